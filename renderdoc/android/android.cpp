@@ -1110,7 +1110,7 @@ struct AndroidController : public IDeviceProtocolHandler
     return 0;
   }
 
-  IRemoteServer *CreateRemoteServer(Network::Socket *sock, const rdcstr &deviceID) override
+  RemoteServer *CreateRemoteServer(Network::Socket *sock, const rdcstr &deviceID) override
   {
     uint16_t portbase = 0;
 
@@ -1050,6 +1050,56 @@ went wrong.
 
 DECLARE_REFLECTION_STRUCT(ExecuteResult);
 
+DOCUMENT(R"(Statistics about a connection to a remote server, and how busy the server is with other
+connections.
+)");
+struct RemoteServerStats
+{
+  DOCUMENT("");
+  RemoteServerStats() = default;
+  RemoteServerStats(const RemoteServerStats &) = default;
+  RemoteServerStats &operator=(const RemoteServerStats &) = default;
+
+  DOCUMENT(R"(The identifier of this connection's session on the server. If the connection drops and
+is re-established, the session is kept.
+)");
+  uint64_t session = 0;
+
+  DOCUMENT("The number of clients currently connected to the server, including this one.");
+  uint32_t activeClients = 0;
+  DOCUMENT("The maximum number of clients the server will serve at once.");
+  uint32_t maxClients = 0;
+  DOCUMENT("The number of captures currently open on the server, across all clients.");
+  uint32_t openReplays = 0;
+  DOCUMENT(R"(The maximum number of captures the server will have open at once. Clients opening a
+capture beyond this wait until another client closes one.
+)");
+  uint32_t maxReplays = 0;
+
+  DOCUMENT("The number of replay requests this connection has made.");
+  uint64_t replayRequests = 0;
+  DOCUMENT("The total time in seconds spent executing this connection's replay requests.");
+  double replayTime = 0.0;
+  DOCUMENT(R"(The total time in seconds this connection has spent waiting on other clients, either
+for a capture to be opened or for its replay requests to get a turn.
+)");
+  double waitTime = 0.0;
+
+  DOCUMENT("The number of bytes of captures this session has copied to the server.");
+  uint64_t storageUsed = 0;
+  DOCUMENT(R"(The maximum number of bytes of captures each session can copy to the server, or 0 if
+there is no limit.
+)");
+  uint64_t storageLimit = 0;
+
+  DOCUMENT(R"(The maximum number of seconds of replay work each session can use, or 0 if there is no
+limit. A session that goes over this is disconnected.
+)");
+  uint32_t replayTimeLimit = 0;
+};
+
+DECLARE_REFLECTION_STRUCT(RemoteServerStats);
+
 // there's not a good way to document a callback, so for lack of a better place we declare these
 // here and document them in the main IReplayController. They can be linked to from anywhere by
 // name.
@@ -1841,6 +1841,44 @@ struct DriverInformation
 
 DECLARE_REFLECTION_STRUCT(DriverInformation);
 
+DOCUMENT(R"(Statistics about the GPU memory that the replay has allocated for its own use, such as
+for storing resources' initial contents. This does not include memory allocated by the capture.
+
+Only some APIs report these statistics, for others they will all be ``0``.
+)");
+struct ReplayMemoryStats
+{
+  DOCUMENT("");
+  ReplayMemoryStats() = default;
+  ReplayMemoryStats(const ReplayMemoryStats &) = default;
+  ReplayMemoryStats &operator=(const ReplayMemoryStats &) = default;
+
+  DOCUMENT("The number of blocks of memory allocated from the driver.");
+  uint32_t blockCount = 0;
+  DOCUMENT("The number of individual allocations within those blocks.");
+  uint32_t allocationCount = 0;
+  DOCUMENT("The total size in bytes of all blocks.");
+  uint64_t blockBytes = 0;
+  DOCUMENT(R"(The number of bytes within blocks that are allocated. The rest is free to be reused
+without allocating any more memory.
+)");
+  uint64_t allocatedBytes = 0;
+  DOCUMENT(R"(The number of bytes of blocks that would normally be in GPU local memory but were put
+in host-visible memory instead, because GPU local memory was over budget or exhausted.
+)");
+  uint64_t spilledBytes = 0;
+  DOCUMENT(R"(The driver's estimate of how many bytes of GPU local memory the process can use, or
+``0`` if the driver doesn't report a budget.
+)");
+  uint64_t deviceLocalBudget = 0;
+  DOCUMENT(R"(The number of bytes of GPU local memory the process is using, including the capture's
+own resources, or ``0`` if the driver doesn't report a budget.
+)");
+  uint64_t deviceLocalUsage = 0;
+};
+
+DECLARE_REFLECTION_STRUCT(ReplayMemoryStats);
+
 DOCUMENT("A 128-bit Uuid.");
 struct Uuid
 {
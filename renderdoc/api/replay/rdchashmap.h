@@ -0,0 +1,510 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <new>
+#include <type_traits>
+#include "apidefs.h"
+#include "rdcarray.h"
+#include "rdcpair.h"
+
+// the maps below only support keys that are plain values of up to 64 bits - ResourceId, integers,
+// enums, handles and pointers - and they operate on the raw bits of the key.
+template <typename Key>
+inline uint64_t rdckeybits(const Key &key)
+{
+  static_assert(sizeof(Key) <= sizeof(uint64_t) && std::is_trivially_copyable<Key>::value,
+                "Key must be a plain value of at most 64 bits");
+
+  uint64_t ret = 0;
+  memcpy(&ret, &key, sizeof(Key));
+  return ret;
+}
+
+// this is an open-addressing hash map. Entries are stored inline in a single allocation instead of
+// in individually allocated nodes, and lookups use robin hood linear probing so probe sequences
+// stay short even at high load. Keys are hashed from their raw bits with fibonacci hashing, which
+// spreads out keys that are mostly sequential like ResourceIds.
+// For ease of transition it presents a std::unordered_map like interface, though it has weaker
+// guarantees: iteration order is unspecified and any insertion or erase invalidates iterators and
+// references to elements.
+DOCUMENT("");
+template <typename Key, typename Value>
+struct rdchashmap
+{
+  using value_type = rdcpair<Key, Value>;
+  using size_type = size_t;
+
+  template <typename MapType, typename ElemType>
+  struct iterator_base
+  {
+    iterator_base() = default;
+    iterator_base(MapType *m, size_t i) : map(m), idx(i) { skip(); }
+    // allow converting a non-const iterator to a const one
+    template <typename OtherMap, typename OtherElem>
+    iterator_base(const iterator_base<OtherMap, OtherElem> &o) : map(o.map), idx(o.idx)
+    {
+    }
+
+    ElemType &operator*() const { return map->elem(idx); }
+    ElemType *operator->() const { return &map->elem(idx); }
+    iterator_base &operator++()
+    {
+      idx++;
+      skip();
+      return *this;
+    }
+    iterator_base operator++(int)
+    {
+      iterator_base ret = *this;
+      ++(*this);
+      return ret;
+    }
+    template <typename OtherMap, typename OtherElem>
+    bool operator==(const iterator_base<OtherMap, OtherElem> &o) const
+    {
+      return idx == o.idx;
+    }
+    template <typename OtherMap, typename OtherElem>
+    bool operator!=(const iterator_base<OtherMap, OtherElem> &o) const
+    {
+      return idx != o.idx;
+    }
+
+    MapType *map = NULL;
+    size_t idx = 0;
+
+  private:
+    void skip()
+    {
+      while(idx < map->capacity() && map->m_Dist[idx] == 0)
+        idx++;
+    }
+  };
+
+  using iterator = iterator_base<rdchashmap, value_type>;
+  using const_iterator = iterator_base<const rdchashmap, const value_type>;
+
+  rdchashmap() = default;
+  rdchashmap(const rdchashmap &o) { *this = o; }
+  rdchashmap(rdchashmap &&o) { swap(o); }
+  ~rdchashmap() { clear(); }
+  rdchashmap &operator=(const rdchashmap &o)
+  {
+    if(this == &o)
+      return *this;
+
+    clear();
+    reserve(o.size());
+    for(const value_type &v : o)
+      insert(v);
+    return *this;
+  }
+  rdchashmap &operator=(rdchashmap &&o)
+  {
+    clear();
+    swap(o);
+    return *this;
+  }
+
+  iterator find(const Key &key) { return iterator(this, find_idx(key)); }
+  const_iterator find(const Key &key) const { return const_iterator(this, find_idx(key)); }
+  Value &operator[](const Key &key)
+  {
+    size_t idx = find_idx(key);
+    if(idx == capacity())
+    {
+      idx = insert_new(key);
+      new(&elem(idx)) value_type(key, Value());
+    }
+    return elem(idx).second;
+  }
+
+  rdcpair<iterator, bool> insert(const value_type &val)
+  {
+    size_t idx = find_idx(val.first);
+    if(idx != capacity())
+      return {iterator(this, idx), false};
+
+    idx = insert_new(val.first);
+    new(&elem(idx)) value_type(val);
+    return {iterator(this, idx), true};
+  }
+
+  rdcpair<iterator, bool> insert(value_type &&val)
+  {
+    size_t idx = find_idx(val.first);
+    if(idx != capacity())
+      return {iterator(this, idx), false};
+
+    idx = insert_new(val.first);
+    new(&elem(idx)) value_type(std::move(val));
+    return {iterator(this, idx), true};
+  }
+
+  void erase(const Key &key)
+  {
+    size_t idx = find_idx(key);
+    if(idx != capacity())
+      erase_idx(idx);
+  }
+  void erase(const_iterator it) { erase_idx(it.idx); }
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, capacity()); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, capacity()); }
+  bool empty() const { return m_Count == 0; }
+  size_t size() const { return m_Count; }
+  void reserve(size_t count)
+  {
+    size_t cap = capacity() ? capacity() : MinCapacity;
+    while(count * MaxLoadDenom > cap * MaxLoadNum)
+      cap *= 2;
+
+    if(cap > capacity())
+      rehash(cap);
+  }
+  void swap(rdchashmap &other)
+  {
+    m_Slots.swap(other.m_Slots);
+    m_Dist.swap(other.m_Dist);
+    std::swap(m_Count, other.m_Count);
+    std::swap(m_Shift, other.m_Shift);
+  }
+  void clear()
+  {
+    for(size_t i = 0; i < capacity(); i++)
+    {
+      if(m_Dist[i])
+      {
+        elem(i).~value_type();
+        m_Dist[i] = 0;
+      }
+    }
+    m_Count = 0;
+  }
+
+private:
+  static const size_t MinCapacity = 16;
+  // grow when more than 3/4 full
+  static const size_t MaxLoadNum = 3;
+  static const size_t MaxLoadDenom = 4;
+  // the probe distance is stored in a byte, with 0 meaning empty
+  static const uint8_t MaxDist = 0xff;
+
+  using Slot = typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type;
+
+  rdcarray<Slot> m_Slots;
+  rdcarray<uint8_t> m_Dist;
+  size_t m_Count = 0;
+  uint32_t m_Shift = 64;
+
+  size_t capacity() const { return m_Dist.size(); }
+  value_type &elem(size_t idx) { return *(value_type *)&m_Slots[idx]; }
+  const value_type &elem(size_t idx) const { return *(const value_type *)&m_Slots[idx]; }
+  size_t home(const Key &key) const
+  {
+    return size_t((rdckeybits(key) * 0x9E3779B97F4A7C15ULL) >> m_Shift);
+  }
+
+  size_t find_idx(const Key &key) const
+  {
+    const size_t cap = capacity();
+    if(m_Count == 0)
+      return cap;
+
+    size_t idx = home(key);
+    // with robin hood hashing, once we see an element closer to its home than we are to ours, the
+    // key can't be present.
+    for(uint8_t dist = 1; m_Dist[idx] >= dist; dist++)
+    {
+      if(elem(idx).first == key)
+        return idx;
+      idx = (idx + 1) & (cap - 1);
+    }
+    return cap;
+  }
+
+  // returns an index that the caller must construct the new element into
+  size_t insert_new(const Key &key)
+  {
+    if((m_Count + 1) * MaxLoadDenom > capacity() * MaxLoadNum)
+      rehash(capacity() ? capacity() * 2 : MinCapacity);
+
+    const size_t mask = capacity() - 1;
+
+    size_t idx = home(key);
+    uint8_t dist = 1;
+
+    // find where the new element goes - the first slot that's empty or whose element is closer to
+    // its home than the new element would be
+    while(m_Dist[idx] >= dist)
+    {
+      idx = (idx + 1) & mask;
+      dist++;
+
+      if(dist == MaxDist)
+      {
+        rehash(capacity() * 2);
+        return insert_new(key);
+      }
+    }
+
+    // find the empty slot at the end of this run, which everything shifts up into
+    size_t empty = idx;
+    while(m_Dist[empty] != 0)
+    {
+      if(m_Dist[empty] + 1 == MaxDist)
+      {
+        rehash(capacity() * 2);
+        return insert_new(key);
+      }
+      empty = (empty + 1) & mask;
+    }
+
+    while(empty != idx)
+    {
+      size_t prev = (empty - 1) & mask;
+      new(&elem(empty)) value_type(std::move(elem(prev)));
+      elem(prev).~value_type();
+      m_Dist[empty] = m_Dist[prev] + 1;
+      empty = prev;
+    }
+
+    m_Dist[idx] = dist;
+    m_Count++;
+    return idx;
+  }
+
+  void erase_idx(size_t idx)
+  {
+    const size_t mask = capacity() - 1;
+
+    elem(idx).~value_type();
+
+    // shift the following run back, so there are never holes inside a probe sequence
+    size_t next = (idx + 1) & mask;
+    while(m_Dist[next] > 1)
+    {
+      new(&elem(idx)) value_type(std::move(elem(next)));
+      elem(next).~value_type();
+      m_Dist[idx] = m_Dist[next] - 1;
+      idx = next;
+      next = (next + 1) & mask;
+    }
+
+    m_Dist[idx] = 0;
+    m_Count--;
+  }
+
+  void rehash(size_t newCapacity)
+  {
+    rdcarray<Slot> oldSlots;
+    rdcarray<uint8_t> oldDist;
+    oldSlots.swap(m_Slots);
+    oldDist.swap(m_Dist);
+
+    m_Slots.resize(newCapacity);
+    m_Dist.resize(newCapacity);
+    m_Count = 0;
+    m_Shift = 64;
+    for(size_t c = newCapacity; c > 1; c >>= 1)
+      m_Shift--;
+
+    for(size_t i = 0; i < oldDist.size(); i++)
+    {
+      if(oldDist[i])
+      {
+        value_type &old = *(value_type *)&oldSlots[i];
+        new(&elem(insert_new(old.first))) value_type(std::move(old));
+        old.~value_type();
+      }
+    }
+  }
+};
+
+// this is a map for keys which are allocated densely, such as ResourceIds generated in sequence
+// during replay. Elements are stored in an array indexed by the key's offset from the lowest key,
+// so lookups are a subtraction and a bounds check. Memory use is proportional to the range of keys,
+// not the number of them, so this should only be used where few keys in the range are missing.
+// Iteration is in ascending key order. Inserting or erasing may invalidate iterators.
+DOCUMENT("");
+template <typename Key, typename Value>
+struct rdcdensemap
+{
+  using value_type = rdcpair<Key, Value>;
+  using size_type = size_t;
+
+  template <typename MapType, typename ElemType>
+  struct iterator_base
+  {
+    iterator_base() = default;
+    iterator_base(MapType *m, size_t i) : map(m), idx(i) { skip(); }
+    template <typename OtherMap, typename OtherElem>
+    iterator_base(const iterator_base<OtherMap, OtherElem> &o) : map(o.map), idx(o.idx)
+    {
+    }
+
+    ElemType &operator*() const { return map->m_Elems[idx]; }
+    ElemType *operator->() const { return &map->m_Elems[idx]; }
+    iterator_base &operator++()
+    {
+      idx++;
+      skip();
+      return *this;
+    }
+    iterator_base operator++(int)
+    {
+      iterator_base ret = *this;
+      ++(*this);
+      return ret;
+    }
+    template <typename OtherMap, typename OtherElem>
+    bool operator==(const iterator_base<OtherMap, OtherElem> &o) const
+    {
+      return idx == o.idx;
+    }
+    template <typename OtherMap, typename OtherElem>
+    bool operator!=(const iterator_base<OtherMap, OtherElem> &o) const
+    {
+      return idx != o.idx;
+    }
+
+    MapType *map = NULL;
+    size_t idx = 0;
+
+  private:
+    void skip()
+    {
+      while(idx < map->m_Present.size() && !map->m_Present[idx])
+        idx++;
+    }
+  };
+
+  using iterator = iterator_base<rdcdensemap, value_type>;
+  using const_iterator = iterator_base<const rdcdensemap, const value_type>;
+
+  iterator find(const Key &key) { return iterator(this, find_idx(key)); }
+  const_iterator find(const Key &key) const { return const_iterator(this, find_idx(key)); }
+  Value &operator[](const Key &key)
+  {
+    size_t idx = find_idx(key);
+    if(idx == m_Present.size())
+      idx = insert_new(key);
+    return m_Elems[idx].second;
+  }
+
+  rdcpair<iterator, bool> insert(const value_type &val)
+  {
+    size_t idx = find_idx(val.first);
+    if(idx != m_Present.size())
+      return {iterator(this, idx), false};
+
+    idx = insert_new(val.first);
+    m_Elems[idx].second = val.second;
+    return {iterator(this, idx), true};
+  }
+
+  void erase(const Key &key)
+  {
+    size_t idx = find_idx(key);
+    if(idx != m_Present.size())
+      erase_idx(idx);
+  }
+  void erase(const_iterator it) { erase_idx(it.idx); }
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, m_Present.size()); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, m_Present.size()); }
+  bool empty() const { return m_Count == 0; }
+  size_t size() const { return m_Count; }
+  void swap(rdcdensemap &other)
+  {
+    m_Elems.swap(other.m_Elems);
+    m_Present.swap(other.m_Present);
+    std::swap(m_Base, other.m_Base);
+    std::swap(m_Count, other.m_Count);
+  }
+  void clear()
+  {
+    m_Elems.clear();
+    m_Present.clear();
+    m_Base = 0;
+    m_Count = 0;
+  }
+
+private:
+  rdcarray<value_type> m_Elems;
+  rdcarray<uint8_t> m_Present;
+  uint64_t m_Base = 0;
+  size_t m_Count = 0;
+
+  size_t find_idx(const Key &key) const
+  {
+    const uint64_t bits = rdckeybits(key);
+    if(bits < m_Base || bits - m_Base >= m_Present.size() || !m_Present[size_t(bits - m_Base)])
+      return m_Present.size();
+    return size_t(bits - m_Base);
+  }
+
+  size_t insert_new(const Key &key)
+  {
+    const uint64_t bits = rdckeybits(key);
+
+    if(m_Present.empty())
+    {
+      m_Base = bits;
+    }
+    else if(bits < m_Base)
+    {
+      // rare - keys are expected to be allocated in ascending order - so just shift everything up
+      size_t shift = size_t(m_Base - bits);
+      m_Elems.insert(0, rdcarray<value_type>(shift));
+      m_Present.insert(0, rdcarray<uint8_t>(shift));
+      m_Base = bits;
+    }
+
+    size_t idx = size_t(bits - m_Base);
+    if(idx >= m_Present.size())
+    {
+      m_Elems.resize(idx + 1);
+      m_Present.resize(idx + 1);
+    }
+
+    m_Elems[idx].first = key;
+    m_Present[idx] = 1;
+    m_Count++;
+    return idx;
+  }
+
+  void erase_idx(size_t idx)
+  {
+    m_Elems[idx] = value_type();
+    m_Present[idx] = 0;
+    m_Count--;
+  }
+};
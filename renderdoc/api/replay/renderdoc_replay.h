@@ -701,6 +701,51 @@ See :meth:`BuildTargetShader`.
 )");
   virtual const SDFile &GetStructuredFile() = 0;
 
+  DOCUMENT(R"(Find every event whose structured data references a given resource in any parameter.
+
+The first search builds an index over the whole capture's structured data, subsequent searches are
+a direct lookup.
+
+:param ResourceId id: The resource to search for.
+:return: The sorted list of event IDs referencing the resource.
+:rtype: List[int]
+)");
+  virtual rdcarray<uint32_t> FindEventsReferencingResource(ResourceId id) = 0;
+
+  DOCUMENT(R"(Find every event whose function/chunk has a given name, e.g. ``vkCmdDraw``.
+
+The name is matched case-insensitively, but otherwise must match exactly.
+
+:param str name: The function name to search for.
+:return: The sorted list of matching event IDs.
+:rtype: List[int]
+)");
+  virtual rdcarray<uint32_t> FindEventsByName(const rdcstr &name) = 0;
+
+  DOCUMENT(R"(Find every event with a parameter of a given name, at any depth in its structured
+data.
+
+The name is matched case-insensitively, but otherwise must match exactly.
+
+:param str name: The parameter name to search for.
+:return: The sorted list of matching event IDs.
+:rtype: List[int]
+)");
+  virtual rdcarray<uint32_t> FindEventsWithParameter(const rdcstr &name) = 0;
+
+  DOCUMENT(R"(Find every event with a string parameter, or a named value such as an enum or flags,
+matching some text.
+
+The text is matched case-insensitively.
+
+:param str text: The text to search for.
+:param bool exactMatch: ``True`` if the whole value must match, ``False`` if the value need only
+  contain the text.
+:return: The sorted list of matching event IDs.
+:rtype: List[int]
+)");
+  virtual rdcarray<uint32_t> FindEventsWithString(const rdcstr &text, bool exactMatch) = 0;
+
   DOCUMENT(R"(Add fake marker regions to the list of actions in the capture, based on which
 textures are bound as outputs. Will not do anything if the capture already contains user marker
 regions.
@@ -784,6 +829,13 @@ newly generated messages will be returned after that.
 )");
   virtual rdcarray<DebugMessage> GetDebugMessages() = 0;
 
+  DOCUMENT(R"(Retrieve statistics about the memory the replay has allocated for its own use.
+
+:return: The current statistics.
+:rtype: ReplayMemoryStats
+)");
+  virtual ReplayMemoryStats GetReplayMemoryStats() = 0;
+
   DOCUMENT(R"(Poll for the current status of the replay.
 
 This function can be used to monitor to see if a fatal error has been encountered and react
@@ -979,6 +1031,38 @@ completed, further calls will return an empty list.
 )");
   virtual rdcarray<EventUsage> GetUsage(ResourceId id) = 0;
 
+  DOCUMENT(R"(Retrieve the ways a given resource is used within a range of events.
+
+:param ResourceId id: The id of the texture or buffer resource to be queried.
+:param int firstEventId: The first event ID in the range, inclusive.
+:param int lastEventId: The last event ID in the range, inclusive.
+:return: The list of usages of the resource within the range, sorted by event ID.
+:rtype: List[EventUsage]
+)");
+  virtual rdcarray<EventUsage> GetUsageInRange(ResourceId id, uint32_t firstEventId,
+                                               uint32_t lastEventId) = 0;
+
+  DOCUMENT(R"(Find the first usage of a resource that writes to it after a given event.
+
+Writes include render target, storage and copy destination usage, as well as clears, discards and
+CPU writes.
+
+:param ResourceId id: The id of the texture or buffer resource to be queried.
+:param int eventId: The event to search after. Usage at this event is not included.
+:return: The first writing usage of the resource. If there is none, the returned usage has an
+  ``eventId`` of 0.
+:rtype: EventUsage
+)");
+  virtual EventUsage GetFirstWriteAfter(ResourceId id, uint32_t eventId) = 0;
+
+  DOCUMENT(R"(Retrieve the textures and buffers used by a given event.
+
+:param int eventId: The event to query.
+:return: The sorted list of resources used by the event.
+:rtype: List[ResourceId]
+)");
+  virtual rdcarray<ResourceId> GetResourcesUsedByEvent(uint32_t eventId) = 0;
+
   DOCUMENT(R"(Retrieve the contents of a constant block by reading from memory or their source
 otherwise.
 
@@ -1421,6 +1505,14 @@ or an error has occurred.
 )");
   virtual void CloseCapture(IReplayController *rend) = 0;
 
+  DOCUMENT(R"(Retrieve statistics about this connection's use of the remote server, and how many
+other clients it is sharing the server with.
+
+:return: The current statistics.
+:rtype: RemoteServerStats
+)");
+  virtual RemoteServerStats GetSessionStats() = 0;
+
   static const uint32_t NoPreference = ~0U;
 
 protected:
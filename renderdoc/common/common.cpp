@@ -39,143 +39,196 @@ void rdcassert(const char *msg, const char *file, unsigned int line, const char
                 "Assertion failed: %s", msg);
 }
 
-#if 0
-static __m128 zero = {0};
+// the diff kernels compare 16 bytes at a time, and skip over identical data 64 bytes at a time.
+// Loads are unaligned so any pointers can be compared.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SSE2_DIFF_KERNELS OPTION_ON
+#define NEON_DIFF_KERNELS OPTION_OFF
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define SSE2_DIFF_KERNELS OPTION_OFF
+#define NEON_DIFF_KERNELS OPTION_ON
+#include <arm_neon.h>
+#else
+#define SSE2_DIFF_KERNELS OPTION_OFF
+#define NEON_DIFF_KERNELS OPTION_OFF
 #endif
 
-// assumes a and b both point to 16-byte aligned 16-byte chunks of memory.
-// Returns if they're equal or different
-bool Vec16NotEqual(void *a, void *b)
+// returns a mask with bit i set if byte i differs between the 16 bytes at a and b
+static inline uint32_t DiffMask16(const byte *a, const byte *b)
 {
-// disabled SSE version as it's acting dodgy
-#if 0
-	__m128 avec = _mm_load_ps(aflt);
-	__m128 bvec = _mm_load_ps(bflt);
-
-	__m128 diff = _mm_xor_ps(avec, bvec);
-
-	__m128 eq = _mm_cmpeq_ps(diff, zero);
-	int mask = _mm_movemask_ps(eq);
-	int signMask = _mm_movemask_ps(diff);
-
-	// first check ensures that diff is floatequal to zero (ie. avec bitwise equal to bvec).
-	// HOWEVER -0 is floatequal to 0, so we ensure no sign bits are set on diff
-	if((mask^0xf) || signMask != 0)
-	{
-		return true;
-	}
-	
-	return false;
-#elif ENABLED(RDOC_X64)
-  uint64_t *a64 = (uint64_t *)a;
-  uint64_t *b64 = (uint64_t *)b;
-
-  return a64[0] != b64[0] || a64[1] != b64[1];
+#if ENABLED(SSE2_DIFF_KERNELS)
+  __m128i eq =
+      _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)a), _mm_loadu_si128((const __m128i *)b));
+  return uint32_t(_mm_movemask_epi8(eq)) ^ 0xffffU;
+#elif ENABLED(NEON_DIFF_KERNELS)
+  static const uint8_t bitWeights[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+  uint8x16_t ne = vmvnq_u8(vceqq_u8(vld1q_u8(a), vld1q_u8(b)));
+  uint8x16_t bits = vandq_u8(ne, vld1q_u8(bitWeights));
+  return uint32_t(vaddv_u8(vget_low_u8(bits))) | (uint32_t(vaddv_u8(vget_high_u8(bits))) << 8);
 #else
-  uint32_t *a32 = (uint32_t *)a;
-  uint32_t *b32 = (uint32_t *)b;
+  uint32_t mask = 0;
+  for(uint32_t i = 0; i < 16; i++)
+    mask |= a[i] != b[i] ? (1U << i) : 0U;
+  return mask;
+#endif
+}
 
-  return a32[0] != b32[0] || a32[1] != b32[1] || a32[2] != b32[2] || a32[3] != b32[3];
+// returns true if the 64 bytes at a and b are identical
+static inline bool Equal64(const byte *a, const byte *b)
+{
+#if ENABLED(SSE2_DIFF_KERNELS)
+  __m128i eq0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + 0)),
+                               _mm_loadu_si128((const __m128i *)(b + 0)));
+  __m128i eq1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + 16)),
+                               _mm_loadu_si128((const __m128i *)(b + 16)));
+  __m128i eq2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + 32)),
+                               _mm_loadu_si128((const __m128i *)(b + 32)));
+  __m128i eq3 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + 48)),
+                               _mm_loadu_si128((const __m128i *)(b + 48)));
+  __m128i eq = _mm_and_si128(_mm_and_si128(eq0, eq1), _mm_and_si128(eq2, eq3));
+  return _mm_movemask_epi8(eq) == 0xffff;
+#elif ENABLED(NEON_DIFF_KERNELS)
+  uint8x16_t x0 = veorq_u8(vld1q_u8(a + 0), vld1q_u8(b + 0));
+  uint8x16_t x1 = veorq_u8(vld1q_u8(a + 16), vld1q_u8(b + 16));
+  uint8x16_t x2 = veorq_u8(vld1q_u8(a + 32), vld1q_u8(b + 32));
+  uint8x16_t x3 = veorq_u8(vld1q_u8(a + 48), vld1q_u8(b + 48));
+  return vmaxvq_u8(vorrq_u8(vorrq_u8(x0, x1), vorrq_u8(x2, x3))) == 0;
+#else
+  return memcmp(a, b, 64) == 0;
 #endif
 }
 
 bool FindDiffRange(void *a, void *b, size_t bufSize, size_t &diffStart, size_t &diffEnd)
 {
-  RDCASSERT(uintptr_t(a) % 16 == 0);
-  RDCASSERT(uintptr_t(b) % 16 == 0);
+  const byte *pa = (const byte *)a;
+  const byte *pb = (const byte *)b;
 
   diffStart = bufSize + 1;
   diffEnd = 0;
 
-  size_t alignedSize = bufSize & (~0xf);
-  size_t numVecs = alignedSize / 16;
-
+  // sweep forward to find the start of differences
   size_t offs = 0;
+  while(offs + 64 <= bufSize && Equal64(pa + offs, pb + offs))
+    offs += 64;
 
-  float *aflt = (float *)a;
-  float *bflt = (float *)b;
-
-  // sweep to find the start of differences
-  for(size_t v = 0; v < numVecs; v++)
+  for(; offs + 16 <= bufSize; offs += 16)
   {
-    if(Vec16NotEqual(aflt, bflt))
+    uint32_t mask = DiffMask16(pa + offs, pb + offs);
+    if(mask)
     {
-      diffStart = offs;
+      diffStart = offs + Bits::CountTrailingZeroes(mask);
       break;
     }
-
-    aflt += 4;
-    bflt += 4;
-    offs += 4 * sizeof(float);
   }
 
-  // make sure we're byte-accurate, to comply with WRITE_NO_OVERWRITE
-  while(diffStart < bufSize && *((byte *)a + diffStart) == *((byte *)b + diffStart))
-    diffStart++;
-
-  // do we have some unaligned bytes at the end of the buffer?
-  if(bufSize > alignedSize)
+  if(diffStart > bufSize)
   {
-    size_t numBytes = bufSize - alignedSize;
-
-    // if we haven't even found a start, check in these bytes
-    if(diffStart > bufSize)
+    for(; offs < bufSize; offs++)
     {
-      offs = alignedSize;
-
-      for(size_t by = 0; by < numBytes; by++)
+      if(pa[offs] != pb[offs])
       {
-        if(*((byte *)a + alignedSize + by) != *((byte *)b + alignedSize + by))
-        {
-          diffStart = offs;
-          break;
-        }
-
-        offs++;
+        diffStart = offs;
+        break;
       }
     }
+  }
+
+  if(diffStart > bufSize)
+    return false;
 
-    // sweep from the last byte to find the end
-    for(size_t by = 0; by < numBytes; by++)
+  // sweep back from the end to find the end. We're byte-accurate to comply with
+  // WRITE_NO_OVERWRITE. If the memory is being modified underneath us the difference at the start
+  // might have gone, in which case we can end up with diffEnd == diffStart.
+  size_t end = bufSize;
+  while(end - diffStart >= 64 && Equal64(pa + end - 64, pb + end - 64))
+    end -= 64;
+
+  for(; end - diffStart >= 16; end -= 16)
+  {
+    uint32_t mask = DiffMask16(pa + end - 16, pb + end - 16);
+    if(mask)
     {
-      if(*((byte *)a + bufSize - 1 - by) != *((byte *)b + bufSize - 1 - by))
-      {
-        diffEnd = bufSize - by;
-        break;
-      }
+      diffEnd = end - 16 + 32 - Bits::CountLeadingZeroes(mask);
+      return true;
     }
   }
 
-  // if we haven't found a start, or we've found a start AND and end,
-  // then we're done.
-  if(diffStart > bufSize || diffEnd > 0)
-    return diffStart < bufSize;
+  while(end > diffStart && pa[end - 1] == pb[end - 1])
+    end--;
 
-  offs = alignedSize;
+  diffEnd = end;
+  return true;
+}
 
-  // sweep from the last __m128
-  aflt = (float *)a + offs / sizeof(float) - 4;
-  bflt = (float *)b + offs / sizeof(float) - 4;
+void FindDiffRanges(const void *a, const void *b, size_t bufSize, size_t mergeGap,
+                    rdcarray<rdcpair<size_t, size_t>> &diffs)
+{
+  const byte *pa = (const byte *)a;
+  const byte *pb = (const byte *)b;
 
-  for(size_t v = 0; v < numVecs; v++)
-  {
-    if(Vec16NotEqual(aflt, bflt))
+  bool active = false;
+  size_t curStart = 0, curEnd = 0;
+
+  auto addDiff = [&](size_t start, size_t end) {
+    if(active && start - curEnd <= mergeGap)
     {
-      diffEnd = offs;
-      break;
+      curEnd = end;
+      return;
     }
 
-    aflt -= 4;
-    bflt -= 4;
-    offs -= 16;
+    if(active)
+      diffs.push_back({curStart, curEnd});
+
+    active = true;
+    curStart = start;
+    curEnd = end;
+  };
+
+  auto diffVec = [&](size_t offs) {
+    uint32_t mask = DiffMask16(pa + offs, pb + offs);
+
+    // add each run of differing bytes in turn, they're merged above if they're close enough
+    while(mask)
+    {
+      uint32_t first = Bits::CountTrailingZeroes(mask);
+      uint32_t run = Bits::CountTrailingZeroes(~(mask >> first));
+      addDiff(offs + first, offs + first + run);
+      mask &= ~(((1U << run) - 1) << first);
+    }
+  };
+
+  size_t offs = 0;
+
+  for(; offs + 64 <= bufSize; offs += 64)
+  {
+    if(Equal64(pa + offs, pb + offs))
+      continue;
+
+    diffVec(offs);
+    diffVec(offs + 16);
+    diffVec(offs + 32);
+    diffVec(offs + 48);
   }
 
-  // make sure we're byte-accurate, to comply with WRITE_NO_OVERWRITE
-  while(diffEnd > 0 && *((byte *)a + diffEnd - 1) == *((byte *)b + diffEnd - 1))
-    diffEnd--;
+  for(; offs + 16 <= bufSize; offs += 16)
+    diffVec(offs);
+
+  for(; offs < bufSize; offs++)
+    if(pa[offs] != pb[offs])
+      addDiff(offs, offs + 1);
+
+  if(active)
+    diffs.push_back({curStart, curEnd});
+}
+
+void CapDiffRanges(rdcarray<rdcpair<size_t, size_t>> &diffs, size_t maxRanges)
+{
+  if(maxRanges == 0 || diffs.size() <= maxRanges)
+    return;
 
-  // if we found a start then we necessarily found an end
-  return diffStart < bufSize;
+  diffs[maxRanges - 1].second = diffs.back().second;
+  diffs.resize(maxRanges);
 }
 
 uint32_t CalcNumMips(int w, int h, int d)
@@ -527,3 +580,184 @@ void rdclog_direct(time_t utcTime, uint32_t pid, LogType type, const char *proje
 
   SAFE_DELETE_ARRAY(oversizedBuffer);
 }
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+#include "common/timing.h"
+
+typedef rdcarray<rdcpair<size_t, size_t>> DiffRangeList;
+
+static DiffRangeList ReferenceDiffRanges(const byte *a, const byte *b, size_t size, size_t mergeGap)
+{
+  DiffRangeList ret;
+  for(size_t i = 0; i < size; i++)
+  {
+    if(a[i] == b[i])
+      continue;
+
+    if(!ret.empty() && i - ret.back().second <= mergeGap)
+      ret.back().second = i + 1;
+    else
+      ret.push_back({i, i + 1});
+  }
+  return ret;
+}
+
+TEST_CASE("Test finding differences between buffers", "[diff]")
+{
+  uint32_t seed = 0x12345678U;
+  auto rand = [&seed]() {
+    seed = seed * 1103515245U + 12345U;
+    return seed >> 8;
+  };
+
+  bytebuf a, b;
+  a.resize(5000);
+  for(byte &x : a)
+    x = byte(rand());
+
+  // offset the buffers relative to each other to check unaligned data
+  b.resize(a.size() + 3);
+
+  for(size_t size : {0, 1, 15, 16, 17, 63, 64, 65, 127, 200, 1000, 4099})
+  {
+    for(size_t numChanges : {0, 1, 2, 5, 40})
+    {
+      for(size_t misalign : {0, 3})
+      {
+        byte *bdata = b.data() + misalign;
+        memcpy(bdata, a.data(), size);
+
+        for(size_t c = 0; c < numChanges && size > 0; c++)
+        {
+          size_t offs = rand() % size;
+          size_t len = RDCMIN(size - offs, size_t(1 + rand() % 20));
+          for(size_t i = 0; i < len; i++)
+            bdata[offs + i] ^= byte(1 + rand() % 255);
+        }
+
+        DiffRangeList ref = ReferenceDiffRanges(a.data(), bdata, size, 0);
+
+        size_t diffStart = 0, diffEnd = 0;
+        bool found = FindDiffRange(a.data(), bdata, size, diffStart, diffEnd);
+
+        CHECK(found == !ref.empty());
+        if(found && !ref.empty())
+        {
+          CHECK(diffStart == ref.front().first);
+          CHECK(diffEnd == ref.back().second);
+        }
+
+        for(size_t mergeGap : {0, 1, 7, 64, 1000})
+        {
+          DiffRangeList diffs;
+          FindDiffRanges(a.data(), bdata, size, mergeGap, diffs);
+
+          CHECK((diffs == ReferenceDiffRanges(a.data(), bdata, size, mergeGap)));
+        }
+      }
+    }
+  }
+
+  SECTION("Ranges are appended")
+  {
+    memcpy(b.data(), a.data(), a.size());
+    b[10]++;
+
+    DiffRangeList diffs = {{1, 2}};
+    FindDiffRanges(a.data(), b.data(), a.size(), 0, diffs);
+    CHECK((diffs == DiffRangeList({{1, 2}, {10, 11}})));
+  };
+
+  SECTION("Range count can be capped")
+  {
+    DiffRangeList diffs = {{0, 4}, {10, 12}, {20, 21}, {30, 40}, {50, 51}};
+
+    DiffRangeList capped = diffs;
+    CapDiffRanges(capped, 5);
+    CHECK((capped == diffs));
+
+    capped = diffs;
+    CapDiffRanges(capped, 0);
+    CHECK((capped == diffs));
+
+    capped = diffs;
+    CapDiffRanges(capped, 3);
+    CHECK((capped == DiffRangeList({{0, 4}, {10, 12}, {20, 51}})));
+
+    capped = diffs;
+    CapDiffRanges(capped, 1);
+    CHECK((capped == DiffRangeList({{0, 51}})));
+  };
+}
+
+TEST_CASE("Benchmark finding differences between buffers", "[diff][.benchmark]")
+{
+  const size_t size = 100 * 1024 * 1024;
+
+  bytebuf a, b;
+  a.resize(size);
+  for(size_t i = 0; i < size; i++)
+    a[i] = byte((i * 2654435761U) >> 24);
+
+  struct Workload
+  {
+    const char *name;
+    rdcarray<rdcpair<size_t, size_t>> writes;
+  };
+
+  rdcarray<Workload> workloads;
+
+  workloads.push_back({"unchanged", {}});
+  workloads.push_back({"64 bytes at each end", {{0, 64}, {size - 64, size}}});
+
+  Workload scattered = {"1000 scattered 16 byte writes", {}};
+  for(size_t i = 0; i < 1000; i++)
+  {
+    size_t offs = size_t((i * 2654435761ULL) % (size - 16));
+    scattered.writes.push_back({offs, offs + 16});
+  }
+  workloads.push_back(scattered);
+
+  Workload strided = {"4 bytes in every 4KB", {}};
+  for(size_t offs = 0; offs < size; offs += 4096)
+    strided.writes.push_back({offs, offs + 4});
+  workloads.push_back(strided);
+
+  for(const Workload &w : workloads)
+  {
+    b = a;
+    for(const rdcpair<size_t, size_t> &write : w.writes)
+      for(size_t i = write.first; i < write.second; i++)
+        b[i] = ~b[i];
+
+    PerformanceTimer timer;
+
+    size_t diffStart = 0, diffEnd = 0;
+    bool found = FindDiffRange(a.data(), b.data(), size, diffStart, diffEnd);
+
+    double spanTime = timer.GetMilliseconds();
+    uint64_t spanBytes = found ? diffEnd - diffStart : 0;
+
+    for(size_t mergeGap : {0, 128, 4096})
+    {
+      timer.Restart();
+
+      DiffRangeList diffs;
+      FindDiffRanges(a.data(), b.data(), size, mergeGap, diffs);
+
+      double rangesTime = timer.GetMilliseconds();
+
+      uint64_t rangesBytes = 0;
+      for(const rdcpair<size_t, size_t> &d : diffs)
+        rangesBytes += d.second - d.first;
+
+      RDCLOG("%s: single span %.2f ms covering %llu bytes. Merge gap %zu: %.2f ms, %zu ranges "
+             "covering %llu bytes",
+             w.name, spanTime, spanBytes, mergeGap, rangesTime, diffs.size(), rangesBytes);
+    }
+  }
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -27,6 +27,8 @@
 
 #include <stdint.h>
 #include <time.h>
+#include "api/replay/rdcarray.h"
+#include "api/replay/rdcpair.h"
 #include "globalconfig.h"
 
 // we allow a small amount of leakage from OS-specific to avoid including os_specific.h which is
@@ -297,7 +299,16 @@ inline T AlignUpPtr(T x, A a)
 #define MAKE_FOURCC(a, b, c, d) \
   (((uint32_t)(d) << 24) | ((uint32_t)(c) << 16) | ((uint32_t)(b) << 8) | (uint32_t)(a))
 
+// finds the first and last differing bytes between a and b, returning false if they're identical.
 bool FindDiffRange(void *a, void *b, size_t bufSize, size_t &diffStart, size_t &diffEnd);
+// finds each range of [start, end) byte offsets that differ between a and b. Differences separated
+// by no more than mergeGap identical bytes are returned as one range, since it's usually cheaper to
+// include a few unchanged bytes than to handle another range. The ranges are appended to diffs.
+void FindDiffRanges(const void *a, const void *b, size_t bufSize, size_t mergeGap,
+                    rdcarray<rdcpair<size_t, size_t>> &diffs);
+// limits a sorted list of ranges to at most maxRanges, by replacing every range from the last
+// allowed one onwards with a single range covering them all.
+void CapDiffRanges(rdcarray<rdcpair<size_t, size_t>> &diffs, size_t maxRanges);
 uint32_t CalcNumMips(int Width, int Height, int Depth);
 
 typedef uint8_t byte;
@@ -27,6 +27,7 @@
 #include "common/common.h"
 #include "common/formatting.h"
 #include "common/result.h"
+#include "maths/blockdecode.h"
 #include "os/os_specific.h"
 #include "serialise/streamio.h"
 
@@ -192,6 +193,48 @@ enum DXGI_FORMAT
   DXGI_FORMAT_P8 = 113,
   DXGI_FORMAT_A8P8 = 114,
   DXGI_FORMAT_B4G4R4A4_UNORM = 115,
+  DXGI_FORMAT_ASTC_4X4_TYPELESS = 133,
+  DXGI_FORMAT_ASTC_4X4_UNORM = 134,
+  DXGI_FORMAT_ASTC_4X4_UNORM_SRGB = 135,
+  DXGI_FORMAT_ASTC_5X4_TYPELESS = 137,
+  DXGI_FORMAT_ASTC_5X4_UNORM = 138,
+  DXGI_FORMAT_ASTC_5X4_UNORM_SRGB = 139,
+  DXGI_FORMAT_ASTC_5X5_TYPELESS = 141,
+  DXGI_FORMAT_ASTC_5X5_UNORM = 142,
+  DXGI_FORMAT_ASTC_5X5_UNORM_SRGB = 143,
+  DXGI_FORMAT_ASTC_6X5_TYPELESS = 145,
+  DXGI_FORMAT_ASTC_6X5_UNORM = 146,
+  DXGI_FORMAT_ASTC_6X5_UNORM_SRGB = 147,
+  DXGI_FORMAT_ASTC_6X6_TYPELESS = 149,
+  DXGI_FORMAT_ASTC_6X6_UNORM = 150,
+  DXGI_FORMAT_ASTC_6X6_UNORM_SRGB = 151,
+  DXGI_FORMAT_ASTC_8X5_TYPELESS = 153,
+  DXGI_FORMAT_ASTC_8X5_UNORM = 154,
+  DXGI_FORMAT_ASTC_8X5_UNORM_SRGB = 155,
+  DXGI_FORMAT_ASTC_8X6_TYPELESS = 157,
+  DXGI_FORMAT_ASTC_8X6_UNORM = 158,
+  DXGI_FORMAT_ASTC_8X6_UNORM_SRGB = 159,
+  DXGI_FORMAT_ASTC_8X8_TYPELESS = 161,
+  DXGI_FORMAT_ASTC_8X8_UNORM = 162,
+  DXGI_FORMAT_ASTC_8X8_UNORM_SRGB = 163,
+  DXGI_FORMAT_ASTC_10X5_TYPELESS = 165,
+  DXGI_FORMAT_ASTC_10X5_UNORM = 166,
+  DXGI_FORMAT_ASTC_10X5_UNORM_SRGB = 167,
+  DXGI_FORMAT_ASTC_10X6_TYPELESS = 169,
+  DXGI_FORMAT_ASTC_10X6_UNORM = 170,
+  DXGI_FORMAT_ASTC_10X6_UNORM_SRGB = 171,
+  DXGI_FORMAT_ASTC_10X8_TYPELESS = 173,
+  DXGI_FORMAT_ASTC_10X8_UNORM = 174,
+  DXGI_FORMAT_ASTC_10X8_UNORM_SRGB = 175,
+  DXGI_FORMAT_ASTC_10X10_TYPELESS = 177,
+  DXGI_FORMAT_ASTC_10X10_UNORM = 178,
+  DXGI_FORMAT_ASTC_10X10_UNORM_SRGB = 179,
+  DXGI_FORMAT_ASTC_12X10_TYPELESS = 181,
+  DXGI_FORMAT_ASTC_12X10_UNORM = 182,
+  DXGI_FORMAT_ASTC_12X10_UNORM_SRGB = 183,
+  DXGI_FORMAT_ASTC_12X12_TYPELESS = 185,
+  DXGI_FORMAT_ASTC_12X12_UNORM = 186,
+  DXGI_FORMAT_ASTC_12X12_UNORM_SRGB = 187,
   DXGI_FORMAT_FORCE_UINT = 0xffffffff
 };
 
@@ -961,6 +1004,46 @@ bool is_dds_file(byte *headerBuffer, size_t size)
   return memcmp(headerBuffer, &dds_fourcc, 4) == 0;
 }
 
+// ASTC formats aren't representable as a ResourceFormat without their footprint, so they're
+// decoded to RGBA8 on load. Returns false for anything that isn't a non-typeless ASTC format.
+static bool GetDXGIASTCFootprint(DXGI_FORMAT format, uint32_t &blockWidth, uint32_t &blockHeight,
+                                 bool &srgb)
+{
+  static const struct
+  {
+    DXGI_FORMAT unorm, srgb;
+    uint32_t blockWidth, blockHeight;
+  } astcFormats[] = {
+      {DXGI_FORMAT_ASTC_4X4_UNORM, DXGI_FORMAT_ASTC_4X4_UNORM_SRGB, 4, 4},
+      {DXGI_FORMAT_ASTC_5X4_UNORM, DXGI_FORMAT_ASTC_5X4_UNORM_SRGB, 5, 4},
+      {DXGI_FORMAT_ASTC_5X5_UNORM, DXGI_FORMAT_ASTC_5X5_UNORM_SRGB, 5, 5},
+      {DXGI_FORMAT_ASTC_6X5_UNORM, DXGI_FORMAT_ASTC_6X5_UNORM_SRGB, 6, 5},
+      {DXGI_FORMAT_ASTC_6X6_UNORM, DXGI_FORMAT_ASTC_6X6_UNORM_SRGB, 6, 6},
+      {DXGI_FORMAT_ASTC_8X5_UNORM, DXGI_FORMAT_ASTC_8X5_UNORM_SRGB, 8, 5},
+      {DXGI_FORMAT_ASTC_8X6_UNORM, DXGI_FORMAT_ASTC_8X6_UNORM_SRGB, 8, 6},
+      {DXGI_FORMAT_ASTC_8X8_UNORM, DXGI_FORMAT_ASTC_8X8_UNORM_SRGB, 8, 8},
+      {DXGI_FORMAT_ASTC_10X5_UNORM, DXGI_FORMAT_ASTC_10X5_UNORM_SRGB, 10, 5},
+      {DXGI_FORMAT_ASTC_10X6_UNORM, DXGI_FORMAT_ASTC_10X6_UNORM_SRGB, 10, 6},
+      {DXGI_FORMAT_ASTC_10X8_UNORM, DXGI_FORMAT_ASTC_10X8_UNORM_SRGB, 10, 8},
+      {DXGI_FORMAT_ASTC_10X10_UNORM, DXGI_FORMAT_ASTC_10X10_UNORM_SRGB, 10, 10},
+      {DXGI_FORMAT_ASTC_12X10_UNORM, DXGI_FORMAT_ASTC_12X10_UNORM_SRGB, 12, 10},
+      {DXGI_FORMAT_ASTC_12X12_UNORM, DXGI_FORMAT_ASTC_12X12_UNORM_SRGB, 12, 12},
+  };
+
+  for(const auto &f : astcFormats)
+  {
+    if(format == f.unorm || format == f.srgb)
+    {
+      blockWidth = f.blockWidth;
+      blockHeight = f.blockHeight;
+      srgb = (format == f.srgb);
+      return true;
+    }
+  }
+
+  return false;
+}
+
 RDResult load_dds_from_file(StreamReader *reader, read_dds_data &ret)
 {
   uint64_t fileSize = reader->GetSize();
@@ -1012,7 +1095,19 @@ RDResult load_dds_from_file(StreamReader *reader, read_dds_data &ret)
 
   bool bgrSwap = false;
 
-  if(dx10Header)
+  uint32_t astcBlockWidth = 0, astcBlockHeight = 0;
+  bool astcSRGB = false;
+
+  if(dx10Header && GetDXGIASTCFootprint(headerDXT10.dxgiFormat, astcBlockWidth, astcBlockHeight,
+                                        astcSRGB))
+  {
+    // the ASTC format is only kept to decode with, the data is returned as RGBA8
+    ret.format.type = ResourceFormatType::ASTC;
+    ret.format.compCount = 4;
+    ret.format.compByteWidth = 1;
+    ret.format.compType = astcSRGB ? CompType::UNormSRGB : CompType::UNorm;
+  }
+  else if(dx10Header)
   {
     ret.format = DXGIFormat2ResourceFormat(headerDXT10.dxgiFormat);
     if(ret.format.type == ResourceFormatType::Undefined)
@@ -1195,9 +1290,10 @@ RDResult load_dds_from_file(StreamReader *reader, read_dds_data &ret)
       case ResourceFormatType::BC5:
       case ResourceFormatType::BC6:
       case ResourceFormatType::BC7: blockFormat = true; break;
+      // decoded as it's read below
+      case ResourceFormatType::ASTC: break;
       case ResourceFormatType::ETC2:
       case ResourceFormatType::EAC:
-      case ResourceFormatType::ASTC:
       {
         RETURN_ERROR_RESULT(ResultCode::ImageUnsupported,
                             "Unsupported file format %s to load from DDS",
@@ -1271,6 +1367,26 @@ RDResult load_dds_from_file(StreamReader *reader, read_dds_data &ret)
 
       byte *bytedata = ret.buffer.data() + subOffs;
 
+      if(astcBlockWidth != 0)
+      {
+        const size_t astcSize = GetASTCSliceSize(astcBlockWidth, astcBlockHeight, rowlen, numRows);
+        bytebuf astc;
+        astc.resize(astcSize);
+
+        for(uint32_t d = 0; d < numdepths; d++)
+        {
+          reader->Read(astc.data(), astcSize);
+
+          DecodeASTC(ret.format, astcBlockWidth, astcBlockHeight, rowlen, numRows, astc.data(),
+                     astcSize, bytedata, false);
+
+          bytedata += numRows * pitch;
+        }
+
+        i++;
+        continue;
+      }
+
       for(uint32_t d = 0; d < numdepths; d++)
       {
         for(uint32_t row = 0; row < numRows; row++)
@@ -1307,5 +1423,9 @@ RDResult load_dds_from_file(StreamReader *reader, read_dds_data &ret)
     }
   }
 
+  if(astcBlockWidth != 0)
+    ret.format = DXGIFormat2ResourceFormat(astcSRGB ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB
+                                                    : DXGI_FORMAT_R8G8B8A8_UNORM);
+
   return RDResult();
 }
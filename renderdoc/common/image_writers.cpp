@@ -0,0 +1,648 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "image_writers.h"
+#include <limits.h>
+#include <stdlib.h>
+#include "common/common.h"
+#include "common/formatting.h"
+#include "common/result.h"
+#include "common/threading.h"
+#include "jpeg-compressor/jpge.h"
+#include "maths/half_convert.h"
+#include "miniz/miniz.h"
+#include "os/os_specific.h"
+
+// rows are handed out to worker threads in small groups, and generated a band at a time when
+// streaming so that only two bands are ever resident.
+static const uint32_t rowsPerJob = 8;
+static const uint32_t rowsPerBand = 64;
+
+// below this many bytes it's not worth spinning up threads
+static const size_t minThreadedImageSize = 256 * 1024;
+
+static void ProcessRows(Threading::JobQueue *jobs, uint32_t firstRow, uint32_t numRows,
+                        const std::function<void(uint32_t y)> &func)
+{
+  for(uint32_t r = 0; r < numRows; r += rowsPerJob)
+  {
+    const uint32_t begin = firstRow + r;
+    const uint32_t end = firstRow + RDCMIN(r + rowsPerJob, numRows);
+
+    if(jobs)
+    {
+      jobs->Push([&func, begin, end]() {
+        for(uint32_t y = begin; y < end; y++)
+          func(y);
+      });
+    }
+    else
+    {
+      for(uint32_t y = begin; y < end; y++)
+        func(y);
+    }
+  }
+}
+
+void process_image_rows(uint32_t height, size_t rowSize,
+                        const std::function<void(uint32_t y)> &func)
+{
+  if(height <= rowsPerJob || rowSize * height < minThreadedImageSize)
+  {
+    ProcessRows(NULL, 0, height, func);
+    return;
+  }
+
+  Threading::JobQueue jobs;
+  ProcessRows(&jobs, 0, height, func);
+  jobs.Wait();
+}
+
+void generate_image_rows(uint32_t height, size_t rowSize, byte *dst, const ImageRowGenerator &rows)
+{
+  process_image_rows(height, rowSize, [&rows, rowSize, dst](uint32_t y) {
+    rows(y, dst + rowSize * y);
+  });
+}
+
+// generate the image band by band and pass each band in order to encode. The next band is
+// generated on worker threads while encode runs on the calling thread. Returns false as soon as
+// encode does.
+typedef std::function<bool(uint32_t y, uint32_t numRows, const byte *band)> ImageBandEncoder;
+
+static bool StreamImageRows(uint32_t height, size_t rowSize, const ImageRowGenerator &rows,
+                            const ImageBandEncoder &encode)
+{
+  const bool threaded = height > rowsPerJob && rowSize * height >= minThreadedImageSize;
+
+  Threading::JobQueue jobs;
+
+  bytebuf bands[2];
+  bands[0].resize(rowSize * RDCMIN(height, rowsPerBand));
+  bands[1].resize(bands[0].size());
+
+  // jobs reference the row function, so it must stay alive until they've been waited on
+  std::function<void(uint32_t)> bandRows = [&rows, rowSize, &bands](uint32_t row) {
+    rows(row, bands[0].data() + rowSize * row);
+  };
+  ProcessRows(threaded ? &jobs : NULL, 0, RDCMIN(rowsPerBand, height), bandRows);
+  jobs.Wait();
+
+  bool success = true;
+
+  for(uint32_t y = 0, cur = 0; y < height && success; y += rowsPerBand, cur ^= 1)
+  {
+    const uint32_t next = y + rowsPerBand;
+
+    if(next < height)
+    {
+      byte *dst = bands[cur ^ 1].data();
+      bandRows = [&rows, rowSize, dst, next](uint32_t row) {
+        rows(row, dst + rowSize * (row - next));
+      };
+      ProcessRows(threaded ? &jobs : NULL, next, RDCMIN(rowsPerBand, height - next), bandRows);
+    }
+
+    success = encode(y, RDCMIN(rowsPerBand, height - y), bands[cur].data());
+
+    jobs.Wait();
+  }
+
+  return success;
+}
+
+static bool WriteBytes(FILE *f, const void *data, size_t size)
+{
+  return FileIO::fwrite(data, 1, size, f) == size;
+}
+
+static void AppendBE32(bytebuf &buf, uint32_t val)
+{
+  byte bytes[4] = {byte(val >> 24), byte(val >> 16), byte(val >> 8), byte(val)};
+  buf.append(bytes, 4);
+}
+
+template <typename T>
+static void AppendLE(bytebuf &buf, T val)
+{
+  // all supported platforms are little endian
+  buf.append((const byte *)&val, sizeof(T));
+}
+
+static bool WritePNGChunk(FILE *f, const char *type, const byte *data, size_t size)
+{
+  bytebuf header;
+  AppendBE32(header, (uint32_t)size);
+  header.append((const byte *)type, 4);
+
+  mz_ulong crc = mz_crc32(MZ_CRC32_INIT, (const byte *)type, 4);
+  crc = mz_crc32(crc, data, size);
+
+  bytebuf footer;
+  AppendBE32(footer, (uint32_t)crc);
+
+  return WriteBytes(f, header.data(), header.size()) && WriteBytes(f, data, size) &&
+         WriteBytes(f, footer.data(), footer.size());
+}
+
+namespace
+{
+// collects deflate output and writes it out as IDAT chunks once enough has built up
+struct PNGDataStream
+{
+  static const size_t chunkSize = 256 * 1024;
+
+  FILE *f = NULL;
+  bytebuf pending;
+  bool success = true;
+
+  bool Flush()
+  {
+    if(!pending.empty())
+      success = success && WritePNGChunk(f, "IDAT", pending.data(), pending.size());
+    pending.clear();
+    return success;
+  }
+
+  static mz_bool PutBuf(const void *buf, int len, void *user)
+  {
+    PNGDataStream *stream = (PNGDataStream *)user;
+    stream->pending.append((const byte *)buf, len);
+    if(stream->pending.size() >= chunkSize)
+      stream->Flush();
+    return stream->success ? MZ_TRUE : MZ_FALSE;
+  }
+};
+
+struct JPGFileStream : public jpge::output_stream
+{
+  FILE *f = NULL;
+
+  bool put_buf(const void *buf, int len) override { return WriteBytes(f, buf, len); }
+};
+};
+
+static byte PNGPaeth(int a, int b, int c)
+{
+  int p = a + b - c;
+  int pa = abs(p - a);
+  int pb = abs(p - b);
+  int pc = abs(p - c);
+  if(pa <= pb && pa <= pc)
+    return byte(a);
+  if(pb <= pc)
+    return byte(b);
+  return byte(c);
+}
+
+// apply all five PNG filters to row and write the one with the smallest sum of absolute signed
+// residuals, the usual heuristic, to out with its filter type byte in front.
+static void FilterPNGRow(const byte *row, const byte *prev, uint32_t rowSize, uint32_t bpp,
+                         bytebuf &scratch, byte *out)
+{
+  int bestSum = INT_MAX;
+
+  for(byte filter = 0; filter < 5; filter++)
+  {
+    byte *dst = scratch.data();
+    int sum = 0;
+
+    for(uint32_t i = 0; i < rowSize; i++)
+    {
+      const int x = row[i];
+      const int a = i >= bpp ? row[i - bpp] : 0;
+      const int b = prev[i];
+      const int c = i >= bpp ? prev[i - bpp] : 0;
+
+      byte v = 0;
+      switch(filter)
+      {
+        case 0: v = byte(x); break;
+        case 1: v = byte(x - a); break;
+        case 2: v = byte(x - b); break;
+        case 3: v = byte(x - ((a + b) >> 1)); break;
+        case 4: v = byte(x - PNGPaeth(a, b, c)); break;
+      }
+
+      dst[i] = v;
+      sum += abs(int(int8_t(v)));
+    }
+
+    if(sum < bestSum)
+    {
+      bestSum = sum;
+      out[0] = filter;
+      memcpy(out + 1, dst, rowSize);
+    }
+  }
+}
+
+RDResult write_png_to_file(FILE *f, uint32_t width, uint32_t height, uint32_t numComps,
+                           const ImageRowGenerator &rows)
+{
+  if(width == 0 || height == 0 || numComps == 0 || numComps > 4)
+    RETURN_ERROR_RESULT(ResultCode::InvalidParameter, "Can't write %ux%u PNG with %u components",
+                        width, height, numComps);
+
+  const uint32_t rowSize = width * numComps;
+
+  // grey, grey+alpha, RGB, RGBA
+  const byte colourTypes[] = {0, 4, 2, 6};
+
+  const byte signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+  bytebuf ihdr;
+  AppendBE32(ihdr, width);
+  AppendBE32(ihdr, height);
+  ihdr.push_back(8);
+  ihdr.push_back(colourTypes[numComps - 1]);
+  ihdr.push_back(0);
+  ihdr.push_back(0);
+  ihdr.push_back(0);
+
+  if(!WriteBytes(f, signature, sizeof(signature)) ||
+     !WritePNGChunk(f, "IHDR", ihdr.data(), ihdr.size()))
+    RETURN_ERROR_RESULT(ResultCode::FileIOFailed, "Failed to write PNG header");
+
+  PNGDataStream stream;
+  stream.f = f;
+
+  tdefl_compressor *comp = tdefl_compressor_alloc();
+  tdefl_init(comp, &PNGDataStream::PutBuf, &stream,
+             tdefl_create_comp_flags_from_zip_params(MZ_DEFAULT_LEVEL, MZ_DEFAULT_WINDOW_BITS,
+                                                     MZ_DEFAULT_STRATEGY));
+
+  // the first row is filtered against an implicit row of zeroes
+  bytebuf prev, scratch, filtered;
+  prev.resize(rowSize);
+  scratch.resize(rowSize);
+  filtered.resize(rowSize + 1);
+
+  bool success = StreamImageRows(
+      height, rowSize, rows, [&](uint32_t, uint32_t numRows, const byte *band) {
+        for(uint32_t r = 0; r < numRows; r++)
+        {
+          const byte *row = band + size_t(rowSize) * r;
+
+          FilterPNGRow(row, prev.data(), rowSize, numComps, scratch, filtered.data());
+          memcpy(prev.data(), row, rowSize);
+
+          if(tdefl_compress_buffer(comp, filtered.data(), filtered.size(), TDEFL_NO_FLUSH) !=
+             TDEFL_STATUS_OKAY)
+            return false;
+        }
+
+        return true;
+      });
+
+  success = success && tdefl_compress_buffer(comp, NULL, 0, TDEFL_FINISH) == TDEFL_STATUS_DONE;
+
+  tdefl_compressor_free(comp);
+
+  success = success && stream.Flush() && WritePNGChunk(f, "IEND", NULL, 0);
+
+  if(!success)
+    RETURN_ERROR_RESULT(ResultCode::FileIOFailed, "Failed to write PNG image data");
+
+  return RDResult();
+}
+
+RDResult write_jpg_to_file(FILE *f, uint32_t width, uint32_t height, uint32_t numComps,
+                           int quality, const ImageRowGenerator &rows)
+{
+  jpge::params p;
+  p.m_quality = quality;
+
+  JPGFileStream stream;
+  stream.f = f;
+
+  jpge::jpeg_encoder encoder;
+  if(!encoder.init(&stream, width, height, numComps, p))
+    RETURN_ERROR_RESULT(ResultCode::InternalError, "Failed to initialise JPG encoder");
+
+  for(uint32_t pass = 0; pass < encoder.get_total_passes(); pass++)
+  {
+    bool success = StreamImageRows(
+        height, width * numComps, rows, [&](uint32_t, uint32_t numRows, const byte *band) {
+          for(uint32_t r = 0; r < numRows; r++)
+            if(!encoder.process_scanline(band + size_t(width) * numComps * r))
+              return false;
+          return true;
+        });
+
+    if(!success || !encoder.process_scanline(NULL))
+      RETURN_ERROR_RESULT(ResultCode::FileIOFailed, "Failed to write JPG image data");
+  }
+
+  return RDResult();
+}
+
+static void AddEXRAttribute(bytebuf &header, const char *name, const char *type,
+                            const bytebuf &value)
+{
+  header.append((const byte *)name, strlen(name) + 1);
+  header.append((const byte *)type, strlen(type) + 1);
+  AppendLE<uint32_t>(header, (uint32_t)value.size());
+  header.append(value);
+}
+
+RDResult write_exr_to_file(FILE *f, uint32_t width, uint32_t height, bool halfChannels,
+                           const ImageRowGenerator &rows)
+{
+  if(width == 0 || height == 0)
+    RETURN_ERROR_RESULT(ResultCode::InvalidParameter, "Can't write %ux%u EXR", width, height);
+
+  // channels must be listed alphabetically, which conveniently is also the ABGR order many viewers
+  // assume without looking at the names.
+  const char *channelNames[] = {"A", "B", "G", "R"};
+  const uint32_t channelSource[] = {3, 2, 1, 0};
+  const uint32_t compSize = halfChannels ? sizeof(uint16_t) : sizeof(float);
+
+  bytebuf header;
+  // magic number, then version 2 single-part scanline
+  AppendLE<uint32_t>(header, 20000630);
+  AppendLE<uint32_t>(header, 2);
+
+  bytebuf value;
+  for(const char *name : channelNames)
+  {
+    value.append((const byte *)name, strlen(name) + 1);
+    AppendLE<int32_t>(value, halfChannels ? 1 : 2);    // pixel type
+    AppendLE<uint32_t>(value, 0);                      // pLinear and reserved
+    AppendLE<int32_t>(value, 1);                       // x sampling
+    AppendLE<int32_t>(value, 1);                       // y sampling
+  }
+  value.push_back(0);
+  AddEXRAttribute(header, "channels", "chlist", value);
+
+  // no compression, so each scanline is its own block
+  value.clear();
+  value.push_back(0);
+  AddEXRAttribute(header, "compression", "compression", value);
+
+  value.clear();
+  AppendLE<int32_t>(value, 0);
+  AppendLE<int32_t>(value, 0);
+  AppendLE<int32_t>(value, int32_t(width - 1));
+  AppendLE<int32_t>(value, int32_t(height - 1));
+  AddEXRAttribute(header, "dataWindow", "box2i", value);
+  AddEXRAttribute(header, "displayWindow", "box2i", value);
+
+  // increasing Y
+  value.clear();
+  value.push_back(0);
+  AddEXRAttribute(header, "lineOrder", "lineOrder", value);
+
+  value.clear();
+  AppendLE<float>(value, 1.0f);
+  AddEXRAttribute(header, "pixelAspectRatio", "float", value);
+  AddEXRAttribute(header, "screenWindowWidth", "float", value);
+
+  value.clear();
+  AppendLE<float>(value, 0.0f);
+  AppendLE<float>(value, 0.0f);
+  AddEXRAttribute(header, "screenWindowCenter", "v2f", value);
+
+  header.push_back(0);
+
+  // every block is the same size, so the offset table can be written up front
+  const uint32_t blockDataSize = width * 4 * compSize;
+  const uint64_t blockSize = sizeof(int32_t) * 2 + blockDataSize;
+  const uint64_t firstBlock = header.size() + sizeof(uint64_t) * height;
+
+  for(uint32_t y = 0; y < height; y++)
+    AppendLE<uint64_t>(header, firstBlock + blockSize * y);
+
+  if(!WriteBytes(f, header.data(), header.size()))
+    RETURN_ERROR_RESULT(ResultCode::FileIOFailed, "Failed to write EXR header");
+
+  bytebuf block;
+  block.resize((size_t)blockSize);
+
+  const size_t rowSize = width * sizeof(FloatVector);
+
+  bool success = StreamImageRows(
+      height, rowSize, rows, [&](uint32_t y, uint32_t numRows, const byte *band) {
+        for(uint32_t r = 0; r < numRows; r++)
+        {
+          const FloatVector *pixels = (const FloatVector *)band + size_t(width) * r;
+
+          int32_t blockHeader[2] = {int32_t(y + r), int32_t(blockDataSize)};
+          memcpy(block.data(), blockHeader, sizeof(blockHeader));
+
+          byte *dst = block.data() + sizeof(blockHeader);
+          for(uint32_t c = 0; c < 4; c++)
+          {
+            const uint32_t src = channelSource[c];
+            if(halfChannels)
+            {
+              uint16_t *out = (uint16_t *)dst;
+              for(uint32_t x = 0; x < width; x++)
+                out[x] = ConvertToHalf((&pixels[x].x)[src]);
+            }
+            else
+            {
+              float *out = (float *)dst;
+              for(uint32_t x = 0; x < width; x++)
+                out[x] = (&pixels[x].x)[src];
+            }
+            dst += width * compSize;
+          }
+
+          if(!WriteBytes(f, block.data(), block.size()))
+            return false;
+        }
+
+        return true;
+      });
+
+  if(!success)
+    RETURN_ERROR_RESULT(ResultCode::FileIOFailed, "Failed to write EXR image data");
+
+  return RDResult();
+}
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+#include "stb/stb_image.h"
+#include "tinyexr/tinyexr.h"
+
+TEST_CASE("Streaming image writers", "[imagewriters]")
+{
+  // big enough to span several bands and be generated on worker threads
+  const uint32_t width = 601, height = 333;
+
+  rdcstr path = FileIO::GetTempFolderFilename() + "rdoc_imagewriters_test";
+
+  SECTION("PNG")
+  {
+    for(uint32_t comps = 1; comps <= 4; comps++)
+    {
+      FILE *f = FileIO::fopen(path, FileIO::WriteBinary);
+      REQUIRE(f);
+
+      RDResult res = write_png_to_file(f, width, height, comps, [comps](uint32_t y, byte *row) {
+        for(uint32_t x = 0; x < width; x++)
+          for(uint32_t c = 0; c < comps; c++)
+            row[x * comps + c] = byte(x * (c + 1) + y * 7 + ((x * y) >> 5));
+      });
+      FileIO::fclose(f);
+
+      CHECK(res.code == ResultCode::Succeeded);
+
+      bytebuf encoded;
+      REQUIRE(FileIO::ReadAll(path, encoded));
+
+      int w = 0, h = 0, n = 0;
+      byte *decoded = stbi_load_from_memory(encoded.data(), (int)encoded.size(), &w, &h, &n, 0);
+      REQUIRE(decoded);
+      CHECK(w == (int)width);
+      CHECK(h == (int)height);
+      CHECK(n == (int)comps);
+
+      uint32_t mismatches = 0;
+      for(uint32_t y = 0; y < height; y++)
+        for(uint32_t x = 0; x < width; x++)
+          for(uint32_t c = 0; c < comps; c++)
+            if(decoded[(y * width + x) * comps + c] != byte(x * (c + 1) + y * 7 + ((x * y) >> 5)))
+              mismatches++;
+      CHECK(mismatches == 0);
+
+      stbi_image_free(decoded);
+    }
+  }
+
+  SECTION("JPG")
+  {
+    FILE *f = FileIO::fopen(path, FileIO::WriteBinary);
+    REQUIRE(f);
+
+    RDResult res = write_jpg_to_file(f, width, height, 3, 95, [](uint32_t y, byte *row) {
+      for(uint32_t x = 0; x < width; x++)
+      {
+        row[x * 3 + 0] = byte(x / 3);
+        row[x * 3 + 1] = byte(y / 2);
+        row[x * 3 + 2] = 128;
+      }
+    });
+    FileIO::fclose(f);
+
+    CHECK(res.code == ResultCode::Succeeded);
+
+    bytebuf encoded;
+    REQUIRE(FileIO::ReadAll(path, encoded));
+
+    int w = 0, h = 0, n = 0;
+    byte *decoded = stbi_load_from_memory(encoded.data(), (int)encoded.size(), &w, &h, &n, 3);
+    REQUIRE(decoded);
+    CHECK(w == (int)width);
+    CHECK(h == (int)height);
+
+    // lossy, so only check it's close on a smooth gradient
+    int maxError = 0;
+    for(uint32_t y = 0; y < height; y++)
+    {
+      for(uint32_t x = 0; x < width; x++)
+      {
+        const byte *pix = decoded + (y * width + x) * 3;
+        maxError = RDCMAX(maxError, abs(int(pix[0]) - int(x / 3)));
+        maxError = RDCMAX(maxError, abs(int(pix[1]) - int(y / 2)));
+        maxError = RDCMAX(maxError, abs(int(pix[2]) - 128));
+      }
+    }
+    CHECK(maxError <= 8);
+
+    stbi_image_free(decoded);
+  }
+
+  SECTION("EXR")
+  {
+    for(bool half : {false, true})
+    {
+      FILE *f = FileIO::fopen(path, FileIO::WriteBinary);
+      REQUIRE(f);
+
+      // values that are exactly representable as halfs
+      RDResult res = write_exr_to_file(f, width, height, half, [](uint32_t y, byte *row) {
+        FloatVector *pixels = (FloatVector *)row;
+        for(uint32_t x = 0; x < width; x++)
+          pixels[x] = FloatVector(float(x) * 0.25f, float(y) * 0.5f, -float(x % 7), 0.125f);
+      });
+      FileIO::fclose(f);
+
+      CHECK(res.code == ResultCode::Succeeded);
+
+      bytebuf encoded;
+      REQUIRE(FileIO::ReadAll(path, encoded));
+
+      float *rgba = NULL;
+      int w = 0, h = 0;
+      const char *err = NULL;
+      int ret = LoadEXRFromMemory(&rgba, &w, &h, encoded.data(), encoded.size(), &err);
+      REQUIRE(ret == TINYEXR_SUCCESS);
+      CHECK(w == (int)width);
+      CHECK(h == (int)height);
+
+      uint32_t mismatches = 0;
+      for(uint32_t y = 0; y < height; y++)
+      {
+        for(uint32_t x = 0; x < width; x++)
+        {
+          const float *pix = rgba + (y * width + x) * 4;
+          if(pix[0] != float(x) * 0.25f || pix[1] != float(y) * 0.5f ||
+             pix[2] != -float(x % 7) || pix[3] != 0.125f)
+            mismatches++;
+        }
+      }
+      CHECK(mismatches == 0);
+
+      free(rgba);
+    }
+  }
+
+  FileIO::Delete(path);
+}
+
+TEST_CASE("Parallel image row generation", "[imagewriters]")
+{
+  const uint32_t width = 1000, height = 777;
+
+  bytebuf data;
+  data.resize(width * height * 4);
+
+  generate_image_rows(height, width * 4, data.data(), [](uint32_t y, byte *row) {
+    for(uint32_t x = 0; x < width * 4; x++)
+      row[x] = byte(x ^ y);
+  });
+
+  uint32_t mismatches = 0;
+  for(uint32_t y = 0; y < height; y++)
+    for(uint32_t x = 0; x < width * 4; x++)
+      if(data[y * width * 4 + x] != byte(x ^ y))
+        mismatches++;
+  CHECK(mismatches == 0);
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
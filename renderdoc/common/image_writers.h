@@ -0,0 +1,59 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+#include <functional>
+#include "api/replay/data_types.h"
+#include "common/result.h"
+
+// produces row y of an image into a tightly packed buffer. This is called concurrently for
+// different rows, so it must only depend on the source data and not on any other generated row.
+typedef std::function<void(uint32_t y, byte *row)> ImageRowGenerator;
+
+// call func for every row in [0, height), spread across worker threads when the image is large
+// enough to be worth it. Returns once every row has been processed.
+extern void process_image_rows(uint32_t height, size_t rowSize,
+                               const std::function<void(uint32_t y)> &func);
+
+// generate a whole image into dst, which must be height * rowSize bytes.
+extern void generate_image_rows(uint32_t height, size_t rowSize, byte *dst,
+                                const ImageRowGenerator &rows);
+
+// Streaming encoders. Rows are generated in bands on worker threads while the previous band is
+// encoded and written to the file, so neither the whole source image nor the whole encoded image
+// is ever held in memory.
+
+// rows are 8-bit with numComps in [1, 4] as for stbi_write_png
+extern RDResult write_png_to_file(FILE *f, uint32_t width, uint32_t height, uint32_t numComps,
+                                  const ImageRowGenerator &rows);
+
+// rows are 8-bit with numComps of 1, 3 or 4 (alpha is ignored)
+extern RDResult write_jpg_to_file(FILE *f, uint32_t width, uint32_t height, uint32_t numComps,
+                                  int quality, const ImageRowGenerator &rows);
+
+// rows are RGBA32 float, written as an uncompressed scanline EXR with half or float channels
+extern RDResult write_exr_to_file(FILE *f, uint32_t width, uint32_t height, bool halfChannels,
+                                  const ImageRowGenerator &rows);
@@ -0,0 +1,164 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "threading.h"
+
+namespace Threading
+{
+JobQueue::JobQueue(uint32_t maxThreads)
+{
+  m_MaxThreads = maxThreads == 0 ? GetNumberOfCores() : maxThreads;
+  if(m_MaxThreads == 0)
+    m_MaxThreads = 1;
+}
+
+JobQueue::~JobQueue()
+{
+  Wait();
+}
+
+void JobQueue::Push(std::function<void()> job)
+{
+  SCOPED_LOCK(m_Lock);
+
+  m_Jobs.push_back(job);
+
+  // workers exit whenever the queue drains, so join any that have finished since the last push
+  // rather than letting their handles pile up until Wait()
+  ReapExitedWorkers();
+
+  // spin up another worker if we're below the limit. Workers only decide to exit while holding the
+  // lock and seeing an empty queue, so there's no window where this job could be left unprocessed.
+  if(m_Workers.size() < m_MaxThreads)
+  {
+    Worker *worker = new Worker;
+    m_Workers.push_back(worker);
+    worker->thread = CreateThread([this, worker]() { WorkerThread(worker); });
+  }
+}
+
+size_t JobQueue::GetWorkerCount()
+{
+  SCOPED_LOCK(m_Lock);
+  return m_Workers.size();
+}
+
+void JobQueue::ReapExitedWorkers()
+{
+  // parent must hold m_Lock
+  for(size_t i = 0; i < m_Workers.size();)
+  {
+    Worker *worker = m_Workers[i];
+
+    if(!worker->exited)
+    {
+      i++;
+      continue;
+    }
+
+    // the worker set this under the lock as the last thing it does, so this won't wait long
+    JoinThread(worker->thread);
+    CloseThread(worker->thread);
+    delete worker;
+    m_Workers.erase(i);
+  }
+}
+
+bool JobQueue::PopJob(std::function<void()> &job)
+{
+  // parent must hold m_Lock
+  if(m_NextJob >= m_Jobs.size())
+  {
+    // reset the queue once it's drained so it doesn't grow unbounded
+    m_Jobs.clear();
+    m_NextJob = 0;
+    return false;
+  }
+
+  job = std::move(m_Jobs[m_NextJob]);
+  m_Jobs[m_NextJob] = std::function<void()>();
+  m_NextJob++;
+  return true;
+}
+
+void JobQueue::WorkerThread(Worker *worker)
+{
+  std::function<void()> job;
+
+  for(;;)
+  {
+    {
+      SCOPED_LOCK(m_Lock);
+
+      if(!PopJob(job))
+      {
+        worker->exited = true;
+        return;
+      }
+    }
+
+    job();
+  }
+}
+
+void JobQueue::Wait()
+{
+  std::function<void()> job;
+
+  // jobs can push more jobs, so keep going until there are no workers left and the queue is empty.
+  // Each pass joins every worker that existed at the start of it, and a worker only exits once the
+  // queue is empty, so anything pushed in the meantime is either run or seen on the next pass.
+  for(;;)
+  {
+    // help out on this thread rather than sitting idle
+    for(;;)
+    {
+      {
+        SCOPED_LOCK(m_Lock);
+        if(!PopJob(job))
+          break;
+      }
+
+      job();
+    }
+
+    rdcarray<Worker *> workers;
+    {
+      SCOPED_LOCK(m_Lock);
+
+      if(m_Workers.empty() && m_NextJob >= m_Jobs.size())
+        return;
+
+      workers.swap(m_Workers);
+    }
+
+    for(Worker *worker : workers)
+    {
+      JoinThread(worker->thread);
+      CloseThread(worker->thread);
+      delete worker;
+    }
+  }
+}
+};
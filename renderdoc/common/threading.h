@@ -25,6 +25,7 @@
 
 #pragma once
 
+#include <functional>
 #include "common/common.h"
 #include "os/os_specific.h"
 
@@ -110,6 +111,50 @@ public:
 private:
   SpinLock *m_Spin = NULL;
 };
+
+// A simple pool of worker threads that independent jobs can be fanned out onto. Workers are only
+// spawned when there is work to do, up to the thread limit, and exit as soon as the queue drains
+// so an idle queue costs nothing. Jobs are started in the order they were pushed but may complete
+// in any order.
+class JobQueue
+{
+public:
+  // a maxThreads of 0 uses one thread per core
+  JobQueue(uint32_t maxThreads = 0);
+  ~JobQueue();
+
+  // no copying
+  JobQueue(const JobQueue &) = delete;
+  JobQueue &operator=(const JobQueue &) = delete;
+
+  uint32_t GetMaxThreads() const { return m_MaxThreads; }
+  // the number of worker threads that haven't been joined yet
+  size_t GetWorkerCount();
+  void Push(std::function<void()> job);
+
+  // process any outstanding jobs on the calling thread, then wait for all workers to finish. After
+  // this returns every job pushed so far has completed.
+  void Wait();
+
+private:
+  struct Worker
+  {
+    ThreadHandle thread = 0;
+    // set under m_Lock when the worker has found the queue empty and is about to return
+    bool exited = false;
+  };
+
+  bool PopJob(std::function<void()> &job);
+  void ReapExitedWorkers();
+  void WorkerThread(Worker *worker);
+
+  CriticalSection m_Lock;
+  rdcarray<std::function<void()>> m_Jobs;
+  size_t m_NextJob = 0;
+  // workers which haven't been joined yet, including any that have exited
+  rdcarray<Worker *> m_Workers;
+  uint32_t m_MaxThreads = 1;
+};
 };
 
 #define SCOPED_LOCK(cs) Threading::ScopedLock CONCAT(scopedlock, __LINE__)(&cs);
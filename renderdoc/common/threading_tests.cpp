@@ -71,4 +71,106 @@ TEST_CASE("Test spin lock", "[threading]")
   CHECK(finalValue == value);
 }
 
+TEST_CASE("Test job queue", "[threading]")
+{
+  SECTION("All jobs run exactly once")
+  {
+    rdcarray<int32_t> counts;
+    counts.resize(1000);
+
+    Threading::JobQueue queue(4);
+
+    for(size_t i = 0; i < counts.size(); i++)
+      queue.Push([&counts, i]() { Atomic::Inc32(&counts[i]); });
+
+    queue.Wait();
+
+    for(size_t i = 0; i < counts.size(); i++)
+      CHECK(counts[i] == 1);
+  };
+
+  SECTION("Queue can be reused after waiting")
+  {
+    int32_t total = 0;
+
+    Threading::JobQueue queue(2);
+
+    for(int pass = 0; pass < 4; pass++)
+    {
+      for(int i = 0; i < 50; i++)
+        queue.Push([&total]() { Atomic::Inc32(&total); });
+
+      queue.Wait();
+
+      CHECK(total == (pass + 1) * 50);
+    }
+  };
+
+  SECTION("Jobs can push more jobs")
+  {
+    int32_t total = 0;
+
+    Threading::JobQueue queue(3);
+
+    for(int i = 0; i < 10; i++)
+    {
+      queue.Push([&queue, &total]() {
+        Atomic::Inc32(&total);
+        for(int j = 0; j < 10; j++)
+          queue.Push([&total]() { Atomic::Inc32(&total); });
+      });
+    }
+
+    queue.Wait();
+
+    CHECK(total == 110);
+  };
+
+  SECTION("Jobs pushed while waiting on a running job are finished")
+  {
+    int32_t total = 0;
+
+    Threading::JobQueue queue(2);
+
+    // a chain where each job pushes the next only after the queue has drained, so the push happens
+    // while Wait() is already joining workers
+    std::function<void(int)> chain = [&queue, &total, &chain](int remaining) {
+      Threading::Sleep(2);
+      Atomic::Inc32(&total);
+      if(remaining > 0)
+        queue.Push([&chain, remaining]() { chain(remaining - 1); });
+    };
+
+    queue.Push([&chain]() { chain(9); });
+
+    queue.Wait();
+
+    CHECK(total == 10);
+  };
+
+  SECTION("Idle workers are joined when more work is pushed")
+  {
+    int32_t total = 0;
+
+    Threading::JobQueue queue(2);
+
+    for(int i = 0; i < 50; i++)
+    {
+      queue.Push([&total]() { Atomic::Inc32(&total); });
+
+      // let the workers drain the queue and exit before pushing again
+      while(Atomic::CmpExch32(&total, i + 1, i + 1) != i + 1)
+        Threading::Sleep(0);
+      Threading::Sleep(1);
+
+      CHECK(queue.GetWorkerCount() <= queue.GetMaxThreads());
+    }
+
+    queue.Wait();
+
+    CHECK(total == 50);
+    CHECK(queue.GetWorkerCount() == 0);
+  };
+}
+
 #endif    // ENABLED(ENABLE_UNIT_TESTS)
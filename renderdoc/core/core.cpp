@@ -54,6 +54,15 @@ RDOC_DEBUG_CONFIG(bool, Capture_Debug_SnapshotDiagnosticLog, false,
 RDOC_CONFIG(rdcarray<rdcstr>, DXBC_Debug_SearchDirPaths, {},
             "Paths to search for separated shader debug PDBs.");
 
+// shared by the backends that compare persistently mapped memory to find what changed
+RDOC_CONFIG(uint32_t, Capture_MappedDiffMergeGap, 256,
+            "When serialising changes to persistently mapped memory while capturing, changes "
+            "separated by at most this many unchanged bytes are serialised together.");
+RDOC_CONFIG(uint32_t, Capture_MappedDiffMaxRanges, 64,
+            "When serialising changes to persistently mapped memory while capturing, at most this "
+            "many separate changed ranges are serialised for each map. Any changes past that are "
+            "serialised as one range covering them all.");
+
 void LogReplayOptions(const ReplayOptions &opts)
 {
   RDCLOG("%s API validation during replay", (opts.apiValidation ? "Enabling" : "Not enabling"));
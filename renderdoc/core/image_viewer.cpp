@@ -25,6 +25,7 @@
 #include "common/dds_readwrite.h"
 #include "common/formatting.h"
 #include "core/core.h"
+#include "maths/blockdecode.h"
 #include "maths/formatpacking.h"
 #include "replay/dummy_driver.h"
 #include "replay/replay_driver.h"
@@ -265,6 +266,7 @@ public:
     return ret;
   }
   rdcarray<GPUDevice> GetAvailableGPUs() { return {}; }
+  ReplayMemoryStats GetReplayMemoryStats() { return {}; }
   void ReplayLog(uint32_t endEventID, ReplayLogType replayType) {}
   rdcarray<uint32_t> GetPassEvents(uint32_t eventId) { return rdcarray<uint32_t>(); }
   rdcarray<EventUsage> GetUsage(ResourceId id) { return rdcarray<EventUsage>(); }
@@ -987,7 +989,9 @@ void ImageViewer::CreateProxyTexture(TextureDescription &texDetails, read_dds_da
       bool convertSupported = false;
       DecodeFormattedComponents(texDetails.format, NULL, &convertSupported);
 
-      if(convertSupported)
+      const bool blockDecode = IsBlockFormatDecodeSupported(texDetails.format);
+
+      if(convertSupported || blockDecode)
       {
         uint32_t srcStride = texDetails.format.ElementSize();
 
@@ -1016,21 +1020,26 @@ void ImageViewer::CreateProxyTexture(TextureDescription &texDetails, read_dds_da
           convertedData.resize(convertedData.size() + read_data.subresources[i].second);
           byte *converted = convertedData.data() + read_data.subresources[i].first;
 
-          byte *src = old;
-          FloatVector *dst = (FloatVector *)converted;
-
-          for(uint32_t z = 0; z < mipdepth; z++)
+          if(blockDecode)
           {
-            for(uint32_t y = 0; y < mipheight; y++)
+            const size_t srcSliceSize =
+                GetBlockFormatSliceSize(texDetails.format, mipwidth, mipheight);
+            const size_t dstSliceSize = sizeof(FloatVector) * mipwidth * mipheight;
+
+            size_t srcRemaining = m_RealTexData[i].size();
+
+            for(uint32_t z = 0; z < mipdepth; z++)
             {
-              for(uint32_t x = 0; x < mipwidth; x++)
-              {
-                *dst = DecodeFormattedComponents(texDetails.format, src);
-                dst++;
-                src += srcStride;
-              }
+              DecodeBlockFormat(texDetails.format, mipwidth, mipheight, old + srcSliceSize * z,
+                                srcRemaining, converted + dstSliceSize * z, true);
+              srcRemaining -= RDCMIN(srcRemaining, srcSliceSize);
             }
           }
+          else
+          {
+            DecodeFormattedComponents(texDetails.format, old, srcStride, (FloatVector *)converted,
+                                      mipwidth * mipheight * mipdepth);
+          }
         }
 
         read_data.buffer.swap(convertedData);
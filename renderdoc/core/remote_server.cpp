@@ -29,13 +29,17 @@
 #include "api/replay/renderdoc_replay.h"
 #include "api/replay/version.h"
 #include "common/threading.h"
+#include "common/timing.h"
 #include "core/core.h"
 #include "core/settings.h"
 #include "os/os_specific.h"
 #include "replay/replay_controller.h"
+#include "serialise/adaptiveio.h"
 #include "serialise/rdcfile.h"
 #include "serialise/serialiser.h"
+#include "serialise/transferio.h"
 #include "strings/string_utils.h"
+#include "zstd/xxhash.h"
 #include "replay_proxy.h"
 
 RDOC_CONFIG(uint32_t, RemoteServer_TimeoutMS, 5000,
@@ -45,8 +49,33 @@ RDOC_CONFIG(bool, RemoteServer_DebugLogging, false,
             "Output a verbose logging file in the system's temporary folder containing the "
             "traffic to and from the remote server.");
 
+RDOC_CONFIG(bool, RemoteServer_AdaptiveCompression, true,
+            "Compress captures and replay data sent to and from the remote server, choosing the "
+            "codec and level for each block based on the measured link speed.");
+
+RDOC_CONFIG(uint32_t, RemoteServer_TransferRetries, 5,
+            "How many times to reconnect and resume a capture copy that was interrupted before "
+            "giving up.");
+
+// bumped whenever the handshake or the data sent over the connection changes within a release.
+// 1: codecs and session in the handshake, adaptive compression, proxy request IDs and pipeline
+//    state deltas.
+// It's sent in the top byte of the version rather than as its own field, so that a peer from the
+// same release without it sees a plain version mismatch instead of misreading the fields after.
+static const uint32_t RemoteServerProtocolRevision = 1;
+
 static const uint32_t RemoteServerProtocolVersion =
-    uint32_t(RENDERDOC_VERSION_MAJOR * 1000) + RENDERDOC_VERSION_MINOR;
+    (RemoteServerProtocolRevision << 24) |
+    (uint32_t(RENDERDOC_VERSION_MAJOR * 1000) + RENDERDOC_VERSION_MINOR);
+
+// the codecs we offer in the handshake, the connection uses those that both ends offer
+static uint32_t OfferedNetworkCodecs()
+{
+  if(RemoteServer_AdaptiveCompression())
+    return SupportedNetworkCodecs();
+
+  return NetworkCodecBit(NetworkCodec::None);
+}
 
 enum RemoteServerPacket
 {
@@ -80,6 +109,7 @@ enum RemoteServerPacket
   eRemoteServer_GetSectionContents,
   eRemoteServer_WriteSection,
   eRemoteServer_GetAvailableGPUs,
+  eRemoteServer_GetSessionStats,
   eRemoteServer_RemoteServerCount,
 };
 
@@ -123,6 +153,7 @@ rdcstr DoStringise(const RemoteServerPacket &el)
     STRINGISE_ENUM_NAMED(eRemoteServer_GetSectionContents, "GetSectionContents");
     STRINGISE_ENUM_NAMED(eRemoteServer_WriteSection, "WriteSection");
     STRINGISE_ENUM_NAMED(eRemoteServer_GetAvailableGPUs, "GetAvailableGPUs");
+    STRINGISE_ENUM_NAMED(eRemoteServer_GetSessionStats, "GetSessionStats");
     STRINGISE_ENUM_NAMED(eRemoteServer_RemoteServerCount, "RemoteServerCount");
   }
   END_ENUM_STRINGISE();
@@ -139,10 +170,30 @@ rdcstr GetRemoteServerChunkName(uint32_t idx)
 #define WRITE_DATA_SCOPE() WriteSerialiser &ser = writer;
 #define READ_DATA_SCOPE() ReadSerialiser &ser = reader;
 
+// where an in-progress copy to the server is kept, see RemoteServer::CopyCaptureToRemote
+static rdcstr RemoteCopyPartialPath(uint64_t transferKey)
+{
+  return FileIO::GetTempFolderFilename() +
+         StringFormat::Fmt("/RenderDoc/remotecopy_%016llx.partial", transferKey);
+}
+
+// numbers the captures copied to us, shared by all clients so their copies don't clash
+static int32_t RemoteCopyCount = 0;
+
 struct ClientThread
 {
   ClientThread()
-      : socket(NULL), allowExecution(false), killThread(false), killServer(false), thread(0)
+      : socket(NULL),
+        allowExecution(false),
+        killThread(false),
+        killServer(false),
+        networkCodecs(0),
+        session(0),
+        storageUsed(0),
+        replayRequests(0),
+        replayTime(0.0),
+        waitTime(0.0),
+        thread(0)
   {
   }
 
@@ -152,20 +203,187 @@ struct ClientThread
   bool killThread;
   bool killServer;
 
+  // the codecs negotiated in the handshake
+  uint32_t networkCodecs;
+
+  // identifies the client's session across reconnects
+  uint64_t session;
+  // files to delete when the session ends
+  rdcarray<rdcstr> tempFiles;
+  // how many bytes of tempFiles were copied to us by the client, counted against its limit
+  uint64_t storageUsed;
+
+  // statistics for eRemoteServer_GetSessionStats
+  uint64_t replayRequests;
+  double replayTime;
+  double waitTime;
+
   Threading::ThreadHandle thread;
 };
 
-struct ActiveClient
+// the limits from remoteserver.conf on how many clients are served at once and what they can use
+struct RemoteServerLimits
+{
+  // how many active connections are served at once, beyond this connections are refused as busy
+  uint32_t maxClients = 1;
+  // how many of those can have a capture open at once, beyond this clients queue to open one
+  uint32_t maxReplays = 1;
+  // how many bytes each session can copy to the server, or 0 for no limit
+  uint64_t clientStorage = 0;
+  // how many seconds of replay work each session can use, or 0 for no limit
+  uint32_t clientReplayTime = 0;
+};
+
+// A first-come first-served semaphore that lets up to count holders in at once. Waiters poll
+// rather than block, which is fine for the handful of clients that share a server.
+class FairSemaphore
+{
+public:
+  FairSemaphore(uint32_t count = 1) : m_Count(count) {}
+  void SetCount(uint32_t count) { m_Count = count; }
+  uint32_t GetHolders()
+  {
+    SCOPED_LOCK(m_Lock);
+    return m_Holders;
+  }
+  uint32_t GetWaiters()
+  {
+    SCOPED_LOCK(m_Lock);
+    return (uint32_t)m_Waiting.size();
+  }
+
+  // wait our turn, returning the number of milliseconds we waited. If cancelled returns true while
+  // we're waiting, we leave the queue and return a negative value.
+  double Acquire(const std::function<bool()> &cancelled = std::function<bool()>())
+  {
+    PerformanceTimer timer;
+
+    uint64_t ticket;
+
+    {
+      SCOPED_LOCK(m_Lock);
+      ticket = m_NextTicket++;
+
+      // uncontended, skip the queue
+      if(m_Waiting.empty() && m_Holders < m_Count)
+      {
+        m_Holders++;
+        return 0.0;
+      }
+
+      m_Waiting.push_back(ticket);
+    }
+
+    for(;;)
+    {
+      {
+        SCOPED_LOCK(m_Lock);
+        if(m_Waiting[0] == ticket && m_Holders < m_Count)
+        {
+          m_Waiting.erase(0);
+          m_Holders++;
+          return timer.GetMilliseconds();
+        }
+
+        if(cancelled && cancelled())
+        {
+          m_Waiting.removeOne(ticket);
+          return -1.0;
+        }
+      }
+
+      Threading::Sleep(1);
+    }
+  }
+
+  // take a slot only if one is free right now and nobody is queued for it
+  bool TryAcquire()
+  {
+    SCOPED_LOCK(m_Lock);
+    if(m_Waiting.empty() && m_Holders < m_Count)
+    {
+      m_NextTicket++;
+      m_Holders++;
+      return true;
+    }
+    return false;
+  }
+
+  void Release()
+  {
+    SCOPED_LOCK(m_Lock);
+    RDCASSERT(m_Holders > 0);
+    m_Holders--;
+  }
+
+private:
+  Threading::CriticalSection m_Lock;
+  uint32_t m_Count;
+  uint32_t m_Holders = 0;
+  uint64_t m_NextTicket = 0;
+  rdcarray<uint64_t> m_Waiting;
+};
+
+// Shares the replay work between concurrent clients, each of which has its own thread and its own
+// ReplayProxy:
+//
+// - only maxReplays captures can be open at once. Clients opening one beyond that wait for a slot
+//   in the order they asked.
+// - anything that touches a replay driver - creating it, loading the capture, replay requests, and
+//   shutting it down - holds the single gpu slot, taking turns in the order they arrived. The
+//   drivers aren't written to be used from several threads at once, and loading reports progress
+//   through a process-global callback, so only one client is ever inside a driver. It also means
+//   one client issuing a long stream of expensive requests can't starve the others.
+//
+// Concurrency is only between clients' network handling, copies and waits, never within replay.
+struct ReplayScheduler
+{
+  FairSemaphore replaySlots;
+  FairSemaphore gpu;
+};
+
+struct ActiveClients
 {
   Threading::CriticalSection lock;
-  ClientThread *active = NULL;
+  rdcarray<ClientThread *> active;
+
+  RemoteServerLimits limits;
+  ReplayScheduler scheduler;
+
+  // only one client at a time can show a preview window, whichever opened a capture first
+  ClientThread *previewOwner = NULL;
+
+  uint64_t nextSession = 1;
+
+  // the temporary files from connections that closed. We can't tell if a connection was closed or
+  // dropped, so these are kept in case it's the same client resuming. Only as many as could
+  // reconnect are kept, oldest first, so with one client this is just the last connection's.
+  struct OrphanedSession
+  {
+    uint64_t session;
+    rdcarray<rdcstr> files;
+    uint64_t storageUsed;
+  };
+  rdcarray<OrphanedSession> orphaned;
+
+  void DeleteOrphanedFiles(size_t keep = 0)
+  {
+    while(orphaned.size() > keep)
+    {
+      for(const rdcstr &f : orphaned[0].files)
+        FileIO::Delete(f);
+      orphaned.erase(0);
+    }
+  }
 };
 
-static bool HandleHandshakeClient(ActiveClient &activeClient, ClientThread *threadData)
+static bool HandleHandshakeClient(ActiveClients &activeClients, ClientThread *threadData)
 {
   uint32_t ip = threadData->socket->GetRemoteIP();
 
   uint32_t version = 0;
+  uint32_t networkCodecs = 0;
+  uint64_t session = 0;
 
   bool activeConnectionDesired = false;
   bool activeConnectionEstablished = false;
@@ -186,6 +404,14 @@ static bool HandleHandshakeClient(ActiveClient &activeClient, ClientThread *thre
     SERIALISE_ELEMENT(version);
     SERIALISE_ELEMENT(activeConnectionDesired);
 
+    // only a peer with exactly our version and revision sends these. Anything else is rejected
+    // below without reading any further
+    if(version == RemoteServerProtocolVersion)
+    {
+      SERIALISE_ELEMENT(networkCodecs);
+      SERIALISE_ELEMENT(session);
+    }
+
     ser.EndChunk();
   }
 
@@ -196,8 +422,9 @@ static bool HandleHandshakeClient(ActiveClient &activeClient, ClientThread *thre
 
     if(version != RemoteServerProtocolVersion)
     {
-      RDCLOG("Connection using protocol %u, but we are running %u", version,
-             RemoteServerProtocolVersion);
+      RDCLOG("Connection using protocol %u revision %u, but we are running %u revision %u",
+             version & 0xffffff, version >> 24, RemoteServerProtocolVersion & 0xffffff,
+             RemoteServerProtocolRevision);
 
       {
         SCOPED_SERIALISE_CHUNK(eRemoteServer_VersionMismatch);
@@ -208,8 +435,8 @@ static bool HandleHandshakeClient(ActiveClient &activeClient, ClientThread *thre
       bool busy = false;
 
       {
-        SCOPED_LOCK(activeClient.lock);
-        busy = activeClient.active != NULL;
+        SCOPED_LOCK(activeClients.lock);
+        busy = activeClients.active.size() >= activeClients.limits.maxClients;
 
         // if we're not busy, and the connection wants to be active, promote it.
         if(!busy && activeConnectionDesired)
@@ -217,7 +444,29 @@ static bool HandleHandshakeClient(ActiveClient &activeClient, ClientThread *thre
           RDCLOG("Promoting connection from %u.%u.%u.%u to active.", Network::GetIPOctet(ip, 0),
                  Network::GetIPOctet(ip, 1), Network::GetIPOctet(ip, 2), Network::GetIPOctet(ip, 3));
           activeConnectionEstablished = true;
-          activeClient.active = threadData;
+          activeClients.active.push_back(threadData);
+
+          // pick up where a dropped connection left off, otherwise start a new session
+          threadData->session = 0;
+          for(size_t i = 0; session != 0 && i < activeClients.orphaned.size(); i++)
+          {
+            if(activeClients.orphaned[i].session == session)
+            {
+              RDCLOG("Resuming session %llu", session);
+              threadData->session = session;
+              threadData->tempFiles.swap(activeClients.orphaned[i].files);
+              threadData->storageUsed = activeClients.orphaned[i].storageUsed;
+              activeClients.orphaned.erase(i);
+              break;
+            }
+          }
+
+          if(threadData->session == 0)
+            threadData->session = activeClients.nextSession++;
+
+          // keep only as many orphaned sessions as there are free client slots to resume them
+          activeClients.DeleteOrphanedFiles(activeClients.limits.maxClients -
+                                            activeClients.active.size());
         }
       }
 
@@ -236,7 +485,17 @@ static bool HandleHandshakeClient(ActiveClient &activeClient, ClientThread *thre
         RDCLOG("Returning OK signal for connection from %u.%u.%u.%u.", Network::GetIPOctet(ip, 0),
                Network::GetIPOctet(ip, 1), Network::GetIPOctet(ip, 2), Network::GetIPOctet(ip, 3));
 
+        // None is always supported even if the client didn't say so
+        networkCodecs &= OfferedNetworkCodecs();
+        networkCodecs |= NetworkCodecBit(NetworkCodec::None);
+
+        threadData->networkCodecs = networkCodecs;
+
+        session = threadData->session;
+
         SCOPED_SERIALISE_CHUNK(eRemoteServer_Handshake);
+        SERIALISE_ELEMENT(networkCodecs);
+        SERIALISE_ELEMENT(session);
       }
     }
   }
@@ -245,7 +504,7 @@ static bool HandleHandshakeClient(ActiveClient &activeClient, ClientThread *thre
   return activeConnectionEstablished;
 }
 
-static void ActiveRemoteClientThread(ClientThread *threadData,
+static void ActiveRemoteClientThread(ActiveClients &activeClients, ClientThread *threadData,
                                      RENDERDOC_PreviewWindowCallback previewWindow)
 {
   Threading::SetCurrentThreadName("ActiveRemoteClientThread");
@@ -256,13 +515,20 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
 
   uint32_t ip = client->GetRemoteIP();
 
-  rdcarray<rdcstr> tempFiles;
+  rdcarray<rdcstr> &tempFiles = threadData->tempFiles;
   IRemoteDriver *remoteDriver = NULL;
   IReplayDriver *replayDriver = NULL;
   ReplayProxy *proxy = NULL;
   RDCFile *rdc = NULL;
   Callstack::StackResolver *resolver = NULL;
 
+  ReplayScheduler &scheduler = activeClients.scheduler;
+  // whether we hold one of the scheduler's replay slots
+  bool replaySlot = false;
+
+  // separate states for each direction, since they're decoded on different ends
+  AdaptiveCodec sendCodec(threadData->networkCodecs), recvCodec(threadData->networkCodecs);
+
   FileIO::LogFileHandle *debugLog = NULL;
 
   WriteSerialiser writer(new StreamWriter(client, Ownership::Nothing), Ownership::Stream);
@@ -289,8 +555,6 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
   writer.SetStreamingMode(true);
   reader.SetStreamingMode(true);
 
-  uint32_t captureNum = 0;
-
   while(client)
   {
     if(client && !client->Connected())
@@ -312,8 +576,12 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
     {
       reader.EndChunk();
 
-      if(proxy)
+      // the preview is only a courtesy, so don't hold up the ping behind other clients' work
+      if(proxy && scheduler.gpu.TryAcquire())
+      {
         proxy->RefreshPreviewWindow();
+        scheduler.gpu.Release();
+      }
 
       // insert a dummy line into our logcat so we can keep track of our progress
       Android::TickDeviceLogcat();
@@ -376,10 +644,13 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
     else if(type == eRemoteServer_CopyCaptureFromRemote)
     {
       rdcstr path;
+      uint64_t resumeOffset = 0, resumeChecksum = 0;
 
       {
         READ_DATA_SCOPE();
         SERIALISE_ELEMENT(path);
+        SERIALISE_ELEMENT(resumeOffset);
+        SERIALISE_ELEMENT(resumeChecksum);
       }
 
       reader.EndChunk();
@@ -388,49 +659,94 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
         WRITE_DATA_SCOPE();
         SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureFromRemote);
 
-        StreamReader fileStream(FileIO::fopen(path, FileIO::ReadBinary));
-        ser.SerialiseStream(path, fileStream);
+        ChunkedFileSend(ser.GetWriter(), path, resumeOffset, resumeChecksum, sendCodec);
       }
     }
     else if(type == eRemoteServer_CopyCaptureToRemote)
     {
-      rdcstr path;
-      rdcstr dummy, dummy2;
-      FileIO::GetDefaultFiles("remotecopy", path, dummy, dummy2);
+      uint64_t transferKey = 0, fileSize = 0;
 
-      // remove the .rdc
-      path.erase(path.size() - 4, 4);
-
-      // append a process- and capture- specific suffix to avoid clashes
-      path += StringFormat::Fmt("_remotecopy_%u_%u.rdc", Process::GetCurrentPID(), captureNum);
-      captureNum++;
+      {
+        READ_DATA_SCOPE();
+        SERIALISE_ELEMENT(transferKey);
+        SERIALISE_ELEMENT(fileSize);
+      }
 
-      RDCLOG("Copying file to local path '%s'.", path.c_str());
+      reader.EndChunk();
 
-      FileIO::CreateParentDirectory(path);
+      uint64_t storageLimit = activeClients.limits.clientStorage;
 
+      if(storageLimit > 0 && threadData->storageUsed + fileSize > storageLimit)
       {
-        READ_DATA_SCOPE();
+        RDCWARN("Refusing %llu byte copy, session has used %llu of its %llu bytes", fileSize,
+                threadData->storageUsed, storageLimit);
 
-        StreamWriter streamWriter(FileIO::fopen(path, FileIO::WriteBinary), Ownership::Stream);
+        bool accepted = false;
 
-        ser.SerialiseStream(path, streamWriter, NULL);
+        WRITE_DATA_SCOPE();
+        SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureToRemote);
+        SERIALISE_ELEMENT(accepted);
+        continue;
       }
 
+      // the partial file is named by the client's key so that if we lose the connection, the next
+      // attempt can pick up where this one left off
+      rdcstr partialPath = RemoteCopyPartialPath(transferKey);
+
+      FileIO::CreateParentDirectory(partialPath);
+
+      uint64_t resumeOffset = 0, resumeChecksum = 0;
+      GetTransferResumePoint(partialPath, resumeOffset, resumeChecksum);
+
+      {
+        bool accepted = true;
+
+        WRITE_DATA_SCOPE();
+        SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureToRemote);
+        SERIALISE_ELEMENT(accepted);
+        SERIALISE_ELEMENT(resumeOffset);
+        SERIALISE_ELEMENT(resumeChecksum);
+      }
+
+      bool complete = false;
+
+      type = reader.ReadChunk<RemoteServerPacket>();
+
+      if(type == eRemoteServer_CopyCaptureToRemote)
+        complete = ChunkedFileReceive(reader.GetReader(), partialPath, recvCodec);
+
       reader.EndChunk();
 
       if(reader.IsErrored())
       {
-        FileIO::Delete(path);
-
-        RDCERR("Network error receiving file");
+        RDCERR("Network error receiving file, %llu bytes kept to resume",
+               FileIO::GetFileSize(partialPath));
         break;
       }
 
-      RDCLOG("File received.");
+      rdcstr path;
 
-      tempFiles.push_back(path);
+      if(complete)
+      {
+        rdcstr dummy, dummy2;
+        FileIO::GetDefaultFiles("remotecopy", path, dummy, dummy2);
+
+        // remove the .rdc
+        path.erase(path.size() - 4, 4);
 
+        // append a process- and capture- specific suffix to avoid clashes
+        path += StringFormat::Fmt("_remotecopy_%u_%d.rdc", Process::GetCurrentPID(),
+                                  Atomic::Inc32(&RemoteCopyCount));
+
+        FileIO::Move(partialPath, path, true);
+
+        RDCLOG("File received to '%s'.", path.c_str());
+
+        tempFiles.push_back(path);
+        threadData->storageUsed += FileIO::GetFileSize(path);
+      }
+
+      // an empty path tells the client to try again
       {
         WRITE_DATA_SCOPE();
         SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureToRemote);
@@ -464,6 +780,34 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
         SERIALISE_ELEMENT(gpus);
       }
     }
+    else if(type == eRemoteServer_GetSessionStats)
+    {
+      reader.EndChunk();
+
+      RemoteServerStats stats;
+
+      stats.session = threadData->session;
+      stats.maxClients = activeClients.limits.maxClients;
+      stats.openReplays = scheduler.replaySlots.GetHolders();
+      stats.maxReplays = activeClients.limits.maxReplays;
+      stats.replayRequests = threadData->replayRequests;
+      stats.replayTime = threadData->replayTime;
+      stats.waitTime = threadData->waitTime;
+      stats.storageUsed = threadData->storageUsed;
+      stats.storageLimit = activeClients.limits.clientStorage;
+      stats.replayTimeLimit = activeClients.limits.clientReplayTime;
+
+      {
+        SCOPED_LOCK(activeClients.lock);
+        stats.activeClients = (uint32_t)activeClients.active.size();
+      }
+
+      {
+        WRITE_DATA_SCOPE();
+        SCOPED_SERIALISE_CHUNK(eRemoteServer_GetSessionStats);
+        SERIALISE_ELEMENT(stats);
+      }
+    }
     else if(type == eRemoteServer_ShutdownServer)
     {
       reader.EndChunk();
@@ -491,34 +835,55 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
 
       reader.EndChunk();
 
-      RDCASSERT(remoteDriver == NULL && proxy == NULL && rdc == NULL);
+      RDCASSERT(remoteDriver == NULL && proxy == NULL && rdc == NULL && !replaySlot);
 
-      rdc = new RDCFile();
-      rdc->Open(path);
+      bool kill = false;
+      float progress = 0.0f;
 
-      RDResult result = rdc->Error();
+      // report progress while we wait for our turn and while the capture loads
+      Threading::ThreadHandle ticker = Threading::CreateThread([&writer, &kill, &progress]() {
+        while(!kill)
+        {
+          {
+            WRITE_DATA_SCOPE();
+            SCOPED_SERIALISE_CHUNK(eRemoteServer_LogOpenProgress);
+            SERIALISE_ELEMENT(progress);
+          }
+          Threading::Sleep(100);
+        }
+      });
+
+      RDResult result;
+
+      // wait for another client to close its capture if we're at the limit, giving up if this
+      // client goes away in the meantime
+      double waited = scheduler.replaySlots.Acquire(
+          [threadData, &writer]() { return threadData->killThread || writer.IsErrored(); });
+
+      if(waited < 0.0)
+      {
+        SET_ERROR_RESULT(result, ResultCode::NetworkIOFailed,
+                         "Connection lost while waiting to open capture");
+      }
+      else
+      {
+        replaySlot = true;
+        threadData->waitTime += waited / 1000.0;
+
+        rdc = new RDCFile();
+        rdc->Open(path);
+
+        result = rdc->Error();
+      }
 
       if(result == ResultCode::Succeeded)
       {
         if(RenderDoc::Inst().HasRemoteDriver(rdc->GetDriver()))
         {
-          bool kill = false;
-          float progress = 0.0f;
+          threadData->waitTime += scheduler.gpu.Acquire() / 1000.0;
 
           RenderDoc::Inst().SetProgressCallback<LoadProgress>([&progress](float p) { progress = p; });
 
-          Threading::ThreadHandle ticker = Threading::CreateThread([&writer, &kill, &progress]() {
-            while(!kill)
-            {
-              {
-                WRITE_DATA_SCOPE();
-                SCOPED_SERIALISE_CHUNK(eRemoteServer_LogOpenProgress);
-                SERIALISE_ELEMENT(progress);
-              }
-              Threading::Sleep(100);
-            }
-          });
-
           // if we have a replay driver, try to create it so we can display a local preview e.g.
           if(RenderDoc::Inst().HasReplayDriver(rdc->GetDriver()))
           {
@@ -550,14 +915,24 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
 
           RenderDoc::Inst().SetProgressCallback<LoadProgress>(RENDERDOC_ProgressCallback());
 
-          kill = true;
-          Threading::JoinThread(ticker);
-          Threading::CloseThread(ticker);
-
           if(result == ResultCode::Succeeded && remoteDriver)
           {
-            proxy = new ReplayProxy(reader, writer, remoteDriver, replayDriver, previewWindow);
+            // the preview window belongs to whichever client opened a capture first
+            RENDERDOC_PreviewWindowCallback preview;
+
+            {
+              SCOPED_LOCK(activeClients.lock);
+              if(activeClients.previewOwner == NULL)
+                activeClients.previewOwner = threadData;
+              if(activeClients.previewOwner == threadData)
+                preview = previewWindow;
+            }
+
+            proxy = new ReplayProxy(reader, writer, remoteDriver, replayDriver, preview,
+                                    threadData->networkCodecs);
           }
+
+          scheduler.gpu.Release();
         }
         else
         {
@@ -567,6 +942,17 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
         }
       }
 
+      kill = true;
+      Threading::JoinThread(ticker);
+      Threading::CloseThread(ticker);
+
+      // the client will still close the log, but there's no need to hold our slot until then
+      if(proxy == NULL && replaySlot)
+      {
+        scheduler.replaySlots.Release();
+        replaySlot = false;
+      }
+
       {
         WRITE_DATA_SCOPE();
         SCOPED_SERIALISE_CHUNK(eRemoteServer_LogOpened);
@@ -784,7 +1170,7 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
       {
         WRITE_DATA_SCOPE();
         SCOPED_SERIALISE_CHUNK(eRemoteServer_GetSectionContents);
-        SERIALISE_ELEMENT(contents);
+        AdaptiveBufferSend(ser.GetWriter(), contents, sendCodec);
       }
     }
     else if(type == eRemoteServer_WriteSection)
@@ -795,7 +1181,7 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
       {
         READ_DATA_SCOPE();
         SERIALISE_ELEMENT(props);
-        SERIALISE_ELEMENT(contents);
+        AdaptiveBufferReceive(ser.GetReader(), contents, recvCodec);
       }
 
       reader.EndChunk();
@@ -832,15 +1218,33 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
     {
       reader.EndChunk();
 
-      SAFE_DELETE(proxy);
+      if(proxy || remoteDriver)
+      {
+        threadData->waitTime += scheduler.gpu.Acquire() / 1000.0;
+
+        SAFE_DELETE(proxy);
+
+        if(remoteDriver)
+          remoteDriver->Shutdown();
+
+        scheduler.gpu.Release();
+      }
 
-      if(remoteDriver)
-        remoteDriver->Shutdown();
       remoteDriver = NULL;
       replayDriver = NULL;
 
       SAFE_DELETE(rdc);
       SAFE_DELETE(resolver);
+
+      if(replaySlot)
+        scheduler.replaySlots.Release();
+      replaySlot = false;
+
+      {
+        SCOPED_LOCK(activeClients.lock);
+        if(activeClients.previewOwner == threadData)
+          activeClients.previewOwner = NULL;
+      }
     }
     else if(type == eRemoteServer_ExecuteAndInject)
     {
@@ -881,8 +1285,26 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
     }
     else if((int)type >= eReplayProxy_First && proxy)
     {
+      uint32_t replayLimit = activeClients.limits.clientReplayTime;
+      if(replayLimit > 0 && threadData->replayTime > double(replayLimit))
+      {
+        RDCWARN("Session %llu has used its %u seconds of replay time, closing connection",
+                threadData->session, replayLimit);
+        break;
+      }
+
+      // take our turn on the GPU behind any other clients' requests
+      threadData->waitTime += scheduler.gpu.Acquire() / 1000.0;
+
+      PerformanceTimer timer;
+
       bool ok = proxy->Tick(type);
 
+      threadData->replayTime += timer.GetMilliseconds() / 1000.0;
+      threadData->replayRequests++;
+
+      scheduler.gpu.Release();
+
       if(!ok)
         break;
 
@@ -892,18 +1314,41 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
 
   FileIO::logfile_close(debugLog, rdcstr());
 
-  SAFE_DELETE(proxy);
+  if(proxy || remoteDriver)
+  {
+    scheduler.gpu.Acquire();
+
+    SAFE_DELETE(proxy);
+
+    if(remoteDriver)
+      remoteDriver->Shutdown();
+
+    scheduler.gpu.Release();
+  }
 
-  if(remoteDriver)
-    remoteDriver->Shutdown();
   remoteDriver = NULL;
   replayDriver = NULL;
   SAFE_DELETE(rdc);
   SAFE_DELETE(resolver);
 
-  for(size_t i = 0; i < tempFiles.size(); i++)
+  if(replaySlot)
+    scheduler.replaySlots.Release();
+
   {
-    FileIO::Delete(tempFiles[i]);
+    SCOPED_LOCK(activeClients.lock);
+
+    if(activeClients.previewOwner == threadData)
+      activeClients.previewOwner = NULL;
+
+    // we're still counted as active until the server reaps this thread, so this leaves room for
+    // every other client to have an orphaned session too
+    activeClients.DeleteOrphanedFiles(activeClients.limits.maxClients - 1);
+
+    ActiveClients::OrphanedSession orphan;
+    orphan.session = threadData->session;
+    orphan.files.swap(tempFiles);
+    orphan.storageUsed = threadData->storageUsed;
+    activeClients.orphaned.push_back(orphan);
   }
 
   RDCLOG("Closing active connection from %u.%u.%u.%u.", Network::GetIPOctet(ip, 0),
@@ -914,109 +1359,17 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
   SAFE_DELETE(client);
 }
 
-void RenderDoc::BecomeRemoteServer(const rdcstr &listenhost, uint16_t port,
-                                   std::function<bool()> killReplay,
-                                   RENDERDOC_PreviewWindowCallback previewWindow)
+// accepts connections on sock and serves them until killReplay returns true, taking ownership of
+// the socket
+static void ServeRemoteClients(Network::Socket *sock,
+                               const rdcarray<rdcpair<uint32_t, uint32_t> > &listenRanges,
+                               bool allowExecution, const RemoteServerLimits &limits,
+                               std::function<bool()> killReplay,
+                               RENDERDOC_PreviewWindowCallback previewWindow)
 {
-  Network::Socket *sock = Network::CreateServerSocket(listenhost, port, 1);
-
-  if(sock == NULL)
-    return;
-
-  rdcarray<rdcpair<uint32_t, uint32_t> > listenRanges;
-  bool allowExecution = true;
-
-  FILE *f = FileIO::fopen(FileIO::GetAppFolderFilename("remoteserver.conf"), FileIO::ReadText);
-
-  rdcstr configFile;
-
-  if(f)
-  {
-    FileIO::fseek64(f, 0, SEEK_END);
-    configFile.resize((size_t)FileIO::ftell64(f));
-    FileIO::fseek64(f, 0, SEEK_SET);
-
-    FileIO::fread(configFile.data(), 1, configFile.size(), f);
-
-    FileIO::fclose(f);
-  }
-
-  rdcarray<rdcstr> lines;
-  split(configFile, lines, '\n');
-
-  for(rdcstr &line : lines)
-  {
-    line.trim();
-
-    if(line == "")
-      continue;
-
-    // skip comments
-    if(line[0] == '#')
-      continue;
-
-    if(line.substr(0, sizeof("whitelist") - 1) == "whitelist")
-    {
-      uint32_t ip = 0, mask = 0;
-
-      // CIDR notation
-      bool found = Network::ParseIPRangeCIDR(line.substr(sizeof("whitelist")), ip, mask);
-
-      if(found)
-      {
-        listenRanges.push_back(make_rdcpair(ip, mask));
-        continue;
-      }
-      else
-      {
-        RDCLOG("Couldn't parse IP range from: %s", line.c_str() + sizeof("whitelist"));
-      }
-
-      continue;
-    }
-    else if(line.substr(0, sizeof("noexec") - 1) == "noexec")
-    {
-      allowExecution = false;
-
-      continue;
-    }
-
-    RDCLOG("Malformed line '%s'. See documentation for file format.", line.c_str());
-  }
-
-  if(listenRanges.empty())
-  {
-    RDCLOG("No whitelist IP ranges configured - using default private IP ranges.");
-    RDCLOG(
-        "Create a config file remoteserver.conf in ~/.renderdoc or %%APPDATA%%/renderdoc to "
-        "narrow "
-        "this down or accept connections from more ranges.");
-
-    listenRanges.push_back(make_rdcpair(Network::MakeIP(10, 0, 0, 0), 0xff000000));
-    listenRanges.push_back(make_rdcpair(Network::MakeIP(172, 16, 0, 0), 0xfff00000));
-    listenRanges.push_back(make_rdcpair(Network::MakeIP(192, 168, 0, 0), 0xffff0000));
-  }
-
-  RDCLOG("Allowing connections from:");
-
-  for(size_t i = 0; i < listenRanges.size(); i++)
-  {
-    uint32_t ip = listenRanges[i].first;
-    uint32_t mask = listenRanges[i].second;
-
-    RDCLOG("%u.%u.%u.%u / %u.%u.%u.%u", Network::GetIPOctet(ip, 0), Network::GetIPOctet(ip, 1),
-           Network::GetIPOctet(ip, 2), Network::GetIPOctet(ip, 3), Network::GetIPOctet(mask, 0),
-           Network::GetIPOctet(mask, 1), Network::GetIPOctet(mask, 2), Network::GetIPOctet(mask, 3));
-  }
-
-  if(allowExecution)
-    RDCLOG("Allowing execution commands");
-  else
-    RDCLOG("Blocking execution commands");
-
-  RDCLOG("Replay host ready for requests...");
-
-  ActiveClient activeClientData;
+  ActiveClients activeClientData;
+  activeClientData.limits = limits;
+  activeClientData.scheduler.replaySlots.SetCount(limits.maxReplays);
 
   rdcarray<ClientThread *> clients;
 
@@ -1024,12 +1377,17 @@ void RenderDoc::BecomeRemoteServer(const rdcstr &listenhost, uint16_t port,
   {
     Network::Socket *client = sock->AcceptClient(0);
 
+    bool killServer = false;
+
     {
       SCOPED_LOCK(activeClientData.lock);
-      if(activeClientData.active && activeClientData.active->killServer)
-        break;
+      for(ClientThread *active : activeClientData.active)
+        killServer |= active->killServer;
     }
 
+    if(killServer)
+      break;
+
     // reap any dead client threads
     for(size_t i = 0; i < clients.size(); i++)
     {
@@ -1037,8 +1395,7 @@ void RenderDoc::BecomeRemoteServer(const rdcstr &listenhost, uint16_t port,
       {
         {
           SCOPED_LOCK(activeClientData.lock);
-          if(activeClientData.active == clients[i])
-            activeClientData.active = NULL;
+          activeClientData.active.removeOne(clients[i]);
         }
 
         Threading::JoinThread(clients[i]->thread);
@@ -1099,7 +1456,7 @@ void RenderDoc::BecomeRemoteServer(const rdcstr &listenhost, uint16_t port,
         Threading::CreateThread([&activeClientData, clientThread, previewWindow]() {
           if(HandleHandshakeClient(activeClientData, clientThread))
           {
-            ActiveRemoteClientThread(clientThread, previewWindow);
+            ActiveRemoteClientThread(activeClientData, clientThread, previewWindow);
           }
           else
           {
@@ -1112,9 +1469,9 @@ void RenderDoc::BecomeRemoteServer(const rdcstr &listenhost, uint16_t port,
 
   {
     SCOPED_LOCK(activeClientData.lock);
-    if(activeClientData.active)
-      activeClientData.active->killThread = true;
-    activeClientData.active = NULL;
+    for(ClientThread *active : activeClientData.active)
+      active->killThread = true;
+    activeClientData.active.clear();
   }
 
   // shut down client threads
@@ -1125,55 +1482,185 @@ void RenderDoc::BecomeRemoteServer(const rdcstr &listenhost, uint16_t port,
     delete clients[i];
   }
 
+  activeClientData.DeleteOrphanedFiles();
+
+  // nothing can resume an interrupted copy any more
+  {
+    rdcstr dir = get_dirname(RemoteCopyPartialPath(0));
+
+    rdcarray<PathEntry> files;
+    FileIO::GetFilesInDirectory(dir, files);
+
+    for(const PathEntry &file : files)
+    {
+      if(file.filename.beginsWith("remotecopy_") && file.filename.endsWith(".partial"))
+        FileIO::Delete(dir + "/" + file.filename);
+    }
+  }
+
   SAFE_DELETE(sock);
 }
 
-extern "C" RENDERDOC_API ResultDetails RENDERDOC_CC
-RENDERDOC_CreateRemoteServerConnection(const rdcstr &URL, IRemoteServer **rend)
+void RenderDoc::BecomeRemoteServer(const rdcstr &listenhost, uint16_t port,
+                                   std::function<bool()> killReplay,
+                                   RENDERDOC_PreviewWindowCallback previewWindow)
 {
-  rdcstr host = "localhost";
-  if(!URL.empty())
-    host = URL;
+  Network::Socket *sock = Network::CreateServerSocket(listenhost, port, 1);
 
-  rdcstr deviceID = host;
+  if(sock == NULL)
+    return;
 
-  IDeviceProtocolHandler *protocol = RenderDoc::Inst().GetDeviceProtocol(deviceID);
+  rdcarray<rdcpair<uint32_t, uint32_t> > listenRanges;
+  bool allowExecution = true;
+  RemoteServerLimits limits;
 
-  uint16_t port = RenderDoc_RemoteServerPort;
+  FILE *f = FileIO::fopen(FileIO::GetAppFolderFilename("remoteserver.conf"), FileIO::ReadText);
 
-  if(protocol)
+  rdcstr configFile;
+
+  if(f)
   {
-    deviceID = protocol->GetDeviceID(deviceID);
-    host = protocol->RemapHostname(deviceID);
-    if(host.empty())
-      return RDResult(ResultCode::NetworkIOFailed);
+    FileIO::fseek64(f, 0, SEEK_END);
+    configFile.resize((size_t)FileIO::ftell64(f));
+    FileIO::fseek64(f, 0, SEEK_SET);
 
-    port = protocol->RemapPort(deviceID, port);
+    FileIO::fread(configFile.data(), 1, configFile.size(), f);
+
+    FileIO::fclose(f);
   }
-  else
+
+  rdcarray<rdcstr> lines;
+  split(configFile, lines, '\n');
+
+  for(rdcstr &line : lines)
   {
-    int32_t idx = deviceID.indexOf(':');
-    if(idx > 0)
+    line.trim();
+
+    if(line == "")
+      continue;
+
+    // skip comments
+    if(line[0] == '#')
+      continue;
+
+    if(line.substr(0, sizeof("whitelist") - 1) == "whitelist")
     {
-      host = deviceID.substr(0, idx);
-      port = atoi(deviceID.substr(idx + 1).c_str()) & 0xffff;
+      uint32_t ip = 0, mask = 0;
+
+      // CIDR notation
+      bool found = Network::ParseIPRangeCIDR(line.substr(sizeof("whitelist")), ip, mask);
+
+      if(found)
+      {
+        listenRanges.push_back(make_rdcpair(ip, mask));
+        continue;
+      }
+      else
+      {
+        RDCLOG("Couldn't parse IP range from: %s", line.c_str() + sizeof("whitelist"));
+      }
+
+      continue;
     }
+    else if(line.substr(0, sizeof("noexec") - 1) == "noexec")
+    {
+      allowExecution = false;
+
+      continue;
+    }
+    else if(line.substr(0, sizeof("maxclients") - 1) == "maxclients")
+    {
+      limits.maxClients = RDCMAX(1, atoi(line.c_str() + sizeof("maxclients")));
+
+      continue;
+    }
+    else if(line.substr(0, sizeof("maxreplays") - 1) == "maxreplays")
+    {
+      limits.maxReplays = RDCMAX(1, atoi(line.c_str() + sizeof("maxreplays")));
+
+      continue;
+    }
+    else if(line.substr(0, sizeof("clientstorage") - 1) == "clientstorage")
+    {
+      // in megabytes
+      limits.clientStorage = uint64_t(RDCMAX(0, atoi(line.c_str() + sizeof("clientstorage"))))
+                             << 20;
+
+      continue;
+    }
+    else if(line.substr(0, sizeof("clientreplaytime") - 1) == "clientreplaytime")
+    {
+      // in seconds
+      limits.clientReplayTime = RDCMAX(0, atoi(line.c_str() + sizeof("clientreplaytime")));
+
+      continue;
+    }
+
+    RDCLOG("Malformed line '%s'. See documentation for file format.", line.c_str());
   }
 
-  if(port == 0)
-    return RDResult(ResultCode::NetworkIOFailed);
+  if(listenRanges.empty())
+  {
+    RDCLOG("No whitelist IP ranges configured - using default private IP ranges.");
+    RDCLOG(
+        "Create a config file remoteserver.conf in ~/.renderdoc or %%APPDATA%%/renderdoc to "
+        "narrow "
+        "this down or accept connections from more ranges.");
+
+    listenRanges.push_back(make_rdcpair(Network::MakeIP(10, 0, 0, 0), 0xff000000));
+    listenRanges.push_back(make_rdcpair(Network::MakeIP(172, 16, 0, 0), 0xfff00000));
+    listenRanges.push_back(make_rdcpair(Network::MakeIP(192, 168, 0, 0), 0xffff0000));
+  }
+
+  RDCLOG("Allowing connections from:");
+
+  for(size_t i = 0; i < listenRanges.size(); i++)
+  {
+    uint32_t ip = listenRanges[i].first;
+    uint32_t mask = listenRanges[i].second;
+
+    RDCLOG("%u.%u.%u.%u / %u.%u.%u.%u", Network::GetIPOctet(ip, 0), Network::GetIPOctet(ip, 1),
+           Network::GetIPOctet(ip, 2), Network::GetIPOctet(ip, 3), Network::GetIPOctet(mask, 0),
+           Network::GetIPOctet(mask, 1), Network::GetIPOctet(mask, 2),
+           Network::GetIPOctet(mask, 3));
+  }
+
+  if(allowExecution)
+    RDCLOG("Allowing execution commands");
+  else
+    RDCLOG("Blocking execution commands");
+
+  // there's no point having more replay slots than clients to use them
+  limits.maxReplays = RDCMIN(limits.maxReplays, limits.maxClients);
+
+  RDCLOG("Serving up to %u clients with up to %u open captures", limits.maxClients,
+         limits.maxReplays);
+
+  if(limits.clientStorage > 0)
+    RDCLOG("Limiting each client to %llu MB of copied captures", limits.clientStorage >> 20);
+
+  if(limits.clientReplayTime > 0)
+    RDCLOG("Limiting each client to %u seconds of replay time", limits.clientReplayTime);
+
+  RDCLOG("Replay host ready for requests...");
+
+  ServeRemoteClients(sock, listenRanges, allowExecution, limits, killReplay, previewWindow);
+}
 
-  Network::Socket *sock = Network::CreateClientSocket(host, port, 750);
+static RDResult ConnectRemoteServer(const rdcstr &host, uint16_t port, bool activeConnection,
+                                    Network::Socket *&sock, uint32_t &networkCodecs,
+                                    uint64_t &session)
+{
+  sock = Network::CreateClientSocket(host, port, 750);
 
   if(sock == NULL)
     return RDResult(ResultCode::NetworkIOFailed);
 
   uint32_t version = RemoteServerProtocolVersion;
+  networkCodecs = OfferedNetworkCodecs();
 
   sock->SetTimeout(RemoteServer_TimeoutMS());
 
-  bool activeConnection = (rend != NULL);
-
   {
     WriteSerialiser ser(new StreamWriter(sock, Ownership::Nothing), Ownership::Stream);
 
@@ -1182,16 +1669,28 @@ RENDERDOC_CreateRemoteServerConnection(const rdcstr &URL, IRemoteServer **rend)
     SCOPED_SERIALISE_CHUNK(eRemoteServer_Handshake);
     SERIALISE_ELEMENT(version);
     SERIALISE_ELEMENT(activeConnection);
+    SERIALISE_ELEMENT(networkCodecs);
+    SERIALISE_ELEMENT(session);
   }
 
   if(!sock->Connected())
+  {
+    SAFE_DELETE(sock);
     return RDResult(ResultCode::NetworkIOFailed);
+  }
 
   {
     ReadSerialiser ser(new StreamReader(sock, Ownership::Nothing), Ownership::Stream);
 
     RemoteServerPacket type = ser.ReadChunk<RemoteServerPacket>();
 
+    // the server replies with the codecs that both of us support, and our session
+    if(type == eRemoteServer_Handshake)
+    {
+      SERIALISE_ELEMENT(networkCodecs);
+      SERIALISE_ELEMENT(session);
+    }
+
     ser.EndChunk();
 
     if(type == eRemoteServer_Busy)
@@ -1214,13 +1713,66 @@ RENDERDOC_CreateRemoteServerConnection(const rdcstr &URL, IRemoteServer **rend)
     }
   }
 
-  if(rend == NULL)
-    return RDResult(ResultCode::Succeeded);
+  return RDResult(ResultCode::Succeeded);
+}
+
+extern "C" RENDERDOC_API ResultDetails RENDERDOC_CC
+RENDERDOC_CreateRemoteServerConnection(const rdcstr &URL, IRemoteServer **rend)
+{
+  rdcstr host = "localhost";
+  if(!URL.empty())
+    host = URL;
+
+  rdcstr deviceID = host;
+
+  IDeviceProtocolHandler *protocol = RenderDoc::Inst().GetDeviceProtocol(deviceID);
+
+  uint16_t port = RenderDoc_RemoteServerPort;
+
+  if(protocol)
+  {
+    deviceID = protocol->GetDeviceID(deviceID);
+    host = protocol->RemapHostname(deviceID);
+    if(host.empty())
+      return RDResult(ResultCode::NetworkIOFailed);
+
+    port = protocol->RemapPort(deviceID, port);
+  }
+  else
+  {
+    int32_t idx = deviceID.indexOf(':');
+    if(idx > 0)
+    {
+      host = deviceID.substr(0, idx);
+      port = atoi(deviceID.substr(idx + 1).c_str()) & 0xffff;
+    }
+  }
+
+  if(port == 0)
+    return RDResult(ResultCode::NetworkIOFailed);
+
+  Network::Socket *sock = NULL;
+  uint32_t networkCodecs = 0;
+  uint64_t session = 0;
+
+  RDResult result = ConnectRemoteServer(host, port, rend != NULL, sock, networkCodecs, session);
+
+  if(result != ResultCode::Succeeded || rend == NULL)
+  {
+    SAFE_DELETE(sock);
+    return result;
+  }
+
+  RemoteServer *server = NULL;
 
   if(protocol)
-    *rend = protocol->CreateRemoteServer(sock, deviceID);
+    server = protocol->CreateRemoteServer(sock, deviceID);
   else
-    *rend = new RemoteServer(sock, deviceID);
+    server = new RemoteServer(sock, deviceID);
+
+  server->SetConnectionInfo(host, port, networkCodecs, session);
+
+  *rend = server;
 
   return RDResult(ResultCode::Succeeded);
 }
@@ -1239,14 +1791,8 @@ RENDERDOC_CheckRemoteServerConnection(const rdcstr &URL)
 RemoteServer::RemoteServer(Network::Socket *sock, const rdcstr &deviceID)
     : m_Socket(sock), m_deviceID(deviceID)
 {
-  reader = new ReadSerialiser(new StreamReader(sock, Ownership::Nothing), Ownership::Stream);
-  writer = new WriteSerialiser(new StreamWriter(sock, Ownership::Nothing), Ownership::Stream);
-
   if(RemoteServer_DebugLogging())
   {
-    reader->ConfigureStructuredExport(&GetRemoteServerChunkName, false, 0, 1.0);
-    writer->ConfigureStructuredExport(&GetRemoteServerChunkName, false, 0, 1.0);
-
     rdcstr filename = FileIO::GetTempFolderFilename() + "/RenderDoc/RemoteServer_Client.log";
 
     RDCLOG("Logging remote server work to '%s'", filename.c_str());
@@ -1255,17 +1801,16 @@ RemoteServer::RemoteServer(Network::Socket *sock, const rdcstr &deviceID)
     debugLog = FileIO::logfile_open(filename);
     FileIO::logfile_close(debugLog, filename);
     debugLog = FileIO::logfile_open(filename);
-
-    reader->EnableDumping(debugLog);
-    writer->EnableDumping(debugLog);
   }
   else
   {
     debugLog = NULL;
   }
 
-  writer->SetStreamingMode(true);
-  reader->SetStreamingMode(true);
+  CreateSerialisers();
+
+  // until SetConnectionInfo is called we can only send uncompressed data
+  SetNetworkCodecs(NetworkCodecBit(NetworkCodec::None));
 
   std::map<RDCDriver, rdcstr> m = RenderDoc::Inst().GetReplayDrivers();
 
@@ -1280,6 +1825,98 @@ RemoteServer::~RemoteServer()
   SAFE_DELETE(writer);
   SAFE_DELETE(reader);
   SAFE_DELETE(m_Socket);
+  SAFE_DELETE(m_SendCodec);
+  SAFE_DELETE(m_RecvCodec);
+}
+
+void RemoteServer::CreateSerialisers()
+{
+  reader = new ReadSerialiser(new StreamReader(m_Socket, Ownership::Nothing), Ownership::Stream);
+  writer = new WriteSerialiser(new StreamWriter(m_Socket, Ownership::Nothing), Ownership::Stream);
+
+  if(debugLog)
+  {
+    reader->ConfigureStructuredExport(&GetRemoteServerChunkName, false, 0, 1.0);
+    writer->ConfigureStructuredExport(&GetRemoteServerChunkName, false, 0, 1.0);
+
+    reader->EnableDumping(debugLog);
+    writer->EnableDumping(debugLog);
+  }
+
+  writer->SetStreamingMode(true);
+  reader->SetStreamingMode(true);
+}
+
+void RemoteServer::SetNetworkCodecs(uint32_t networkCodecs)
+{
+  m_NetworkCodecs = networkCodecs;
+
+  // the codecs also hold history that the other end's codecs must match, so a new connection
+  // always starts with new ones
+  SAFE_DELETE(m_SendCodec);
+  SAFE_DELETE(m_RecvCodec);
+  m_SendCodec = new AdaptiveCodec(networkCodecs);
+  m_RecvCodec = new AdaptiveCodec(networkCodecs);
+}
+
+void RemoteServer::SetConnectionInfo(const rdcstr &host, uint16_t port, uint32_t networkCodecs,
+                                     uint64_t session)
+{
+  m_Host = host;
+  m_Port = port;
+  m_Session = session;
+  SetNetworkCodecs(networkCodecs);
+}
+
+bool RemoteServer::Reconnect()
+{
+  if(m_Host.empty())
+    return false;
+
+  RDCLOG("Reconnecting to remote server %s:%u", m_Host.c_str(), m_Port);
+
+  Network::Socket *sock = NULL;
+  uint32_t networkCodecs = 0;
+  uint64_t session = m_Session;
+
+  // the server may not have noticed that the old connection dropped, in which case it will say
+  // it's busy until it times out
+  double timeout = RemoteServer_TimeoutMS() * 2.0;
+  PerformanceTimer timer;
+
+  while(sock == NULL && timer.GetMilliseconds() < timeout)
+  {
+    RDResult result = ConnectRemoteServer(m_Host, m_Port, true, sock, networkCodecs, session);
+
+    if(result == ResultCode::NetworkVersionMismatch)
+      break;
+
+    if(result != ResultCode::Succeeded)
+      Threading::Sleep(500);
+  }
+
+  // if we failed, keep the old connection which will continue to report errors
+  if(sock == NULL)
+  {
+    RDCERR("Couldn't reconnect to remote server");
+    return false;
+  }
+
+  SAFE_DELETE(writer);
+  SAFE_DELETE(reader);
+  SAFE_DELETE(m_Socket);
+
+  m_Socket = sock;
+
+  CreateSerialisers();
+  SetNetworkCodecs(networkCodecs);
+
+  if(session != m_Session)
+    RDCWARN("Remote server didn't resume our session, temporary files on it have been lost");
+
+  m_Session = session;
+
+  return true;
 }
 
 void RemoteServer::ShutdownConnection()
@@ -1502,26 +2139,56 @@ ExecuteResult RemoteServer::ExecuteAndInject(const rdcstr &app, const rdcstr &wo
 void RemoteServer::CopyCaptureFromRemote(const rdcstr &remotepath, const rdcstr &localpath,
                                          RENDERDOC_ProgressCallback progress)
 {
+  // the capture is received into a partial file next to the destination, which can be resumed
+  // from if the connection drops - either by the retries below or by a later call.
+  rdcstr partialPath = localpath + ".partial";
+
+  for(uint32_t attempt = 0; attempt <= RemoteServer_TransferRetries(); attempt++)
+  {
+    if(!Connected() && !Reconnect())
+      break;
+
+    if(DownloadCapture(remotepath, partialPath, progress))
+    {
+      FileIO::Move(partialPath, localpath, true);
+      return;
+    }
+
+    RDCWARN("Copy of '%s' from remote was interrupted", remotepath.c_str());
+  }
+
+  RDCERR("Failed to copy '%s' from remote, %llu bytes kept to resume", remotepath.c_str(),
+         FileIO::GetFileSize(partialPath));
+}
+
+bool RemoteServer::DownloadCapture(const rdcstr &remotepath, const rdcstr &partialPath,
+                                   RENDERDOC_ProgressCallback progress)
+{
+  uint64_t resumeOffset = 0, resumeChecksum = 0;
+  GetTransferResumePoint(partialPath, resumeOffset, resumeChecksum);
+
   {
     WRITE_DATA_SCOPE();
     SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureFromRemote);
     SERIALISE_ELEMENT(remotepath);
+    SERIALISE_ELEMENT(resumeOffset);
+    SERIALISE_ELEMENT(resumeChecksum);
   }
 
+  bool complete = false;
+
   {
     READ_DATA_SCOPE();
     RemoteServerPacket type = ser.ReadChunk<RemoteServerPacket>();
 
     if(type == eRemoteServer_CopyCaptureFromRemote)
     {
-      StreamWriter streamWriter(FileIO::fopen(localpath, FileIO::WriteBinary), Ownership::Stream);
-
-      ser.SerialiseStream(localpath, streamWriter, progress);
+      complete = ChunkedFileReceive(ser.GetReader(), partialPath, *m_RecvCodec, progress);
 
       if(ser.IsErrored())
       {
         RDCERR("Network error receiving file");
-        return;
+        return false;
       }
     }
     else
@@ -1531,25 +2198,104 @@ void RemoteServer::CopyCaptureFromRemote(const rdcstr &remotepath, const rdcstr
 
     ser.EndChunk();
   }
+
+  return complete;
 }
 
 rdcstr RemoteServer::CopyCaptureToRemote(const rdcstr &filename, RENDERDOC_ProgressCallback progress)
 {
-  FILE *fileHandle = FileIO::fopen(filename, FileIO::ReadBinary);
-
-  if(!fileHandle)
+  if(!FileIO::exists(filename))
   {
     RDCERR("Can't open file '%s'", filename.c_str());
     return "";
   }
 
+  // identify this copy so the server can find what it already has if we need to resume. The
+  // modification time and size make sure a changed file is sent again from the start.
+  rdcstr fullpath = FileIO::GetFullPathname(filename);
+  uint64_t stats[] = {FileIO::GetModifiedTimestamp(filename), FileIO::GetFileSize(filename)};
+  uint64_t transferKey = XXH64(fullpath.c_str(), fullpath.size(), 0);
+  transferKey = XXH64(stats, sizeof(stats), transferKey);
+
+  for(uint32_t attempt = 0; attempt <= RemoteServer_TransferRetries(); attempt++)
+  {
+    if(!Connected() && !Reconnect())
+      break;
+
+    bool retry = false;
+    rdcstr path = UploadCapture(transferKey, filename, retry, progress);
+
+    if(!path.empty())
+      return path;
+
+    if(!retry)
+      break;
+
+    RDCWARN("Copy of '%s' to remote was interrupted", filename.c_str());
+  }
+
+  RDCERR("Failed to copy '%s' to remote", filename.c_str());
+
+  return "";
+}
+
+rdcstr RemoteServer::UploadCapture(uint64_t transferKey, const rdcstr &filename, bool &retry,
+                                   RENDERDOC_ProgressCallback progress)
+{
+  retry = true;
+
+  {
+    uint64_t fileSize = FileIO::GetFileSize(filename);
+
+    WRITE_DATA_SCOPE();
+    SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureToRemote);
+    SERIALISE_ELEMENT(transferKey);
+    SERIALISE_ELEMENT(fileSize);
+  }
+
+  uint64_t resumeOffset = 0, resumeChecksum = 0;
+
+  {
+    READ_DATA_SCOPE();
+    RemoteServerPacket type = ser.ReadChunk<RemoteServerPacket>();
+
+    bool accepted = false;
+
+    if(type == eRemoteServer_CopyCaptureToRemote)
+    {
+      SERIALISE_ELEMENT(accepted);
+
+      if(accepted)
+      {
+        SERIALISE_ELEMENT(resumeOffset);
+        SERIALISE_ELEMENT(resumeChecksum);
+      }
+    }
+    else
+    {
+      RDCERR("Unexpected response to capture copy request");
+    }
+
+    ser.EndChunk();
+
+    if(ser.IsErrored() || type != eRemoteServer_CopyCaptureToRemote)
+      return "";
+
+    // the server has a limit on how much each client can store, which this would go over
+    if(!accepted)
+    {
+      RDCERR("Remote server refused copy of '%s', storage limit reached", filename.c_str());
+      retry = false;
+      return "";
+    }
+  }
+
   {
     WRITE_DATA_SCOPE();
     SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureToRemote);
 
-    // this will take ownership of and close the file
-    StreamReader fileStream(fileHandle);
-    ser.SerialiseStream(filename, fileStream, progress);
+    ChunkedFileSend(ser.GetWriter(), filename, resumeOffset, resumeChecksum, *m_SendCodec,
+                    progress);
   }
 
   rdcstr path;
@@ -1672,7 +2418,7 @@ rdcpair<ResultDetails, IReplayController *> RemoteServer::OpenCapture(
 
   ReplayController *rend = new ReplayController();
 
-  ReplayProxy *proxy = new ReplayProxy(*reader, *writer, proxyDriver);
+  ReplayProxy *proxy = new ReplayProxy(*reader, *writer, proxyDriver, m_NetworkCodecs);
   result = rend->SetDevice(proxy);
 
   if(result != ResultCode::Succeeded)
@@ -1702,6 +2448,34 @@ void RemoteServer::CloseCapture(IReplayController *rend)
   }
 }
 
+RemoteServerStats RemoteServer::GetSessionStats()
+{
+  {
+    WRITE_DATA_SCOPE();
+    SCOPED_SERIALISE_CHUNK(eRemoteServer_GetSessionStats);
+  }
+
+  RemoteServerStats stats;
+
+  {
+    READ_DATA_SCOPE();
+    RemoteServerPacket type = ser.ReadChunk<RemoteServerPacket>();
+
+    if(type == eRemoteServer_GetSessionStats)
+    {
+      SERIALISE_ELEMENT(stats);
+    }
+    else
+    {
+      RDCERR("Unexpected response to session stats request");
+    }
+
+    ser.EndChunk();
+  }
+
+  return stats;
+}
+
 rdcstr RemoteServer::DriverName()
 {
   if(!Connected())
@@ -1910,7 +2684,7 @@ bytebuf RemoteServer::GetSectionContents(int index)
 
     if(type == eRemoteServer_GetSectionContents)
     {
-      SERIALISE_ELEMENT(contents);
+      AdaptiveBufferReceive(ser.GetReader(), contents, *m_RecvCodec);
     }
     else
     {
@@ -1937,7 +2711,7 @@ ResultDetails RemoteServer::WriteSection(const SectionProperties &props, const b
     WRITE_DATA_SCOPE();
     SCOPED_SERIALISE_CHUNK(eRemoteServer_WriteSection);
     SERIALISE_ELEMENT(props);
-    SERIALISE_ELEMENT(contents);
+    AdaptiveBufferSend(ser.GetWriter(), contents, *m_SendCodec);
   }
 
   RDResult success;
@@ -2071,3 +2845,183 @@ rdcarray<rdcstr> RemoteServer::GetResolve(const rdcarray<uint64_t> &callstack)
 
   return StackFrames;
 }
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+TEST_CASE("Test remote server scheduling", "[remoteserver]")
+{
+  SECTION("Waiters are served in the order they arrived")
+  {
+    FairSemaphore sem(1);
+
+    CHECK(sem.Acquire() == 0.0);
+
+    Threading::CriticalSection lock;
+    rdcarray<int> order;
+    rdcarray<Threading::ThreadHandle> threads;
+
+    for(int i = 0; i < 4; i++)
+    {
+      threads.push_back(Threading::CreateThread([&sem, &lock, &order, i]() {
+        sem.Acquire();
+        {
+          SCOPED_LOCK(lock);
+          order.push_back(i);
+        }
+        Threading::Sleep(5);
+        sem.Release();
+      }));
+
+      // make sure each thread is queued before starting the next
+      while(sem.GetWaiters() < uint32_t(i + 1))
+        Threading::Sleep(1);
+    }
+
+    CHECK(sem.GetHolders() == 1);
+    CHECK_FALSE(sem.TryAcquire());
+
+    sem.Release();
+
+    for(Threading::ThreadHandle t : threads)
+    {
+      Threading::JoinThread(t);
+      Threading::CloseThread(t);
+    }
+
+    CHECK(order == rdcarray<int>({0, 1, 2, 3}));
+    CHECK(sem.GetHolders() == 0);
+  };
+
+  SECTION("The count limits how many hold it at once")
+  {
+    FairSemaphore sem(2);
+
+    CHECK(sem.TryAcquire());
+    CHECK(sem.TryAcquire());
+    CHECK_FALSE(sem.TryAcquire());
+    CHECK(sem.GetHolders() == 2);
+
+    sem.Release();
+
+    CHECK(sem.TryAcquire());
+
+    sem.Release();
+    sem.Release();
+
+    CHECK(sem.GetHolders() == 0);
+  };
+
+  SECTION("Cancelled waiters leave the queue")
+  {
+    FairSemaphore sem(1);
+
+    sem.Acquire();
+
+    bool cancel = false;
+    double waited = 0.0;
+
+    Threading::ThreadHandle t = Threading::CreateThread(
+        [&sem, &cancel, &waited]() { waited = sem.Acquire([&cancel]() { return cancel; }); });
+
+    while(sem.GetWaiters() < 1)
+      Threading::Sleep(1);
+
+    cancel = true;
+
+    Threading::JoinThread(t);
+    Threading::CloseThread(t);
+
+    CHECK(waited < 0.0);
+    CHECK(sem.GetWaiters() == 0);
+
+    // the cancelled waiter doesn't hold up anyone behind it
+    sem.Release();
+    CHECK(sem.TryAcquire());
+    sem.Release();
+  };
+};
+
+TEST_CASE("Test remote server with multiple clients", "[remoteserver]")
+{
+  // find a free port near the usual one
+  Network::Socket *sock = NULL;
+  uint16_t port = RenderDoc_RemoteServerPort + 100;
+  for(; sock == NULL && port < RenderDoc_RemoteServerPort + 200; port++)
+    sock = Network::CreateServerSocket("127.0.0.1", port, 1);
+  port--;
+
+  REQUIRE(sock);
+
+  RemoteServerLimits limits;
+  limits.maxClients = 2;
+  limits.maxReplays = 1;
+
+  bool kill = false;
+
+  Threading::ThreadHandle server = Threading::CreateThread([sock, limits, &kill]() {
+    ServeRemoteClients(sock, {}, false, limits, [&kill]() { return kill; },
+                       RENDERDOC_PreviewWindowCallback());
+  });
+
+  rdcstr URL = StringFormat::Fmt("localhost:%u", port);
+
+  IRemoteServer *a = NULL, *b = NULL, *c = NULL;
+
+  CHECK(RENDERDOC_CreateRemoteServerConnection(URL, &a).code == ResultCode::Succeeded);
+  CHECK(RENDERDOC_CreateRemoteServerConnection(URL, &b).code == ResultCode::Succeeded);
+
+  REQUIRE(a);
+  REQUIRE(b);
+
+  // a third client is turned away while both slots are taken
+  CHECK(RENDERDOC_CreateRemoteServerConnection(URL, &c).code == ResultCode::NetworkRemoteBusy);
+  CHECK(c == NULL);
+
+  RemoteServerStats statsA = a->GetSessionStats();
+  RemoteServerStats statsB = b->GetSessionStats();
+
+  CHECK(statsA.session != 0);
+  CHECK(statsB.session != 0);
+  CHECK(statsA.session != statsB.session);
+  CHECK(statsA.activeClients == 2);
+  CHECK(statsB.activeClients == 2);
+  CHECK(statsA.maxClients == 2);
+  CHECK(statsA.maxReplays == 1);
+  CHECK(statsA.openReplays == 0);
+  CHECK(statsA.replayRequests == 0);
+
+  // both sessions keep working while the other is connected
+  CHECK(a->Ping().OK());
+  CHECK(b->Ping().OK());
+
+  // once one leaves, its slot is free for a new client once the server notices
+  a->ShutdownConnection();
+  a = NULL;
+
+  for(int i = 0; i < 100 && c == NULL; i++)
+  {
+    if(RENDERDOC_CreateRemoteServerConnection(URL, &c).code != ResultCode::Succeeded)
+      Threading::Sleep(20);
+  }
+
+  REQUIRE(c);
+
+  RemoteServerStats statsC = c->GetSessionStats();
+
+  CHECK(statsC.session != statsA.session);
+  CHECK(statsC.session != statsB.session);
+  CHECK(statsC.activeClients == 2);
+
+  CHECK(b->Ping().OK());
+
+  b->ShutdownConnection();
+  c->ShutdownConnection();
+
+  kill = true;
+  Threading::JoinThread(server);
+  Threading::CloseThread(server);
+};
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -36,6 +36,7 @@ enum class RDCDriver : uint32_t;
 
 class WriteSerialiser;
 class ReadSerialiser;
+class AdaptiveCodec;
 
 struct RemoteServer : public IRemoteServer
 {
@@ -78,6 +79,8 @@ public:
 
   virtual void CloseCapture(IReplayController *rend);
 
+  virtual RemoteServerStats GetSessionStats();
+
   virtual rdcstr DriverName();
 
   virtual rdcarray<GPUDevice> GetAvailableGPUs();
@@ -100,12 +103,39 @@ public:
 
   virtual rdcarray<rdcstr> GetResolve(const rdcarray<uint64_t> &callstack);
 
+  // set where we connected to and the session we were given, for reconnecting, and the codecs
+  // negotiated in the handshake
+  void SetConnectionInfo(const rdcstr &host, uint16_t port, uint32_t networkCodecs,
+                         uint64_t session);
+
 protected:
+  void CreateSerialisers();
+  void SetNetworkCodecs(uint32_t networkCodecs);
+
+  // replace a dropped connection with a new one to the same server, resuming the same session so
+  // that temporary capture copies on the server are kept.
+  bool Reconnect();
+
+  bool DownloadCapture(const rdcstr &remotepath, const rdcstr &partialPath,
+                       RENDERDOC_ProgressCallback progress);
+  // returns the path on the server, or an empty path if the copy failed. retry is set if the copy
+  // was interrupted and can be resumed, rather than refused.
+  rdcstr UploadCapture(uint64_t transferKey, const rdcstr &filename, bool &retry,
+                       RENDERDOC_ProgressCallback progress);
+
   Network::Socket *m_Socket;
   WriteSerialiser *writer;
   ReadSerialiser *reader;
   FileIO::LogFileHandle *debugLog;
   rdcstr m_deviceID;
 
+  rdcstr m_Host;
+  uint16_t m_Port = 0;
+  uint64_t m_Session = 0;
+
+  uint32_t m_NetworkCodecs = 0;
+  AdaptiveCodec *m_SendCodec = NULL;
+  AdaptiveCodec *m_RecvCodec = NULL;
+
   rdcarray<rdcpair<RDCDriver, rdcstr>> m_Proxies;
 };
@@ -25,9 +25,12 @@
 
 #include "replay_proxy.h"
 #include <list>
-#include "lz4/lz4.h"
+#include "core/settings.h"
 #include "replay/dummy_driver.h"
-#include "serialise/lz4io.h"
+
+RDOC_CONFIG(uint32_t, RemoteServer_DeltaMergeGap, 128,
+            "When sending changes to buffer and texture data, changes separated by at most this "
+            "many unchanged bytes are sent together.");
 
 template <>
 rdcstr DoStringise(const ReplayProxyPacket &el)
@@ -97,6 +100,8 @@ rdcstr DoStringise(const ReplayProxyPacket &el)
 
     STRINGISE_ENUM_NAMED(eReplayProxy_ContinueDebug, "ContinueDebug");
     STRINGISE_ENUM_NAMED(eReplayProxy_FreeDebugger, "FreeDebugger");
+
+    STRINGISE_ENUM_NAMED(eReplayProxy_GetReplayMemoryStats, "GetReplayMemoryStats");
   }
   END_ENUM_STRINGISE();
 }
@@ -104,26 +109,43 @@ rdcstr DoStringise(const ReplayProxyPacket &el)
 // utility macros for implementing proxied functions
 
 // begins a chunk with the given packet type, and if reading verifies that the
-// read type was what was expected - otherwise sets an error flag
-#define PACKET_HEADER(packet)                                         \
-  ReplayProxyPacket p = (ReplayProxyPacket)ser.BeginChunk(packet, 0); \
-  if(ser.IsReading() && p != packet)                                  \
-    m_IsErrored = true;
+// read type was what was expected - otherwise sets an error flag. The reply also carries the ID of
+// the request it answers, which must be the one we're waiting for.
+#define PACKET_HEADER(packet)                                      \
+  uint32_t replyID = m_RequestID;                                  \
+  ReplayProxyPacket p = BeginReplyChunk(ser, packet, replyID);     \
+  if(ser.IsReading() && p != packet)                               \
+    m_IsErrored = true;                                            \
+  if(ser.IsReading() && replyID != m_RequestID)                    \
+    CheckRequestID(replyID);
 
 // begins the set of parameters. Note that we only begin a chunk when writing (sending a request to
 // the remote server), since on reading the chunk has already been begun to read the type to
-// dispatch to the correct function.
-#define BEGIN_PARAMS()             \
-  ParamSerialiser &ser = paramser; \
-  if(ser.IsWriting())              \
+// dispatch to the correct function. When reading the reply to a pipelined request the parameters
+// were already sent, so they're serialised to a scratch serialiser instead.
+#define BEGIN_PARAMS()                                  \
+  ParamSerialiser &ser = BeginPipelineParams(paramser); \
+  if(ser.IsWriting())                                   \
     ser.BeginChunk(packet, 0);
 
-// end the set of parameters, and that chunk.
-#define END_PARAMS()                                \
-  {                                                 \
-    GET_SERIALISER.Serialise("packet"_lit, packet); \
-    ser.EndChunk();                                 \
-    CheckError(packet, expectedPacket);             \
+// end the set of parameters, and that chunk. Each new request sent is given the next request ID.
+#define END_PARAMS()                                               \
+  {                                                                \
+    if(ser.IsWriting() && m_ParamsPhase != PipelinePhase::Receive) \
+      m_RequestID = ++m_NextRequestID;                             \
+    GET_SERIALISER.Serialise("requestID"_lit, m_RequestID);        \
+    GET_SERIALISER.Serialise("packet"_lit, packet);                \
+    ser.EndChunk();                                                \
+    CheckError(packet, expectedPacket);                            \
+  }
+
+// for functions that can be pipelined, return once the request has been sent if that's all that
+// was asked for. The function is run again in the receive phase to read the reply.
+#define PIPELINE_SEND_RETURN(retval)       \
+  if(m_ParamsPhase == PipelinePhase::Send) \
+  {                                        \
+    m_PipelineSent = true;                 \
+    return retval;                         \
   }
 
 // begin serialising a return value. We begin a chunk here in either the writing or reading case
@@ -194,18 +216,22 @@ struct RemoteExecution
 #endif
 
 // dispatches to the right implementation of the Proxied_ function, depending on whether we're on
-// the remote server or not.
+// the remote server or not. Synchronous calls on the host read the replies for any pipelined
+// requests still in flight first, so that the next reply read is their own.
 #define PROXY_FUNCTION(name, ...)                                     \
   PROXY_DEBUG("Proxying out %s", #name);                              \
   if(m_RemoteServer)                                                  \
     return CONCAT(Proxied_, name)(m_Reader, m_Writer, ##__VA_ARGS__); \
-  else                                                                \
-    return CONCAT(Proxied_, name)(m_Writer, m_Reader, ##__VA_ARGS__);
+  WaitForAllRequests();                                               \
+  return CONCAT(Proxied_, name)(m_Writer, m_Reader, ##__VA_ARGS__);
 
 ReplayProxy::ReplayProxy(ReadSerialiser &reader, WriteSerialiser &writer, IRemoteDriver *remoteDriver,
-                         IReplayDriver *replayDriver, RENDERDOC_PreviewWindowCallback previewWindow)
+                         IReplayDriver *replayDriver, RENDERDOC_PreviewWindowCallback previewWindow,
+                         uint32_t networkCodecs)
     : m_Reader(reader),
       m_Writer(writer),
+      m_SendCodec(networkCodecs),
+      m_RecvCodec(networkCodecs),
       m_Proxy(NULL),
       m_Remote(remoteDriver),
       m_Replay(replayDriver),
@@ -234,9 +260,12 @@ ReplayProxy::ReplayProxy(ReadSerialiser &reader, WriteSerialiser &writer, IRemot
                               m_VulkanPipelineState);
 }
 
-ReplayProxy::ReplayProxy(ReadSerialiser &reader, WriteSerialiser &writer, IReplayDriver *proxy)
+ReplayProxy::ReplayProxy(ReadSerialiser &reader, WriteSerialiser &writer, IReplayDriver *proxy,
+                         uint32_t networkCodecs)
     : m_Reader(reader),
       m_Writer(writer),
+      m_SendCodec(networkCodecs),
+      m_RecvCodec(networkCodecs),
       m_Proxy(proxy),
       m_Remote(NULL),
       m_Replay(NULL),
@@ -244,13 +273,19 @@ ReplayProxy::ReplayProxy(ReadSerialiser &reader, WriteSerialiser &writer, IRepla
 {
   m_StructuredFile = new SDFile;
 
+  m_DiscardParams =
+      new WriteSerialiser(new StreamWriter(StreamWriter::DefaultScratchSize), Ownership::Stream);
+
   ReplayProxy::GetAPIProperties();
   ReplayProxy::FetchStructuredFile();
 }
 
 ReplayProxy::~ReplayProxy()
 {
+  WaitForAllRequests();
+
   SAFE_DELETE(m_StructuredFile);
+  SAFE_DELETE(m_DiscardParams);
   if(m_Remote)
   {
     SAFE_DELETE(m_D3D11PipelineState);
@@ -271,6 +306,165 @@ ReplayProxy::~ReplayProxy()
     delete it->second;
 }
 
+#pragma region Pipelining
+
+template <typename T, typename... FuncArgs, typename... Args>
+void ReplayProxy::PipelineRequest(ProxyFuture<T> &future,
+                                  T (ReplayProxy::*func)(WriteSerialiser &, ReadSerialiser &,
+                                                         FuncArgs...),
+                                  Args... args)
+{
+  RDCASSERT(!m_RemoteServer);
+
+  // finish whatever this future was last used for
+  future.Wait();
+
+  m_PipelineSent = false;
+  m_PipelinePhase = PipelinePhase::Send;
+  future.m_Value = (this->*func)(m_Writer, m_Reader, args...);
+  m_PipelinePhase = m_ParamsPhase = PipelinePhase::SendAndReceive;
+
+  // if the request wasn't left pending the result is already in the future
+  if(!m_PipelineSent)
+    return;
+
+  future.m_Proxy = this;
+  future.m_RequestID = m_RequestID;
+
+  m_PendingRequests.push_back({m_RequestID, &future, [this, func, args...](void *d) {
+                                 ProxyFuture<T> *dest = (ProxyFuture<T> *)d;
+                                 m_PipelinePhase = PipelinePhase::Receive;
+                                 m_RequestID = dest->m_RequestID;
+                                 dest->m_Value = (this->*func)(m_Writer, m_Reader, args...);
+                                 m_PipelinePhase = m_ParamsPhase = PipelinePhase::SendAndReceive;
+                                 m_DiscardParams->GetWriter()->Rewind();
+                                 dest->m_Proxy = NULL;
+                               }});
+}
+
+void ReplayProxy::WaitForRequest(uint32_t requestID)
+{
+  // read replies, in whatever order they arrive, until this request's has been read
+  for(;;)
+  {
+    bool pending = false;
+    for(const PendingRequest &req : m_PendingRequests)
+      pending |= (req.requestID == requestID);
+
+    if(!pending)
+      return;
+
+    ReceiveNextReply();
+  }
+}
+
+void ReplayProxy::WaitForAllRequests()
+{
+  while(!m_PendingRequests.empty())
+    ReceiveNextReply();
+}
+
+void ReplayProxy::ReceiveNextReply()
+{
+  // every reply is preceded by the remote execution packets for its request
+  if(!m_IsErrored)
+    EndRemoteExecution();
+
+  // if nothing more can be read, the requests are abandoned with their default results
+  if(m_IsErrored || m_Reader.IsErrored() || m_Writer.IsErrored())
+  {
+    m_PendingRequests.clear();
+    return;
+  }
+
+  m_PeekedPacket = (ReplayProxyPacket)m_Reader.BeginChunk(0, 0);
+  m_Reader.Serialise("requestID"_lit, m_PeekedReplyID);
+
+  size_t idx = ~0U;
+  for(size_t i = 0; i < m_PendingRequests.size(); i++)
+    if(m_PendingRequests[i].requestID == m_PeekedReplyID)
+      idx = i;
+
+  if(idx == ~0U)
+  {
+    RDCERR("Received reply to %u which isn't pending", m_PeekedReplyID);
+    m_IsErrored = true;
+    m_PendingRequests.clear();
+    return;
+  }
+
+  PendingRequest req = m_PendingRequests[idx];
+  m_PendingRequests.erase(idx);
+
+  m_ReplyPeeked = true;
+  req.receive(req.dest);
+  m_ReplyPeeked = false;
+}
+
+void ReplayProxy::RetargetRequest(uint32_t requestID, void *dest)
+{
+  for(PendingRequest &req : m_PendingRequests)
+    if(req.requestID == requestID)
+      req.dest = dest;
+}
+
+ReplayProxyPacket ReplayProxy::BeginReplyChunk(WriteSerialiser &ser, ReplayProxyPacket packet,
+                                               uint32_t &replyID)
+{
+  ser.BeginChunk(packet, 0);
+  ser.Serialise("requestID"_lit, replyID);
+  return packet;
+}
+
+ReplayProxyPacket ReplayProxy::BeginReplyChunk(ReadSerialiser &ser, ReplayProxyPacket packet,
+                                               uint32_t &replyID)
+{
+  if(m_ReplyPeeked)
+  {
+    m_ReplyPeeked = false;
+    replyID = m_PeekedReplyID;
+    return m_PeekedPacket;
+  }
+
+  ReplayProxyPacket ret = (ReplayProxyPacket)ser.BeginChunk(packet, 0);
+  ser.Serialise("requestID"_lit, replyID);
+  return ret;
+}
+
+void ReplayProxy::FetchShaderReflections(const rdcarray<ShaderReflFetch> &fetches)
+{
+  if(fetches.empty())
+    return;
+
+  // look up every live ID, then fetch every reflection. Each set is pipelined so this costs at most
+  // two round trips however many shaders are bound.
+  rdcarray<ProxyFuture<ResourceId>> liveIDs;
+  liveIDs.resize(fetches.size() * 2);
+
+  for(size_t i = 0; i < fetches.size(); i++)
+  {
+    if(fetches[i].pipeline != ResourceId())
+      PipelineRequest(liveIDs[i * 2 + 0],
+                      &ReplayProxy::Proxied_GetLiveID<WriteSerialiser, ReadSerialiser>,
+                      fetches[i].pipeline);
+    PipelineRequest(liveIDs[i * 2 + 1],
+                    &ReplayProxy::Proxied_GetLiveID<WriteSerialiser, ReadSerialiser>,
+                    fetches[i].shader);
+  }
+
+  rdcarray<ProxyFuture<ShaderReflection *>> refls;
+  refls.resize(fetches.size());
+
+  for(size_t i = 0; i < fetches.size(); i++)
+    PipelineRequest(refls[i], &ReplayProxy::Proxied_GetShader<WriteSerialiser, ReadSerialiser>,
+                    liveIDs[i * 2 + 0].Get(), liveIDs[i * 2 + 1].Get(), fetches[i].entry);
+
+  for(size_t i = 0; i < fetches.size(); i++)
+    *fetches[i].reflection = refls[i].Get();
+}
+
+#pragma endregion Pipelining
+
 #pragma region Proxied Functions
 
 template <typename ParamSerialiser, typename ReturnSerialiser>
@@ -428,6 +622,35 @@ rdcarray<GPUDevice> ReplayProxy::GetAvailableGPUs()
   PROXY_FUNCTION(GetAvailableGPUs);
 }
 
+template <typename ParamSerialiser, typename ReturnSerialiser>
+ReplayMemoryStats ReplayProxy::Proxied_GetReplayMemoryStats(ParamSerialiser &paramser,
+                                                            ReturnSerialiser &retser)
+{
+  const ReplayProxyPacket expectedPacket = eReplayProxy_GetReplayMemoryStats;
+  ReplayProxyPacket packet = eReplayProxy_GetReplayMemoryStats;
+  ReplayMemoryStats ret = {};
+
+  {
+    BEGIN_PARAMS();
+    END_PARAMS();
+  }
+
+  {
+    REMOTE_EXECUTION();
+    if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
+      ret = m_Remote->GetReplayMemoryStats();
+  }
+
+  SERIALISE_RETURN(ret);
+
+  return ret;
+}
+
+ReplayMemoryStats ReplayProxy::GetReplayMemoryStats()
+{
+  PROXY_FUNCTION(GetReplayMemoryStats);
+}
+
 template <typename ParamSerialiser, typename ReturnSerialiser>
 rdcarray<DebugMessage> ReplayProxy::Proxied_GetDebugMessages(ParamSerialiser &paramser,
                                                              ReturnSerialiser &retser)
@@ -506,6 +729,8 @@ TextureDescription ReplayProxy::Proxied_GetTexture(ParamSerialiser &paramser,
     END_PARAMS();
   }
 
+  PIPELINE_SEND_RETURN(ret);
+
   {
     REMOTE_EXECUTION();
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
@@ -597,6 +822,8 @@ BufferDescription ReplayProxy::Proxied_GetBuffer(ParamSerialiser &paramser,
     END_PARAMS();
   }
 
+  PIPELINE_SEND_RETURN(ret);
+
   {
     REMOTE_EXECUTION();
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
@@ -657,6 +884,8 @@ rdcarray<EventUsage> ReplayProxy::Proxied_GetUsage(ParamSerialiser &paramser,
     END_PARAMS();
   }
 
+  PIPELINE_SEND_RETURN(ret);
+
   {
     REMOTE_EXECUTION();
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
@@ -673,6 +902,47 @@ rdcarray<EventUsage> ReplayProxy::GetUsage(ResourceId id)
   PROXY_FUNCTION(GetUsage, id);
 }
 
+rdcarray<rdcarray<EventUsage>> ReplayProxy::GetUsages(const rdcarray<ResourceId> &ids)
+{
+  // look up every live ID, then fetch every usage. Both are pipelined so this costs a handful of
+  // round trips however many resources there are. Only a window of requests is kept in flight, so
+  // that neither end can fill its socket buffer with replies the other isn't reading yet.
+  const size_t window = 256;
+
+  rdcarray<ProxyFuture<ResourceId>> liveIDs;
+  liveIDs.resize(ids.size());
+
+  for(size_t i = 0; i < ids.size(); i++)
+  {
+    if(i >= window)
+      liveIDs[i - window].Get();
+    PipelineRequest(liveIDs[i], &ReplayProxy::Proxied_GetLiveID<WriteSerialiser, ReadSerialiser>,
+                    ids[i]);
+  }
+
+  rdcarray<ProxyFuture<rdcarray<EventUsage>>> usages;
+  usages.resize(ids.size());
+
+  for(size_t i = 0; i < ids.size(); i++)
+  {
+    if(i >= window)
+      usages[i - window].Get();
+
+    ResourceId liveId = liveIDs[i].Get();
+    if(liveId != ResourceId())
+      PipelineRequest(usages[i], &ReplayProxy::Proxied_GetUsage<WriteSerialiser, ReadSerialiser>,
+                      liveId);
+  }
+
+  rdcarray<rdcarray<EventUsage>> ret;
+  ret.resize(ids.size());
+
+  for(size_t i = 0; i < ids.size(); i++)
+    ret[i] = usages[i].Get();
+
+  return ret;
+}
+
 template <typename ParamSerialiser, typename ReturnSerialiser>
 FrameRecord ReplayProxy::Proxied_GetFrameRecord(ParamSerialiser &paramser, ReturnSerialiser &retser)
 {
@@ -696,7 +966,8 @@ FrameRecord ReplayProxy::Proxied_GetFrameRecord(ParamSerialiser &paramser, Retur
   if(paramser.IsWriting())
   {
     // re-configure the action pointers, since they will be invalid
-    SetupActionPointers(m_Actions, ret.actionList);
+    ActionIndex index;
+    index.Build(ret.actionList);
   }
 
   return ret;
@@ -711,7 +982,7 @@ template <typename ParamSerialiser, typename ReturnSerialiser>
 ResourceId ReplayProxy::Proxied_GetLiveID(ParamSerialiser &paramser, ReturnSerialiser &retser,
                                           ResourceId id)
 {
-  if(paramser.IsWriting())
+  if(paramser.IsWriting() && m_PipelinePhase != PipelinePhase::Receive)
   {
     if(m_LiveIDs.find(id) != m_LiveIDs.end())
       return m_LiveIDs[id];
@@ -733,6 +1004,8 @@ ResourceId ReplayProxy::Proxied_GetLiveID(ParamSerialiser &paramser, ReturnSeria
     END_PARAMS();
   }
 
+  PIPELINE_SEND_RETURN(ret);
+
   {
     REMOTE_EXECUTION();
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
@@ -804,6 +1077,21 @@ rdcarray<GPUCounter> ReplayProxy::Proxied_EnumerateCounters(ParamSerialiser &par
 
   SERIALISE_RETURN(ret);
 
+  // the UI describes every counter straight after enumerating them, so pipeline those requests now
+  // rather than paying a round trip for each.
+  if(retser.IsReading() && !m_IsErrored && !ret.empty())
+  {
+    rdcarray<ProxyFuture<CounterDescription>> descs;
+    descs.resize(ret.size());
+
+    for(size_t i = 0; i < ret.size(); i++)
+      PipelineRequest(descs[i],
+                      &ReplayProxy::Proxied_DescribeCounter<WriteSerialiser, ReadSerialiser>,
+                      ret[i]);
+
+    // the futures wait for their replies as they're destroyed, which caches each description
+  }
+
   return ret;
 }
 
@@ -817,6 +1105,14 @@ CounterDescription ReplayProxy::Proxied_DescribeCounter(ParamSerialiser &paramse
                                                         ReturnSerialiser &retser,
                                                         GPUCounter counterID)
 {
+  // descriptions are fetched for every counter up front when they're enumerated
+  if(paramser.IsWriting() && m_PipelinePhase != PipelinePhase::Receive)
+  {
+    auto it = m_CounterDescriptions.find(counterID);
+    if(it != m_CounterDescriptions.end())
+      return it->second;
+  }
+
   const ReplayProxyPacket expectedPacket = eReplayProxy_DescribeCounter;
   ReplayProxyPacket packet = eReplayProxy_DescribeCounter;
   CounterDescription ret = {};
@@ -827,6 +1123,8 @@ CounterDescription ReplayProxy::Proxied_DescribeCounter(ParamSerialiser &paramse
     END_PARAMS();
   }
 
+  PIPELINE_SEND_RETURN(ret);
+
   {
     REMOTE_EXECUTION();
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
@@ -835,6 +1133,9 @@ CounterDescription ReplayProxy::Proxied_DescribeCounter(ParamSerialiser &paramse
 
   SERIALISE_RETURN(ret);
 
+  if(retser.IsReading() && !m_IsErrored)
+    m_CounterDescriptions[counterID] = ret;
+
   return ret;
 }
 
@@ -916,12 +1217,14 @@ void ReplayProxy::Proxied_GetBufferData(ParamSerialiser &paramser, ReturnSeriali
 
   char empty[128] = {};
 
-  // lz4 compress
+  // compress with whichever codec suits the link
   if(retser.IsReading())
   {
-    ReadSerialiser ser(new StreamReader(new LZ4Decompressor(retser.GetReader(), Ownership::Nothing),
-                                        dataSize, Ownership::Stream),
-                       Ownership::Stream);
+    ReadSerialiser ser(
+        new StreamReader(
+            new AdaptiveDecompressor(retser.GetReader(), m_RecvCodec, Ownership::Nothing),
+            dataSize, Ownership::Stream),
+        Ownership::Stream);
 
     SERIALISE_ELEMENT(retData);
 
@@ -934,9 +1237,11 @@ void ReplayProxy::Proxied_GetBufferData(ParamSerialiser &paramser, ReturnSeriali
   }
   else
   {
-    WriteSerialiser ser(new StreamWriter(new LZ4Compressor(retser.GetWriter(), Ownership::Nothing),
-                                         Ownership::Stream),
-                        Ownership::Stream);
+    WriteSerialiser ser(
+        new StreamWriter(
+            new AdaptiveCompressor(retser.GetWriter(), m_SendCodec, Ownership::Nothing),
+            Ownership::Stream),
+        Ownership::Stream);
 
     SERIALISE_ELEMENT(retData);
 
@@ -994,12 +1299,14 @@ void ReplayProxy::Proxied_GetTextureData(ParamSerialiser &paramser, ReturnSerial
 
   char empty[128] = {};
 
-  // lz4 compress
+  // compress with whichever codec suits the link
   if(retser.IsReading())
   {
-    ReadSerialiser ser(new StreamReader(new LZ4Decompressor(retser.GetReader(), Ownership::Nothing),
-                                        dataSize, Ownership::Stream),
-                       Ownership::Stream);
+    ReadSerialiser ser(
+        new StreamReader(
+            new AdaptiveDecompressor(retser.GetReader(), m_RecvCodec, Ownership::Nothing),
+            dataSize, Ownership::Stream),
+        Ownership::Stream);
 
     SERIALISE_ELEMENT(data);
 
@@ -1012,9 +1319,11 @@ void ReplayProxy::Proxied_GetTextureData(ParamSerialiser &paramser, ReturnSerial
   }
   else
   {
-    WriteSerialiser ser(new StreamWriter(new LZ4Compressor(retser.GetWriter(), Ownership::Nothing),
-                                         Ownership::Stream),
-                        Ownership::Stream);
+    WriteSerialiser ser(
+        new StreamWriter(
+            new AdaptiveCompressor(retser.GetWriter(), m_SendCodec, Ownership::Nothing),
+            Ownership::Stream),
+        Ownership::Stream);
 
     SERIALISE_ELEMENT(data);
 
@@ -1206,7 +1515,8 @@ ShaderReflection *ReplayProxy::Proxied_GetShader(ParamSerialiser &paramser,
   // only consider eventID part of the key on APIs where shaders are mutable
   ShaderReflKey key(m_APIProps.shadersMutable ? m_EventID : 0, pipeline, shader, entry);
 
-  if(retser.IsReading() && m_ShaderReflectionCache.find(key) != m_ShaderReflectionCache.end())
+  if(retser.IsReading() && m_PipelinePhase != PipelinePhase::Receive &&
+     m_ShaderReflectionCache.find(key) != m_ShaderReflectionCache.end())
     return m_ShaderReflectionCache[key];
 
   {
@@ -1217,6 +1527,8 @@ ShaderReflection *ReplayProxy::Proxied_GetShader(ParamSerialiser &paramser,
     END_PARAMS();
   }
 
+  PIPELINE_SEND_RETURN(ret);
+
   {
     REMOTE_EXECUTION();
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
@@ -1231,10 +1543,15 @@ ShaderReflection *ReplayProxy::Proxied_GetShader(ParamSerialiser &paramser,
     ser.EndChunk();
 
     // if we're reading, we should have checked the cache above. If we didn't, we need to steal the
-    // serialised pointer here into our cache
+    // serialised pointer here into our cache. Two pipelined requests for the same shader can both
+    // miss the cache, in which case the first reply is kept since it may already be referenced.
     if(ser.IsReading())
     {
-      m_ShaderReflectionCache[key] = ret;
+      ShaderReflection *&cached = m_ShaderReflectionCache[key];
+      if(cached)
+        delete ret;
+      else
+        cached = ret;
       ret = NULL;
     }
   }
@@ -1709,6 +2026,250 @@ void ReplayProxy::FreeDebugger(ShaderDebugger *debugger)
   PROXY_FUNCTION(FreeDebugger, debugger);
 }
 
+// The pipeline state is sent as a delta against the last state sent. For the large arrays in the
+// state - descriptor sets and their bindings, image layouts, GL binding points - the remote side
+// keeps a copy of what it last sent and only serialises the elements that differ, as runs of
+// changed indices. The local side applies those in place to the state it last received, so
+// unchanged elements are neither sent nor reallocated. Everything else is small and sent in full.
+//
+// When writing, 'prev' is the matching element of the previously sent array and is updated to the
+// new contents. When reading it's NULL since the element being read into holds the previous
+// contents already.
+template <typename SerialiserType, typename T>
+static bool SerialiseDeltaElement(SerialiserType &ser, T &el, T *prev);
+template <typename SerialiserType>
+static bool SerialiseDeltaElement(SerialiserType &ser, VKPipe::DescriptorSet &el,
+                                  VKPipe::DescriptorSet *prev);
+template <typename SerialiserType>
+static bool SerialiseDeltaElement(SerialiserType &ser, VKPipe::DescriptorBinding &el,
+                                  VKPipe::DescriptorBinding *prev);
+
+template <typename T>
+static bool DeltaEqual(const T &a, const T &b)
+{
+  return a == b;
+}
+
+// some structs' comparison operators skip fields that can change from event to event. Those need a
+// comparison here that covers every serialised field, or the changes would never be sent.
+static bool DeltaEqual(const VKPipe::BindingElement &a, const VKPipe::BindingElement &b);
+static bool DeltaEqual(const VKPipe::DescriptorBinding &a, const VKPipe::DescriptorBinding &b);
+
+template <typename T>
+static bool DeltaEqual(const rdcarray<T> &a, const rdcarray<T> &b)
+{
+  if(a.size() != b.size())
+    return false;
+
+  for(size_t i = 0; i < a.size(); i++)
+    if(!DeltaEqual(a[i], b[i]))
+      return false;
+
+  return true;
+}
+
+static bool DeltaEqual(const VKPipe::ImageData &a, const VKPipe::ImageData &b)
+{
+  // ImageData's comparison only looks at the resource, we want to resend changed layouts
+  return a.resourceId == b.resourceId && a.layouts == b.layouts;
+}
+
+static bool DeltaEqual(const VKPipe::BindingElement &a, const VKPipe::BindingElement &b)
+{
+  // BindingElement's comparison skips the ycbcr conversion, which is filled in per event
+  return a == b && a.ycbcrSampler == b.ycbcrSampler && a.ycbcrModel == b.ycbcrModel &&
+         a.ycbcrRange == b.ycbcrRange && a.ycbcrSwizzle == b.ycbcrSwizzle &&
+         a.xChromaOffset == b.xChromaOffset && a.yChromaOffset == b.yChromaOffset &&
+         a.chromaFilter == b.chromaFilter &&
+         a.forceExplicitReconstruction == b.forceExplicitReconstruction;
+}
+
+static bool DeltaEqual(const VKPipe::DescriptorBinding &a, const VKPipe::DescriptorBinding &b)
+{
+  return a.descriptorCount == b.descriptorCount &&
+         a.dynamicallyUsedCount == b.dynamicallyUsedCount &&
+         a.firstUsedIndex == b.firstUsedIndex && a.lastUsedIndex == b.lastUsedIndex &&
+         a.type == b.type && a.stageFlags == b.stageFlags && DeltaEqual(a.binds, b.binds);
+}
+
+static bool DeltaEqual(const VKPipe::DescriptorSet &a, const VKPipe::DescriptorSet &b)
+{
+  return a.layoutResourceId == b.layoutResourceId &&
+         a.descriptorSetResourceId == b.descriptorSetResourceId &&
+         a.pushDescriptor == b.pushDescriptor && a.inlineData == b.inlineData &&
+         DeltaEqual(a.bindings, b.bindings);
+}
+
+static bool DeltaEqual(const GLPipe::Texture &a, const GLPipe::Texture &b)
+{
+  // Texture's comparison skips the completeness status, which is checked per event
+  return a == b && a.completeStatus == b.completeStatus;
+}
+
+template <typename SerialiserType, typename T>
+static bool SerialiseArrayDelta(SerialiserType &ser, rdcarray<T> &arr, rdcarray<T> &prev)
+{
+  uint64_t count = arr.size();
+  // pairs of (first index, count) for each run of changed elements
+  rdcarray<uint32_t> runs;
+
+  if(ser.IsWriting())
+  {
+    for(uint32_t i = 0; i < arr.size(); i++)
+    {
+      if(i < prev.size() && DeltaEqual(arr[i], prev[i]))
+        continue;
+
+      if(!runs.empty() && runs[runs.size() - 2] + runs.back() == i)
+      {
+        runs.back()++;
+      }
+      else
+      {
+        runs.push_back(i);
+        runs.push_back(1);
+      }
+    }
+
+    prev.resize(arr.size());
+  }
+
+  SERIALISE_ELEMENT(count);
+  SERIALISE_ELEMENT(runs);
+
+  if(ser.IsErrored())
+    return false;
+
+  if(ser.IsReading())
+    arr.resize((size_t)count);
+
+  for(size_t r = 0; r + 1 < runs.size(); r += 2)
+  {
+    if(uint64_t(runs[r]) + runs[r + 1] > arr.size())
+      return false;
+
+    for(uint32_t i = runs[r]; i < runs[r] + runs[r + 1]; i++)
+      if(!SerialiseDeltaElement(ser, arr[i], ser.IsWriting() ? &prev[i] : NULL))
+        return false;
+  }
+
+  return true;
+}
+
+template <typename SerialiserType, typename T>
+static bool SerialiseDeltaElement(SerialiserType &ser, T &el, T *prev)
+{
+  ser.Serialise("el"_lit, el);
+  if(prev)
+    *prev = el;
+  return true;
+}
+
+template <typename SerialiserType>
+static bool SerialiseDeltaElement(SerialiserType &ser, VKPipe::DescriptorBinding &el,
+                                  VKPipe::DescriptorBinding *prev)
+{
+  // bindless arrays can be huge and only a few elements typically change, e.g. which are
+  // dynamically used. Send the binding without its elements, then the elements as a delta.
+  rdcarray<VKPipe::BindingElement> binds;
+  binds.swap(el.binds);
+  ser.Serialise("binding"_lit, el);
+  el.binds.swap(binds);
+
+  rdcarray<VKPipe::BindingElement> unused;
+
+  if(prev)
+  {
+    binds.swap(el.binds);
+    unused.swap(prev->binds);
+    *prev = el;
+    prev->binds.swap(unused);
+    el.binds.swap(binds);
+  }
+
+  return SerialiseArrayDelta(ser, el.binds, prev ? prev->binds : unused);
+}
+
+template <typename SerialiserType>
+static bool SerialiseDeltaElement(SerialiserType &ser, VKPipe::DescriptorSet &el,
+                                  VKPipe::DescriptorSet *prev)
+{
+  rdcarray<VKPipe::DescriptorBinding> bindings;
+  bindings.swap(el.bindings);
+  ser.Serialise("set"_lit, el);
+  el.bindings.swap(bindings);
+
+  rdcarray<VKPipe::DescriptorBinding> unused;
+
+  if(prev)
+  {
+    bindings.swap(el.bindings);
+    unused.swap(prev->bindings);
+    *prev = el;
+    prev->bindings.swap(unused);
+    el.bindings.swap(bindings);
+  }
+
+  return SerialiseArrayDelta(ser, el.bindings, prev ? prev->bindings : unused);
+}
+
+template <typename SerialiserType>
+bool ReplayProxy::SerialisePipelineStateDelta(SerialiserType &ser, VKPipe::State &state)
+{
+  PipelineStateBaseline &prev = m_PipelineStateBaseline;
+
+  rdcarray<VKPipe::DescriptorSet> graphicsSets, computeSets;
+  rdcarray<VKPipe::ImageData> images;
+
+  graphicsSets.swap(state.graphics.descriptorSets);
+  computeSets.swap(state.compute.descriptorSets);
+  images.swap(state.images);
+
+  SERIALISE_ELEMENT(state);
+
+  state.graphics.descriptorSets.swap(graphicsSets);
+  state.compute.descriptorSets.swap(computeSets);
+  state.images.swap(images);
+
+  return SerialiseArrayDelta(ser, state.graphics.descriptorSets, prev.vkGraphicsSets) &&
+         SerialiseArrayDelta(ser, state.compute.descriptorSets, prev.vkComputeSets) &&
+         SerialiseArrayDelta(ser, state.images, prev.vkImages);
+}
+
+template <typename SerialiserType>
+bool ReplayProxy::SerialisePipelineStateDelta(SerialiserType &ser, GLPipe::State &state)
+{
+  PipelineStateBaseline &prev = m_PipelineStateBaseline;
+
+  rdcarray<GLPipe::Texture> textures;
+  rdcarray<GLPipe::Sampler> samplers;
+  rdcarray<GLPipe::Buffer> atomicBuffers, uniformBuffers, shaderStorageBuffers;
+  rdcarray<GLPipe::ImageLoadStore> images;
+
+  textures.swap(state.textures);
+  samplers.swap(state.samplers);
+  atomicBuffers.swap(state.atomicBuffers);
+  uniformBuffers.swap(state.uniformBuffers);
+  shaderStorageBuffers.swap(state.shaderStorageBuffers);
+  images.swap(state.images);
+
+  SERIALISE_ELEMENT(state);
+
+  state.textures.swap(textures);
+  state.samplers.swap(samplers);
+  state.atomicBuffers.swap(atomicBuffers);
+  state.uniformBuffers.swap(uniformBuffers);
+  state.shaderStorageBuffers.swap(shaderStorageBuffers);
+  state.images.swap(images);
+
+  return SerialiseArrayDelta(ser, state.textures, prev.glTextures) &&
+         SerialiseArrayDelta(ser, state.samplers, prev.glSamplers) &&
+         SerialiseArrayDelta(ser, state.atomicBuffers, prev.glAtomicBuffers) &&
+         SerialiseArrayDelta(ser, state.uniformBuffers, prev.glUniformBuffers) &&
+         SerialiseArrayDelta(ser, state.shaderStorageBuffers, prev.glShaderStorageBuffers) &&
+         SerialiseArrayDelta(ser, state.images, prev.glImages);
+}
+
 template <typename ParamSerialiser, typename ReturnSerialiser>
 void ReplayProxy::Proxied_SavePipelineState(ParamSerialiser &paramser, ReturnSerialiser &retser,
                                             uint32_t eventId)
@@ -1716,9 +2277,14 @@ void ReplayProxy::Proxied_SavePipelineState(ParamSerialiser &paramser, ReturnSer
   const ReplayProxyPacket expectedPacket = eReplayProxy_SavePipelineState;
   ReplayProxyPacket packet = eReplayProxy_SavePipelineState;
 
+  // the generation of the state the local side holds, which the remote side can delta against if
+  // it matches the last state it sent
+  uint32_t baseline = m_PipelineStateGeneration;
+
   {
     BEGIN_PARAMS();
     SERIALISE_ELEMENT(eventId);
+    SERIALISE_ELEMENT(baseline);
     END_PARAMS();
   }
 
@@ -1727,12 +2293,21 @@ void ReplayProxy::Proxied_SavePipelineState(ParamSerialiser &paramser, ReturnSer
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
     {
       m_Remote->SavePipelineState(eventId);
+
+      // if the local side doesn't have what we last sent, send everything
+      if(baseline == 0 || baseline != m_PipelineStateGeneration)
+        m_PipelineStateBaseline = PipelineStateBaseline();
+
+      m_PipelineStateGeneration = RDCMAX(m_PipelineStateGeneration + 1, 1U);
     }
   }
 
   {
     ReturnSerialiser &ser = retser;
     PACKET_HEADER(packet);
+    uint32_t generation = m_PipelineStateGeneration;
+    SERIALISE_ELEMENT(generation);
+    bool success = true;
     if(m_APIProps.pipelineType == GraphicsAPI::D3D11)
     {
       SERIALISE_ELEMENT(*m_D3D11PipelineState);
@@ -1743,17 +2318,31 @@ void ReplayProxy::Proxied_SavePipelineState(ParamSerialiser &paramser, ReturnSer
     }
     else if(m_APIProps.pipelineType == GraphicsAPI::OpenGL)
     {
-      SERIALISE_ELEMENT(*m_GLPipelineState);
+      success = SerialisePipelineStateDelta(ser, *m_GLPipelineState);
     }
     else if(m_APIProps.pipelineType == GraphicsAPI::Vulkan)
     {
-      SERIALISE_ELEMENT(*m_VulkanPipelineState);
+      success = SerialisePipelineStateDelta(ser, *m_VulkanPipelineState);
     }
     SERIALISE_ELEMENT(packet);
     ser.EndChunk();
 
     if(retser.IsReading())
     {
+      // if anything went wrong the state we have can't be used as a baseline for the next one
+      if(success && !retser.IsErrored())
+        m_PipelineStateGeneration = generation;
+      else
+        m_PipelineStateGeneration = 0;
+
+      if(!success)
+        m_IsErrored = true;
+    }
+
+    if(retser.IsReading())
+    {
+      rdcarray<ShaderReflFetch> fetches;
+
       if(m_APIProps.pipelineType == GraphicsAPI::D3D11 && m_D3D11PipelineState)
       {
         D3D11Pipe::Shader *stages[] = {
@@ -1764,13 +2353,12 @@ void ReplayProxy::Proxied_SavePipelineState(ParamSerialiser &paramser, ReturnSer
 
         for(int i = 0; i < 6; i++)
           if(stages[i]->resourceId != ResourceId())
-            stages[i]->reflection =
-                GetShader(ResourceId(), GetLiveID(stages[i]->resourceId), ShaderEntryPoint());
+            fetches.push_back({ResourceId(), stages[i]->resourceId, ShaderEntryPoint(),
+                               &stages[i]->reflection});
 
         if(m_D3D11PipelineState->inputAssembly.resourceId != ResourceId())
-          m_D3D11PipelineState->inputAssembly.bytecode =
-              GetShader(ResourceId(), GetLiveID(m_D3D11PipelineState->inputAssembly.resourceId),
-                        ShaderEntryPoint());
+          fetches.push_back({ResourceId(), m_D3D11PipelineState->inputAssembly.resourceId,
+                             ShaderEntryPoint(), &m_D3D11PipelineState->inputAssembly.bytecode});
       }
       else if(m_APIProps.pipelineType == GraphicsAPI::D3D12 && m_D3D12PipelineState)
       {
@@ -1780,12 +2368,12 @@ void ReplayProxy::Proxied_SavePipelineState(ParamSerialiser &paramser, ReturnSer
             &m_D3D12PipelineState->pixelShader,  &m_D3D12PipelineState->computeShader,
         };
 
-        ResourceId pipe = GetLiveID(m_D3D12PipelineState->pipelineResourceId);
+        ResourceId pipe = m_D3D12PipelineState->pipelineResourceId;
 
         for(int i = 0; i < 6; i++)
           if(stages[i]->resourceId != ResourceId())
-            stages[i]->reflection =
-                GetShader(pipe, GetLiveID(stages[i]->resourceId), ShaderEntryPoint());
+            fetches.push_back(
+                {pipe, stages[i]->resourceId, ShaderEntryPoint(), &stages[i]->reflection});
       }
       else if(m_APIProps.pipelineType == GraphicsAPI::OpenGL && m_GLPipelineState)
       {
@@ -1797,8 +2385,8 @@ void ReplayProxy::Proxied_SavePipelineState(ParamSerialiser &paramser, ReturnSer
 
         for(int i = 0; i < 6; i++)
           if(stages[i]->shaderResourceId != ResourceId())
-            stages[i]->reflection =
-                GetShader(ResourceId(), GetLiveID(stages[i]->shaderResourceId), ShaderEntryPoint());
+            fetches.push_back({ResourceId(), stages[i]->shaderResourceId, ShaderEntryPoint(),
+                               &stages[i]->reflection});
       }
       else if(m_APIProps.pipelineType == GraphicsAPI::Vulkan && m_VulkanPipelineState)
       {
@@ -1808,19 +2396,21 @@ void ReplayProxy::Proxied_SavePipelineState(ParamSerialiser &paramser, ReturnSer
             &m_VulkanPipelineState->fragmentShader, &m_VulkanPipelineState->computeShader,
         };
 
-        ResourceId pipe = GetLiveID(m_VulkanPipelineState->graphics.pipelineResourceId);
+        ResourceId pipe = m_VulkanPipelineState->graphics.pipelineResourceId;
 
         for(int i = 0; i < 6; i++)
         {
           if(i == 5)
-            pipe = GetLiveID(m_VulkanPipelineState->compute.pipelineResourceId);
+            pipe = m_VulkanPipelineState->compute.pipelineResourceId;
 
           if(stages[i]->resourceId != ResourceId())
-            stages[i]->reflection =
-                GetShader(pipe, GetLiveID(stages[i]->resourceId),
-                          ShaderEntryPoint(stages[i]->entryPoint, stages[i]->stage));
+            fetches.push_back({pipe, stages[i]->resourceId,
+                               ShaderEntryPoint(stages[i]->entryPoint, stages[i]->stage),
+                               &stages[i]->reflection});
         }
       }
+
+      FetchShaderReflections(fetches);
     }
   }
 
@@ -1958,7 +2548,7 @@ void DoSerialise(SerialiserType &ser, DeltaSection &el)
 template <typename SerialiserType>
 void ReplayProxy::DeltaTransferBytes(SerialiserType &xferser, bytebuf &referenceData, bytebuf &newData)
 {
-  // lz4 compress
+  // compress with whichever codec suits the link
   if(xferser.IsReading())
   {
     uint64_t uncompSize = 0;
@@ -1976,8 +2566,9 @@ void ReplayProxy::DeltaTransferBytes(SerialiserType &xferser, bytebuf &reference
 
       {
         ReadSerialiser ser(
-            new StreamReader(new LZ4Decompressor(xferser.GetReader(), Ownership::Nothing),
-                             uncompSize, Ownership::Stream),
+            new StreamReader(
+                new AdaptiveDecompressor(xferser.GetReader(), m_RecvCodec, Ownership::Nothing),
+                uncompSize, Ownership::Stream),
             Ownership::Stream);
 
         SERIALISE_ELEMENT(deltas);
@@ -2063,90 +2654,19 @@ void ReplayProxy::DeltaTransferBytes(SerialiserType &xferser, bytebuf &reference
       }
       else
       {
-        // do actual diff.
-        const byte *srcBegin = newData.data();
-        const byte *src = srcBegin;
-        const byte *dst = referenceData.data();
-        size_t bytesRemain = newData.size();
-
-        // we only care about large-ish chunks at a time. This prevents us generating lots of tiny
-        // deltas where we could batch changes together. This is tuned to not be too large (and
-        // thus causing us to miss too many sections we could skip) and not too small (causing us
-        // to devolve into lots of byte-wise deltas). The current value as of this comment of 128
-        // is definitely on the small end of the range, but consider e.g. an android image of
-        // 1440x2560 and a pixel-wide line that goes vertically from top to bottom. Reading
-        // horizontally that will mean 2560 different diffs, and only actually one pixel changed.
-        // The larger this value gets, the more redundant data we'll send along with.
-        const size_t chunkSize = 128;
-
-        // we use a simple state machine. Start in state 1
-        //
-        // State 1: No active delta. Look at the current chunk, if there's no difference move to the
-        //          next chunk and stay in this state. If there is a difference, push a delta onto
-        //          the list at the current offset. Copy the current chunk into the contents of the
-        //          delta. Move to state 2.
-        // State 2. Active delta. Look at the current chunk, if there is a difference then append
-        //          the current chunk to the last delta's contents, move to the next chunk, and stay
-        //          in this state. If there isn't a difference, move back to state 1 (the delta is
-        //          already 'finished' so we have no need to do anything more on it).
-        //
-        // At any point we can end the loop, both states are 'complete' at all points.
-
-        enum DeltaState
-        {
-          None,
-          Active
-        };
-        DeltaState state = DeltaState::None;
-
-        // loop over whole chunks
-        while(bytesRemain > chunkSize)
-        {
-          // check if there's a difference in this chunk.
-          bool chunkDiff = memcmp(src, dst, chunkSize) != 0;
-
-          // if we're in state 1
-          if(state == DeltaState::None)
-          {
-            // if there's a difference, append a new delta with the current offset and chunk
-            // contents and move to state 2
-            if(chunkDiff)
-            {
-              deltasList.push_back(DeltaSection());
-              deltasList.back().offs = src - srcBegin;
-              deltasList.back().contents.append(src, chunkSize);
-
-              state = DeltaState::Active;
-            }
-          }
-          // if we're in state 2
-          else if(state == DeltaState::Active)
-          {
-            // continue to append to the delta if there's another difference in this chunk.
-            if(chunkDiff)
-            {
-              deltasList.back().contents.append(src, chunkSize);
-            }
-            else
-            {
-              state = DeltaState::None;
-            }
-          }
-
-          // move to the next chunk
-          bytesRemain -= chunkSize;
-          src += chunkSize;
-          dst += chunkSize;
-        }
-
-        // if there are still some bytes remaining at the end of the image, smaller than the chunk
-        // size, just diff directly and send if needed. We could combine this with the last delta if
-        // we ended in the active state.
-        if(bytesRemain > 0 && memcmp(src, dst, bytesRemain) != 0)
+        // do actual diff. Changes that are close together are sent as one delta, since each delta
+        // has some overhead and the unchanged bytes in between compress well. Changes further apart
+        // are still sent separately, e.g. a pixel-wide vertical line down a 1440x2560 image is
+        // 2560 deltas, one per row.
+        rdcarray<rdcpair<size_t, size_t>> diffs;
+        FindDiffRanges(referenceData.data(), newData.data(), newData.size(),
+                       RemoteServer_DeltaMergeGap(), diffs);
+
+        for(const rdcpair<size_t, size_t> &diff : diffs)
         {
           deltasList.push_back(DeltaSection());
-          deltasList.back().offs = src - srcBegin;
-          deltasList.back().contents.append(src, bytesRemain);
+          deltasList.back().offs = diff.first;
+          deltasList.back().contents.append(newData.data() + diff.first, diff.second - diff.first);
         }
       }
     }
@@ -2183,9 +2703,11 @@ void ReplayProxy::DeltaTransferBytes(SerialiserType &xferser, bytebuf &reference
 
     if(uncompSize > 0)
     {
-      WriteSerialiser ser(new StreamWriter(new LZ4Compressor(xferser.GetWriter(), Ownership::Nothing),
-                                           Ownership::Stream),
-                          Ownership::Stream);
+      WriteSerialiser ser(
+          new StreamWriter(
+              new AdaptiveCompressor(xferser.GetWriter(), m_SendCodec, Ownership::Nothing),
+              Ownership::Stream),
+          Ownership::Stream);
 
       SERIALISE_ELEMENT(deltas);
 
@@ -2513,25 +3035,6 @@ void ReplayProxy::EnsureBufCached(ResourceId bufid)
   }
 }
 
-const ActionDescription *ReplayProxy::FindAction(const rdcarray<ActionDescription> &actionList,
-                                                 uint32_t eventId)
-{
-  for(const ActionDescription &a : actionList)
-  {
-    if(!a.children.empty())
-    {
-      const ActionDescription *action = FindAction(a.children, eventId);
-      if(action != NULL)
-        return action;
-    }
-
-    if(a.eventId == eventId)
-      return &a;
-  }
-
-  return NULL;
-}
-
 void ReplayProxy::InitPreviewWindow()
 {
   if(m_Replay && m_PreviewWindow)
@@ -2556,7 +3059,10 @@ void ReplayProxy::InitPreviewWindow()
     }
 
     if(m_FrameRecord.actionList.empty())
+    {
       m_FrameRecord = m_Replay->GetFrameRecord();
+      m_ActionIndex.Build(m_FrameRecord.actionList);
+    }
   }
 }
 
@@ -2588,7 +3094,7 @@ void ReplayProxy::RefreshPreviewWindow()
     m_Replay->RenderCheckerboard(RenderDoc::Inst().DarkCheckerboardColor(),
                                  RenderDoc::Inst().LightCheckerboardColor());
 
-    const ActionDescription *curDraw = FindAction(m_FrameRecord.actionList, m_EventID);
+    const ActionDescription *curDraw = m_ActionIndex.GetAction(m_EventID);
 
     if(curDraw)
     {
@@ -2708,6 +3214,10 @@ void ReplayProxy::EndRemoteExecution()
   }
   else
   {
+    // the execution packets were already read when the reply header was peeked
+    if(m_ReplyPeeked)
+      return;
+
     while(!m_Writer.IsErrored() && !m_Reader.IsErrored() && !m_IsErrored)
     {
       ReplayProxyPacket packet = m_Reader.ReadChunk<ReplayProxyPacket>();
@@ -2850,6 +3360,12 @@ bool ReplayProxy::CheckError(ReplayProxyPacket receivedPacket, ReplayProxyPacket
   return false;
 }
 
+void ReplayProxy::CheckRequestID(uint32_t replyID)
+{
+  RDCERR("Expected reply to request %u, received reply to %u", m_RequestID, replyID);
+  m_IsErrored = true;
+}
+
 bool ReplayProxy::Tick(int type)
 {
   if(!m_RemoteServer)
@@ -2953,6 +3469,7 @@ bool ReplayProxy::Tick(int type)
     case eReplayProxy_GetTargetShaderEncodings: GetTargetShaderEncodings(); break;
     case eReplayProxy_GetDriverInfo: GetDriverInfo(); break;
     case eReplayProxy_GetAvailableGPUs: GetAvailableGPUs(); break;
+    case eReplayProxy_GetReplayMemoryStats: GetReplayMemoryStats(); break;
     default: RDCERR("Unexpected command %u", type); return false;
   }
 
@@ -2966,3 +3483,216 @@ bool ReplayProxy::Tick(int type)
 
   return true;
 }
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+// sends one delta from the remote state to the local state, returning how many bytes it took
+template <typename T>
+static uint64_t SendArrayDelta(rdcarray<T> &remote, rdcarray<T> &baseline, rdcarray<T> &local)
+{
+  StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+  {
+    WriteSerialiser ser(buf, Ownership::Nothing);
+    SCOPED_SERIALISE_CHUNK(1);
+    CHECK(SerialiseArrayDelta(ser, remote, baseline));
+  }
+
+  uint64_t size = buf->GetOffset();
+
+  {
+    ReadSerialiser ser(new StreamReader(buf->GetData(), buf->GetOffset()), Ownership::Stream);
+    ser.ReadChunk<uint32_t>();
+    rdcarray<T> unused;
+    CHECK(SerialiseArrayDelta(ser, local, unused));
+    ser.EndChunk();
+    CHECK(!ser.IsErrored());
+  }
+
+  delete buf;
+
+  return size;
+}
+
+TEST_CASE("Test pipeline state delta encoding", "[proxy]")
+{
+  rdcarray<VKPipe::DescriptorSet> remote, baseline, local;
+
+  remote.resize(2);
+  remote[0].descriptorSetResourceId = ResourceIDGen::GetNewUniqueID();
+  remote[0].bindings.resize(2);
+  remote[0].bindings[0].descriptorCount = 1;
+  remote[0].bindings[0].binds.resize(1);
+  remote[0].bindings[0].binds[0].viewResourceId = ResourceIDGen::GetNewUniqueID();
+
+  // a large bindless array
+  remote[0].bindings[1].descriptorCount = 10000;
+  remote[0].bindings[1].binds.resize(10000);
+  for(uint32_t i = 0; i < 10000; i++)
+  {
+    remote[0].bindings[1].binds[i].resourceResourceId = ResourceIDGen::GetNewUniqueID();
+    remote[0].bindings[1].binds[i].dynamicallyUsed = false;
+  }
+
+  remote[1].descriptorSetResourceId = ResourceIDGen::GetNewUniqueID();
+  remote[1].inlineData = {1, 2, 3, 4};
+
+  uint64_t fullSize = SendArrayDelta(remote, baseline, local);
+  CHECK(DeltaEqual(local, remote));
+  CHECK(DeltaEqual(baseline, remote));
+  CHECK(fullSize > 10000 * sizeof(ResourceId));
+
+  SECTION("Unchanged state")
+  {
+    uint64_t size = SendArrayDelta(remote, baseline, local);
+    CHECK(DeltaEqual(local, remote));
+    // only the chunk header and empty run lists
+    CHECK(size <= 128);
+  };
+
+  SECTION("Single element changed")
+  {
+    remote[0].bindings[1].binds[5000].dynamicallyUsed = true;
+    remote[0].bindings[1].dynamicallyUsedCount = 1;
+
+    uint64_t size = SendArrayDelta(remote, baseline, local);
+    CHECK(DeltaEqual(local, remote));
+    CHECK(size < 1024);
+
+    // and back again
+    remote[0].bindings[1].binds[5000].dynamicallyUsed = false;
+    remote[0].bindings[1].dynamicallyUsedCount = ~0U;
+
+    size = SendArrayDelta(remote, baseline, local);
+    CHECK(DeltaEqual(local, remote));
+    CHECK(size < 1024);
+  };
+
+  SECTION("Only ycbcr conversion changed")
+  {
+    // these fields aren't part of BindingElement's comparison, but must still be sent
+    VKPipe::BindingElement &el = remote[0].bindings[1].binds[1234];
+    el.ycbcrSampler = ResourceIDGen::GetNewUniqueID();
+    el.ycbcrModel = YcbcrConversion::BT709;
+    el.ycbcrRange = YcbcrRange::ITUNarrow;
+    el.xChromaOffset = ChromaSampleLocation::Midpoint;
+    el.chromaFilter = FilterMode::Linear;
+    el.forceExplicitReconstruction = true;
+
+    uint64_t size = SendArrayDelta(remote, baseline, local);
+    CHECK(DeltaEqual(local, remote));
+    CHECK(local[0].bindings[1].binds[1234].ycbcrModel == YcbcrConversion::BT709);
+    CHECK(local[0].bindings[1].binds[1234].forceExplicitReconstruction);
+    CHECK(size < 1024);
+
+    remote[0].bindings[1].binds[1234].ycbcrSwizzle.red = TextureSwizzle::Blue;
+
+    size = SendArrayDelta(remote, baseline, local);
+    CHECK(DeltaEqual(local, remote));
+    CHECK(local[0].bindings[1].binds[1234].ycbcrSwizzle.red == TextureSwizzle::Blue);
+    CHECK(size < 1024);
+  };
+
+  SECTION("Set header changed")
+  {
+    remote[1].inlineData = {5, 6};
+    remote[0].pushDescriptor = true;
+
+    uint64_t size = SendArrayDelta(remote, baseline, local);
+    CHECK(DeltaEqual(local, remote));
+    CHECK(size < 1024);
+  };
+
+  SECTION("Arrays resized")
+  {
+    remote[0].bindings[1].binds.resize(20);
+    remote.resize(3);
+    remote[2].bindings.resize(1);
+    remote[2].bindings[0].binds.resize(3);
+
+    SendArrayDelta(remote, baseline, local);
+    CHECK(DeltaEqual(local, remote));
+
+    remote.resize(1);
+
+    SendArrayDelta(remote, baseline, local);
+    CHECK(DeltaEqual(local, remote));
+  };
+
+  SECTION("Baseline reset")
+  {
+    // with no baseline everything is sent, regardless of what the local side had
+    remote[0].bindings[0].binds[0].viewResourceId = ResourceId();
+    baseline.clear();
+
+    uint64_t size = SendArrayDelta(remote, baseline, local);
+    CHECK(DeltaEqual(local, remote));
+    CHECK(size >= fullSize);
+  };
+}
+
+TEST_CASE("Test GL pipeline state delta encoding", "[proxy]")
+{
+  rdcarray<GLPipe::Texture> remote, baseline, local;
+
+  remote.resize(96);
+  for(GLPipe::Texture &tex : remote)
+  {
+    tex.resourceId = ResourceIDGen::GetNewUniqueID();
+    tex.type = TextureType::Texture2D;
+  }
+
+  SendArrayDelta(remote, baseline, local);
+  CHECK(DeltaEqual(local, remote));
+
+  SECTION("Unchanged state")
+  {
+    uint64_t size = SendArrayDelta(remote, baseline, local);
+    CHECK(DeltaEqual(local, remote));
+    CHECK(size <= 128);
+  };
+
+  SECTION("Only completeness changed")
+  {
+    // completeStatus isn't part of Texture's comparison, but must still be sent
+    remote[40].completeStatus = "Mipmap levels are incomplete";
+
+    uint64_t size = SendArrayDelta(remote, baseline, local);
+    CHECK(DeltaEqual(local, remote));
+    CHECK(local[40].completeStatus == remote[40].completeStatus);
+    CHECK(size < 256);
+
+    remote[40].completeStatus = rdcstr();
+
+    SendArrayDelta(remote, baseline, local);
+    CHECK(local[40].completeStatus.empty());
+  };
+
+  SECTION("Binding changed")
+  {
+    remote[3].resourceId = ResourceId();
+    remote[90].firstMip = 2;
+
+    SendArrayDelta(remote, baseline, local);
+    CHECK(DeltaEqual(local, remote));
+  };
+
+  SECTION("Buffers")
+  {
+    rdcarray<GLPipe::Buffer> remoteBufs, baselineBufs, localBufs;
+    remoteBufs.resize(16);
+    remoteBufs[7].resourceId = ResourceIDGen::GetNewUniqueID();
+
+    SendArrayDelta(remoteBufs, baselineBufs, localBufs);
+    CHECK((localBufs == remoteBufs));
+
+    remoteBufs[7].byteOffset = 256;
+
+    SendArrayDelta(remoteBufs, baselineBufs, localBufs);
+    CHECK((localBufs == remoteBufs));
+  };
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -25,8 +25,11 @@
 
 #pragma once
 
+#include <functional>
 #include "os/os_specific.h"
+#include "replay/action_index.h"
 #include "replay/replay_driver.h"
+#include "serialise/adaptiveio.h"
 #include "serialise/serialiser.h"
 
 // turns on/off the feature to transfer resource contents (cached textures and buffers) as a series
@@ -105,6 +108,8 @@ enum ReplayProxyPacket
   eReplayProxy_FreeDebugger,
 
   eReplayProxy_FatalErrorCheck,
+
+  eReplayProxy_GetReplayMemoryStats,
 };
 
 DECLARE_REFLECTION_ENUM(ReplayProxyPacket);
@@ -124,10 +129,12 @@ DECLARE_REFLECTION_ENUM(ReplayProxyPacket);
 class ReplayProxy : public IReplayDriver
 {
 public:
-  ReplayProxy(ReadSerialiser &reader, WriteSerialiser &writer, IReplayDriver *proxy);
+  ReplayProxy(ReadSerialiser &reader, WriteSerialiser &writer, IReplayDriver *proxy,
+              uint32_t networkCodecs);
 
   ReplayProxy(ReadSerialiser &reader, WriteSerialiser &writer, IRemoteDriver *remoteDriver,
-              IReplayDriver *replayDriver, RENDERDOC_PreviewWindowCallback previewWindow);
+              IReplayDriver *replayDriver, RENDERDOC_PreviewWindowCallback previewWindow,
+              uint32_t networkCodecs);
 
   virtual ~ReplayProxy();
 
@@ -458,6 +465,8 @@ public:
     m_D3D12PipelineState = d3d12;
     m_GLPipelineState = gl;
     m_VulkanPipelineState = vk;
+    // new state objects can't be delta'd against
+    m_PipelineStateGeneration = 0;
   }
   SDFile *GetStructuredFile() { return m_StructuredFile; }
   IMPLEMENT_FUNCTION_PROXIED(void, FetchStructuredFile);
@@ -473,6 +482,7 @@ public:
   IMPLEMENT_FUNCTION_PROXIED(APIProperties, GetAPIProperties);
   IMPLEMENT_FUNCTION_PROXIED(DriverInformation, GetDriverInfo);
   IMPLEMENT_FUNCTION_PROXIED(rdcarray<GPUDevice>, GetAvailableGPUs);
+  IMPLEMENT_FUNCTION_PROXIED(ReplayMemoryStats, GetReplayMemoryStats);
 
   IMPLEMENT_FUNCTION_PROXIED(rdcarray<DebugMessage>, GetDebugMessages);
 
@@ -482,6 +492,7 @@ public:
   IMPLEMENT_FUNCTION_PROXIED(rdcarray<uint32_t>, GetPassEvents, uint32_t eventId);
 
   IMPLEMENT_FUNCTION_PROXIED(rdcarray<EventUsage>, GetUsage, ResourceId id);
+  rdcarray<rdcarray<EventUsage>> GetUsages(const rdcarray<ResourceId> &ids);
   IMPLEMENT_FUNCTION_PROXIED(FrameRecord, GetFrameRecord);
 
   IMPLEMENT_FUNCTION_PROXIED(bool, IsRenderOutput, ResourceId id);
@@ -585,10 +596,137 @@ private:
   void EnsureBufCached(ResourceId bufid);
   IMPLEMENT_FUNCTION_PROXIED(bool, NeedRemapForFetch, const ResourceFormat &format);
 
-  const ActionDescription *FindAction(const rdcarray<ActionDescription> &actionList,
-                                      uint32_t eventId);
+  template <typename SerialiserType>
+  bool SerialisePipelineStateDelta(SerialiserType &ser, VKPipe::State &state);
+  template <typename SerialiserType>
+  bool SerialisePipelineStateDelta(SerialiserType &ser, GLPipe::State &state);
 
   bool CheckError(ReplayProxyPacket receivedPacket, ReplayProxyPacket expectedPacket);
+  void CheckRequestID(uint32_t replyID);
+
+  // On the host, requests can be pipelined so that several are in flight at once. A pipelined
+  // request runs its Proxied_ function in the Send phase, which returns as soon as the parameters
+  // are sent, and then again in the Receive phase to read the reply.
+  //
+  // Replies are matched to their requests by ID, not by order. Waiting on one request reads
+  // whichever replies arrive until its own does, completing each pending request as its reply is
+  // read.
+  //
+  // The connection is shared with the remote server's own packets, so any pipelined requests must
+  // be completed before returning to the caller.
+  enum class PipelinePhase
+  {
+    SendAndReceive,
+    Send,
+    Receive,
+  };
+
+  // the result of a pipelined request. The pending request refers to the future, so it can't be
+  // copied. Moving it re-points the pending request, so futures can be kept in an rdcarray. It
+  // waits for the reply if it's destroyed first.
+  template <typename T>
+  class ProxyFuture
+  {
+  public:
+    ProxyFuture() = default;
+    ~ProxyFuture() { Wait(); }
+    ProxyFuture(const ProxyFuture &) = delete;
+    ProxyFuture &operator=(const ProxyFuture &) = delete;
+    ProxyFuture &operator=(ProxyFuture &&) = delete;
+    ProxyFuture(ProxyFuture &&o)
+        : m_Proxy(o.m_Proxy), m_RequestID(o.m_RequestID), m_Value(std::move(o.m_Value))
+    {
+      o.m_Proxy = NULL;
+      if(m_Proxy)
+        m_Proxy->RetargetRequest(m_RequestID, this);
+    }
+
+    const T &Get()
+    {
+      Wait();
+      return m_Value;
+    }
+
+  private:
+    friend class ReplayProxy;
+
+    void Wait()
+    {
+      if(m_Proxy)
+        m_Proxy->WaitForRequest(m_RequestID);
+    }
+
+    ReplayProxy *m_Proxy = NULL;
+    uint32_t m_RequestID = 0;
+    T m_Value = T();
+  };
+
+  // send the request for func with the given parameters, and fill out future once the reply is
+  // read.
+  // Functions that can't be pipelined (those without PIPELINE_SEND_RETURN), or which can return a
+  // locally cached result, complete immediately.
+  template <typename T, typename... FuncArgs, typename... Args>
+  void PipelineRequest(ProxyFuture<T> &future,
+                       T (ReplayProxy::*func)(WriteSerialiser &, ReadSerialiser &, FuncArgs...),
+                       Args... args);
+  void WaitForRequest(uint32_t requestID);
+  void WaitForAllRequests();
+  void ReceiveNextReply();
+  void RetargetRequest(uint32_t requestID, void *dest);
+
+  // the reply header is read before it's known which request it belongs to, and then consumed by
+  // that request's PACKET_HEADER
+  ReplayProxyPacket BeginReplyChunk(WriteSerialiser &ser, ReplayProxyPacket packet,
+                                    uint32_t &replyID);
+  ReplayProxyPacket BeginReplyChunk(ReadSerialiser &ser, ReplayProxyPacket packet,
+                                    uint32_t &replyID);
+
+  ReadSerialiser &BeginPipelineParams(ReadSerialiser &ser) { return ser; }
+  WriteSerialiser &BeginPipelineParams(WriteSerialiser &ser)
+  {
+    m_ParamsPhase = m_PipelinePhase;
+    m_PipelinePhase = PipelinePhase::SendAndReceive;
+    return m_ParamsPhase == PipelinePhase::Receive ? *m_DiscardParams : ser;
+  }
+
+  struct PendingRequest
+  {
+    uint32_t requestID;
+    // the ProxyFuture to fill out
+    void *dest;
+    std::function<void(void *)> receive;
+  };
+
+  // pending pipelined requests, in the order they were sent
+  rdcarray<PendingRequest> m_PendingRequests;
+
+  // set while a reply's header has been read but not yet handed to its request
+  bool m_ReplyPeeked = false;
+  ReplayProxyPacket m_PeekedPacket = eReplayProxy_First;
+  uint32_t m_PeekedReplyID = 0;
+
+  // the phase requested for the next Proxied_ call, and the phase its parameters were handled in
+  PipelinePhase m_PipelinePhase = PipelinePhase::SendAndReceive;
+  PipelinePhase m_ParamsPhase = PipelinePhase::SendAndReceive;
+  bool m_PipelineSent = false;
+
+  // the ID of the request currently being sent or replied to. On the host these are allocated from
+  // m_NextRequestID, on the remote server it's read from the request and echoed in the reply.
+  uint32_t m_RequestID = 0;
+  uint32_t m_NextRequestID = 0;
+
+  // the parameters are serialised again when reading a pipelined reply, and discarded here
+  WriteSerialiser *m_DiscardParams = NULL;
+
+  struct ShaderReflFetch
+  {
+    ResourceId pipeline;
+    ResourceId shader;
+    ShaderEntryPoint entry;
+    ShaderReflection **reflection;
+  };
+
+  void FetchShaderReflections(const rdcarray<ShaderReflFetch> &fetches);
 
   struct TextureCacheEntry
   {
@@ -635,6 +773,7 @@ private:
   std::set<ResourceId> m_LocalTextures;
 
   std::map<ResourceId, ResourceId> m_LiveIDs;
+  std::map<GPUCounter, CounterDescription> m_CounterDescriptions;
 
   struct ShaderReflKey
   {
@@ -668,6 +807,10 @@ private:
   // writer to the other side of the host <-> remote connection
   WriteSerialiser &m_Writer;
 
+  // compression state for bulk data in each direction, see AdaptiveCodec
+  AdaptiveCodec m_SendCodec;
+  AdaptiveCodec m_RecvCodec;
+
   // the local proxy replay driver when on the host side, NULL on the remote server
   IReplayDriver *m_Proxy;
   // the remote driver on the remote server, NULL on the host side
@@ -716,7 +859,7 @@ private:
   APIProperties m_APIProps;
   std::map<ResourceId, TextureDescription> m_TextureInfo;
 
-  rdcarray<ActionDescription *> m_Actions;
+  ActionIndex m_ActionIndex;
 
   SDFile *m_StructuredFile;
 
@@ -724,4 +867,24 @@ private:
   D3D12Pipe::State *m_D3D12PipelineState = NULL;
   GLPipe::State *m_GLPipelineState = NULL;
   VKPipe::State *m_VulkanPipelineState = NULL;
+
+  // the large arrays of the pipeline state as they were last sent, which the next state is
+  // delta-encoded against. Only used on the remote side.
+  struct PipelineStateBaseline
+  {
+    rdcarray<VKPipe::DescriptorSet> vkGraphicsSets;
+    rdcarray<VKPipe::DescriptorSet> vkComputeSets;
+    rdcarray<VKPipe::ImageData> vkImages;
+
+    rdcarray<GLPipe::Texture> glTextures;
+    rdcarray<GLPipe::Sampler> glSamplers;
+    rdcarray<GLPipe::Buffer> glAtomicBuffers;
+    rdcarray<GLPipe::Buffer> glUniformBuffers;
+    rdcarray<GLPipe::Buffer> glShaderStorageBuffers;
+    rdcarray<GLPipe::ImageLoadStore> glImages;
+  } m_PipelineStateBaseline;
+
+  // on the remote side, the generation of the last pipeline state sent. On the local side, the
+  // generation of the state last received, or 0 if there isn't a valid one to delta against.
+  uint32_t m_PipelineStateGeneration = 0;
 };
@@ -199,6 +199,94 @@ bool IsCompleteWriteFrameRef(FrameRefType refType)
   return refType == eFrameRef_CompleteWrite || refType == eFrameRef_CompleteWriteAndDiscard;
 }
 
+static const uint32_t FrameRefAccumulatorInitialBits = 6;
+
+FrameRefAccumulator::FrameRefAccumulator()
+{
+  m_Slots.resize(1ULL << FrameRefAccumulatorInitialBits);
+  m_Shift = 64 - FrameRefAccumulatorInitialBits;
+}
+
+size_t FrameRefAccumulator::GetSlot(ResourceId id) const
+{
+  // fibonacci hashing spreads the mostly sequential IDs across the table
+  return size_t((uint64_t(std::hash<ResourceId>()(id)) * 0x9E3779B97F4A7C15ULL) >> m_Shift);
+}
+
+FrameRefAccumulator::Entry *FrameRefAccumulator::Find(ResourceId id)
+{
+  const size_t mask = m_Slots.size() - 1;
+
+  for(size_t slot = GetSlot(id);; slot = (slot + 1) & mask)
+  {
+    Entry &e = m_Slots[slot];
+
+    if(e.id == id)
+      return &e;
+
+    if(e.id == ResourceId())
+      return NULL;
+  }
+}
+
+FrameRefAccumulator::Entry &FrameRefAccumulator::FindOrAdd(ResourceId id)
+{
+  RDCASSERT(id != ResourceId());
+
+  // keep the load factor under a half so probe sequences stay short
+  if((m_Count + 1) * 2 > m_Slots.size())
+    Grow();
+
+  const size_t mask = m_Slots.size() - 1;
+
+  for(size_t slot = GetSlot(id);; slot = (slot + 1) & mask)
+  {
+    Entry &e = m_Slots[slot];
+
+    if(e.id == id)
+      return e;
+
+    if(e.id == ResourceId())
+    {
+      m_Count++;
+      e.id = id;
+      e.ref = e.synced = eFrameRef_None;
+      return e;
+    }
+  }
+}
+
+void FrameRefAccumulator::Clear()
+{
+  if(m_Count == 0)
+    return;
+
+  for(Entry &e : m_Slots)
+    e.id = ResourceId();
+
+  m_Count = 0;
+}
+
+void FrameRefAccumulator::Grow()
+{
+  rdcarray<Entry> oldSlots;
+  oldSlots.swap(m_Slots);
+
+  m_Slots.resize(oldSlots.size() * 2);
+  m_Shift--;
+  m_Count = 0;
+
+  for(const Entry &old : oldSlots)
+  {
+    if(old.id == ResourceId())
+      continue;
+
+    Entry &e = FindOrAdd(old.id);
+    e.ref = old.ref;
+    e.synced = old.synced;
+  }
+}
+
 void ResourceRecord::AddResourceReferences(ResourceRecordHandler *mgr)
 {
   for(auto it = m_FrameRefs.begin(); it != m_FrameRefs.end(); ++it)
@@ -31,6 +31,7 @@
 #include <unordered_map>
 #include <unordered_set>
 #include "api/replay/rdcflatmap.h"
+#include "api/replay/rdchashmap.h"
 #include "api/replay/resourceid.h"
 #include "common/threading.h"
 #include "core/core.h"
@@ -266,9 +267,8 @@ inline InitReqType InitReq(FrameRefType refType, InitPolicy policy, bool initial
 }
 
 // handle marking a resource referenced for read or write and storing RAW access etc.
-template <typename Compose>
-bool MarkReferenced(std::map<ResourceId, FrameRefType> &refs, ResourceId id, FrameRefType refType,
-                    Compose comp)
+template <typename Map, typename Compose>
+bool MarkReferenced(Map &refs, ResourceId id, FrameRefType refType, Compose comp)
 {
   auto refit = refs.find(id);
   if(refit == refs.end())
@@ -283,12 +283,51 @@ bool MarkReferenced(std::map<ResourceId, FrameRefType> &refs, ResourceId id, Fra
   return false;
 }
 
-inline bool MarkReferenced(std::map<ResourceId, FrameRefType> &refs, ResourceId id,
-                           FrameRefType refType)
+template <typename Map>
+inline bool MarkReferenced(Map &refs, ResourceId id, FrameRefType refType)
 {
   return MarkReferenced(refs, id, refType, ComposeFrameRefs);
 }
 
+// Accumulates the frame references made by a single thread while actively capturing, so that
+// re-referencing a resource the thread has already seen this frame doesn't need the resource
+// manager's lock. This is an open-addressing hash table keyed by ResourceId, and it is merged into
+// the manager's frame references before they're read. The spin lock is only ever taken by the
+// owning thread and by the merge, so it's effectively uncontended.
+class FrameRefAccumulator
+{
+public:
+  struct Entry
+  {
+    ResourceId id;
+    // the reference this thread has accumulated, starting from the manager's reference at the
+    // point this entry was last synchronised
+    FrameRefType ref;
+    // the manager's reference when this entry was last synchronised, so a merge can tell if any
+    // other thread has referenced the resource since.
+    FrameRefType synced;
+  };
+
+  FrameRefAccumulator();
+
+  Entry *Find(ResourceId id);
+  Entry &FindOrAdd(ResourceId id);
+  void Clear();
+
+  size_t Size() const { return m_Count; }
+  // this contains empty slots, which have a null ID
+  const rdcarray<Entry> &GetSlots() const { return m_Slots; }
+  Threading::SpinLock Lock;
+
+private:
+  size_t GetSlot(ResourceId id) const;
+  void Grow();
+
+  rdcarray<Entry> m_Slots;
+  size_t m_Count = 0;
+  uint32_t m_Shift = 0;
+};
+
 // verbose prints with IDs of each dirty resource and whether it was prepared,
 // and whether it was serialised.
 #define VERBOSE_DIRTY_RESOURCES OPTION_OFF
@@ -534,7 +573,7 @@ protected:
   rdcarray<StoredChunk> m_Chunks;
   Threading::CriticalSection *m_ChunkLock;
 
-  std::map<ResourceId, FrameRefType> m_FrameRefs;
+  rdchashmap<ResourceId, FrameRefType> m_FrameRefs;
 };
 
 template <typename Compose>
@@ -661,9 +700,20 @@ public:
   // Free any initial contents that are prepared (for after capture is complete)
   void FreeInitialContents();
 
-  // Apply the initial contents for the resources that need them, used at the start of a frame
+  // Apply the initial contents for the resources that need them, used at the start of a frame.
+  // Resources with a known first write are skipped if no replay since the last apply reached it.
   void ApplyInitialContents();
 
+  // Set the first event that can write each resource (by original ID), for resources where every
+  // write is known. Any resource not listed is assumed to be written by any replay.
+  void SetFirstReplayWrites(rdchashmap<ResourceId, uint32_t> &&firstWrites);
+  // record that a replay has executed events up to and including eventId
+  void MarkReplayedUpTo(uint32_t eventId);
+  // force the next ApplyInitialContents to restore every resource
+  void MarkAllReplayWritten() { m_ReplayedUpTo = ~0U; }
+  // returns whether a resource may have been written since its initial contents were last applied
+  bool IsReplayWritten(ResourceId origid);
+
   // Resource wrapping, allows for querying and adding/removing of wrapper layers around resources
   bool AddWrapper(WrappedResourceType wrap, RealResourceType real);
   bool HasWrapper(RealResourceType real);
@@ -693,6 +743,10 @@ protected:
     return true;
   }
   virtual bool Prepare_InitialState(WrappedResourceType res) = 0;
+  // optional, brackets a run of Prepare_InitialState calls so the driver can batch them and defer
+  // waiting on any GPU work until the initial state is serialised
+  virtual void BeginPrepareInitialStateBatch() {}
+  virtual void EndPrepareInitialStateBatch() {}
   virtual uint64_t GetSize_InitialState(ResourceId id, const InitialContentData &initial) = 0;
   virtual bool Serialise_InitialState(WriteSerialiser &ser, ResourceId id, RecordType *record,
                                       const InitialContentData *initialData) = 0;
@@ -702,6 +756,9 @@ protected:
 
   void UpdateLastWriteTime(ResourceId id, FrameRefType refType);
 
+  void MergeThreadFrameReferences();
+  void MergeThreadFrameReference(const FrameRefAccumulator::Entry &entry);
+
   void Prepare_InitialStateIfPostponed(ResourceId id, bool midframe);
   void SkipOrPostponeOrPrepare_InitialState(ResourceId id, FrameRefType refType);
 
@@ -722,7 +779,12 @@ protected:
   std::map<RealResourceType, WrappedResourceType> m_WrapperMap;
 
   // used during capture - holds resources referenced in current frame (and how they're referenced)
-  std::map<ResourceId, FrameRefType> m_FrameReferencedResources;
+  rdchashmap<ResourceId, FrameRefType> m_FrameReferencedResources;
+
+  // used during active capture - references accumulated on each thread, which are merged into
+  // m_FrameReferencedResources before the reference types are needed.
+  uint64_t m_FrameRefTLSSlot;
+  rdcarray<FrameRefAccumulator *> m_FrameRefAccumulators;
 
   // used during capture - holds resources marked as dirty, needing initial contents
   std::set<ResourceId> m_DirtyResources;
@@ -749,23 +811,31 @@ protected:
 
   // used during capture or replay - map of resources currently alive with their real IDs, used in
   // capture and replay.
-  std::unordered_map<ResourceId, WrappedResourceType> m_CurrentResourceMap;
+  rdchashmap<ResourceId, WrappedResourceType> m_CurrentResourceMap;
 
   // used during replay - maps back and forth from original id to live id and vice-versa
-  std::unordered_map<ResourceId, ResourceId> m_OriginalIDs, m_LiveIDs;
+  // original IDs are keyed by live IDs, which are allocated densely in sequence on replay
+  rdcdensemap<ResourceId, ResourceId> m_OriginalIDs;
+  rdchashmap<ResourceId, ResourceId> m_LiveIDs;
 
   // used during replay - holds resources allocated and the original id that they represent
-  std::unordered_map<ResourceId, WrappedResourceType> m_LiveResourceMap;
+  rdchashmap<ResourceId, WrappedResourceType> m_LiveResourceMap;
+
+  // used during replay - the first event that writes each resource whose writes are all known, and
+  // the last event replayed since initial contents were applied. Starts as ~0U so the first apply
+  // restores everything.
+  rdchashmap<ResourceId, uint32_t> m_FirstReplayWrite;
+  uint32_t m_ReplayedUpTo = ~0U;
 
   // used during capture - holds resource records by id.
-  std::unordered_map<ResourceId, RecordType *> m_ResourceRecords;
+  rdchashmap<ResourceId, RecordType *> m_ResourceRecords;
   Threading::RWLock m_ResourceRecordLock;
 
   // used during replay - holds current resource replacements
   // replaced -> replacement
-  std::unordered_map<ResourceId, ResourceId> m_Replacements;
+  rdchashmap<ResourceId, ResourceId> m_Replacements;
   // replacement -> replaced (for looking up original IDs)
-  std::unordered_map<ResourceId, ResourceId> m_Replaced;
+  rdchashmap<ResourceId, ResourceId> m_Replaced;
 
   // During initial resources preparation, persistent resources are
   // postponed until serializing to RDC file.
@@ -811,6 +881,7 @@ template <typename Configuration>
 ResourceManager<Configuration>::ResourceManager(CaptureState &state) : m_State(state)
 {
   m_Capturing = IsCaptureMode(state);
+  m_FrameRefTLSSlot = Threading::AllocateTLSSlot();
   RenderDoc::Inst().RegisterMemoryRegion(this, sizeof(ResourceManager));
 }
 
@@ -819,17 +890,28 @@ void ResourceManager<Configuration>::Shutdown()
 {
   FreeInitialContents();
 
-  while(!m_LiveResourceMap.empty())
+  // releasing a resource can erase others from the map, so gather the IDs up front and look each
+  // one up again before releasing it. Repeatedly erasing from begin() would be quadratic.
+  rdcarray<ResourceId> liveIDs;
+  liveIDs.reserve(m_LiveResourceMap.size());
+  for(auto it = m_LiveResourceMap.begin(); it != m_LiveResourceMap.end(); ++it)
+    liveIDs.push_back(it->first);
+
+  for(ResourceId id : liveIDs)
   {
-    auto it = m_LiveResourceMap.begin();
-    ResourceId id = it->first;
+    auto it = m_LiveResourceMap.find(id);
+    if(it == m_LiveResourceMap.end())
+      continue;
+
     ResourceTypeRelease(it->second);
 
-    auto removeit = m_LiveResourceMap.find(id);
-    if(removeit != m_LiveResourceMap.end())
-      m_LiveResourceMap.erase(removeit);
+    it = m_LiveResourceMap.find(id);
+    if(it != m_LiveResourceMap.end())
+      m_LiveResourceMap.erase(it);
   }
 
+  m_LiveResourceMap.clear();
+
   RDCASSERT(m_ResourceRecords.empty());
 }
 
@@ -840,6 +922,9 @@ ResourceManager<Configuration>::~ResourceManager()
   RDCASSERT(m_InitialContents.empty());
   RDCASSERT(m_ResourceRecords.empty());
 
+  for(FrameRefAccumulator *accum : m_FrameRefAccumulators)
+    delete accum;
+
   RenderDoc::Inst().UnregisterMemoryRegion(this);
 }
 
@@ -920,11 +1005,47 @@ template <typename Compose>
 void ResourceManager<Configuration>::MarkResourceFrameReferenced(ResourceId id,
                                                                  FrameRefType refType, Compose comp)
 {
-  SCOPED_LOCK_OPTIONAL(m_Lock, m_Capturing);
-
   if(id == ResourceId())
     return;
 
+  const bool accumulate = m_Capturing && IsActiveCapturing(m_State);
+
+  FrameRefAccumulator *accum = NULL;
+
+  if(accumulate)
+  {
+    accum = (FrameRefAccumulator *)Threading::GetTLSValue(m_FrameRefTLSSlot);
+
+    // if this thread has already referenced the resource this frame we can accumulate locally
+    // without locking. The exception is the first write, which may need to prepare postponed
+    // initial contents before it happens.
+    if(accum)
+    {
+      Threading::ScopedSpinLock lock(accum->Lock);
+
+      FrameRefAccumulator::Entry *entry = accum->Find(id);
+
+      if(entry && (IsDirtyFrameRef(entry->ref) || !IsDirtyFrameRef(refType)))
+      {
+        entry->ref = comp(entry->ref, refType);
+        return;
+      }
+    }
+  }
+
+  SCOPED_LOCK_OPTIONAL(m_Lock, m_Capturing);
+
+  // apply anything this thread accumulated for the resource before the new reference
+  if(accum)
+  {
+    Threading::ScopedSpinLock lock(accum->Lock);
+
+    FrameRefAccumulator::Entry *entry = accum->Find(id);
+
+    if(entry)
+      MergeThreadFrameReference(*entry);
+  }
+
   if(IsActiveCapturing(m_State))
   {
     SkipOrPostponeOrPrepare_InitialState(id, refType);
@@ -949,6 +1070,69 @@ void ResourceManager<Configuration>::MarkResourceFrameReferenced(ResourceId id,
     if(record)
       record->AddRef();
   }
+
+  if(accumulate)
+  {
+    // slow path, but only once per thread for each resource
+    if(!accum)
+    {
+      accum = new FrameRefAccumulator;
+      Threading::SetTLSValue(m_FrameRefTLSSlot, (void *)accum);
+      m_FrameRefAccumulators.push_back(accum);
+    }
+
+    Threading::ScopedSpinLock lock(accum->Lock);
+
+    FrameRefAccumulator::Entry &entry = accum->FindOrAdd(id);
+    entry.ref = entry.synced = m_FrameReferencedResources[id];
+  }
+}
+
+template <typename Configuration>
+void ResourceManager<Configuration>::MergeThreadFrameReferences()
+{
+  // parent must hold m_Lock for us
+
+  for(FrameRefAccumulator *accum : m_FrameRefAccumulators)
+  {
+    Threading::ScopedSpinLock lock(accum->Lock);
+
+    if(accum->Size() == 0)
+      continue;
+
+    for(const FrameRefAccumulator::Entry &entry : accum->GetSlots())
+    {
+      if(entry.id != ResourceId())
+        MergeThreadFrameReference(entry);
+    }
+
+    accum->Clear();
+  }
+}
+
+template <typename Configuration>
+void ResourceManager<Configuration>::MergeThreadFrameReference(
+    const FrameRefAccumulator::Entry &entry)
+{
+  // parent must hold m_Lock and the accumulator's lock for us
+
+  if(entry.ref == entry.synced)
+    return;
+
+  // every accumulated resource was referenced through the slow path first, so it must be here
+  auto it = m_FrameReferencedResources.find(entry.id);
+  if(it == m_FrameReferencedResources.end())
+    return;
+
+  // if no other thread has changed the reference since this thread last synchronised, this thread's
+  // references happened after everything else and can be applied in order. Otherwise we don't know
+  // how they interleaved with the other threads' references.
+  if(it->second == entry.synced)
+    it->second = entry.ref;
+  else
+    it->second = ComposeFrameRefsUnordered(it->second, entry.ref);
+
+  UpdateLastWriteTime(entry.id, entry.ref);
 }
 
 template <typename Configuration>
@@ -1051,6 +1235,8 @@ void ResourceManager<Configuration>::Serialise_InitialContentsNeeded(WriteSerial
 
   SCOPED_LOCK_OPTIONAL(m_Lock, m_Capturing);
 
+  MergeThreadFrameReferences();
+
   // which resources need initial contents? either those which we didn't have proper initialisation
   // for (because they were dirty one way or another) or resources that are written mid-frame and so
   // need to be reset.
@@ -1072,6 +1258,10 @@ void ResourceManager<Configuration>::Serialise_InitialContentsNeeded(WriteSerial
     }
   }
 
+  // the frame references are in hash order, sort them so the capture output is deterministic
+  std::sort(NeededInitials.begin(), NeededInitials.end(),
+            [](const WrittenRecord &a, const WrittenRecord &b) { return a.id < b.id; });
+
   // any resources that had initial contents generated should also be included, even if they're only
   // referenced read-only, as anything not in this list will have its initial contents freed on
   // replay (see CreateInitialContents). However we only need to keep resources that are referenced
@@ -1346,14 +1536,44 @@ void ResourceManager<Configuration>::ApplyInitialContents()
 {
   RDCDEBUG("Applying initial contents");
   rdcarray<ResourceId> resources = InitialContentResources();
+  uint32_t skipped = 0;
   for(auto it = resources.begin(); it != resources.end(); ++it)
   {
     ResourceId id = *it;
+
+    // anything not written since the last apply still holds its initial contents
+    if(!IsReplayWritten(id))
+    {
+      skipped++;
+      continue;
+    }
+
     const InitialContentDataOrChunk &data = m_InitialContents[id];
     WrappedResourceType live = GetLiveResource(id);
     Apply_InitialState(live, data.data);
   }
-  RDCDEBUG("Applied %d", (uint32_t)resources.size());
+  m_ReplayedUpTo = 0;
+  RDCDEBUG("Applied %u, skipped %u unwritten", (uint32_t)resources.size() - skipped, skipped);
+}
+
+template <typename Configuration>
+void ResourceManager<Configuration>::SetFirstReplayWrites(
+    rdchashmap<ResourceId, uint32_t> &&firstWrites)
+{
+  m_FirstReplayWrite.swap(firstWrites);
+}
+
+template <typename Configuration>
+void ResourceManager<Configuration>::MarkReplayedUpTo(uint32_t eventId)
+{
+  m_ReplayedUpTo = RDCMAX(m_ReplayedUpTo, eventId);
+}
+
+template <typename Configuration>
+bool ResourceManager<Configuration>::IsReplayWritten(ResourceId origid)
+{
+  auto it = m_FirstReplayWrite.find(origid);
+  return it == m_FirstReplayWrite.end() || it->second <= m_ReplayedUpTo;
 }
 
 template <typename Configuration>
@@ -1446,6 +1666,8 @@ void ResourceManager<Configuration>::PrepareInitialContents()
   float num = float(m_DirtyResources.size());
   float idx = 0.0f;
 
+  BeginPrepareInitialStateBatch();
+
   for(auto it = m_DirtyResources.begin(); it != m_DirtyResources.end(); ++it)
   {
     ResourceId id = *it;
@@ -1491,6 +1713,8 @@ void ResourceManager<Configuration>::PrepareInitialContents()
     Prepare_InitialState(res);
   }
 
+  EndPrepareInitialStateBatch();
+
   RDCDEBUG("Prepared %u dirty resources, postponed %u, skipped %u", prepared, postponed, skipped);
 }
 
@@ -1499,6 +1723,9 @@ void ResourceManager<Configuration>::InsertInitialContentsChunks(WriteSerialiser
 {
   SCOPED_LOCK_OPTIONAL(m_Lock, m_Capturing);
 
+  // the frame is over, so pick up any references still held per-thread before checking them
+  MergeThreadFrameReferences();
+
   uint32_t dirty = 0;
   uint32_t skipped = 0;
 
@@ -1507,10 +1734,31 @@ void ResourceManager<Configuration>::InsertInitialContentsChunks(WriteSerialiser
   float num = float(m_InitialContents.size());
   float idx = 0.0f;
 
-  for(auto it = m_InitialContents.begin(); it != m_InitialContents.end(); ++it)
+  // postponed resources are prepared a few entries ahead of where we're serialising, so that their
+  // readback can be in flight while earlier resources are serialised.
+  const size_t postponedPrepareWindow = 16;
+  auto prepareIt = m_InitialContents.begin();
+  size_t prepareIdx = 0, serialiseIdx = 0;
+
+  BeginPrepareInitialStateBatch();
+
+  for(auto it = m_InitialContents.begin(); it != m_InitialContents.end(); ++it, ++serialiseIdx)
   {
     ResourceId id = it->first;
 
+    for(; prepareIt != m_InitialContents.end() &&
+          prepareIdx <= serialiseIdx + postponedPrepareWindow;
+        ++prepareIt, ++prepareIdx)
+    {
+      ResourceId prepareId = prepareIt->first;
+      RecordType *prepareRecord = GetResourceRecord(prepareId);
+
+      if(prepareRecord && !prepareRecord->InternalResource &&
+         (m_FrameReferencedResources.find(prepareId) != m_FrameReferencedResources.end() ||
+          RenderDoc::Inst().GetCaptureOptions().refAllResources))
+        Prepare_InitialStateIfPostponed(prepareId, false);
+    }
+
     RenderDoc::Inst().SetProgress(CaptureProgress::SerialiseInitialStates, idx / num);
     idx += 1.0f;
 
@@ -1575,6 +1823,8 @@ void ResourceManager<Configuration>::InsertInitialContentsChunks(WriteSerialiser
     SetInitialContents(id, InitialContentData());
   }
 
+  EndPrepareInitialStateBatch();
+
   RDCDEBUG("Serialised %u resources, skipped %u unreferenced", dirty, skipped);
 }
 
@@ -1608,6 +1858,8 @@ void ResourceManager<Configuration>::ClearReferencedResources()
 {
   SCOPED_LOCK_OPTIONAL(m_Lock, m_Capturing);
 
+  MergeThreadFrameReferences();
+
   for(auto it = m_FrameReferencedResources.begin(); it != m_FrameReferencedResources.end(); ++it)
   {
     RecordType *record = GetResourceRecord(it->first);
@@ -1912,8 +2164,13 @@ ResourceId ResourceManager<Configuration>::GetOriginalID(ResourceId id)
   if(id == ResourceId())
     return id;
 
-  RDCASSERT(m_OriginalIDs.find(id) != m_OriginalIDs.end(), id);
-  return m_OriginalIDs[id];
+  auto it = m_OriginalIDs.find(id);
+  if(it == m_OriginalIDs.end())
+  {
+    RDCERR("Unknown live ID %s", ToStr(id).c_str());
+    return ResourceId();
+  }
+  return it->second;
 }
 
 template <typename Configuration>
@@ -1922,11 +2179,17 @@ ResourceId ResourceManager<Configuration>::GetUnreplacedOriginalID(ResourceId id
   if(id == ResourceId())
     return id;
 
-  if(m_Replaced.find(id) != m_Replaced.end())
-    return m_Replaced[id];
+  auto replacedit = m_Replaced.find(id);
+  if(replacedit != m_Replaced.end())
+    return replacedit->second;
 
-  RDCASSERT(m_OriginalIDs.find(id) != m_OriginalIDs.end(), id);
-  return m_OriginalIDs[id];
+  auto it = m_OriginalIDs.find(id);
+  if(it == m_OriginalIDs.end())
+  {
+    RDCERR("Unknown live ID %s", ToStr(id).c_str());
+    return ResourceId();
+  }
+  return it->second;
 }
 
 template <typename Configuration>
@@ -1939,6 +2202,11 @@ ResourceId ResourceManager<Configuration>::GetLiveID(ResourceId id)
   if(it != m_Replacements.end())
     return it->second;
 
-  RDCASSERT(m_LiveIDs.find(id) != m_LiveIDs.end(), id);
-  return m_LiveIDs[id];
+  auto liveIt = m_LiveIDs.find(id);
+  if(liveIt == m_LiveIDs.end())
+  {
+    RDCERR("Unknown original ID %s", ToStr(id).c_str());
+    return ResourceId();
+  }
+  return liveIt->second;
 }
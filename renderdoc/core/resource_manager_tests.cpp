@@ -0,0 +1,374 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "common/globalconfig.h"
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "common/timing.h"
+#include "resource_manager.h"
+
+#include "catch/catch.hpp"
+
+namespace
+{
+struct TestRecord : public ResourceRecord
+{
+  static const uint64_t NullResource = 0;
+
+  TestRecord(ResourceId id) : ResourceRecord(id, true) {}
+};
+
+struct TestInitialContents
+{
+  template <typename Configuration>
+  void Free(ResourceManager<Configuration> *mgr)
+  {
+  }
+};
+
+struct TestResourceManagerConfiguration
+{
+  typedef uint64_t WrappedResourceType;
+  typedef uint64_t RealResourceType;
+  typedef TestRecord RecordType;
+  typedef TestInitialContents InitialContentData;
+};
+
+class TestResourceManager : public ResourceManager<TestResourceManagerConfiguration>
+{
+public:
+  TestResourceManager(CaptureState &state) : ResourceManager(state) {}
+  std::map<ResourceId, FrameRefType> GetFrameReferences()
+  {
+    SCOPED_LOCK(m_Lock);
+    MergeThreadFrameReferences();
+    std::map<ResourceId, FrameRefType> ret;
+    for(auto it = m_FrameReferencedResources.begin(); it != m_FrameReferencedResources.end(); ++it)
+      ret[it->first] = it->second;
+    return ret;
+  }
+
+  // replay-side resources are numbered and given an ID when first used
+  std::map<uint64_t, ResourceId> liveIDs;
+  rdcarray<uint64_t> applied;
+
+private:
+  ResourceId GetID(uint64_t res)
+  {
+    ResourceId &id = liveIDs[res];
+    if(id == ResourceId())
+      id = ResourceIDGen::GetNewUniqueID();
+    return id;
+  }
+  bool ResourceTypeRelease(uint64_t res) { return true; }
+  bool Prepare_InitialState(uint64_t res) { return true; }
+  uint64_t GetSize_InitialState(ResourceId id, const TestInitialContents &initial) { return 0; }
+  bool Serialise_InitialState(WriteSerialiser &ser, ResourceId id, TestRecord *record,
+                              const TestInitialContents *initialData)
+  {
+    return true;
+  }
+  void Create_InitialState(ResourceId id, uint64_t live, bool hasData) {}
+  void Apply_InitialState(uint64_t live, const TestInitialContents &initial)
+  {
+    applied.push_back(live);
+  }
+};
+
+// rand() isn't thread safe, so each thread uses its own generator
+struct TestRandom
+{
+  uint32_t state;
+  uint32_t Next()
+  {
+    state = state * 1664525U + 1013904223U;
+    return state >> 8;
+  }
+  FrameRefType NextRef() { return FrameRefType(Next() % (eFrameRef_Maximum + 1)); }
+};
+
+void CheckFrameReferences(const std::map<ResourceId, FrameRefType> &refs,
+                          const std::map<ResourceId, FrameRefType> &expected)
+{
+  CHECK(refs.size() == expected.size());
+
+  for(auto it = expected.begin(); it != expected.end(); ++it)
+  {
+    auto refit = refs.find(it->first);
+    bool found = (refit != refs.end());
+    REQUIRE(found);
+    CHECK(refit->second == it->second);
+  }
+}
+};
+
+TEST_CASE("Test frame reference accumulator", "[resource_manager]")
+{
+  FrameRefAccumulator accum;
+
+  rdcarray<ResourceId> ids;
+  for(int i = 0; i < 1000; i++)
+    ids.push_back(ResourceIDGen::GetNewUniqueID());
+
+  for(size_t i = 0; i < ids.size(); i++)
+  {
+    FrameRefAccumulator::Entry &e = accum.FindOrAdd(ids[i]);
+    CHECK(e.id == ids[i]);
+    e.ref = FrameRefType(i % (eFrameRef_Maximum + 1));
+  }
+
+  CHECK(accum.Size() == ids.size());
+  CHECK(accum.Find(ResourceIDGen::GetNewUniqueID()) == NULL);
+
+  for(size_t i = 0; i < ids.size(); i++)
+  {
+    FrameRefAccumulator::Entry *e = accum.Find(ids[i]);
+    REQUIRE(e);
+    CHECK(e->id == ids[i]);
+    CHECK(e->ref == FrameRefType(i % (eFrameRef_Maximum + 1)));
+  }
+
+  // adding again finds the existing entry
+  accum.FindOrAdd(ids[5]);
+  CHECK(accum.Size() == ids.size());
+
+  accum.Clear();
+
+  CHECK(accum.Size() == 0);
+  CHECK(accum.Find(ids[0]) == NULL);
+  CHECK(accum.Find(ids[999]) == NULL);
+};
+
+TEST_CASE("Test frame references accumulated across threads", "[resource_manager]")
+{
+  CaptureState state = CaptureState::ActiveCapturing;
+  TestResourceManager mgr(state);
+
+  SECTION("single thread matches serial composition")
+  {
+    rdcarray<ResourceId> ids;
+    for(int i = 0; i < 16; i++)
+      ids.push_back(ResourceIDGen::GetNewUniqueID());
+
+    std::map<ResourceId, FrameRefType> expected;
+
+    TestRandom rng = {1234};
+
+    for(int i = 0; i < 2000; i++)
+    {
+      ResourceId id = ids[rng.Next() % ids.size()];
+      FrameRefType ref = rng.NextRef();
+
+      MarkReferenced(expected, id, ref);
+      mgr.MarkResourceFrameReferenced(id, ref);
+    }
+
+    CheckFrameReferences(mgr.GetFrameReferences(), expected);
+
+    // merging clears the accumulators, so the next references go through the slow path again
+    for(ResourceId id : ids)
+    {
+      MarkReferenced(expected, id, eFrameRef_PartialWrite);
+      mgr.MarkResourceFrameReferenced(id, eFrameRef_PartialWrite);
+    }
+
+    CheckFrameReferences(mgr.GetFrameReferences(), expected);
+  };
+
+  SECTION("multiple threads")
+  {
+    const int numThreads = 8;
+
+    rdcarray<ResourceId> shared;
+    for(int i = 0; i < 64; i++)
+      shared.push_back(ResourceIDGen::GetNewUniqueID());
+
+    rdcarray<rdcarray<ResourceId>> owned;
+    rdcarray<std::map<ResourceId, FrameRefType>> expected;
+    owned.resize(numThreads);
+    expected.resize(numThreads);
+
+    for(int t = 0; t < numThreads; t++)
+      for(int i = 0; i < 32; i++)
+        owned[t].push_back(ResourceIDGen::GetNewUniqueID());
+
+    // one resource is written by one thread and read by all the others
+    ResourceId contended = ResourceIDGen::GetNewUniqueID();
+
+    rdcarray<Threading::ThreadHandle> threads;
+    for(int t = 0; t < numThreads; t++)
+    {
+      threads.push_back(Threading::CreateThread([&, t]() {
+        TestRandom rng = {uint32_t(t * 7919 + 1)};
+
+        for(int i = 0; i < 5000; i++)
+        {
+          // resources only referenced by this thread compose exactly in order
+          ResourceId id = owned[t][rng.Next() % owned[t].size()];
+          FrameRefType ref = rng.NextRef();
+          MarkReferenced(expected[t], id, ref);
+          mgr.MarkResourceFrameReferenced(id, ref);
+
+          mgr.MarkResourceFrameReferenced(shared[rng.Next() % shared.size()], eFrameRef_Read);
+
+          mgr.MarkResourceFrameReferenced(
+              contended, t == 0 && (i % 100) == 50 ? eFrameRef_PartialWrite : eFrameRef_Read);
+        }
+      }));
+    }
+
+    for(Threading::ThreadHandle th : threads)
+    {
+      Threading::JoinThread(th);
+      Threading::CloseThread(th);
+    }
+
+    std::map<ResourceId, FrameRefType> refs = mgr.GetFrameReferences();
+
+    for(int t = 0; t < numThreads; t++)
+    {
+      for(auto it = expected[t].begin(); it != expected[t].end(); ++it)
+      {
+        INFO("thread " << t);
+        CHECK(refs[it->first] == it->second);
+      }
+    }
+
+    for(ResourceId id : shared)
+      CHECK(refs[id] == eFrameRef_Read);
+
+    // the read/write order isn't known, but it must be conservatively read-before-write
+    CHECK(refs[contended] == eFrameRef_ReadBeforeWrite);
+  };
+
+  mgr.ClearReferencedResources();
+};
+
+TEST_CASE("Test initial contents are only applied to written resources", "[resource_manager]")
+{
+  CaptureState state = CaptureState::ActiveReplaying;
+  TestResourceManager mgr(state);
+
+  rdcarray<ResourceId> ids;
+  for(uint64_t live = 1; live <= 4; live++)
+  {
+    ids.push_back(ResourceIDGen::GetNewUniqueID());
+    mgr.AddLiveResource(ids.back(), live);
+    mgr.SetInitialContents(ids.back(), TestInitialContents());
+  }
+
+  // the first three are written first at events 10, 20 and never. The last isn't tracked
+  rdchashmap<ResourceId, uint32_t> firstWrites;
+  firstWrites[ids[0]] = 10;
+  firstWrites[ids[1]] = 20;
+  firstWrites[ids[2]] = ~0U;
+  mgr.SetFirstReplayWrites(std::move(firstWrites));
+
+  auto apply = [&mgr]() {
+    mgr.applied.clear();
+    mgr.ApplyInitialContents();
+    std::sort(mgr.applied.begin(), mgr.applied.end());
+    return mgr.applied;
+  };
+
+  // nothing is known about the state of resources before the first apply
+  CHECK((apply() == rdcarray<uint64_t>({1, 2, 3, 4})));
+
+  CHECK((apply() == rdcarray<uint64_t>({4})));
+
+  mgr.MarkReplayedUpTo(15);
+  CHECK((apply() == rdcarray<uint64_t>({1, 4})));
+
+  // replays since the last apply are accumulated
+  mgr.MarkReplayedUpTo(25);
+  mgr.MarkReplayedUpTo(5);
+  CHECK((apply() == rdcarray<uint64_t>({1, 2, 4})));
+
+  mgr.MarkReplayedUpTo(9);
+  CHECK((apply() == rdcarray<uint64_t>({4})));
+
+  mgr.MarkAllReplayWritten();
+  CHECK((apply() == rdcarray<uint64_t>({1, 2, 3, 4})));
+
+  CHECK(mgr.IsReplayWritten(ids[3]));
+  CHECK(!mgr.IsReplayWritten(ids[0]));
+};
+
+TEST_CASE("Benchmark concurrent command buffer frame references", "[resource_manager][.benchmark]")
+{
+  CaptureState state = CaptureState::ActiveCapturing;
+  TestResourceManager mgr(state);
+
+  rdcarray<ResourceId> ids;
+  for(int i = 0; i < 4096; i++)
+    ids.push_back(ResourceIDGen::GetNewUniqueID());
+
+  const int cmdBuffersPerThread = 64;
+  const int refsPerCmdBuffer = 2048;
+
+  for(int numThreads : {1, 4, 16})
+  {
+    PerformanceTimer timer;
+
+    rdcarray<Threading::ThreadHandle> threads;
+    for(int t = 0; t < numThreads; t++)
+    {
+      threads.push_back(Threading::CreateThread([&, t]() {
+        TestRandom rng = {uint32_t(t + 1)};
+
+        // like a command buffer recorded on this thread then submitted, which pushes its
+        // references to the resource manager
+        for(int c = 0; c < cmdBuffersPerThread; c++)
+        {
+          ResourceRecord cmd(ResourceId(), false);
+
+          for(int r = 0; r < refsPerCmdBuffer; r++)
+            cmd.MarkResourceFrameReferenced(ids[rng.Next() % ids.size()], rng.NextRef());
+
+          cmd.AddResourceReferences(&mgr);
+        }
+      }));
+    }
+
+    for(Threading::ThreadHandle th : threads)
+    {
+      Threading::JoinThread(th);
+      Threading::CloseThread(th);
+    }
+
+    double submitMS = timer.GetMilliseconds();
+
+    timer.Restart();
+    size_t numRefs = mgr.GetFrameReferences().size();
+    double mergeMS = timer.GetMilliseconds();
+
+    RDCLOG("%d threads x %d command buffers: %.2f ms to submit, %.2f ms to merge %zu references",
+           numThreads, cmdBuffersPerThread, submitMS, mergeMS, numRefs);
+
+    mgr.ClearReferencedResources();
+  }
+};
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
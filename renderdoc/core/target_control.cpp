@@ -30,9 +30,11 @@
 #include "jpeg-compressor/jpgd.h"
 #include "os/os_specific.h"
 #include "replay/replay_driver.h"
+#include "serialise/adaptiveio.h"
 #include "serialise/serialiser.h"
+#include "serialise/transferio.h"
 
-static const uint32_t TargetControlProtocolVersion = 8;
+static const uint32_t TargetControlProtocolVersion = 10;
 
 static bool IsProtocolVersionSupported(const uint32_t protocolVersion)
 {
@@ -60,6 +62,14 @@ static bool IsProtocolVersionSupported(const uint32_t protocolVersion)
   if(protocolVersion == 7)
     return true;
 
+  // 8 -> 9 captures are copied with adaptive compression
+  if(protocolVersion == 8)
+    return true;
+
+  // 9 -> 10 captures are copied in verified chunks and can resume
+  if(protocolVersion == 9)
+    return true;
+
   if(protocolVersion == TargetControlProtocolVersion)
     return true;
 
@@ -123,6 +133,8 @@ void RenderDoc::TargetControlClientThread(uint32_t version, Network::Socket *cli
   writer.SetStreamingMode(true);
   reader.SetStreamingMode(true);
 
+  AdaptiveCodec sendCodec;
+
   rdcstr target = RenderDoc::Inst().GetCurrentTarget();
   uint32_t mypid = Process::GetCurrentPID();
 
@@ -375,10 +387,17 @@ void RenderDoc::TargetControlClientThread(uint32_t version, Network::Socket *cli
         caps = RenderDoc::Inst().GetCaptures();
 
         uint32_t id;
+        uint64_t resumeOffset = 0, resumeChecksum = 0;
 
         {
           READ_DATA_SCOPE();
           SERIALISE_ELEMENT(id);
+
+          if(version >= 10)
+          {
+            SERIALISE_ELEMENT(resumeOffset);
+            SERIALISE_ELEMENT(resumeChecksum);
+          }
         }
 
         if(id < caps.size())
@@ -389,13 +408,30 @@ void RenderDoc::TargetControlClientThread(uint32_t version, Network::Socket *cli
 
           rdcstr filename = caps[id].path;
 
-          StreamReader fileStream(FileIO::fopen(filename, FileIO::ReadBinary));
-          ser.SerialiseStream(filename, fileStream);
-
-          if(fileStream.IsErrored() || ser.IsErrored())
-            SAFE_DELETE(client);
+          if(version >= 10)
+          {
+            // a missing or unreadable file is reported in-band, so the connection stays usable
+            bool sent = ChunkedFileSend(ser.GetWriter(), filename, resumeOffset, resumeChecksum,
+                                        sendCodec);
+
+            if(ser.IsErrored())
+              SAFE_DELETE(client);
+            else if(sent)
+              RenderDoc::Inst().MarkCaptureRetrieved(id);
+          }
           else
-            RenderDoc::Inst().MarkCaptureRetrieved(id);
+          {
+            StreamReader fileStream(FileIO::fopen(filename, FileIO::ReadBinary));
+            if(version >= 9)
+              AdaptiveStreamSend(ser.GetWriter(), &fileStream, sendCodec);
+            else
+              ser.SerialiseStream(filename, fileStream);
+
+            if(fileStream.IsErrored() || ser.IsErrored())
+              SAFE_DELETE(client);
+            else
+              RenderDoc::Inst().MarkCaptureRetrieved(id);
+          }
         }
       }
       else if(type == ePacket_CycleActiveWindow)
@@ -660,11 +696,22 @@ public:
 
   void CopyCapture(uint32_t remoteID, const rdcstr &localpath)
   {
+    // if an earlier copy to the same path was interrupted, pick up where it left off
+    uint64_t resumeOffset = 0, resumeChecksum = 0;
+    if(m_Version >= 10)
+      GetTransferResumePoint(localpath + ".partial", resumeOffset, resumeChecksum);
+
     WRITE_DATA_SCOPE();
     SCOPED_SERIALISE_CHUNK(ePacket_CopyCapture);
 
     SERIALISE_ELEMENT(remoteID);
 
+    if(m_Version >= 10)
+    {
+      SERIALISE_ELEMENT(resumeOffset);
+      SERIALISE_ELEMENT(resumeChecksum);
+    }
+
     if(ser.IsErrored())
     {
       SAFE_DELETE(m_Socket);
@@ -883,11 +930,29 @@ public:
 
       msg.newCapture.path = m_CaptureCopies[msg.newCapture.captureId];
 
-      StreamWriter streamWriter(FileIO::fopen(msg.newCapture.path, FileIO::WriteBinary),
-                                Ownership::Stream);
+      bool complete = true;
+
+      if(m_Version >= 10)
+      {
+        rdcstr partialPath = msg.newCapture.path + ".partial";
+
+        complete = ChunkedFileReceive(ser.GetReader(), partialPath, m_RecvCodec, progress);
 
-      ser.SerialiseStream(msg.newCapture.path, streamWriter, progress);
+        if(complete)
+          FileIO::Move(partialPath, msg.newCapture.path, true);
+      }
+      else
+      {
+        StreamWriter streamWriter(FileIO::fopen(msg.newCapture.path, FileIO::WriteBinary),
+                                  Ownership::Stream);
 
+        if(m_Version >= 9)
+          AdaptiveStreamReceive(ser.GetReader(), &streamWriter, m_RecvCodec, progress);
+        else
+          ser.SerialiseStream(msg.newCapture.path, streamWriter, progress);
+      }
+
+      // if we disconnect, copying the capture again after reconnecting will resume
       if(reader.IsErrored())
       {
         SAFE_DELETE(m_Socket);
@@ -896,9 +961,29 @@ public:
         return msg;
       }
 
+      reader.EndChunk();
+
+      // if a chunk failed to verify but the connection is fine, ask for the rest again
+      if(!complete)
+      {
+        if(m_CopyRetries++ < 5)
+        {
+          RDCWARN("Capture copy was incomplete, resuming");
+          CopyCapture(msg.newCapture.captureId, msg.newCapture.path);
+          msg.type = TargetControlMessageType::Noop;
+          return msg;
+        }
+
+        RDCERR("Capture copy failed repeatedly, disconnecting");
+        SAFE_DELETE(m_Socket);
+
+        msg.type = TargetControlMessageType::Disconnected;
+        return msg;
+      }
+
+      m_CopyRetries = 0;
       m_CaptureCopies.erase(msg.newCapture.captureId);
 
-      reader.EndChunk();
       return msg;
     }
     else if(type == ePacket_CapturableWindowCount)
@@ -935,6 +1020,8 @@ private:
   uint32_t m_Version, m_PID;
 
   std::map<uint32_t, rdcstr> m_CaptureCopies;
+  uint32_t m_CopyRetries = 0;
+  AdaptiveCodec m_RecvCodec;
 };
 
 extern "C" RENDERDOC_API ITargetControl *RENDERDOC_CC RENDERDOC_CreateTargetControl(
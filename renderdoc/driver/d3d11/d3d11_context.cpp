@@ -1124,6 +1124,7 @@ void WrappedID3D11DeviceContext::AddAction(const ActionDescription &a)
     return;
 
   ActionDescription action = a;
+  action.customName = StringIntern::InternData(action.customName);
 
   m_AddedAction = true;
 
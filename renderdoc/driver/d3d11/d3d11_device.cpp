@@ -1469,7 +1469,7 @@ RDResult WrappedID3D11Device::ReadLogInitialisation(RDCFile *rdc, bool storeStru
 
   if(!IsStructuredExporting(m_State))
   {
-    SetupActionPointers(m_Actions, GetReplay()->WriteFrameRecord().actionList);
+    m_ActionIndex.Build(GetReplay()->WriteFrameRecord().actionList);
 
     // propagate any UAV names onto counter buffers
     rdcarray<BufferDescription> counterBuffers;
@@ -3001,10 +3001,7 @@ WrappedID3D11DeviceContext *WrappedID3D11Device::GetDeferredContext(size_t idx)
 
 const ActionDescription *WrappedID3D11Device::GetAction(uint32_t eventId)
 {
-  if(eventId >= m_Actions.size())
-    return NULL;
-
-  return m_Actions[eventId];
+  return m_ActionIndex.GetAction(eventId);
 }
 
 ResourceDescription &WrappedID3D11Device::GetResourceDesc(ResourceId id)
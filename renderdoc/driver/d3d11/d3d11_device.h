@@ -33,6 +33,7 @@
 #include "driver/dxgi/dxgi_wrapped.h"
 #include "driver/ihv/amd/ags_wrapper.h"
 #include "driver/ihv/nv/nvapi_wrapper.h"
+#include "replay/action_index.h"
 #include "d3d11_common.h"
 #include "d3d11_manager.h"
 #include "d3d11_video.h"
@@ -622,7 +623,7 @@ private:
   RDResult m_FatalError = ResultCode::Succeeded;
 
   rdcarray<FrameDescription> m_CapturedFrames;
-  rdcarray<ActionDescription *> m_Actions;
+  ActionIndex m_ActionIndex;
 
   void MaskResourceMiscFlags(UINT &MiscFlags);
 
@@ -1895,6 +1895,7 @@ void D3D12CommandData::AddAction(const ActionDescription &a)
   m_AddedAction = true;
 
   ActionDescription action = a;
+  action.customName = StringIntern::InternData(action.customName);
   action.eventId = m_LastCmdListID != ResourceId() ? m_BakedCmdListInfo[m_LastCmdListID].curEventID
                                                    : m_RootEventID;
   action.actionId = m_LastCmdListID != ResourceId() ? m_BakedCmdListInfo[m_LastCmdListID].actionCount
@@ -3703,10 +3703,7 @@ void WrappedID3D12Device::FlushLists(bool forceSync, ID3D12CommandQueue *queue)
 
 const ActionDescription *WrappedID3D12Device::GetAction(uint32_t eventId)
 {
-  if(eventId >= m_Actions.size())
-    return NULL;
-
-  return m_Actions[eventId];
+  return m_ActionIndex.GetAction(eventId);
 }
 
 bool WrappedID3D12Device::ProcessChunk(ReadSerialiser &ser, D3D12Chunk context)
@@ -4154,7 +4151,7 @@ RDResult WrappedID3D12Device::ReadLogInitialisation(RDCFile *rdc, bool storeStru
 
     m_Queue->GetParentAction().children.clear();
 
-    SetupActionPointers(m_Actions, GetReplay()->WriteFrameRecord().actionList);
+    m_ActionIndex.Build(GetReplay()->WriteFrameRecord().actionList);
 
     D3D12CommandData &cmd = *m_Queue->GetCommandData();
 
@@ -33,6 +33,7 @@
 #include "driver/dxgi/dxgi_wrapped.h"
 #include "driver/ihv/amd/ags_wrapper.h"
 #include "driver/ihv/nv/nvapi_wrapper.h"
+#include "replay/action_index.h"
 #include "replay/replay_driver.h"
 #include "d3d12_common.h"
 #include "d3d12_manager.h"
@@ -677,7 +678,7 @@ private:
 
   uint32_t m_FrameCounter = 0;
   rdcarray<FrameDescription> m_CapturedFrames;
-  rdcarray<ActionDescription *> m_Actions;
+  ActionIndex m_ActionIndex;
 
   RDResult m_FailedReplayResult = ResultCode::APIReplayFailed;
 
@@ -107,6 +107,7 @@ public:
   void DestroyResources();
   DriverInformation GetDriverInfo() { return m_DriverInfo; }
   rdcarray<GPUDevice> GetAvailableGPUs();
+  ReplayMemoryStats GetReplayMemoryStats() { return {}; }
   APIProperties GetAPIProperties();
 
   ResourceDescription &GetResourceDesc(ResourceId id);
@@ -2461,6 +2461,7 @@ bool WrappedOpenGL::EndFrameCapture(DeviceOwnedWindow devWnd)
     {
       GLResourceRecord *record = *it;
 
+      WriteWatch::Unwatch(record->Map.ptr);
       record->FreeShadowStorage();
     }
 
@@ -2524,6 +2525,7 @@ bool WrappedOpenGL::EndFrameCapture(DeviceOwnedWindow devWnd)
     {
       GLResourceRecord *record = *it;
 
+      WriteWatch::Unwatch(record->Map.ptr);
       record->FreeShadowStorage();
     }
 
@@ -2605,6 +2607,7 @@ bool WrappedOpenGL::DiscardFrameCapture(DeviceOwnedWindow devWnd)
   {
     GLResourceRecord *record = *it;
 
+    WriteWatch::Unwatch(record->Map.ptr);
     record->FreeShadowStorage();
   }
 
@@ -3371,7 +3374,8 @@ RDResult WrappedOpenGL::ReadLogInitialisation(RDCFile *rdc, bool storeStructured
   if(sectionIdx < 0)
     RETURN_ERROR_RESULT(ResultCode::FileCorrupted, "File does not contain captured API data");
 
-  StreamReader *reader = rdc->ReadSection(sectionIdx);
+  // chunks are processed strictly in order, but decompression can run ahead on another thread
+  StreamReader *reader = rdc->ReadSection(sectionIdx, true);
 
   if(IsStructuredExporting(m_State))
   {
@@ -5289,7 +5293,7 @@ RDResult WrappedOpenGL::ContextReplayLog(CaptureState readType, uint32_t startEv
     GetReplay()->WriteFrameRecord().actionList = m_ParentAction.children;
     GetReplay()->WriteFrameRecord().frameInfo.debugMessages = GetDebugMessages();
 
-    SetupActionPointers(m_Actions, GetReplay()->WriteFrameRecord().actionList);
+    m_ActionIndex.Build(GetReplay()->WriteFrameRecord().actionList);
 
     // it's easier to remove duplicate usages here than check it as we go.
     // this means if textures are bound in multiple places in the same action
@@ -5640,6 +5644,7 @@ void WrappedOpenGL::AddAction(const ActionDescription &a)
   WrappedOpenGL *context = this;
 
   ActionDescription action = a;
+  action.customName = StringIntern::InternData(action.customName);
   action.eventId = m_CurEventID;
   action.actionId = m_CurActionID;
 
@@ -5741,10 +5746,7 @@ const APIEvent &WrappedOpenGL::GetEvent(uint32_t eventId)
 
 const ActionDescription *WrappedOpenGL::GetAction(uint32_t eventId)
 {
-  if(eventId >= m_Actions.size())
-    return NULL;
-
-  return m_Actions[eventId];
+  return m_ActionIndex.GetAction(eventId);
 }
 
 const GLDrawParams &WrappedOpenGL::GetDrawParameters(uint32_t eventId)
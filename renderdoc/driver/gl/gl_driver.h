@@ -29,6 +29,7 @@
 #include "common/timing.h"
 #include "core/core.h"
 #include "driver/shaders/spirv/spirv_reflect.h"
+#include "replay/action_index.h"
 #include "gl_common.h"
 #include "gl_dispatch_table.h"
 #include "gl_manager.h"
@@ -274,7 +275,7 @@ private:
   }
 
   rdcarray<FrameDescription> m_CapturedFrames;
-  rdcarray<ActionDescription *> m_Actions;
+  ActionIndex m_ActionIndex;
   rdcarray<GLDrawParams> m_DrawcallParams;
 
   // replay
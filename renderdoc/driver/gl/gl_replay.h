@@ -122,6 +122,7 @@ public:
 
   DriverInformation GetDriverInfo() { return m_DriverInfo; }
   rdcarray<GPUDevice> GetAvailableGPUs();
+  ReplayMemoryStats GetReplayMemoryStats() { return {}; }
   APIProperties GetAPIProperties();
 
   ResourceDescription &GetResourceDesc(ResourceId id);
@@ -25,9 +25,13 @@
 
 #include "../gl_driver.h"
 #include "common/common.h"
+#include "core/settings.h"
 #include "strings/string_utils.h"
 #include "tinyfiledialogs/tinyfiledialogs.h"
 
+RDOC_EXTERN_CONFIG(uint32_t, Capture_MappedDiffMergeGap);
+RDOC_EXTERN_CONFIG(uint32_t, Capture_MappedDiffMaxRanges);
+
 enum GLbufferbitfield
 {
   DYNAMIC_STORAGE_BIT = 0x0100,
@@ -2712,6 +2716,10 @@ GLboolean WrappedOpenGL::glUnmapNamedBufferEXT(GLuint buffer)
 
     GLboolean ret = GL_TRUE;
 
+    // stop tracking writes before the memory goes away
+    if(status == GLResourceRecord::Mapped_Direct && (record->Map.access & GL_MAP_COHERENT_BIT))
+      WriteWatch::Unwatch(record->Map.ptr);
+
     switch(status)
     {
       case GLResourceRecord::Unmapped:
@@ -3065,21 +3073,58 @@ void WrappedOpenGL::PersistentMapMemoryBarrier(const std::set<GLResourceRecord *
 
     if(record->Map.ptr)
     {
-      size_t diffStart = 0, diffEnd = record->Map.length;
-      bool found = true;
+      // for coherent maps we can track which pages are written, and only compare those. This has
+      // to be fetched before we read the map so that writes from here on are caught next time.
+      rdcarray<rdcpair<size_t, size_t>> writtenRanges;
+      bool writesTracked = false;
+      if(record->Map.access & GL_MAP_COHERENT_BIT)
+      {
+        if(record->GetShadowPtr(0))
+          writesTracked = WriteWatch::FetchWritten(record->Map.ptr, writtenRanges);
+        else
+          WriteWatch::Watch(record->Map.ptr, (size_t)record->Map.length);
+      }
 
+      rdcarray<rdcpair<size_t, size_t>> diffRanges;
       if(record->GetShadowPtr(0))
-        found = FindDiffRange(record->GetShadowPtr(0), record->Map.ptr, (size_t)record->Map.length,
-                              diffStart, diffEnd);
+      {
+        if(!writesTracked)
+          writtenRanges = {{0, (size_t)record->Map.length}};
+
+        // each changed range is flushed separately, so merge nearby changes
+        const size_t mergeGap = Capture_MappedDiffMergeGap();
+
+        for(const rdcpair<size_t, size_t> &written : writtenRanges)
+        {
+          size_t first = diffRanges.size();
+          FindDiffRanges(record->GetShadowPtr(0) + written.first, record->Map.ptr + written.first,
+                         written.second - written.first, mergeGap, diffRanges);
+
+          for(size_t i = first; i < diffRanges.size(); i++)
+          {
+            diffRanges[i].first += written.first;
+            diffRanges[i].second += written.first;
+          }
+        }
+
+        // scattered writes could otherwise produce a flush chunk for every few bytes
+        CapDiffRanges(diffRanges, Capture_MappedDiffMaxRanges());
+      }
+      else
+      {
+        diffRanges = {{0, (size_t)record->Map.length}};
+      }
 
-      if(found && diffEnd > diffStart)
+      for(const rdcpair<size_t, size_t> &diff : diffRanges)
       {
+        size_t diffStart = diff.first, diffEnd = diff.second;
+
         // update the modified region in the 'comparison' shadow buffer for next check
         if(record->GetShadowPtr(0) == NULL)
           record->AllocShadowStorage(record->Map.length);
-        else
-          memcpy(record->GetShadowPtr(0) + diffStart, record->Map.ptr + diffStart,
-                 diffEnd - diffStart);
+
+        memcpy(record->GetShadowPtr(0) + diffStart, record->Map.ptr + diffStart,
+               diffEnd - diffStart);
 
         // we use our own flush function so it will serialise chunks when necessary, and it
         // also handles copying into the persistent mapped pointer and flushing the real GL
@@ -5153,7 +5198,10 @@ void WrappedOpenGL::glDeleteBuffers(GLsizei n, const GLuint *buffers)
         {
           m_PersistentMaps.erase(record);
           if(record->Map.access & GL_MAP_COHERENT_BIT)
+          {
+            WriteWatch::Unwatch(record->Map.ptr);
             m_CoherentMaps.erase(record);
+          }
         }
 
         // free any shadow storage
@@ -441,6 +441,94 @@ struct MemoryAllocation
   bool buffer = false;
 };
 
+// Tracks the sub-allocations within one block of device memory. Free space is kept as a list of
+// ranges sorted by offset which are merged with their neighbours when freed, so any allocation
+// can be released individually and the space reused.
+//
+// Buffers and images in neighbouring ranges must not share a page of bufferImageGranularity, so the
+// used ranges remember which kind of resource they hold.
+class MemoryBlockAllocator
+{
+public:
+  void Init(VkDeviceSize size, VkDeviceSize granularity);
+
+  // returns false if there's no range big enough, otherwise offs is the offset of the allocation
+  bool Allocate(VkDeviceSize size, VkDeviceSize alignment, bool buffer, VkDeviceSize &offs);
+  // returns false if there is no allocation at offs
+  bool Free(VkDeviceSize offs);
+
+  VkDeviceSize GetSize() const { return m_Size; }
+  VkDeviceSize GetUsedBytes() const { return m_UsedBytes; }
+  size_t GetAllocationCount() const { return m_Used.size(); }
+  bool IsEmpty() const { return m_Used.empty(); }
+private:
+  struct Range
+  {
+    VkDeviceSize offs;
+    VkDeviceSize size;
+    bool buffer;
+  };
+
+  size_t FindUsed(VkDeviceSize offs) const;
+
+  VkDeviceSize m_Size = 0;
+  VkDeviceSize m_Granularity = 1;
+  VkDeviceSize m_UsedBytes = 0;
+
+  // both sorted by offset. Free ranges never touch, they're merged instead
+  rdcarray<Range> m_Free;
+  rdcarray<Range> m_Used;
+};
+
+// The bookkeeping for the staging ring that streamed initial contents are read into on replay.
+// Ranges are handed out in order from the start, and the ring is only reset once nothing on the
+// GPU is reading from it any more.
+class StagingRing
+{
+public:
+  void Init(VkDeviceSize size);
+  void Reset() { m_Offset = 0; }
+  // alignments aren't necessarily a power of two, copies to images must be aligned to e.g. 12-byte
+  // texels
+  static VkDeviceSize Align(VkDeviceSize offset, VkDeviceSize alignment);
+
+  bool Fits(VkDeviceSize size, VkDeviceSize alignment) const;
+  // returns false if the range doesn't fit, otherwise offs is where it starts
+  bool Reserve(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offs);
+
+  VkDeviceSize GetSize() const { return m_Size; }
+  VkDeviceSize GetUsedBytes() const { return m_Offset; }
+private:
+  VkDeviceSize m_Size = 0;
+  VkDeviceSize m_Offset = 0;
+};
+
+// A local file that streamed initial contents are appended to while loading, each identified by
+// the offset it was written at. The file is deleted when closed.
+class InitialContentsCache
+{
+public:
+  ~InitialContentsCache() { Close(); }
+  bool Open(const rdcstr &path);
+  void Close();
+  bool IsOpen() const { return m_File != NULL; }
+  // write is called with a writer on the end of the file, the return value is the offset the
+  // written data starts at
+  uint64_t Append(const std::function<void(StreamWriter &writer)> &write);
+  // returns false if fewer than size bytes could be read
+  bool Read(uint64_t offset, byte *dst, uint64_t size);
+
+private:
+  FILE *m_File = NULL;
+  rdcstr m_Path;
+};
+
+// when memoryTypeIndex's heap is full or over budget, returns a host-visible memory type in a
+// different heap that's allowed by resourceCompatibleBitmask. Returns memoryTypeIndex if there is
+// nowhere else to go, e.g. on UMA systems with only one heap.
+uint32_t ChooseSpillMemoryType(const VkPhysicalDeviceMemoryProperties &memProps,
+                               uint32_t resourceCompatibleBitmask, uint32_t memoryTypeIndex);
+
 #define IMPLEMENT_FUNCTION_SERIALISED(ret, func, ...) \
   ret func(__VA_ARGS__);                              \
   template <typename SerialiserType>                  \
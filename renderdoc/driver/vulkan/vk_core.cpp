@@ -30,6 +30,7 @@
 #include "driver/shaders/spirv/spirv_compile.h"
 #include "jpeg-compressor/jpge.h"
 #include "maths/formatpacking.h"
+#include "serialise/parallel_export.h"
 #include "serialise/rdcfile.h"
 #include "strings/string_utils.h"
 #include "vk_debug.h"
@@ -39,6 +40,14 @@
 
 RDOC_EXTERN_CONFIG(bool, Vulkan_Debug_VerboseCommandRecording);
 
+RDOC_CONFIG(uint32_t, Vulkan_PipelineCompileThreads, 0,
+            "The number of worker threads to compile pipelines on while loading a capture. 0 uses "
+            "one thread per core, 1 compiles each pipeline inline as it is loaded.");
+
+RDOC_CONFIG(bool, Vulkan_Debug_VerifyInitialStateWriteSet, false,
+            "Restore every image's initial contents on each replay, and report any image that was "
+            "modified by the previous replay but would have been skipped as unwritten.");
+
 uint64_t VkInitParams::GetSerialiseSize()
 {
   // misc bytes and fixed integer members
@@ -191,6 +200,8 @@ WrappedVulkan::~WrappedVulkan()
 
   SAFE_DELETE(m_FrameReader);
 
+  JoinPipeCacheWriteThread();
+
   for(size_t i = 0; i < m_ThreadSerialisers.size(); i++)
     delete m_ThreadSerialisers[i];
 
@@ -203,6 +214,16 @@ WrappedVulkan::~WrappedVulkan()
   delete m_Replay;
 }
 
+void WrappedVulkan::JoinPipeCacheWriteThread()
+{
+  if(m_PipeCacheWriteThread)
+  {
+    Threading::JoinThread(m_PipeCacheWriteThread);
+    Threading::CloseThread(m_PipeCacheWriteThread);
+    m_PipeCacheWriteThread = 0;
+  }
+}
+
 VkCommandBuffer WrappedVulkan::GetInitStateCmd()
 {
   if(initStateCurBatch >= initialStateMaxBatch)
@@ -2017,9 +2038,11 @@ bool WrappedVulkan::EndFrameCapture(DeviceOwnedWindow devWnd)
       SCOPED_LOCK(m_CoherentMapsLock);
       for(auto it = m_CoherentMaps.begin(); it != m_CoherentMaps.end(); ++it)
       {
-        FreeAlignedBuffer((*it)->memMapState->refData);
-        (*it)->memMapState->refData = NULL;
-        (*it)->memMapState->needRefData = false;
+        MemMapState *state = (*it)->memMapState;
+        WriteWatch::Unwatch(state->mappedPtr + state->mapOffset);
+        FreeAlignedBuffer(state->refData);
+        state->refData = NULL;
+        state->needRefData = false;
       }
     }
 
@@ -2396,9 +2419,11 @@ bool WrappedVulkan::DiscardFrameCapture(DeviceOwnedWindow devWnd)
       SCOPED_LOCK(m_CoherentMapsLock);
       for(auto it = m_CoherentMaps.begin(); it != m_CoherentMaps.end(); ++it)
       {
-        FreeAlignedBuffer((*it)->memMapState->refData);
-        (*it)->memMapState->refData = NULL;
-        (*it)->memMapState->needRefData = false;
+        MemMapState *state = (*it)->memMapState;
+        WriteWatch::Unwatch(state->mappedPtr + state->mapOffset);
+        FreeAlignedBuffer(state->refData);
+        state->refData = NULL;
+        state->needRefData = false;
       }
     }
   }
@@ -2547,7 +2572,19 @@ RDResult WrappedVulkan::ReadLogInitialisation(RDCFile *rdc, bool storeStructured
   if(sectionIdx < 0)
     RETURN_ERROR_RESULT(ResultCode::FileCorrupted, "File does not contain captured API data");
 
-  StreamReader *reader = rdc->ReadSection(sectionIdx);
+  // chunks are processed strictly in order, but decompression can run ahead on another thread
+  StreamReader *reader = rdc->ReadSection(sectionIdx, true);
+
+  // there's no unique ID stored in a capture, but the machine it was made on, the timestamp it
+  // started at and the size of the frame data are as good as one.
+  {
+    const SectionProperties &props = rdc->GetSectionProperties(sectionIdx);
+    rdcstr captureIdent = StringFormat::Fmt("%llx_%llx_%llx_%llx", rdc->GetMachineIdent(),
+                                            rdc->GetTimestampBase(), props.uncompressedSize,
+                                            props.compressedSize);
+    m_CaptureCacheKey = (uint64_t(strhash(captureIdent.c_str())) << 32) |
+                        strhash(captureIdent.c_str(), 0x9e3779b9);
+  }
 
   if(IsStructuredExporting(m_State))
   {
@@ -2568,6 +2605,40 @@ RDResult WrappedVulkan::ReadLogInitialisation(RDCFile *rdc, bool storeStructured
     return result;
   }
 
+  // when exporting, the chunks before the frame are self-contained so they're decoded on several
+  // threads, each with its own driver instance to process them. The frame itself is still decoded
+  // in order below.
+  SDFile initChunks;
+
+  if(IsStructuredExporting(m_State) && GetStructuredExportThreads() > 1)
+  {
+    rdcarray<WrappedVulkan *> workers;
+    rdcarray<ChunkBatchExporter> exporters;
+
+    for(uint32_t i = 0; i < GetStructuredExportThreads(); i++)
+    {
+      WrappedVulkan *worker = new WrappedVulkan;
+      worker->SetStructuredExport(m_SectionVersion);
+      workers.push_back(worker);
+
+      exporters.push_back([worker, storeStructuredBuffers](StreamReader *batch, SDFile &output) {
+        return worker->ExportChunkBatch(batch, storeStructuredBuffers, output);
+      });
+    }
+
+    RDResult result = ExportChunksParallel(reader, (uint32_t)SystemChunk::CaptureScope, exporters,
+                                           initChunks);
+
+    for(WrappedVulkan *worker : workers)
+      delete worker;
+
+    if(result != ResultCode::Succeeded)
+    {
+      delete reader;
+      return result;
+    }
+  }
+
   ReadSerialiser ser(reader, Ownership::Stream);
 
   ser.SetStringDatabase(&m_StringDB);
@@ -2577,6 +2648,8 @@ RDResult WrappedVulkan::ReadLogInitialisation(RDCFile *rdc, bool storeStructured
 
   m_StructuredFile = &ser.GetStructuredFile();
 
+  AppendStructuredFile(*m_StructuredFile, initChunks);
+
   m_StoredStructuredData->version = m_StructuredFile->version = m_SectionVersion;
 
   ser.SetVersion(m_SectionVersion);
@@ -2601,7 +2674,11 @@ RDResult WrappedVulkan::ReadLogInitialisation(RDCFile *rdc, bool storeStructured
   if(m_ReplayOptions.apiValidation)
     sink = new ScopedDebugMessageSink(this);
 
-  for(;;)
+  if(!IsStructuredExporting(m_State) && Vulkan_PipelineCompileThreads() != 1)
+    m_PipelineCompileQueue = new Threading::JobQueue(Vulkan_PipelineCompileThreads());
+
+  // if there's no frame, the parallel export above may already have decoded everything
+  while(!reader->AtEnd())
   {
     PerformanceTimer timer;
 
@@ -2613,6 +2690,8 @@ RDResult WrappedVulkan::ReadLogInitialisation(RDCFile *rdc, bool storeStructured
 
     if(reader->IsErrored())
     {
+      FlushDeferredPipelineCompiles();
+      SAFE_DELETE(m_PipelineCompileQueue);
       SAFE_DELETE(sink);
       return RDResult(ResultCode::APIDataCorrupted, ser.GetError().message);
     }
@@ -2627,6 +2706,8 @@ RDResult WrappedVulkan::ReadLogInitialisation(RDCFile *rdc, bool storeStructured
 
     if(reader->IsErrored())
     {
+      FlushDeferredPipelineCompiles();
+      SAFE_DELETE(m_PipelineCompileQueue);
       SAFE_DELETE(sink);
       return RDResult(ResultCode::APIDataCorrupted, ser.GetError().message);
     }
@@ -2653,6 +2734,8 @@ RDResult WrappedVulkan::ReadLogInitialisation(RDCFile *rdc, bool storeStructured
             "\n\nMore debugging information may be available by enabling API validation on replay";
       }
 
+      FlushDeferredPipelineCompiles();
+      SAFE_DELETE(m_PipelineCompileQueue);
       SAFE_DELETE(sink);
       m_FailedReplayResult.message = rdcstr(m_FailedReplayResult.message) + extra;
       return m_FailedReplayResult;
@@ -2670,6 +2753,16 @@ RDResult WrappedVulkan::ReadLogInitialisation(RDCFile *rdc, bool storeStructured
 
     if((SystemChunk)context == SystemChunk::CaptureScope)
     {
+      // all pipelines must be created before we start replaying the frame
+      bool compiled = FlushDeferredPipelineCompiles();
+      SAFE_DELETE(m_PipelineCompileQueue);
+
+      if(!compiled)
+      {
+        SAFE_DELETE(sink);
+        return m_FailedReplayResult;
+      }
+
       GetReplay()->WriteFrameRecord().frameInfo.fileOffset = offsetStart;
 
       // read the remaining data into memory and pass to immediate context
@@ -2714,8 +2807,14 @@ RDResult WrappedVulkan::ReadLogInitialisation(RDCFile *rdc, bool storeStructured
       break;
   }
 
+  bool compiled = FlushDeferredPipelineCompiles();
+  SAFE_DELETE(m_PipelineCompileQueue);
+
   SAFE_DELETE(sink);
 
+  if(!compiled)
+    return m_FailedReplayResult;
+
 #if ENABLED(RDOC_DEVEL)
   for(auto it = chunkInfos.begin(); it != chunkInfos.end(); ++it)
   {
@@ -2763,6 +2862,8 @@ RDResult WrappedVulkan::ReadLogInitialisation(RDCFile *rdc, bool storeStructured
 
     // steal the command buffer out of the pending commands - we'll manage its lifetime ourselves
     m_InternalCmds.pendingcmds.pop_back();
+
+    CalculateFirstReplayWrites();
   }
 
   FreeAllMemory(MemoryScope::IndirectReadback);
@@ -2975,7 +3076,7 @@ RDResult WrappedVulkan::ContextReplayLog(CaptureState readType, uint32_t startEv
   {
     GetReplay()->WriteFrameRecord().actionList = m_ParentAction.Bake();
 
-    SetupActionPointers(m_Actions, GetReplay()->WriteFrameRecord().actionList);
+    m_ActionIndex.Build(GetReplay()->WriteFrameRecord().actionList);
 
     m_ParentAction.children.clear();
   }
@@ -3050,6 +3151,21 @@ void WrappedVulkan::ApplyInitialContents()
     m_ExternalQueues[i].queue = queue;
   }
 
+  // to verify the write set, hash every image that would be skipped and then restore everything.
+  // If any of them change, a write was missed.
+  rdcarray<rdcpair<ResourceId, uint64_t>> unwrittenImages;
+  if(Vulkan_Debug_VerifyInitialStateWriteSet() && IsActiveReplaying(m_State))
+  {
+    for(auto it = m_ImageStates.begin(); it != m_ImageStates.end(); ++it)
+    {
+      ResourceId orig = GetResourceManager()->GetOriginalID(it->first);
+      if(!GetResourceManager()->IsReplayWritten(orig))
+        unwrittenImages.push_back({it->first, HashImageContents(it->first)});
+    }
+
+    GetResourceManager()->MarkAllReplayWritten();
+  }
+
   // add a global memory barrier to ensure all writes have finished and are synchronised
   // add memory barrier to ensure this copy completes before any subsequent work
   // this is a very blunt instrument but it ensures we don't get random artifacts around
@@ -3080,6 +3196,9 @@ void WrappedVulkan::ApplyInitialContents()
   SubmitCmds();
   FlushQ();
 
+  // this also means nothing is reading from the streamed initial contents staging ring
+  m_InitContentsRing.Reset();
+
   // actually apply the initial contents here
   GetResourceManager()->ApplyInitialContents();
 
@@ -3121,6 +3240,13 @@ void WrappedVulkan::ApplyInitialContents()
   FlushQ();
   SubmitAndFlushImageStateBarriers(m_cleanupImageBarriers);
 
+  for(const rdcpair<ResourceId, uint64_t> &img : unwrittenImages)
+  {
+    if(HashImageContents(img.first) != img.second)
+      RDCERR("Image %s was modified by replay but its initial contents would have been skipped",
+             ToStr(GetResourceManager()->GetOriginalID(img.first)).c_str());
+  }
+
   // reset any queries to a valid copy-able state if they need to be copied.
   if(!m_ResetQueries.empty())
   {
@@ -3187,6 +3313,148 @@ void WrappedVulkan::ApplyInitialContents()
   }
 }
 
+static bool UsageMayWrite(ResourceUsage usage)
+{
+  if(usage >= ResourceUsage::VS_Constants && usage <= ResourceUsage::All_Constants)
+    return false;
+  if(usage >= ResourceUsage::VS_Resource && usage <= ResourceUsage::All_Resource)
+    return false;
+
+  switch(usage)
+  {
+    case ResourceUsage::Unused:
+    case ResourceUsage::VertexBuffer:
+    case ResourceUsage::IndexBuffer:
+    case ResourceUsage::InputTarget:
+    case ResourceUsage::Indirect:
+    case ResourceUsage::ResolveSrc:
+    case ResourceUsage::CopySrc: return false;
+    // anything else, including discards and barriers, could change the contents
+    default: return true;
+  }
+}
+
+void WrappedVulkan::CalculateFirstReplayWrites()
+{
+  // Only images are tracked. Memory can be written through buffer device addresses or mapped
+  // pointers without any usage being recorded, and descriptor sets are cheap to restore anyway.
+  // Each image's writes are all recorded as usage unless it shares memory with something else, or
+  // it could be written through a descriptor that was skipped.
+  struct BoundRange
+  {
+    ResourceId memory;
+    VkDeviceSize offset, size;
+    ResourceId image;
+
+    bool operator<(const BoundRange &o) const
+    {
+      if(memory != o.memory)
+        return memory < o.memory;
+      return offset < o.offset;
+    }
+  };
+
+  rdcarray<BoundRange> ranges;
+  for(auto it = m_ImageStates.begin(); it != m_ImageStates.end(); ++it)
+  {
+    LockedConstImageStateRef state = it->second.LockRead();
+    if(state->boundMemory != ResourceId())
+      ranges.push_back({state->boundMemory, state->boundMemoryOffset, state->boundMemorySize,
+                        it->first});
+  }
+
+  std::sort(ranges.begin(), ranges.end());
+
+  // any group of images with overlapping ranges can be written through each other
+  std::unordered_set<ResourceId> aliased;
+  for(size_t i = 0; i < ranges.size();)
+  {
+    size_t groupEnd = i + 1;
+    VkDeviceSize end = ranges[i].offset + ranges[i].size;
+    while(groupEnd < ranges.size() && ranges[groupEnd].memory == ranges[i].memory &&
+          ranges[groupEnd].offset < end)
+    {
+      end = RDCMAX(end, ranges[groupEnd].offset + ranges[groupEnd].size);
+      groupEnd++;
+    }
+
+    if(groupEnd - i > 1)
+    {
+      for(; i < groupEnd; i++)
+        aliased.insert(ranges[i].image);
+    }
+
+    i = groupEnd;
+  }
+
+  rdchashmap<ResourceId, uint32_t> firstWrites;
+
+  for(const BoundRange &range : ranges)
+  {
+    const ResourceId id = range.image;
+    const ResourceId orig = GetResourceManager()->GetOriginalID(id);
+
+    if(aliased.find(id) != aliased.end())
+      continue;
+
+    if(GetResourceManager()->GetInitialContents(orig).type != eResImage)
+      continue;
+
+    const VulkanCreationInfo::Image &imInfo = m_CreationInfo.m_Image[id];
+    if(imInfo.external)
+      continue;
+
+    if(m_SkippedDescriptorUsage && (imInfo.creationFlags & TextureCategory::ShaderReadWrite))
+      continue;
+
+    if(IsBoundMemoryWritten(range.memory, range.offset, range.size))
+      continue;
+
+    // an image that's never written only needs to be restored when everything is
+    uint32_t firstWrite = ~0U;
+    for(const EventUsage &u : m_ResourceUses[id])
+      if(UsageMayWrite(u.usage))
+        firstWrite = RDCMIN(firstWrite, u.eventId);
+
+    firstWrites[orig] = firstWrite;
+  }
+
+  RDCDEBUG("Tracking writes for %zu of %zu images", firstWrites.size(), m_ImageStates.size());
+
+  GetResourceManager()->SetFirstReplayWrites(std::move(firstWrites));
+
+  // loading replayed the whole frame
+  GetResourceManager()->MarkAllReplayWritten();
+}
+
+uint64_t WrappedVulkan::HashImageContents(ResourceId liveId)
+{
+  const VulkanCreationInfo::Image &imInfo = m_CreationInfo.m_Image[liveId];
+
+  // FNV-1a over every subresource
+  uint64_t hash = 14695981039346656037ULL;
+
+  bytebuf data;
+  for(uint32_t mip = 0; mip < imInfo.mipLevels; mip++)
+  {
+    for(uint32_t slice = 0; slice < imInfo.arrayLayers; slice++)
+    {
+      for(uint32_t sample = 0; sample < (uint32_t)imInfo.samples; sample++)
+      {
+        GetReplay()->GetTextureData(liveId, {mip, slice, sample}, GetTextureDataParams(), data);
+
+        for(byte b : data)
+        {
+          hash ^= b;
+          hash *= 1099511628211ULL;
+        }
+      }
+    }
+  }
+
+  return hash;
+}
+
 bool WrappedVulkan::ContextProcessChunk(ReadSerialiser &ser, VulkanChunk chunk)
 {
   m_AddedAction = false;
@@ -3218,6 +3486,51 @@ bool WrappedVulkan::ContextProcessChunk(ReadSerialiser &ser, VulkanChunk chunk)
   return true;
 }
 
+RDResult WrappedVulkan::ExportChunkBatch(StreamReader *reader, bool storeStructuredBuffers,
+                                         SDFile &output)
+{
+  ReadSerialiser ser(reader, Ownership::Nothing);
+
+  ser.SetStringDatabase(&m_StringDB);
+  ser.SetUserData(GetResourceManager());
+
+  ser.ConfigureStructuredExport(&GetChunkName, storeStructuredBuffers, 0, 1.0);
+
+  ser.SetVersion(m_SectionVersion);
+
+  m_StructuredFile = &ser.GetStructuredFile();
+
+  RDResult ret = ResultCode::Succeeded;
+
+  while(!reader->AtEnd())
+  {
+    VulkanChunk context = ser.ReadChunk<VulkanChunk>();
+
+    bool success = !reader->IsErrored() && ProcessChunk(ser, context);
+
+    ser.EndChunk();
+
+    if(reader->IsErrored())
+    {
+      ret = RDResult(ResultCode::APIDataCorrupted, ser.GetError().message);
+      break;
+    }
+
+    if(!success)
+    {
+      ret = m_FailedReplayResult;
+      break;
+    }
+  }
+
+  if(ret == ResultCode::Succeeded)
+    m_StructuredFile->Swap(output);
+
+  m_StructuredFile = m_StoredStructuredData;
+
+  return ret;
+}
+
 bool WrappedVulkan::ProcessChunk(ReadSerialiser &ser, VulkanChunk chunk)
 {
   switch(chunk)
@@ -3784,6 +4097,8 @@ void WrappedVulkan::ReplayLog(uint32_t startEventID, uint32_t endEventID, Replay
     VkMarkerRegion::End();
   }
 
+  GetResourceManager()->MarkReplayedUpTo(endEventID);
+
   m_State = CaptureState::ActiveReplaying;
 
   VkMarkerRegion::Set(StringFormat::Fmt("!!!!RenderDoc Internal: RenderDoc Replay %d (%d): %u->%u",
@@ -4479,6 +4794,7 @@ void WrappedVulkan::AddAction(const ActionDescription &a)
   m_AddedAction = true;
 
   ActionDescription action = a;
+  action.customName = StringIntern::InternData(action.customName);
   action.eventId = m_LastCmdBufferID != ResourceId()
                        ? m_BakedCmdBufferInfo[m_LastCmdBufferID].curEventID
                        : m_RootEventID;
@@ -4754,6 +5070,7 @@ void WrappedVulkan::AddUsage(VulkanActionTreeNode &actionNode, rdcarray<DebugMes
           if(!hugeRangeWarned)
             RDCWARN("Skipping large, most likely 'bindless', descriptor range");
           hugeRangeWarned = true;
+          m_SkippedDescriptorUsage = true;
           continue;
         }
 
@@ -4942,10 +5259,7 @@ const APIEvent &WrappedVulkan::GetEvent(uint32_t eventId)
 
 const ActionDescription *WrappedVulkan::GetAction(uint32_t eventId)
 {
-  if(eventId >= m_Actions.size())
-    return NULL;
-
-  return m_Actions[eventId];
+  return m_ActionIndex.GetAction(eventId);
 }
 
 uint32_t WrappedVulkan::FindCommandQueueFamily(ResourceId cmdId)
@@ -25,6 +25,7 @@
 #pragma once
 
 #include "common/timing.h"
+#include "replay/action_index.h"
 #include "serialise/serialiser.h"
 #include "vk_common.h"
 #include "vk_info.h"
@@ -384,7 +385,7 @@ private:
   uint32_t m_FrameCounter = 0;
 
   rdcarray<FrameDescription> m_CapturedFrames;
-  rdcarray<ActionDescription *> m_Actions;
+  ActionIndex m_ActionIndex;
 
   struct PhysicalDeviceData
   {
@@ -553,17 +554,72 @@ private:
   int initStateCurBatch = 0;
   VkCommandBuffer initStateCurCmd = VK_NULL_HANDLE;
 
+  // capture only, readbacks for initial states. While batching, Prepare_InitialState records its
+  // copies into a shared command buffer and groups are submitted with a fence rather than waiting
+  // on each one, so the GPU copies later groups while earlier ones are serialised.
+  struct InitStateReadbackBatch
+  {
+    VkCommandBuffer cmd = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    rdcarray<ResourceId> ids;
+    rdcarray<VkBuffer> buffers;
+    VkDeviceSize size = 0;
+  };
+
+  static const VkDeviceSize initialStateMaxReadbackBatchSize = 256 * 1024 * 1024;
+  bool m_InitStateReadbackBatching = false;
+  InitStateReadbackBatch m_InitStateReadbackRecording;
+  rdcarray<InitStateReadbackBatch> m_InitStateReadbacksInFlight;
+
+  VkCommandBuffer GetInitStateReadbackCmd();
+  void AddInitStateReadback(ResourceId id, VkBuffer readbackBuf, VkDeviceSize size);
+  void SubmitInitStateReadbacks();
+  void RetireInitStateReadbacks(size_t count);
+
+  // replay only, for streamed initial contents. Their data is kept in a local cache file rather
+  // than in upload memory, and is read into a staging ring just before it's copied in
+  // Apply_InitialState. When the ring is full all pending work is flushed before it's reused.
+  InitialContentsCache m_InitContentsCache;
+  GPUBuffer m_InitContentsStaging;
+  byte *m_InitContentsStagingData = NULL;
+  StagingRing m_InitContentsRing;
+
+  bool OpenInitContentsCache();
+  bool InitContentsStagingFits(VkDeviceSize size, VkDeviceSize alignment);
+  bool ReserveInitContentsStaging(VkDeviceSize size, VkDeviceSize alignment,
+                                  VkDeviceSize &stagingOffset);
+  void ReadInitContentsStaging(const VkInitialContents &initial, VkDeviceSize srcOffset,
+                               VkDeviceSize stagingOffset, VkDeviceSize size);
+  void CopyStreamedInitialContents(const VkInitialContents &initial, VkBuffer dstBuf,
+                                   const rdcarray<VkBufferCopy> &regions);
+  void DestroyInitContentsStaging();
+
   // Internal lumped/pooled memory allocations
 
-  // Each memory scope gets a separate vector of allocation objects. The vector contains the list of
-  // all 'base' allocations. The offset is used to indicate the current offset, and the size is the
-  // total size, thus the free space can be determined with size - offset.
-  rdcarray<MemoryAllocation> m_MemoryBlocks[arraydim<MemoryScope>()];
+  struct MemoryBlock
+  {
+    VkDeviceMemory mem = VK_NULL_HANDLE;
+    MemoryType type = MemoryType::GPULocal;
+    uint32_t memoryTypeIndex = 0;
+    // a GPULocal block that was placed in host-visible memory because of memory pressure
+    bool spilled = false;
+    MemoryBlockAllocator ranges;
+  };
+
+  // Each memory scope gets a separate list of 'base' allocations, which resources are then
+  // sub-allocated from.
+  rdcarray<MemoryBlock> m_MemoryBlocks[arraydim<MemoryScope>()];
 
   // Per memory scope, the size of the next allocation. This allows us to balance number of memory
   // allocation objects with size by incrementally allocating larger blocks.
   VkDeviceSize m_MemoryBlockSize[arraydim<MemoryScope>()] = {};
 
+  // set if VK_EXT_memory_budget is enabled on replay, so we can avoid over-committing the device
+  bool m_MemoryBudget = false;
+
+  bool GetHeapBudget(uint32_t heapIndex, VkDeviceSize &budget, VkDeviceSize &usage);
+  VkResult AllocateMemoryBlock(VkDeviceSize size, uint32_t memoryTypeIndex, VkDeviceMemory &mem);
+
   void FreeAllMemory(MemoryScope scope);
   void FreeMemoryAllocation(MemoryAllocation alloc);
 
@@ -853,6 +909,9 @@ private:
 
   std::map<ResourceId, rdcarray<EventUsage>> m_ResourceUses;
   std::map<uint32_t, EventFlags> m_EventFlags;
+  // set if any descriptors were skipped when adding usage, so storage images can't be assumed to
+  // have all their writes recorded
+  bool m_SkippedDescriptorUsage = false;
 
   bytebuf m_MaskedMapData;
 
@@ -983,7 +1042,47 @@ private:
     return m_ActionStack;
   }
 
+  // while loading the capture, driver pipeline compiles are farmed out onto worker threads. The
+  // pipeline is wrapped immediately with no real handle so that all of the bookkeeping can proceed
+  // serially, and the job fills in the real handle. All jobs are flushed before anything could use
+  // a pipeline's real handle.
+  struct DeferredPipelineCompile
+  {
+    VkDevice device = VK_NULL_HANDLE;
+    VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+
+    // the deserialised create info, owned by this struct
+    VkGraphicsPipelineCreateInfo graphicsInfo = {};
+    VkComputePipelineCreateInfo computeInfo = {};
+
+    // storage and pointers to the unwrapped create infos. If subpass0 is set, a second pipeline is
+    // compiled for the graphics pipeline against its load renderpass
+    bytebuf unwrapMem;
+    VkGraphicsPipelineCreateInfo *unwrappedGraphics = NULL;
+    VkComputePipelineCreateInfo unwrappedCompute = {};
+    VkRenderPass subpass0RenderPass = VK_NULL_HANDLE;
+
+    VkPipeline pipe = VK_NULL_HANDLE;
+    VkPipeline subpass0pipe = VK_NULL_HANDLE;
+
+    VkResult ret = VK_SUCCESS;
+  };
+
+  Threading::JobQueue *m_PipelineCompileQueue = NULL;
+
+  // identifies the capture being replayed, for persisting its pipeline cache. See VulkanShaderCache
+  uint64_t m_CaptureCacheKey = 0;
+  Threading::ThreadHandle m_PipeCacheWriteThread = 0;
+  void JoinPipeCacheWriteThread();
+  rdcarray<DeferredPipelineCompile *> m_DeferredPipelineCompiles;
+
+  bool ShouldDeferPipelineCompile(VkPipelineCreateFlags flags, const void *pNext);
+  void DeferPipelineCompile(DeferredPipelineCompile *compile);
+  bool FlushDeferredPipelineCompiles();
+
   bool ProcessChunk(ReadSerialiser &ser, VulkanChunk chunk);
+  RDResult ExportChunkBatch(StreamReader *reader, bool storeStructuredBuffers, SDFile &output);
   RDResult ContextReplayLog(CaptureState readType, uint32_t startEventID, uint32_t endEventID,
                             bool partial);
   bool ContextProcessChunk(ReadSerialiser &ser, VulkanChunk chunk);
@@ -995,6 +1094,9 @@ private:
   void AddFramebufferUsageAllChildren(VulkanActionTreeNode &actionNode,
                                       const VulkanRenderState &renderState);
 
+  void CalculateFirstReplayWrites();
+  uint64_t HashImageContents(ResourceId liveId);
+
   // no copy semantics
   WrappedVulkan(const WrappedVulkan &);
   WrappedVulkan &operator=(const WrappedVulkan &);
@@ -1051,12 +1153,16 @@ public:
   VulkanReplay *GetReplay() { return m_Replay; }
   // replay interface
   bool Prepare_InitialState(WrappedVkRes *res);
+  void BeginInitStateReadbackBatch();
+  void WaitForInitStateReadback(ResourceId id);
+  void EndInitStateReadbackBatch();
   uint64_t GetSize_InitialState(ResourceId id, const VkInitialContents &initial);
   template <typename SerialiserType>
   bool Serialise_InitialState(SerialiserType &ser, ResourceId id, VkResourceRecord *record,
                               const VkInitialContents *initial);
   void Create_InitialState(ResourceId id, WrappedVkRes *live, bool hasData);
   void Apply_InitialState(WrappedVkRes *live, const VkInitialContents &initial);
+  bool IsBoundMemoryWritten(ResourceId boundMemory, VkDeviceSize offset, VkDeviceSize size);
 
   void RemapQueueFamilyIndices(uint32_t &srcQueueFamily, uint32_t &dstQueueFamily);
   uint32_t GetQueueFamilyIndex() const { return m_QueueFamilyIdx; }
@@ -1103,6 +1209,8 @@ public:
   MemoryAllocation AllocateMemoryForResource(VkImage im, MemoryScope scope, MemoryType type);
   MemoryAllocation AllocateMemoryForResource(VkBuffer buf, MemoryScope scope, MemoryType type);
 
+  ReplayMemoryStats GetReplayMemoryStats();
+
   void ChooseMemoryIndices();
 
   EventFlags GetEventFlags(uint32_t eid) { return m_EventFlags[eid]; }
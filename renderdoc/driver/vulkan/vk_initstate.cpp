@@ -29,12 +29,26 @@
 // VKTODOLOW there's a lot of duplicated code in this file for creating a buffer to do
 // a memory copy and saving to disk.
 
-// VKTODOLOW in general we do a lot of "create buffer, use it, flush/sync then destroy".
-// I don't know what the exact cost is, but it would be nice to batch up the buffers/etc
-// used across init state use, and only do a single flush. Also we could then get some
-// nice command buffer reuse (although need to be careful we don't create too large a
-// command buffer that stalls the GPU).
-// See INITSTATEBATCH
+// When preparing initial states in bulk at capture time, readbacks are batched - see
+// BeginInitStateReadbackBatch(). Each group of copies is recorded into one command buffer and
+// submitted with a fence, and we only wait on a group when one of its resources is serialised.
+// Resources prepared outside a batch (e.g. mid-frame) still create, copy and flush one by one.
+
+// On replay, initial contents normally stay resident in upload memory for the whole session. With
+// Vulkan_StreamInitialContents the data for memory and single-sampled images is instead written out
+// to a local cache file while loading, and only what each Apply_InitialState needs is read back
+// into a bounded staging ring - see ReserveInitContentsStaging() and StagingRing.
+
+RDOC_CONFIG(bool, Vulkan_BatchInitialStateReadback, true,
+            "Batch the readback of initial states at capture time into fewer submissions, and "
+            "serialise completed readbacks while later ones are still in flight.");
+RDOC_CONFIG(bool, Vulkan_StreamInitialContents, false,
+            "On replay, keep the initial contents of memory and single-sampled images in a local "
+            "cache file instead of in memory, and stream them in each time they're applied. This "
+            "allows opening captures with more initial contents than there is memory available, "
+            "at the cost of slower replays.");
+RDOC_CONFIG(uint32_t, Vulkan_InitialContentsStagingMB, 256,
+            "The size in MB of the staging ring used to upload streamed initial contents.");
 
 template <typename SerialiserType>
 void DoSerialise(SerialiserType &ser, AspectSparseTable &el)
@@ -43,6 +57,380 @@ void DoSerialise(SerialiserType &ser, AspectSparseTable &el)
   SERIALISE_MEMBER(table);
 }
 
+void WrappedVulkan::BeginInitStateReadbackBatch()
+{
+  RDCASSERT(!m_InitStateReadbackBatching);
+  m_InitStateReadbackBatching = Vulkan_BatchInitialStateReadback();
+}
+
+void WrappedVulkan::EndInitStateReadbackBatch()
+{
+  if(!m_InitStateReadbackBatching)
+    return;
+
+  SubmitInitStateReadbacks();
+  RetireInitStateReadbacks(m_InitStateReadbacksInFlight.size());
+
+  // recycle the command buffers, and hand back any images that were acquired from other queues
+  FlushQ();
+  SubmitAndFlushImageStateBarriers(m_cleanupImageBarriers);
+
+  m_InitStateReadbackBatching = false;
+}
+
+void WrappedVulkan::WaitForInitStateReadback(ResourceId id)
+{
+  // kick off anything recorded since the last wait, so those copies are in flight while this
+  // resource is serialised
+  SubmitInitStateReadbacks();
+
+  for(size_t i = 0; i < m_InitStateReadbacksInFlight.size(); i++)
+  {
+    if(m_InitStateReadbacksInFlight[i].ids.contains(id))
+    {
+      // batches complete in submission order, so retire everything up to this one
+      RetireInitStateReadbacks(i + 1);
+      return;
+    }
+  }
+}
+
+VkCommandBuffer WrappedVulkan::GetInitStateReadbackCmd()
+{
+  InitStateReadbackBatch &batch = m_InitStateReadbackRecording;
+
+  if(batch.cmd == VK_NULL_HANDLE)
+  {
+    batch.cmd = GetNextCmd();
+
+    if(batch.cmd == VK_NULL_HANDLE)
+      return VK_NULL_HANDLE;
+
+    VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
+                                          VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+
+    VkResult vkr = ObjDisp(batch.cmd)->BeginCommandBuffer(Unwrap(batch.cmd), &beginInfo);
+    CheckVkResult(vkr);
+  }
+
+  return batch.cmd;
+}
+
+void WrappedVulkan::AddInitStateReadback(ResourceId id, VkBuffer readbackBuf, VkDeviceSize size)
+{
+  InitStateReadbackBatch &batch = m_InitStateReadbackRecording;
+
+  batch.ids.push_back(id);
+  batch.buffers.push_back(readbackBuf);
+  batch.size += size;
+
+  // kick off the copies once we have a reasonable amount of work, so the GPU can get started while
+  // we record the next group.
+  if(batch.ids.size() >= initialStateMaxBatch || batch.size >= initialStateMaxReadbackBatchSize)
+    SubmitInitStateReadbacks();
+}
+
+void WrappedVulkan::SubmitInitStateReadbacks()
+{
+  InitStateReadbackBatch &batch = m_InitStateReadbackRecording;
+
+  if(batch.cmd == VK_NULL_HANDLE)
+    return;
+
+  VkResult vkr = ObjDisp(batch.cmd)->EndCommandBuffer(Unwrap(batch.cmd));
+  CheckVkResult(vkr);
+
+  // any images owned by other queues must be acquired before the copies execute
+  SubmitAndFlushImageStateBarriers(m_setupImageBarriers);
+  SubmitCmds();
+
+  if(m_Queue != VK_NULL_HANDLE && !HasFatalError())
+  {
+    VkFenceCreateInfo fenceInfo = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    vkr = ObjDisp(m_Device)->CreateFence(Unwrap(m_Device), &fenceInfo, NULL, &batch.fence);
+    CheckVkResult(vkr);
+
+    // an empty submission signals the fence once all previously submitted work has completed
+    if(vkr == VK_SUCCESS)
+    {
+      vkr = ObjDisp(m_Queue)->QueueSubmit(Unwrap(m_Queue), 0, NULL, batch.fence);
+      CheckVkResult(vkr);
+    }
+    else
+    {
+      batch.fence = VK_NULL_HANDLE;
+    }
+  }
+
+  m_InitStateReadbacksInFlight.push_back(batch);
+  batch = InitStateReadbackBatch();
+}
+
+void WrappedVulkan::RetireInitStateReadbacks(size_t count)
+{
+  VkDevice d = GetDev();
+
+  for(size_t i = 0; i < count; i++)
+  {
+    InitStateReadbackBatch &batch = m_InitStateReadbacksInFlight[i];
+
+    if(batch.fence != VK_NULL_HANDLE)
+    {
+      VkResult vkr = ObjDisp(d)->WaitForFences(Unwrap(d), 1, &batch.fence, VK_TRUE, UINT64_MAX);
+      CheckVkResult(vkr);
+
+      ObjDisp(d)->DestroyFence(Unwrap(d), batch.fence, NULL);
+    }
+    else
+    {
+      FlushQ();
+    }
+
+    for(VkBuffer buf : batch.buffers)
+    {
+      ObjDisp(d)->DestroyBuffer(Unwrap(d), Unwrap(buf), NULL);
+      GetResourceManager()->ReleaseWrappedResource(buf);
+    }
+  }
+
+  m_InitStateReadbacksInFlight.erase(0, count);
+}
+
+static void SerialiseContentsToCache(ReadSerialiser &ser, StreamWriter &writer)
+{
+  ser.SerialiseStream("Contents"_lit, writer, RENDERDOC_ProgressCallback()).Important();
+}
+
+static void SerialiseContentsToCache(WriteSerialiser &ser, StreamWriter &writer)
+{
+  RDCERR("Initial contents can only be streamed to the cache when reading");
+}
+
+void StagingRing::Init(VkDeviceSize size)
+{
+  m_Size = size;
+  m_Offset = 0;
+}
+
+VkDeviceSize StagingRing::Align(VkDeviceSize offset, VkDeviceSize alignment)
+{
+  return ((offset + alignment - 1) / alignment) * alignment;
+}
+
+bool StagingRing::Fits(VkDeviceSize size, VkDeviceSize alignment) const
+{
+  return Align(m_Offset, alignment) + size <= m_Size;
+}
+
+bool StagingRing::Reserve(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offs)
+{
+  if(!Fits(size, alignment))
+    return false;
+
+  offs = Align(m_Offset, alignment);
+  m_Offset = offs + size;
+  return true;
+}
+
+bool InitialContentsCache::Open(const rdcstr &path)
+{
+  Close();
+
+  m_File = FileIO::fopen(path, FileIO::OverwriteBinary);
+  if(m_File)
+    m_Path = path;
+
+  return m_File != NULL;
+}
+
+void InitialContentsCache::Close()
+{
+  if(m_File)
+  {
+    FileIO::fclose(m_File);
+    FileIO::Delete(m_Path);
+    m_File = NULL;
+    m_Path.clear();
+  }
+}
+
+uint64_t InitialContentsCache::Append(const std::function<void(StreamWriter &writer)> &write)
+{
+  FileIO::fseek64(m_File, 0, SEEK_END);
+  uint64_t offset = FileIO::ftell64(m_File);
+
+  {
+    StreamWriter writer(m_File, Ownership::Nothing);
+    write(writer);
+  }
+
+  return offset;
+}
+
+bool InitialContentsCache::Read(uint64_t offset, byte *dst, uint64_t size)
+{
+  FileIO::fseek64(m_File, offset, SEEK_SET);
+  size_t numRead = FileIO::fread(dst, 1, (size_t)size, m_File);
+
+  if(numRead != (size_t)size)
+  {
+    RDCERR("Only read %zu of %llu bytes of streamed initial contents", numRead, size);
+    return false;
+  }
+
+  return true;
+}
+
+bool WrappedVulkan::OpenInitContentsCache()
+{
+  if(!m_InitContentsCache.IsOpen())
+  {
+    rdcstr path =
+        FileIO::GetTempFolderFilename() +
+        StringFormat::Fmt("rdoc_vk_initcontents_%u_%p.bin", Process::GetCurrentPID(), this);
+
+    if(!m_InitContentsCache.Open(path))
+      RDCERR("Couldn't open '%s' to stream initial contents, keeping them in memory", path.c_str());
+  }
+
+  return m_InitContentsCache.IsOpen();
+}
+
+bool WrappedVulkan::InitContentsStagingFits(VkDeviceSize size, VkDeviceSize alignment)
+{
+  return m_InitContentsStagingData != NULL && m_InitContentsRing.Fits(size, alignment);
+}
+
+bool WrappedVulkan::ReserveInitContentsStaging(VkDeviceSize size, VkDeviceSize alignment,
+                                               VkDeviceSize &stagingOffset)
+{
+  if(!InitContentsStagingFits(size, alignment))
+  {
+    // everything recorded so far may still be reading from the ring, so flush it all before
+    // wrapping around to the start again
+    if(m_InitContentsStagingData != NULL)
+    {
+      CloseInitStateCmd();
+      SubmitAndFlushImageStateBarriers(m_setupImageBarriers);
+      SubmitCmds();
+      FlushQ();
+      SubmitAndFlushImageStateBarriers(m_cleanupImageBarriers);
+    }
+
+    m_InitContentsRing.Reset();
+
+    // callers split up memory, but an image's copies are staged together so a huge image can need
+    // more than the ring holds. Grow to fit rather than splitting its copies across submits.
+    if(m_InitContentsStagingData == NULL || size > m_InitContentsRing.GetSize())
+    {
+      DestroyInitContentsStaging();
+
+      VkDeviceSize ringSize = VkDeviceSize(Vulkan_InitialContentsStagingMB()) * 1024 * 1024;
+      m_InitContentsStaging.Create(this, GetDev(), RDCMAX(size, ringSize), 1, 0);
+
+      if(m_InitContentsStaging.mem == VK_NULL_HANDLE)
+        return false;
+
+      m_InitContentsStagingData = (byte *)m_InitContentsStaging.Map(NULL, 0);
+
+      if(m_InitContentsStagingData == NULL)
+        return false;
+
+      m_InitContentsRing.Init(m_InitContentsStaging.sz);
+    }
+  }
+
+  return m_InitContentsRing.Reserve(size, alignment, stagingOffset);
+}
+
+void WrappedVulkan::ReadInitContentsStaging(const VkInitialContents &initial,
+                                            VkDeviceSize srcOffset, VkDeviceSize stagingOffset,
+                                            VkDeviceSize size)
+{
+  m_InitContentsCache.Read(initial.streamOffset + srcOffset,
+                           m_InitContentsStagingData + stagingOffset, size);
+
+  // the ring is created with its size aligned to the non-coherent atom size
+  const VkDeviceSize nonCoherentAtomSize = GetDeviceProps().limits.nonCoherentAtomSize;
+  VkDeviceSize start = stagingOffset - (stagingOffset % nonCoherentAtomSize);
+  VkDeviceSize end = RDCMIN(AlignUp(stagingOffset + size, nonCoherentAtomSize),
+                            m_InitContentsStaging.totalsize);
+
+  VkMappedMemoryRange range = {
+      VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, NULL, m_InitContentsStaging.mem, start, end - start,
+  };
+
+  VkResult vkr = vkFlushMappedMemoryRanges(GetDev(), 1, &range);
+  CheckVkResult(vkr);
+}
+
+void WrappedVulkan::CopyStreamedInitialContents(const VkInitialContents &initial, VkBuffer dstBuf,
+                                                const rdcarray<VkBufferCopy> &regions)
+{
+  rdcarray<VkBufferCopy> staged;
+
+  auto recordStaged = [this, dstBuf, &staged]() {
+    if(staged.empty())
+      return;
+
+    VkCommandBuffer cmd = GetNextCmd();
+
+    if(cmd == VK_NULL_HANDLE)
+      return;
+
+    VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
+                                          VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+
+    VkResult vkr = ObjDisp(cmd)->BeginCommandBuffer(Unwrap(cmd), &beginInfo);
+    CheckVkResult(vkr);
+
+    ObjDisp(cmd)->CmdCopyBuffer(Unwrap(cmd), Unwrap(m_InitContentsStaging.buf), Unwrap(dstBuf),
+                                (uint32_t)staged.size(), staged.data());
+
+    vkr = ObjDisp(cmd)->EndCommandBuffer(Unwrap(cmd));
+    CheckVkResult(vkr);
+
+    staged.clear();
+  };
+
+  // split large ranges so the ring never has to grow for memory
+  const VkDeviceSize maxPiece = VkDeviceSize(Vulkan_InitialContentsStagingMB()) * 1024 * 1024;
+  const VkDeviceSize alignment = 4;
+
+  for(const VkBufferCopy &region : regions)
+  {
+    for(VkDeviceSize offs = 0; offs < region.size; offs += maxPiece)
+    {
+      VkDeviceSize size = RDCMIN(maxPiece, region.size - offs);
+
+      // record the copies already staged before the ring is flushed and overwritten
+      if(!InitContentsStagingFits(size, alignment))
+        recordStaged();
+
+      VkDeviceSize stagingOffset = 0;
+      if(!ReserveInitContentsStaging(size, alignment, stagingOffset))
+        return;
+
+      ReadInitContentsStaging(initial, region.srcOffset + offs, stagingOffset, size);
+
+      staged.push_back({stagingOffset, region.dstOffset + offs, size});
+    }
+  }
+
+  recordStaged();
+}
+
+void WrappedVulkan::DestroyInitContentsStaging()
+{
+  if(m_InitContentsStagingData != NULL)
+    m_InitContentsStaging.Unmap();
+  m_InitContentsStaging.Destroy();
+
+  m_InitContentsStaging = GPUBuffer();
+  m_InitContentsStagingData = NULL;
+  m_InitContentsRing.Init(0);
+}
+
 bool WrappedVulkan::Prepare_InitialState(WrappedVkRes *res)
 {
   ResourceId id = GetResourceManager()->GetID(res);
@@ -113,8 +501,14 @@ bool WrappedVulkan::Prepare_InitialState(WrappedVkRes *res)
     }
 
     VkDevice d = GetDev();
-    // INITSTATEBATCH
-    VkCommandBuffer cmd = GetNextCmd();
+
+    // multisampled images are copied by a separate submission in the debug manager so can't be
+    // batched. Submit any pending readbacks first so that image barriers stay in order.
+    const bool batched = m_InitStateReadbackBatching && !wasms;
+    if(m_InitStateReadbackBatching && wasms)
+      SubmitInitStateReadbacks();
+
+    VkCommandBuffer cmd = batched ? GetInitStateReadbackCmd() : GetNextCmd();
 
     // must ensure offset remains valid. Must be multiple of block size, or 4, depending on format
     VkDeviceSize bufAlignment = 4;
@@ -230,8 +624,11 @@ bool WrappedVulkan::Prepare_InitialState(WrappedVkRes *res)
     VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
                                           VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
 
-    vkr = ObjDisp(d)->BeginCommandBuffer(Unwrap(cmd), &beginInfo);
-    CheckVkResult(vkr);
+    if(!batched)
+    {
+      vkr = ObjDisp(d)->BeginCommandBuffer(Unwrap(cmd), &beginInfo);
+      CheckVkResult(vkr);
+    }
 
     VkImageAspectFlags aspectFlags = FormatImageAspects(imageInfo.format);
 
@@ -367,16 +764,23 @@ bool WrappedVulkan::Prepare_InitialState(WrappedVkRes *res)
     InlineCleanupImageBarriers(cmd, cleanupBarriers);
     m_cleanupImageBarriers.Merge(cleanupBarriers);
 
-    vkr = ObjDisp(d)->EndCommandBuffer(Unwrap(cmd));
-    CheckVkResult(vkr);
+    if(batched)
+    {
+      AddInitStateReadback(id, dstBuf, bufInfo.size);
+    }
+    else
+    {
+      vkr = ObjDisp(d)->EndCommandBuffer(Unwrap(cmd));
+      CheckVkResult(vkr);
 
-    SubmitAndFlushImageStateBarriers(m_setupImageBarriers);
-    SubmitCmds();
-    FlushQ();
-    SubmitAndFlushImageStateBarriers(m_cleanupImageBarriers);
+      SubmitAndFlushImageStateBarriers(m_setupImageBarriers);
+      SubmitCmds();
+      FlushQ();
+      SubmitAndFlushImageStateBarriers(m_cleanupImageBarriers);
 
-    ObjDisp(d)->DestroyBuffer(Unwrap(d), Unwrap(dstBuf), NULL);
-    GetResourceManager()->ReleaseWrappedResource(dstBuf);
+      ObjDisp(d)->DestroyBuffer(Unwrap(d), Unwrap(dstBuf), NULL);
+      GetResourceManager()->ReleaseWrappedResource(dstBuf);
+    }
 
     VkInitialContents initialContents(type, readbackmem);
 
@@ -405,8 +809,8 @@ bool WrappedVulkan::Prepare_InitialState(WrappedVkRes *res)
     VkResult vkr = VK_SUCCESS;
 
     VkDevice d = GetDev();
-    // INITSTATEBATCH
-    VkCommandBuffer cmd = GetNextCmd();
+    const bool batched = m_InitStateReadbackBatching;
+    VkCommandBuffer cmd = batched ? GetInitStateReadbackCmd() : GetNextCmd();
 
     VkDeviceMemory datamem = ToUnwrappedHandle<VkDeviceMemory>(res);
     VkDeviceSize datasize = record->Length;
@@ -461,23 +865,32 @@ bool WrappedVulkan::Prepare_InitialState(WrappedVkRes *res)
     VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
                                           VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
 
-    vkr = ObjDisp(d)->BeginCommandBuffer(Unwrap(cmd), &beginInfo);
-    CheckVkResult(vkr);
+    if(!batched)
+    {
+      vkr = ObjDisp(d)->BeginCommandBuffer(Unwrap(cmd), &beginInfo);
+      CheckVkResult(vkr);
+    }
 
     VkBufferCopy region = {0, 0, datasize};
 
     ObjDisp(d)->CmdCopyBuffer(Unwrap(cmd), Unwrap(record->memMapState->wholeMemBuf), Unwrap(dstBuf),
                               1, &region);
 
-    vkr = ObjDisp(d)->EndCommandBuffer(Unwrap(cmd));
-    CheckVkResult(vkr);
+    if(batched)
+    {
+      AddInitStateReadback(id, dstBuf, datasize);
+    }
+    else
+    {
+      vkr = ObjDisp(d)->EndCommandBuffer(Unwrap(cmd));
+      CheckVkResult(vkr);
 
-    // INITSTATEBATCH
-    SubmitCmds();
-    FlushQ();
+      SubmitCmds();
+      FlushQ();
 
-    ObjDisp(d)->DestroyBuffer(Unwrap(d), Unwrap(dstBuf), NULL);
-    GetResourceManager()->ReleaseWrappedResource(dstBuf);
+      ObjDisp(d)->DestroyBuffer(Unwrap(d), Unwrap(dstBuf), NULL);
+      GetResourceManager()->ReleaseWrappedResource(dstBuf);
+    }
 
     GetResourceManager()->SetInitialContents(id, VkInitialContents(type, readbackmem));
 
@@ -1399,11 +1812,30 @@ bool WrappedVulkan::Serialise_InitialState(SerialiserType &ser, ResourceId id, V
     MemoryAllocation uploadMemory;
     VkBuffer uploadBuf = VK_NULL_HANDLE;
 
+    // MSAA images are copied into a GPU-local buffer for the shader copy, so there's no point in
+    // streaming them. Anything else goes straight to the cache file without any upload memory.
+    bool streamContents = false;
+    uint64_t streamOffset = 0;
+
+    if(IsReplayingAndReading() && Vulkan_StreamInitialContents() && ContentsSize > 0)
+    {
+      if(type == eResDeviceMemory)
+        streamContents = true;
+      else
+        streamContents = m_CreationInfo.m_Image[GetResourceManager()->GetLiveID(id)].samples ==
+                         VK_SAMPLE_COUNT_1_BIT;
+
+      streamContents = streamContents && OpenInitContentsCache();
+    }
+
     // during writing, we already have the memory copied off - we just need to map it.
     if(ser.IsWriting())
     {
       if(initial && initial->mem.mem != VK_NULL_HANDLE)
       {
+        // the copy may still be in flight if it was batched
+        WaitForInitStateReadback(id);
+
         mappedMem = initial->mem;
         vkr = ObjDisp(d)->MapMemory(Unwrap(d), Unwrap(mappedMem.mem), initial->mem.offs,
                                     initial->mem.size, 0, (void **)&Contents);
@@ -1422,7 +1854,7 @@ bool WrappedVulkan::Serialise_InitialState(SerialiserType &ser, ResourceId id, V
         CheckVkResult(vkr);
       }
     }
-    else if(IsReplayingAndReading() && !ser.IsErrored())
+    else if(IsReplayingAndReading() && !ser.IsErrored() && !streamContents)
     {
       // create a buffer with memory attached, which we will fill with the initial contents
       VkBufferCreateInfo bufInfo = {
@@ -1459,9 +1891,19 @@ bool WrappedVulkan::Serialise_InitialState(SerialiserType &ser, ResourceId id, V
         return false;
     }
 
-    // not using SERIALISE_ELEMENT_ARRAY so we can deliberately avoid allocation - we serialise
-    // directly into upload memory
-    ser.Serialise("Contents"_lit, Contents, ContentsSize, SerialiserFlags::NoFlags).Important();
+    if(streamContents)
+    {
+      streamOffset = m_InitContentsCache.Append(
+          [&ser](StreamWriter &writer) { SerialiseContentsToCache(ser, writer); });
+
+      uploadMemory.size = ContentsSize;
+    }
+    else
+    {
+      // not using SERIALISE_ELEMENT_ARRAY so we can deliberately avoid allocation - we serialise
+      // directly into upload memory
+      ser.Serialise("Contents"_lit, Contents, ContentsSize, SerialiserFlags::NoFlags).Important();
+    }
 
     // unmap the resource we mapped before - we need to do this on read and on write.
     if(!IsStructuredExporting(m_State) && mappedMem.mem != VK_NULL_HANDLE)
@@ -1496,6 +1938,8 @@ bool WrappedVulkan::Serialise_InitialState(SerialiserType &ser, ResourceId id, V
       {
         VkInitialContents initialContents(type, uploadMemory);
         initialContents.buf = uploadBuf;
+        initialContents.streamed = streamContents;
+        initialContents.streamOffset = streamOffset;
 
         GetResourceManager()->SetInitialContents(id, initialContents);
       }
@@ -1525,6 +1969,8 @@ bool WrappedVulkan::Serialise_InitialState(SerialiserType &ser, ResourceId id, V
         if(c.samples == VK_SAMPLE_COUNT_1_BIT)
         {
           initialContents.buf = uploadBuf;
+          initialContents.streamed = streamContents;
+          initialContents.streamOffset = streamOffset;
         }
         else
         {
@@ -1663,6 +2109,38 @@ void WrappedVulkan::Create_InitialState(ResourceId id, WrappedVkRes *live, bool)
   }
 }
 
+bool WrappedVulkan::IsBoundMemoryWritten(ResourceId boundMemory, VkDeviceSize offset,
+                                         VkDeviceSize size)
+{
+  ResourceId origMem = GetResourceManager()->GetOriginalID(boundMemory);
+  if(origMem == ResourceId())
+    return false;
+
+  MemRefs *memRefs = GetResourceManager()->FindMemRefs(origMem);
+  // Check whether any portion of the device memory range bound to an image is written.
+  // The memory might be written by a captured command (e.g. mapped memory), or might have
+  // initial contents.
+  if(memRefs == NULL)
+  {
+    // The device memory allocation is missing reference info, and so the memory will be reset
+    // before each frame; this means the image needs to be treated as if it is uninitialized
+    // at the beginning of each replay.
+    return true;
+  }
+
+  InitPolicy policy = GetResourceManager()->GetInitPolicy();
+  for(auto it = memRefs->rangeRefs.find(offset);
+      it != memRefs->rangeRefs.end() && it->start() < offset + size; ++it)
+  {
+    // The bound memory is written, either by a captured command or by the device memory
+    // initialization policy.
+    if(IncludesWrite(it->value()) || InitReq(it->value(), policy, true) != eInitReq_None)
+      return true;
+  }
+
+  return false;
+}
+
 void WrappedVulkan::Apply_InitialState(WrappedVkRes *live, const VkInitialContents &initial)
 {
   if(HasFatalError())
@@ -1780,37 +2258,7 @@ void WrappedVulkan::Apply_InitialState(WrappedVkRes *live, const VkInitialConten
     }
     else if(initialized && boundMemory != ResourceId())
     {
-      ResourceId origMem = GetResourceManager()->GetOriginalID(boundMemory);
-      if(origMem != ResourceId())
-      {
-        MemRefs *memRefs = GetResourceManager()->FindMemRefs(origMem);
-        // Check whether any portion of the device memory range bound to this image is written.
-        // The memory might be written by a captured command (e.g. mapped memory), or might have
-        // initial contents.
-        if(memRefs == NULL)
-        {
-          // The device memory allocation is missing reference info, and so the memory will be reset
-          // before each frame; this means the image needs to be treated as if it is uninitialized
-          // at the beginning of each replay.
-          initialized = false;
-        }
-        else
-        {
-          for(auto it = memRefs->rangeRefs.find(boundMemoryOffset);
-              it != memRefs->rangeRefs.end() && it->start() < boundMemoryOffset + boundMemorySize;
-              ++it)
-          {
-            if(IncludesWrite(it->value()) ||
-               InitReq(it->value(), policy, initialized) != eInitReq_None)
-            {
-              // The bound memory is written, either by a captured command or by the device memory
-              // initialization policy.
-              initialized = false;
-              break;
-            }
-          }
-        }
-      }
+      initialized = !IsBoundMemoryWritten(boundMemory, boundMemoryOffset, boundMemorySize);
     }
 
     // handle any 'created' initial states, without an actual image with contents
@@ -1993,6 +2441,7 @@ void WrappedVulkan::Apply_InitialState(WrappedVkRes *live, const VkInitialConten
       bufAlignment = (VkDeviceSize)GetByteSize(1, 1, 1, fmt, 0);
 
     rdcarray<VkBufferImageCopy> copyRegions;
+    rdcarray<VkDeviceSize> copySizes;
     rdcarray<VkImageSubresourceRange> clearRegions;
 
     // copy each slice/mip individually
@@ -2045,7 +2494,10 @@ void WrappedVulkan::Apply_InitialState(WrappedVkRes *live, const VkInitialConten
 
             // you can't clear YUV textures, so force them to be copied either way
             if(initReq == eInitReq_Copy || initReq == eInitReq_Clear)
+            {
               copyRegions.push_back(region);
+              copySizes.push_back(bufOffset - region.bufferOffset);
+            }
           }
         }
         else if(IsDepthAndStencilFormat(fmt))
@@ -2073,7 +2525,10 @@ void WrappedVulkan::Apply_InitialState(WrappedVkRes *live, const VkInitialConten
           // pass 0 for mip since we've already pre-downscaled extent
           bufOffset += GetByteSize(extent.width, extent.height, extent.depth, sizeFormat, 0);
           if(initReq == eInitReq_Copy)
+          {
             copyRegions.push_back(region);
+            copySizes.push_back(bufOffset - region.bufferOffset);
+          }
           else if(initReq == eInitReq_Clear)
             clearRegions.push_back(range);
 
@@ -2086,7 +2541,10 @@ void WrappedVulkan::Apply_InitialState(WrappedVkRes *live, const VkInitialConten
           bufOffset += GetByteSize(extent.width, extent.height, extent.depth, VK_FORMAT_S8_UINT, 0);
 
           if(initReq == eInitReq_Copy)
+          {
             copyRegions.push_back(region);
+            copySizes.push_back(bufOffset - region.bufferOffset);
+          }
           else if(initReq == eInitReq_Clear)
             clearRegions.push_back(range);
         }
@@ -2111,7 +2569,10 @@ void WrappedVulkan::Apply_InitialState(WrappedVkRes *live, const VkInitialConten
           // you can't clear compressed textures, so fall back to copying them
           if(initReq == eInitReq_Copy ||
              (IsBlockFormat(imageInfo.format) && initReq == eInitReq_Clear))
+          {
             copyRegions.push_back(region);
+            copySizes.push_back(bufOffset - region.bufferOffset);
+          }
           else if(initReq == eInitReq_Clear)
             clearRegions.push_back(range);
         }
@@ -2123,6 +2584,33 @@ void WrappedVulkan::Apply_InitialState(WrappedVkRes *live, const VkInitialConten
       }
     }
 
+    // stream in the contents for the copies, retargeting them at the staging ring. They're staged
+    // all together so the copies below can still be recorded at once.
+    if(initial.streamed && !copyRegions.empty())
+    {
+      // each copy must start on a multiple of both 4 and the texel block size
+      const VkDeviceSize stagingAlign =
+          4 * RDCMAX(bufAlignment, (VkDeviceSize)GetByteSize(1, 1, 1, fmt, 0));
+
+      VkDeviceSize stagingSize = 0;
+      for(VkDeviceSize size : copySizes)
+        stagingSize = StagingRing::Align(stagingSize, stagingAlign) + size;
+
+      VkDeviceSize stagingOffset = 0;
+      if(!ReserveInitContentsStaging(stagingSize, stagingAlign, stagingOffset))
+        return;
+
+      for(size_t i = 0; i < copyRegions.size(); i++)
+      {
+        stagingOffset = StagingRing::Align(stagingOffset, stagingAlign);
+        ReadInitContentsStaging(initial, copyRegions[i].bufferOffset, stagingOffset, copySizes[i]);
+        copyRegions[i].bufferOffset = stagingOffset;
+        stagingOffset += copySizes[i];
+      }
+
+      buf = m_InitContentsStaging.buf;
+    }
+
     if(copyRegions.size() + clearRegions.size() > 0)
     {
       VkCommandBuffer cmd = GetInitStateCmd();
@@ -2255,7 +2743,7 @@ void WrappedVulkan::Apply_InitialState(WrappedVkRes *live, const VkInitialConten
     }
     RDCDEBUG("Apply_InitialState (Mem %s): %d fills, %d copies", ToStr(orig).c_str(), fillCount,
              regions.size());
-    if(regions.size() > 0)
+    if(regions.size() > 0 && !initial.streamed)
       ObjDisp(cmd)->CmdCopyBuffer(Unwrap(cmd), Unwrap(srcBuf), Unwrap(dstBuf),
                                   (uint32_t)regions.size(), regions.data());
 
@@ -2264,6 +2752,11 @@ void WrappedVulkan::Apply_InitialState(WrappedVkRes *live, const VkInitialConten
     vkr = ObjDisp(cmd)->EndCommandBuffer(Unwrap(cmd));
     CheckVkResult(vkr);
 
+    // streamed copies may need to flush the staging ring, so they're recorded once this command
+    // buffer is finished
+    if(regions.size() > 0 && initial.streamed)
+      CopyStreamedInitialContents(initial, dstBuf, regions);
+
 #if ENABLED(SINGLE_FLUSH_VALIDATE)
     SubmitCmds();
 #endif
@@ -2273,3 +2766,165 @@ void WrappedVulkan::Apply_InitialState(WrappedVkRes *live, const VkInitialConten
     RDCERR("Unhandled resource type %d", type);
   }
 }
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#undef None
+#undef Always
+
+#include "catch/catch.hpp"
+
+TEST_CASE("Test initial contents staging ring", "[vulkan]")
+{
+  StagingRing ring;
+  ring.Init(1024);
+
+  VkDeviceSize offs = 0;
+
+  SECTION("Alignment isn't required to be a power of two")
+  {
+    CHECK(StagingRing::Align(0, 12) == 0);
+    CHECK(StagingRing::Align(1, 12) == 12);
+    CHECK(StagingRing::Align(12, 12) == 12);
+    CHECK(StagingRing::Align(13, 12) == 24);
+    CHECK(StagingRing::Align(100, 4) == 100);
+
+    REQUIRE(ring.Reserve(10, 4, offs));
+    CHECK(offs == 0);
+
+    REQUIRE(ring.Reserve(10, 12, offs));
+    CHECK(offs == 12);
+
+    REQUIRE(ring.Reserve(1, 48, offs));
+    CHECK(offs == 48);
+
+    CHECK(ring.GetUsedBytes() == 49);
+  };
+
+  SECTION("Ranges are handed out until the ring is full")
+  {
+    REQUIRE(ring.Reserve(1000, 4, offs));
+    CHECK(offs == 0);
+
+    CHECK(ring.Fits(24, 4));
+    CHECK_FALSE(ring.Fits(25, 4));
+
+    // aligning pushes it past the end
+    CHECK_FALSE(ring.Fits(20, 16));
+
+    VkDeviceSize prev = offs;
+    CHECK_FALSE(ring.Reserve(25, 4, offs));
+    CHECK(offs == prev);
+    CHECK(ring.GetUsedBytes() == 1000);
+
+    REQUIRE(ring.Reserve(24, 4, offs));
+    CHECK(offs == 1000);
+    CHECK_FALSE(ring.Fits(1, 1));
+
+    // once the GPU is done with it, everything is available again
+    ring.Reset();
+    CHECK(ring.GetUsedBytes() == 0);
+    REQUIRE(ring.Reserve(1024, 4, offs));
+    CHECK(offs == 0);
+  };
+
+  SECTION("Ranges larger than the ring never fit")
+  {
+    CHECK_FALSE(ring.Fits(1025, 1));
+    CHECK_FALSE(ring.Reserve(1025, 1, offs));
+
+    // the ring is regrown for them
+    ring.Init(2048);
+    REQUIRE(ring.Reserve(1025, 1, offs));
+    CHECK(offs == 0);
+  };
+
+  SECTION("Image copies packed into one reservation stay in bounds")
+  {
+    // the same layout that's used for the copies of an image's subresources
+    const VkDeviceSize stagingAlign = 4 * 12;
+    const VkDeviceSize copySizes[] = {300, 75, 18, 6};
+
+    REQUIRE(ring.Reserve(7, 4, offs));
+
+    VkDeviceSize stagingSize = 0;
+    for(VkDeviceSize size : copySizes)
+      stagingSize = StagingRing::Align(stagingSize, stagingAlign) + size;
+
+    VkDeviceSize stagingOffset = 0;
+    REQUIRE(ring.Reserve(stagingSize, stagingAlign, stagingOffset));
+    const VkDeviceSize reserveEnd = stagingOffset + stagingSize;
+
+    VkDeviceSize prevEnd = stagingOffset;
+    for(VkDeviceSize size : copySizes)
+    {
+      stagingOffset = StagingRing::Align(stagingOffset, stagingAlign);
+      CHECK(stagingOffset % stagingAlign == 0);
+      CHECK(stagingOffset >= prevEnd);
+      stagingOffset += size;
+      CHECK(stagingOffset <= reserveEnd);
+      prevEnd = stagingOffset;
+    }
+
+    CHECK(prevEnd == reserveEnd);
+    CHECK(ring.GetUsedBytes() == reserveEnd);
+  };
+}
+
+TEST_CASE("Test initial contents cache file", "[vulkan]")
+{
+  rdcstr path = FileIO::GetTempFolderFilename() + "rdoc_vk_initcontents_test.bin";
+
+  InitialContentsCache cache;
+  REQUIRE(cache.Open(path));
+  CHECK(cache.IsOpen());
+
+  bytebuf contents[3];
+  uint64_t offsets[3] = {};
+
+  for(size_t i = 0; i < ARRAY_COUNT(contents); i++)
+  {
+    contents[i].resize(1000 * (i + 1) + 3);
+    for(size_t b = 0; b < contents[i].size(); b++)
+      contents[i][b] = byte((b * 7 + i) & 0xff);
+
+    offsets[i] = cache.Append([&contents, i](StreamWriter &writer) {
+      writer.Write(contents[i].data(), contents[i].size());
+    });
+  }
+
+  // each one is appended directly after the last
+  CHECK(offsets[0] == 0);
+  CHECK(offsets[1] == contents[0].size());
+  CHECK(offsets[2] == contents[0].size() + contents[1].size());
+
+  // read back out of order, and partial ranges as memory is split into pieces
+  bytebuf readback;
+  for(size_t i : {2, 0, 1})
+  {
+    readback.resize(contents[i].size());
+    REQUIRE(cache.Read(offsets[i], readback.data(), readback.size()));
+    CHECK(readback == contents[i]);
+  }
+
+  readback.resize(100);
+  REQUIRE(cache.Read(offsets[1] + 500, readback.data(), readback.size()));
+  CHECK(memcmp(readback.data(), contents[1].data() + 500, 100) == 0);
+
+  // appending after reading still goes at the end
+  uint64_t offset = cache.Append([](StreamWriter &writer) { writer.Write<uint32_t>(0x12345678); });
+  CHECK(offset == offsets[2] + contents[2].size());
+
+  uint32_t value = 0;
+  REQUIRE(cache.Read(offset, (byte *)&value, sizeof(value)));
+  CHECK(value == 0x12345678);
+
+  // reading past the end fails
+  CHECK_FALSE(cache.Read(offset, readback.data(), readback.size()));
+
+  cache.Close();
+  CHECK_FALSE(cache.IsOpen());
+  CHECK_FALSE(FileIO::exists(path));
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -1000,6 +1000,16 @@ bool VulkanResourceManager::Prepare_InitialState(WrappedVkRes *res)
   return m_Core->Prepare_InitialState(res);
 }
 
+void VulkanResourceManager::BeginPrepareInitialStateBatch()
+{
+  m_Core->BeginInitStateReadbackBatch();
+}
+
+void VulkanResourceManager::EndPrepareInitialStateBatch()
+{
+  m_Core->EndInitStateReadbackBatch();
+}
+
 uint64_t VulkanResourceManager::GetSize_InitialState(ResourceId id, const VkInitialContents &initial)
 {
   return m_Core->GetSize_InitialState(id, initial);
@@ -129,6 +129,11 @@ struct VkInitialContents
   MemoryAllocation mem;
   Tag tag;
 
+  // on replay when streaming initial contents, buf is unset and the mem.size bytes of contents are
+  // instead at this offset in the local cache file
+  bool streamed;
+  uint64_t streamOffset;
+
   // for sparse resources. The tables pointer is only valid on capture, it is converted to the queue
   // sparse bind. Similar to the descriptors above
   rdcarray<AspectSparseTable> *sparseTables;
@@ -312,6 +317,37 @@ public:
     return wrapped->id;
   }
 
+  // wrap a non-dispatchable resource before its real handle exists, when creation is deferred onto
+  // another thread. The real handle must be written through UnwrapPtr() and registered with
+  // AddDeferredWrapper() before anything else uses it.
+  template <typename realtype>
+  ResourceId WrapDeferredResource(realtype &obj)
+  {
+    ResourceId id = ResourceIDGen::GetNewUniqueID();
+    typename UnwrapHelper<realtype>::Outer *wrapped =
+        new typename UnwrapHelper<realtype>::Outer(realtype(VK_NULL_HANDLE), id);
+
+    AddCurrentResource(id, wrapped);
+
+    obj = realtype((uint64_t)wrapped);
+
+    return id;
+  }
+
+  // returns false if the real handle already has a wrapper, which can happen if the driver returns
+  // the same handle for identical objects
+  template <typename realtype>
+  bool AddDeferredWrapper(realtype obj)
+  {
+    TypedRealHandle real = ToTypedHandle(Unwrap(obj));
+
+    if(HasWrapper(real))
+      return false;
+
+    AddWrapper(GetWrapped(obj), real);
+    return true;
+  }
+
   void PreFreeMemory(ResourceId id)
   {
     if(IsActiveCapturing(m_State))
@@ -452,6 +488,8 @@ private:
   bool ResourceTypeRelease(WrappedVkRes *res);
 
   bool Prepare_InitialState(WrappedVkRes *res);
+  void BeginPrepareInitialStateBatch();
+  void EndPrepareInitialStateBatch();
   uint64_t GetSize_InitialState(ResourceId id, const VkInitialContents &initial);
   bool Serialise_InitialState(WriteSerialiser &ser, ResourceId id, VkResourceRecord *record,
                               const VkInitialContents *initial);
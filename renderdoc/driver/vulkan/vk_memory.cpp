@@ -157,6 +157,200 @@ uint32_t WrappedVulkan::PhysicalDeviceData::GetMemoryIndex(uint32_t resourceComp
   return best;
 }
 
+void MemoryBlockAllocator::Init(VkDeviceSize size, VkDeviceSize granularity)
+{
+  m_Size = size;
+  m_Granularity = RDCMAX(granularity, (VkDeviceSize)1);
+  m_UsedBytes = 0;
+
+  m_Free = {{0, size, false}};
+  m_Used.clear();
+}
+
+size_t MemoryBlockAllocator::FindUsed(VkDeviceSize offs) const
+{
+  // first used range that starts at or after offs
+  size_t lo = 0, hi = m_Used.size();
+  while(lo < hi)
+  {
+    size_t mid = (lo + hi) / 2;
+    if(m_Used[mid].offs < offs)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+bool MemoryBlockAllocator::Allocate(VkDeviceSize size, VkDeviceSize alignment, bool buffer,
+                                    VkDeviceSize &offs)
+{
+  // first-fit, so that allocations pack towards the start of the block and the free space left at
+  // the end stays contiguous
+  for(size_t f = 0; f < m_Free.size(); f++)
+  {
+    const Range range = m_Free[f];
+
+    if(range.size < size)
+      continue;
+
+    const size_t next = FindUsed(range.offs);
+
+    VkDeviceSize start = AlignUp(range.offs, alignment);
+
+    // if the previous allocation is a different kind of resource, we can't share its last page
+    if(next > 0 && m_Used[next - 1].buffer != buffer)
+    {
+      const Range &prev = m_Used[next - 1];
+      if((prev.offs + prev.size - 1) / m_Granularity == start / m_Granularity)
+        start = AlignUp(AlignUp(prev.offs + prev.size, m_Granularity), alignment);
+    }
+
+    const VkDeviceSize end = start + size;
+
+    if(end > range.offs + range.size)
+      continue;
+
+    // likewise for the next allocation's first page
+    if(next < m_Used.size() && m_Used[next].buffer != buffer &&
+       (end - 1) / m_Granularity == m_Used[next].offs / m_Granularity)
+      continue;
+
+    // keep whatever is left before and after the allocation
+    const Range after = {end, range.offs + range.size - end, false};
+
+    if(start > range.offs)
+    {
+      m_Free[f].size = start - range.offs;
+      if(after.size > 0)
+        m_Free.insert(f + 1, after);
+    }
+    else if(after.size > 0)
+    {
+      m_Free[f] = after;
+    }
+    else
+    {
+      m_Free.erase(f);
+    }
+
+    const Range used = {start, size, buffer};
+    m_Used.insert(next, used);
+    m_UsedBytes += size;
+
+    offs = start;
+    return true;
+  }
+
+  return false;
+}
+
+bool MemoryBlockAllocator::Free(VkDeviceSize offs)
+{
+  const size_t idx = FindUsed(offs);
+
+  if(idx >= m_Used.size() || m_Used[idx].offs != offs)
+    return false;
+
+  Range range = m_Used[idx];
+  range.buffer = false;
+  m_Used.erase(idx);
+  m_UsedBytes -= range.size;
+
+  // find where this range goes in the free list, and merge it with any free neighbours
+  size_t f = 0;
+  while(f < m_Free.size() && m_Free[f].offs < range.offs)
+    f++;
+
+  if(f < m_Free.size() && range.offs + range.size == m_Free[f].offs)
+  {
+    range.size += m_Free[f].size;
+    m_Free.erase(f);
+  }
+
+  if(f > 0 && m_Free[f - 1].offs + m_Free[f - 1].size == range.offs)
+  {
+    m_Free[f - 1].size += range.size;
+    return true;
+  }
+
+  m_Free.insert(f, range);
+  return true;
+}
+
+bool WrappedVulkan::GetHeapBudget(uint32_t heapIndex, VkDeviceSize &budget, VkDeviceSize &usage)
+{
+  if(!m_MemoryBudget || ObjDisp(m_PhysicalDevice)->GetPhysicalDeviceMemoryProperties2 == NULL)
+    return false;
+
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProps = {
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+  };
+  VkPhysicalDeviceMemoryProperties2 memProps = {
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+      &budgetProps,
+  };
+
+  ObjDisp(m_PhysicalDevice)
+      ->GetPhysicalDeviceMemoryProperties2(Unwrap(m_PhysicalDevice), &memProps);
+
+  budget = budgetProps.heapBudget[heapIndex];
+  usage = budgetProps.heapUsage[heapIndex];
+
+  // drivers are supposed to report a non-zero budget for every heap, but don't trust it
+  return budget > 0;
+}
+
+uint32_t ChooseSpillMemoryType(const VkPhysicalDeviceMemoryProperties &memProps,
+                               uint32_t resourceCompatibleBitmask, uint32_t memoryTypeIndex)
+{
+  const uint32_t heap = memProps.memoryTypes[memoryTypeIndex].heapIndex;
+
+  // any host-visible type in another heap will do. Types are ordered by performance so take the
+  // first we find.
+  for(uint32_t m = 0; m < memProps.memoryTypeCount; m++)
+  {
+    if((resourceCompatibleBitmask & (1U << m)) == 0 || memProps.memoryTypes[m].heapIndex == heap)
+      continue;
+
+    if(memProps.memoryTypes[m].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+      return m;
+  }
+
+  // nowhere else to go
+  return memoryTypeIndex;
+}
+
+VkResult WrappedVulkan::AllocateMemoryBlock(VkDeviceSize size, uint32_t memoryTypeIndex,
+                                            VkDeviceMemory &mem)
+{
+  if(Vulkan_Debug_MemoryAllocationLogging())
+  {
+    RDCLOG("Creating new allocation of 0x%llx bytes in memory type %u", size, memoryTypeIndex);
+  }
+
+  VkMemoryAllocateInfo info = {
+      VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+      NULL,
+      size,
+      memoryTypeIndex,
+  };
+
+  VkDevice d = GetDev();
+
+  mem = VK_NULL_HANDLE;
+
+  // errors are not checked here, the caller may have somewhere else to try
+  VkResult vkr = ObjDisp(d)->AllocateMemory(Unwrap(d), &info, NULL, &mem);
+
+  if(vkr == VK_SUCCESS)
+    GetResourceManager()->WrapResource(Unwrap(d), mem);
+  else
+    mem = VK_NULL_HANDLE;
+
+  return vkr;
+}
+
 MemoryAllocation WrappedVulkan::AllocateMemoryForResource(bool buffer, VkMemoryRequirements mrq,
                                                           MemoryScope scope, MemoryType type)
 {
@@ -171,6 +365,9 @@ MemoryAllocation WrappedVulkan::AllocateMemoryForResource(bool buffer, VkMemoryR
   // invalidate/flush safely. This is at most 256 bytes which is likely already satisfied.
   ret.size = AlignUp(ret.size, nonCoherentAtomSize);
 
+  // the same goes for the offset, as allocations aren't packed from the start of the block
+  const VkDeviceSize alignment = RDCMAX(mrq.alignment, nonCoherentAtomSize);
+
   if(Vulkan_Debug_MemoryAllocationLogging())
   {
     RDCLOG("Allocating 0x%llx (0x%llx requested) with alignment 0x%llx in 0x%x for a %s (%s in %s)",
@@ -178,21 +375,21 @@ MemoryAllocation WrappedVulkan::AllocateMemoryForResource(bool buffer, VkMemoryR
            ToStr(type).c_str(), ToStr(scope).c_str());
   }
 
-  rdcarray<MemoryAllocation> &blockList = m_MemoryBlocks[(size_t)scope];
+  rdcarray<MemoryBlock> &blockList = m_MemoryBlocks[(size_t)scope];
 
   // first try to find a match
-  int i = 0;
-  for(MemoryAllocation &block : blockList)
+  for(size_t i = 0; i < blockList.size(); i++)
   {
+    MemoryBlock &block = blockList[i];
+
     if(Vulkan_Debug_MemoryAllocationLogging())
     {
       RDCLOG(
-          "Considering block %d: memory type %u and type %s. Total size 0x%llx, current offset "
-          "0x%llx, last alloc was %s",
-          i, block.memoryTypeIndex, ToStr(block.type).c_str(), block.size, block.offs,
-          block.buffer ? "buffer" : "image");
+          "Considering block %zu: memory type %u and type %s. Total size 0x%llx, 0x%llx used by "
+          "%zu allocations",
+          i, block.memoryTypeIndex, ToStr(block.type).c_str(), block.ranges.GetSize(),
+          block.ranges.GetUsedBytes(), block.ranges.GetAllocationCount());
     }
-    i++;
 
     // skip this block if it's not the memory type we want
     if(ret.type != block.type || (mrq.memoryTypeBits & (1 << block.memoryTypeIndex)) == 0)
@@ -204,53 +401,25 @@ MemoryAllocation WrappedVulkan::AllocateMemoryForResource(bool buffer, VkMemoryR
       continue;
     }
 
-    // offs is where we can put our next sub-allocation
-    VkDeviceSize offs = block.offs;
-
-    // if we are on a buffer/image, account for any alignment we might have to do
-    if(ret.buffer != block.buffer)
-      offs = AlignUp(offs, m_PhysicalDeviceData.props.limits.bufferImageGranularity);
-
-    // align as required by the resource
-    offs = AlignUp(offs, mrq.alignment);
-
-    if(offs > block.size)
-    {
-      if(Vulkan_Debug_MemoryAllocationLogging())
-      {
-        RDCLOG("Next offset 0x%llx would be off the end of the memory (size 0x%llx).", offs,
-               block.size);
-      }
-      continue;
-    }
-
-    VkDeviceSize avail = block.size - offs;
-
-    if(Vulkan_Debug_MemoryAllocationLogging())
-    {
-      RDCLOG("At next offset 0x%llx, there's 0x%llx bytes available for 0x%llx bytes requested",
-             offs, avail, ret.size);
-    }
-
     // if the allocation will fit, we've found our candidate.
-    if(ret.size <= avail)
+    if(block.ranges.Allocate(ret.size, alignment, ret.buffer, ret.offs))
     {
-      // update the block offset and buffer/image bit
-      block.offs = offs + ret.size;
-      block.buffer = ret.buffer;
-
-      // update our return value
-      ret.offs = offs;
       ret.mem = block.mem;
+      ret.memoryTypeIndex = block.memoryTypeIndex;
 
       if(Vulkan_Debug_MemoryAllocationLogging())
       {
-        RDCLOG("Allocating using this block: 0x%llx -> 0x%llx", ret.offs, block.offs);
+        RDCLOG("Allocating using this block: 0x%llx -> 0x%llx", ret.offs, ret.offs + ret.size);
       }
 
       // stop searching
       break;
     }
+
+    if(Vulkan_Debug_MemoryAllocationLogging())
+    {
+      RDCLOG("No free range in this block can fit 0x%llx bytes", ret.size);
+    }
   }
 
   if(ret.mem == VK_NULL_HANDLE)
@@ -276,23 +445,28 @@ MemoryAllocation WrappedVulkan::AllocateMemoryForResource(bool buffer, VkMemoryR
         break;
     }
 
+    const VkPhysicalDeviceMemoryProperties &memProps = m_PhysicalDeviceData.memProps;
+
     uint32_t memoryTypeIndex = 0;
 
+    // the resource could go in any of these types, before we narrow it down below
+    const uint32_t compatibleTypeBits = mrq.memoryTypeBits;
+
     // Upload heaps are sometimes limited in size. To prevent OOM issues, deselect any memory types
     // corresponding to a small heap (<= 512MB) if there are other memory types available.
     for(uint32_t m = 0; m < 32; m++)
     {
       if(mrq.memoryTypeBits & (1U << m))
       {
-        uint32_t heap = m_PhysicalDeviceData.memProps.memoryTypes[m].heapIndex;
-        if(m_PhysicalDeviceData.memProps.memoryHeaps[heap].size <= 512 * 1024 * 1024)
+        uint32_t heap = memProps.memoryTypes[m].heapIndex;
+        if(memProps.memoryHeaps[heap].size <= 512 * 1024 * 1024)
         {
           if(mrq.memoryTypeBits > (1U << m))
           {
             if(Vulkan_Debug_MemoryAllocationLogging())
             {
               RDCLOG("Avoiding memory type %u due to small heap size (%llu)", m,
-                     m_PhysicalDeviceData.memProps.memoryHeaps[heap].size);
+                     memProps.memoryHeaps[heap].size);
             }
             mrq.memoryTypeBits &= ~(1U << m);
           }
@@ -311,47 +485,75 @@ MemoryAllocation WrappedVulkan::AllocateMemoryForResource(bool buffer, VkMemoryR
         break;
     }
 
-    VkMemoryAllocateInfo info = {
-        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, allocSize * 1024 * 1024, memoryTypeIndex,
-    };
+    VkDeviceSize blockSize = allocSize * 1024 * 1024;
 
-    if(ret.size > info.allocationSize)
+    if(ret.size > blockSize)
     {
       // if we get an over-sized allocation, first try to immediately jump to the largest block
       // size.
       allocSize = 256;
-      info.allocationSize = allocSize * 1024 * 1024;
+      blockSize = allocSize * 1024 * 1024;
 
       // if it's still over-sized, just allocate precisely enough and give it a dedicated allocation
-      if(ret.size > info.allocationSize)
+      if(ret.size > blockSize)
       {
         if(Vulkan_Debug_MemoryAllocationLogging())
         {
           RDCLOG("Over-sized allocation for 0x%llx bytes", ret.size);
         }
-        info.allocationSize = ret.size;
+        blockSize = ret.size;
       }
     }
 
-    if(Vulkan_Debug_MemoryAllocationLogging())
+    bool spilled = false;
+
+    // if the GPU local heap is already over budget, don't push it further and risk the capture's
+    // own resources being evicted. Our memory can be in a host-visible heap instead, it will just
+    // be slower for the GPU to access.
+    if(ret.type == MemoryType::GPULocal)
     {
-      RDCLOG("Creating new allocation of 0x%llx bytes", info.allocationSize);
+      const uint32_t heap = memProps.memoryTypes[memoryTypeIndex].heapIndex;
+      VkDeviceSize budget = 0, usage = 0;
+
+      if(GetHeapBudget(heap, budget, usage) && usage + blockSize > budget)
+      {
+        uint32_t spillIndex = ChooseSpillMemoryType(memProps, compatibleTypeBits, memoryTypeIndex);
+        if(spillIndex != memoryTypeIndex)
+        {
+          RDCLOG("Heap %u would be over budget (0x%llx used of 0x%llx), using memory type %u", heap,
+                 usage, budget, spillIndex);
+          memoryTypeIndex = spillIndex;
+          spilled = true;
+        }
+      }
     }
 
-    MemoryAllocation chunk;
-    chunk.buffer = ret.buffer;
-    chunk.memoryTypeIndex = memoryTypeIndex;
-    chunk.scope = scope;
-    chunk.type = type;
-    chunk.size = info.allocationSize;
+    VkDeviceMemory mem = VK_NULL_HANDLE;
+    VkResult vkr = AllocateMemoryBlock(blockSize, memoryTypeIndex, mem);
 
-    // the offset starts immediately after this allocation
-    chunk.offs = ret.size;
+    // if we couldn't get a whole block, try again with just what we need
+    if(vkr != VK_SUCCESS && blockSize > ret.size)
+    {
+      RDCWARN("Failed to allocate 0x%llx byte block: %s. Retrying with 0x%llx bytes", blockSize,
+              ToStr(vkr).c_str(), ret.size);
+      blockSize = ret.size;
+      vkr = AllocateMemoryBlock(blockSize, memoryTypeIndex, mem);
+    }
 
-    VkDevice d = GetDev();
+    // if GPU local memory is exhausted, fall back to host-visible memory
+    if(vkr != VK_SUCCESS && ret.type == MemoryType::GPULocal && !spilled)
+    {
+      uint32_t spillIndex = ChooseSpillMemoryType(memProps, compatibleTypeBits, memoryTypeIndex);
+      if(spillIndex != memoryTypeIndex)
+      {
+        RDCWARN("Failed to allocate in memory type %u: %s. Retrying in memory type %u",
+                memoryTypeIndex, ToStr(vkr).c_str(), spillIndex);
+        memoryTypeIndex = spillIndex;
+        spilled = true;
+        vkr = AllocateMemoryBlock(blockSize, memoryTypeIndex, mem);
+      }
+    }
 
-    // do the actual allocation
-    VkResult vkr = ObjDisp(d)->AllocateMemory(Unwrap(d), &info, NULL, &chunk.mem);
     CheckVkResult(vkr);
 
     ret.offs = 0;
@@ -360,13 +562,21 @@ MemoryAllocation WrappedVulkan::AllocateMemoryForResource(bool buffer, VkMemoryR
     if(vkr != VK_SUCCESS)
       return ret;
 
-    GetResourceManager()->WrapResource(Unwrap(d), chunk.mem);
+    MemoryBlock block;
+    block.mem = mem;
+    block.type = type;
+    block.memoryTypeIndex = memoryTypeIndex;
+    block.spilled = spilled;
+    block.ranges.Init(blockSize, m_PhysicalDeviceData.props.limits.bufferImageGranularity);
 
-    // push the new chunk
-    blockList.push_back(chunk);
+    // this can't fail, the block is empty and big enough
+    block.ranges.Allocate(ret.size, alignment, ret.buffer, ret.offs);
 
-    // return the first bytes in the new chunk
-    ret.mem = chunk.mem;
+    // push the new block
+    blockList.push_back(block);
+
+    ret.mem = mem;
+    ret.memoryTypeIndex = memoryTypeIndex;
   }
 
   // ensure the returned size is accurate to what was requested, not what we padded
@@ -399,23 +609,303 @@ MemoryAllocation WrappedVulkan::AllocateMemoryForResource(VkBuffer buf, MemorySc
 
 void WrappedVulkan::FreeAllMemory(MemoryScope scope)
 {
-  rdcarray<MemoryAllocation> &allocList = m_MemoryBlocks[(size_t)scope];
+  rdcarray<MemoryBlock> &blockList = m_MemoryBlocks[(size_t)scope];
 
-  if(allocList.empty())
+  if(blockList.empty())
     return;
 
   VkDevice d = GetDev();
 
-  for(MemoryAllocation alloc : allocList)
+  for(const MemoryBlock &block : blockList)
   {
-    ObjDisp(d)->FreeMemory(Unwrap(d), Unwrap(alloc.mem), NULL);
-    GetResourceManager()->ReleaseWrappedResource(alloc.mem);
+    ObjDisp(d)->FreeMemory(Unwrap(d), Unwrap(block.mem), NULL);
+    GetResourceManager()->ReleaseWrappedResource(block.mem);
   }
 
-  allocList.clear();
+  blockList.clear();
 }
 
 void WrappedVulkan::FreeMemoryAllocation(MemoryAllocation alloc)
 {
-  // don't do anything at the moment, we only support freeing the whole scope at once.
+  if(alloc.mem == VK_NULL_HANDLE)
+    return;
+
+  rdcarray<MemoryBlock> &blockList = m_MemoryBlocks[(size_t)alloc.scope];
+
+  for(size_t i = 0; i < blockList.size(); i++)
+  {
+    MemoryBlock &block = blockList[i];
+
+    if(block.mem != alloc.mem)
+      continue;
+
+    if(!block.ranges.Free(alloc.offs))
+    {
+      RDCERR("Freeing unknown allocation at 0x%llx in %s memory", alloc.offs,
+             ToStr(alloc.scope).c_str());
+      return;
+    }
+
+    if(!block.ranges.IsEmpty())
+      return;
+
+    // temporary allocations are often made and freed one after another, so keep one empty block of
+    // each type around to avoid allocating a new block each time. Spilled blocks are always
+    // released so that the next allocation has a chance to go back to GPU local memory.
+    bool keep = !block.spilled;
+    for(size_t j = 0; keep && j < blockList.size(); j++)
+    {
+      if(j != i && blockList[j].type == block.type && blockList[j].ranges.IsEmpty())
+        keep = false;
+    }
+
+    if(!keep)
+    {
+      VkDevice d = GetDev();
+
+      ObjDisp(d)->FreeMemory(Unwrap(d), Unwrap(block.mem), NULL);
+      GetResourceManager()->ReleaseWrappedResource(block.mem);
+
+      blockList.erase(i);
+    }
+
+    return;
+  }
+
+  RDCERR("Freeing allocation from unknown %s memory block", ToStr(alloc.scope).c_str());
+}
+
+ReplayMemoryStats WrappedVulkan::GetReplayMemoryStats()
+{
+  ReplayMemoryStats ret;
+
+  for(const rdcarray<MemoryBlock> &blockList : m_MemoryBlocks)
+  {
+    for(const MemoryBlock &block : blockList)
+    {
+      ret.blockCount++;
+      ret.allocationCount += (uint32_t)block.ranges.GetAllocationCount();
+      ret.blockBytes += block.ranges.GetSize();
+      ret.allocatedBytes += block.ranges.GetUsedBytes();
+      if(block.spilled)
+        ret.spilledBytes += block.ranges.GetSize();
+    }
+  }
+
+  const VkPhysicalDeviceMemoryProperties &memProps = m_PhysicalDeviceData.memProps;
+
+  for(uint32_t h = 0; h < memProps.memoryHeapCount; h++)
+  {
+    if((memProps.memoryHeaps[h].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) == 0)
+      continue;
+
+    VkDeviceSize budget = 0, usage = 0;
+    if(GetHeapBudget(h, budget, usage))
+    {
+      ret.deviceLocalBudget += budget;
+      ret.deviceLocalUsage += usage;
+    }
+  }
+
+  return ret;
+}
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#undef None
+#undef Always
+
+#include "catch/catch.hpp"
+
+TEST_CASE("Test memory block sub-allocation", "[vulkan]")
+{
+  MemoryBlockAllocator block;
+  VkDeviceSize offs = 0;
+
+  SECTION("Buffers and images don't share a page")
+  {
+    block.Init(1024, 64);
+
+    REQUIRE(block.Allocate(100, 16, true, offs));
+    CHECK(offs == 0);
+
+    // the buffer's last page is [64, 128) so the image has to start at 128
+    REQUIRE(block.Allocate(100, 16, false, offs));
+    CHECK(offs == 128);
+
+    // another buffer can fill the gap, as long as it doesn't reach the image's page
+    REQUIRE(block.Allocate(28, 4, true, offs));
+    CHECK(offs == 100);
+
+    CHECK(block.Free(100));
+
+    // an image can't go in the same gap
+    REQUIRE(block.Allocate(20, 4, false, offs));
+    CHECK(offs == 228);
+
+    CHECK(block.GetAllocationCount() == 3);
+    CHECK(block.GetUsedBytes() == 220);
+  };
+
+  SECTION("Freed ranges are merged and reused")
+  {
+    block.Init(1024, 1);
+
+    VkDeviceSize a = 0, b = 0, c = 0, d = 0;
+    REQUIRE(block.Allocate(256, 256, true, a));
+    REQUIRE(block.Allocate(256, 256, true, b));
+    REQUIRE(block.Allocate(256, 256, true, c));
+    REQUIRE(block.Allocate(256, 256, true, d));
+    CHECK(a == 0);
+    CHECK(b == 256);
+    CHECK(c == 512);
+    CHECK(d == 768);
+
+    CHECK(!block.Allocate(1, 1, true, offs));
+
+    CHECK(block.Free(a));
+    CHECK(block.Free(c));
+    CHECK(!block.Free(c));
+    CHECK(!block.Free(100));
+
+    // the free space either side of b is not contiguous
+    CHECK(!block.Allocate(512, 1, true, offs));
+
+    CHECK(block.Free(b));
+
+    // but now it is
+    REQUIRE(block.Allocate(768, 1, true, a));
+    CHECK(a == 0);
+
+    CHECK(block.Free(a));
+    CHECK(block.Free(d));
+    CHECK(block.IsEmpty());
+    CHECK(block.GetUsedBytes() == 0);
+
+    REQUIRE(block.Allocate(1024, 1, false, offs));
+    CHECK(offs == 0);
+  };
+
+  SECTION("Random allocations never overlap")
+  {
+    block.Init(1 << 20, 1024);
+
+    rdcarray<rdcpair<VkDeviceSize, VkDeviceSize>> live;
+    uint32_t seed = 12345;
+    auto rand = [&seed]() {
+      seed = seed * 1103515245 + 12345;
+      return (seed >> 8) & 0xffff;
+    };
+
+    for(int i = 0; i < 5000; i++)
+    {
+      if(!live.empty() && (rand() % 3) == 0)
+      {
+        size_t idx = rand() % live.size();
+        CHECK(block.Free(live[idx].first));
+        live.erase(idx);
+        continue;
+      }
+
+      VkDeviceSize size = 1 + rand() % 20000;
+      VkDeviceSize align = VkDeviceSize(1) << (rand() % 9);
+      bool buffer = (rand() % 2) == 0;
+
+      if(!block.Allocate(size, align, buffer, offs))
+        continue;
+
+      CHECK((offs % align) == 0);
+      CHECK(offs + size <= block.GetSize());
+
+      for(const rdcpair<VkDeviceSize, VkDeviceSize> &l : live)
+      {
+        bool overlap = offs < l.first + l.second && l.first < offs + size;
+        CHECK(!overlap);
+      }
+
+      live.push_back({offs, size});
+    }
+
+    VkDeviceSize used = 0;
+    for(const rdcpair<VkDeviceSize, VkDeviceSize> &l : live)
+      used += l.second;
+
+    CHECK(block.GetAllocationCount() == live.size());
+    CHECK(block.GetUsedBytes() == used);
+
+    for(const rdcpair<VkDeviceSize, VkDeviceSize> &l : live)
+      CHECK(block.Free(l.first));
+
+    CHECK(block.IsEmpty());
+    REQUIRE(block.Allocate(1 << 20, 1, true, offs));
+  };
+}
+
+TEST_CASE("Test memory type selection when spilling out of a heap", "[vulkan]")
+{
+  const VkMemoryPropertyFlags local = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  const VkMemoryPropertyFlags hostVisible =
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+  VkPhysicalDeviceMemoryProperties memProps = {};
+
+  SECTION("Discrete GPU")
+  {
+    // heap 0 is VRAM, heap 1 is system memory, heap 2 is a small BAR window
+    memProps.memoryHeapCount = 3;
+    memProps.memoryHeaps[0] = {8ULL << 30, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT};
+    memProps.memoryHeaps[1] = {16ULL << 30, 0};
+    memProps.memoryHeaps[2] = {256ULL << 20, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT};
+
+    memProps.memoryTypeCount = 5;
+    memProps.memoryTypes[0] = {local, 0};
+    memProps.memoryTypes[1] = {local, 0};
+    memProps.memoryTypes[2] = {hostVisible, 1};
+    memProps.memoryTypes[3] = {hostVisible | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, 1};
+    memProps.memoryTypes[4] = {local | hostVisible, 2};
+
+    // the first host-visible type outside of VRAM is picked
+    CHECK(ChooseSpillMemoryType(memProps, 0x1f, 0) == 2);
+    CHECK(ChooseSpillMemoryType(memProps, 0x1f, 1) == 2);
+
+    // the resource's compatible types are respected
+    CHECK(ChooseSpillMemoryType(memProps, 0x19, 0) == 3);
+    CHECK(ChooseSpillMemoryType(memProps, 0x11, 0) == 4);
+
+    // types in the same heap are never chosen, since they'd be just as full
+    CHECK(ChooseSpillMemoryType(memProps, 0x03, 0) == 0);
+
+    // spilling out of system memory can go to the BAR heap
+    CHECK(ChooseSpillMemoryType(memProps, 0x1f, 2) == 4);
+  };
+
+  SECTION("UMA with a single heap")
+  {
+    memProps.memoryHeapCount = 1;
+    memProps.memoryHeaps[0] = {8ULL << 30, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT};
+
+    memProps.memoryTypeCount = 2;
+    memProps.memoryTypes[0] = {local, 0};
+    memProps.memoryTypes[1] = {local | hostVisible, 0};
+
+    // there's nowhere to spill to, so the original type is kept
+    CHECK(ChooseSpillMemoryType(memProps, 0x3, 0) == 0);
+    CHECK(ChooseSpillMemoryType(memProps, 0x3, 1) == 1);
+  };
+
+  SECTION("No host-visible type in another heap")
+  {
+    memProps.memoryHeapCount = 2;
+    memProps.memoryHeaps[0] = {8ULL << 30, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT};
+    memProps.memoryHeaps[1] = {8ULL << 30, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT};
+
+    memProps.memoryTypeCount = 3;
+    memProps.memoryTypes[0] = {local, 0};
+    memProps.memoryTypes[1] = {local, 1};
+    memProps.memoryTypes[2] = {hostVisible, 0};
+
+    CHECK(ChooseSpillMemoryType(memProps, 0x7, 0) == 0);
+  };
 }
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
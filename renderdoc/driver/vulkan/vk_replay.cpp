@@ -302,6 +302,11 @@ rdcarray<DebugMessage> VulkanReplay::GetDebugMessages()
   return m_pDriver->GetDebugMessages();
 }
 
+ReplayMemoryStats VulkanReplay::GetReplayMemoryStats()
+{
+  return m_pDriver->GetReplayMemoryStats();
+}
+
 ResourceDescription &VulkanReplay::GetResourceDesc(ResourceId id)
 {
   auto it = m_ResourceIdx.find(id);
@@ -278,6 +278,7 @@ public:
 
   DriverInformation GetDriverInfo() { return m_DriverInfo; }
   rdcarray<GPUDevice> GetAvailableGPUs();
+  ReplayMemoryStats GetReplayMemoryStats();
   APIProperties GetAPIProperties();
 
   ResourceDescription &GetResourceDesc(ResourceId id);
@@ -23,10 +23,16 @@
  ******************************************************************************/
 
 #include "vk_shader_cache.h"
+#include <algorithm>
 #include "common/shader_cache.h"
+#include "core/settings.h"
 #include "data/glsl_shaders.h"
 #include "strings/string_utils.h"
 
+RDOC_CONFIG(bool, Vulkan_CapturePipelineCache, true,
+            "Persist a pipeline cache for each capture and driver, so that opening the same "
+            "capture again does not need to recompile its pipelines.");
+
 enum class FeatureCheck
 {
   NoCheck = 0x0,
@@ -215,6 +221,152 @@ struct VkPipeCacheHeader
   byte uuid[VK_UUID_SIZE];
 };
 
+static bool IsPipeCacheCompatible(const bytebuf &blob, const VkPhysicalDeviceProperties &props)
+{
+  if(blob.size() < sizeof(VkPipeCacheHeader))
+    return false;
+
+  const VkPipeCacheHeader *header = (const VkPipeCacheHeader *)blob.data();
+
+  // check explicitly for incompatibility
+  if(header->length != sizeof(VkPipeCacheHeader))
+  {
+    RDCLOG("Pipeline cache header length %u is unexpected, not using cache", header->length);
+    return false;
+  }
+  else if(header->version != VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+  {
+    RDCLOG("Pipeline cache header version %u is unexpected, not using cache", header->version);
+    return false;
+  }
+  else if(header->vendorID != props.vendorID)
+  {
+    RDCLOG("Pipeline cache header vendorID %u doesn't match %u", header->vendorID, props.vendorID);
+    return false;
+  }
+  else if(header->deviceID != props.deviceID)
+  {
+    RDCLOG("Pipeline cache header deviceID %u doesn't match %u", header->deviceID, props.deviceID);
+    return false;
+  }
+  else if(memcmp(header->uuid, props.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+  {
+    RDCLOG("Pipeline cache UUID doesn't match");
+    return false;
+  }
+
+  return true;
+}
+
+static const uint32_t CapturePipeCacheMagic = MAKE_FOURCC('R', 'D', 'P', 'C');
+static const uint32_t CapturePipeCacheVersion = 1;
+
+// how many per-capture pipeline caches to keep around before evicting the least recently used
+static const size_t CapturePipeCacheMaxCount = 32;
+
+static rdcstr GetCapturePipeCacheDir()
+{
+  return FileIO::GetAppFolderFilename("vkpipecaches");
+}
+
+static rdcstr GetCapturePipeCacheFilename(uint64_t captureKey,
+                                          const VkPhysicalDeviceProperties &props)
+{
+  // the driver version is included since driver updates often don't change the pipeline cache UUID
+  // even when the cached data is stale. Other incompatibilities are caught by the header check
+  return GetCapturePipeCacheDir() + StringFormat::Fmt("/%016llx_%08x_%08x_%08x.cache", captureKey,
+                                                      props.vendorID, props.deviceID,
+                                                      props.driverVersion);
+}
+
+static bytebuf LoadCapturePipeCache(const rdcstr &filename)
+{
+  bytebuf ret;
+
+  if(!FileIO::exists(filename))
+    return ret;
+
+  StreamReader fileReader(FileIO::fopen(filename, FileIO::ReadBinary));
+
+  uint32_t magic = 0, version = 0;
+  uint64_t size = 0;
+  fileReader.Read(magic);
+  fileReader.Read(version);
+  fileReader.Read(size);
+
+  if(magic != CapturePipeCacheMagic || version != CapturePipeCacheVersion ||
+     fileReader.IsErrored() || size > fileReader.GetSize() * 1024)
+    return ret;
+
+  StreamReader compressedReader(new ZSTDDecompressor(&fileReader, Ownership::Nothing), size,
+                                Ownership::Stream);
+
+  ret.resize((size_t)size);
+  compressedReader.Read(ret.data(), size);
+
+  if(compressedReader.IsErrored() || fileReader.IsErrored())
+    ret.clear();
+
+  return ret;
+}
+
+static void SaveCapturePipeCache(const rdcstr &filename, const bytebuf &blob)
+{
+  FileIO::CreateParentDirectory(filename);
+
+  // write to a temporary file first and move it into place, so a reader never sees a partial file
+  rdcstr tmpFilename = filename + ".tmp";
+
+  {
+    FILE *f = FileIO::fopen(tmpFilename, FileIO::WriteBinary);
+
+    if(!f)
+    {
+      RDCWARN("Couldn't open %s to write pipeline cache", tmpFilename.c_str());
+      return;
+    }
+
+    StreamWriter fileWriter(f, Ownership::Stream);
+
+    fileWriter.Write(CapturePipeCacheMagic);
+    fileWriter.Write(CapturePipeCacheVersion);
+    fileWriter.Write((uint64_t)blob.size());
+
+    StreamWriter compressedWriter(new ZSTDCompressor(&fileWriter, Ownership::Nothing),
+                                  Ownership::Stream);
+
+    compressedWriter.Write(blob.data(), blob.size());
+    compressedWriter.Finish();
+
+    if(compressedWriter.IsErrored() || fileWriter.IsErrored())
+    {
+      RDCWARN("Error writing pipeline cache to %s", tmpFilename.c_str());
+      return;
+    }
+  }
+
+  FileIO::Move(tmpFilename, filename, true);
+
+  // evict the least recently written caches so the directory doesn't grow without bound
+  rdcarray<PathEntry> entries;
+  FileIO::GetFilesInDirectory(GetCapturePipeCacheDir(), entries);
+
+  entries.removeIf([](const PathEntry &e) {
+    if(!(e.flags & PathProperty::Directory))
+      return !e.filename.endsWith(".cache");
+    return true;
+  });
+
+  if(entries.size() > CapturePipeCacheMaxCount)
+  {
+    std::sort(entries.begin(), entries.end(),
+              [](const PathEntry &a, const PathEntry &b) { return a.lastmod > b.lastmod; });
+
+    for(size_t i = CapturePipeCacheMaxCount; i < entries.size(); i++)
+      FileIO::Delete(GetCapturePipeCacheDir() + "/" + entries[i].filename);
+  }
+}
+
 VulkanShaderCache::VulkanShaderCache(WrappedVulkan *driver)
 {
   // Load shader cache, if present
@@ -339,46 +491,8 @@ VulkanShaderCache::VulkanShaderCache(WrappedVulkan *driver)
 
     GetPipeCacheBlob();
 
-    if(!m_PipeCacheBlob.empty())
-    {
-      if(m_PipeCacheBlob.size() < sizeof(VkPipeCacheHeader))
-      {
-        m_PipeCacheBlob.clear();
-      }
-      else
-      {
-        VkPipeCacheHeader *header = (VkPipeCacheHeader *)m_PipeCacheBlob.data();
-
-        // check explicitly for incompatibility
-        if(header->length != sizeof(VkPipeCacheHeader))
-        {
-          m_PipeCacheBlob.clear();
-          RDCLOG("Pipeline cache header length %u is unexpected, not using cache", header->length);
-        }
-        else if(header->version != VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
-        {
-          m_PipeCacheBlob.clear();
-          RDCLOG("Pipeline cache header version %u is unexpected, not using cache", header->version);
-        }
-        else if(header->vendorID != m_pDriver->GetDeviceProps().vendorID)
-        {
-          m_PipeCacheBlob.clear();
-          RDCLOG("Pipeline cache header vendorID %u doesn't match %u", header->vendorID,
-                 m_pDriver->GetDeviceProps().vendorID);
-        }
-        else if(header->deviceID != m_pDriver->GetDeviceProps().deviceID)
-        {
-          m_PipeCacheBlob.clear();
-          RDCLOG("Pipeline cache header deviceID %u doesn't match %u", header->deviceID,
-                 m_pDriver->GetDeviceProps().deviceID);
-        }
-        else if(memcmp(header->uuid, m_pDriver->GetDeviceProps().pipelineCacheUUID, VK_UUID_SIZE) != 0)
-        {
-          m_PipeCacheBlob.clear();
-          RDCLOG("Pipeline cache UUID doesn't match");
-        }
-      }
-    }
+    if(!IsPipeCacheCompatible(m_PipeCacheBlob, m_pDriver->GetDeviceProps()))
+      m_PipeCacheBlob.clear();
 
     if(!m_PipeCacheBlob.empty())
     {
@@ -408,6 +522,43 @@ VulkanShaderCache::VulkanShaderCache(WrappedVulkan *driver)
     }
   }
 
+  // on replay, captured pipelines get their own cache persisted per-capture and per-driver, so that
+  // opening the same capture again doesn't need to recompile everything.
+  if(IsReplayMode(m_pDriver->GetState()) && m_pDriver->m_CaptureCacheKey != 0 &&
+     Vulkan_CapturePipelineCache())
+  {
+    m_CapturePipeCacheFilename =
+        GetCapturePipeCacheFilename(m_pDriver->m_CaptureCacheKey, m_pDriver->GetDeviceProps());
+
+    m_CapturePipeCacheBlob = LoadCapturePipeCache(m_CapturePipeCacheFilename);
+
+    if(!m_CapturePipeCacheBlob.empty() &&
+       !IsPipeCacheCompatible(m_CapturePipeCacheBlob, m_pDriver->GetDeviceProps()))
+      m_CapturePipeCacheBlob.clear();
+
+    if(!m_CapturePipeCacheBlob.empty())
+      RDCLOG("Loaded %zu byte pipeline cache for capture", m_CapturePipeCacheBlob.size());
+
+    VkPipelineCacheCreateInfo createInfo = {VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+    createInfo.initialDataSize = m_CapturePipeCacheBlob.size();
+    createInfo.pInitialData = m_CapturePipeCacheBlob.data();
+
+    VkResult vkr = ObjDisp(m_Device)->CreatePipelineCache(Unwrap(m_Device), &createInfo, NULL,
+                                                          &m_CapturePipelineCache);
+    driver->CheckVkResult(vkr);
+
+    if(vkr == VK_SUCCESS)
+    {
+      ResourceId id =
+          m_pDriver->GetResourceManager()->WrapResource(Unwrap(m_Device), m_CapturePipelineCache);
+      m_pDriver->GetResourceManager()->AddLiveResource(id, m_CapturePipelineCache);
+    }
+    else
+    {
+      m_CapturePipelineCache = VK_NULL_HANDLE;
+    }
+  }
+
   SetCaching(false);
 }
 
@@ -425,6 +576,30 @@ VulkanShaderCache::~VulkanShaderCache()
     m_pDriver->vkDestroyPipelineCache(m_Device, m_PipelineCache, NULL);
   }
 
+  if(m_CapturePipelineCache != VK_NULL_HANDLE)
+  {
+    bytebuf blob;
+    size_t size = 0;
+    ObjDisp(m_Device)->GetPipelineCacheData(Unwrap(m_Device), Unwrap(m_CapturePipelineCache),
+                                            &size, NULL);
+    blob.resize(size);
+    ObjDisp(m_Device)->GetPipelineCacheData(Unwrap(m_Device), Unwrap(m_CapturePipelineCache),
+                                            &size, blob.data());
+    blob.resize(size);
+    m_pDriver->vkDestroyPipelineCache(m_Device, m_CapturePipelineCache, NULL);
+
+    // only write the cache back if it changed, and do it in the background so that the rest of
+    // shutdown isn't waiting on disk I/O. The driver joins the thread before it's destroyed, and
+    // any earlier write is finished first so its handle isn't leaked.
+    if(!blob.empty() && blob != m_CapturePipeCacheBlob)
+    {
+      rdcstr filename = m_CapturePipeCacheFilename;
+      m_pDriver->JoinPipeCacheWriteThread();
+      m_pDriver->m_PipeCacheWriteThread = Threading::CreateThread(
+          [filename, blob]() { SaveCapturePipeCache(filename, blob); });
+    }
+  }
+
   if(m_ShaderCacheDirty)
   {
     SaveShaderCache("vkshaders.cache", m_ShaderCacheMagic, m_ShaderCacheVersion, m_ShaderCache,
@@ -109,6 +109,7 @@ public:
     return m_BuiltinShaderModules[(size_t)builtin][(size_t)baseType][(size_t)texType];
   }
   VkPipelineCache GetPipeCache() { return m_PipelineCache; }
+  VkPipelineCache GetCapturePipeCache() { return m_CapturePipelineCache; }
   void MakeGraphicsPipelineInfo(VkGraphicsPipelineCreateInfo &pipeCreateInfo, ResourceId pipeline);
   void MakeComputePipelineInfo(VkComputePipelineCreateInfo &pipeCreateInfo, ResourceId pipeline);
 
@@ -131,6 +132,11 @@ private:
   bytebuf m_PipeCacheBlob;
   VkPipelineCache m_PipelineCache = VK_NULL_HANDLE;
 
+  // cache for the captured pipelines themselves, only used on replay
+  rdcstr m_CapturePipeCacheFilename;
+  bytebuf m_CapturePipeCacheBlob;
+  VkPipelineCache m_CapturePipelineCache = VK_NULL_HANDLE;
+
   bool m_Buffer2MSSupported = false;
 
   bool m_ShaderCacheDirty = false, m_CacheShaders = false;
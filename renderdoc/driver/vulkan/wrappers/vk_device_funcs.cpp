@@ -939,6 +939,10 @@ void WrappedVulkan::Shutdown()
 
   m_IndirectBuffer.Destroy();
 
+  DestroyInitContentsStaging();
+
+  m_InitContentsCache.Close();
+
   // destroy debug manager and any objects it created
   SAFE_DELETE(m_DebugManager);
   SAFE_DELETE(m_ShaderCache);
@@ -1748,6 +1752,16 @@ bool WrappedVulkan::Serialise_vkCreateDevice(SerialiserType &ser, VkPhysicalDevi
       RDCLOG("Enabling VK_KHR_shader_non_semantic_info");
     }
 
+    // enable VK_EXT_memory_budget if it's available, so our own allocations can stay out of the way
+    // of the capture's when device memory is tight
+    if(supportedExtensions.find(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) != supportedExtensions.end())
+    {
+      if(!Extensions.contains(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+        Extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+      m_MemoryBudget = true;
+      RDCLOG("Enabling VK_EXT_memory_budget");
+    }
+
     bool pipeExec = false;
 
     // enable VK_KHR_pipeline_executable_properties if it's available, to fetch disassembly and
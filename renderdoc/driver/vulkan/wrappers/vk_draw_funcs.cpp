@@ -862,7 +862,7 @@ bool WrappedVulkan::Serialise_vkCmdDrawIndexedIndirect(SerialiserType &ser,
             {
               uint32_t drawidx = 0;
 
-              ActionDescription *action = m_Actions[curEID];
+              ActionDescription *action = m_ActionIndex.GetAction(curEID);
 
               if(m_FirstEventID <= 1)
               {
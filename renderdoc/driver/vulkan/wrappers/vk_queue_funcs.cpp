@@ -28,6 +28,8 @@
 #include "core/settings.h"
 
 RDOC_EXTERN_CONFIG(bool, Vulkan_Debug_VerboseCommandRecording);
+RDOC_EXTERN_CONFIG(uint32_t, Capture_MappedDiffMergeGap);
+RDOC_EXTERN_CONFIG(uint32_t, Capture_MappedDiffMaxRanges);
 
 template <typename SerialiserType>
 bool WrappedVulkan::Serialise_vkGetDeviceQueue(SerialiserType &ser, VkDevice device,
@@ -1065,8 +1067,25 @@ void WrappedVulkan::CaptureQueueSubmit(VkQueue queue,
           continue;
         }
 
-        size_t diffStart = 0, diffEnd = 0;
-        bool found = true;
+        byte *watchBase = state.mappedPtr + state.mapOffset;
+
+        // if CPU writes to the map are being tracked we only need to compare the pages that were
+        // written. This must be fetched before we read the memory below, so that anything written
+        // from here on is caught next time. When there's no previous data to compare against we
+        // start tracking now, before the whole map is serialised.
+        rdcarray<rdcpair<size_t, size_t>> writtenRanges;
+        bool writesTracked = false;
+        if(state.refData)
+          writesTracked = WriteWatch::FetchWritten(watchBase, writtenRanges);
+        else
+          WriteWatch::Watch(watchBase, (size_t)state.mapSize);
+
+        if(writesTracked && writtenRanges.empty())
+        {
+          RDCDEBUG("Persistent map flush not needed for %s, nothing written",
+                   ToStr(record->GetResourceID()).c_str());
+          continue;
+        }
 
         // this causes vkFlushMappedMemoryRanges call to allocate and copy to refData
         // from serialised buffer. We want to copy *precisely* the serialised data,
@@ -1169,31 +1188,53 @@ void WrappedVulkan::CaptureQueueSubmit(VkQueue queue,
           state.cpuReadPtr = state.mappedPtr;
         }
 
-        // if we have a previous set of data, compare.
-        // otherwise just serialise it all
+        // if we have a previous set of data, compare - either the pages that were written or the
+        // whole map. Otherwise just serialise it all
+        rdcarray<rdcpair<size_t, size_t>> diffRanges;
         if(state.refData)
-          found = FindDiffRange(((byte *)state.cpuReadPtr) + state.mapOffset, state.refData,
-                                (size_t)state.mapSize, diffStart, diffEnd);
-        else
-          diffEnd = (size_t)state.mapSize;
+        {
+          if(!writesTracked)
+            writtenRanges = {{0, (size_t)state.mapSize}};
+
+          // each changed range is serialised as a separate flush, so nearby changes are merged to
+          // avoid paying that overhead for every few bytes
+          const size_t mergeGap = Capture_MappedDiffMergeGap();
 
-        // sanitise diff start/end. Since the mapped pointer might be written on another thread
-        // (or even the GPU) this could cause a difference to appear and disappear transiently. In
-        // this case FindDiffRange could find the difference when locating the start but not find
-        // it when locating the end. In this case we don't need to write the difference (the
-        // application is responsible for ensuring it's not writing to memory the GPU might need)
-        if(diffEnd <= diffStart)
-          found = false;
+          for(const rdcpair<size_t, size_t> &written : writtenRanges)
+          {
+            size_t first = diffRanges.size();
+            FindDiffRanges(state.cpuReadPtr + state.mapOffset + written.first,
+                           state.refData + written.first, written.second - written.first,
+                           mergeGap, diffRanges);
+
+            for(size_t i = first; i < diffRanges.size(); i++)
+            {
+              diffRanges[i].first += written.first;
+              diffRanges[i].second += written.first;
+            }
+          }
 
-        if(found)
+          // scattered writes could otherwise produce a flush chunk for every few bytes
+          CapDiffRanges(diffRanges, Capture_MappedDiffMaxRanges());
+        }
+        else
+        {
+          diffRanges = {{0, (size_t)state.mapSize}};
+        }
+
+        if(!diffRanges.empty())
         {
           // MULTIDEVICE should find the device for this queue.
           // MULTIDEVICE only want to flush maps associated with this queue
           VkDevice dev = GetDev();
 
+          RDCLOG("Persistent map flush forced for %s (%zu ranges, %llu -> %llu)",
+                 ToStr(record->GetResourceID()).c_str(), diffRanges.size(),
+                 (uint64_t)diffRanges.front().first, (uint64_t)diffRanges.back().second);
+
+          for(const rdcpair<size_t, size_t> &diff : diffRanges)
           {
-            RDCLOG("Persistent map flush forced for %s (%llu -> %llu)",
-                   ToStr(record->GetResourceID()).c_str(), (uint64_t)diffStart, (uint64_t)diffEnd);
+            size_t diffStart = diff.first, diffEnd = diff.second;
             VkMappedMemoryRange range = {
                 VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
                 NULL,
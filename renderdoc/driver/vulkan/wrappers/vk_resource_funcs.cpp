@@ -778,6 +778,9 @@ void WrappedVulkan::vkFreeMemory(VkDevice device, VkDeviceMemory memory,
     if(memMapState)
     {
       // there is an implicit unmap on free, so make sure to tidy up
+      if(memMapState->mappedPtr)
+        WriteWatch::Unwatch(memMapState->mappedPtr + memMapState->mapOffset);
+
       if(memMapState->refData)
       {
         FreeAlignedBuffer(memMapState->refData);
@@ -1075,6 +1078,8 @@ void WrappedVulkan::vkUnmapMemory(VkDevice device, VkDeviceMemory mem)
         }
       }
 
+      WriteWatch::Unwatch(state.mappedPtr + state.mapOffset);
+
       state.cpuReadPtr = state.mappedPtr = NULL;
     }
 
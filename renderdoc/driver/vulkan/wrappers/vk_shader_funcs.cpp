@@ -24,6 +24,7 @@
 
 #include "../vk_core.h"
 #include "../vk_replay.h"
+#include "../vk_shader_cache.h"
 #include "driver/shaders/spirv/spirv_reflect.h"
 
 template <>
@@ -45,10 +46,7 @@ VkComputePipelineCreateInfo *WrappedVulkan::UnwrapInfos(CaptureState state,
   return unwrapped;
 }
 
-template <>
-VkGraphicsPipelineCreateInfo *WrappedVulkan::UnwrapInfos(CaptureState state,
-                                                         const VkGraphicsPipelineCreateInfo *info,
-                                                         uint32_t count)
+static size_t GetUnwrappedSize(const VkGraphicsPipelineCreateInfo *info, uint32_t count)
 {
   // conservatively request memory for 5 stages on each pipeline
   // (worst case - can't have compute stage). Avoids needing to count
@@ -59,8 +57,13 @@ VkGraphicsPipelineCreateInfo *WrappedVulkan::UnwrapInfos(CaptureState state,
     memSize += GetNextPatchSize(info[i].pNext);
   }
 
-  byte *tempMem = GetTempMemory(memSize);
+  return memSize;
+}
 
+static VkGraphicsPipelineCreateInfo *UnwrapInfosInto(CaptureState state,
+                                                     const VkGraphicsPipelineCreateInfo *info,
+                                                     uint32_t count, byte *tempMem)
+{
   // keep pipelines first in the memory, then the stages
   VkGraphicsPipelineCreateInfo *unwrappedInfos = (VkGraphicsPipelineCreateInfo *)tempMem;
   tempMem = (byte *)(unwrappedInfos + count);
@@ -89,6 +92,16 @@ VkGraphicsPipelineCreateInfo *WrappedVulkan::UnwrapInfos(CaptureState state,
   return unwrappedInfos;
 }
 
+template <>
+VkGraphicsPipelineCreateInfo *WrappedVulkan::UnwrapInfos(CaptureState state,
+                                                         const VkGraphicsPipelineCreateInfo *info,
+                                                         uint32_t count)
+{
+  byte *tempMem = GetTempMemory(GetUnwrappedSize(info, count));
+
+  return UnwrapInfosInto(state, info, count, tempMem);
+}
+
 template <>
 VkPipelineLayoutCreateInfo WrappedVulkan::UnwrapInfo(const VkPipelineLayoutCreateInfo *info)
 {
@@ -420,6 +433,124 @@ VkResult WrappedVulkan::vkCreatePipelineCache(VkDevice device,
   return ret;
 }
 
+bool WrappedVulkan::ShouldDeferPipelineCompile(VkPipelineCreateFlags flags, const void *pNext)
+{
+  // only defer while loading the capture, any other time the pipeline is needed immediately
+  if(!IsLoading(m_State) || m_PipelineCompileQueue == NULL)
+    return false;
+
+  // pipelines that derive from or link other pipelines need their real handles, so they can't be
+  // deferred. The caller must flush any outstanding compiles before creating these.
+  if(flags & VK_PIPELINE_CREATE_DERIVATIVE_BIT)
+    return false;
+
+  for(const VkBaseInStructure *next = (const VkBaseInStructure *)pNext; next; next = next->pNext)
+  {
+    if(next->sType == VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR)
+      return false;
+  }
+
+  return true;
+}
+
+void WrappedVulkan::DeferPipelineCompile(DeferredPipelineCompile *compile)
+{
+  // unwrap everything now while we're serial, into memory owned by the compile so it stays valid
+  // until the job runs.
+  if(compile->bindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS)
+  {
+    compile->unwrapMem.resize(GetUnwrappedSize(&compile->graphicsInfo, 1));
+    compile->unwrappedGraphics =
+        UnwrapInfosInto(m_State, &compile->graphicsInfo, 1, compile->unwrapMem.data());
+  }
+  else
+  {
+    compile->unwrappedCompute = *UnwrapInfos(m_State, &compile->computeInfo, 1);
+  }
+
+  m_DeferredPipelineCompiles.push_back(compile);
+
+  m_PipelineCompileQueue->Push([compile]() {
+    VkDevice dev = Unwrap(compile->device);
+
+    if(compile->bindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS)
+    {
+      compile->ret = ObjDisp(compile->device)
+                         ->CreateGraphicsPipelines(dev, compile->pipelineCache, 1,
+                                                   compile->unwrappedGraphics, NULL,
+                                                   UnwrapPtr(compile->pipe));
+
+      // the subpass-0 pipeline only differs in its renderpass, so it can share the rest
+      if(compile->ret == VK_SUCCESS && compile->subpass0pipe != VK_NULL_HANDLE)
+      {
+        VkGraphicsPipelineCreateInfo subpass0Info = *compile->unwrappedGraphics;
+        subpass0Info.renderPass = compile->subpass0RenderPass;
+        subpass0Info.subpass = 0;
+
+        compile->ret = ObjDisp(compile->device)
+                           ->CreateGraphicsPipelines(dev, compile->pipelineCache, 1, &subpass0Info,
+                                                     NULL, UnwrapPtr(compile->subpass0pipe));
+      }
+    }
+    else
+    {
+      compile->ret = ObjDisp(compile->device)
+                         ->CreateComputePipelines(dev, compile->pipelineCache, 1,
+                                                  &compile->unwrappedCompute, NULL,
+                                                  UnwrapPtr(compile->pipe));
+    }
+  });
+}
+
+bool WrappedVulkan::FlushDeferredPipelineCompiles()
+{
+  if(m_DeferredPipelineCompiles.empty())
+    return true;
+
+  m_PipelineCompileQueue->Wait();
+
+  bool success = true;
+
+  for(DeferredPipelineCompile *compile : m_DeferredPipelineCompiles)
+  {
+    // register whichever real handles we got, even on failure, so they're cleaned up properly
+    for(VkPipeline pipe : {compile->pipe, compile->subpass0pipe})
+    {
+      if(pipe == VK_NULL_HANDLE || Unwrap(pipe) == VK_NULL_HANDLE)
+        continue;
+
+      // if the driver de-duplicated this pipeline we can't replace the resource after the fact as
+      // we do when creating inline. Both wrappers refer to the same driver object, which is still
+      // destroyed once per create as required.
+      if(!GetResourceManager()->AddDeferredWrapper(pipe))
+        RDCWARN("Driver returned duplicate handle for deferred pipeline %s",
+                ToStr(GetResourceManager()->GetOriginalID(GetResID(pipe))).c_str());
+    }
+
+    if(compile->ret != VK_SUCCESS && success)
+    {
+      const char *type =
+          compile->bindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS ? "graphics" : "compute";
+      SET_ERROR_RESULT(m_FailedReplayResult, ResultCode::APIReplayFailed,
+                       "Failed creating %s pipeline %s, VkResult: %s", type,
+                       ToStr(GetResourceManager()->GetOriginalID(GetResID(compile->pipe))).c_str(),
+                       ToStr(compile->ret).c_str());
+      success = false;
+    }
+
+    if(compile->bindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS)
+      Deserialise(compile->graphicsInfo);
+    else
+      Deserialise(compile->computeInfo);
+
+    delete compile;
+  }
+
+  m_DeferredPipelineCompiles.clear();
+
+  return success;
+}
+
 template <typename SerialiserType>
 bool WrappedVulkan::Serialise_vkCreateGraphicsPipelines(
     SerialiserType &ser, VkDevice device, VkPipelineCache pipelineCache, uint32_t count,
@@ -442,8 +573,8 @@ bool WrappedVulkan::Serialise_vkCreateGraphicsPipelines(
     VkRenderPass origRP = CreateInfo.renderPass;
     VkPipelineCache origCache = pipelineCache;
 
-    // don't use pipeline caches on replay
-    pipelineCache = VK_NULL_HANDLE;
+    // don't use the application's pipeline caches on replay, use our own persistent one
+    pipelineCache = GetShaderCache()->GetCapturePipeCache();
 
     // if we have pipeline executable properties, capture the data
     if(GetExtensions(NULL).ext_KHR_pipeline_executable_properties)
@@ -457,9 +588,20 @@ bool WrappedVulkan::Serialise_vkCreateGraphicsPipelines(
     // valid
     CreateInfo.flags &= ~VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT;
 
-    VkGraphicsPipelineCreateInfo *unwrapped = UnwrapInfos(m_State, &CreateInfo, 1);
-    VkResult ret = ObjDisp(device)->CreateGraphicsPipelines(Unwrap(device), Unwrap(pipelineCache),
-                                                            1, unwrapped, NULL, &pipe);
+    DeferredPipelineCompile *compile = NULL;
+    VkResult ret = VK_SUCCESS;
+
+    bool defer = ShouldDeferPipelineCompile(CreateInfo.flags, CreateInfo.pNext);
+
+    if(!defer)
+    {
+      if(!FlushDeferredPipelineCompiles())
+        return false;
+
+      VkGraphicsPipelineCreateInfo *unwrapped = UnwrapInfos(m_State, &CreateInfo, 1);
+      ret = ObjDisp(device)->CreateGraphicsPipelines(Unwrap(device), Unwrap(pipelineCache), 1,
+                                                     unwrapped, NULL, &pipe);
+    }
 
     AddResource(Pipeline, ResourceType::PipelineState, "Graphics Pipeline");
 
@@ -473,7 +615,20 @@ bool WrappedVulkan::Serialise_vkCreateGraphicsPipelines(
     {
       ResourceId live;
 
-      if(GetResourceManager()->HasWrapper(ToTypedHandle(pipe)))
+      // only allocated once nothing else can fail, and queued at the end of this function
+      if(defer)
+      {
+        compile = new DeferredPipelineCompile;
+        compile->device = device;
+        compile->bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        compile->pipelineCache = Unwrap(pipelineCache);
+        compile->graphicsInfo = CreateInfo;
+
+        GetResourceManager()->WrapDeferredResource(pipe);
+        compile->pipe = pipe;
+      }
+
+      if(!compile && GetResourceManager()->HasWrapper(ToTypedHandle(pipe)))
       {
         live = GetResourceManager()->GetNonDispWrapper(pipe)->id;
 
@@ -486,7 +641,10 @@ bool WrappedVulkan::Serialise_vkCreateGraphicsPipelines(
       }
       else
       {
-        live = GetResourceManager()->WrapResource(Unwrap(device), pipe);
+        if(compile)
+          live = GetResID(pipe);
+        else
+          live = GetResourceManager()->WrapResource(Unwrap(device), pipe);
         GetResourceManager()->AddLiveResource(Pipeline, pipe);
 
         VkGraphicsPipelineCreateInfo shadInstantiatedInfo = CreateInfo;
@@ -549,13 +707,25 @@ bool WrappedVulkan::Serialise_vkCreateGraphicsPipelines(
               m_CreationInfo.m_RenderPass[renderPassID].loadRPs[CreateInfo.subpass];
           CreateInfo.subpass = 0;
 
-          unwrapped = UnwrapInfos(m_State, &CreateInfo, 1);
-          ret = ObjDisp(device)->CreateGraphicsPipelines(Unwrap(device), Unwrap(pipelineCache), 1,
-                                                         unwrapped, NULL, &pipeInfo.subpass0pipe);
-          RDCASSERTEQUAL(ret, VK_SUCCESS);
+          ResourceId subpass0id;
+
+          if(compile)
+          {
+            compile->subpass0RenderPass = Unwrap(CreateInfo.renderPass);
+
+            subpass0id = GetResourceManager()->WrapDeferredResource(pipeInfo.subpass0pipe);
+            compile->subpass0pipe = pipeInfo.subpass0pipe;
+          }
+          else
+          {
+            VkGraphicsPipelineCreateInfo *unwrapped = UnwrapInfos(m_State, &CreateInfo, 1);
+            ret = ObjDisp(device)->CreateGraphicsPipelines(Unwrap(device), Unwrap(pipelineCache),
+                                                           1, unwrapped, NULL,
+                                                           &pipeInfo.subpass0pipe);
+            RDCASSERTEQUAL(ret, VK_SUCCESS);
 
-          ResourceId subpass0id =
-              GetResourceManager()->WrapResource(Unwrap(device), pipeInfo.subpass0pipe);
+            subpass0id = GetResourceManager()->WrapResource(Unwrap(device), pipeInfo.subpass0pipe);
+          }
 
           // register as a live-only resource, so it is cleaned up properly
           GetResourceManager()->AddLiveResource(subpass0id, pipeInfo.subpass0pipe);
@@ -591,6 +761,14 @@ bool WrappedVulkan::Serialise_vkCreateGraphicsPipelines(
         DerivedResource(libraryInfo->pLibraries[l], Pipeline);
       }
     }
+
+    if(compile)
+    {
+      DeferPipelineCompile(compile);
+
+      // the deferred compile now owns the deserialised create info and will free it
+      CreateInfo = VkGraphicsPipelineCreateInfo();
+    }
   }
 
   return true;
@@ -747,8 +925,8 @@ bool WrappedVulkan::Serialise_vkCreateComputePipelines(SerialiserType &ser, VkDe
 
     VkPipelineCache origCache = pipelineCache;
 
-    // don't use pipeline caches on replay
-    pipelineCache = VK_NULL_HANDLE;
+    // don't use the application's pipeline caches on replay, use our own persistent one
+    pipelineCache = GetShaderCache()->GetCapturePipeCache();
 
     // if we have pipeline executable properties, capture the data
     if(GetExtensions(NULL).ext_KHR_pipeline_executable_properties)
@@ -757,9 +935,20 @@ bool WrappedVulkan::Serialise_vkCreateComputePipelines(SerialiserType &ser, VkDe
                            VK_PIPELINE_CREATE_CAPTURE_INTERNAL_REPRESENTATIONS_BIT_KHR);
     }
 
-    VkComputePipelineCreateInfo *unwrapped = UnwrapInfos(m_State, &CreateInfo, 1);
-    VkResult ret = ObjDisp(device)->CreateComputePipelines(Unwrap(device), Unwrap(pipelineCache), 1,
-                                                           unwrapped, NULL, &pipe);
+    DeferredPipelineCompile *compile = NULL;
+    VkResult ret = VK_SUCCESS;
+
+    bool defer = ShouldDeferPipelineCompile(CreateInfo.flags, CreateInfo.pNext);
+
+    if(!defer)
+    {
+      if(!FlushDeferredPipelineCompiles())
+        return false;
+
+      VkComputePipelineCreateInfo *unwrapped = UnwrapInfos(m_State, &CreateInfo, 1);
+      ret = ObjDisp(device)->CreateComputePipelines(Unwrap(device), Unwrap(pipelineCache), 1,
+                                                    unwrapped, NULL, &pipe);
+    }
 
     if(ret != VK_SUCCESS)
     {
@@ -771,7 +960,20 @@ bool WrappedVulkan::Serialise_vkCreateComputePipelines(SerialiserType &ser, VkDe
     {
       ResourceId live;
 
-      if(GetResourceManager()->HasWrapper(ToTypedHandle(pipe)))
+      // only allocated once nothing else can fail, and queued at the end of this function
+      if(defer)
+      {
+        compile = new DeferredPipelineCompile;
+        compile->device = device;
+        compile->bindPoint = VK_PIPELINE_BIND_POINT_COMPUTE;
+        compile->pipelineCache = Unwrap(pipelineCache);
+        compile->computeInfo = CreateInfo;
+
+        GetResourceManager()->WrapDeferredResource(pipe);
+        compile->pipe = pipe;
+      }
+
+      if(!compile && GetResourceManager()->HasWrapper(ToTypedHandle(pipe)))
       {
         live = GetResourceManager()->GetNonDispWrapper(pipe)->id;
 
@@ -784,7 +986,10 @@ bool WrappedVulkan::Serialise_vkCreateComputePipelines(SerialiserType &ser, VkDe
       }
       else
       {
-        live = GetResourceManager()->WrapResource(Unwrap(device), pipe);
+        if(compile)
+          live = GetResID(pipe);
+        else
+          live = GetResourceManager()->WrapResource(Unwrap(device), pipe);
         GetResourceManager()->AddLiveResource(Pipeline, pipe);
 
         m_CreationInfo.m_Pipeline[live].Init(GetResourceManager(), m_CreationInfo, live, &CreateInfo);
@@ -802,6 +1007,14 @@ bool WrappedVulkan::Serialise_vkCreateComputePipelines(SerialiserType &ser, VkDe
     }
     DerivedResource(CreateInfo.layout, Pipeline);
     DerivedResource(CreateInfo.stage.module, Pipeline);
+
+    if(compile)
+    {
+      DeferPipelineCompile(compile);
+
+      // the deferred compile now owns the deserialised create info and will free it
+      CreateInfo = VkComputePipelineCreateInfo();
+    }
   }
 
   return true;
@@ -0,0 +1,61 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t byte;
+
+struct ResourceFormat;
+
+// CPU decoding of block-compressed formats, so textures can be converted without a GPU round-trip
+// or on a device that can't sample the format at all.
+//
+// BC1-BC6H (including sRGB and signed variants), ETC2 RGB8/RGB8A1, ETC2+EAC RGBA8 and EAC
+// R11/RG11 are always supported. BC7 is supported where compressonator is built. ASTC is decoded
+// separately below since its block size isn't part of ResourceFormat.
+bool IsBlockFormatDecodeSupported(const ResourceFormat &fmt);
+
+// the size in bytes of one width x height slice of a 4x4 block format, with tightly packed rows of
+// blocks.
+size_t GetBlockFormatSliceSize(const ResourceFormat &fmt, uint32_t width, uint32_t height);
+
+// decode one width x height slice into tightly packed RGBA texels. With floatOutput the result is
+// RGBA32 float with sRGB formats linearised, otherwise it is RGBA8 unorm with sRGB formats left
+// encoded - the same as remapping the texture to those formats on the GPU. Channels that the format
+// doesn't have are 0, or 1 for alpha. Large slices are decoded across multiple threads.
+bool DecodeBlockFormat(const ResourceFormat &fmt, uint32_t width, uint32_t height, const byte *src,
+                       size_t srcSize, byte *dst, bool floatOutput);
+
+// the size in bytes of one width x height slice of ASTC with the given 2D block footprint.
+size_t GetASTCSliceSize(uint32_t blockWidth, uint32_t blockHeight, uint32_t width, uint32_t height);
+
+// decode one width x height slice of 2D ASTC, as DecodeBlockFormat. Float formats are decoded with
+// the HDR profile, everything else with the LDR profile where HDR blocks decode to the error
+// colour. Returns false for formats other than ASTC and for footprints that aren't in the spec.
+bool DecodeASTC(const ResourceFormat &fmt, uint32_t blockWidth, uint32_t blockHeight,
+                uint32_t width, uint32_t height, const byte *src, size_t srcSize, byte *dst,
+                bool floatOutput);
@@ -828,12 +828,737 @@ void EncodeFormattedComponents(const ResourceFormat &fmt, FloatVector v, byte *d
   }
 }
 
+// batch conversion. We resolve the format to a specialised loop once up front, instead of
+// branching on the format for every texel. The specialised loops must produce bit-identical
+// results to the per-texel functions above, which the unit tests below verify.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SSE2_FORMAT_KERNELS OPTION_ON
+#include <emmintrin.h>
+#else
+#define SSE2_FORMAT_KERNELS OPTION_OFF
+#endif
+
+typedef void (*DecodeTexelsFunc)(const byte *data, size_t stride, FloatVector *out, size_t count);
+typedef void (*EncodeTexelsFunc)(const FloatVector *in, size_t count, byte *data, size_t stride);
+
+template <CompType compType>
+static inline float DecodeComp(uint8_t u8)
+{
+  switch(compType)
+  {
+    case CompType::UInt:
+    case CompType::UScaled: return float(u8);
+    case CompType::SInt:
+    case CompType::SScaled: return float(int8_t(u8));
+    case CompType::UNormSRGB: return SRGB8_lookuptable[u8];
+    case CompType::UNorm: return float(u8) / 255.0f;
+    case CompType::SNorm: return int8_t(u8) == -128 ? -1.0f : float(int8_t(u8)) / 127.0f;
+    default: return 0.0f;
+  }
+}
+
+template <CompType compType>
+static inline float DecodeComp(uint16_t u16)
+{
+  switch(compType)
+  {
+    case CompType::Float: return ConvertFromHalf(u16);
+    case CompType::UInt:
+    case CompType::UScaled: return float(u16);
+    case CompType::SInt:
+    case CompType::SScaled: return float(int16_t(u16));
+    case CompType::UNorm: return float(u16) / 65535.0f;
+    case CompType::SNorm: return int16_t(u16) == -32768 ? -1.0f : float(int16_t(u16)) / 32767.0f;
+    default: return 0.0f;
+  }
+}
+
+template <CompType compType>
+static inline float DecodeComp(uint32_t u32)
+{
+  switch(compType)
+  {
+    case CompType::Float:
+    {
+      float f;
+      memcpy(&f, &u32, sizeof(f));
+      return f;
+    }
+    case CompType::UInt:
+    case CompType::UScaled: return float(u32);
+    case CompType::SInt:
+    case CompType::SScaled: return float(int32_t(u32));
+    default: return 0.0f;
+  }
+}
+
+template <CompType compType>
+static inline void EncodeComp(float f, uint8_t &u8)
+{
+  switch(compType)
+  {
+    case CompType::UInt:
+    case CompType::UScaled: u8 = (uint8_t)RDCCLAMP(f, 0.0f, float(UINT8_MAX)); break;
+    case CompType::SInt:
+    case CompType::SScaled:
+      u8 = uint8_t((int8_t)RDCCLAMP(f, float(INT8_MIN), float(INT8_MAX)));
+      break;
+    case CompType::UNormSRGB: u8 = uint8_t(ConvertLinearToSRGB(f) * float(0xff) + 0.5f); break;
+    case CompType::UNorm: u8 = uint8_t(RDCCLAMP(f, 0.0f, 1.0f) * float(0xff) + 0.5f); break;
+    case CompType::SNorm:
+      f = RDCCLAMP(f, -1.0f, 1.0f) * 0x7f;
+      u8 = uint8_t(f < 0.0f ? int8_t(f - 0.5f) : int8_t(f + 0.5f));
+      break;
+    default: break;
+  }
+}
+
+template <CompType compType>
+static inline void EncodeComp(float f, uint16_t &u16)
+{
+  switch(compType)
+  {
+    case CompType::Float: u16 = ConvertToHalf(f); break;
+    case CompType::UInt:
+    case CompType::UScaled: u16 = (uint16_t)RDCCLAMP(f, 0.0f, float(UINT16_MAX)); break;
+    case CompType::SInt:
+    case CompType::SScaled:
+      u16 = uint16_t((int16_t)RDCCLAMP(f, float(INT16_MIN), float(INT16_MAX)));
+      break;
+    case CompType::UNorm: u16 = uint16_t(RDCCLAMP(f, 0.0f, 1.0f) * float(0xffff) + 0.5f); break;
+    case CompType::SNorm:
+      f = RDCCLAMP(f, -1.0f, 1.0f) * 0x7fff;
+      u16 = uint16_t(f < 0.0f ? int16_t(f - 0.5f) : int16_t(f + 0.5f));
+      break;
+    default: break;
+  }
+}
+
+template <CompType compType>
+static inline void EncodeComp(float f, uint32_t &u32)
+{
+  switch(compType)
+  {
+    case CompType::Float: memcpy(&u32, &f, sizeof(f)); break;
+    case CompType::UInt:
+    case CompType::UScaled: u32 = uint32_t(RDCCLAMP(f, 0.0f, float(UINT32_MAX))); break;
+    case CompType::SInt:
+    case CompType::SScaled:
+      u32 = uint32_t(int32_t(RDCCLAMP(f, float(INT32_MIN), float(INT32_MAX))));
+      break;
+    default: break;
+  }
+}
+
+// alpha is never interpreted as sRGB
+template <CompType compType>
+struct AlphaCompType
+{
+  static const CompType value = compType == CompType::UNormSRGB ? CompType::UNorm : compType;
+};
+
+template <typename T, CompType compType, uint32_t compCount, bool bgra>
+static void DecodeTexels(const byte *data, size_t stride, FloatVector *out, size_t count)
+{
+  const float defaultW =
+      (compType == CompType::UInt || compType == CompType::SInt || compCount == 4) ? 0.0f : 1.0f;
+
+  for(size_t i = 0; i < count; i++, data += stride)
+  {
+    T raw[compCount];
+    memcpy(raw, data, sizeof(raw));
+
+    FloatVector ret(0.0f, 0.0f, 0.0f, defaultW);
+    float *comp = &ret.x;
+
+    for(uint32_t c = 0; c < compCount; c++)
+      comp[c] = c == 3 ? DecodeComp<AlphaCompType<compType>::value>(raw[c])
+                       : DecodeComp<compType>(raw[c]);
+
+    if(bgra)
+      std::swap(ret.x, ret.z);
+
+    out[i] = ret;
+  }
+}
+
+template <typename T, CompType compType, uint32_t compCount>
+static void EncodeTexels(const FloatVector *in, size_t count, byte *data, size_t stride)
+{
+  for(size_t i = 0; i < count; i++, data += stride)
+  {
+    const float *comp = &in[i].x;
+
+    T raw[compCount];
+    for(uint32_t c = 0; c < compCount; c++)
+    {
+      if(c == 3)
+        EncodeComp<AlphaCompType<compType>::value>(comp[c], raw[c]);
+      else
+        EncodeComp<compType>(comp[c], raw[c]);
+    }
+
+    memcpy(data, raw, sizeof(raw));
+  }
+}
+
+template <bool bgra>
+static void DecodeR10G10B10A2Texels(const byte *data, size_t stride, FloatVector *out, size_t count)
+{
+  for(size_t i = 0; i < count; i++, data += stride)
+  {
+    uint32_t u;
+    memcpy(&u, data, sizeof(u));
+    Vec4f v = ConvertFromR10G10B10A2(u);
+    out[i] = bgra ? FloatVector(v.z, v.y, v.x, v.w) : FloatVector(v.x, v.y, v.z, v.w);
+  }
+}
+
+static void DecodeR11G11B10Texels(const byte *data, size_t stride, FloatVector *out, size_t count)
+{
+  for(size_t i = 0; i < count; i++, data += stride)
+  {
+    uint32_t u;
+    memcpy(&u, data, sizeof(u));
+    Vec3f v = ConvertFromR11G11B10(u);
+    out[i] = FloatVector(v.x, v.y, v.z, 1.0f);
+  }
+}
+
+static void DecodeR9G9B9E5Texels(const byte *data, size_t stride, FloatVector *out, size_t count)
+{
+  for(size_t i = 0; i < count; i++, data += stride)
+  {
+    uint32_t u;
+    memcpy(&u, data, sizeof(u));
+    Vec3f v = ConvertFromR9G9B9E5(u);
+    out[i] = FloatVector(v.x, v.y, v.z, 1.0f);
+  }
+}
+
+#if ENABLED(SSE2_FORMAT_KERNELS)
+
+// the SSE2 kernels process four tightly packed texels at a time, and leave any remainder (or a
+// non-tight stride) to the scalar loops. Divisions are kept as divisions rather than multiplying
+// by a reciprocal so that the results match the scalar path exactly.
+
+static inline void StoreTransposed(FloatVector *out, __m128 x, __m128 y, __m128 z, __m128 w)
+{
+  _MM_TRANSPOSE4_PS(x, y, z, w);
+  _mm_storeu_ps(&out[0].x, x);
+  _mm_storeu_ps(&out[1].x, y);
+  _mm_storeu_ps(&out[2].x, z);
+  _mm_storeu_ps(&out[3].x, w);
+}
+
+template <bool bgra>
+static void DecodeRGBA8UNormTexels_SSE2(const byte *data, size_t stride, FloatVector *out,
+                                        size_t count)
+{
+  size_t i = 0;
+
+  if(stride == 4)
+  {
+    const __m128i mask = _mm_set1_epi32(0xff);
+    const __m128 scale = _mm_set1_ps(255.0f);
+
+    for(; i + 4 <= count; i += 4)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i *)(data + i * 4));
+
+      __m128 r = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(v, mask)), scale);
+      __m128 g = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 8), mask)), scale);
+      __m128 b = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 16), mask)), scale);
+      __m128 a = _mm_div_ps(_mm_cvtepi32_ps(_mm_srli_epi32(v, 24)), scale);
+
+      if(bgra)
+        StoreTransposed(out + i, b, g, r, a);
+      else
+        StoreTransposed(out + i, r, g, b, a);
+    }
+  }
+
+  DecodeTexels<uint8_t, CompType::UNorm, 4, bgra>(data + i * stride, stride, out + i, count - i);
+}
+
+template <bool bgra>
+static void DecodeR10G10B10A2Texels_SSE2(const byte *data, size_t stride, FloatVector *out,
+                                         size_t count)
+{
+  size_t i = 0;
+
+  if(stride == 4)
+  {
+    const __m128i mask = _mm_set1_epi32(0x3ff);
+    const __m128 scale = _mm_set1_ps(1023.0f);
+    const __m128 alphaScale = _mm_set1_ps(3.0f);
+
+    for(; i + 4 <= count; i += 4)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i *)(data + i * 4));
+
+      __m128 r = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(v, mask)), scale);
+      __m128 g = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 10), mask)), scale);
+      __m128 b = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 20), mask)), scale);
+      __m128 a = _mm_div_ps(_mm_cvtepi32_ps(_mm_srli_epi32(v, 30)), alphaScale);
+
+      if(bgra)
+        StoreTransposed(out + i, b, g, r, a);
+      else
+        StoreTransposed(out + i, r, g, b, a);
+    }
+  }
+
+  DecodeR10G10B10A2Texels<bgra>(data + i * stride, stride, out + i, count - i);
+}
+
+static inline __m128 Select(__m128i mask, __m128 a, __m128 b)
+{
+  __m128 m = _mm_castsi128_ps(mask);
+  return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+}
+
+// converts four halfs, zero-extended into 32-bit lanes, matching ConvertFromHalf()
+static inline __m128 HalfToFloat(__m128i h)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i sign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16);
+  const __m128i exponent = _mm_and_si128(h, _mm_set1_epi32(0x7c00));
+  const __m128i mantissa = _mm_and_si128(h, _mm_set1_epi32(0x03ff));
+
+  // normal values just need the exponent rebiased
+  __m128i normal = _mm_add_epi32(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7fff)), 13),
+                                 _mm_set1_epi32((127 - 15) << 23));
+  __m128 ret = _mm_castsi128_ps(_mm_or_si128(sign, normal));
+
+  // subnormals (and zero) are exactly mantissa * 2^-24
+  __m128 subnormal = _mm_mul_ps(_mm_cvtepi32_ps(mantissa), _mm_set1_ps(1.0f / 16777216.0f));
+  ret = Select(_mm_cmpeq_epi32(exponent, zero),
+               _mm_or_ps(_mm_castsi128_ps(sign), subnormal), ret);
+
+  // infinity keeps its sign, but all NaNs are returned as the same value
+  __m128 inf = _mm_castsi128_ps(_mm_or_si128(sign, _mm_set1_epi32(0x7f800000)));
+  __m128 nan = _mm_castsi128_ps(_mm_set1_epi32(0x7f800001));
+  ret = Select(_mm_cmpeq_epi32(exponent, _mm_set1_epi32(0x7c00)),
+               Select(_mm_cmpeq_epi32(mantissa, zero), inf, nan), ret);
+
+  return ret;
+}
+
+static void DecodeRGBA16FloatTexels_SSE2(const byte *data, size_t stride, FloatVector *out,
+                                         size_t count)
+{
+  size_t i = 0;
+
+  if(stride == 8)
+  {
+    const __m128i zero = _mm_setzero_si128();
+
+    // each texel is four halfs, so unpacking to 32-bit lanes gives one texel per register
+    for(; i + 2 <= count; i += 2)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i *)(data + i * 8));
+
+      _mm_storeu_ps(&out[i + 0].x, HalfToFloat(_mm_unpacklo_epi16(v, zero)));
+      _mm_storeu_ps(&out[i + 1].x, HalfToFloat(_mm_unpackhi_epi16(v, zero)));
+    }
+  }
+
+  DecodeTexels<uint16_t, CompType::Float, 4, false>(data + i * stride, stride, out + i, count - i);
+}
+
+// converts the unsigned small floats in R11G11B10, matching ConvertFromR11G11B10()
+template <int mantissaBits>
+static inline __m128 SmallFloatToFloat(__m128i mantissa, __m128i exponent)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i shiftedMantissa = _mm_slli_epi32(mantissa, 23 - mantissaBits);
+
+  __m128 ret = _mm_castsi128_ps(_mm_or_si128(
+      _mm_slli_epi32(_mm_add_epi32(exponent, _mm_set1_epi32(127 - 15)), 23), shiftedMantissa));
+
+  // denormals (and zero) are exactly mantissa * 2^(-14 - mantissaBits)
+  __m128 subnormal =
+      _mm_mul_ps(_mm_cvtepi32_ps(mantissa), _mm_set1_ps(1.0f / float(1 << (14 + mantissaBits))));
+  ret = Select(_mm_cmpeq_epi32(exponent, zero), subnormal, ret);
+
+  __m128 special = _mm_castsi128_ps(_mm_or_si128(_mm_set1_epi32(0x7f800000), shiftedMantissa));
+  ret = Select(_mm_cmpeq_epi32(exponent, _mm_set1_epi32(0x1f)), special, ret);
+
+  return ret;
+}
+
+static void DecodeR11G11B10Texels_SSE2(const byte *data, size_t stride, FloatVector *out,
+                                       size_t count)
+{
+  size_t i = 0;
+
+  if(stride == 4)
+  {
+    const __m128i mask5 = _mm_set1_epi32(0x1f);
+    const __m128i mask6 = _mm_set1_epi32(0x3f);
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    for(; i + 4 <= count; i += 4)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i *)(data + i * 4));
+
+      __m128 r = SmallFloatToFloat<6>(_mm_and_si128(v, mask6),
+                                      _mm_and_si128(_mm_srli_epi32(v, 6), mask5));
+      __m128 g = SmallFloatToFloat<6>(_mm_and_si128(_mm_srli_epi32(v, 11), mask6),
+                                      _mm_and_si128(_mm_srli_epi32(v, 17), mask5));
+      __m128 b = SmallFloatToFloat<5>(_mm_and_si128(_mm_srli_epi32(v, 22), mask5),
+                                      _mm_srli_epi32(v, 27));
+
+      StoreTransposed(out + i, r, g, b, one);
+    }
+  }
+
+  DecodeR11G11B10Texels(data + i * stride, stride, out + i, count - i);
+}
+
+static void DecodeR9G9B9E5Texels_SSE2(const byte *data, size_t stride, FloatVector *out,
+                                      size_t count)
+{
+  size_t i = 0;
+
+  if(stride == 4)
+  {
+    const __m128i mask9 = _mm_set1_epi32(0x1ff);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 mantissaScale = _mm_set1_ps(512.0f);
+
+    for(; i + 4 <= count; i += 4)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i *)(data + i * 4));
+
+      __m128i exponent = _mm_srli_epi32(v, 27);
+
+      // the shared scale is 2^(exp - 15), which we can construct directly
+      __m128 scale = _mm_castsi128_ps(
+          _mm_slli_epi32(_mm_add_epi32(exponent, _mm_set1_epi32(127 - 15)), 23));
+      __m128i isSpecial = _mm_cmpeq_epi32(exponent, _mm_set1_epi32(0x1f));
+
+      __m128 comps[3];
+      for(int c = 0; c < 3; c++)
+      {
+        __m128i mantissa = _mm_and_si128(_mm_srl_epi32(v, _mm_cvtsi32_si128(9 * c)), mask9);
+
+        __m128 f = _mm_mul_ps(scale, _mm_div_ps(_mm_cvtepi32_ps(mantissa), mantissaScale));
+        __m128 special = _mm_castsi128_ps(
+            _mm_or_si128(_mm_set1_epi32(0x7f800000), _mm_slli_epi32(mantissa, 23 - 9)));
+
+        comps[c] = Select(isSpecial, special, f);
+      }
+
+      StoreTransposed(out + i, comps[0], comps[1], comps[2], one);
+    }
+  }
+
+  DecodeR9G9B9E5Texels(data + i * stride, stride, out + i, count - i);
+}
+
+static void EncodeRGBA8UNormTexels_SSE2(const FloatVector *in, size_t count, byte *data,
+                                        size_t stride)
+{
+  size_t i = 0;
+
+  if(stride == 4)
+  {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    for(; i + 4 <= count; i += 4)
+    {
+      __m128i texels[4];
+      for(int t = 0; t < 4; t++)
+      {
+        __m128 v = _mm_max_ps(_mm_min_ps(_mm_loadu_ps(&in[i + t].x), one), zero);
+        texels[t] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half));
+      }
+
+      __m128i packed = _mm_packus_epi16(_mm_packs_epi32(texels[0], texels[1]),
+                                        _mm_packs_epi32(texels[2], texels[3]));
+      _mm_storeu_si128((__m128i *)(data + i * 4), packed);
+    }
+  }
+
+  EncodeTexels<uint8_t, CompType::UNorm, 4>(in + i, count - i, data + i * stride, stride);
+}
+
+#endif    // ENABLED(SSE2_FORMAT_KERNELS)
+
+template <bool bgra>
+static void EncodeR10G10B10A2Texels(const FloatVector *in, size_t count, byte *data, size_t stride)
+{
+  for(size_t i = 0; i < count; i++, data += stride)
+  {
+    const FloatVector &v = in[i];
+    uint32_t u = ConvertToR10G10B10A2(bgra ? Vec4f(v.z, v.y, v.x, v.w) : Vec4f(v.x, v.y, v.z, v.w));
+    memcpy(data, &u, sizeof(u));
+  }
+}
+
+static void EncodeR11G11B10Texels(const FloatVector *in, size_t count, byte *data, size_t stride)
+{
+  for(size_t i = 0; i < count; i++, data += stride)
+  {
+    uint32_t u = ConvertToR11G11B10(Vec3f(in[i].x, in[i].y, in[i].z));
+    memcpy(data, &u, sizeof(u));
+  }
+}
+
+static void EncodeR9G9B9E5Texels(const FloatVector *in, size_t count, byte *data, size_t stride)
+{
+  for(size_t i = 0; i < count; i++, data += stride)
+  {
+    uint32_t u = ConvertToR9G9B9E5(Vec3f(in[i].x, in[i].y, in[i].z));
+    memcpy(data, &u, sizeof(u));
+  }
+}
+
+template <typename T, CompType compType>
+static DecodeTexelsFunc GetRegularDecodeTexels(uint32_t compCount, bool bgra)
+{
+  switch(compCount)
+  {
+    case 1:
+      return bgra ? &DecodeTexels<T, compType, 1, true> : &DecodeTexels<T, compType, 1, false>;
+    case 2:
+      return bgra ? &DecodeTexels<T, compType, 2, true> : &DecodeTexels<T, compType, 2, false>;
+    case 3:
+      return bgra ? &DecodeTexels<T, compType, 3, true> : &DecodeTexels<T, compType, 3, false>;
+    case 4:
+      return bgra ? &DecodeTexels<T, compType, 4, true> : &DecodeTexels<T, compType, 4, false>;
+    default: return NULL;
+  }
+}
+
+template <typename T, CompType compType>
+static EncodeTexelsFunc GetRegularEncodeTexels(uint32_t compCount)
+{
+  switch(compCount)
+  {
+    case 1: return &EncodeTexels<T, compType, 1>;
+    case 2: return &EncodeTexels<T, compType, 2>;
+    case 3: return &EncodeTexels<T, compType, 3>;
+    case 4: return &EncodeTexels<T, compType, 4>;
+    default: return NULL;
+  }
+}
+
+// returns NULL for formats without a specialised loop, which are converted texel by texel
+static DecodeTexelsFunc GetDecodeTexelsFunc(const ResourceFormat &fmt)
+{
+  const bool bgra = fmt.BGRAOrder();
+
+#if ENABLED(SSE2_FORMAT_KERNELS)
+  if(fmt.type == ResourceFormatType::R10G10B10A2 && fmt.compType == CompType::UNorm)
+    return bgra ? &DecodeR10G10B10A2Texels_SSE2<true> : &DecodeR10G10B10A2Texels_SSE2<false>;
+  if(fmt.type == ResourceFormatType::R11G11B10 && fmt.compCount == 3)
+    return &DecodeR11G11B10Texels_SSE2;
+  if(fmt.type == ResourceFormatType::R9G9B9E5 && fmt.compCount == 3)
+    return &DecodeR9G9B9E5Texels_SSE2;
+#else
+  if(fmt.type == ResourceFormatType::R10G10B10A2 && fmt.compType == CompType::UNorm)
+    return bgra ? &DecodeR10G10B10A2Texels<true> : &DecodeR10G10B10A2Texels<false>;
+  if(fmt.type == ResourceFormatType::R11G11B10 && fmt.compCount == 3)
+    return &DecodeR11G11B10Texels;
+  if(fmt.type == ResourceFormatType::R9G9B9E5 && fmt.compCount == 3)
+    return &DecodeR9G9B9E5Texels;
+#endif
+
+  if(fmt.type != ResourceFormatType::Regular)
+    return NULL;
+
+  if(fmt.compByteWidth == 4)
+  {
+    switch(fmt.compType)
+    {
+      case CompType::Float:
+      case CompType::Depth:
+        return GetRegularDecodeTexels<uint32_t, CompType::Float>(fmt.compCount, bgra);
+      case CompType::UInt:
+        return GetRegularDecodeTexels<uint32_t, CompType::UInt>(fmt.compCount, bgra);
+      case CompType::UScaled:
+        return GetRegularDecodeTexels<uint32_t, CompType::UScaled>(fmt.compCount, bgra);
+      case CompType::SInt:
+        return GetRegularDecodeTexels<uint32_t, CompType::SInt>(fmt.compCount, bgra);
+      case CompType::SScaled:
+        return GetRegularDecodeTexels<uint32_t, CompType::SScaled>(fmt.compCount, bgra);
+      default: return NULL;
+    }
+  }
+  else if(fmt.compByteWidth == 2)
+  {
+    switch(fmt.compType)
+    {
+      case CompType::Float:
+#if ENABLED(SSE2_FORMAT_KERNELS)
+        if(fmt.compCount == 4 && !bgra)
+          return &DecodeRGBA16FloatTexels_SSE2;
+#endif
+        return GetRegularDecodeTexels<uint16_t, CompType::Float>(fmt.compCount, bgra);
+      case CompType::UNorm:
+      case CompType::Depth:
+        return GetRegularDecodeTexels<uint16_t, CompType::UNorm>(fmt.compCount, bgra);
+      case CompType::SNorm:
+        return GetRegularDecodeTexels<uint16_t, CompType::SNorm>(fmt.compCount, bgra);
+      case CompType::UInt:
+        return GetRegularDecodeTexels<uint16_t, CompType::UInt>(fmt.compCount, bgra);
+      case CompType::UScaled:
+        return GetRegularDecodeTexels<uint16_t, CompType::UScaled>(fmt.compCount, bgra);
+      case CompType::SInt:
+        return GetRegularDecodeTexels<uint16_t, CompType::SInt>(fmt.compCount, bgra);
+      case CompType::SScaled:
+        return GetRegularDecodeTexels<uint16_t, CompType::SScaled>(fmt.compCount, bgra);
+      default: return NULL;
+    }
+  }
+  else if(fmt.compByteWidth == 1)
+  {
+    switch(fmt.compType)
+    {
+      case CompType::UNorm:
+#if ENABLED(SSE2_FORMAT_KERNELS)
+        if(fmt.compCount == 4)
+          return bgra ? &DecodeRGBA8UNormTexels_SSE2<true> : &DecodeRGBA8UNormTexels_SSE2<false>;
+#endif
+        return GetRegularDecodeTexels<uint8_t, CompType::UNorm>(fmt.compCount, bgra);
+      case CompType::UNormSRGB:
+        return GetRegularDecodeTexels<uint8_t, CompType::UNormSRGB>(fmt.compCount, bgra);
+      case CompType::SNorm:
+        return GetRegularDecodeTexels<uint8_t, CompType::SNorm>(fmt.compCount, bgra);
+      case CompType::UInt:
+        return GetRegularDecodeTexels<uint8_t, CompType::UInt>(fmt.compCount, bgra);
+      case CompType::UScaled:
+        return GetRegularDecodeTexels<uint8_t, CompType::UScaled>(fmt.compCount, bgra);
+      case CompType::SInt:
+        return GetRegularDecodeTexels<uint8_t, CompType::SInt>(fmt.compCount, bgra);
+      case CompType::SScaled:
+        return GetRegularDecodeTexels<uint8_t, CompType::SScaled>(fmt.compCount, bgra);
+      default: return NULL;
+    }
+  }
+
+  return NULL;
+}
+
+static EncodeTexelsFunc GetEncodeTexelsFunc(const ResourceFormat &fmt)
+{
+  if(fmt.type == ResourceFormatType::R10G10B10A2 && fmt.compType == CompType::UNorm)
+    return fmt.BGRAOrder() ? &EncodeR10G10B10A2Texels<true> : &EncodeR10G10B10A2Texels<false>;
+  if(fmt.type == ResourceFormatType::R11G11B10)
+    return &EncodeR11G11B10Texels;
+  if(fmt.type == ResourceFormatType::R9G9B9E5)
+    return &EncodeR9G9B9E5Texels;
+
+  if(fmt.type != ResourceFormatType::Regular)
+    return NULL;
+
+  // note that unlike decoding, encoding of regular formats doesn't swizzle BGRA
+  if(fmt.compByteWidth == 4)
+  {
+    switch(fmt.compType)
+    {
+      case CompType::Float:
+      case CompType::Depth: return GetRegularEncodeTexels<uint32_t, CompType::Float>(fmt.compCount);
+      case CompType::UInt:
+      case CompType::UScaled:
+        return GetRegularEncodeTexels<uint32_t, CompType::UInt>(fmt.compCount);
+      case CompType::SInt:
+      case CompType::SScaled:
+        return GetRegularEncodeTexels<uint32_t, CompType::SInt>(fmt.compCount);
+      default: return NULL;
+    }
+  }
+  else if(fmt.compByteWidth == 2)
+  {
+    switch(fmt.compType)
+    {
+      case CompType::Float: return GetRegularEncodeTexels<uint16_t, CompType::Float>(fmt.compCount);
+      case CompType::UNorm:
+      case CompType::Depth: return GetRegularEncodeTexels<uint16_t, CompType::UNorm>(fmt.compCount);
+      case CompType::SNorm: return GetRegularEncodeTexels<uint16_t, CompType::SNorm>(fmt.compCount);
+      case CompType::UInt:
+      case CompType::UScaled:
+        return GetRegularEncodeTexels<uint16_t, CompType::UInt>(fmt.compCount);
+      case CompType::SInt:
+      case CompType::SScaled:
+        return GetRegularEncodeTexels<uint16_t, CompType::SInt>(fmt.compCount);
+      default: return NULL;
+    }
+  }
+  else if(fmt.compByteWidth == 1)
+  {
+    switch(fmt.compType)
+    {
+      case CompType::UNorm:
+#if ENABLED(SSE2_FORMAT_KERNELS)
+        if(fmt.compCount == 4)
+          return &EncodeRGBA8UNormTexels_SSE2;
+#endif
+        return GetRegularEncodeTexels<uint8_t, CompType::UNorm>(fmt.compCount);
+      case CompType::UNormSRGB:
+        return GetRegularEncodeTexels<uint8_t, CompType::UNormSRGB>(fmt.compCount);
+      case CompType::SNorm: return GetRegularEncodeTexels<uint8_t, CompType::SNorm>(fmt.compCount);
+      case CompType::UInt:
+      case CompType::UScaled: return GetRegularEncodeTexels<uint8_t, CompType::UInt>(fmt.compCount);
+      case CompType::SInt:
+      case CompType::SScaled: return GetRegularEncodeTexels<uint8_t, CompType::SInt>(fmt.compCount);
+      default: return NULL;
+    }
+  }
+
+  return NULL;
+}
+
+void DecodeFormattedComponents(const ResourceFormat &fmt, const byte *data, size_t stride,
+                               FloatVector *out, size_t count, bool *success)
+{
+  DecodeTexelsFunc func = GetDecodeTexelsFunc(fmt);
+
+  if(func)
+  {
+    if(success)
+      *success = true;
+
+    func(data, stride, out, count);
+    return;
+  }
+
+  for(size_t i = 0; i < count; i++, data += stride)
+    out[i] = DecodeFormattedComponents(fmt, data, success);
+}
+
+void EncodeFormattedComponents(const ResourceFormat &fmt, const FloatVector *in, size_t count,
+                               byte *data, size_t stride, bool *success)
+{
+  EncodeTexelsFunc func = GetEncodeTexelsFunc(fmt);
+
+  if(func)
+  {
+    if(success)
+      *success = true;
+
+    func(in, count, data, stride);
+    return;
+  }
+
+  for(size_t i = 0; i < count; i++, data += stride)
+    EncodeFormattedComponents(fmt, in[i], data, success);
+}
+
 #if ENABLED(ENABLE_UNIT_TESTS)
 
 #undef None
 
 #include "catch/catch.hpp"
 #include "common/formatting.h"
+#include "common/timing.h"
 
 template <>
 rdcstr DoStringise(const FloatVector &el)
@@ -1557,4 +2282,260 @@ TEST_CASE("Check format conversion", "[format]")
   };
 }
 
+static rdcarray<ResourceFormat> BatchTestFormats()
+{
+  rdcarray<ResourceFormat> ret;
+
+  ResourceFormat fmt;
+  fmt.type = ResourceFormatType::Regular;
+
+  const rdcpair<uint8_t, CompType> regular[] = {
+      {4, CompType::Float},   {4, CompType::Depth},     {4, CompType::UInt},
+      {4, CompType::UScaled}, {4, CompType::SInt},      {4, CompType::SScaled},
+      {2, CompType::Float},   {2, CompType::UNorm},     {2, CompType::Depth},
+      {2, CompType::SNorm},   {2, CompType::UInt},      {2, CompType::UScaled},
+      {2, CompType::SInt},    {2, CompType::SScaled},   {1, CompType::UNorm},
+      {1, CompType::SNorm},   {1, CompType::UNormSRGB}, {1, CompType::UInt},
+      {1, CompType::UScaled}, {1, CompType::SInt},      {1, CompType::SScaled},
+      // no specialised path, these convert texel by texel
+      {8, CompType::Float},   {1, CompType::Typeless},
+  };
+
+  for(const rdcpair<uint8_t, CompType> &r : regular)
+  {
+    for(uint8_t compCount = 1; compCount <= 4; compCount++)
+    {
+      for(bool bgra : {false, true})
+      {
+        fmt.compByteWidth = r.first;
+        fmt.compType = r.second;
+        fmt.compCount = compCount;
+        fmt.SetBGRAOrder(bgra);
+        ret.push_back(fmt);
+      }
+    }
+  }
+
+  fmt = ResourceFormat();
+  fmt.type = ResourceFormatType::R10G10B10A2;
+  fmt.compByteWidth = 1;
+  fmt.compCount = 4;
+  for(CompType compType : {CompType::UNorm, CompType::SNorm, CompType::UInt})
+  {
+    for(bool bgra : {false, true})
+    {
+      fmt.compType = compType;
+      fmt.SetBGRAOrder(bgra);
+      ret.push_back(fmt);
+    }
+  }
+
+  fmt = ResourceFormat();
+  fmt.compByteWidth = 1;
+  fmt.compCount = 3;
+  fmt.compType = CompType::Float;
+  fmt.type = ResourceFormatType::R11G11B10;
+  ret.push_back(fmt);
+  fmt.type = ResourceFormatType::R9G9B9E5;
+  ret.push_back(fmt);
+
+  fmt = ResourceFormat();
+  fmt.type = ResourceFormatType::D24S8;
+  fmt.compType = CompType::Depth;
+  fmt.compByteWidth = 1;
+  fmt.compCount = 2;
+  ret.push_back(fmt);
+
+  return ret;
+}
+
+static uint32_t BatchTestStride(const ResourceFormat &fmt)
+{
+  return fmt.type == ResourceFormatType::Regular ? fmt.ElementSize() : 4;
+}
+
+TEST_CASE("Check batch format conversion", "[format]")
+{
+  // an odd count, so that we cover the SIMD loops and their remainders
+  const size_t count = 1027;
+
+  uint32_t seed = 12345;
+  auto rand = [&seed]() {
+    seed = seed * 1664525U + 1013904223U;
+    return seed;
+  };
+
+  // random bits for decoding, covering NaNs, infinities, denormals etc for float formats
+  bytebuf data;
+  data.resize(count * 64);
+  for(byte &b : data)
+    b = byte(rand() >> 24);
+
+  // make sure special values are present in the packed float formats too
+  for(uint32_t special : {0x00000000U, 0xffffffffU, 0x7c007c00U, 0xf8000000U, 0x07ff03ffU})
+    memcpy(&data[(rand() % count) * 4], &special, sizeof(special));
+
+  rdcarray<FloatVector> vecs;
+  vecs.resize(count);
+  for(FloatVector &v : vecs)
+  {
+    float *comp = &v.x;
+    for(int c = 0; c < 4; c++)
+      comp[c] = (float(rand() >> 8) / float(1 << 24)) * 3.0f - 1.5f;
+  }
+
+  rdcarray<FloatVector> positiveVecs = vecs;
+  for(FloatVector &v : positiveVecs)
+  {
+    v.x = fabsf(v.x);
+    v.y = fabsf(v.y);
+    v.z = fabsf(v.z);
+    v.w = fabsf(v.w);
+  }
+
+  for(const ResourceFormat &fmt : BatchTestFormats())
+  {
+    const uint32_t texelSize = BatchTestStride(fmt);
+
+    // test both tightly packed and padded texels
+    for(uint32_t stride : {texelSize, texelSize + 4})
+    {
+      INFO("format " << fmt.Name().c_str() << " width " << (uint32_t)fmt.compByteWidth << " count "
+                     << (uint32_t)fmt.compCount << " stride " << stride);
+
+      // decode
+      {
+        rdcarray<FloatVector> batch;
+        batch.resize(count);
+
+        bool batchSuccess = false;
+        DecodeFormattedComponents(fmt, data.data(), stride, batch.data(), count, &batchSuccess);
+
+        bool success = false;
+        bool mismatch = false;
+        for(size_t i = 0; i < count && !mismatch; i++)
+        {
+          FloatVector ref = DecodeFormattedComponents(fmt, data.data() + i * stride, &success);
+
+          // compare bitwise so that NaNs are checked too
+          if(memcmp(&ref, &batch[i], sizeof(FloatVector)) != 0)
+          {
+            mismatch = true;
+            INFO("texel " << i);
+            CHECK(ref == batch[i]);
+          }
+        }
+
+        CHECK(batchSuccess == success);
+        CHECK_FALSE(mismatch);
+      }
+
+      // encode
+      {
+        // sRGB encoding doesn't clamp negative values, which are undefined to convert
+        const rdcarray<FloatVector> &input =
+            fmt.compType == CompType::UNormSRGB ? positiveVecs : vecs;
+
+        bytebuf ref, batch;
+        ref.resize(count * stride);
+        batch.resize(count * stride);
+
+        bool batchSuccess = false;
+        EncodeFormattedComponents(fmt, input.data(), count, batch.data(), stride, &batchSuccess);
+
+        bool success = false;
+        for(size_t i = 0; i < count; i++)
+          EncodeFormattedComponents(fmt, input[i], ref.data() + i * stride, &success);
+
+        CHECK(batchSuccess == success);
+        CHECK((ref == batch));
+      }
+    }
+  }
+}
+
+TEST_CASE("Benchmark batch format conversion", "[format][.benchmark]")
+{
+  const uint32_t width = 4096, height = 1024;
+  const size_t count = width * height;
+
+  rdcarray<ResourceFormat> formats;
+
+  ResourceFormat fmt;
+  fmt.type = ResourceFormatType::Regular;
+  fmt.compCount = 4;
+
+  fmt.compByteWidth = 1;
+  fmt.compType = CompType::UNorm;
+  formats.push_back(fmt);
+  fmt.compType = CompType::UNormSRGB;
+  formats.push_back(fmt);
+  fmt.compByteWidth = 2;
+  fmt.compType = CompType::Float;
+  formats.push_back(fmt);
+  fmt.compByteWidth = 4;
+  formats.push_back(fmt);
+
+  fmt = ResourceFormat();
+  fmt.type = ResourceFormatType::R10G10B10A2;
+  fmt.compType = CompType::UNorm;
+  fmt.compByteWidth = 1;
+  fmt.compCount = 4;
+  formats.push_back(fmt);
+
+  fmt.type = ResourceFormatType::R11G11B10;
+  fmt.compType = CompType::Float;
+  fmt.compCount = 3;
+  formats.push_back(fmt);
+
+  fmt.type = ResourceFormatType::R9G9B9E5;
+  formats.push_back(fmt);
+
+  bytebuf data;
+  data.resize(count * 16);
+  for(size_t i = 0; i < data.size(); i++)
+    data[i] = byte((i * 2654435761U) >> 24);
+
+  rdcarray<FloatVector> out;
+  out.resize(count);
+
+  for(const ResourceFormat &f : formats)
+  {
+    const uint32_t stride = BatchTestStride(f);
+
+    PerformanceTimer timer;
+
+    const byte *src = data.data();
+    for(size_t i = 0; i < count; i++, src += stride)
+      out[i] = DecodeFormattedComponents(f, src);
+
+    double scalarTime = timer.GetMilliseconds();
+
+    timer.Restart();
+
+    DecodeFormattedComponents(f, data.data(), stride, out.data(), count);
+
+    double batchTime = timer.GetMilliseconds();
+
+    timer.Restart();
+
+    byte *dst = data.data();
+    for(size_t i = 0; i < count; i++, dst += stride)
+      EncodeFormattedComponents(f, out[i], dst);
+
+    double scalarEncodeTime = timer.GetMilliseconds();
+
+    timer.Restart();
+
+    EncodeFormattedComponents(f, out.data(), count, data.data(), stride);
+
+    double batchEncodeTime = timer.GetMilliseconds();
+
+    RDCLOG("%s %ux%u: decode %.2f ms per-texel, %.2f ms batched. encode %.2f ms per-texel, %.2f ms "
+           "batched",
+           f.Name().c_str(), width, height, scalarTime, batchTime, scalarEncodeTime,
+           batchEncodeTime);
+  }
+}
+
 #endif
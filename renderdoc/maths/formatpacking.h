@@ -182,3 +182,11 @@ FloatVector DecodeFormattedComponents(const ResourceFormat &fmt, const byte *dat
                                       bool *success = NULL);
 void EncodeFormattedComponents(const ResourceFormat &fmt, FloatVector v, byte *data,
                                bool *success = NULL);
+
+// batch versions of the above for count texels spaced stride bytes apart. The format is only
+// inspected once per call, and common formats use specialised loops (SIMD where available) that
+// give identical results to converting each texel individually.
+void DecodeFormattedComponents(const ResourceFormat &fmt, const byte *data, size_t stride,
+                               FloatVector *out, size_t count, bool *success = NULL);
+void EncodeFormattedComponents(const ResourceFormat &fmt, const FloatVector *in, size_t count,
+                               byte *data, size_t stride, bool *success = NULL);
@@ -153,6 +153,7 @@ void SetCurrentThreadName(const rdcstr &name);
 typedef uint64_t ThreadHandle;
 ThreadHandle CreateThread(std::function<void()> entryFunc);
 uint64_t GetCurrentID();
+uint32_t GetNumberOfCores();
 void JoinThread(ThreadHandle handle);
 void DetachThread(ThreadHandle handle);
 void CloseThread(ThreadHandle handle);
@@ -236,6 +237,19 @@ int64_t ExchAdd64(int64_t *i, int64_t a);
 int32_t CmpExch32(int32_t *dest, int32_t oldVal, int32_t newVal);
 };
 
+// tracks which pages of a range of memory are written by the CPU, so that memory which is only
+// partly modified between checks doesn't have to be compared in full. Not all platforms support
+// this, in which case Watch() returns false.
+namespace WriteWatch
+{
+bool Watch(void *base, size_t size);
+void Unwatch(void *base);
+// returns sorted ranges of [start, end) byte offsets from base that may have been written since
+// the range was watched or since the last fetch, and resets tracking. Ranges are rounded out to
+// whole pages so they can include bytes that weren't written. Returns false if base isn't watched.
+bool FetchWritten(void *base, rdcarray<rdcpair<size_t, size_t>> &written);
+};
+
 namespace Callstack
 {
 class Stackwalk
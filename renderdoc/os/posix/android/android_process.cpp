@@ -196,3 +196,17 @@ uint64_t Process::GetMemoryUsage()
 
   return 0;
 }
+
+bool WriteWatch::Watch(void *base, size_t size)
+{
+  return false;
+}
+
+void WriteWatch::Unwatch(void *base)
+{
+}
+
+bool WriteWatch::FetchWritten(void *base, rdcarray<rdcpair<size_t, size_t>> &written)
+{
+  return false;
+}
@@ -226,3 +226,17 @@ bool ShouldOutputDebugMon()
 {
   return OSUtility::DebuggerPresent() && RenderDoc::Inst().IsReplayApp();
 }
+
+bool WriteWatch::Watch(void *base, size_t size)
+{
+  return false;
+}
+
+void WriteWatch::Unwatch(void *base)
+{
+}
+
+bool WriteWatch::FetchWritten(void *base, rdcarray<rdcpair<size_t, size_t>> &written)
+{
+  return false;
+}
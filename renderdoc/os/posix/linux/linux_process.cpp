@@ -23,7 +23,10 @@
  ******************************************************************************/
 
 #include <elf.h>
+#include <errno.h>
+#include <signal.h>
 #include <stdlib.h>
+#include <sys/mman.h>
 #include <sys/ptrace.h>
 #include <sys/types.h>
 #include <sys/uio.h>
@@ -35,6 +38,7 @@
 #include "api/replay/data_types.h"
 #include "common/common.h"
 #include "common/formatting.h"
+#include "common/threading.h"
 #include "core/core.h"
 #include "core/settings.h"
 #include "os/os_specific.h"
@@ -746,3 +750,504 @@ uint64_t Process::GetMemoryUsage()
 
   return 0;
 }
+
+// Write tracking works by write-protecting the watched pages. The first write to each page faults,
+// and the fault handler flags the page as written and makes it writable again so the write can
+// proceed. Fetching the written pages protects them again. This is opt-in since system calls that
+// write into protected memory (e.g. read() into a mapped buffer) will fail instead of faulting.
+RDOC_CONFIG(bool, Linux_TrackMappedWrites, false,
+            "Track which pages of persistently mapped memory are written while capturing by "
+            "write-protecting them, instead of comparing the whole mapping each time. System calls "
+            "that write directly into the mapped memory will fail with EFAULT while capturing.");
+
+struct WatchedRegion
+{
+  enum
+  {
+    Free,
+    Active,
+    // no longer watched, but a fault raised just before it was unwatched might still be on its
+    // way to the handler so we keep recognising the pages for a short time.
+    Retired,
+  };
+
+  int32_t state;
+  uint64_t retiredTick;
+  byte *base;
+  size_t size;
+  byte *pageStart, *pageEnd;
+  // one bit per page, set when the page is written
+  int32_t *dirty;
+};
+
+static const int32_t MaxWatchedRegions = 1024;
+static WatchedRegion watchedRegions[MaxWatchedRegions] = {};
+// number of slots that have ever been used, so the handler doesn't check them all
+static int32_t numWatchSlots = 0;
+static int32_t runningHandlers = 0;
+static size_t watchPageSize = 0;
+static struct sigaction prevSegvAction = {};
+static bool segvHandlerInstalled = false;
+// set while a fault that isn't ours is passed on, in case the handler we chain to chains back to us
+static __thread int32_t chainingSegv = 0;
+// protects everything except the dirty bits and slot states, which the handler also accesses
+static Threading::CriticalSection watchLock;
+
+static int32_t AtomicLoad32(int32_t *i)
+{
+  return Atomic::CmpExch32(i, 0, 0);
+}
+
+static void AtomicOr32(int32_t *i, int32_t bits)
+{
+  int32_t prev = AtomicLoad32(i);
+  while(Atomic::CmpExch32(i, prev, prev | bits) != prev)
+    prev = AtomicLoad32(i);
+}
+
+static int32_t AtomicClear32(int32_t *i)
+{
+  int32_t prev = AtomicLoad32(i);
+  while(Atomic::CmpExch32(i, prev, 0) != prev)
+    prev = AtomicLoad32(i);
+  return prev;
+}
+
+static void SetPageDirty(WatchedRegion &region, byte *page)
+{
+  size_t idx = size_t(page - region.pageStart) / watchPageSize;
+  AtomicOr32(&region.dirty[idx / 32], int32_t(1U << (idx % 32)));
+}
+
+static void WaitForRunningHandlers()
+{
+  while(AtomicLoad32(&runningHandlers) != 0)
+    Threading::Sleep(0);
+}
+
+static void WriteWatchHandler(int sig, siginfo_t *info, void *context)
+{
+  // a retired region's pages are recognised for this long after being unwatched
+  const uint64_t retireTicks = uint64_t(Timing::GetTickFrequency() * 1000.0);
+
+  int savedErrno = errno;
+
+  Atomic::Inc32(&runningHandlers);
+
+  byte *addr = (byte *)info->si_addr;
+  byte *page = addr - (uintptr_t(addr) % watchPageSize);
+
+  bool handled = false;
+
+  if(info->si_code == SEGV_ACCERR)
+  {
+    const int32_t numSlots = AtomicLoad32(&numWatchSlots);
+    for(int32_t i = 0; i < numSlots; i++)
+    {
+      WatchedRegion &region = watchedRegions[i];
+
+      int32_t state = AtomicLoad32(&region.state);
+
+      if(state == WatchedRegion::Free || page < region.pageStart || page >= region.pageEnd)
+        continue;
+
+      if(state == WatchedRegion::Retired)
+      {
+        // the page has been made writable again, so retry the write
+        if(Timing::GetTick() - region.retiredTick < retireTicks)
+          handled = true;
+        continue;
+      }
+
+      // make the page writable before flagging it. Otherwise a fetch could see the flag and
+      // protect the page between us flagging it and unprotecting it, and later writes would be
+      // missed. Pages can be shared by neighbouring regions, so flag it in every region.
+      if(!handled)
+        mprotect(page, watchPageSize, PROT_READ | PROT_WRITE);
+      handled = true;
+
+      SetPageDirty(region, page);
+    }
+  }
+
+  Atomic::Dec32(&runningHandlers);
+
+  errno = savedErrno;
+
+  if(handled)
+    return;
+
+  // not our fault, pass it on. If the application installed its handler over ours and chains to
+  // whatever it replaced, we'll be called again from inside it, so fall back to the default then.
+  if(chainingSegv)
+  {
+    signal(SIGSEGV, SIG_DFL);
+    return;
+  }
+
+  chainingSegv = 1;
+
+  if(prevSegvAction.sa_flags & SA_SIGINFO)
+  {
+    prevSegvAction.sa_sigaction(sig, info, context);
+  }
+  else if(prevSegvAction.sa_handler == SIG_DFL || prevSegvAction.sa_handler == SIG_IGN)
+  {
+    // returning will re-raise the fault, which the default action will then handle. Ignoring a
+    // segfault would loop forever.
+    signal(SIGSEGV, SIG_DFL);
+  }
+  else
+  {
+    prevSegvAction.sa_handler(sig);
+  }
+
+  chainingSegv = 0;
+}
+
+// called with watchLock held whenever pages are protected, i.e. on watch and on every fetch. The
+// application could have installed its own handler over ours since the last time, in which case
+// it's chained to and ours goes back on top. A fault on a protected page in between would still
+// reach the application's handler, so pages are only protected once ours is installed again.
+static void InstallWriteWatchHandler()
+{
+  struct sigaction cur = {};
+  sigaction(SIGSEGV, NULL, &cur);
+
+  if((cur.sa_flags & SA_SIGINFO) && cur.sa_sigaction == &WriteWatchHandler)
+    return;
+
+  if(segvHandlerInstalled)
+    RDCLOG("SIGSEGV handler was replaced while watching for writes, chaining to the new handler");
+
+  segvHandlerInstalled = true;
+
+  prevSegvAction = cur;
+
+  struct sigaction action = {};
+  action.sa_sigaction = &WriteWatchHandler;
+  action.sa_flags = SA_SIGINFO | SA_ONSTACK | SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGSEGV, &action, NULL);
+}
+
+static WatchedRegion *FindWatchedRegion(void *base)
+{
+  for(int32_t i = 0; i < numWatchSlots; i++)
+  {
+    WatchedRegion &region = watchedRegions[i];
+    if(region.state == WatchedRegion::Active && region.base == base)
+      return &region;
+  }
+
+  return NULL;
+}
+
+static WatchedRegion *AllocWatchSlot()
+{
+  for(int32_t i = 0; i < numWatchSlots; i++)
+    if(watchedRegions[i].state == WatchedRegion::Free)
+      return &watchedRegions[i];
+
+  if(numWatchSlots < MaxWatchedRegions)
+  {
+    Atomic::Inc32(&numWatchSlots);
+    return &watchedRegions[numWatchSlots - 1];
+  }
+
+  // reuse the oldest retired slot
+  WatchedRegion *oldest = NULL;
+  for(int32_t i = 0; i < numWatchSlots; i++)
+    if(watchedRegions[i].state == WatchedRegion::Retired &&
+       (oldest == NULL || watchedRegions[i].retiredTick < oldest->retiredTick))
+      oldest = &watchedRegions[i];
+
+  if(oldest)
+  {
+    Atomic::CmpExch32(&oldest->state, WatchedRegion::Retired, WatchedRegion::Free);
+    WaitForRunningHandlers();
+  }
+
+  return oldest;
+}
+
+static void UnwatchRegion(WatchedRegion &region)
+{
+  // other regions sharing a page at either end lose their protection on it when we make it
+  // writable below, so treat it as written for them.
+  for(int32_t i = 0; i < numWatchSlots; i++)
+  {
+    WatchedRegion &other = watchedRegions[i];
+    if(&other == &region || other.state != WatchedRegion::Active)
+      continue;
+
+    byte *start = RDCMAX(region.pageStart, other.pageStart);
+    byte *end = RDCMIN(region.pageEnd, other.pageEnd);
+    for(byte *page = start; page < end; page += watchPageSize)
+      SetPageDirty(other, page);
+  }
+
+  mprotect(region.pageStart, region.pageEnd - region.pageStart, PROT_READ | PROT_WRITE);
+
+  region.retiredTick = Timing::GetTick();
+  Atomic::CmpExch32(&region.state, WatchedRegion::Active, WatchedRegion::Retired);
+
+  // once no handler can still be looking at the dirty bits we can free them
+  WaitForRunningHandlers();
+
+  delete[] region.dirty;
+  region.dirty = NULL;
+}
+
+static bool WatchRegion(void *base, size_t size)
+{
+  if(base == NULL || size == 0)
+    return false;
+
+  SCOPED_LOCK(watchLock);
+
+  if(watchPageSize == 0)
+    watchPageSize = (size_t)sysconf(_SC_PAGESIZE);
+
+  // watching again restarts tracking
+  WatchedRegion *existing = FindWatchedRegion(base);
+  if(existing)
+    UnwatchRegion(*existing);
+
+  WatchedRegion *region = AllocWatchSlot();
+  if(!region)
+  {
+    RDCWARN("Too many regions being watched for writes");
+    return false;
+  }
+
+  InstallWriteWatchHandler();
+
+  byte *start = (byte *)base;
+  region->base = start;
+  region->size = size;
+  region->pageStart = start - (uintptr_t(start) % watchPageSize);
+  region->pageEnd = AlignUpPtr(start + size, watchPageSize);
+
+  size_t numPages = size_t(region->pageEnd - region->pageStart) / watchPageSize;
+  region->dirty = new int32_t[(numPages + 31) / 32];
+  memset(region->dirty, 0, ((numPages + 31) / 32) * sizeof(int32_t));
+
+  Atomic::CmpExch32(&region->state, WatchedRegion::Free, WatchedRegion::Active);
+
+  if(mprotect(region->pageStart, region->pageEnd - region->pageStart, PROT_READ) != 0)
+  {
+    RDCWARN("Couldn't write-protect %p-%p: %d", region->pageStart, region->pageEnd, errno);
+    UnwatchRegion(*region);
+    return false;
+  }
+
+  return true;
+}
+
+static void UnwatchRegion(void *base)
+{
+  SCOPED_LOCK(watchLock);
+
+  WatchedRegion *region = FindWatchedRegion(base);
+  if(region)
+    UnwatchRegion(*region);
+}
+
+static bool FetchWrittenRegion(void *base, rdcarray<rdcpair<size_t, size_t>> &written)
+{
+  written.clear();
+
+  SCOPED_LOCK(watchLock);
+
+  WatchedRegion *region = FindWatchedRegion(base);
+  if(!region)
+    return false;
+
+  const size_t numPages = size_t(region->pageEnd - region->pageStart) / watchPageSize;
+
+  // gather runs of written pages, clearing the flags as we go
+  rdcarray<rdcpair<size_t, size_t>> &pages = written;
+  for(size_t w = 0; w < (numPages + 31) / 32; w++)
+  {
+    uint32_t bits = (uint32_t)AtomicClear32(&region->dirty[w]);
+
+    while(bits)
+    {
+      size_t page = w * 32 + __builtin_ctz(bits);
+      bits &= bits - 1;
+
+      if(!pages.empty() && pages.back().second == page)
+        pages.back().second++;
+      else
+        pages.push_back({page, page + 1});
+    }
+  }
+
+  // protect them again. Any write from here on is caught for the next fetch, so the caller should
+  // only read the memory after this.
+  InstallWriteWatchHandler();
+
+  for(rdcpair<size_t, size_t> &p : pages)
+    mprotect(region->pageStart + p.first * watchPageSize, (p.second - p.first) * watchPageSize,
+             PROT_READ);
+
+  // convert to offsets from base, clamped to the watched range
+  const size_t baseOffset = size_t(region->base - region->pageStart);
+  for(rdcpair<size_t, size_t> &p : pages)
+  {
+    p.first = RDCMAX(p.first * watchPageSize, baseOffset) - baseOffset;
+    p.second = RDCMIN(p.second * watchPageSize, baseOffset + region->size) - baseOffset;
+  }
+
+  return true;
+}
+
+bool WriteWatch::Watch(void *base, size_t size)
+{
+  if(!Linux_TrackMappedWrites())
+    return false;
+
+  return WatchRegion(base, size);
+}
+
+void WriteWatch::Unwatch(void *base)
+{
+  UnwatchRegion(base);
+}
+
+bool WriteWatch::FetchWritten(void *base, rdcarray<rdcpair<size_t, size_t>> &written)
+{
+  return FetchWrittenRegion(base, written);
+}
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+static int32_t testAppSegvCount = 0;
+
+static void TestAppSegvHandler(int sig, siginfo_t *info, void *context)
+{
+  testAppSegvCount++;
+}
+
+TEST_CASE("Test tracking writes to memory", "[writewatch]")
+{
+  const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+
+  byte *mem =
+      (byte *)mmap(NULL, pageSize * 4, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  REQUIRE(mem != MAP_FAILED);
+
+  typedef rdcarray<rdcpair<size_t, size_t>> RangeList;
+  RangeList written;
+
+  SECTION("Written pages are returned once")
+  {
+    // watch a range that doesn't start or end on a page boundary
+    byte *base = mem + 100;
+    REQUIRE(WatchRegion(base, pageSize * 4 - 200));
+
+    CHECK(FetchWrittenRegion(base, written));
+    CHECK(written.empty());
+
+    mem[pageSize + 5] = 1;
+    mem[pageSize * 3 + 5] = 1;
+    mem[pageSize * 3 + 6] = 1;
+
+    CHECK(FetchWrittenRegion(base, written));
+    CHECK((written == RangeList({{pageSize - 100, pageSize * 2 - 100},
+                                 {pageSize * 3 - 100, pageSize * 4 - 200}})));
+
+    CHECK(FetchWrittenRegion(base, written));
+    CHECK(written.empty());
+
+    // adjacent pages are merged
+    mem[0] = 1;
+    mem[pageSize] = 1;
+    mem[pageSize * 2] = 1;
+
+    CHECK(FetchWrittenRegion(base, written));
+    CHECK((written == RangeList({{0, pageSize * 3 - 100}})));
+
+    UnwatchRegion(base);
+
+    // unwatched memory is writable and no longer tracked
+    mem[pageSize * 2] = 2;
+    CHECK(!FetchWrittenRegion(base, written));
+    CHECK(mem[pageSize * 2] == 2);
+  };
+
+  SECTION("Regions sharing a page")
+  {
+    byte *a = mem;
+    byte *b = mem + pageSize + 16;
+
+    REQUIRE(WatchRegion(a, pageSize + 16));
+    REQUIRE(WatchRegion(b, pageSize - 16));
+
+    // a write to either region's half of the shared page counts for both
+    b[0] = 1;
+
+    CHECK(FetchWrittenRegion(a, written));
+    CHECK((written == RangeList({{pageSize, pageSize + 16}})));
+    CHECK(FetchWrittenRegion(b, written));
+    CHECK((written == RangeList({{0, pageSize - 16}})));
+
+    // removing one region unprotects the shared page, so the other must assume it's written
+    UnwatchRegion(a);
+
+    CHECK(FetchWrittenRegion(b, written));
+    CHECK((written == RangeList({{0, pageSize - 16}})));
+
+    // but it's protected again after that
+    b[1] = 1;
+    CHECK(FetchWrittenRegion(b, written));
+    CHECK((written == RangeList({{0, pageSize - 16}})));
+    CHECK(FetchWrittenRegion(b, written));
+    CHECK(written.empty());
+
+    UnwatchRegion(b);
+  };
+
+  SECTION("Application replaces the SIGSEGV handler")
+  {
+    REQUIRE(WatchRegion(mem, pageSize * 2));
+
+    const struct sigaction origPrevAction = prevSegvAction;
+
+    struct sigaction appAction = {}, ourAction = {};
+    appAction.sa_sigaction = &TestAppSegvHandler;
+    appAction.sa_flags = SA_SIGINFO;
+    sigemptyset(&appAction.sa_mask);
+    sigaction(SIGSEGV, &appAction, &ourAction);
+
+    CHECK(ourAction.sa_sigaction == &WriteWatchHandler);
+
+    // the next fetch puts our handler back on top, chaining to the application's
+    CHECK(FetchWrittenRegion(mem, written));
+    CHECK(written.empty());
+
+    struct sigaction cur = {};
+    sigaction(SIGSEGV, NULL, &cur);
+    CHECK(cur.sa_sigaction == &WriteWatchHandler);
+    CHECK(prevSegvAction.sa_sigaction == &TestAppSegvHandler);
+
+    // writes to protected pages are still ours and never reach the application
+    mem[pageSize + 1] = 1;
+
+    CHECK(testAppSegvCount == 0);
+    CHECK(FetchWrittenRegion(mem, written));
+    CHECK((written == RangeList({{pageSize, pageSize * 2}})));
+
+    UnwatchRegion(mem);
+
+    // leave the handler as we found it for any later tests
+    prevSegvAction = origPrevAction;
+  };
+
+  munmap(mem, pageSize * 4);
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
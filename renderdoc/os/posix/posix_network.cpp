@@ -42,6 +42,13 @@
 
 #include "posix_network.h"
 
+// a connection dropping while we send should fail the send, not raise SIGPIPE and kill the process
+#if defined(MSG_NOSIGNAL)
+static const int sendFlags = MSG_NOSIGNAL;
+#else
+static const int sendFlags = 0;
+#endif
+
 // because strerror_r is a complete mess...
 static rdcstr errno_string(int err)
 {
@@ -167,7 +174,7 @@ bool Socket::SendDataBlocking(const void *buf, uint32_t length)
 
   while(sent < length)
   {
-    ssize_t ret = send((int)socket, src, length - sent, 0);
+    ssize_t ret = send((int)socket, src, length - sent, sendFlags);
 
     if(ret <= 0)
     {
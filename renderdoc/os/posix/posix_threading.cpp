@@ -279,6 +279,12 @@ uint64_t GetCurrentID()
   return (uint64_t)pthread_self();
 }
 
+uint32_t GetNumberOfCores()
+{
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  return cores > 0 ? (uint32_t)cores : 1;
+}
+
 void JoinThread(ThreadHandle handle)
 {
   pthread_join((pthread_t)handle, NULL);
@@ -1745,3 +1745,17 @@ void Process::Shutdown()
 {
   // nothing to do
 }
+
+bool WriteWatch::Watch(void *base, size_t size)
+{
+  return false;
+}
+
+void WriteWatch::Unwatch(void *base)
+{
+}
+
+bool WriteWatch::FetchWritten(void *base, rdcarray<rdcpair<size_t, size_t>> &written)
+{
+  return false;
+}
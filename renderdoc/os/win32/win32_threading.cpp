@@ -329,6 +329,13 @@ uint64_t GetCurrentID()
   return (uint64_t)::GetCurrentThreadId();
 }
 
+uint32_t GetNumberOfCores()
+{
+  SYSTEM_INFO info = {};
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors > 0 ? (uint32_t)info.dwNumberOfProcessors : 1;
+}
+
 void JoinThread(ThreadHandle handle)
 {
   if(handle == 0)
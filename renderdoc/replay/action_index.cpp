@@ -0,0 +1,367 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "action_index.h"
+#include "common/common.h"
+
+const uint32_t ActionIndex::NoNode;
+
+static bool PreviousNextExcludedMarker(ActionDescription *action)
+{
+  return bool(action->flags & (ActionFlags::PushMarker | ActionFlags::PopMarker |
+                               ActionFlags::SetMarker | ActionFlags::MultiAction));
+}
+
+void ActionIndex::Build(rdcarray<ActionDescription> &rootActions)
+{
+  Clear();
+
+  ActionDescription *previous = NULL;
+  AddNodes(rootActions, NoNode, previous);
+
+  LinkMarkers();
+}
+
+void ActionIndex::Clear()
+{
+  m_Nodes.clear();
+  m_Events.clear();
+  m_LastActionNode = NoNode;
+}
+
+uint32_t ActionIndex::AddNodes(rdcarray<ActionDescription> &actions, uint32_t parent,
+                               ActionDescription *&previous)
+{
+  uint32_t first = NoNode;
+  uint32_t prevSibling = NoNode;
+
+  ActionDescription *parentAction = parent == NoNode ? NULL : m_Nodes[parent].action;
+
+  for(ActionDescription &action : actions)
+  {
+    RDCASSERTMSG("All actions must have their own event as the final event",
+                 !action.events.empty() && action.events.back().eventId == action.eventId);
+
+    // we also allow non-contiguous EIDs for fake markers that have high EIDs
+    RDCASSERT(m_LastActionNode == NoNode || action.eventId > m_Nodes[m_LastActionNode].eventId ||
+              m_Nodes[m_LastActionNode].action->IsFakeMarker());
+
+    const uint32_t idx = (uint32_t)m_Nodes.size();
+
+    Node node;
+    node.action = &action;
+    node.eventId = action.eventId;
+    node.flags = action.flags;
+    node.parent = parent;
+    node.firstChild = NoNode;
+    node.nextSibling = NoNode;
+    node.numChildren = (uint32_t)action.children.size();
+    m_Nodes.push_back(node);
+
+    if(prevSibling == NoNode)
+      first = idx;
+    else
+      m_Nodes[prevSibling].nextSibling = idx;
+    prevSibling = idx;
+
+    if(m_LastActionNode == NoNode || action.eventId > m_Nodes[m_LastActionNode].eventId)
+      m_LastActionNode = idx;
+
+    for(uint32_t e = 0; e < action.events.size(); e++)
+      GetEventSlot(action.events[e].eventId) = {idx, e};
+
+    // the action's own event should always be in its list, but make sure the action can be found
+    // even if it isn't
+    EventSlot &slot = GetEventSlot(action.eventId);
+    if(slot.node != idx)
+      slot = {idx, (uint32_t)action.events.size()};
+
+    action.parent = parentAction;
+
+    // only leaf actions that aren't markers form the previous/next chain. Markers are linked up to
+    // their neighbouring actions afterwards, in LinkMarkers
+    if(!action.children.empty())
+    {
+      // adding the children can reallocate m_Nodes, so don't look up this node until afterwards
+      const uint32_t firstChild = AddNodes(action.children, idx, previous);
+      m_Nodes[idx].firstChild = firstChild;
+    }
+    else if(!PreviousNextExcludedMarker(&action))
+    {
+      if(previous)
+        previous->next = &action;
+      action.previous = previous;
+
+      previous = &action;
+    }
+  }
+
+  return first;
+}
+
+ActionIndex::EventSlot &ActionIndex::GetEventSlot(uint32_t eventId)
+{
+  if(eventId >= m_Events.size())
+  {
+    // rdcarray grows geometrically so this doesn't reallocate for every new event
+    const size_t oldSize = m_Events.size();
+    m_Events.resize(eventId + 1);
+    for(size_t i = oldSize; i < m_Events.size(); i++)
+      m_Events[i] = {NoNode, 0};
+  }
+
+  return m_Events[eventId];
+}
+
+void ActionIndex::LinkMarkers()
+{
+  // markers don't enter the previous/next chain, but we still want pointers for them that point to
+  // the next or previous actual action (skipping any markers). This means that
+  // action->next->previous != action sometimes, but it's more useful than action->next being NULL
+  // in the middle of the list.
+  // This enables searching for a marker string and then being able to navigate from there and
+  // joining the 'real' linked list after one step.
+  //
+  // This walks in eventId order rather than tree order, since fake markers have eventIds after
+  // all the real events.
+
+  ActionDescription *previous = NULL;
+  rdcarray<ActionDescription *> markers;
+
+  for(uint32_t eid = 0; eid < m_Events.size(); eid++)
+  {
+    ActionDescription *action = GetAction(eid);
+    if(!action)
+      continue;
+
+    if(PreviousNextExcludedMarker(action))
+    {
+      // point the previous pointer to the last non-marker action we got. If we haven't hit one yet
+      // because this is near the start, this will just be NULL.
+      action->previous = previous;
+
+      // because there can be multiple markers consecutively we want to point all of their nexts to
+      // the next action we encounter. Accumulate this list, though in most cases it will only be 1
+      // long as it's uncommon to have multiple markers one after the other
+      markers.push_back(action);
+    }
+    else
+    {
+      // the next markers we encounter should point their previous to this.
+      previous = action;
+
+      // all previous markers point to this one
+      for(ActionDescription *m : markers)
+        m->next = action;
+
+      markers.clear();
+    }
+  }
+}
+
+ActionDescription *ActionIndex::GetAction(uint32_t eventId) const
+{
+  const uint32_t node = GetNodeIndex(eventId);
+  if(node == NoNode || m_Nodes[node].eventId != eventId)
+    return NULL;
+
+  return m_Nodes[node].action;
+}
+
+ActionDescription *ActionIndex::GetActionForEvent(uint32_t eventId) const
+{
+  const uint32_t node = GetNodeIndex(eventId);
+  if(node == NoNode)
+    return NULL;
+
+  return m_Nodes[node].action;
+}
+
+const APIEvent *ActionIndex::GetEvent(uint32_t eventId) const
+{
+  if(eventId >= m_Events.size())
+    return NULL;
+
+  const EventSlot &slot = m_Events[eventId];
+  if(slot.node == NoNode)
+    return NULL;
+
+  const rdcarray<APIEvent> &events = m_Nodes[slot.node].action->events;
+  if(slot.event >= events.size())
+    return NULL;
+
+  return &events[slot.event];
+}
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+TEST_CASE("Test action index", "[actionindex]")
+{
+  // 1: begin marker containing
+  //      2,3: draw
+  //      4: end marker
+  // 5,6,7: draw
+  // 8: set marker
+  // 9: draw
+  rdcarray<ActionDescription> actions;
+  actions.resize(4);
+
+  actions[0].eventId = 1;
+  actions[0].flags = ActionFlags::PushMarker;
+  actions[0].events.resize(1);
+  actions[0].events[0].eventId = 1;
+
+  actions[0].children.resize(2);
+  actions[0].children[0].eventId = 3;
+  actions[0].children[0].flags = ActionFlags::Drawcall;
+  actions[0].children[0].events.resize(2);
+  actions[0].children[0].events[0].eventId = 2;
+  actions[0].children[0].events[1].eventId = 3;
+  actions[0].children[1].eventId = 4;
+  actions[0].children[1].flags = ActionFlags::PopMarker;
+  actions[0].children[1].events.resize(1);
+  actions[0].children[1].events[0].eventId = 4;
+
+  actions[1].eventId = 7;
+  actions[1].flags = ActionFlags::Drawcall;
+  actions[1].events.resize(3);
+  actions[1].events[0].eventId = 5;
+  actions[1].events[1].eventId = 6;
+  actions[1].events[2].eventId = 7;
+  actions[1].events[1].chunkIndex = 42;
+
+  actions[2].eventId = 8;
+  actions[2].flags = ActionFlags::SetMarker;
+  actions[2].events.resize(1);
+  actions[2].events[0].eventId = 8;
+
+  actions[3].eventId = 9;
+  actions[3].flags = ActionFlags::Drawcall;
+  actions[3].events.resize(1);
+  actions[3].events[0].eventId = 9;
+
+  ActionIndex index;
+  CHECK(index.IsEmpty());
+  CHECK(index.GetAction(1) == NULL);
+  CHECK(index.GetEvent(1) == NULL);
+  CHECK(index.GetLastAction() == NULL);
+
+  index.Build(actions);
+
+  SECTION("Tree structure")
+  {
+    const rdcarray<ActionIndex::Node> &nodes = index.GetNodes();
+    REQUIRE(nodes.size() == 6);
+
+    CHECK(nodes[0].eventId == 1);
+    CHECK(nodes[0].parent == ActionIndex::NoNode);
+    CHECK(nodes[0].firstChild == 1);
+    CHECK(nodes[0].numChildren == 2);
+    CHECK(nodes[0].nextSibling == 3);
+
+    CHECK(nodes[1].eventId == 3);
+    CHECK(nodes[1].parent == 0);
+    CHECK(nodes[1].nextSibling == 2);
+    CHECK(nodes[1].firstChild == ActionIndex::NoNode);
+
+    CHECK(nodes[2].eventId == 4);
+    CHECK(nodes[2].parent == 0);
+    CHECK(nodes[2].nextSibling == ActionIndex::NoNode);
+
+    CHECK(nodes[3].eventId == 7);
+    CHECK(nodes[3].parent == ActionIndex::NoNode);
+    CHECK(nodes[3].nextSibling == 4);
+    CHECK(nodes[3].flags == ActionFlags::Drawcall);
+
+    CHECK(nodes[5].eventId == 9);
+    CHECK(nodes[5].nextSibling == ActionIndex::NoNode);
+
+    CHECK(index.GetLastAction() == &actions[3]);
+  };
+
+  SECTION("Action lookups")
+  {
+    CHECK(index.GetAction(0) == NULL);
+    CHECK(index.GetAction(1) == &actions[0]);
+    CHECK(index.GetAction(2) == NULL);
+    CHECK(index.GetAction(3) == &actions[0].children[0]);
+    CHECK(index.GetAction(4) == &actions[0].children[1]);
+    CHECK(index.GetAction(5) == NULL);
+    CHECK(index.GetAction(7) == &actions[1]);
+    CHECK(index.GetAction(10) == NULL);
+    CHECK(index.GetAction(~0U) == NULL);
+
+    CHECK(index.GetActionForEvent(2) == &actions[0].children[0]);
+    CHECK(index.GetActionForEvent(5) == &actions[1]);
+    CHECK(index.GetActionForEvent(6) == &actions[1]);
+    CHECK(index.GetActionForEvent(0) == NULL);
+  };
+
+  SECTION("Event lookups")
+  {
+    CHECK(index.GetEvent(0) == NULL);
+    CHECK(index.GetEvent(2) == &actions[0].children[0].events[0]);
+    CHECK(index.GetEvent(6) == &actions[1].events[1]);
+    CHECK(index.GetEvent(6)->chunkIndex == 42);
+    CHECK(index.GetEvent(7) == &actions[1].events[2]);
+    CHECK(index.GetEvent(100) == NULL);
+  };
+
+  SECTION("Action pointers")
+  {
+    CHECK(actions[0].parent == NULL);
+    CHECK(actions[0].children[0].parent == &actions[0]);
+    CHECK(actions[0].children[1].parent == &actions[0]);
+    CHECK(actions[1].parent == NULL);
+
+    // markers are skipped in the chain of actions
+    CHECK(actions[0].children[0].previous == NULL);
+    CHECK(actions[0].children[0].next == &actions[1]);
+    CHECK(actions[1].previous == &actions[0].children[0]);
+    CHECK(actions[1].next == &actions[3]);
+    CHECK(actions[3].previous == &actions[1]);
+    CHECK(actions[3].next == NULL);
+
+    // but point into it themselves
+    CHECK(actions[0].previous == NULL);
+    CHECK(actions[0].next == &actions[0].children[0]);
+    CHECK(actions[0].children[1].previous == &actions[0].children[0]);
+    CHECK(actions[0].children[1].next == &actions[1]);
+    CHECK(actions[2].previous == &actions[1]);
+    CHECK(actions[2].next == &actions[3]);
+  };
+
+  SECTION("Clear")
+  {
+    index.Clear();
+    CHECK(index.IsEmpty());
+    CHECK(index.GetAction(1) == NULL);
+    CHECK(index.GetEvent(6) == NULL);
+    CHECK(index.GetLastAction() == NULL);
+  };
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
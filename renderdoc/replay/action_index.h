@@ -0,0 +1,91 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include "api/replay/data_types.h"
+
+// A flattened store of an action tree, built once when the tree is finalised after loading. Every
+// action is recorded in a contiguous array of small nodes in depth-first order, with indices to its
+// parent, first child and next sibling, so the tree can be walked without touching the scattered
+// ActionDescriptions. A single table indexed by eventId gives the node that owns each event and the
+// event's slot in that action, so looking up an action or event is two array reads.
+//
+// The nested rdcarray<ActionDescription> is still what the public API returns, so it remains the
+// storage and the nodes point into it. Building the index also sets the parent/previous/next
+// pointers in the tree, so those stay valid for anything that walks it directly. The index must be
+// rebuilt whenever the tree is modified or reallocated.
+class ActionIndex
+{
+public:
+  static const uint32_t NoNode = ~0U;
+
+  struct Node
+  {
+    ActionDescription *action;
+    uint32_t eventId;
+    ActionFlags flags;
+    uint32_t parent;
+    uint32_t firstChild;
+    uint32_t nextSibling;
+    uint32_t numChildren;
+  };
+
+  void Build(rdcarray<ActionDescription> &rootActions);
+  void Clear();
+  bool IsEmpty() const { return m_Nodes.empty(); }
+  // the action with exactly this eventId, or NULL if eventId isn't an action
+  ActionDescription *GetAction(uint32_t eventId) const;
+  // the action that this eventId is part of, i.e. the action that has it in its events list
+  ActionDescription *GetActionForEvent(uint32_t eventId) const;
+  // the event with this eventId, or NULL if there's no such event
+  const APIEvent *GetEvent(uint32_t eventId) const;
+  // the action with the highest eventId, or NULL if the index is empty
+  ActionDescription *GetLastAction() const
+  {
+    return m_LastActionNode == NoNode ? NULL : m_Nodes[m_LastActionNode].action;
+  }
+  // nodes in depth-first order. The root actions are node 0 and its chain of siblings.
+  const rdcarray<Node> &GetNodes() const { return m_Nodes; }
+  uint32_t GetNodeIndex(uint32_t eventId) const
+  {
+    return eventId < m_Events.size() ? m_Events[eventId].node : NoNode;
+  }
+
+private:
+  struct EventSlot
+  {
+    uint32_t node;
+    uint32_t event;
+  };
+
+  uint32_t AddNodes(rdcarray<ActionDescription> &actions, uint32_t parent,
+                    ActionDescription *&previous);
+  EventSlot &GetEventSlot(uint32_t eventId);
+  void LinkMarkers();
+
+  rdcarray<Node> m_Nodes;
+  rdcarray<EventSlot> m_Events;
+  uint32_t m_LastActionNode = NoNode;
+};
@@ -28,6 +28,7 @@
 
 #include "api/replay/rdcarray.h"
 #include "api/replay/rdcflatmap.h"
+#include "api/replay/rdchashmap.h"
 #include "api/replay/rdcpair.h"
 #include "api/replay/rdcstr.h"
 #include "api/replay/resourceid.h"
@@ -38,6 +39,9 @@
 
 #include "catch/catch.hpp"
 
+#include <map>
+#include <unordered_map>
+
 static int32_t constructor = 0;
 static int32_t moveConstructor = 0;
 static int32_t valueConstructor = 0;
@@ -2293,6 +2297,272 @@ TEST_CASE("Test flatmap type", "[basictypes][flatmap]")
   };
 };
 
+TEST_CASE("Test hashmap type", "[basictypes][hashmap]")
+{
+  SECTION("basic lookup of values")
+  {
+    rdchashmap<uint32_t, rdcstr> test;
+
+    CHECK(test.empty());
+    CHECK((test.find(5) == test.end()));
+    CHECK((test.begin() == test.end()));
+
+    test[5] = "foo";
+    test[7] = "bar";
+    test[3] = "asdf";
+
+    CHECK(test[5] == "foo");
+    CHECK(test[7] == "bar");
+    CHECK(test[3] == "asdf");
+    CHECK(!test.empty());
+    CHECK(test.size() == 3);
+
+    // order is not guaranteed, but multiplying the keys in any order will give us a unique value
+    // because they're prime
+    uint32_t product = 1;
+    uint32_t count = 0;
+    for(auto it = test.begin(); it != test.end(); ++it)
+    {
+      product *= it->first;
+      count++;
+    }
+
+    CHECK(product == 3 * 5 * 7);
+    CHECK(count == 3);
+
+    CHECK(test.find(5)->second == "foo");
+    CHECK((test.find(6) == test.end()));
+    CHECK(test.find(7)->second == "bar");
+    CHECK((test.find(8) == test.end()));
+
+    // inserting an existing key doesn't overwrite it
+    auto res = test.insert({7, "baz"});
+    CHECK_FALSE(res.second);
+    CHECK(res.first->second == "bar");
+
+    res = test.insert({11, "baz"});
+    CHECK(res.second);
+    CHECK(res.first->first == 11);
+    CHECK(res.first->second == "baz");
+    CHECK(test.size() == 4);
+
+    test.erase(5);
+    test.erase(test.find(11));
+    test.erase(999);
+
+    CHECK(test.size() == 2);
+    CHECK((test.find(5) == test.end()));
+    CHECK((test.find(11) == test.end()));
+    CHECK(test[7] == "bar");
+    CHECK(test[3] == "asdf");
+
+    test.clear();
+
+    CHECK(test.empty());
+    CHECK(test.size() == 0);
+    CHECK((test.begin() == test.end()));
+
+    // this inserts the values as default-initialised, as std::map does
+    CHECK(test[5] == "");
+    CHECK(test.size() == 1);
+  };
+
+  SECTION("copy, move and swap")
+  {
+    rdchashmap<uint32_t, rdcstr> test;
+
+    test[5] = "foo";
+    test[7] = "bar";
+    test[3] = "asdf";
+
+    rdchashmap<uint32_t, rdcstr> copied = test;
+
+    CHECK(copied.size() == 3);
+    CHECK(copied[5] == "foo");
+    CHECK(copied[7] == "bar");
+    CHECK(copied[3] == "asdf");
+
+    rdchashmap<uint32_t, rdcstr> swapped;
+    test.swap(swapped);
+
+    CHECK(test.empty());
+    CHECK(swapped.size() == 3);
+    CHECK(swapped[5] == "foo");
+
+    rdchashmap<uint32_t, rdcstr> moved = std::move(swapped);
+
+    CHECK(moved.size() == 3);
+    CHECK(moved[7] == "bar");
+  };
+
+  SECTION("ResourceId keys against std::unordered_map")
+  {
+    rdchashmap<ResourceId, uint32_t> test;
+    std::unordered_map<ResourceId, uint32_t> ref;
+
+    rdcarray<ResourceId> ids;
+    for(uint32_t i = 0; i < 5000; i++)
+      ids.push_back(ResourceIDGen::GetNewUniqueID());
+
+    uint32_t state = 12345;
+    for(uint32_t i = 0; i < 50000; i++)
+    {
+      state = state * 1664525U + 1013904223U;
+      ResourceId id = ids[(state >> 8) % ids.size()];
+
+      // mostly insert, with enough erases to exercise the backward shift
+      if((state >> 28) < 5)
+      {
+        test.erase(id);
+        ref.erase(id);
+      }
+      else
+      {
+        test[id] = i;
+        ref[id] = i;
+      }
+    }
+
+    CHECK(test.size() == ref.size());
+
+    for(ResourceId id : ids)
+    {
+      auto it = test.find(id);
+      auto refit = ref.find(id);
+
+      bool found = (it != test.end());
+      bool refFound = (refit != ref.end());
+      CHECK(found == refFound);
+      if(found && refFound)
+        CHECK(it->second == refit->second);
+    }
+
+    size_t count = 0;
+    for(auto it = test.begin(); it != test.end(); ++it)
+    {
+      CHECK(ref[it->first] == it->second);
+      count++;
+    }
+    CHECK(count == ref.size());
+  };
+};
+
+TEST_CASE("Test densemap type", "[basictypes][densemap]")
+{
+  rdcdensemap<uint64_t, rdcstr> test;
+
+  CHECK(test.empty());
+  CHECK((test.find(5) == test.end()));
+
+  test[1000] = "a";
+  test[1002] = "b";
+  test[1005] = "c";
+
+  CHECK(test.size() == 3);
+  CHECK(test[1000] == "a");
+  CHECK(test[1002] == "b");
+  CHECK(test[1005] == "c");
+  CHECK((test.find(1001) == test.end()));
+  CHECK((test.find(999) == test.end()));
+  CHECK((test.find(2000) == test.end()));
+
+  // keys below the first are handled
+  test[995] = "d";
+
+  CHECK(test.size() == 4);
+  CHECK(test[995] == "d");
+  CHECK(test[1000] == "a");
+  CHECK(test.find(1005)->second == "c");
+
+  // iteration is in key order
+  rdcarray<uint64_t> keys;
+  for(auto it = test.begin(); it != test.end(); ++it)
+    keys.push_back(it->first);
+
+  CHECK(keys == rdcarray<uint64_t>({995, 1000, 1002, 1005}));
+
+  auto res = test.insert({1002, "x"});
+  CHECK_FALSE(res.second);
+  CHECK(res.first->second == "b");
+
+  test.erase(1000);
+  test.erase(test.find(1005));
+
+  CHECK(test.size() == 2);
+  CHECK((test.find(1000) == test.end()));
+  CHECK((test.find(1005) == test.end()));
+
+  keys.clear();
+  for(auto it = test.begin(); it != test.end(); ++it)
+    keys.push_back(it->first);
+
+  CHECK(keys == rdcarray<uint64_t>({995, 1002}));
+
+  test.clear();
+  CHECK(test.empty());
+  CHECK((test.begin() == test.end()));
+};
+
+template <typename MapType>
+static void BenchmarkResourceIdMap(const char *name, MapType &map, const rdcarray<ResourceId> &ids,
+                                   const rdcarray<ResourceId> &lookups)
+{
+  PerformanceTimer timer;
+
+  for(size_t i = 0; i < ids.size(); i++)
+    map[ids[i]] = uint32_t(i);
+
+  double insertMS = timer.GetMilliseconds();
+  timer.Restart();
+
+  uint64_t sum = 0;
+  for(ResourceId id : lookups)
+    sum += map.find(id)->second;
+
+  double findMS = timer.GetMilliseconds();
+  timer.Restart();
+
+  for(auto it = map.begin(); it != map.end(); ++it)
+    sum += it->second;
+
+  double iterMS = timer.GetMilliseconds();
+
+  RDCLOG("%s: insert %.2f ms, lookup %.2f ms, iterate %.2f ms (%llu)", name, insertMS, findMS,
+         iterMS, sum);
+}
+
+TEST_CASE("Benchmark ResourceId map types", "[basictypes][.benchmark]")
+{
+  const size_t count = 200000;
+
+  // allocate IDs the way resources get them, with a few gaps for IDs used by other objects
+  rdcarray<ResourceId> ids;
+  for(uint32_t n = 0; ids.size() < count; n++)
+  {
+    ResourceId id = ResourceIDGen::GetNewUniqueID();
+    if(n % 5 != 4)
+      ids.push_back(id);
+  }
+
+  rdcarray<ResourceId> lookups = ids;
+  uint32_t state = 1;
+  for(size_t i = lookups.size() - 1; i > 0; i--)
+  {
+    state = state * 1664525U + 1013904223U;
+    std::swap(lookups[i], lookups[(state >> 8) % (i + 1)]);
+  }
+
+  std::map<ResourceId, uint32_t> stdmap;
+  std::unordered_map<ResourceId, uint32_t> stdunordered;
+  rdchashmap<ResourceId, uint32_t> hashmap;
+  rdcdensemap<ResourceId, uint32_t> densemap;
+
+  BenchmarkResourceIdMap("std::map", stdmap, ids, lookups);
+  BenchmarkResourceIdMap("std::unordered_map", stdunordered, ids, lookups);
+  BenchmarkResourceIdMap("rdchashmap", hashmap, ids, lookups);
+  BenchmarkResourceIdMap("rdcdensemap", densemap, ids, lookups);
+};
+
 union foo
 {
   rdcfixedarray<float, 16> f32v;
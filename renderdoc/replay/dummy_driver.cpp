@@ -309,6 +309,11 @@ rdcarray<GPUDevice> DummyDriver::GetAvailableGPUs()
   return m_GPUs;
 }
 
+ReplayMemoryStats DummyDriver::GetReplayMemoryStats()
+{
+  return {};
+}
+
 bool DummyDriver::IsRemoteProxy()
 {
   return m_Proxy;
@@ -120,6 +120,7 @@ public:
   DriverInformation GetDriverInfo();
 
   rdcarray<GPUDevice> GetAvailableGPUs();
+  ReplayMemoryStats GetReplayMemoryStats();
 
   // IReplayDriver
   bool IsRemoteProxy();
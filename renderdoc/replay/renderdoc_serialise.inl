@@ -947,6 +947,38 @@ void DoSerialise(SerialiserType &ser, GPUDevice &el)
   SIZE_CHECK(80);
 }
 
+template <typename SerialiserType>
+void DoSerialise(SerialiserType &ser, ReplayMemoryStats &el)
+{
+  SERIALISE_MEMBER(blockCount);
+  SERIALISE_MEMBER(allocationCount);
+  SERIALISE_MEMBER(blockBytes);
+  SERIALISE_MEMBER(allocatedBytes);
+  SERIALISE_MEMBER(spilledBytes);
+  SERIALISE_MEMBER(deviceLocalBudget);
+  SERIALISE_MEMBER(deviceLocalUsage);
+
+  SIZE_CHECK(48);
+}
+
+template <typename SerialiserType>
+void DoSerialise(SerialiserType &ser, RemoteServerStats &el)
+{
+  SERIALISE_MEMBER(session);
+  SERIALISE_MEMBER(activeClients);
+  SERIALISE_MEMBER(maxClients);
+  SERIALISE_MEMBER(openReplays);
+  SERIALISE_MEMBER(maxReplays);
+  SERIALISE_MEMBER(replayRequests);
+  SERIALISE_MEMBER(replayTime);
+  SERIALISE_MEMBER(waitTime);
+  SERIALISE_MEMBER(storageUsed);
+  SERIALISE_MEMBER(storageLimit);
+  SERIALISE_MEMBER(replayTimeLimit);
+
+  SIZE_CHECK(72);
+}
+
 template <typename SerialiserType>
 void DoSerialise(SerialiserType &ser, ReplayOptions &el)
 {
@@ -2415,6 +2447,8 @@ INSTANTIATE_SERIALISE_TYPE(EventUsage)
 INSTANTIATE_SERIALISE_TYPE(CounterResult)
 INSTANTIATE_SERIALISE_TYPE(CounterValue)
 INSTANTIATE_SERIALISE_TYPE(GPUDevice)
+INSTANTIATE_SERIALISE_TYPE(ReplayMemoryStats)
+INSTANTIATE_SERIALISE_TYPE(RemoteServerStats)
 INSTANTIATE_SERIALISE_TYPE(ReplayOptions)
 INSTANTIATE_SERIALISE_TYPE(D3D11Pipe::Layout)
 INSTANTIATE_SERIALISE_TYPE(D3D11Pipe::InputAssembly)
@@ -2439,7 +2473,9 @@ INSTANTIATE_SERIALISE_TYPE(D3D12Pipe::State)
 INSTANTIATE_SERIALISE_TYPE(GLPipe::VertexAttribute)
 INSTANTIATE_SERIALISE_TYPE(GLPipe::VertexInput)
 INSTANTIATE_SERIALISE_TYPE(GLPipe::Shader)
+INSTANTIATE_SERIALISE_TYPE(GLPipe::Texture)
 INSTANTIATE_SERIALISE_TYPE(GLPipe::Sampler)
+INSTANTIATE_SERIALISE_TYPE(GLPipe::Buffer)
 INSTANTIATE_SERIALISE_TYPE(GLPipe::ImageLoadStore)
 INSTANTIATE_SERIALISE_TYPE(GLPipe::Rasterizer)
 INSTANTIATE_SERIALISE_TYPE(GLPipe::DepthState)
@@ -27,24 +27,107 @@
 #include <string.h>
 #include <time.h>
 #include "common/dds_readwrite.h"
+#include "common/image_writers.h"
+#include "core/settings.h"
 #include "driver/ihv/amd/amd_isa.h"
 #include "driver/ihv/amd/amd_rgp.h"
 #include "jpeg-compressor/jpgd.h"
-#include "jpeg-compressor/jpge.h"
+#include "maths/blockdecode.h"
 #include "maths/formatpacking.h"
 #include "os/os_specific.h"
 #include "serialise/rdcfile.h"
 #include "serialise/serialiser.h"
 #include "stb/stb_image.h"
 #include "stb/stb_image_write.h"
+#include "strings/string_intern.h"
 #include "strings/string_utils.h"
-#include "tinyexr/tinyexr.h"
+
+RDOC_CONFIG(bool, Replay_CPUBlockDecode, true,
+            "Decode block-compressed textures on the CPU when saving them, instead of remapping "
+            "them on the GPU.");
 
 static void fileWriteFunc(void *context, void *data, int size)
 {
   FileIO::fwrite(data, 1, size, (FILE *)context);
 }
 
+// lay out slices of RGBA data in a gridWidth x gridHeight grid, replacing them with the combined
+// image. cellSlices gives the slice for each cell in row-major order, cells with no slice are left
+// black.
+static void ComposeSliceGrid(TextureDescription &td, rdcarray<byte *> &subdata, uint32_t gridWidth,
+                             uint32_t gridHeight, const uint32_t *cellSlices)
+{
+  const uint32_t sliceHeight = td.height;
+  const size_t pixelStride = td.format.compCount * td.format.compByteWidth;
+  const size_t sliceRowSize = td.width * pixelStride;
+
+  td.width *= gridWidth;
+  td.height *= gridHeight;
+
+  const size_t rowSize = td.width * pixelStride;
+
+  byte *combinedData = new byte[rowSize * td.height];
+
+  process_image_rows(td.height, rowSize, [&](uint32_t y) {
+    const size_t srcOffset = (y % sliceHeight) * sliceRowSize;
+    const uint32_t *rowCells = cellSlices + (y / sliceHeight) * gridWidth;
+
+    byte *dst = combinedData + rowSize * y;
+
+    for(uint32_t gridx = 0; gridx < gridWidth; gridx++)
+    {
+      if(rowCells[gridx] < subdata.size())
+        memcpy(dst, subdata[rowCells[gridx]] + srcOffset, sliceRowSize);
+      else
+        memset(dst, 0, sliceRowSize);
+
+      dst += sliceRowSize;
+    }
+  });
+
+  for(size_t i = 0; i < subdata.size(); i++)
+    delete[] subdata[i];
+
+  subdata.resize(1);
+  subdata[0] = combinedData;
+}
+
+// decode a raw block-compressed subresource in place to tightly packed RGBA8 or RGBA32F, one depth
+// slice at a time.
+static bool DecodeSubresourceBlocks(const ResourceFormat &fmt, uint32_t width, uint32_t height,
+                                    uint32_t depth, bool floatOutput, bool flipY, bytebuf &data)
+{
+  const size_t srcSliceSize = GetBlockFormatSliceSize(fmt, width, height);
+  const size_t dstRowPitch = size_t(width) * (floatOutput ? sizeof(float) * 4 : 4);
+  const size_t dstSliceSize = dstRowPitch * height;
+
+  if(data.size() < srcSliceSize * depth)
+    return false;
+
+  bytebuf decoded;
+  decoded.resize(dstSliceSize * depth);
+
+  for(uint32_t z = 0; z < depth; z++)
+  {
+    byte *dst = decoded.data() + dstSliceSize * z;
+
+    if(!DecodeBlockFormat(fmt, width, height, data.data() + srcSliceSize * z, srcSliceSize, dst,
+                          floatOutput))
+      return false;
+
+    // compressed data can't be flipped for saving to disk the way remapped data is, so do it now
+    if(flipY)
+    {
+      for(uint32_t y = 0; y < height / 2; y++)
+        std::swap_ranges(dst + y * dstRowPitch, dst + (y + 1) * dstRowPitch,
+                         dst + (height - 1 - y) * dstRowPitch);
+    }
+  }
+
+  data.swap(decoded);
+  return true;
+}
+
 ReplayController::ReplayController()
 {
   m_ThreadID = Threading::GetCurrentID();
@@ -174,14 +257,47 @@ const SDFile &ReplayController::GetStructuredFile()
   return *m_pDevice->GetStructuredFile();
 }
 
-ActionDescription *ReplayController::GetActionByEID(uint32_t eventId)
+const StructuredIndex &ReplayController::GetStructuredIndex()
+{
+  if(!m_StructuredIndex.IsBuilt())
+    m_StructuredIndex.Build(*m_pDevice->GetStructuredFile(), m_FrameRecord.actionList);
+
+  return m_StructuredIndex;
+}
+
+rdcarray<uint32_t> ReplayController::FindEventsReferencingResource(ResourceId id)
 {
   CHECK_REPLAY_THREAD();
 
-  if(eventId >= m_Actions.size())
-    return NULL;
+  return GetStructuredIndex().FindResource(id);
+}
+
+rdcarray<uint32_t> ReplayController::FindEventsByName(const rdcstr &name)
+{
+  CHECK_REPLAY_THREAD();
+
+  return GetStructuredIndex().FindChunkName(name);
+}
+
+rdcarray<uint32_t> ReplayController::FindEventsWithParameter(const rdcstr &name)
+{
+  CHECK_REPLAY_THREAD();
+
+  return GetStructuredIndex().FindParameter(name);
+}
+
+rdcarray<uint32_t> ReplayController::FindEventsWithString(const rdcstr &text, bool exactMatch)
+{
+  CHECK_REPLAY_THREAD();
+
+  return GetStructuredIndex().FindString(text, exactMatch);
+}
+
+ActionDescription *ReplayController::GetActionByEID(uint32_t eventId)
+{
+  CHECK_REPLAY_THREAD();
 
-  return m_Actions[eventId];
+  return m_ActionIndex.GetAction(eventId);
 }
 
 const rdcarray<ActionDescription> &ReplayController::GetRootActions()
@@ -291,6 +407,9 @@ void ReplayController::AddFakeMarkers()
   if(ContainsMarker(actions))
     return;
 
+  // the action tree is about to change, so the index will need to be rebuilt
+  m_StructuredIndex.Clear();
+
   uint32_t newEventId = actions.back().events.back().eventId + 1;
   uint32_t newActionId = actions.back().actionId + 1;
 
@@ -406,9 +525,8 @@ void ReplayController::AddFakeMarkers()
 
   m_FrameRecord.actionList = ret;
 
-  // re-configure the previous/next pointeres
-  m_Actions.clear();
-  SetupActionPointers(m_Actions, m_FrameRecord.actionList);
+  // the tree has been rebuilt, so re-index it and re-configure the previous/next pointers
+  m_ActionIndex.Build(m_FrameRecord.actionList);
 }
 
 rdcarray<CounterResult> ReplayController::FetchCounters(const rdcarray<GPUCounter> &counters)
@@ -464,6 +582,13 @@ rdcarray<DebugMessage> ReplayController::GetDebugMessages()
   return m_pDevice->GetDebugMessages();
 }
 
+ReplayMemoryStats ReplayController::GetReplayMemoryStats()
+{
+  CHECK_REPLAY_THREAD();
+
+  return m_pDevice->GetReplayMemoryStats();
+}
+
 rdcarray<ShaderEntryPoint> ReplayController::GetShaderEntryPoints(ResourceId shader)
 {
   CHECK_REPLAY_THREAD();
@@ -479,16 +604,66 @@ const ShaderReflection *ReplayController::GetShader(ResourceId pipeline, Resourc
   return m_pDevice->GetShader(m_pDevice->GetLiveID(pipeline), m_pDevice->GetLiveID(shader), entry);
 }
 
+const UsageIndex &ReplayController::GetUsageIndex()
+{
+  if(!m_UsageIndex.IsBuilt())
+  {
+    rdcarray<ResourceId> resources;
+    resources.reserve(m_Textures.size() + m_Buffers.size());
+    for(const TextureDescription &tex : m_Textures)
+      resources.push_back(tex.resourceId);
+    for(const BufferDescription &buf : m_Buffers)
+      resources.push_back(buf.resourceId);
+
+    // fetch everything at once, so that remote replay doesn't pay a round trip per resource
+    rdcarray<rdcarray<EventUsage>> usages = m_pDevice->GetUsages(resources);
+
+    std::map<ResourceId, size_t> indices;
+    for(size_t i = 0; i < resources.size(); i++)
+      indices[resources[i]] = i;
+
+    m_UsageIndex.Build(resources, [&](ResourceId id) { return usages[indices[id]]; });
+  }
+
+  return m_UsageIndex;
+}
+
 rdcarray<EventUsage> ReplayController::GetUsage(ResourceId id)
 {
   CHECK_REPLAY_THREAD();
 
+  const UsageIndex &index = GetUsageIndex();
+  if(index.Contains(id))
+    return index.GetUsage(id);
+
   id = m_pDevice->GetLiveID(id);
   if(id == ResourceId())
     return rdcarray<EventUsage>();
   return m_pDevice->GetUsage(id);
 }
 
+rdcarray<EventUsage> ReplayController::GetUsageInRange(ResourceId id, uint32_t firstEventId,
+                                                       uint32_t lastEventId)
+{
+  CHECK_REPLAY_THREAD();
+
+  return GetUsageIndex().GetUsageInRange(id, firstEventId, lastEventId);
+}
+
+EventUsage ReplayController::GetFirstWriteAfter(ResourceId id, uint32_t eventId)
+{
+  CHECK_REPLAY_THREAD();
+
+  return GetUsageIndex().GetFirstWriteAfter(id, eventId);
+}
+
+rdcarray<ResourceId> ReplayController::GetResourcesUsedByEvent(uint32_t eventId)
+{
+  CHECK_REPLAY_THREAD();
+
+  return GetUsageIndex().GetResourcesUsedByEvent(eventId);
+}
+
 MeshFormat ReplayController::GetPostVSData(uint32_t instID, uint32_t viewID, MeshDataStage stage)
 {
   CHECK_REPLAY_THREAD();
@@ -751,6 +926,8 @@ ResultDetails ReplayController::SaveTexture(const TextureSave &saveData, const r
      td.format.type != ResourceFormatType::R11G11B10)
     downcast = true;
 
+  const ResourceFormat sourceFormat = td.format;
+
   // if we're downcasting, pick either RGBA8 or RGBA32 to downcast to
   RemapTexture remap = RemapTexture::NoRemap;
 
@@ -788,6 +965,15 @@ ResultDetails ReplayController::SaveTexture(const TextureSave &saveData, const r
     }
   }
 
+  // block-compressed data that can be decoded on the CPU is fetched raw and decoded here instead of
+  // being remapped on the GPU. That works even if the replay device can't sample the format, and
+  // sends much less data when replaying remotely. Anything that needs the GPU's display pipeline
+  // (type casts or a remapped range) still goes through the remap.
+  const bool cpuBlockDecode = remap != RemapTexture::NoRemap && Replay_CPUBlockDecode() &&
+                              IsBlockFormatDecodeSupported(sourceFormat) &&
+                              sd.typeCast == CompType::Typeless && sd.comp.blackPoint == 0.0f &&
+                              sd.comp.whitePoint == 1.0f;
+
   uint32_t rowPitch = 0;
   uint32_t slicePitch = 0;
 
@@ -864,8 +1050,29 @@ ResultDetails ReplayController::SaveTexture(const TextureSave &saveData, const r
       Subresource sub = {mip, slice / sampleCount, slice % sampleCount};
 
       bytebuf data;
-      m_pDevice->GetTextureData(liveid, sub, params, data);
-      FatalErrorCheck();
+
+      if(cpuBlockDecode)
+      {
+        params.remap = RemapTexture::NoRemap;
+        m_pDevice->GetTextureData(liveid, sub, params, data);
+        FatalErrorCheck();
+
+        if(!DecodeSubresourceBlocks(sourceFormat, RDCMAX(1U, td.width >> m),
+                                    RDCMAX(1U, td.height >> m), RDCMAX(1U, td.depth >> m),
+                                    remap == RemapTexture::RGBA32,
+                                    m_APIProps.pipelineType == GraphicsAPI::OpenGL, data))
+        {
+          // fall back to the GPU if the raw data wasn't what we expected
+          params.remap = remap;
+          data.clear();
+        }
+      }
+
+      if(data.empty())
+      {
+        m_pDevice->GetTextureData(liveid, sub, params, data);
+        FatalErrorCheck();
+      }
 
       if(data.empty())
       {
@@ -936,66 +1143,23 @@ ResultDetails ReplayController::SaveTexture(const TextureSave &saveData, const r
   if(sd.slice.slicesAsGrid && (td.format.compByteWidth == 1 || td.format.compByteWidth == 4) &&
      td.format.compCount == 4 && !td.format.Special())
   {
-    uint32_t sliceWidth = td.width;
-    uint32_t sliceHeight = td.height;
-
     uint32_t sliceGridHeight = (td.arraysize * td.depth) / sd.slice.sliceGridWidth;
     if((td.arraysize * td.depth) % sd.slice.sliceGridWidth != 0)
       sliceGridHeight++;
 
-    td.width *= sd.slice.sliceGridWidth;
-    td.height *= sliceGridHeight;
-
-    uint32_t pixelStride = td.format.compCount * td.format.compByteWidth;
-
-    byte *combinedData = new byte[td.width * td.height * pixelStride];
-
-    memset(combinedData, 0, td.width * td.height * pixelStride);
-
-    for(size_t i = 0; i < subdata.size(); i++)
-    {
-      uint32_t gridx = (uint32_t)i % sd.slice.sliceGridWidth;
-      uint32_t gridy = (uint32_t)i / sd.slice.sliceGridWidth;
-
-      uint32_t yoffs = gridy * sliceHeight;
-      uint32_t xoffs = gridx * sliceWidth;
-
-      for(uint32_t y = 0; y < sliceHeight; y++)
-      {
-        for(uint32_t x = 0; x < sliceWidth; x++)
-        {
-          uint32_t *srcpix = (uint32_t *)&subdata[i][(y * sliceWidth + x) * pixelStride + 0];
-          uint32_t *dstpix =
-              (uint32_t *)&combinedData[((y + yoffs) * td.width + x + xoffs) * pixelStride + 0];
-
-          memcpy(dstpix, srcpix, pixelStride);
-        }
-      }
-
-      delete[] subdata[i];
-    }
+    rdcarray<uint32_t> cellSlices;
+    cellSlices.resize(sd.slice.sliceGridWidth * sliceGridHeight);
+    for(uint32_t i = 0; i < cellSlices.size(); i++)
+      cellSlices[i] = i;
 
-    subdata.resize(1);
-    subdata[0] = combinedData;
-    rowPitch = td.width * 4;
+    ComposeSliceGrid(td, subdata, sd.slice.sliceGridWidth, sliceGridHeight, cellSlices.data());
+    rowPitch = td.width * td.format.compCount * td.format.compByteWidth;
   }
 
   // should have been handled above, but verify incoming data is RGBA8 or RGBA32 and 6 slices
   if(sd.slice.cubeCruciform && (td.format.compByteWidth == 1 || td.format.compByteWidth == 4) &&
      td.format.compCount == 4 && !td.format.Special() && subdata.size() == 6)
   {
-    uint32_t sliceWidth = td.width;
-    uint32_t sliceHeight = td.height;
-
-    td.width *= 4;
-    td.height *= 3;
-
-    uint32_t pixelStride = td.format.compCount * td.format.compByteWidth;
-
-    byte *combinedData = new byte[td.width * td.height * pixelStride];
-
-    memset(combinedData, 0, td.width * td.height * pixelStride);
-
     /*
      Y X=0   1   2   3
      =     +---+
@@ -1011,32 +1175,14 @@ ResultDetails ReplayController::SaveTexture(const TextureSave &saveData, const r
 
     */
 
-    uint32_t gridx[6] = {2, 0, 1, 1, 1, 3};
-    uint32_t gridy[6] = {1, 1, 0, 2, 1, 1};
-
-    for(size_t i = 0; i < subdata.size(); i++)
-    {
-      uint32_t yoffs = gridy[i] * sliceHeight;
-      uint32_t xoffs = gridx[i] * sliceWidth;
-
-      for(uint32_t y = 0; y < sliceHeight; y++)
-      {
-        for(uint32_t x = 0; x < sliceWidth; x++)
-        {
-          uint32_t *srcpix = (uint32_t *)&subdata[i][(y * sliceWidth + x) * pixelStride + 0];
-          uint32_t *dstpix =
-              (uint32_t *)&combinedData[((y + yoffs) * td.width + x + xoffs) * pixelStride + 0];
-
-          memcpy(dstpix, srcpix, pixelStride);
-        }
-      }
-
-      delete[] subdata[i];
-    }
+    const uint32_t cellSlices[4 * 3] = {
+        ~0U, 2, ~0U, ~0U,    //
+        1,   4, 0,   5,      //
+        ~0U, 3, ~0U, ~0U,    //
+    };
 
-    subdata.resize(1);
-    subdata[0] = combinedData;
-    rowPitch = td.width * 4;
+    ComposeSliceGrid(td, subdata, 4, 3, cellSlices);
+    rowPitch = td.width * td.format.compCount * td.format.compByteWidth;
   }
 
   int numComps = td.format.compCount;
@@ -1047,70 +1193,89 @@ ResultDetails ReplayController::SaveTexture(const TextureSave &saveData, const r
      (td.format.compByteWidth == 1 || td.format.compByteWidth == 4) &&
      (uint32_t)sd.channelExtract < td.format.compCount)
   {
-    uint32_t pixelStride = td.format.compCount * td.format.compByteWidth;
-    uint32_t compWidth = td.format.compByteWidth;
-    uint32_t compCount = td.format.compCount;
+    const uint32_t pixelStride = td.format.compCount * td.format.compByteWidth;
+    const uint32_t compWidth = td.format.compByteWidth;
+    const uint32_t compCount = td.format.compCount;
+    const uint32_t width = td.width;
+    const uint32_t channel = (uint32_t)sd.channelExtract;
+    byte *image = subdata[0];
 
-    uint32_t val = 0;
-    uint32_t max = ~0U;
+    process_image_rows(td.height, width * pixelStride, [=](uint32_t y) {
+      const uint32_t max = ~0U;
+      uint32_t val = 0;
 
-    for(uint32_t y = 0; y < td.height; y++)
-    {
-      for(uint32_t x = 0; x < td.width; x++)
+      byte *pixel = image + size_t(y) * width * pixelStride;
+
+      for(uint32_t x = 0; x < width; x++, pixel += pixelStride)
       {
-        memcpy(&val, &subdata[0][(y * td.width + x) * pixelStride + sd.channelExtract * compWidth],
-               td.format.compByteWidth);
+        memcpy(&val, pixel + channel * compWidth, compWidth);
 
         switch(compCount)
         {
-          case 4:
-            memcpy(&subdata[0][(y * td.width + x) * pixelStride + 3 * compWidth], &max,
-                   td.format.compByteWidth);
-            DELIBERATE_FALLTHROUGH();
-          case 3:
-            memcpy(&subdata[0][(y * td.width + x) * pixelStride + 2 * compWidth], &val,
-                   td.format.compByteWidth);
-            DELIBERATE_FALLTHROUGH();
-          case 2:
-            memcpy(&subdata[0][(y * td.width + x) * pixelStride + 1 * compWidth], &val,
-                   td.format.compByteWidth);
-            DELIBERATE_FALLTHROUGH();
-          case 1:
-            memcpy(&subdata[0][(y * td.width + x) * pixelStride + 0 * compWidth], &val,
-                   td.format.compByteWidth);
-            break;
+          case 4: memcpy(pixel + 3 * compWidth, &max, compWidth); DELIBERATE_FALLTHROUGH();
+          case 3: memcpy(pixel + 2 * compWidth, &val, compWidth); DELIBERATE_FALLTHROUGH();
+          case 2: memcpy(pixel + 1 * compWidth, &val, compWidth); DELIBERATE_FALLTHROUGH();
+          case 1: memcpy(pixel + 0 * compWidth, &val, compWidth); break;
         }
       }
-    }
+    });
   }
 
+  const int srcComps = numComps;
+
   // handle formats that don't support alpha
   if(numComps == 4 && (sd.destType == FileType::BMP || sd.destType == FileType::JPG))
+    numComps = 3;
+
+  // assume that (R,G,0) is better mapping than (Y,A) for 2 component data
+  if(numComps == 2 && (sd.destType == FileType::BMP || sd.destType == FileType::JPG ||
+                       sd.destType == FileType::PNG || sd.destType == FileType::TGA))
+    numComps = 3;
+
+  // background for blending out alpha, indexed by whether the pixel is on a dark square
+  Vec4f alphaBackground[2] = {
+      Vec4f(sd.alphaCol.x, sd.alphaCol.y, sd.alphaCol.z),
+      Vec4f(sd.alphaCol.x, sd.alphaCol.y, sd.alphaCol.z),
+  };
+
+  if(sd.alpha == AlphaMapping::BlendToCheckerboard)
+  {
+    alphaBackground[0] = RenderDoc::Inst().LightCheckerboardColor();
+    alphaBackground[1] = RenderDoc::Inst().DarkCheckerboardColor();
+  }
+
+  for(Vec4f &col : alphaBackground)
   {
-    byte *nonalpha = new byte[td.width * td.height * 3];
+    col.x = ConvertLinearToSRGB(col.x);
+    col.y = ConvertLinearToSRGB(col.y);
+    col.z = ConvertLinearToSRGB(col.z);
+  }
+
+  // converts rows of 8-bit data to the layout being written, for the formats above. These are
+  // generated on demand so they can be streamed to the encoder from worker threads without
+  // converting the whole image up front.
+  ImageRowGenerator ldrRows = [&](uint32_t y, byte *row) {
+    const byte *src = subdata[0] + size_t(y) * rowPitch;
+
+    if(srcComps == numComps)
+    {
+      memcpy(row, src, td.width * numComps);
+      return;
+    }
 
-    for(uint32_t y = 0; y < td.height; y++)
+    for(uint32_t x = 0; x < td.width; x++)
     {
-      for(uint32_t x = 0; x < td.width; x++)
+      if(srcComps == 4)
       {
-        byte r = subdata[0][(y * td.width + x) * 4 + 0];
-        byte g = subdata[0][(y * td.width + x) * 4 + 1];
-        byte b = subdata[0][(y * td.width + x) * 4 + 2];
-        byte a = subdata[0][(y * td.width + x) * 4 + 3];
+        byte r = src[x * 4 + 0];
+        byte g = src[x * 4 + 1];
+        byte b = src[x * 4 + 2];
+        byte a = src[x * 4 + 3];
 
         if(sd.alpha != AlphaMapping::Discard)
         {
-          Vec4f col = Vec4f(sd.alphaCol.x, sd.alphaCol.y, sd.alphaCol.z);
-          if(sd.alpha == AlphaMapping::BlendToCheckerboard)
-          {
-            bool lightSquare = ((x / 64) % 2) == ((y / 64) % 2);
-            col = lightSquare ? RenderDoc::Inst().LightCheckerboardColor()
-                              : RenderDoc::Inst().DarkCheckerboardColor();
-          }
-
-          col.x = ConvertLinearToSRGB(col.x);
-          col.y = ConvertLinearToSRGB(col.y);
-          col.z = ConvertLinearToSRGB(col.z);
+          const bool lightSquare = ((x / 64) % 2) == ((y / 64) % 2);
+          const Vec4f &col = alphaBackground[lightSquare ? 0 : 1];
 
           FloatVector pixel = FloatVector(float(r) / 255.0f, float(g) / 255.0f, float(b) / 255.0f,
                                           float(a) / 255.0f);
@@ -1124,50 +1289,22 @@ ResultDetails ReplayController::SaveTexture(const TextureSave &saveData, const r
           b = byte(pixel.z * 255.0f);
         }
 
-        nonalpha[(y * td.width + x) * 3 + 0] = r;
-        nonalpha[(y * td.width + x) * 3 + 1] = g;
-        nonalpha[(y * td.width + x) * 3 + 2] = b;
+        row[x * 3 + 0] = r;
+        row[x * 3 + 1] = g;
+        row[x * 3 + 2] = b;
       }
-    }
-
-    delete[] subdata[0];
-
-    subdata[0] = nonalpha;
-
-    numComps = 3;
-    rowPitch = td.width * 3;
-  }
-
-  // assume that (R,G,0) is better mapping than (Y,A) for 2 component data
-  if(numComps == 2 && (sd.destType == FileType::BMP || sd.destType == FileType::JPG ||
-                       sd.destType == FileType::PNG || sd.destType == FileType::TGA))
-  {
-    byte *rg0 = new byte[td.width * td.height * 3];
-
-    for(uint32_t y = 0; y < td.height; y++)
-    {
-      for(uint32_t x = 0; x < td.width; x++)
+      else
       {
-        byte r = subdata[0][(y * td.width + x) * 2 + 0];
-        byte g = subdata[0][(y * td.width + x) * 2 + 1];
-
-        rg0[(y * td.width + x) * 3 + 0] = r;
-        rg0[(y * td.width + x) * 3 + 1] = g;
-        rg0[(y * td.width + x) * 3 + 2] = 0;
+        row[x * 3 + 0] = src[x * 2 + 0];
+        row[x * 3 + 1] = src[x * 2 + 1];
+        row[x * 3 + 2] = 0;
 
         // if we're greyscaling the image, then keep the greyscale here.
         if(sd.channelExtract >= 0)
-          rg0[(y * td.width + x) * 3 + 2] = r;
+          row[x * 3 + 2] = src[x * 2 + 0];
       }
     }
-
-    delete[] subdata[0];
-
-    subdata[0] = rg0;
-
-    numComps = 3;
-    rowPitch = td.width * 3;
-  }
+  };
 
   FILE *f = FileIO::fopen(path, FileIO::WriteBinary);
 
@@ -1203,71 +1340,41 @@ ResultDetails ReplayController::SaveTexture(const TextureSave &saveData, const r
 
       res = write_dds_to_file(f, ddsData);
     }
-    else if(sd.destType == FileType::BMP)
+    else if(sd.destType == FileType::BMP || sd.destType == FileType::TGA)
     {
-      int ret = stbi_write_bmp_to_func(fileWriteFunc, (void *)f, td.width, td.height, numComps,
-                                       subdata[0]);
+      // stb needs the whole image, so only convert into a new buffer if the layout changes
+      byte *image = subdata[0];
+      if(srcComps != numComps)
+      {
+        image = new byte[td.width * td.height * numComps];
+        generate_image_rows(td.height, td.width * numComps, image, ldrRows);
+      }
 
-      if(ret == 0)
-        SET_ERROR_RESULT(res, ResultCode::InternalError, "Failed to write BMP image");
-    }
-    else if(sd.destType == FileType::PNG)
-    {
-      int ret = stbi_write_png_to_func(fileWriteFunc, (void *)f, td.width, td.height, numComps,
-                                       subdata[0], rowPitch);
+      int ret = 0;
+      if(sd.destType == FileType::BMP)
+        ret = stbi_write_bmp_to_func(fileWriteFunc, (void *)f, td.width, td.height, numComps,
+                                     image);
+      else
+        ret = stbi_write_tga_to_func(fileWriteFunc, (void *)f, td.width, td.height, numComps,
+                                     image);
+
+      if(image != subdata[0])
+        delete[] image;
 
       if(ret == 0)
-        SET_ERROR_RESULT(res, ResultCode::InternalError, "Failed to write PNG image");
+        SET_ERROR_RESULT(res, ResultCode::InternalError, "Failed to write %s image",
+                         sd.destType == FileType::BMP ? "BMP" : "TGA");
     }
-    else if(sd.destType == FileType::TGA)
+    else if(sd.destType == FileType::PNG)
     {
-      int ret = stbi_write_tga_to_func(fileWriteFunc, (void *)f, td.width, td.height, numComps,
-                                       subdata[0]);
-
-      if(ret == 0)
-        SET_ERROR_RESULT(res, ResultCode::InternalError, "Failed to write TGA image");
+      res = write_png_to_file(f, td.width, td.height, numComps, ldrRows);
     }
     else if(sd.destType == FileType::JPG)
     {
-      jpge::params p;
-      p.m_quality = sd.jpegQuality;
-
-      int len = td.width * td.height * td.format.compCount;
-      // ensure buffer is at least 1024
-      if(len < 1024)
-        len = 1024;
-
-      char *jpgdst = new char[len];
-
-      bool success = jpge::compress_image_to_jpeg_file_in_memory(jpgdst, len, td.width, td.height,
-                                                                 numComps, subdata[0], p);
-
-      if(success)
-        fwrite(jpgdst, 1, len, f);
-      else
-        SET_ERROR_RESULT(res, ResultCode::InternalError, "Failed to write JPG image");
-
-      delete[] jpgdst;
+      res = write_jpg_to_file(f, td.width, td.height, numComps, sd.jpegQuality, ldrRows);
     }
     else if(sd.destType == FileType::HDR || sd.destType == FileType::EXR)
     {
-      float *fldata = NULL;
-      float *abgr[4] = {NULL, NULL, NULL, NULL};
-
-      if(sd.destType == FileType::HDR)
-      {
-        fldata = new float[td.width * td.height * 4];
-      }
-      else
-      {
-        abgr[0] = new float[td.width * td.height];
-        abgr[1] = new float[td.width * td.height];
-        abgr[2] = new float[td.width * td.height];
-        abgr[3] = new float[td.width * td.height];
-      }
-
-      byte *srcData = subdata[0];
-
       ResourceFormat saveFmt = td.format;
       if(saveFmt.compType == CompType::Typeless)
         saveFmt.compType = sd.typeCast;
@@ -1280,12 +1387,15 @@ ResultDetails ReplayController::SaveTexture(const TextureSave &saveData, const r
       if(saveFmt.compType == CompType::Depth && pixStride == 3)
         pixStride = 4;
 
-      for(uint32_t y = 0; y < td.height; y++)
-      {
+      ImageRowGenerator floatRows = [&](uint32_t y, byte *row) {
+        FloatVector *pixels = (FloatVector *)row;
+
+        DecodeFormattedComponents(saveFmt, subdata[0] + size_t(y) * pixStride * td.width, pixStride,
+                                  pixels, td.width);
+
         for(uint32_t x = 0; x < td.width; x++)
         {
-          FloatVector pixel = DecodeFormattedComponents(saveFmt, srcData);
-          srcData += pixStride;
+          FloatVector &pixel = pixels[x];
 
           // HDR can't represent negative values
           if(sd.destType == FileType::HDR)
@@ -1316,90 +1426,27 @@ ResultDetails ReplayController::SaveTexture(const TextureSave &saveData, const r
             pixel.x = pixel.y = pixel.z = pixel.w;
             pixel.w = 1.0f;
           }
-
-          if(fldata)
-          {
-            fldata[(y * td.width + x) * 4 + 0] = pixel.x;
-            fldata[(y * td.width + x) * 4 + 1] = pixel.y;
-            fldata[(y * td.width + x) * 4 + 2] = pixel.z;
-            fldata[(y * td.width + x) * 4 + 3] = pixel.w;
-          }
-          else
-          {
-            abgr[0][(y * td.width + x)] = pixel.w;
-            abgr[1][(y * td.width + x)] = pixel.z;
-            abgr[2][(y * td.width + x)] = pixel.y;
-            abgr[3][(y * td.width + x)] = pixel.x;
-          }
         }
-      }
+      };
 
       if(sd.destType == FileType::HDR)
       {
-        int ret = stbi_write_hdr_to_func(fileWriteFunc, (void *)f, td.width, td.height, 4, fldata);
-
-        if(ret == 0)
-          SET_ERROR_RESULT(res, ResultCode::InternalError, "Failed to write HDR image");
-      }
-      else if(sd.destType == FileType::EXR)
-      {
-        const char *err = NULL;
-
-        EXRHeader exrHeader;
-        InitEXRHeader(&exrHeader);
-
-        EXRImage exrImage;
-        InitEXRImage(&exrImage);
-
-        int pixTypes[4] = {TINYEXR_PIXELTYPE_FLOAT, TINYEXR_PIXELTYPE_FLOAT,
-                           TINYEXR_PIXELTYPE_FLOAT, TINYEXR_PIXELTYPE_FLOAT};
-        int reqTypes[4] = {TINYEXR_PIXELTYPE_HALF, TINYEXR_PIXELTYPE_HALF, TINYEXR_PIXELTYPE_HALF,
-                           TINYEXR_PIXELTYPE_HALF};
+        rdcarray<FloatVector> fldata;
+        fldata.resize(td.width * td.height);
 
-        if(saveFmt.compByteWidth == 4)
-        {
-          for(size_t channel = 0; channel < 4; channel++)
-          {
-            reqTypes[channel] = TINYEXR_PIXELTYPE_FLOAT;
-          }
-        }
-
-        // must be in this order as many viewers don't pay attention to channels and just assume
-        // they are in this order
-        EXRChannelInfo bgraChannels[4] = {
-            {"A"}, {"B"}, {"G"}, {"R"},
-        };
-
-        exrHeader.num_channels = 4;
-        exrHeader.channels = bgraChannels;
-        exrImage.images = (unsigned char **)abgr;
-        exrImage.width = td.width;
-        exrImage.height = td.height;
-        exrHeader.pixel_types = pixTypes;
-        exrHeader.requested_pixel_types = reqTypes;
-
-        unsigned char *mem = NULL;
+        generate_image_rows(td.height, td.width * sizeof(FloatVector), (byte *)fldata.data(),
+                            floatRows);
 
-        size_t ret = SaveEXRImageToMemory(&exrImage, &exrHeader, &mem, &err);
+        int ret = stbi_write_hdr_to_func(fileWriteFunc, (void *)f, td.width, td.height, 4,
+                                         (float *)fldata.data());
 
-        if(ret > 0)
-          FileIO::fwrite(mem, 1, ret, f);
-        else
-          SET_ERROR_RESULT(res, ResultCode::InternalError, "Failed to write EXR image: %s", err);
-
-        free(mem);
-      }
-
-      if(fldata)
-      {
-        delete[] fldata;
+        if(ret == 0)
+          SET_ERROR_RESULT(res, ResultCode::InternalError, "Failed to write HDR image");
       }
       else
       {
-        delete[] abgr[0];
-        delete[] abgr[1];
-        delete[] abgr[2];
-        delete[] abgr[3];
+        // halfs are enough unless the source had 32-bit components
+        res = write_exr_to_file(f, td.width, td.height, saveFmt.compByteWidth != 4, floatRows);
       }
     }
 
@@ -1457,7 +1504,11 @@ rdcarray<PixelModification> ReplayController::PixelHistory(ResourceId target, ui
   if(id == ResourceId())
     return ret;
 
-  rdcarray<EventUsage> usage = m_pDevice->GetUsage(id);
+  // only usages up to the current event are relevant
+  const UsageIndex &usageIndex = GetUsageIndex();
+  rdcarray<EventUsage> usage = usageIndex.Contains(target)
+                                   ? usageIndex.GetUsageInRange(target, 0, m_EventID)
+                                   : m_pDevice->GetUsage(id);
 
   rdcarray<EventUsage> events;
 
@@ -2174,10 +2225,11 @@ RDResult ReplayController::PostCreateInit(IReplayDriver *device, RDCFile *rdc)
   if(m_FrameRecord.actionList.empty())
     return ResultCode::APIReplayFailed;
 
-  m_Actions.clear();
-  SetupActionPointers(m_Actions, m_FrameRecord.actionList);
+  m_ActionIndex.Build(m_FrameRecord.actionList);
+
+  StringIntern::LogStats("Capture loaded");
 
-  FetchPipelineState(m_Actions.back()->eventId);
+  FetchPipelineState(m_ActionIndex.GetLastAction()->eventId);
   FatalErrorCheck();
 
   return m_FatalError;
@@ -29,7 +29,10 @@
 #include "api/replay/renderdoc_replay.h"
 #include "common/common.h"
 #include "core/core.h"
+#include "replay/action_index.h"
 #include "replay/replay_driver.h"
+#include "replay/structured_index.h"
+#include "replay/usage_index.h"
 
 #define CHECK_REPLAY_THREAD() RDCASSERT(Threading::GetCurrentID() == m_ThreadID);
 
@@ -168,6 +171,10 @@ public:
 
   FrameDescription GetFrameInfo();
   const SDFile &GetStructuredFile();
+  rdcarray<uint32_t> FindEventsReferencingResource(ResourceId id);
+  rdcarray<uint32_t> FindEventsByName(const rdcstr &name);
+  rdcarray<uint32_t> FindEventsWithParameter(const rdcstr &name);
+  rdcarray<uint32_t> FindEventsWithString(const rdcstr &text, bool exactMatch);
   const rdcarray<ActionDescription> &GetRootActions();
   void AddFakeMarkers();
   rdcarray<CounterResult> FetchCounters(const rdcarray<GPUCounter> &counters);
@@ -177,6 +184,7 @@ public:
   const rdcarray<BufferDescription> &GetBuffers();
   const rdcarray<ResourceDescription> &GetResources();
   rdcarray<DebugMessage> GetDebugMessages();
+  ReplayMemoryStats GetReplayMemoryStats();
   ResultDetails GetFatalErrorStatus()
   {
     // don't reconvert this on return every time, or we would cache many strings if this function is
@@ -206,6 +214,9 @@ public:
   MeshFormat GetPostVSData(uint32_t instID, uint32_t viewID, MeshDataStage stage);
 
   rdcarray<EventUsage> GetUsage(ResourceId id);
+  rdcarray<EventUsage> GetUsageInRange(ResourceId id, uint32_t firstEventId, uint32_t lastEventId);
+  EventUsage GetFirstWriteAfter(ResourceId id, uint32_t eventId);
+  rdcarray<ResourceId> GetResourcesUsedByEvent(uint32_t eventId);
 
   bytebuf GetBufferData(ResourceId buff, uint64_t offset, uint64_t len);
   bytebuf GetTextureData(ResourceId buff, const Subresource &sub);
@@ -243,7 +254,15 @@ private:
 
   IReplayDriver *GetDevice() { return m_pDevice; }
   FrameRecord m_FrameRecord;
-  rdcarray<ActionDescription *> m_Actions;
+  ActionIndex m_ActionIndex;
+
+  // built on first use by the FindEvents* functions
+  StructuredIndex m_StructuredIndex;
+  const StructuredIndex &GetStructuredIndex();
+
+  // built on first use by the usage queries
+  UsageIndex m_UsageIndex;
+  const UsageIndex &GetUsageIndex();
 
   uint64_t m_ThreadID;
 
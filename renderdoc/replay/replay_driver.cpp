@@ -56,12 +56,6 @@ void DoSerialise(SerialiserType &ser, GetTextureDataParams &el)
 
 INSTANTIATE_SERIALISE_TYPE(GetTextureDataParams);
 
-static bool PreviousNextExcludedMarker(ActionDescription *action)
-{
-  return bool(action->flags & (ActionFlags::PushMarker | ActionFlags::PopMarker |
-                               ActionFlags::SetMarker | ActionFlags::MultiAction));
-}
-
 CompType BaseRemapType(CompType typeCast)
 {
   switch(typeCast)
@@ -76,115 +70,6 @@ CompType BaseRemapType(CompType typeCast)
   }
 }
 
-static ActionDescription *SetupActionPointers(rdcarray<ActionDescription *> &actionTable,
-                                              rdcarray<ActionDescription> &actions,
-                                              ActionDescription *parent, ActionDescription *&previous)
-{
-  ActionDescription *ret = NULL;
-
-  for(size_t i = 0; i < actions.size(); i++)
-  {
-    ActionDescription *action = &actions[i];
-
-    RDCASSERTMSG("All actions must have their own event as the final event",
-                 !action->events.empty() && action->events.back().eventId == action->eventId);
-
-    action->parent = parent;
-
-    if(!action->children.empty())
-    {
-      {
-        RDCASSERT(actionTable.empty() || action->eventId > actionTable.back()->eventId ||
-                  actionTable.back()->IsFakeMarker());
-        actionTable.resize(RDCMAX(actionTable.size(), size_t(action->eventId) + 1));
-        actionTable[action->eventId] = action;
-      }
-
-      ret = SetupActionPointers(actionTable, action->children, action, previous);
-    }
-    else if(PreviousNextExcludedMarker(action))
-    {
-      // don't want to set up previous/next links for markers, but still add them to the table
-      // Some markers like Present should have previous/next, but API Calls we also skip
-
-      {
-        // we also allow non-contiguous EIDs for fake markers that have high EIDs
-        RDCASSERT(actionTable.empty() || action->eventId > actionTable.back()->eventId ||
-                  actionTable.back()->IsFakeMarker());
-        actionTable.resize(RDCMAX(actionTable.size(), size_t(action->eventId) + 1));
-        actionTable[action->eventId] = action;
-      }
-    }
-    else
-    {
-      if(previous)
-        previous->next = action;
-      action->previous = previous;
-
-      {
-        // we also allow non-contiguous EIDs for fake markers that have high EIDs
-        RDCASSERT(actionTable.empty() || action->eventId > actionTable.back()->eventId ||
-                  actionTable.back()->IsFakeMarker());
-        actionTable.resize(RDCMAX(actionTable.size(), size_t(action->eventId) + 1));
-        actionTable[action->eventId] = action;
-      }
-
-      ret = previous = action;
-    }
-  }
-
-  return ret;
-}
-
-void SetupActionPointers(rdcarray<ActionDescription *> &actionTable,
-                         rdcarray<ActionDescription> &actions)
-{
-  ActionDescription *previous = NULL;
-  SetupActionPointers(actionTable, actions, NULL, previous);
-
-  // markers don't enter the previous/next chain, but we still want pointers for them that point to
-  // the next or previous actual action (skipping any markers). This means that
-  // action->next->previous
-  // != action sometimes, but it's more useful than action->next being NULL in the middle of the
-  // list.
-  // This enables searching for a marker string and then being able to navigate from there and
-  // joining the 'real' linked list after one step.
-
-  previous = NULL;
-  rdcarray<ActionDescription *> markers;
-
-  for(ActionDescription *action : actionTable)
-  {
-    if(!action)
-      continue;
-
-    bool marker = PreviousNextExcludedMarker(action);
-
-    if(marker)
-    {
-      // point the previous pointer to the last non-marker action we got. If we haven't hit one yet
-      // because this is near the start, this will just be NULL.
-      action->previous = previous;
-
-      // because there can be multiple markers consecutively we want to point all of their nexts to
-      // the next action we encounter. Accumulate this list, though in most cases it will only be 1
-      // long as it's uncommon to have multiple markers one after the other
-      markers.push_back(action);
-    }
-    else
-    {
-      // the next markers we encounter should point their previous to this.
-      previous = action;
-
-      // all previous markers point to this one
-      for(ActionDescription *m : markers)
-        m->next = action;
-
-      markers.clear();
-    }
-  }
-}
-
 void PatchLineStripIndexBuffer(const ActionDescription *action, Topology topology, uint8_t *idx8,
                                uint16_t *idx16, uint32_t *idx32, rdcarray<uint32_t> &patchedIndices)
 {
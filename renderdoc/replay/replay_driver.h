@@ -104,6 +104,7 @@ DECLARE_REFLECTION_STRUCT(GetTextureDataParams);
 CompType BaseRemapType(CompType typeCast);
 
 class RDCFile;
+struct RemoteServer;
 
 class AMDRGPControl;
 
@@ -219,6 +220,8 @@ public:
   virtual DriverInformation GetDriverInfo() = 0;
 
   virtual rdcarray<GPUDevice> GetAvailableGPUs() = 0;
+
+  virtual ReplayMemoryStats GetReplayMemoryStats() = 0;
 };
 
 class IReplayDriver : public IRemoteDriver
@@ -279,6 +282,21 @@ public:
 
   virtual uint32_t PickVertex(uint32_t eventId, int32_t width, int32_t height,
                               const MeshDisplay &cfg, uint32_t x, uint32_t y) = 0;
+
+  // the usage of each resource in ids, which are original IDs. Resources with no live ID have no
+  // usage. The proxy overrides this to fetch them all without a round trip per resource.
+  virtual rdcarray<rdcarray<EventUsage>> GetUsages(const rdcarray<ResourceId> &ids)
+  {
+    rdcarray<rdcarray<EventUsage>> ret;
+    ret.resize(ids.size());
+    for(size_t i = 0; i < ids.size(); i++)
+    {
+      ResourceId liveId = GetLiveID(ids[i]);
+      if(liveId != ResourceId())
+        ret[i] = GetUsage(liveId);
+    }
+    return ret;
+  }
 };
 
 // for protocols, we extend the public interface a bit to add callbacks for remapping connection
@@ -296,13 +314,10 @@ struct IDeviceProtocolHandler : public IDeviceProtocolController
 
   virtual rdcstr RemapHostname(const rdcstr &deviceID) = 0;
   virtual uint16_t RemapPort(const rdcstr &deviceID, uint16_t srcPort) = 0;
-  virtual IRemoteServer *CreateRemoteServer(Network::Socket *sock, const rdcstr &deviceID) = 0;
+  virtual RemoteServer *CreateRemoteServer(Network::Socket *sock, const rdcstr &deviceID) = 0;
 };
 
 // utility functions useful in any driver implementation
-void SetupActionPointers(rdcarray<ActionDescription *> &actionTable,
-                         rdcarray<ActionDescription> &actions);
-
 // for hardware/APIs that can't do line rasterization, manually expand any triangle input topology
 // to a linestrip with strip restart indices.
 void PatchLineStripIndexBuffer(const ActionDescription *action, Topology topology, uint8_t *idx8,
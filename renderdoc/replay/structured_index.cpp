@@ -0,0 +1,271 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "structured_index.h"
+#include <algorithm>
+#include "common/common.h"
+#include "common/timing.h"
+#include "strings/string_utils.h"
+
+void StructuredIndex::Clear()
+{
+  m_Resources.clear();
+  m_ChunkNames.clear();
+  m_Parameters.clear();
+  m_Strings.clear();
+  m_Built = false;
+}
+
+void StructuredIndex::AddEvents(EventList &list, const uint32_t *eventIds, size_t count)
+{
+  // objects in the same chunk often add the same key many times, e.g. a member of each element in
+  // an array. Chunks are processed one at a time so this is cheap to skip.
+  if(!list.empty() && list.back() == eventIds[count - 1])
+    return;
+
+  list.append(eventIds, count);
+}
+
+void StructuredIndex::Finalise(EventList &list)
+{
+  std::sort(list.begin(), list.end());
+  list.resize(std::unique(list.begin(), list.end()) - list.begin());
+}
+
+void StructuredIndex::Build(const SDFile &file, const rdcarray<ActionDescription> &rootActions)
+{
+  Clear();
+
+  PerformanceTimer timer;
+
+  // gather which events use each chunk. Usually that's one, but a chunk that's recorded once and
+  // executed several times is used by several events.
+  rdcarray<rdcpair<uint32_t, uint32_t>> chunkEvents;
+
+  {
+    rdcarray<const ActionDescription *> actions;
+    for(const ActionDescription &a : rootActions)
+      actions.push_back(&a);
+
+    while(!actions.empty())
+    {
+      const ActionDescription *action = actions.back();
+      actions.pop_back();
+
+      for(const APIEvent &e : action->events)
+        if(e.chunkIndex != APIEvent::NoChunk && e.chunkIndex < file.chunks.size())
+          chunkEvents.push_back({e.chunkIndex, e.eventId});
+
+      for(const ActionDescription &c : action->children)
+        actions.push_back(&c);
+    }
+  }
+
+  std::sort(chunkEvents.begin(), chunkEvents.end());
+
+  rdcarray<uint32_t> eventIds;
+  rdcarray<const SDObject *> objects;
+
+  for(size_t i = 0; i < chunkEvents.size();)
+  {
+    const uint32_t chunkIndex = chunkEvents[i].first;
+
+    eventIds.clear();
+    for(; i < chunkEvents.size() && chunkEvents[i].first == chunkIndex; i++)
+      eventIds.push_back(chunkEvents[i].second);
+
+    const SDChunk *chunk = file.chunks[chunkIndex];
+
+    AddEvents(m_ChunkNames[strlower(chunk->name)], eventIds.data(), eventIds.size());
+
+    objects.clear();
+    for(size_t c = 0; c < chunk->NumChildren(); c++)
+      objects.push_back(chunk->GetChild(c));
+
+    while(!objects.empty())
+    {
+      const SDObject *obj = objects.back();
+      objects.pop_back();
+
+      // array elements all have the same placeholder name
+      if(!obj->name.empty() && obj->name != "$el")
+        AddEvents(m_Parameters[strlower(obj->name)], eventIds.data(), eventIds.size());
+
+      if(obj->type.basetype == SDBasic::Resource)
+      {
+        if(obj->data.basic.id != ResourceId())
+          AddEvents(m_Resources[obj->data.basic.id], eventIds.data(), eventIds.size());
+      }
+      else if(obj->type.basetype == SDBasic::String ||
+              (obj->type.flags & SDTypeFlags::HasCustomString))
+      {
+        if(!obj->data.str.empty())
+          AddEvents(m_Strings[strlower(obj->data.str)], eventIds.data(), eventIds.size());
+      }
+
+      for(size_t c = 0; c < obj->NumChildren(); c++)
+        objects.push_back(obj->GetChild(c));
+    }
+  }
+
+  for(auto it = m_Resources.begin(); it != m_Resources.end(); ++it)
+    Finalise(it->second);
+  for(TermIndex *index : {&m_ChunkNames, &m_Parameters, &m_Strings})
+    for(auto it = index->begin(); it != index->end(); ++it)
+      Finalise(it->second);
+
+  m_Built = true;
+
+  RDCLOG("Indexed structured data for %zu events in %.2lf ms", chunkEvents.size(),
+         timer.GetMilliseconds());
+}
+
+rdcarray<uint32_t> StructuredIndex::Lookup(const TermIndex &index, const rdcstr &term)
+{
+  auto it = index.find(strlower(term));
+  if(it == index.end())
+    return {};
+  return it->second;
+}
+
+rdcarray<uint32_t> StructuredIndex::FindResource(ResourceId id) const
+{
+  auto it = m_Resources.find(id);
+  if(it == m_Resources.end())
+    return {};
+  return it->second;
+}
+
+rdcarray<uint32_t> StructuredIndex::FindChunkName(const rdcstr &name) const
+{
+  return Lookup(m_ChunkNames, name);
+}
+
+rdcarray<uint32_t> StructuredIndex::FindParameter(const rdcstr &name) const
+{
+  return Lookup(m_Parameters, name);
+}
+
+rdcarray<uint32_t> StructuredIndex::FindString(const rdcstr &text, bool exact) const
+{
+  if(exact)
+    return Lookup(m_Strings, text);
+
+  // partial matches only need to scan the unique values, which are far fewer than the events
+  rdcstr needle = strlower(text);
+
+  EventList ret;
+  for(auto it = m_Strings.begin(); it != m_Strings.end(); ++it)
+    if(it->first.contains(needle))
+      ret.append(it->second);
+
+  Finalise(ret);
+  return ret;
+}
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+TEST_CASE("Test structured data index", "[structuredindex]")
+{
+  SDFile file;
+
+  ResourceId tex = ResourceIDGen::GetNewUniqueID();
+  ResourceId buf = ResourceIDGen::GetNewUniqueID();
+
+  auto makeChunk = [&file](const rdcstr &name) {
+    SDChunk *chunk = new SDChunk(name);
+    file.chunks.push_back(chunk);
+    return chunk;
+  };
+
+  // chunk 0: a bind of a texture
+  SDChunk *chunk = makeChunk("vkCmdBindImage");
+  chunk->AddAndOwnChild(makeSDResourceId("image"_lit, tex));
+  chunk->AddAndOwnChild(makeSDEnum("layout"_lit, 5))->SetCustomString("VK_IMAGE_LAYOUT_GENERAL");
+
+  // chunk 1: a draw, with an array of structs referencing both resources
+  chunk = makeChunk("vkCmdDraw");
+  chunk->AddAndOwnChild(makeSDUInt32("vertexCount"_lit, 3));
+  SDObject *arr = chunk->AddAndOwnChild(makeSDArray("bindings"_lit));
+  for(ResourceId id : {tex, buf, buf})
+  {
+    SDObject *s = arr->AddAndOwnChild(makeSDStruct("$el"_lit, "Binding"_lit));
+    s->AddAndOwnChild(makeSDResourceId("resource"_lit, id));
+  }
+
+  // chunk 2: a marker
+  chunk = makeChunk("vkCmdBeginDebugUtilsLabelEXT");
+  chunk->AddAndOwnChild(makeSDString("pLabelName"_lit, "Shadow Pass"));
+
+  // events: the bind and draw are executed twice, as if from a secondary command buffer
+  rdcarray<ActionDescription> actions;
+  actions.resize(2);
+  actions[0].eventId = 3;
+  actions[0].events = {APIEvent(), APIEvent(), APIEvent()};
+  actions[0].events[0].eventId = 1;
+  actions[0].events[0].chunkIndex = 2;
+  actions[0].events[1].eventId = 2;
+  actions[0].events[1].chunkIndex = 0;
+  actions[0].events[2].eventId = 3;
+  actions[0].events[2].chunkIndex = 1;
+
+  actions[1].eventId = 10;
+  actions[1].children.resize(1);
+  actions[1].children[0].events = {APIEvent(), APIEvent()};
+  actions[1].children[0].events[0].eventId = 9;
+  actions[1].children[0].events[0].chunkIndex = 0;
+  actions[1].children[0].events[1].eventId = 10;
+  actions[1].children[0].events[1].chunkIndex = 1;
+
+  StructuredIndex index;
+  CHECK(!index.IsBuilt());
+  index.Build(file, actions);
+  CHECK(index.IsBuilt());
+
+  CHECK((index.FindResource(tex) == rdcarray<uint32_t>({2, 3, 9, 10})));
+  CHECK((index.FindResource(buf) == rdcarray<uint32_t>({3, 10})));
+  CHECK(index.FindResource(ResourceIDGen::GetNewUniqueID()).empty());
+
+  CHECK((index.FindChunkName("vkCmdDraw") == rdcarray<uint32_t>({3, 10})));
+  CHECK((index.FindChunkName("VKCMDDRAW") == rdcarray<uint32_t>({3, 10})));
+  CHECK(index.FindChunkName("vkCmdDra").empty());
+
+  CHECK((index.FindParameter("resource") == rdcarray<uint32_t>({3, 10})));
+  CHECK((index.FindParameter("vertexcount") == rdcarray<uint32_t>({3, 10})));
+  CHECK(index.FindParameter("$el").empty());
+
+  CHECK((index.FindString("shadow pass", true) == rdcarray<uint32_t>({1})));
+  CHECK(index.FindString("shadow", true).empty());
+  CHECK((index.FindString("shadow", false) == rdcarray<uint32_t>({1})));
+  CHECK((index.FindString("LAYOUT_GENERAL", false) == rdcarray<uint32_t>({2, 9})));
+  CHECK((index.FindString("a", false) == rdcarray<uint32_t>({1, 2, 9})));
+
+  index.Clear();
+  CHECK(!index.IsBuilt());
+  CHECK(index.FindResource(tex).empty());
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -0,0 +1,68 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <map>
+#include <unordered_map>
+#include "api/replay/data_types.h"
+#include "api/replay/structured_data.h"
+
+// An inverted index from the contents of each event's structured data to the events, so that
+// searching for events by what they reference doesn't need to walk every chunk each time. It's
+// built once over the whole capture and is then read-only.
+//
+// Names and string values are matched case-insensitively, and every lookup returns a sorted list of
+// unique event IDs.
+class StructuredIndex
+{
+public:
+  void Build(const SDFile &file, const rdcarray<ActionDescription> &rootActions);
+  void Clear();
+  bool IsBuilt() const { return m_Built; }
+  // events with any parameter that is this resource
+  rdcarray<uint32_t> FindResource(ResourceId id) const;
+  // events whose function/chunk is called this
+  rdcarray<uint32_t> FindChunkName(const rdcstr &name) const;
+  // events with a parameter with this name, at any depth
+  rdcarray<uint32_t> FindParameter(const rdcstr &name) const;
+  // events with a string parameter or named value (such as an enum) that matches text. If exact is
+  // false any value containing text matches.
+  rdcarray<uint32_t> FindString(const rdcstr &text, bool exact) const;
+
+private:
+  typedef rdcarray<uint32_t> EventList;
+  typedef std::map<rdcstr, EventList> TermIndex;
+
+  static void AddEvents(EventList &list, const uint32_t *eventIds, size_t count);
+  static void Finalise(EventList &list);
+  static rdcarray<uint32_t> Lookup(const TermIndex &index, const rdcstr &term);
+
+  std::unordered_map<ResourceId, EventList> m_Resources;
+  TermIndex m_ChunkNames;
+  TermIndex m_Parameters;
+  TermIndex m_Strings;
+
+  bool m_Built = false;
+};
@@ -0,0 +1,307 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+
+#include "usage_index.h"
+#include <algorithm>
+#include "common/common.h"
+#include "common/timing.h"
+
+static_assert(uint32_t(ResourceUsage::CPUWrite) < 64, "Usage mask is not large enough");
+
+// any usage that can modify the contents of the resource
+const uint64_t UsageIndex::WriteMask =
+    UsageBit(ResourceUsage::StreamOut) | UsageBit(ResourceUsage::VS_RWResource) |
+    UsageBit(ResourceUsage::HS_RWResource) | UsageBit(ResourceUsage::DS_RWResource) |
+    UsageBit(ResourceUsage::GS_RWResource) | UsageBit(ResourceUsage::PS_RWResource) |
+    UsageBit(ResourceUsage::CS_RWResource) | UsageBit(ResourceUsage::All_RWResource) |
+    UsageBit(ResourceUsage::ColorTarget) | UsageBit(ResourceUsage::DepthStencilTarget) |
+    UsageBit(ResourceUsage::Clear) | UsageBit(ResourceUsage::Discard) |
+    UsageBit(ResourceUsage::GenMips) | UsageBit(ResourceUsage::Resolve) |
+    UsageBit(ResourceUsage::ResolveDst) | UsageBit(ResourceUsage::Copy) |
+    UsageBit(ResourceUsage::CopyDst) | UsageBit(ResourceUsage::CPUWrite);
+
+void UsageIndex::Clear()
+{
+  m_Resources.clear();
+  m_EventIds.clear();
+  m_Usages.clear();
+  m_Views.clear();
+  m_EventOffsets.clear();
+  m_EventResources.clear();
+  m_Built = false;
+}
+
+void UsageIndex::Build(const rdcarray<ResourceId> &resources, UsageFetcher fetchUsage)
+{
+  Clear();
+
+  PerformanceTimer timer;
+
+  rdcarray<rdcpair<uint32_t, ResourceId>> eventResources;
+  uint32_t maxEventId = 0;
+
+  for(ResourceId id : resources)
+  {
+    if(m_Resources.find(id) != m_Resources.end())
+      continue;
+
+    rdcarray<EventUsage> usage = fetchUsage(id);
+
+    // usages are mostly recorded in event order, but not always e.g. with secondary command
+    // buffers. Keep the order of usages within an event.
+    std::stable_sort(usage.begin(), usage.end(), [](const EventUsage &a, const EventUsage &b) {
+      return a.eventId < b.eventId;
+    });
+
+    ResourceUsages &res = m_Resources[id];
+    res.offset = (uint32_t)m_EventIds.size();
+    res.count = (uint32_t)usage.size();
+    res.mask = 0;
+
+    for(const EventUsage &u : usage)
+    {
+      m_EventIds.push_back(u.eventId);
+      m_Usages.push_back(u.usage);
+      m_Views.push_back(u.view);
+      res.mask |= UsageBit(u.usage);
+
+      if(eventResources.empty() || eventResources.back().first != u.eventId ||
+         eventResources.back().second != id)
+        eventResources.push_back({u.eventId, id});
+
+      maxEventId = RDCMAX(maxEventId, u.eventId);
+    }
+  }
+
+  std::sort(eventResources.begin(), eventResources.end());
+  eventResources.resize(std::unique(eventResources.begin(), eventResources.end()) -
+                        eventResources.begin());
+
+  m_EventOffsets.resize(m_EventIds.empty() ? 0 : maxEventId + 2);
+  m_EventResources.reserve(eventResources.size());
+
+  size_t cur = 0;
+  for(uint32_t eid = 0; eid < m_EventOffsets.size(); eid++)
+  {
+    m_EventOffsets[eid] = (uint32_t)m_EventResources.size();
+    for(; cur < eventResources.size() && eventResources[cur].first == eid; cur++)
+      m_EventResources.push_back(eventResources[cur].second);
+  }
+
+  m_Built = true;
+
+  RDCLOG("Indexed %zu usages of %zu resources in %.2lf ms", m_EventIds.size(), m_Resources.size(),
+         timer.GetMilliseconds());
+}
+
+rdcpair<size_t, size_t> UsageIndex::FindRange(const ResourceUsages &res, uint32_t firstEventId,
+                                              uint32_t lastEventId) const
+{
+  const uint32_t *begin = m_EventIds.data() + res.offset;
+  const uint32_t *end = begin + res.count;
+
+  const uint32_t *first = std::lower_bound(begin, end, firstEventId);
+  const uint32_t *last = std::upper_bound(first, end, lastEventId);
+
+  return {size_t(first - m_EventIds.data()), size_t(last - m_EventIds.data())};
+}
+
+rdcarray<EventUsage> UsageIndex::GetUsage(ResourceId id) const
+{
+  return GetUsageInRange(id, 0, ~0U);
+}
+
+rdcarray<EventUsage> UsageIndex::GetUsageInRange(ResourceId id, uint32_t firstEventId,
+                                                 uint32_t lastEventId) const
+{
+  rdcarray<EventUsage> ret;
+
+  auto it = m_Resources.find(id);
+  if(it == m_Resources.end() || firstEventId > lastEventId)
+    return ret;
+
+  rdcpair<size_t, size_t> range = FindRange(it->second, firstEventId, lastEventId);
+
+  ret.reserve(range.second - range.first);
+  for(size_t i = range.first; i < range.second; i++)
+    ret.push_back(EventUsage(m_EventIds[i], m_Usages[i], m_Views[i]));
+
+  return ret;
+}
+
+EventUsage UsageIndex::GetFirstWriteAfter(ResourceId id, uint32_t eventId) const
+{
+  auto it = m_Resources.find(id);
+  if(it == m_Resources.end() || (it->second.mask & WriteMask) == 0 || eventId == ~0U)
+    return EventUsage();
+
+  rdcpair<size_t, size_t> range = FindRange(it->second, eventId + 1, ~0U);
+
+  for(size_t i = range.first; i < range.second; i++)
+    if(IsWrite(m_Usages[i]))
+      return EventUsage(m_EventIds[i], m_Usages[i], m_Views[i]);
+
+  return EventUsage();
+}
+
+uint64_t UsageIndex::GetUsageMask(ResourceId id) const
+{
+  auto it = m_Resources.find(id);
+  if(it == m_Resources.end())
+    return 0;
+
+  return it->second.mask;
+}
+
+rdcarray<ResourceId> UsageIndex::GetResourcesUsedByEvent(uint32_t eventId) const
+{
+  if(size_t(eventId) + 1 >= m_EventOffsets.size())
+    return {};
+
+  const ResourceId *begin = m_EventResources.data() + m_EventOffsets[eventId];
+  const ResourceId *end = m_EventResources.data() + m_EventOffsets[eventId + 1];
+
+  rdcarray<ResourceId> ret;
+  ret.assign(begin, end - begin);
+  return ret;
+}
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+TEST_CASE("Test resource usage index", "[usageindex]")
+{
+  ResourceId tex = ResourceIDGen::GetNewUniqueID();
+  ResourceId buf = ResourceIDGen::GetNewUniqueID();
+  ResourceId unused = ResourceIDGen::GetNewUniqueID();
+  ResourceId view = ResourceIDGen::GetNewUniqueID();
+
+  rdcarray<ResourceId> fetched;
+
+  UsageIndex index;
+  CHECK(!index.IsBuilt());
+
+  index.Build({tex, buf, unused, tex}, [&](ResourceId id) {
+    fetched.push_back(id);
+
+    rdcarray<EventUsage> ret;
+    if(id == tex)
+    {
+      // deliberately out of order, as from a secondary command buffer
+      ret.push_back(EventUsage(10, ResourceUsage::PS_Resource, view));
+      ret.push_back(EventUsage(3, ResourceUsage::Clear));
+      ret.push_back(EventUsage(5, ResourceUsage::ColorTarget));
+      ret.push_back(EventUsage(5, ResourceUsage::PS_Resource));
+      ret.push_back(EventUsage(20, ResourceUsage::CopyDst));
+    }
+    else if(id == buf)
+    {
+      ret.push_back(EventUsage(5, ResourceUsage::VertexBuffer));
+      ret.push_back(EventUsage(12, ResourceUsage::VS_Constants));
+    }
+    return ret;
+  });
+
+  CHECK(index.IsBuilt());
+
+  // each resource is only fetched once
+  CHECK((fetched == rdcarray<ResourceId>({tex, buf, unused})));
+
+  SECTION("Full usage")
+  {
+    rdcarray<EventUsage> usage = index.GetUsage(tex);
+    REQUIRE(usage.size() == 5);
+    CHECK(usage[0].eventId == 3);
+    CHECK(usage[1].eventId == 5);
+    CHECK(usage[1].usage == ResourceUsage::ColorTarget);
+    CHECK(usage[2].eventId == 5);
+    CHECK(usage[2].usage == ResourceUsage::PS_Resource);
+    CHECK(usage[3].eventId == 10);
+    CHECK(usage[3].view == view);
+    CHECK(usage[4].eventId == 20);
+
+    CHECK(index.GetUsage(unused).empty());
+    CHECK(index.Contains(unused));
+    CHECK(!index.Contains(view));
+    CHECK(index.GetUsage(view).empty());
+  };
+
+  SECTION("Range queries")
+  {
+    CHECK(index.GetUsageInRange(tex, 4, 10).size() == 3);
+    CHECK(index.GetUsageInRange(tex, 5, 5).size() == 2);
+    CHECK(index.GetUsageInRange(tex, 6, 9).empty());
+    CHECK(index.GetUsageInRange(tex, 0, 3).size() == 1);
+    CHECK(index.GetUsageInRange(tex, 21, ~0U).empty());
+    CHECK(index.GetUsageInRange(tex, 10, 4).empty());
+    CHECK(index.GetUsageInRange(buf, 0, 100).size() == 2);
+  };
+
+  SECTION("First write")
+  {
+    CHECK(index.GetFirstWriteAfter(tex, 0).eventId == 3);
+    CHECK(index.GetFirstWriteAfter(tex, 3).eventId == 5);
+    CHECK(index.GetFirstWriteAfter(tex, 3).usage == ResourceUsage::ColorTarget);
+    CHECK(index.GetFirstWriteAfter(tex, 5).eventId == 20);
+    CHECK(index.GetFirstWriteAfter(tex, 20).eventId == 0);
+    CHECK(index.GetFirstWriteAfter(tex, ~0U).eventId == 0);
+    CHECK(index.GetFirstWriteAfter(buf, 0).eventId == 0);
+    CHECK(index.GetFirstWriteAfter(view, 0).eventId == 0);
+  };
+
+  SECTION("Usage masks")
+  {
+    CHECK(index.GetUsageMask(buf) == (UsageIndex::UsageBit(ResourceUsage::VertexBuffer) |
+                                      UsageIndex::UsageBit(ResourceUsage::VS_Constants)));
+    CHECK(index.GetUsageMask(unused) == 0);
+    CHECK(UsageIndex::IsWrite(ResourceUsage::CS_RWResource));
+    CHECK(!UsageIndex::IsWrite(ResourceUsage::CopySrc));
+  };
+
+  SECTION("Event to resources")
+  {
+    rdcarray<ResourceId> expected = {tex, buf};
+    std::sort(expected.begin(), expected.end());
+
+    CHECK((index.GetResourcesUsedByEvent(5) == expected));
+    CHECK((index.GetResourcesUsedByEvent(3) == rdcarray<ResourceId>({tex})));
+    CHECK((index.GetResourcesUsedByEvent(12) == rdcarray<ResourceId>({buf})));
+    CHECK(index.GetResourcesUsedByEvent(4).empty());
+    CHECK(index.GetResourcesUsedByEvent(20).size() == 1);
+    CHECK(index.GetResourcesUsedByEvent(21).empty());
+    CHECK(index.GetResourcesUsedByEvent(~0U).empty());
+  };
+
+  SECTION("Clear")
+  {
+    index.Clear();
+    CHECK(!index.IsBuilt());
+    CHECK(index.GetUsage(tex).empty());
+    CHECK(index.GetResourcesUsedByEvent(5).empty());
+  };
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
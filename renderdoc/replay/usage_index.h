@@ -0,0 +1,92 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+
+#pragma once
+
+#include <functional>
+#include <unordered_map>
+#include "api/replay/data_types.h"
+#include "api/replay/rdcpair.h"
+
+// A columnar index of how every resource is used across the capture, so that resource inspection
+// and pixel history don't need to fetch and scan the whole usage list for each query. It's built
+// once from the driver's usage lists and is then read-only.
+//
+// Each resource's usages are stored sorted by event ID in shared arrays, along with a bitmask of
+// the kinds of usage it has. There is also a reverse table from each event to the resources it
+// uses.
+class UsageIndex
+{
+public:
+  typedef std::function<rdcarray<EventUsage>(ResourceId)> UsageFetcher;
+
+  void Build(const rdcarray<ResourceId> &resources, UsageFetcher fetchUsage);
+  void Clear();
+  bool IsBuilt() const { return m_Built; }
+  bool Contains(ResourceId id) const { return m_Resources.find(id) != m_Resources.end(); }
+  // all usages of a resource, sorted by event ID
+  rdcarray<EventUsage> GetUsage(ResourceId id) const;
+  // usages of a resource in the inclusive range of events [firstEventId, lastEventId]
+  rdcarray<EventUsage> GetUsageInRange(ResourceId id, uint32_t firstEventId,
+                                       uint32_t lastEventId) const;
+  // the first usage that writes to the resource in an event after eventId. If there is none the
+  // returned usage has an eventId of 0.
+  EventUsage GetFirstWriteAfter(ResourceId id, uint32_t eventId) const;
+  // a mask with bit N set if the resource has any usage of ResourceUsage(N)
+  uint64_t GetUsageMask(ResourceId id) const;
+  // the sorted list of resources used by an event
+  rdcarray<ResourceId> GetResourcesUsedByEvent(uint32_t eventId) const;
+
+  static bool IsWrite(ResourceUsage usage) { return (WriteMask & UsageBit(usage)) != 0; }
+  static constexpr uint64_t UsageBit(ResourceUsage usage) { return 1ULL << uint32_t(usage); }
+
+private:
+  static const uint64_t WriteMask;
+
+  struct ResourceUsages
+  {
+    uint32_t offset;
+    uint32_t count;
+    uint64_t mask;
+  };
+
+  // returns the range of usage indices for a resource with events in [firstEventId, lastEventId]
+  rdcpair<size_t, size_t> FindRange(const ResourceUsages &res, uint32_t firstEventId,
+                                    uint32_t lastEventId) const;
+
+  std::unordered_map<ResourceId, ResourceUsages> m_Resources;
+
+  // the usages for all resources, each resource's range is contiguous
+  rdcarray<uint32_t> m_EventIds;
+  rdcarray<ResourceUsage> m_Usages;
+  rdcarray<ResourceId> m_Views;
+
+  // for event N the resources it uses are m_EventResources[m_EventOffsets[N]] up to
+  // m_EventResources[m_EventOffsets[N + 1]]
+  rdcarray<uint32_t> m_EventOffsets;
+  rdcarray<ResourceId> m_EventResources;
+
+  bool m_Built = false;
+};
@@ -0,0 +1,742 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#define ZSTD_STATIC_LINKING_ONLY
+#include "adaptiveio.h"
+#include "common/timing.h"
+
+template <>
+rdcstr DoStringise(const NetworkCodec &el)
+{
+  BEGIN_ENUM_STRINGISE(NetworkCodec);
+  {
+    STRINGISE_ENUM_CLASS(None);
+    STRINGISE_ENUM_CLASS(LZ4);
+    STRINGISE_ENUM_CLASS(ZSTD);
+    STRINGISE_ENUM_CLASS(Count);
+  }
+  END_ENUM_STRINGISE();
+}
+
+// Each block is written as:
+//   uint8_t   codec, with historyFlag set if it was compressed against the connection's history
+//   uint8_t   history generation
+//   uint32_t  uncompressed size, at most adaptiveBlockSize
+//   uint32_t  compressed size
+//   uint32_t  history position, only if historyFlag is set
+//   byte[]    compressed data, or the raw data for NetworkCodec::None
+static const uint64_t adaptiveBlockSize = 128 * 1024;
+static const uint64_t compressBlockSize =
+    RDCMAX((uint64_t)ZSTD_compressBound(adaptiveBlockSize),
+           (uint64_t)LZ4_COMPRESSBOUND(adaptiveBlockSize));
+
+static const byte historyFlag = 0x80;
+
+// how much previously sent data is kept as a dictionary. Only blocks smaller than this are
+// compressed against it - larger blocks have enough context of their own and loading the
+// dictionary would cost more than it gains.
+// The history carries across messages, and the sender resets it at the start of each bulk stream
+// where it would be pushed out anyway. The generation in each block header tells the receiver
+// when that happened, and the position lets it check it has seen every block since.
+static const uint64_t historySize = 64 * 1024;
+
+// blocks smaller than this are dominated by fixed overheads and don't give useful timings or
+// ratios, so they don't update the estimates and never explore other choices.
+static const uint64_t minimumSampleSize = 16 * 1024;
+
+// every this many blocks we try a choice next to the current best, so that estimates for the
+// others don't go stale when the data or the link changes.
+static const uint32_t explorePeriod = 16;
+
+static const double estimateWeight = 0.25;
+
+AdaptiveCodec::AdaptiveCodec(uint32_t allowedCodecs) : m_Allowed(allowedCodecs)
+{
+  // initial estimates, refined as soon as real blocks are sent. The link estimate starts at
+  // roughly gigabit ethernet.
+  m_Choices = {
+      {NetworkCodec::None, 0, 1.0e12, 1.0},    {NetworkCodec::LZ4, 1, 600.0e6, 0.55},
+      {NetworkCodec::ZSTD, 1, 350.0e6, 0.42},  {NetworkCodec::ZSTD, 3, 200.0e6, 0.39},
+      {NetworkCodec::ZSTD, 7, 70.0e6, 0.36},   {NetworkCodec::ZSTD, 15, 15.0e6, 0.34},
+  };
+
+  m_LinkBytesPerSec = 100.0e6;
+}
+
+AdaptiveCodec::~AdaptiveCodec()
+{
+  if(m_LZ4Comp)
+    LZ4_freeStream(m_LZ4Comp);
+  if(m_ZSTDComp)
+    ZSTD_freeCCtx(m_ZSTDComp);
+  if(m_ZSTDDecomp)
+    ZSTD_freeDCtx(m_ZSTDDecomp);
+}
+
+NetworkCodec AdaptiveCodec::GetPreferredCodec()
+{
+  // pick the best without advancing the exploration counter
+  uint32_t counter = m_BlockCounter;
+  size_t choice = ChooseCodec(0);
+  m_BlockCounter = counter;
+  return m_Choices[choice].codec;
+}
+
+size_t AdaptiveCodec::ChooseCodec(uint64_t blockSize)
+{
+  // compressing one block overlaps with the socket sending the previous one, so the throughput of
+  // each choice is mostly determined by whichever is slower. The overlap is never perfect though,
+  // so some of the compression time is added on top - that also means that when compression
+  // doesn't gain anything we don't do it.
+  double bestCost = 0.0;
+  m_Best = 0;
+
+  for(size_t i = 0; i < m_Choices.size(); i++)
+  {
+    const Choice &c = m_Choices[i];
+
+    if(c.codec != NetworkCodec::None && (m_Allowed & NetworkCodecBit(c.codec)) == 0)
+      continue;
+
+    double compressCost = 1.0 / c.bytesPerSec;
+    double cost = RDCMAX(compressCost, c.ratio / m_LinkBytesPerSec) + compressCost * 0.25;
+
+    if(i == 0 || cost < bestCost)
+    {
+      bestCost = cost;
+      m_Best = i;
+    }
+  }
+
+  if(blockSize < minimumSampleSize)
+    return m_Best;
+
+  m_BlockCounter++;
+
+  if(m_BlockCounter % explorePeriod != 0)
+    return m_Best;
+
+  // alternate between trying the next cheaper and the next stronger choice
+  bool stronger = ((m_BlockCounter / explorePeriod) & 1) != 0;
+
+  for(size_t i = m_Best; stronger ? i + 1 < m_Choices.size() : i > 0;)
+  {
+    i = stronger ? i + 1 : i - 1;
+
+    const Choice &c = m_Choices[i];
+    if(c.codec == NetworkCodec::None || (m_Allowed & NetworkCodecBit(c.codec)) != 0)
+      return i;
+  }
+
+  return m_Best;
+}
+
+void AdaptiveCodec::RecordBlock(size_t choice, uint64_t rawSize, uint64_t compSize,
+                                double compressSeconds, double writeSeconds)
+{
+  if(rawSize < minimumSampleSize)
+    return;
+
+  Choice &c = m_Choices[choice];
+
+  c.ratio += (double(compSize) / double(rawSize) - c.ratio) * estimateWeight;
+
+  if(c.codec != NetworkCodec::None && compressSeconds > 0.0)
+    c.bytesPerSec += (double(rawSize) / compressSeconds - c.bytesPerSec) * estimateWeight;
+
+  double totalSeconds = compressSeconds + writeSeconds;
+
+  if(totalSeconds <= 0.0)
+    return;
+
+  // if the write blocked for a significant time then the socket is the bottleneck. Compression of
+  // this block overlapped with sending the previous one, so the real link throughput is over the
+  // whole time.
+  // Otherwise the write was absorbed by buffering and all we know is that the link is faster than
+  // the write itself, so we raise the estimate - but only gradually so one well-buffered write
+  // doesn't throw it off completely. This also means that if compression is the bottleneck we
+  // slowly move towards cheaper choices until the link is saturated again.
+  if(writeSeconds > totalSeconds * 0.1)
+  {
+    double sample = double(compSize) / totalSeconds;
+    m_LinkBytesPerSec += (sample - m_LinkBytesPerSec) * estimateWeight;
+  }
+  else
+  {
+    double sample = double(compSize) / RDCMAX(writeSeconds, 1.0e-9);
+    m_LinkBytesPerSec = RDCMAX(m_LinkBytesPerSec, RDCMIN(sample, m_LinkBytesPerSec * 2.0));
+  }
+
+  m_LinkBytesPerSec = RDCCLAMP(m_LinkBytesPerSec, 1.0e3, 1.0e11);
+}
+
+void AdaptiveCodec::ResetHistory()
+{
+  m_History.clear();
+  m_HistoryPosition = 0;
+  m_HistoryGeneration++;
+}
+
+void AdaptiveCodec::SyncHistory(uint8_t generation)
+{
+  if(generation == m_HistoryGeneration)
+    return;
+
+  m_History.clear();
+  m_HistoryPosition = 0;
+  m_HistoryGeneration = generation;
+}
+
+void AdaptiveCodec::AppendHistory(const byte *data, uint64_t size)
+{
+  m_HistoryPosition += size;
+
+  if(size >= historySize)
+  {
+    m_History.clear();
+    m_History.append(data + size - historySize, (size_t)historySize);
+    return;
+  }
+
+  uint64_t keep = RDCMIN((uint64_t)m_History.size(), historySize - size);
+  m_History.erase(0, m_History.size() - (size_t)keep);
+  m_History.append(data, (size_t)size);
+}
+
+AdaptiveCompressor::AdaptiveCompressor(StreamWriter *write, AdaptiveCodec &codec, Ownership own)
+    : Compressor(write, own), m_Codec(codec)
+{
+  m_Page = AllocAlignedBuffer(adaptiveBlockSize);
+  m_CompressBuffer = AllocAlignedBuffer(compressBlockSize);
+
+  m_PageOffset = 0;
+}
+
+AdaptiveCompressor::~AdaptiveCompressor()
+{
+  FreeAlignedBuffer(m_Page);
+  FreeAlignedBuffer(m_CompressBuffer);
+}
+
+bool AdaptiveCompressor::Write(const void *data, uint64_t numBytes)
+{
+  // if we encountered a stream error this will be NULL
+  if(!m_CompressBuffer)
+    return false;
+
+  if(numBytes == 0)
+    return true;
+
+  // this is largely similar to ZSTDCompressor, each page is compressed independently (apart from
+  // the connection's history for small pages).
+
+  if(m_PageOffset + numBytes <= adaptiveBlockSize)
+  {
+    // simplest path, no page wrapping/spanning at all
+    memcpy(m_Page + m_PageOffset, data, (size_t)numBytes);
+    m_PageOffset += numBytes;
+
+    return true;
+  }
+
+  const byte *src = (const byte *)data;
+
+  // copy whatever will fit on this page
+  {
+    uint64_t firstBytes = adaptiveBlockSize - m_PageOffset;
+    memcpy(m_Page + m_PageOffset, src, (size_t)firstBytes);
+
+    m_PageOffset += firstBytes;
+    numBytes -= firstBytes;
+    src += firstBytes;
+  }
+
+  bool success = true;
+
+  while(success && numBytes > 0)
+  {
+    success &= FlushPage();
+
+    if(!success)
+      return success;
+
+    uint64_t partialBytes = RDCMIN(adaptiveBlockSize, numBytes);
+    memcpy(m_Page, src, (size_t)partialBytes);
+
+    m_PageOffset += partialBytes;
+    numBytes -= partialBytes;
+    src += partialBytes;
+  }
+
+  return success;
+}
+
+bool AdaptiveCompressor::Finish()
+{
+  // only the last page can be partial. Calling Write() after Finish() is illegal
+  if(m_PageOffset == 0)
+    return m_CompressBuffer != NULL;
+
+  return FlushPage();
+}
+
+bool AdaptiveCompressor::FlushPage()
+{
+  // if we encountered a stream error this will be NULL
+  if(!m_CompressBuffer)
+    return false;
+
+  const size_t choiceIdx = m_Codec.ChooseCodec(m_PageOffset);
+  const AdaptiveCodec::Choice &choice = m_Codec.m_Choices[choiceIdx];
+  const bytebuf &history = m_Codec.m_History;
+
+  NetworkCodec codec = choice.codec;
+  bool useHistory =
+      codec != NetworkCodec::None && m_PageOffset < historySize && !history.empty();
+
+  PerformanceTimer timer;
+
+  uint64_t compSize = 0;
+
+  if(codec == NetworkCodec::LZ4)
+  {
+    if(!m_Codec.m_LZ4Comp)
+      m_Codec.m_LZ4Comp = LZ4_createStream();
+
+    int ret = 0;
+
+    if(useHistory)
+    {
+      LZ4_loadDict(m_Codec.m_LZ4Comp, (const char *)history.data(), (int)history.size());
+      ret = LZ4_compress_fast_continue(m_Codec.m_LZ4Comp, (const char *)m_Page,
+                                       (char *)m_CompressBuffer, (int)m_PageOffset,
+                                       (int)compressBlockSize, choice.level);
+    }
+    else
+    {
+      ret = LZ4_compress_fast_extState(m_Codec.m_LZ4Comp, (const char *)m_Page,
+                                       (char *)m_CompressBuffer, (int)m_PageOffset,
+                                       (int)compressBlockSize, choice.level);
+    }
+
+    if(ret > 0)
+      compSize = (uint64_t)ret;
+  }
+  else if(codec == NetworkCodec::ZSTD)
+  {
+    if(!m_Codec.m_ZSTDComp)
+      m_Codec.m_ZSTDComp = ZSTD_createCCtx();
+
+    ZSTD_CCtx *cctx = m_Codec.m_ZSTDComp;
+
+    ZSTD_CCtx_reset(cctx);
+#if ZSTD_VERSION_NUMBER >= 10400
+    size_t err = ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, choice.level);
+#else
+    // the bundled zstd predates ZSTD_compress2, this is the equivalent in its advanced API
+    size_t err = ZSTD_CCtx_setParameter(cctx, ZSTD_p_compressionLevel, (unsigned)choice.level);
+#endif
+
+    // the prefix only applies to the next frame, so it must be set every time
+    if(!ZSTD_isError(err) && useHistory)
+      err = ZSTD_CCtx_refPrefix(cctx, history.data(), history.size());
+
+#if ZSTD_VERSION_NUMBER >= 10400
+    if(!ZSTD_isError(err))
+    {
+      err = ZSTD_compress2(cctx, m_CompressBuffer, (size_t)compressBlockSize, m_Page,
+                           (size_t)m_PageOffset);
+      if(!ZSTD_isError(err))
+        compSize = err;
+    }
+#else
+    size_t dstPos = 0, srcPos = 0;
+    if(!ZSTD_isError(err))
+      err = ZSTD_compress_generic_simpleArgs(cctx, m_CompressBuffer, (size_t)compressBlockSize,
+                                             &dstPos, m_Page, (size_t)m_PageOffset, &srcPos,
+                                             ZSTD_e_end);
+
+    // a non-zero return means the frame isn't complete, which can't happen with a big enough
+    // output buffer
+    if(!ZSTD_isError(err) && err == 0)
+      compSize = dstPos;
+#endif
+  }
+
+  // if compression failed or didn't gain anything, send the data as-is. This isn't an error, and
+  // the estimates learn that this choice doesn't work on this data.
+  const byte *payload = m_CompressBuffer;
+  uint64_t recordedSize = compSize;
+  if(compSize == 0 || compSize >= m_PageOffset)
+  {
+    codec = NetworkCodec::None;
+    useHistory = false;
+    payload = m_Page;
+    compSize = recordedSize = m_PageOffset;
+  }
+
+  double compressSeconds = timer.GetMilliseconds() / 1000.0;
+
+  timer.Restart();
+
+  byte flags = byte(codec) | (useHistory ? historyFlag : 0);
+  uint32_t rawSize32 = (uint32_t)m_PageOffset;
+  uint32_t compSize32 = (uint32_t)compSize;
+
+  bool success = true;
+
+  success &= m_Write->Write(flags);
+  success &= m_Write->Write(m_Codec.m_HistoryGeneration);
+  success &= m_Write->Write(rawSize32);
+  success &= m_Write->Write(compSize32);
+  if(useHistory)
+    success &= m_Write->Write((uint32_t)m_Codec.m_HistoryPosition);
+  success &= m_Write->Write(payload, compSize);
+
+  if(!success)
+  {
+    m_Error = m_Write->GetError();
+    FreeAlignedBuffer(m_Page);
+    FreeAlignedBuffer(m_CompressBuffer);
+    m_Page = m_CompressBuffer = NULL;
+    return false;
+  }
+
+  double writeSeconds = timer.GetMilliseconds() / 1000.0;
+
+  m_Codec.RecordBlock(choiceIdx, m_PageOffset, recordedSize, compressSeconds, writeSeconds);
+
+  m_Codec.AppendHistory(m_Page, m_PageOffset);
+
+  m_PageOffset = 0;
+
+  return success;
+}
+
+AdaptiveDecompressor::AdaptiveDecompressor(StreamReader *read, AdaptiveCodec &codec, Ownership own)
+    : Decompressor(read, own), m_Codec(codec)
+{
+  m_Page = AllocAlignedBuffer(adaptiveBlockSize);
+  m_CompressBuffer = AllocAlignedBuffer(compressBlockSize);
+
+  m_PageOffset = 0;
+  m_PageLength = 0;
+}
+
+AdaptiveDecompressor::~AdaptiveDecompressor()
+{
+  FreeBuffers();
+}
+
+void AdaptiveDecompressor::FreeBuffers()
+{
+  FreeAlignedBuffer(m_Page);
+  FreeAlignedBuffer(m_CompressBuffer);
+  m_Page = m_CompressBuffer = NULL;
+}
+
+bool AdaptiveDecompressor::Recompress(Compressor *comp)
+{
+  bool success = true;
+
+  while(success && !m_Read->AtEnd())
+  {
+    success &= FillPage();
+    if(success)
+    {
+      success &= comp->Write(m_Page, m_PageLength);
+
+      if(!success)
+        m_Error = comp->GetError();
+    }
+  }
+  success &= comp->Finish();
+
+  return success;
+}
+
+bool AdaptiveDecompressor::Read(void *data, uint64_t numBytes)
+{
+  // if we encountered a stream error this will be NULL
+  if(!m_CompressBuffer)
+    return false;
+
+  if(numBytes == 0)
+    return true;
+
+  // if we already have all the data in-memory, just copy and return
+  uint64_t available = m_PageLength - m_PageOffset;
+
+  if(numBytes <= available)
+  {
+    memcpy(data, m_Page + m_PageOffset, (size_t)numBytes);
+    m_PageOffset += numBytes;
+    return true;
+  }
+
+  byte *dst = (byte *)data;
+
+  // copy what remains in m_Page
+  memcpy(dst, m_Page + m_PageOffset, (size_t)available);
+
+  dst += available;
+  numBytes -= available;
+
+  bool success = true;
+
+  while(success && numBytes > 0)
+  {
+    success &= FillPage();
+
+    if(!success)
+      return success;
+
+    // if we can now satisfy the remainder of the read, do so and return
+    if(numBytes <= m_PageLength)
+    {
+      memcpy(dst, m_Page, (size_t)numBytes);
+      m_PageOffset += numBytes;
+      return success;
+    }
+
+    // otherwise copy this page in and continue
+    memcpy(dst, m_Page, (size_t)m_PageLength);
+    dst += m_PageLength;
+    numBytes -= m_PageLength;
+  }
+
+  return success;
+}
+
+bool AdaptiveDecompressor::FillPage()
+{
+  byte flags = 0;
+  uint8_t generation = 0;
+  uint32_t rawSize = 0;
+  uint32_t compSize = 0;
+  uint32_t historyPosition = 0;
+
+  bool success = true;
+
+  success &= m_Read->Read(flags);
+  success &= m_Read->Read(generation);
+  success &= m_Read->Read(rawSize);
+  success &= m_Read->Read(compSize);
+
+  NetworkCodec codec = NetworkCodec(flags & ~historyFlag);
+  bool useHistory = (flags & historyFlag) != 0;
+
+  if(useHistory)
+    success &= m_Read->Read(historyPosition);
+
+  if(!success)
+  {
+    m_Error = m_Read->GetError();
+    FreeBuffers();
+    return false;
+  }
+
+  m_Codec.SyncHistory(generation);
+
+  const bytebuf &history = m_Codec.m_History;
+
+  if(codec >= NetworkCodec::Count || rawSize > adaptiveBlockSize ||
+     compSize > compressBlockSize || (codec == NetworkCodec::None && compSize != rawSize))
+  {
+    SET_ERROR_RESULT(m_Error, ResultCode::CompressionFailed,
+                     "Invalid compressed block: codec %u, %u bytes from %u bytes", flags & 0x7f,
+                     rawSize, compSize);
+    FreeBuffers();
+    return false;
+  }
+
+  // if we missed any block since the history was reset, decoding against it would silently give
+  // the wrong data
+  if(useHistory && (history.empty() || historyPosition != (uint32_t)m_Codec.m_HistoryPosition))
+  {
+    SET_ERROR_RESULT(m_Error, ResultCode::CompressionFailed,
+                     "Compressed block history out of sync: expected position %u, have %u",
+                     historyPosition, (uint32_t)m_Codec.m_HistoryPosition);
+    FreeBuffers();
+    return false;
+  }
+
+  if(codec == NetworkCodec::None)
+  {
+    success &= m_Read->Read(m_Page, rawSize);
+  }
+  else
+  {
+    success &= m_Read->Read(m_CompressBuffer, compSize);
+
+    if(success)
+    {
+      uint64_t decompSize = 0;
+
+      if(codec == NetworkCodec::LZ4)
+      {
+        int ret = 0;
+
+        if(useHistory)
+          ret = LZ4_decompress_safe_usingDict((const char *)m_CompressBuffer, (char *)m_Page,
+                                              (int)compSize, (int)adaptiveBlockSize,
+                                              (const char *)history.data(), (int)history.size());
+        else
+          ret = LZ4_decompress_safe((const char *)m_CompressBuffer, (char *)m_Page, (int)compSize,
+                                    (int)adaptiveBlockSize);
+
+        if(ret > 0)
+          decompSize = (uint64_t)ret;
+      }
+      else if(codec == NetworkCodec::ZSTD)
+      {
+        if(!m_Codec.m_ZSTDDecomp)
+          m_Codec.m_ZSTDDecomp = ZSTD_createDCtx();
+
+        size_t ret = 0;
+
+        if(useHistory)
+        {
+          // the history is a raw-content prefix, the same as ZSTD_CCtx_refPrefix on the other end
+          ZSTD_DDict *ddict =
+              ZSTD_createDDict_advanced(history.data(), history.size(), ZSTD_dlm_byRef,
+                                        ZSTD_dct_rawContent, ZSTD_defaultCMem);
+          ret = ZSTD_decompress_usingDDict(m_Codec.m_ZSTDDecomp, m_Page, (size_t)adaptiveBlockSize,
+                                           m_CompressBuffer, compSize, ddict);
+          ZSTD_freeDDict(ddict);
+        }
+        else
+        {
+          ret = ZSTD_decompressDCtx(m_Codec.m_ZSTDDecomp, m_Page, (size_t)adaptiveBlockSize,
+                                    m_CompressBuffer, compSize);
+        }
+
+        if(!ZSTD_isError(ret))
+          decompSize = ret;
+      }
+
+      if(decompSize != rawSize)
+      {
+        SET_ERROR_RESULT(m_Error, ResultCode::CompressionFailed,
+                         "Decompression failed on block: got %llu bytes, expected %u", decompSize,
+                         rawSize);
+        FreeBuffers();
+        return false;
+      }
+    }
+  }
+
+  if(!success)
+  {
+    m_Error = m_Read->GetError();
+    FreeBuffers();
+    return false;
+  }
+
+  m_Codec.AppendHistory(m_Page, rawSize);
+
+  m_PageOffset = 0;
+  m_PageLength = rawSize;
+
+  return success;
+}
+
+bool AdaptiveStreamSend(StreamWriter *writer, StreamReader *reader, AdaptiveCodec &codec,
+                        RENDERDOC_ProgressCallback progress)
+{
+  uint64_t size = reader->GetSize();
+
+  bool success = writer->Write(size);
+
+  // bulk data would push any history out quickly, so this is where it's reset. This gives the
+  // receiver a regular point to resynchronise if it ever skipped data.
+  codec.ResetHistory();
+
+  AdaptiveCompressor *comp = new AdaptiveCompressor(writer, codec, Ownership::Nothing);
+
+  {
+    StreamWriter compWriter(comp, Ownership::Nothing);
+
+    StreamTransfer(&compWriter, reader, progress);
+
+    success &= compWriter.Finish();
+  }
+
+  if(comp->GetError() != ResultCode::Succeeded)
+    RDCERR("Error compressing stream: %s", comp->GetError().message.c_str());
+
+  success &= comp->GetError() == ResultCode::Succeeded;
+
+  delete comp;
+
+  return success && !writer->IsErrored() && !reader->IsErrored();
+}
+
+bool AdaptiveStreamReceive(StreamReader *reader, StreamWriter *writer, AdaptiveCodec &codec,
+                           RENDERDOC_ProgressCallback progress)
+{
+  uint64_t size = 0;
+
+  if(!reader->Read(size))
+    return false;
+
+  StreamReader compReader(new AdaptiveDecompressor(reader, codec, Ownership::Nothing), size,
+                          Ownership::Stream);
+
+  StreamTransfer(writer, &compReader, progress);
+
+  if(compReader.IsErrored())
+    RDCERR("Error decompressing stream: %s", compReader.GetError().message.c_str());
+
+  return !compReader.IsErrored() && !reader->IsErrored() && !writer->IsErrored();
+}
+
+bool AdaptiveBufferSend(StreamWriter *writer, const bytebuf &data, AdaptiveCodec &codec)
+{
+  StreamReader reader(data);
+  return AdaptiveStreamSend(writer, &reader, codec);
+}
+
+bool AdaptiveBufferReceive(StreamReader *reader, bytebuf &data, AdaptiveCodec &codec)
+{
+  uint64_t size = 0;
+
+  if(!reader->Read(size))
+    return false;
+
+  data.resize((size_t)size);
+
+  StreamReader compReader(new AdaptiveDecompressor(reader, codec, Ownership::Nothing), size,
+                          Ownership::Stream);
+
+  compReader.Read(data.data(), size);
+
+  if(compReader.IsErrored())
+  {
+    RDCERR("Error decompressing buffer: %s", compReader.GetError().message.c_str());
+    data.clear();
+  }
+
+  return !compReader.IsErrored() && !reader->IsErrored();
+}
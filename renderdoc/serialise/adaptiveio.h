@@ -0,0 +1,177 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include "lz4/lz4.h"
+#include "zstd/zstd.h"
+#include "streamio.h"
+
+enum class NetworkCodec : uint8_t
+{
+  None = 0,
+  LZ4,
+  ZSTD,
+  Count,
+};
+
+DECLARE_REFLECTION_ENUM(NetworkCodec);
+
+constexpr uint32_t NetworkCodecBit(NetworkCodec codec)
+{
+  return 1U << uint32_t(codec);
+}
+
+// the bitmask of codecs this build can encode and decode. Connections exchange this during their
+// handshake and only use the intersection, so either end can disable compression.
+constexpr uint32_t SupportedNetworkCodecs()
+{
+  return NetworkCodecBit(NetworkCodec::None) | NetworkCodecBit(NetworkCodec::LZ4) |
+         NetworkCodecBit(NetworkCodec::ZSTD);
+}
+
+// State shared by every AdaptiveCompressor or AdaptiveDecompressor for one direction of one
+// connection. Each message gets its own compressor but they all feed the same statistics, and
+// the last few KB of data sent is kept on both ends as a dictionary so that small repetitive
+// messages compress against the previous ones.
+//
+// The dictionary persists for the whole connection. The sender resets it at the start of every
+// bulk stream, and each block carries the generation of the dictionary so the receiver resets
+// at the same point. Blocks that use the dictionary also carry how much data had been added to
+// it, so a receiver that skipped a message fails to decode rather than silently getting garbage.
+//
+// On the sending side this measures the link throughput and the speed and ratio of each codec,
+// and picks whichever is expected to get the data across fastest: nothing at all on a fast local
+// link or for incompressible data, up to the higher zstd levels on a slow link.
+//
+// Messages must be decoded in the same order they were encoded, so one codec must only be used
+// for one stream direction and never shared between threads.
+class AdaptiveCodec
+{
+public:
+  AdaptiveCodec(uint32_t allowedCodecs = SupportedNetworkCodecs());
+  ~AdaptiveCodec();
+
+  AdaptiveCodec(const AdaptiveCodec &) = delete;
+  AdaptiveCodec &operator=(const AdaptiveCodec &) = delete;
+
+  void SetAllowedCodecs(uint32_t allowedCodecs) { m_Allowed = allowedCodecs; }
+  uint32_t GetAllowedCodecs() const { return m_Allowed; }
+  // the current estimate of link throughput in bytes per second
+  double GetLinkThroughput() const { return m_LinkBytesPerSec; }
+  // the codec that would be chosen for the next full-sized block
+  NetworkCodec GetPreferredCodec();
+  // discard the dictionary, the next block sent tells the receiver to do the same
+  void ResetHistory();
+
+private:
+  friend class AdaptiveCompressor;
+  friend class AdaptiveDecompressor;
+
+  struct Choice
+  {
+    NetworkCodec codec;
+    int level;
+    // estimated compression speed in uncompressed bytes per second
+    double bytesPerSec;
+    // estimated compressed size / uncompressed size
+    double ratio;
+  };
+
+  size_t ChooseCodec(uint64_t blockSize);
+  void RecordBlock(size_t choice, uint64_t rawSize, uint64_t compSize, double compressSeconds,
+                   double writeSeconds);
+  void AppendHistory(const byte *data, uint64_t size);
+  void SyncHistory(uint8_t generation);
+
+  uint32_t m_Allowed;
+
+  rdcarray<Choice> m_Choices;
+  size_t m_Best = 0;
+  uint32_t m_BlockCounter = 0;
+
+  double m_LinkBytesPerSec;
+
+  bytebuf m_History;
+  // incremented each time the history is reset
+  uint8_t m_HistoryGeneration = 0;
+  // total bytes added to the history since it was last reset
+  uint64_t m_HistoryPosition = 0;
+
+  LZ4_stream_t *m_LZ4Comp = NULL;
+  ZSTD_CCtx *m_ZSTDComp = NULL;
+  ZSTD_DCtx *m_ZSTDDecomp = NULL;
+};
+
+class AdaptiveCompressor : public Compressor
+{
+public:
+  AdaptiveCompressor(StreamWriter *write, AdaptiveCodec &codec, Ownership own);
+  ~AdaptiveCompressor();
+
+  bool Write(const void *data, uint64_t numBytes);
+  bool Finish();
+
+private:
+  bool FlushPage();
+
+  AdaptiveCodec &m_Codec;
+
+  byte *m_Page;
+  byte *m_CompressBuffer;
+  uint64_t m_PageOffset;
+};
+
+class AdaptiveDecompressor : public Decompressor
+{
+public:
+  AdaptiveDecompressor(StreamReader *read, AdaptiveCodec &codec, Ownership own);
+  ~AdaptiveDecompressor();
+
+  bool Recompress(Compressor *comp);
+  bool Read(void *data, uint64_t numBytes);
+
+private:
+  bool FillPage();
+  void FreeBuffers();
+
+  AdaptiveCodec &m_Codec;
+
+  byte *m_Page;
+  byte *m_CompressBuffer;
+  uint64_t m_PageOffset;
+  uint64_t m_PageLength;
+};
+
+// send the whole of reader through an adaptive compressor, preceded by its uncompressed size.
+bool AdaptiveStreamSend(StreamWriter *writer, StreamReader *reader, AdaptiveCodec &codec,
+                        RENDERDOC_ProgressCallback progress = RENDERDOC_ProgressCallback());
+
+// receive a stream sent by AdaptiveStreamSend into writer.
+bool AdaptiveStreamReceive(StreamReader *reader, StreamWriter *writer, AdaptiveCodec &codec,
+                           RENDERDOC_ProgressCallback progress = RENDERDOC_ProgressCallback());
+
+// as above, for data that's already in memory.
+bool AdaptiveBufferSend(StreamWriter *writer, const bytebuf &data, AdaptiveCodec &codec);
+bool AdaptiveBufferReceive(StreamReader *reader, bytebuf &data, AdaptiveCodec &codec);
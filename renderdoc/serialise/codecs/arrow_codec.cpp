@@ -0,0 +1,1304 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include <algorithm>
+#include "api/replay/structured_data.h"
+#include "common/common.h"
+#include "common/formatting.h"
+#include "core/settings.h"
+#include "serialise/rdcfile.h"
+#include "strings/string_utils.h"
+
+RDOC_CONFIG(rdcarray<rdcstr>, Export_ArrowParameters, {},
+            "Chunk parameters to add as extra columns when exporting to Apache Arrow. Each is a "
+            "path to a parameter within a chunk with members separated by '.', such as "
+            "'indexCount' or 'CreateInfo.size'. Chunks without the parameter get a null value.");
+
+// A minimal flatbuffers serialiser, with just enough to write the Arrow IPC metadata. Objects are
+// declared children first and each one may only be referenced once. On Finish() they're laid out
+// front to back from the root, so every offset points forward as flatbuffers requires.
+class FlatBufferBuilder
+{
+public:
+  typedef uint32_t Ref;
+
+  Ref String(const rdcstr &str)
+  {
+    Object &o = NewObject(ObjectType::String, 4);
+    o.data.assign((const byte *)str.c_str(), str.size());
+    return Ref(m_Objects.size() - 1);
+  }
+
+  template <typename T>
+  Ref StructVector(const rdcarray<T> &elems)
+  {
+    Object &o = NewObject(ObjectType::StructVector, RDCMAX((uint32_t)alignof(T), 4U));
+    o.data.assign((const byte *)elems.data(), elems.byteSize());
+    o.count = (uint32_t)elems.size();
+    return Ref(m_Objects.size() - 1);
+  }
+
+  Ref TableVector(const rdcarray<Ref> &tables)
+  {
+    Object &o = NewObject(ObjectType::TableVector, 4);
+    o.refs = tables;
+    return Ref(m_Objects.size() - 1);
+  }
+
+  // only one table can be under construction at once
+  void BeginTable() { m_Fields.clear(); }
+  template <typename T>
+  void AddScalar(uint16_t id, T value)
+  {
+    Field f = {};
+    f.id = id;
+    f.size = sizeof(T);
+    memcpy(&f.value, &value, sizeof(T));
+    m_Fields.push_back(f);
+  }
+
+  void AddRef(uint16_t id, Ref ref)
+  {
+    Field f = {};
+    f.id = id;
+    f.size = sizeof(uint32_t);
+    f.isRef = true;
+    f.ref = ref;
+    m_Fields.push_back(f);
+  }
+
+  Ref EndTable()
+  {
+    Object &o = NewObject(ObjectType::Table, 4);
+    o.fields.swap(m_Fields);
+    return Ref(m_Objects.size() - 1);
+  }
+
+  bytebuf Finish(Ref root)
+  {
+    bytebuf out;
+    rdcarray<rdcpair<uint32_t, Ref>> pending;
+
+    Write(out, uint32_t(0));
+    pending.push_back({0U, root});
+
+    // objects are emitted breadth first, always after whatever references them
+    for(size_t i = 0; i < pending.size(); i++)
+    {
+      uint32_t patch = pending[i].first;
+      uint32_t pos = Emit(out, pending[i].second, pending);
+      uint32_t offset = pos - patch;
+      memcpy(out.data() + patch, &offset, sizeof(offset));
+    }
+
+    return out;
+  }
+
+private:
+  enum class ObjectType
+  {
+    Table,
+    String,
+    StructVector,
+    TableVector,
+  };
+
+  struct Field
+  {
+    uint16_t id;
+    uint16_t size;
+    bool isRef;
+    Ref ref;
+    uint64_t value;
+  };
+
+  struct Object
+  {
+    ObjectType type;
+    uint32_t align;
+    uint32_t count;
+    bytebuf data;
+    rdcarray<Field> fields;
+    rdcarray<Ref> refs;
+  };
+
+  Object &NewObject(ObjectType type, uint32_t align)
+  {
+    m_Objects.push_back(Object());
+    Object &o = m_Objects.back();
+    o.type = type;
+    o.align = align;
+    o.count = 0;
+    return o;
+  }
+
+  template <typename T>
+  static void Write(bytebuf &out, T value)
+  {
+    out.append((const byte *)&value, sizeof(T));
+  }
+
+  static void Pad(bytebuf &out, uint32_t align, uint32_t offset = 0)
+  {
+    while((out.size() + offset) % align)
+      out.push_back(0);
+  }
+
+  uint32_t Emit(bytebuf &out, Ref ref, rdcarray<rdcpair<uint32_t, Ref>> &pending)
+  {
+    const Object &o = m_Objects[ref];
+
+    uint32_t pos = 0;
+
+    switch(o.type)
+    {
+      case ObjectType::String:
+      {
+        Pad(out, 4);
+        pos = (uint32_t)out.size();
+        Write(out, (uint32_t)o.data.size());
+        out.append(o.data);
+        out.push_back(0);
+        break;
+      }
+      case ObjectType::StructVector:
+      {
+        // the elements after the length need the struct's alignment
+        Pad(out, 4);
+        Pad(out, o.align, 4);
+        pos = (uint32_t)out.size();
+        Write(out, o.count);
+        out.append(o.data);
+        break;
+      }
+      case ObjectType::TableVector:
+      {
+        Pad(out, 4);
+        pos = (uint32_t)out.size();
+        Write(out, (uint32_t)o.refs.size());
+        for(Ref r : o.refs)
+        {
+          pending.push_back({(uint32_t)out.size(), r});
+          Write(out, uint32_t(0));
+        }
+        break;
+      }
+      case ObjectType::Table:
+      {
+        // lay out the fields after the vtable offset, largest first so they're naturally aligned
+        rdcarray<Field> fields = o.fields;
+        std::stable_sort(fields.begin(), fields.end(),
+                         [](const Field &a, const Field &b) { return a.size > b.size; });
+
+        uint16_t numSlots = 0;
+        for(const Field &f : fields)
+          numSlots = RDCMAX(numSlots, uint16_t(f.id + 1));
+
+        rdcarray<uint16_t> vtable;
+        vtable.resize(2 + numSlots);
+        for(uint16_t &v : vtable)
+          v = 0;
+
+        rdcarray<uint16_t> fieldOffsets;
+        uint16_t tableSize = sizeof(int32_t);
+        uint32_t tableAlign = sizeof(int32_t);
+        for(const Field &f : fields)
+        {
+          tableSize = AlignUp(tableSize, f.size);
+          vtable[2 + f.id] = tableSize;
+          fieldOffsets.push_back(tableSize);
+          tableSize += f.size;
+          tableAlign = RDCMAX(tableAlign, (uint32_t)f.size);
+        }
+
+        vtable[0] = uint16_t(vtable.byteSize());
+        vtable[1] = tableSize;
+
+        Pad(out, 2);
+        uint32_t vtablePos = (uint32_t)out.size();
+        out.append((const byte *)vtable.data(), vtable.byteSize());
+
+        Pad(out, tableAlign);
+        pos = (uint32_t)out.size();
+        out.resize(pos + tableSize);
+        memset(out.data() + pos, 0, tableSize);
+
+        int32_t vtableOffset = int32_t(pos - vtablePos);
+        memcpy(out.data() + pos, &vtableOffset, sizeof(vtableOffset));
+
+        for(size_t i = 0; i < fields.size(); i++)
+        {
+          if(fields[i].isRef)
+            pending.push_back({pos + fieldOffsets[i], fields[i].ref});
+          else
+            memcpy(out.data() + pos + fieldOffsets[i], &fields[i].value, fields[i].size);
+        }
+        break;
+      }
+    }
+
+    return pos;
+  }
+
+  rdcarray<Object> m_Objects;
+  rdcarray<Field> m_Fields;
+};
+
+enum class ArrowType
+{
+  UInt32,
+  UInt64,
+  Int64,
+  Float64,
+  Bool,
+  Utf8,
+  UInt64List,
+};
+
+// one column's data for the record batch being built
+struct ArrowColumn
+{
+  rdcstr name;
+  ArrowType type;
+  bool nullable;
+
+  uint64_t nullCount;
+  bytebuf validity;
+  // int32 offsets into values for strings and lists
+  bytebuf offsets;
+  bytebuf values;
+
+  void Reset()
+  {
+    nullCount = 0;
+    validity.clear();
+    offsets.clear();
+    values.clear();
+
+    if(type == ArrowType::Utf8 || type == ArrowType::UInt64List)
+      AppendOffset();
+  }
+
+  void AppendOffset()
+  {
+    int32_t offs = int32_t(type == ArrowType::UInt64List ? values.size() / sizeof(uint64_t)
+                                                           : values.size());
+    offsets.append((const byte *)&offs, sizeof(offs));
+  }
+
+  static void SetBit(bytebuf &bits, uint32_t row, bool set)
+  {
+    if(row / 8 >= bits.size())
+      bits.push_back(0);
+    if(set)
+      bits[row / 8] |= byte(1 << (row % 8));
+  }
+
+  void AppendNull(uint32_t row)
+  {
+    nullCount++;
+    SetBit(validity, row, false);
+
+    switch(type)
+    {
+      case ArrowType::UInt32: values.resize(values.size() + sizeof(uint32_t)); break;
+      case ArrowType::UInt64:
+      case ArrowType::Int64:
+      case ArrowType::Float64: values.resize(values.size() + sizeof(uint64_t)); break;
+      case ArrowType::Bool: SetBit(values, row, false); break;
+      case ArrowType::Utf8:
+      case ArrowType::UInt64List: AppendOffset(); break;
+    }
+  }
+
+  template <typename T>
+  void Append(uint32_t row, T value)
+  {
+    SetBit(validity, row, true);
+    values.append((const byte *)&value, sizeof(T));
+  }
+
+  void AppendBool(uint32_t row, bool value)
+  {
+    SetBit(validity, row, true);
+    SetBit(values, row, value);
+  }
+
+  void AppendString(uint32_t row, const rdcstr &str)
+  {
+    SetBit(validity, row, true);
+    values.append((const byte *)str.c_str(), str.size());
+    AppendOffset();
+  }
+
+  void AppendList(uint32_t row, const rdcarray<uint64_t> &list)
+  {
+    SetBit(validity, row, true);
+    values.append((const byte *)list.data(), list.byteSize());
+    AppendOffset();
+  }
+};
+
+struct ArrowBlock
+{
+  int64_t offset;
+  int32_t metaDataLength;
+  int32_t padding;
+  int64_t bodyLength;
+};
+
+struct ArrowFieldNode
+{
+  int64_t length;
+  int64_t nullCount;
+};
+
+struct ArrowBuffer
+{
+  int64_t offset;
+  int64_t length;
+};
+
+// Writes the Arrow IPC file format, which is also what Feather v2 files are: a schema message
+// followed by record batches, then a footer indexing them for random access.
+class ArrowFileWriter
+{
+public:
+  ArrowFileWriter(StreamWriter &stream) : m_Stream(stream)
+  {
+    m_Stream.Write("ARROW1\0\0", 8);
+  }
+
+  void WriteSchema(const rdcarray<ArrowColumn> &columns,
+                   const rdcarray<rdcpair<rdcstr, rdcstr>> &metadata)
+  {
+    FlatBufferBuilder fb;
+    FlatBufferBuilder::Ref schema = BuildSchema(fb, columns, metadata);
+    WriteMessage(BuildMessage(fb, MessageHeader_Schema, schema, 0), 0);
+  }
+
+  void WriteBatch(const rdcarray<ArrowColumn> &columns, uint32_t rows)
+  {
+    rdcarray<ArrowFieldNode> nodes;
+    rdcarray<ArrowBuffer> buffers;
+    rdcarray<const bytebuf *> contents;
+    int64_t bodyLength = 0;
+
+    auto addBuffer = [&](const bytebuf *buf) {
+      int64_t length = buf ? (int64_t)buf->size() : 0;
+      buffers.push_back({bodyLength, length});
+      contents.push_back(buf);
+      bodyLength += AlignUp(length, (int64_t)8);
+    };
+
+    // buffers are listed depth first, each column with its validity bitmap first. The bitmap can
+    // be omitted if nothing is null.
+    for(const ArrowColumn &col : columns)
+    {
+      nodes.push_back({rows, (int64_t)col.nullCount});
+      addBuffer(col.nullCount > 0 ? &col.validity : NULL);
+
+      if(col.type == ArrowType::Utf8)
+      {
+        addBuffer(&col.offsets);
+      }
+      else if(col.type == ArrowType::UInt64List)
+      {
+        addBuffer(&col.offsets);
+        nodes.push_back({int64_t(col.values.size() / sizeof(uint64_t)), 0});
+        addBuffer(NULL);
+      }
+
+      addBuffer(&col.values);
+    }
+
+    FlatBufferBuilder fb;
+    FlatBufferBuilder::Ref nodesRef = fb.StructVector(nodes);
+    FlatBufferBuilder::Ref buffersRef = fb.StructVector(buffers);
+
+    fb.BeginTable();
+    fb.AddScalar<int64_t>(RecordBatch_length, rows);
+    fb.AddRef(RecordBatch_nodes, nodesRef);
+    fb.AddRef(RecordBatch_buffers, buffersRef);
+    FlatBufferBuilder::Ref batch = fb.EndTable();
+
+    m_Blocks.push_back(
+        WriteMessage(BuildMessage(fb, MessageHeader_RecordBatch, batch, bodyLength), bodyLength));
+
+    for(const bytebuf *buf : contents)
+    {
+      if(!buf)
+        continue;
+
+      m_Stream.Write(buf->data(), buf->size());
+      WritePadding(buf->size());
+    }
+  }
+
+  RDResult Finish(const rdcarray<ArrowColumn> &columns,
+                  const rdcarray<rdcpair<rdcstr, rdcstr>> &metadata)
+  {
+    // end of stream marker, so the messages can also be read as an IPC stream
+    m_Stream.Write(0xFFFFFFFFU);
+    m_Stream.Write(0U);
+
+    FlatBufferBuilder fb;
+    FlatBufferBuilder::Ref schema = BuildSchema(fb, columns, metadata);
+    FlatBufferBuilder::Ref dictionaries = fb.StructVector(rdcarray<ArrowBlock>());
+    FlatBufferBuilder::Ref batches = fb.StructVector(m_Blocks);
+
+    fb.BeginTable();
+    fb.AddScalar<int16_t>(Footer_version, MetadataVersion_V5);
+    fb.AddRef(Footer_schema, schema);
+    fb.AddRef(Footer_dictionaries, dictionaries);
+    fb.AddRef(Footer_recordBatches, batches);
+    bytebuf footer = fb.Finish(fb.EndTable());
+
+    m_Stream.Write(footer.data(), footer.size());
+    m_Stream.Write((int32_t)footer.size());
+    m_Stream.Write("ARROW1", 6);
+
+    m_Stream.Finish();
+
+    return m_Stream.GetError();
+  }
+
+private:
+  // field indices of the tables we write, from the Arrow flatbuffers schemas
+  enum
+  {
+    Message_version = 0,
+    Message_header_type = 1,
+    Message_header = 2,
+    Message_bodyLength = 3,
+
+    Schema_endianness = 0,
+    Schema_fields = 1,
+    Schema_custom_metadata = 2,
+
+    Field_name = 0,
+    Field_nullable = 1,
+    Field_type_type = 2,
+    Field_type = 3,
+    Field_children = 5,
+
+    KeyValue_key = 0,
+    KeyValue_value = 1,
+
+    Int_bitWidth = 0,
+    Int_is_signed = 1,
+
+    FloatingPoint_precision = 0,
+
+    RecordBatch_length = 0,
+    RecordBatch_nodes = 1,
+    RecordBatch_buffers = 2,
+
+    Footer_version = 0,
+    Footer_schema = 1,
+    Footer_dictionaries = 2,
+    Footer_recordBatches = 3,
+  };
+
+  enum : uint8_t
+  {
+    MessageHeader_Schema = 1,
+    MessageHeader_RecordBatch = 3,
+
+    Type_Int = 2,
+    Type_FloatingPoint = 3,
+    Type_Utf8 = 5,
+    Type_Bool = 6,
+    Type_List = 12,
+  };
+
+  static const int16_t MetadataVersion_V5 = 4;
+  static const int16_t Precision_Double = 2;
+
+  static FlatBufferBuilder::Ref BuildField(FlatBufferBuilder &fb, const rdcstr &name,
+                                           ArrowType type, bool nullable)
+  {
+    FlatBufferBuilder::Ref nameRef = fb.String(name);
+
+    rdcarray<FlatBufferBuilder::Ref> children;
+    if(type == ArrowType::UInt64List)
+      children.push_back(BuildField(fb, "item", ArrowType::UInt64, false));
+    FlatBufferBuilder::Ref childrenRef = fb.TableVector(children);
+
+    uint8_t typeType = Type_Int;
+
+    fb.BeginTable();
+    switch(type)
+    {
+      case ArrowType::UInt32:
+        fb.AddScalar<int32_t>(Int_bitWidth, 32);
+        fb.AddScalar<uint8_t>(Int_is_signed, 0);
+        break;
+      case ArrowType::UInt64:
+        fb.AddScalar<int32_t>(Int_bitWidth, 64);
+        fb.AddScalar<uint8_t>(Int_is_signed, 0);
+        break;
+      case ArrowType::Int64:
+        fb.AddScalar<int32_t>(Int_bitWidth, 64);
+        fb.AddScalar<uint8_t>(Int_is_signed, 1);
+        break;
+      case ArrowType::Float64:
+        typeType = Type_FloatingPoint;
+        fb.AddScalar<int16_t>(FloatingPoint_precision, Precision_Double);
+        break;
+      case ArrowType::Bool: typeType = Type_Bool; break;
+      case ArrowType::Utf8: typeType = Type_Utf8; break;
+      case ArrowType::UInt64List: typeType = Type_List; break;
+    }
+    FlatBufferBuilder::Ref typeRef = fb.EndTable();
+
+    fb.BeginTable();
+    fb.AddRef(Field_name, nameRef);
+    fb.AddScalar<uint8_t>(Field_nullable, nullable ? 1 : 0);
+    fb.AddScalar<uint8_t>(Field_type_type, typeType);
+    fb.AddRef(Field_type, typeRef);
+    fb.AddRef(Field_children, childrenRef);
+    return fb.EndTable();
+  }
+
+  static FlatBufferBuilder::Ref BuildSchema(FlatBufferBuilder &fb,
+                                            const rdcarray<ArrowColumn> &columns,
+                                            const rdcarray<rdcpair<rdcstr, rdcstr>> &metadata)
+  {
+    rdcarray<FlatBufferBuilder::Ref> fields;
+    for(const ArrowColumn &col : columns)
+      fields.push_back(BuildField(fb, col.name, col.type, col.nullable));
+    FlatBufferBuilder::Ref fieldsRef = fb.TableVector(fields);
+
+    rdcarray<FlatBufferBuilder::Ref> keyValues;
+    for(const rdcpair<rdcstr, rdcstr> &kv : metadata)
+    {
+      FlatBufferBuilder::Ref key = fb.String(kv.first);
+      FlatBufferBuilder::Ref value = fb.String(kv.second);
+
+      fb.BeginTable();
+      fb.AddRef(KeyValue_key, key);
+      fb.AddRef(KeyValue_value, value);
+      keyValues.push_back(fb.EndTable());
+    }
+    FlatBufferBuilder::Ref metadataRef = fb.TableVector(keyValues);
+
+    fb.BeginTable();
+    // little endian
+    fb.AddScalar<int16_t>(Schema_endianness, 0);
+    fb.AddRef(Schema_fields, fieldsRef);
+    fb.AddRef(Schema_custom_metadata, metadataRef);
+    return fb.EndTable();
+  }
+
+  static bytebuf BuildMessage(FlatBufferBuilder &fb, uint8_t headerType,
+                              FlatBufferBuilder::Ref header, int64_t bodyLength)
+  {
+    fb.BeginTable();
+    fb.AddScalar<int16_t>(Message_version, MetadataVersion_V5);
+    fb.AddScalar<uint8_t>(Message_header_type, headerType);
+    fb.AddRef(Message_header, header);
+    fb.AddScalar<int64_t>(Message_bodyLength, bodyLength);
+    return fb.Finish(fb.EndTable());
+  }
+
+  // messages are a continuation marker and the metadata length, then the metadata padded so that
+  // the body which follows is 8-byte aligned
+  ArrowBlock WriteMessage(const bytebuf &metadata, int64_t bodyLength)
+  {
+    ArrowBlock block = {};
+    block.offset = (int64_t)m_Stream.GetOffset();
+
+    int32_t paddedLength = (int32_t)AlignUp(metadata.size(), (size_t)8);
+
+    m_Stream.Write(0xFFFFFFFFU);
+    m_Stream.Write(paddedLength);
+    m_Stream.Write(metadata.data(), metadata.size());
+    WritePadding(metadata.size());
+
+    block.metaDataLength = paddedLength + 8;
+    block.bodyLength = bodyLength;
+    return block;
+  }
+
+  void WritePadding(uint64_t size)
+  {
+    static const byte zeroes[8] = {};
+    if(size % 8)
+      m_Stream.Write(zeroes, 8 - (size % 8));
+  }
+
+  StreamWriter &m_Stream;
+  rdcarray<ArrowBlock> m_Blocks;
+};
+
+// the fixed columns for each chunk's metadata, before any parameter columns
+enum
+{
+  Column_Index,
+  Column_ChunkID,
+  Column_Name,
+  Column_ThreadID,
+  Column_Timestamp,
+  Column_Duration,
+  Column_Length,
+  Column_Flags,
+  Column_Callstack,
+  Column_FirstParameter,
+};
+
+static const SDObject *FindParameter(const SDChunk *chunk, const rdcarray<rdcstr> &path)
+{
+  const SDObject *obj = chunk;
+  for(size_t i = 0; obj && i < path.size(); i++)
+    obj = obj->FindChild(path[i]);
+  return obj;
+}
+
+static ArrowType ParameterType(const SDObject *obj)
+{
+  switch(obj->type.basetype)
+  {
+    case SDBasic::UnsignedInteger:
+    case SDBasic::Resource: return ArrowType::UInt64;
+    case SDBasic::SignedInteger: return ArrowType::Int64;
+    case SDBasic::Float: return ArrowType::Float64;
+    case SDBasic::Boolean: return ArrowType::Bool;
+    // enums export their name, as the values are API specific
+    case SDBasic::Enum:
+      return (obj->type.flags & SDTypeFlags::HasCustomString) ? ArrowType::Utf8 : ArrowType::UInt64;
+    default: return ArrowType::Utf8;
+  }
+}
+
+// append a parameter to its column, converting if this chunk's parameter has a different type to
+// the one the column was created with
+static void AppendParameter(ArrowColumn &col, uint32_t row, const SDObject *obj)
+{
+  if(!obj)
+  {
+    col.AppendNull(row);
+    return;
+  }
+
+  const SDObjectPODData &data = obj->data.basic;
+  const SDBasic basetype = obj->type.basetype;
+
+  bool isUnsigned = basetype == SDBasic::UnsignedInteger || basetype == SDBasic::Enum ||
+                    basetype == SDBasic::Resource || basetype == SDBasic::Boolean;
+  bool isNumber = isUnsigned || basetype == SDBasic::SignedInteger || basetype == SDBasic::Float;
+
+  double d = 0.0;
+  if(basetype == SDBasic::Float)
+    d = data.d;
+  else if(basetype == SDBasic::SignedInteger)
+    d = (double)data.i;
+  else if(basetype == SDBasic::Boolean)
+    d = data.b ? 1.0 : 0.0;
+  else
+    d = (double)data.u;
+
+  switch(col.type)
+  {
+    case ArrowType::UInt32:
+    case ArrowType::UInt64:
+    case ArrowType::Int64:
+    {
+      if(!isNumber)
+        col.AppendNull(row);
+      else if(basetype == SDBasic::Float)
+        col.Append<int64_t>(row, (int64_t)d);
+      else if(basetype == SDBasic::Boolean)
+        col.Append<uint64_t>(row, data.b ? 1 : 0);
+      else
+        col.Append<uint64_t>(row, data.u);
+      break;
+    }
+    case ArrowType::Float64:
+    {
+      if(isNumber)
+        col.Append<double>(row, d);
+      else
+        col.AppendNull(row);
+      break;
+    }
+    case ArrowType::Bool:
+    {
+      if(basetype == SDBasic::Boolean)
+        col.AppendBool(row, data.b);
+      else if(isNumber)
+        col.AppendBool(row, d != 0.0);
+      else
+        col.AppendNull(row);
+      break;
+    }
+    case ArrowType::Utf8:
+    {
+      if(basetype == SDBasic::String || (obj->type.flags & SDTypeFlags::HasCustomString))
+        col.AppendString(row, obj->data.str);
+      else if(basetype == SDBasic::Character)
+        col.AppendString(row, rdcstr(&data.c, data.c ? 1 : 0));
+      else if(basetype == SDBasic::Float)
+        col.AppendString(row, StringFormat::Fmt("%.17g", data.d));
+      else if(basetype == SDBasic::SignedInteger)
+        col.AppendString(row, StringFormat::Fmt("%lld", data.i));
+      else if(basetype == SDBasic::Boolean)
+        col.AppendString(row, data.b ? "true" : "false");
+      else if(isUnsigned)
+        col.AppendString(row, StringFormat::Fmt("%llu", data.u));
+      else
+        col.AppendNull(row);
+      break;
+    }
+    case ArrowType::UInt64List: col.AppendNull(row); break;
+  }
+}
+
+static RDResult Structured2Arrow(const rdcstr &filename, const RDCFile &rdc,
+                                 const SDFile &structData, const rdcarray<rdcstr> &parameters,
+                                 RENDERDOC_ProgressCallback progress)
+{
+  StreamWriter stream(FileIO::fopen(filename, FileIO::WriteBinary), Ownership::Stream);
+
+  if(stream.IsErrored())
+    return stream.GetError();
+
+  // rows are buffered into batches of this many before being written
+  const uint32_t batchRows = 64 * 1024;
+
+  const StructuredChunkList &chunks = structData.chunks;
+
+  rdcarray<ArrowColumn> columns;
+  columns.resize(Column_FirstParameter + parameters.size());
+
+  columns[Column_Index] = {"index", ArrowType::UInt32, false};
+  columns[Column_ChunkID] = {"chunkID", ArrowType::UInt32, false};
+  columns[Column_Name] = {"name", ArrowType::Utf8, false};
+  columns[Column_ThreadID] = {"threadID", ArrowType::UInt64, false};
+  columns[Column_Timestamp] = {"timestampMicro", ArrowType::UInt64, false};
+  columns[Column_Duration] = {"durationMicro", ArrowType::Int64, true};
+  columns[Column_Length] = {"length", ArrowType::UInt64, false};
+  columns[Column_Flags] = {"flags", ArrowType::UInt32, false};
+  columns[Column_Callstack] = {"callstack", ArrowType::UInt64List, true};
+
+  // the schema has to be written before any rows, so each parameter column takes the type of the
+  // first occurrence in the first batch. Parameters not seen there are exported as strings.
+  rdcarray<rdcarray<rdcstr>> paths;
+  paths.resize(parameters.size());
+  for(size_t p = 0; p < parameters.size(); p++)
+  {
+    split(parameters[p], paths[p], '.');
+
+    ArrowColumn &col = columns[Column_FirstParameter + p];
+    col.name = parameters[p];
+    col.type = ArrowType::Utf8;
+    col.nullable = true;
+
+    for(size_t c = 0; c < chunks.size() && c < batchRows; c++)
+    {
+      const SDObject *obj = FindParameter(chunks[c], paths[p]);
+      if(obj)
+      {
+        col.type = ParameterType(obj);
+        break;
+      }
+    }
+  }
+
+  rdcarray<rdcpair<rdcstr, rdcstr>> metadata = {
+      {"renderdoc.driver", rdc.GetDriverName()},
+      {"renderdoc.machineIdent", StringFormat::Fmt("%llu", rdc.GetMachineIdent())},
+      {"renderdoc.timestampBase", StringFormat::Fmt("%llu", rdc.GetTimestampBase())},
+      {"renderdoc.timestampFrequency", StringFormat::Fmt("%.17g", rdc.GetTimestampFrequency())},
+      {"renderdoc.version", StringFormat::Fmt("%llu", structData.version)},
+  };
+
+  ArrowFileWriter writer(stream);
+
+  writer.WriteSchema(columns, metadata);
+
+  for(ArrowColumn &col : columns)
+    col.Reset();
+
+  uint32_t row = 0;
+
+  for(size_t c = 0; c < chunks.size(); c++)
+  {
+    const SDChunk *chunk = chunks[c];
+    const SDChunkMetaData &meta = chunk->metadata;
+
+    columns[Column_Index].Append<uint32_t>(row, (uint32_t)c);
+    columns[Column_ChunkID].Append<uint32_t>(row, meta.chunkID);
+    columns[Column_Name].AppendString(row, chunk->name);
+    columns[Column_ThreadID].Append<uint64_t>(row, meta.threadID);
+    columns[Column_Timestamp].Append<uint64_t>(row, meta.timestampMicro);
+    if(meta.durationMicro >= 0)
+      columns[Column_Duration].Append<int64_t>(row, meta.durationMicro);
+    else
+      columns[Column_Duration].AppendNull(row);
+    columns[Column_Length].Append<uint64_t>(row, meta.length);
+    columns[Column_Flags].Append<uint32_t>(row, (uint32_t)meta.flags);
+    if(meta.flags & SDChunkFlags::HasCallstack)
+      columns[Column_Callstack].AppendList(row, meta.callstack);
+    else
+      columns[Column_Callstack].AppendNull(row);
+
+    for(size_t p = 0; p < paths.size(); p++)
+      AppendParameter(columns[Column_FirstParameter + p], row, FindParameter(chunk, paths[p]));
+
+    row++;
+
+    if(row == batchRows || c + 1 == chunks.size())
+    {
+      writer.WriteBatch(columns, row);
+
+      for(ArrowColumn &col : columns)
+        col.Reset();
+      row = 0;
+    }
+
+    if(progress)
+      progress(float(c) / float(chunks.size()));
+  }
+
+  RDResult ret = writer.Finish(columns, metadata);
+
+  if(progress)
+    progress(1.0f);
+
+  return ret;
+}
+
+RDResult exportArrow(const rdcstr &filename, const RDCFile &rdc, const SDFile &structData,
+                     RENDERDOC_ProgressCallback progress)
+{
+  return Structured2Arrow(filename, rdc, structData, Export_ArrowParameters(), progress);
+}
+
+static ConversionRegistration ArrowConversionRegistration(
+    &exportArrow,
+    {
+        "arrow", "Apache Arrow columnar data",
+        R"(Exports each chunk's ID, name, thread, timestamp, duration and callstack as a row in an
+Arrow IPC (Feather v2) file, for loading into data analysis tools. Extra chunk parameters can be
+exported as columns with the Export_ArrowParameters config setting.)",
+        false,
+    });
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+// just enough of a flatbuffers reader to walk the metadata we write, so the test can check the
+// file decodes rather than only its framing
+struct FlatTable
+{
+  const byte *base;
+  uint32_t pos;
+
+  template <typename T>
+  T Read(uint32_t offs) const
+  {
+    T ret;
+    memcpy(&ret, base + offs, sizeof(T));
+    return ret;
+  }
+
+  // the absolute position of a field, or 0 if it's not present
+  uint32_t Field(uint16_t id) const
+  {
+    uint32_t vtable = pos - Read<int32_t>(pos);
+    uint16_t vtableSize = Read<uint16_t>(vtable);
+    if(4U + id * 2U >= vtableSize)
+      return 0;
+    uint16_t offs = Read<uint16_t>(vtable + 4 + id * 2);
+    return offs ? pos + offs : 0;
+  }
+
+  template <typename T>
+  T Scalar(uint16_t id, T def = T()) const
+  {
+    uint32_t f = Field(id);
+    return f ? Read<T>(f) : def;
+  }
+
+  uint32_t Ref(uint16_t id) const
+  {
+    uint32_t f = Field(id);
+    return f ? f + Read<uint32_t>(f) : 0;
+  }
+
+  FlatTable Table(uint16_t id) const { return {base, Ref(id)}; }
+  rdcstr String(uint16_t id) const
+  {
+    uint32_t str = Ref(id);
+    return rdcstr((const char *)base + str + 4, Read<uint32_t>(str));
+  }
+
+  uint32_t VectorCount(uint16_t id) const { return Read<uint32_t>(Ref(id)); }
+  FlatTable TableElement(uint16_t id, uint32_t idx) const
+  {
+    uint32_t elem = Ref(id) + 4 + idx * 4;
+    return {base, elem + Read<uint32_t>(elem)};
+  }
+
+  template <typename T>
+  T StructElement(uint16_t id, uint32_t idx) const
+  {
+    return Read<T>(Ref(id) + 4 + idx * sizeof(T));
+  }
+
+  static FlatTable Root(const byte *data)
+  {
+    uint32_t root;
+    memcpy(&root, data, sizeof(root));
+    return {data, root};
+  }
+};
+
+TEST_CASE("Export structured data to Arrow", "[arrow]")
+{
+  rdcstr filename = FileIO::GetTempFolderFilename() + "rdoc_arrow_test.arrow";
+
+  RDCFile rdc;
+  rdc.SetData(RDCDriver::Vulkan, "Vulkan", 1234, NULL, 0, 1.0);
+
+  SDFile sdfile;
+
+  const uint32_t numChunks = 10;
+
+  for(uint32_t i = 0; i < numChunks; i++)
+  {
+    SDChunk *chunk = new SDChunk(i % 2 ? "vkCmdDraw"_lit : "vkCmdDispatch"_lit);
+    chunk->metadata.chunkID = 1000 + i;
+    chunk->metadata.timestampMicro = i * 10;
+    chunk->metadata.durationMicro = i % 3 ? int64_t(i) : -1;
+    if(i == 4)
+    {
+      chunk->metadata.flags = SDChunkFlags::HasCallstack;
+      chunk->metadata.callstack = {1, 2, 3};
+    }
+    if(i % 2)
+      chunk->AddAndOwnChild(makeSDUInt32("vertexCount"_lit, i * 3));
+    sdfile.chunks.push_back(chunk);
+  }
+
+  RDResult res =
+      Structured2Arrow(filename, rdc, sdfile, {"vertexCount"}, RENDERDOC_ProgressCallback());
+  REQUIRE(res.code == ResultCode::Succeeded);
+
+  bytebuf contents;
+  REQUIRE(FileIO::ReadAll(filename, contents));
+  FileIO::Delete(filename);
+
+  REQUIRE(contents.size() > 32);
+  CHECK(memcmp(contents.data(), "ARROW1\0\0", 8) == 0);
+  CHECK(memcmp(contents.data() + contents.size() - 6, "ARROW1", 6) == 0);
+
+  // the schema message directly follows the magic
+  uint32_t continuation = 0;
+  memcpy(&continuation, contents.data() + 8, sizeof(continuation));
+  CHECK(continuation == 0xFFFFFFFFU);
+
+  // the footer length is just before the trailing magic, and the footer is preceded by the end of
+  // stream marker
+  int32_t footerLength = 0;
+  memcpy(&footerLength, contents.data() + contents.size() - 10, sizeof(footerLength));
+  REQUIRE(footerLength > 0);
+  REQUIRE(size_t(footerLength) + 18 < contents.size());
+
+  const byte *footerData = contents.data() + contents.size() - 10 - footerLength;
+
+  const byte *eos = footerData - 8;
+  uint32_t eosMarker[2] = {};
+  memcpy(eosMarker, eos, sizeof(eosMarker));
+  CHECK(eosMarker[0] == 0xFFFFFFFFU);
+  CHECK(eosMarker[1] == 0U);
+
+  // every message and body is padded to 8 bytes
+  CHECK((eos - contents.data()) % 8 == 0);
+
+  // field and enum values from the Arrow flatbuffers schemas
+  enum
+  {
+    Footer_schema = 1,
+    Footer_recordBatches = 3,
+    Schema_fields = 1,
+    Schema_custom_metadata = 2,
+    Field_name = 0,
+    Field_nullable = 1,
+    Field_type_type = 2,
+    Field_type = 3,
+    Field_children = 5,
+    Int_bitWidth = 0,
+    Int_is_signed = 1,
+    Message_header_type = 1,
+    Message_header = 2,
+    Message_bodyLength = 3,
+    RecordBatch_length = 0,
+    RecordBatch_nodes = 1,
+    RecordBatch_buffers = 2,
+  };
+
+  const uint8_t Type_Int = 2, Type_Utf8 = 5, Type_List = 12;
+  const uint8_t MessageHeader_RecordBatch = 3;
+
+  FlatTable footer = FlatTable::Root(footerData);
+
+  FlatTable schema = footer.Table(Footer_schema);
+
+  struct ExpectedField
+  {
+    const char *name;
+    uint8_t type;
+    int32_t bitWidth;
+    bool isSigned;
+    bool nullable;
+  };
+
+  const ExpectedField expectedFields[] = {
+      {"index", Type_Int, 32, false, false},
+      {"chunkID", Type_Int, 32, false, false},
+      {"name", Type_Utf8, 0, false, false},
+      {"threadID", Type_Int, 64, false, false},
+      {"timestampMicro", Type_Int, 64, false, false},
+      {"durationMicro", Type_Int, 64, true, true},
+      {"length", Type_Int, 64, false, false},
+      {"flags", Type_Int, 32, false, false},
+      {"callstack", Type_List, 0, false, true},
+      {"vertexCount", Type_Int, 64, false, true},
+  };
+
+  const uint32_t numFields = ARRAY_COUNT(expectedFields);
+
+  REQUIRE(schema.VectorCount(Schema_fields) == numFields);
+
+  for(uint32_t f = 0; f < numFields; f++)
+  {
+    FlatTable field = schema.TableElement(Schema_fields, f);
+
+    CHECK(field.String(Field_name) == expectedFields[f].name);
+    CHECK(field.Scalar<uint8_t>(Field_type_type) == expectedFields[f].type);
+    CHECK(field.Scalar<uint8_t>(Field_nullable) == (expectedFields[f].nullable ? 1 : 0));
+
+    if(expectedFields[f].type == Type_Int)
+    {
+      FlatTable intType = field.Table(Field_type);
+      CHECK(intType.Scalar<int32_t>(Int_bitWidth) == expectedFields[f].bitWidth);
+      CHECK(intType.Scalar<uint8_t>(Int_is_signed) == (expectedFields[f].isSigned ? 1 : 0));
+    }
+
+    if(expectedFields[f].type == Type_List)
+    {
+      REQUIRE(field.VectorCount(Field_children) == 1);
+      FlatTable item = field.TableElement(Field_children, 0);
+      CHECK(item.String(Field_name) == "item");
+      CHECK(item.Scalar<uint8_t>(Field_type_type) == Type_Int);
+    }
+  }
+
+  std::map<rdcstr, rdcstr> metadata;
+  for(uint32_t m = 0; m < schema.VectorCount(Schema_custom_metadata); m++)
+  {
+    FlatTable kv = schema.TableElement(Schema_custom_metadata, m);
+    metadata[kv.String(0)] = kv.String(1);
+  }
+
+  CHECK(metadata["renderdoc.driver"] == "Vulkan");
+  CHECK(metadata["renderdoc.machineIdent"] == "1234");
+
+  // one record batch holds every row
+  REQUIRE(footer.VectorCount(Footer_recordBatches) == 1);
+  ArrowBlock block = footer.StructElement<ArrowBlock>(Footer_recordBatches, 0);
+
+  REQUIRE(block.offset % 8 == 0);
+  REQUIRE(uint64_t(block.offset + block.metaDataLength + block.bodyLength) <=
+          uint64_t(eos - contents.data()));
+
+  const byte *messageData = contents.data() + block.offset;
+  memcpy(&continuation, messageData, sizeof(continuation));
+  CHECK(continuation == 0xFFFFFFFFU);
+
+  FlatTable message = FlatTable::Root(messageData + 8);
+  CHECK(message.Scalar<uint8_t>(Message_header_type) == MessageHeader_RecordBatch);
+  CHECK(message.Scalar<int64_t>(Message_bodyLength) == block.bodyLength);
+
+  FlatTable batch = message.Table(Message_header);
+  CHECK(batch.Scalar<int64_t>(RecordBatch_length) == numChunks);
+
+  const byte *body = messageData + block.metaDataLength;
+
+  // the list column has a node for its child, and every column has a validity buffer, offsets for
+  // variable length columns, and values
+  REQUIRE(batch.VectorCount(RecordBatch_nodes) == numFields + 1);
+  REQUIRE(batch.VectorCount(RecordBatch_buffers) == numFields * 2 + 3);
+
+  uint32_t bufIdx = 0;
+  auto nextBuffer = [&](int64_t *length = NULL) -> const byte * {
+    ArrowBuffer buf = batch.StructElement<ArrowBuffer>(RecordBatch_buffers, bufIdx++);
+    REQUIRE(buf.offset + buf.length <= block.bodyLength);
+    if(length)
+      *length = buf.length;
+    return buf.length > 0 ? body + buf.offset : NULL;
+  };
+
+  auto isValid = [](const byte *validity, uint32_t row) {
+    return validity == NULL || (validity[row / 8] & (1 << (row % 8))) != 0;
+  };
+
+  auto readU32 = [](const byte *values, uint32_t row) {
+    uint32_t ret;
+    memcpy(&ret, values + row * sizeof(ret), sizeof(ret));
+    return ret;
+  };
+
+  auto readU64 = [](const byte *values, uint32_t row) {
+    uint64_t ret;
+    memcpy(&ret, values + row * sizeof(ret), sizeof(ret));
+    return ret;
+  };
+
+  auto readI32 = [](const byte *values, uint32_t row) {
+    int32_t ret;
+    memcpy(&ret, values + row * sizeof(ret), sizeof(ret));
+    return ret;
+  };
+
+  // index
+  {
+    CHECK(batch.StructElement<ArrowFieldNode>(RecordBatch_nodes, Column_Index).nullCount == 0);
+    CHECK(nextBuffer() == NULL);
+    const byte *values = nextBuffer();
+    for(uint32_t i = 0; i < numChunks; i++)
+      CHECK(readU32(values, i) == i);
+  }
+
+  // chunkID
+  {
+    CHECK(nextBuffer() == NULL);
+    const byte *values = nextBuffer();
+    for(uint32_t i = 0; i < numChunks; i++)
+      CHECK(readU32(values, i) == 1000 + i);
+  }
+
+  // name
+  {
+    CHECK(nextBuffer() == NULL);
+    const byte *offsets = nextBuffer();
+    const byte *values = nextBuffer();
+    for(uint32_t i = 0; i < numChunks; i++)
+    {
+      int32_t start = readI32(offsets, i), end = readI32(offsets, i + 1);
+      CHECK(rdcstr((const char *)values + start, end - start) ==
+            (i % 2 ? "vkCmdDraw" : "vkCmdDispatch"));
+    }
+  }
+
+  // threadID
+  {
+    CHECK(nextBuffer() == NULL);
+    const byte *values = nextBuffer();
+    for(uint32_t i = 0; i < numChunks; i++)
+      CHECK(readU64(values, i) == 0);
+  }
+
+  // timestampMicro
+  {
+    CHECK(nextBuffer() == NULL);
+    const byte *values = nextBuffer();
+    for(uint32_t i = 0; i < numChunks; i++)
+      CHECK(readU64(values, i) == i * 10);
+  }
+
+  // durationMicro, null when unknown
+  {
+    CHECK(batch.StructElement<ArrowFieldNode>(RecordBatch_nodes, Column_Duration).nullCount == 4);
+    const byte *validity = nextBuffer();
+    REQUIRE(validity != NULL);
+    const byte *values = nextBuffer();
+    for(uint32_t i = 0; i < numChunks; i++)
+    {
+      CHECK(isValid(validity, i) == (i % 3 != 0));
+      if(i % 3)
+        CHECK(int64_t(readU64(values, i)) == int64_t(i));
+    }
+  }
+
+  // length
+  {
+    CHECK(nextBuffer() == NULL);
+    nextBuffer();
+  }
+
+  // flags
+  {
+    CHECK(nextBuffer() == NULL);
+    const byte *values = nextBuffer();
+    for(uint32_t i = 0; i < numChunks; i++)
+      CHECK(readU32(values, i) == (i == 4 ? (uint32_t)SDChunkFlags::HasCallstack : 0U));
+  }
+
+  // callstack, only on one chunk
+  {
+    CHECK(batch.StructElement<ArrowFieldNode>(RecordBatch_nodes, Column_Callstack).nullCount ==
+          numChunks - 1);
+    // the child node follows the list's node
+    CHECK(batch.StructElement<ArrowFieldNode>(RecordBatch_nodes, Column_Callstack + 1).length == 3);
+
+    const byte *validity = nextBuffer();
+    REQUIRE(validity != NULL);
+    const byte *offsets = nextBuffer();
+    CHECK(nextBuffer() == NULL);
+    const byte *values = nextBuffer();
+
+    for(uint32_t i = 0; i < numChunks; i++)
+    {
+      CHECK(isValid(validity, i) == (i == 4));
+
+      int32_t start = readI32(offsets, i), end = readI32(offsets, i + 1);
+      CHECK(end - start == (i == 4 ? 3 : 0));
+      for(int32_t e = start; e < end; e++)
+        CHECK(readU64(values, e) == uint64_t(e - start + 1));
+    }
+  }
+
+  // vertexCount parameter, only present on draws
+  {
+    CHECK(batch.StructElement<ArrowFieldNode>(RecordBatch_nodes, Column_FirstParameter + 1)
+              .nullCount == numChunks / 2);
+    const byte *validity = nextBuffer();
+    REQUIRE(validity != NULL);
+    const byte *values = nextBuffer();
+    for(uint32_t i = 0; i < numChunks; i++)
+    {
+      CHECK(isValid(validity, i) == (i % 2 == 1));
+      if(i % 2)
+        CHECK(readU64(values, i) == i * 3);
+    }
+  }
+
+  CHECK(bufIdx == numFields * 2 + 3);
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -22,15 +22,16 @@
  * THE SOFTWARE.
  ******************************************************************************/
 
+
 #include <utility>
 #include "api/replay/structured_data.h"
 #include "common/common.h"
 #include "common/formatting.h"
+#include "common/threading.h"
 #include "serialise/rdcfile.h"
 #include "strings/string_utils.h"
 
 #include "miniz/miniz.h"
-#include "pugixml/pugixml.hpp"
 
 struct ThumbTypeAndData
 {
@@ -59,18 +60,6 @@ inline float StructuredProgress(float progress)
   return 0.2f + 0.8f * progress;
 }
 
-struct xml_file_writer : pugi::xml_writer
-{
-  StreamWriter stream;
-
-  xml_file_writer(const rdcstr &filename)
-      : stream(FileIO::fopen(filename, FileIO::WriteBinary), Ownership::Stream)
-  {
-  }
-
-  void write(const void *data, size_t size) { stream.Write(data, size); }
-};
-
 // avoid &, <, and > since they throw off the ascii alignment
 static constexpr bool IsXMLPrintable(const char c)
 {
@@ -90,45 +79,691 @@ static constexpr byte FromHex(const char c)
                                      : (c >= 'a' && c <= 'f' ? byte(c - 'a') + 10 : 0));
 }
 
-static void HexEncode(const bytebuf &in, rdcstr &out)
+static constexpr bool IsXMLWhitespace(const int c)
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Writes XML directly to a stream as it's generated, so no document tree is built in memory. The
+// output is formatted the same as pugixml's default save - tab indented with one element per line,
+// and elements containing only text kept on one line.
+class XMLStreamWriter
+{
+public:
+  XMLStreamWriter(StreamWriter &stream) : m_Stream(stream) { Write("<?xml version=\"1.0\"?>\n"); }
+  void BeginElement(const char *name)
+  {
+    // the parent now has element children so its end tag goes on its own line
+    if(m_StartTagOpen)
+      Write(">\n");
+
+    for(size_t i = 0; i < m_Elements.size(); i++)
+      Write("\t");
+
+    Write("<");
+    Write(name);
+
+    m_Elements.push_back(name);
+    m_StartTagOpen = true;
+    m_HasText = false;
+  }
+
+  void EndElement()
+  {
+    if(m_HasText)
+    {
+      Write("</");
+      Write(m_Elements.back().c_str());
+      Write(">\n");
+    }
+    else if(m_StartTagOpen)
+    {
+      Write(" />\n");
+    }
+    else
+    {
+      for(size_t i = 0; i + 1 < m_Elements.size(); i++)
+        Write("\t");
+
+      Write("</");
+      Write(m_Elements.back().c_str());
+      Write(">\n");
+    }
+
+    m_Elements.pop_back();
+    m_StartTagOpen = false;
+    m_HasText = false;
+  }
+
+  void Attribute(const char *name, const char *value)
+  {
+    RDCASSERT(m_StartTagOpen && !m_HasText);
+    Write(" ");
+    Write(name);
+    Write("=\"");
+    WriteEscaped(value, strlen(value), true);
+    Write("\"");
+  }
+
+  void Attribute(const char *name, const rdcstr &value) { Attribute(name, value.c_str()); }
+  void AttributeUInt(const char *name, uint64_t value) { Attribute(name, UIntString(value)); }
+  void AttributeInt(const char *name, int64_t value) { Attribute(name, IntString(value)); }
+  void AttributeFloat(const char *name, double value) { Attribute(name, FloatString(value)); }
+  void AttributeBool(const char *name, bool value) { Attribute(name, value ? "true" : "false"); }
+  // the text contents of the current element, which can't then have any child elements. Stops at
+  // the first NUL character, if there is one.
+  void Text(const char *text, size_t length)
+  {
+    BeginText();
+    WriteEscaped(text, length, false);
+  }
+
+  void Text(const char *text) { Text(text, strlen(text)); }
+  void Text(const rdcstr &text) { Text(text.c_str(), text.size()); }
+  void TextUInt(uint64_t value) { Text(UIntString(value)); }
+  void TextInt(int64_t value) { Text(IntString(value)); }
+  void TextFloat(double value) { Text(FloatString(value)); }
+  void TextBool(bool value) { Text(value ? "true" : "false"); }
+  // text that's known not to need escaping
+  void RawText(const char *text, size_t length)
+  {
+    BeginText();
+    m_Stream.Write(text, length);
+  }
+
+  RDResult GetError() { return m_Stream.GetError(); }
+
+private:
+  void Write(const char *str) { m_Stream.Write(str, strlen(str)); }
+  void BeginText()
+  {
+    RDCASSERT(m_StartTagOpen || m_HasText);
+    if(m_StartTagOpen)
+      Write(">");
+    m_StartTagOpen = false;
+    m_HasText = true;
+  }
+
+  // escape the same characters as pugixml
+  void WriteEscaped(const char *str, size_t length, bool attribute)
+  {
+    const char *run = str;
+    const char *end = str;
+
+    for(; end < str + length && *end; end++)
+    {
+      const char c = *end;
+      const char *escaped = NULL;
+      char numeric[6] = {'&', '#', '0', '0', ';', 0};
+
+      if(c == '&')
+        escaped = "&amp;";
+      else if(c == '<')
+        escaped = "&lt;";
+      else if(c == '>')
+        escaped = "&gt;";
+      else if(c == '"' && attribute)
+        escaped = "&quot;";
+      else if(c > 0 && c < 32 && c != '\t' && (attribute || (c != '\r' && c != '\n')))
+        escaped = numeric;
+
+      if(escaped)
+      {
+        numeric[2] = char('0' + c / 10);
+        numeric[3] = char('0' + c % 10);
+
+        m_Stream.Write(run, end - run);
+        Write(escaped);
+        run = end + 1;
+      }
+    }
+
+    m_Stream.Write(run, end - run);
+  }
+
+  static rdcstr UIntString(uint64_t value) { return StringFormat::Fmt("%llu", value); }
+  static rdcstr IntString(int64_t value) { return StringFormat::Fmt("%lld", value); }
+  static rdcstr FloatString(double value) { return StringFormat::Fmt("%.17g", value); }
+  StreamWriter &m_Stream;
+  rdcarray<rdcstr> m_Elements;
+  bool m_StartTagOpen = false;
+  bool m_HasText = false;
+};
+
+// A pull parser that reads XML incrementally from a stream, so that only the element being
+// processed needs to be in memory rather than the whole document. It accepts the same documents
+// as pugixml's default parsing: the declaration, comments and doctypes are skipped, CDATA is
+// treated as text, whitespace-only text between elements is ignored and line endings are
+// normalised.
+class XMLStreamReader
+{
+public:
+  enum class Token
+  {
+    StartElement,
+    EndElement,
+    Text,
+    EndOfDocument,
+    Error,
+  };
+
+  XMLStreamReader(StreamReader &stream) : m_Stream(stream)
+  {
+    // skip any UTF-8 BOM
+    if(Peek() == 0xEF)
+    {
+      Get();
+      Get();
+      Get();
+    }
+  }
+
+  Token Next();
+
+  // the name of the element that was just started or ended
+  const rdcstr &Name() const { return m_Name; }
+  const rdcstr &Text() const { return m_Text; }
+  const rdcstr &Error() const { return m_Error; }
+  float Progress() { return float(m_Stream.GetOffset() - (m_Length - m_Pos)) / m_Stream.GetSize(); }
+  // the attributes of the element that was just started
+  bool HasAttribute(const char *name) const { return FindAttribute(name) != NULL; }
+  const char *Attribute(const char *name) const
+  {
+    const rdcstr *ret = FindAttribute(name);
+    return ret ? ret->c_str() : "";
+  }
+
+  uint64_t AttributeUInt(const char *name) const { return ToUInt(Attribute(name)); }
+  int64_t AttributeInt(const char *name) const { return ToInt(Attribute(name)); }
+  double AttributeFloat(const char *name) const { return atof(Attribute(name)); }
+  // read the text inside the element that was just started, skipping any child elements, and
+  // finish the element. Returns false on a parse error.
+  bool ReadElementText(rdcstr &text);
+
+  // skip the rest of the element that was just started, including any children.
+  bool SkipElement()
+  {
+    rdcstr dummy;
+    return ReadElementText(dummy);
+  }
+
+  static uint64_t ToUInt(const char *str)
+  {
+    while(IsXMLWhitespace(*str))
+      str++;
+
+    bool negative = (*str == '-');
+    if(negative)
+      str++;
+
+    uint64_t ret = 0;
+    if(str[0] == '0' && (str[1] == 'x' || str[1] == 'X'))
+      ret = strtoull(str + 2, NULL, 16);
+    else
+      ret = strtoull(str, NULL, 10);
+
+    return negative ? 0 - ret : ret;
+  }
+
+  static int64_t ToInt(const char *str) { return (int64_t)ToUInt(str); }
+  static bool ToBool(const char *str)
+  {
+    while(IsXMLWhitespace(*str))
+      str++;
+
+    return *str == '1' || *str == 't' || *str == 'T' || *str == 'y' || *str == 'Y';
+  }
+
+private:
+  static const int EndOfStream = -1;
+
+  int Peek()
+  {
+    if(m_Pos >= m_Length && !Fill())
+      return EndOfStream;
+    return m_Buffer[m_Pos];
+  }
+
+  int Get()
+  {
+    int ret = Peek();
+    if(ret != EndOfStream)
+      m_Pos++;
+    return ret;
+  }
+
+  bool Fill()
+  {
+    uint64_t remaining = m_Stream.GetSize() - m_Stream.GetOffset();
+
+    if(remaining == 0 || m_Stream.IsErrored())
+      return false;
+
+    m_Length = (size_t)RDCMIN(remaining, (uint64_t)sizeof(m_Buffer));
+    m_Pos = 0;
+
+    if(!m_Stream.Read(m_Buffer, m_Length))
+    {
+      m_Length = 0;
+      return false;
+    }
+
+    return true;
+  }
+
+  const rdcstr *FindAttribute(const char *name) const
+  {
+    for(const rdcpair<rdcstr, rdcstr> &a : m_Attributes)
+      if(a.first == name)
+        return &a.second;
+    return NULL;
+  }
+
+  Token SetError(const rdcstr &error)
+  {
+    if(m_Error.empty())
+      m_Error = error;
+    return Token::Error;
+  }
+
+  // skip input up to and including terminator
+  bool SkipPast(const char *terminator);
+  void ReadName(rdcstr &name);
+  // read and decode text up to the next '<', or up to and including quote in an attribute
+  void ReadText(rdcstr &text, int quote);
+  void ReadEntity(rdcstr &text);
+
+  StreamReader &m_Stream;
+
+  byte m_Buffer[64 * 1024];
+  size_t m_Pos = 0, m_Length = 0;
+
+  rdcarray<rdcstr> m_Open;
+  bool m_SelfClosed = false;
+
+  rdcstr m_Name;
+  rdcstr m_Text;
+  rdcarray<rdcpair<rdcstr, rdcstr>> m_Attributes;
+  rdcstr m_Error;
+};
+
+bool XMLStreamReader::SkipPast(const char *terminator)
+{
+  size_t len = strlen(terminator);
+  size_t matched = 0;
+
+  while(matched < len)
+  {
+    int c = Get();
+    if(c == EndOfStream)
+      return false;
+
+    if(c == terminator[matched])
+      matched++;
+    else
+      matched = (c == terminator[0]) ? 1 : 0;
+  }
+
+  return true;
+}
+
+void XMLStreamReader::ReadName(rdcstr &name)
+{
+  name.clear();
+
+  for(;;)
+  {
+    int c = Peek();
+    if(c == EndOfStream || IsXMLWhitespace(c) || c == '/' || c == '>' || c == '=' || c == '?')
+      break;
+    name.push_back((char)Get());
+  }
+}
+
+void XMLStreamReader::ReadEntity(rdcstr &text)
+{
+  // we've consumed the '&', read up to the ';'. Unknown entities are left as they are
+  rdcstr entity;
+
+  for(;;)
+  {
+    int c = Peek();
+    if(c == EndOfStream || c == '<' || IsXMLWhitespace(c) || entity.size() > 10)
+    {
+      text += "&" + entity;
+      return;
+    }
+
+    Get();
+
+    if(c == ';')
+      break;
+
+    entity.push_back((char)c);
+  }
+
+  if(entity == "lt")
+    text.push_back('<');
+  else if(entity == "gt")
+    text.push_back('>');
+  else if(entity == "amp")
+    text.push_back('&');
+  else if(entity == "quot")
+    text.push_back('"');
+  else if(entity == "apos")
+    text.push_back('\'');
+  else if(entity.size() > 1 && entity[0] == '#')
+  {
+    uint32_t codepoint = 0;
+    if(entity[1] == 'x' || entity[1] == 'X')
+      codepoint = (uint32_t)strtoul(entity.c_str() + 2, NULL, 16);
+    else
+      codepoint = (uint32_t)strtoul(entity.c_str() + 1, NULL, 10);
+
+    // encode as UTF-8
+    if(codepoint < 0x80)
+    {
+      text.push_back(char(codepoint));
+    }
+    else if(codepoint < 0x800)
+    {
+      text.push_back(char(0xC0 | (codepoint >> 6)));
+      text.push_back(char(0x80 | (codepoint & 0x3f)));
+    }
+    else if(codepoint < 0x10000)
+    {
+      text.push_back(char(0xE0 | (codepoint >> 12)));
+      text.push_back(char(0x80 | ((codepoint >> 6) & 0x3f)));
+      text.push_back(char(0x80 | (codepoint & 0x3f)));
+    }
+    else
+    {
+      text.push_back(char(0xF0 | (codepoint >> 18)));
+      text.push_back(char(0x80 | ((codepoint >> 12) & 0x3f)));
+      text.push_back(char(0x80 | ((codepoint >> 6) & 0x3f)));
+      text.push_back(char(0x80 | (codepoint & 0x3f)));
+    }
+  }
+  else
+  {
+    text += "&" + entity + ";";
+  }
+}
+
+void XMLStreamReader::ReadText(rdcstr &text, int quote)
+{
+  for(;;)
+  {
+    int c = Peek();
+
+    if(c == EndOfStream || (quote == 0 && c == '<'))
+      return;
+
+    Get();
+
+    if(c == quote)
+      return;
+
+    if(c == '&')
+    {
+      ReadEntity(text);
+      continue;
+    }
+
+    // normalise line endings
+    if(c == '\r')
+    {
+      if(Peek() == '\n')
+        Get();
+      c = '\n';
+    }
+
+    // whitespace in attributes is converted to spaces
+    if(quote != 0 && IsXMLWhitespace(c))
+      c = ' ';
+
+    text.push_back((char)c);
+  }
+}
+
+XMLStreamReader::Token XMLStreamReader::Next()
+{
+  if(!m_Error.empty())
+    return Token::Error;
+
+  if(m_SelfClosed)
+  {
+    m_SelfClosed = false;
+    m_Name = m_Open.back();
+    m_Open.pop_back();
+    return Token::EndElement;
+  }
+
+  for(;;)
+  {
+    int c = Peek();
+
+    if(c == EndOfStream)
+    {
+      if(m_Stream.IsErrored())
+        return SetError("Error reading xml stream");
+      if(!m_Open.empty())
+        return SetError(StringFormat::Fmt("Unexpected end of document inside <%s>",
+                                          m_Open.back().c_str()));
+      return Token::EndOfDocument;
+    }
+
+    if(c != '<')
+    {
+      m_Text.clear();
+      ReadText(m_Text, 0);
+
+      bool whitespace = true;
+      for(char t : m_Text)
+        whitespace &= IsXMLWhitespace(t);
+
+      if(whitespace)
+        continue;
+
+      return Token::Text;
+    }
+
+    Get();
+    c = Peek();
+
+    if(c == '?')
+    {
+      if(!SkipPast("?>"))
+        return SetError("Unterminated processing instruction");
+      continue;
+    }
+
+    if(c == '!')
+    {
+      Get();
+
+      if(Peek() == '-')
+      {
+        if(!SkipPast("-->"))
+          return SetError("Unterminated comment");
+        continue;
+      }
+
+      if(Peek() == '[')
+      {
+        if(!SkipPast("CDATA["))
+          return SetError("Malformed CDATA section");
+
+        // CDATA is taken literally up to the terminator
+        m_Text.clear();
+        for(;;)
+        {
+          int d = Get();
+          if(d == EndOfStream)
+            return SetError("Unterminated CDATA section");
+          m_Text.push_back((char)d);
+          if(m_Text.endsWith("]]>"))
+            break;
+        }
+        m_Text.erase(m_Text.size() - 3, 3);
+        return Token::Text;
+      }
+
+      // doctype, which may contain a bracketed internal subset
+      int depth = 0;
+      for(;;)
+      {
+        int d = Get();
+        if(d == EndOfStream)
+          return SetError("Unterminated doctype");
+        if(d == '[')
+          depth++;
+        else if(d == ']')
+          depth--;
+        else if(d == '>' && depth <= 0)
+          break;
+      }
+      continue;
+    }
+
+    if(c == '/')
+    {
+      Get();
+      ReadName(m_Name);
+
+      while(IsXMLWhitespace(Peek()))
+        Get();
+
+      if(Get() != '>')
+        return SetError(StringFormat::Fmt("Malformed end tag </%s>", m_Name.c_str()));
+
+      if(m_Open.empty() || m_Open.back() != m_Name)
+        return SetError(StringFormat::Fmt("Unexpected end tag </%s>", m_Name.c_str()));
+
+      m_Open.pop_back();
+      return Token::EndElement;
+    }
+
+    ReadName(m_Name);
+
+    if(m_Name.empty())
+      return SetError("Malformed start tag");
+
+    m_Attributes.clear();
+
+    for(;;)
+    {
+      while(IsXMLWhitespace(Peek()))
+        Get();
+
+      c = Peek();
+
+      if(c == '>')
+      {
+        Get();
+        break;
+      }
+
+      if(c == '/')
+      {
+        Get();
+        if(Get() != '>')
+          return SetError(StringFormat::Fmt("Malformed start tag <%s>", m_Name.c_str()));
+        m_SelfClosed = true;
+        break;
+      }
+
+      if(c == EndOfStream)
+        return SetError(StringFormat::Fmt("Unterminated start tag <%s>", m_Name.c_str()));
+
+      rdcpair<rdcstr, rdcstr> attr;
+      ReadName(attr.first);
+
+      while(IsXMLWhitespace(Peek()))
+        Get();
+
+      if(attr.first.empty() || Get() != '=')
+        return SetError(StringFormat::Fmt("Malformed attribute in <%s>", m_Name.c_str()));
+
+      while(IsXMLWhitespace(Peek()))
+        Get();
+
+      int quote = Get();
+      if(quote != '"' && quote != '\'')
+        return SetError(StringFormat::Fmt("Malformed attribute in <%s>", m_Name.c_str()));
+
+      ReadText(attr.second, quote);
+      m_Attributes.push_back(std::move(attr));
+    }
+
+    m_Open.push_back(m_Name);
+    return Token::StartElement;
+  }
+}
+
+bool XMLStreamReader::ReadElementText(rdcstr &text)
+{
+  text.clear();
+
+  size_t depth = 1;
+  while(depth > 0)
+  {
+    Token tok = Next();
+
+    if(tok == Token::Error || tok == Token::EndOfDocument)
+      return false;
+
+    if(tok == Token::StartElement)
+      depth++;
+    else if(tok == Token::EndElement)
+      depth--;
+    else if(tok == Token::Text && depth == 1)
+      text += m_Text;
+  }
+
+  return true;
+}
+
+// hex dump data into the current element, 32 bytes per line with an ascii representation
+static void HexEncode(XMLStreamWriter &xml, const byte *data, size_t size)
 {
   const size_t bytesPerLine = 32;
   const size_t bytesPerGroup = 4;
 
   const char digit[] = "0123456789ABCDEF";
-  // Reserve rough required size:
-  // - 3 characters per byte (two for hex, 1 for ascii),
-  // - 4 characters per line (3x space between hex and ascii, newline)
-  // - 1 character per group (space)
-  // - 2 characters for leading/trailing newline
-  out.reserve(in.size() * 3 + (in.size() / bytesPerLine) * 4 + (in.size() / bytesPerGroup) + 2);
 
   // leading newline
-  out = "\n";
+  rdcstr line = "\n";
 
   // accumulate ascii representation for each line
   rdcstr ascii;
 
   size_t i = 0;
-  for(byte c : in)
+  for(; i < size; i++)
   {
-    out.push_back(digit[(c & 0xf0) >> 4]);
-    out.push_back(digit[(c & 0x0f) >> 0]);
+    const byte c = data[i];
+
+    line.push_back(digit[(c & 0xf0) >> 4]);
+    line.push_back(digit[(c & 0x0f) >> 0]);
 
     if(IsXMLPrintable((char)c))
       ascii.push_back((char)c);
     else
       ascii.push_back('.');
 
-    i++;
-    if((i % bytesPerLine) == 0)
+    if(((i + 1) % bytesPerLine) == 0)
     {
-      out += StringFormat::Fmt("   %s\n", ascii.c_str());
+      line += "   ";
+      line += ascii;
+      line += "\n";
       ascii.clear();
+
+      xml.RawText(line.c_str(), line.size());
+      line.clear();
     }
-    else if((i % bytesPerGroup) == 0)
+    else if(((i + 1) % bytesPerGroup) == 0)
     {
-      out.push_back(' ');
+      line.push_back(' ');
     }
   }
 
@@ -139,18 +774,22 @@ static void HexEncode(const bytebuf &in, rdcstr &out)
     for(i = lastLineLength; i < bytesPerLine; i++)
     {
       // print 2 spaces where there would be characters
-      out.push_back(' ');
-      out.push_back(' ');
+      line.push_back(' ');
+      line.push_back(' ');
 
       // don't print the group space the first time, since it was already printed, but after that
       // print the group space
       if((i % bytesPerGroup) == 0 && i > lastLineLength)
-        out.push_back(' ');
+        line.push_back(' ');
     }
 
     // add ascii and final newline
-    out += StringFormat::Fmt("   %s\n", ascii.c_str());
+    line += "   ";
+    line += ascii;
+    line += "\n";
   }
+
+  xml.RawText(line.c_str(), line.size());
 }
 
 static void HexDecode(const char *str, const char *end, bytebuf &out)
@@ -190,45 +829,50 @@ static void HexDecode(const char *str, const char *end, bytebuf &out)
   }
 }
 
-static void Obj2XML(pugi::xml_node &parent, SDObject &child)
+static void Obj2XML(XMLStreamWriter &xml, const SDObject &child, bool arrayElement)
 {
-  pugi::xml_node obj = parent.append_child(typeNames[(uint32_t)child.type.basetype]);
+  xml.BeginElement(typeNames[(uint32_t)child.type.basetype]);
 
-  obj.append_attribute("name") = child.name.c_str();
+  // array elements are all named $el, so there's no need to store it
+  if(!arrayElement)
+    xml.Attribute("name", child.name);
 
-  if(!child.type.name.empty())
-    obj.append_attribute("typename") = child.type.name.c_str();
+  // similarly the array's type is the type of its elements, if it has any
+  if(!child.type.name.empty() &&
+     !(child.type.basetype == SDBasic::Array && child.NumChildren() > 0))
+    xml.Attribute("typename", child.type.name);
 
   if(child.type.basetype == SDBasic::UnsignedInteger ||
      child.type.basetype == SDBasic::SignedInteger || child.type.basetype == SDBasic::Float ||
      child.type.basetype == SDBasic::Resource)
   {
-    obj.append_attribute("width") = child.type.byteSize;
+    xml.AttributeUInt("width", child.type.byteSize);
   }
 
   if(child.type.flags & SDTypeFlags::Hidden)
-    obj.append_attribute("hidden") = true;
+    xml.AttributeBool("hidden", true);
 
-  if(child.type.flags & SDTypeFlags::Nullable)
-    obj.append_attribute("nullable") = true;
+  // redundant for null objects
+  if((child.type.flags & SDTypeFlags::Nullable) && child.type.basetype != SDBasic::Null)
+    xml.AttributeBool("nullable", true);
 
   if(child.type.flags & SDTypeFlags::NullString)
-    obj.append_attribute("nullstring") = true;
+    xml.AttributeBool("nullstring", true);
 
   if(child.type.flags & SDTypeFlags::FixedArray)
-    obj.append_attribute("fixedarray") = true;
+    xml.AttributeBool("fixedarray", true);
 
   if(child.type.flags & SDTypeFlags::Union)
-    obj.append_attribute("union") = true;
+    xml.AttributeBool("union", true);
 
   if(child.type.flags & SDTypeFlags::Important)
-    obj.append_attribute("important") = true;
+    xml.AttributeBool("important", true);
 
   if(child.type.flags & SDTypeFlags::ImportantChildren)
-    obj.append_attribute("importantchildren") = true;
+    xml.AttributeBool("importantchildren", true);
 
   if(child.type.flags & SDTypeFlags::HiddenChildren)
-    obj.append_attribute("hiddenchildren") = true;
+    xml.AttributeBool("hiddenchildren", true);
 
   if(child.type.basetype == SDBasic::Chunk)
   {
@@ -236,94 +880,91 @@ static void Obj2XML(pugi::xml_node &parent, SDObject &child)
   }
   else if(child.type.basetype == SDBasic::Null)
   {
-    // redundant
-    obj.remove_attribute("nullable");
   }
   else if(child.type.basetype == SDBasic::Struct || child.type.basetype == SDBasic::Array)
   {
-    if(child.type.basetype == SDBasic::Array && child.NumChildren() > 0)
-      obj.remove_attribute("typename");
-
     for(size_t o = 0; o < child.NumChildren(); o++)
-    {
-      Obj2XML(obj, *child.GetChild(o));
-
-      if(child.type.basetype == SDBasic::Array)
-        obj.last_child().remove_attribute("name");
-    }
+      Obj2XML(xml, *child.GetChild(o), child.type.basetype == SDBasic::Array);
   }
   else if(child.type.basetype == SDBasic::Buffer)
   {
-    obj.append_attribute("byteLength") = child.type.byteSize;
-    obj.text() = child.data.basic.u;
+    xml.AttributeUInt("byteLength", child.type.byteSize);
+    xml.TextUInt(child.data.basic.u);
   }
   else
   {
     if(child.type.flags & SDTypeFlags::HasCustomString)
     {
-      obj.append_attribute("string") = child.data.str.c_str();
+      xml.Attribute("string", child.data.str);
     }
 
     switch(child.type.basetype)
     {
       case SDBasic::Resource:
       case SDBasic::Enum:
-      case SDBasic::UnsignedInteger: obj.text() = child.data.basic.u; break;
-      case SDBasic::SignedInteger: obj.text() = child.data.basic.i; break;
-      case SDBasic::String: obj.text() = child.data.str.c_str(); break;
-      case SDBasic::Float: obj.text() = child.data.basic.d; break;
-      case SDBasic::Boolean: obj.text() = child.data.basic.b; break;
-      case SDBasic::Character:
-      {
-        char str[2] = {child.data.basic.c, '\0'};
-        obj.text().set(str);
-        break;
-      }
+      case SDBasic::UnsignedInteger: xml.TextUInt(child.data.basic.u); break;
+      case SDBasic::SignedInteger: xml.TextInt(child.data.basic.i); break;
+      case SDBasic::String: xml.Text(child.data.str); break;
+      case SDBasic::Float: xml.TextFloat(child.data.basic.d); break;
+      case SDBasic::Boolean: xml.TextBool(child.data.basic.b); break;
+      case SDBasic::Character: xml.Text(&child.data.basic.c, 1); break;
       default: RDCERR("Unexpected case");
     }
   }
+
+  xml.EndElement();
 }
 
 static RDResult Structured2XML(const rdcstr &filename, const RDCFile &file, uint64_t version,
                                const StructuredChunkList &chunks, RENDERDOC_ProgressCallback progress)
 {
-  pugi::xml_document doc;
+  StreamWriter stream(FileIO::fopen(filename, FileIO::WriteBinary), Ownership::Stream);
 
-  pugi::xml_node xRoot = doc.append_child("rdc");
+  if(stream.IsErrored())
+    return stream.GetError();
 
-  {
-    pugi::xml_node xHeader = xRoot.append_child("header");
+  XMLStreamWriter xml(stream);
 
-    pugi::xml_node xDriver = xHeader.append_child("driver");
-    xDriver.append_attribute("id") = (uint32_t)file.GetDriver();
-    xDriver.text() = file.GetDriverName().c_str();
+  xml.BeginElement("rdc");
 
-    pugi::xml_node xIdent = xHeader.append_child("machineIdent");
+  {
+    xml.BeginElement("header");
+
+    xml.BeginElement("driver");
+    xml.AttributeUInt("id", (uint32_t)file.GetDriver());
+    xml.Text(file.GetDriverName());
+    xml.EndElement();
 
-    xIdent.text().set(file.GetMachineIdent());
+    xml.BeginElement("machineIdent");
+    xml.TextUInt(file.GetMachineIdent());
+    xml.EndElement();
 
-    pugi::xml_node xThumbnail = xHeader.append_child("thumbnail");
+    xml.BeginElement("thumbnail");
 
     const RDCThumb &th = file.GetThumbnail();
     if(!th.pixels.empty() && th.width > 0 && th.height > 0)
     {
-      xThumbnail.append_attribute("width") = th.width;
-      xThumbnail.append_attribute("height") = th.height;
+      xml.AttributeUInt("width", th.width);
+      xml.AttributeUInt("height", th.height);
 
       if(th.format == FileType::JPG)
-        xThumbnail.text() = "thumb.jpg";
+        xml.Text("thumb.jpg");
       else if(th.format == FileType::PNG)
-        xThumbnail.text() = "thumb.png";
+        xml.Text("thumb.png");
       else if(th.format == FileType::Raw)
-        xThumbnail.text() = "thumb.raw";
+        xml.Text("thumb.raw");
       else
         RDCERR("Unexpected thumbnail format %s", ToStr(th.format).c_str());
     }
 
-    pugi::xml_node xTimebase = xHeader.append_child("timebase");
+    xml.EndElement();
 
-    xTimebase.append_attribute("base") = file.GetTimestampBase();
-    xTimebase.append_attribute("frequency") = file.GetTimestampFrequency();
+    xml.BeginElement("timebase");
+    xml.AttributeUInt("base", file.GetTimestampBase());
+    xml.AttributeFloat("frequency", file.GetTimestampFrequency());
+    xml.EndElement();
+
+    xml.EndElement();
   }
 
   if(progress)
@@ -348,20 +989,22 @@ static RDResult Structured2XML(const rdcstr &filename, const RDCFile &file, uint
         bool succeeded = reader->SkipBytes(thumbHeader.len) && !reader->IsErrored();
         if(succeeded && (uint32_t)thumbHeader.format < (uint32_t)FileType::Count)
         {
-          pugi::xml_node xExtThumbnail = xRoot.append_child("extended_thumbnail");
+          xml.BeginElement("extended_thumbnail");
 
-          xExtThumbnail.append_attribute("width") = thumbHeader.width;
-          xExtThumbnail.append_attribute("height") = thumbHeader.height;
-          xExtThumbnail.append_attribute("length") = thumbHeader.len;
+          xml.AttributeUInt("width", thumbHeader.width);
+          xml.AttributeUInt("height", thumbHeader.height);
+          xml.AttributeUInt("length", thumbHeader.len);
 
           if(thumbHeader.format == FileType::JPG)
-            xExtThumbnail.text() = "ext_thumb.jpg";
+            xml.Text("ext_thumb.jpg");
           else if(thumbHeader.format == FileType::PNG)
-            xExtThumbnail.text() = "ext_thumb.png";
+            xml.Text("ext_thumb.png");
           else if(thumbHeader.format == FileType::Raw)
-            xExtThumbnail.text() = "ext_thumb.raw";
+            xml.Text("ext_thumb.raw");
           else
             RDCERR("Unexpected extended thumbnail format %s", ToStr(thumbHeader.format).c_str());
+
+          xml.EndElement();
         }
       }
 
@@ -370,116 +1013,131 @@ static RDResult Structured2XML(const rdcstr &filename, const RDCFile &file, uint
     }
     else if(props.type == SectionType::EmbeddedLogfile)
     {
-      pugi::xml_node xLogfile = xRoot.append_child("diagnostic_log");
-      xLogfile.text() = "diagnostic.log";
+      xml.BeginElement("diagnostic_log");
+      xml.Text("diagnostic.log");
+      xml.EndElement();
 
       delete reader;
       continue;
     }
 
-    pugi::xml_node xSection = xRoot.append_child("section");
+    xml.BeginElement("section");
 
     if(props.flags & SectionFlags::ASCIIStored)
-      xSection.append_attribute("ascii");
+      xml.Attribute("ascii", "");
     if(props.flags & SectionFlags::LZ4Compressed)
-      xSection.append_attribute("lz4");
+      xml.Attribute("lz4", "");
     if(props.flags & SectionFlags::ZstdCompressed)
-      xSection.append_attribute("zstd");
+      xml.Attribute("zstd", "");
 
-    pugi::xml_node name = xSection.append_child("name");
-    name.text() = props.name.c_str();
+    xml.BeginElement("name");
+    xml.Text(props.name);
+    xml.EndElement();
 
-    pugi::xml_node secVer = xSection.append_child("version");
-    secVer.text() = props.version;
+    xml.BeginElement("version");
+    xml.TextUInt(props.version);
+    xml.EndElement();
 
-    pugi::xml_node type = xSection.append_child("type");
-    type.text() = (uint32_t)props.type;
+    xml.BeginElement("type");
+    xml.TextUInt((uint32_t)props.type);
+    xml.EndElement();
 
     bytebuf contents;
     contents.resize((size_t)reader->GetSize());
     reader->Read(contents.data(), reader->GetSize());
 
-    pugi::xml_node data = xSection.append_child("data");
+    xml.BeginElement("data");
 
     if(props.flags & SectionFlags::ASCIIStored)
     {
       // insert the contents literally
-      data.text().set((char *)contents.data());
+      xml.Text((const char *)contents.data(), contents.size());
     }
     else
     {
       // encode to simple hex. Not efficient, but easy.
-      rdcstr hexdata;
-      hexdata.reserve(contents.size() * 2);
-      HexEncode(contents, hexdata);
-      data.text().set(hexdata.c_str());
+      HexEncode(xml, contents.data(), contents.size());
     }
 
+    xml.EndElement();
+
+    xml.EndElement();
+
     delete reader;
   }
 
   if(progress)
     progress(StructuredProgress(0.2f));
 
-  pugi::xml_node xChunks = xRoot.append_child("chunks");
+  xml.BeginElement("chunks");
 
-  xChunks.append_attribute("version") = version;
+  xml.AttributeUInt("version", version);
 
   for(size_t c = 0; c < chunks.size(); c++)
   {
-    pugi::xml_node xChunk = xChunks.append_child("chunk");
-    SDChunk *chunk = chunks[c];
+    const SDChunk *chunk = chunks[c];
+
+    xml.BeginElement("chunk");
 
-    xChunk.append_attribute("id") = chunk->metadata.chunkID;
-    xChunk.append_attribute("name") = chunk->name.c_str();
-    xChunk.append_attribute("length") = chunk->metadata.length;
+    xml.AttributeUInt("id", chunk->metadata.chunkID);
+    xml.Attribute("name", chunk->name);
+    xml.AttributeUInt("length", chunk->metadata.length);
     if(chunk->metadata.threadID)
-      xChunk.append_attribute("threadID") = chunk->metadata.threadID;
+      xml.AttributeUInt("threadID", chunk->metadata.threadID);
     if(chunk->metadata.timestampMicro)
-      xChunk.append_attribute("timestamp") = chunk->metadata.timestampMicro;
+      xml.AttributeUInt("timestamp", chunk->metadata.timestampMicro);
     if(chunk->metadata.durationMicro >= 0)
-      xChunk.append_attribute("duration") = chunk->metadata.durationMicro;
+      xml.AttributeInt("duration", chunk->metadata.durationMicro);
+    if(chunk->metadata.flags & SDChunkFlags::OpaqueChunk)
+      xml.AttributeBool("opaque", true);
+
     if(chunk->metadata.flags & SDChunkFlags::HasCallstack)
     {
-      pugi::xml_node stack = xChunk.append_child("callstack");
+      xml.BeginElement("callstack");
 
       for(size_t i = 0; i < chunk->metadata.callstack.size(); i++)
       {
-        stack.append_child("address").text() = chunk->metadata.callstack[i];
+        xml.BeginElement("address");
+        xml.TextUInt(chunk->metadata.callstack[i]);
+        xml.EndElement();
       }
+
+      xml.EndElement();
     }
 
     if(chunk->metadata.flags & SDChunkFlags::OpaqueChunk)
     {
-      xChunk.append_attribute("opaque") = true;
-
       RDCASSERT(chunk->NumChildren() > 0);
-      pugi::xml_node opaque = xChunk.append_child("buffer");
-      opaque.append_attribute("byteLength") = chunk->GetChild(0)->type.byteSize;
-      opaque.text() = chunk->GetChild(0)->data.basic.u;
+      xml.BeginElement("buffer");
+      xml.AttributeUInt("byteLength", chunk->GetChild(0)->type.byteSize);
+      xml.TextUInt(chunk->GetChild(0)->data.basic.u);
+      xml.EndElement();
     }
     else
     {
       for(size_t o = 0; o < chunk->NumChildren(); o++)
-        Obj2XML(xChunk, *chunk->GetChild(o));
+        Obj2XML(xml, *chunk->GetChild(o), false);
     }
 
+    xml.EndElement();
+
     if(progress)
       progress(StructuredProgress(0.2f + 0.8f * (float(c) / float(chunks.size()))));
   }
 
-  xml_file_writer writer(filename);
-  doc.save(writer);
+  xml.EndElement();
+
+  xml.EndElement();
 
-  return writer.stream.GetError();
+  return xml.GetError();
 }
 
-static SDObject *XML2Obj(pugi::xml_node &obj)
+// reads an object from the element that was just started, up to and including its end.
+static SDObject *XML2Obj(XMLStreamReader &xml)
 {
-  SDObject *ret = new SDObject(rdcstr(obj.attribute("name").as_string()),
-                               rdcstr(obj.attribute("typename").as_string()));
+  SDObject *ret = new SDObject(rdcstr(xml.Attribute("name")), rdcstr(xml.Attribute("typename")));
 
-  rdcstr name = obj.name();
+  const rdcstr &name = xml.Name();
 
   for(size_t i = 0; i < ARRAY_COUNT(typeNames); i++)
   {
@@ -493,35 +1151,30 @@ static SDObject *XML2Obj(pugi::xml_node &obj)
   if(ret->type.basetype == SDBasic::UnsignedInteger || ret->type.basetype == SDBasic::SignedInteger ||
      ret->type.basetype == SDBasic::Float || ret->type.basetype == SDBasic::Resource)
   {
-    ret->type.byteSize = obj.attribute("width").as_uint();
+    ret->type.byteSize = xml.AttributeUInt("width");
   }
 
-  if(obj.attribute("hidden"))
+  if(xml.HasAttribute("hidden"))
     ret->type.flags |= SDTypeFlags::Hidden;
 
-  if(obj.attribute("nullable"))
+  if(xml.HasAttribute("nullable"))
     ret->type.flags |= SDTypeFlags::Nullable;
 
-  if(obj.attribute("fixedarray"))
+  if(xml.HasAttribute("fixedarray"))
     ret->type.flags |= SDTypeFlags::FixedArray;
 
-  if(obj.attribute("union"))
+  if(xml.HasAttribute("union"))
     ret->type.flags |= SDTypeFlags::Union;
 
-  if(obj.attribute("important"))
+  if(xml.HasAttribute("important"))
     ret->type.flags |= SDTypeFlags::Important;
 
-  if(obj.attribute("importantchildren"))
+  if(xml.HasAttribute("importantchildren"))
     ret->type.flags |= SDTypeFlags::ImportantChildren;
 
-  if(obj.attribute("hiddenchildren"))
+  if(xml.HasAttribute("hiddenchildren"))
     ret->type.flags |= SDTypeFlags::HiddenChildren;
 
-  if(obj.attribute("typename"))
-    ret->type.name = obj.attribute("typename").as_string();
-
-  ret->name = obj.attribute("name").as_string();
-
   if(ret->type.basetype == SDBasic::Chunk)
   {
     RDCFATAL("Nested chunks!");
@@ -529,15 +1182,25 @@ static SDObject *XML2Obj(pugi::xml_node &obj)
   else if(ret->type.basetype == SDBasic::Null)
   {
     ret->type.flags |= SDTypeFlags::Nullable;
+    xml.SkipElement();
   }
   else if(ret->type.basetype == SDBasic::Struct || ret->type.basetype == SDBasic::Array)
   {
-    for(pugi::xml_node child = obj.first_child(); child; child = child.next_sibling())
+    for(;;)
     {
-      SDObject *c = ret->AddAndOwnChild(XML2Obj(child));
+      XMLStreamReader::Token tok = xml.Next();
+
+      if(tok == XMLStreamReader::Token::StartElement)
+      {
+        SDObject *c = ret->AddAndOwnChild(XML2Obj(xml));
 
-      if(ret->type.basetype == SDBasic::Array)
-        c->name = "$el";
+        if(ret->type.basetype == SDBasic::Array)
+          c->name = "$el";
+      }
+      else if(tok != XMLStreamReader::Token::Text)
+      {
+        break;
+      }
     }
 
     if(ret->type.basetype == SDBasic::Array && ret->NumChildren() > 0)
@@ -545,30 +1208,40 @@ static SDObject *XML2Obj(pugi::xml_node &obj)
   }
   else if(ret->type.basetype == SDBasic::Buffer)
   {
-    ret->type.byteSize = obj.attribute("byteLength").as_ullong();
-    ret->data.basic.u = obj.text().as_uint();
+    ret->type.byteSize = xml.AttributeUInt("byteLength");
+
+    rdcstr text;
+    xml.ReadElementText(text);
+    ret->data.basic.u = XMLStreamReader::ToUInt(text.c_str());
   }
   else
   {
-    if(obj.attribute("string"))
+    if(xml.HasAttribute("string"))
     {
       ret->type.flags |= SDTypeFlags::HasCustomString;
-      ret->data.str = obj.attribute("string").as_string();
+      ret->data.str = xml.Attribute("string");
     }
 
-    if(obj.attribute("nullstring"))
+    if(xml.HasAttribute("nullstring"))
       ret->type.flags |= SDTypeFlags::NullString;
 
+    rdcstr text;
+    xml.ReadElementText(text);
+
     switch(ret->type.basetype)
     {
       case SDBasic::Resource:
       case SDBasic::Enum:
-      case SDBasic::UnsignedInteger: ret->data.basic.u = obj.text().as_ullong(); break;
-      case SDBasic::SignedInteger: ret->data.basic.i = obj.text().as_llong(); break;
-      case SDBasic::String: ret->data.str = obj.text().as_string(); break;
-      case SDBasic::Float: ret->data.basic.d = obj.text().as_double(); break;
-      case SDBasic::Boolean: ret->data.basic.b = obj.text().as_bool(); break;
-      case SDBasic::Character: ret->data.basic.c = obj.text().as_string()[0]; break;
+      case SDBasic::UnsignedInteger:
+        ret->data.basic.u = XMLStreamReader::ToUInt(text.c_str());
+        break;
+      case SDBasic::SignedInteger:
+        ret->data.basic.i = XMLStreamReader::ToInt(text.c_str());
+        break;
+      case SDBasic::String: ret->data.str = text; break;
+      case SDBasic::Float: ret->data.basic.d = atof(text.c_str()); break;
+      case SDBasic::Boolean: ret->data.basic.b = XMLStreamReader::ToBool(text.c_str()); break;
+      case SDBasic::Character: ret->data.basic.c = text.empty() ? '\0' : text[0]; break;
       default: RDCERR("Unexpected case");
     }
   }
@@ -576,69 +1249,88 @@ static SDObject *XML2Obj(pugi::xml_node &obj)
   return ret;
 }
 
-static RDResult XML2Structured(const rdcstr &xml, const ThumbTypeAndData &thumb,
+// move to the next element start or end, skipping any text
+static XMLStreamReader::Token NextElement(XMLStreamReader &xml)
+{
+  XMLStreamReader::Token tok;
+  do
+  {
+    tok = xml.Next();
+  } while(tok == XMLStreamReader::Token::Text);
+  return tok;
+}
+
+#define EXPECT_ELEMENT(expected)                                                                \
+  if(NextElement(xml) != XMLStreamReader::Token::StartElement || xml.Name() != expected)       \
+  {                                                                                             \
+    if(!xml.Error().empty())                                                                    \
+      RETURN_ERROR_RESULT(ResultCode::FileCorrupted, "Malformed xml document: %s",              \
+                          xml.Error().c_str());                                                 \
+    RETURN_ERROR_RESULT(ResultCode::FileCorrupted,                                              \
+                        "Malformed xml document, expected <%s> node got <%s>", expected,        \
+                        xml.Name().c_str());                                                    \
+  }
+
+static RDResult XML2Structured(StreamReader &reader, const ThumbTypeAndData &thumb,
                                const ThumbTypeAndData &extThumb, const bytebuf &logfile,
                                const StructuredBufferList &buffers, RDCFile *rdc, uint64_t &version,
                                StructuredChunkList &chunks, RENDERDOC_ProgressCallback progress)
 {
-  pugi::xml_document doc;
-  doc.load_string(xml.c_str());
-
-  pugi::xml_node root = doc.child("rdc");
+  XMLStreamReader xml(reader);
 
-  if(!root)
+  if(NextElement(xml) != XMLStreamReader::Token::StartElement || xml.Name() != "rdc")
     RETURN_ERROR_RESULT(ResultCode::FileCorrupted,
                         "Malformed xml document, couldn't get root <rdc> node");
 
-  pugi::xml_node xHeader = root.first_child();
-
-  if(strcmp(xHeader.name(), "header") != 0)
-    RETURN_ERROR_RESULT(ResultCode::FileCorrupted,
-                        "Malformed xml document, expected <header> node got <%s>", xHeader.name());
+  EXPECT_ELEMENT("header");
 
   // process the header and push meta-data into RDC
   {
-    pugi::xml_node xDriver = xHeader.first_child();
-
-    if(strcmp(xDriver.name(), "driver") != 0)
-      RETURN_ERROR_RESULT(ResultCode::FileCorrupted,
-                          "Malformed xml document, expected <driver> node got <%s>", xDriver.name());
-
-    RDCDriver driver = (RDCDriver)xDriver.attribute("id").as_uint();
-    rdcstr driverName = xDriver.text().as_string();
+    EXPECT_ELEMENT("driver");
 
-    pugi::xml_node xIdent = xDriver.next_sibling();
+    RDCDriver driver = (RDCDriver)xml.AttributeUInt("id");
+    rdcstr driverName;
+    xml.ReadElementText(driverName);
 
-    uint64_t machineIdent = xIdent.text().as_ullong();
+    if(NextElement(xml) != XMLStreamReader::Token::StartElement)
+      RETURN_ERROR_RESULT(ResultCode::FileCorrupted,
+                          "Malformed xml document, expected <machineIdent> node");
 
-    pugi::xml_node xThumbnail = xIdent.next_sibling();
+    rdcstr text;
+    xml.ReadElementText(text);
+    uint64_t machineIdent = XMLStreamReader::ToUInt(text.c_str());
 
-    if(strcmp(xThumbnail.name(), "thumbnail") != 0)
-      RETURN_ERROR_RESULT(ResultCode::FileCorrupted,
-                          "Malformed xml document, expected <thumbnail> node got <%s>",
-                          xThumbnail.name());
+    EXPECT_ELEMENT("thumbnail");
 
-    pugi::xml_node xTimebase = xThumbnail.next_sibling();
+    RDCThumb th;
+    th.format = thumb.format;
+    th.width = (uint16_t)xml.AttributeUInt("width");
+    th.height = (uint16_t)xml.AttributeUInt("height");
+    xml.SkipElement();
 
     uint64_t timeBase = 0;
     double timeFreq = 1.0;
 
     // newer XML documents have the timebase here, allow conversion without it
-    if(xTimebase)
+    XMLStreamReader::Token tok = NextElement(xml);
+
+    if(tok == XMLStreamReader::Token::StartElement)
     {
-      if(strcmp(xTimebase.name(), "timebase") != 0)
+      if(xml.Name() != "timebase")
         RETURN_ERROR_RESULT(ResultCode::FileCorrupted,
                             "Malformed xml document, expected <timebase> node got <%s>",
-                            xTimebase.name());
+                            xml.Name().c_str());
 
-      timeBase = xTimebase.attribute("base").as_ullong();
-      timeFreq = xTimebase.attribute("frequency").as_double();
+      timeBase = xml.AttributeUInt("base");
+      timeFreq = xml.AttributeFloat("frequency");
+      xml.SkipElement();
+
+      tok = NextElement(xml);
     }
 
-    RDCThumb th;
-    th.format = thumb.format;
-    th.width = (uint16_t)xThumbnail.attribute("width").as_uint();
-    th.height = (uint16_t)xThumbnail.attribute("height").as_uint();
+    if(tok != XMLStreamReader::Token::EndElement)
+      RETURN_ERROR_RESULT(ResultCode::FileCorrupted,
+                          "Malformed xml document, unexpected <%s> in header", xml.Name().c_str());
 
     RDCThumb *rdcthumb = NULL;
 
@@ -655,12 +1347,13 @@ static RDResult XML2Structured(const rdcstr &xml, const ThumbTypeAndData &thumb,
     progress(StructuredProgress(0.1f));
 
   // push in other sections
-  pugi::xml_node xSection = xHeader.next_sibling();
+  XMLStreamReader::Token tok = NextElement(xml);
 
-  while(!strcmp(xSection.name(), "section") || !strcmp(xSection.name(), "extended_thumbnail") ||
-        !strcmp(xSection.name(), "diagnostic_log"))
+  while(tok == XMLStreamReader::Token::StartElement &&
+        (xml.Name() == "section" || xml.Name() == "extended_thumbnail" ||
+         xml.Name() == "diagnostic_log"))
   {
-    if(!strcmp(xSection.name(), "extended_thumbnail"))
+    if(xml.Name() == "extended_thumbnail")
     {
       SectionProperties props = {};
       props.type = SectionType::ExtendedThumbnail;
@@ -668,8 +1361,8 @@ static RDResult XML2Structured(const rdcstr &xml, const ThumbTypeAndData &thumb,
       StreamWriter *w = rdc->WriteSection(props);
 
       ExtThumbnailHeader header;
-      header.width = (uint16_t)xSection.attribute("width").as_uint();
-      header.height = (uint16_t)xSection.attribute("height").as_uint();
+      header.width = (uint16_t)xml.AttributeUInt("width");
+      header.height = (uint16_t)xml.AttributeUInt("height");
       header.len = (uint32_t)extThumb.data.size();
       header.format = extThumb.format;
       w->Write(header);
@@ -679,10 +1372,11 @@ static RDResult XML2Structured(const rdcstr &xml, const ThumbTypeAndData &thumb,
 
       delete w;
 
-      xSection = xSection.next_sibling();
+      xml.SkipElement();
+      tok = NextElement(xml);
       continue;
     }
-    else if(!strcmp(xSection.name(), "diagnostic_log"))
+    else if(xml.Name() == "diagnostic_log")
     {
       SectionProperties props = {};
       props.type = SectionType::EmbeddedLogfile;
@@ -695,153 +1389,189 @@ static RDResult XML2Structured(const rdcstr &xml, const ThumbTypeAndData &thumb,
 
       delete w;
 
-      xSection = xSection.next_sibling();
+      xml.SkipElement();
+      tok = NextElement(xml);
       continue;
     }
 
     SectionProperties props;
 
-    if(xSection.attribute("ascii"))
+    if(xml.HasAttribute("ascii"))
       props.flags |= SectionFlags::ASCIIStored;
-    if(xSection.attribute("lz4"))
+    if(xml.HasAttribute("lz4"))
       props.flags |= SectionFlags::LZ4Compressed;
-    if(xSection.attribute("zstd"))
+    if(xml.HasAttribute("zstd"))
       props.flags |= SectionFlags::ZstdCompressed;
 
-    pugi::xml_node name = xSection.child("name");
-    if(!name)
+    bool hasName = false, hasVersion = false, hasType = false, hasData = false;
+    rdcstr data;
+
+    while(NextElement(xml) == XMLStreamReader::Token::StartElement)
+    {
+      rdcstr child = xml.Name();
+      rdcstr text;
+      xml.ReadElementText(text);
+
+      if(child == "name")
+      {
+        props.name = text;
+        hasName = true;
+      }
+      else if(child == "version")
+      {
+        props.version = XMLStreamReader::ToUInt(text.c_str());
+        hasVersion = true;
+      }
+      else if(child == "type")
+      {
+        props.type = (SectionType)XMLStreamReader::ToUInt(text.c_str());
+        hasType = true;
+      }
+      else if(child == "data")
+      {
+        data.swap(text);
+        hasData = true;
+      }
+    }
+
+    tok = NextElement(xml);
+
+    if(!hasName)
     {
       RDCERR("Malformed section, expected name node");
-      xSection = xSection.next_sibling();
       continue;
     }
-    props.name = name.text().as_string();
-
-    pugi::xml_node secVer = xSection.child("version");
-    if(!secVer)
+    if(!hasVersion)
     {
       RDCERR("Malformed section, expected version node");
-      xSection = xSection.next_sibling();
       continue;
     }
-    props.version = secVer.text().as_ullong();
-
-    pugi::xml_node type = xSection.child("type");
-    if(!type)
+    if(!hasType)
     {
       RDCERR("Malformed section, expected type node");
-      xSection = xSection.next_sibling();
       continue;
     }
-    props.type = (SectionType)type.text().as_uint();
-
-    pugi::xml_node data = xSection.child("data");
-    if(!data)
+    if(!hasData)
     {
       RDCERR("Malformed section, expected data node");
-      xSection = xSection.next_sibling();
       continue;
     }
 
-    const char *str = (const char *)data.text().get();
-    size_t len = strlen(str);
-
     StreamWriter *writer = rdc->WriteSection(props);
 
     if(props.flags & SectionFlags::ASCIIStored)
     {
-      writer->Write(str, len);
+      writer->Write(data.c_str(), data.size());
     }
     else
     {
       bytebuf decoded;
-      HexDecode(str, str + len, decoded);
+      HexDecode(data.c_str(), data.c_str() + data.size(), decoded);
       writer->Write(decoded.data(), decoded.size());
     }
 
     writer->Finish();
     delete writer;
-
-    xSection = xSection.next_sibling();
   }
 
   if(progress)
     progress(StructuredProgress(0.2f));
 
-  pugi::xml_node xChunks = xSection;
-
-  if(strcmp(xSection.name(), "chunks") != 0)
+  if(tok != XMLStreamReader::Token::StartElement || xml.Name() != "chunks")
+  {
+    if(!xml.Error().empty())
+      RETURN_ERROR_RESULT(ResultCode::FileCorrupted, "Malformed xml document: %s",
+                          xml.Error().c_str());
     RETURN_ERROR_RESULT(ResultCode::FileCorrupted,
-                        "Malformed xml document, expected <chunks> node, got <%s>", xSection.name());
+                        "Malformed xml document, expected <chunks> node, got <%s>",
+                        xml.Name().c_str());
+  }
 
-  if(!xChunks.attribute("version"))
+  if(!xml.HasAttribute("version"))
     RETURN_ERROR_RESULT(ResultCode::FileCorrupted,
                         "Malformed xml document, expected version attribute");
 
-  version = xChunks.attribute("version").as_ullong();
-
-  size_t chunkIdx = 0;
-  size_t numChunks = std::distance(xChunks.begin(), xChunks.end());
+  version = xml.AttributeUInt("version");
 
-  for(pugi::xml_node xChunk = xChunks.first_child(); xChunk; xChunk = xChunk.next_sibling())
+  for(tok = NextElement(xml); tok == XMLStreamReader::Token::StartElement; tok = NextElement(xml))
   {
-    if(strcmp(xChunk.name(), "chunk") != 0)
+    if(xml.Name() != "chunk")
       RETURN_ERROR_RESULT(ResultCode::FileCorrupted,
                           "Malformed xml document, expected <chunk> child under <chunks>, got <%s>",
-                          xChunk.name());
+                          xml.Name().c_str());
 
-    SDChunk *chunk = new SDChunk(rdcstr(xChunk.attribute("name").as_string()));
+    SDChunk *chunk = new SDChunk(rdcstr(xml.Attribute("name")));
 
-    chunk->metadata.chunkID = xChunk.attribute("id").as_uint();
-    chunk->metadata.length = xChunk.attribute("length").as_uint();
-    if(xChunk.attribute("threadID"))
-      chunk->metadata.threadID = xChunk.attribute("threadID").as_ullong();
-    if(xChunk.attribute("timestamp"))
-      chunk->metadata.timestampMicro = xChunk.attribute("timestamp").as_ullong();
-    if(xChunk.attribute("duration"))
-      chunk->metadata.durationMicro = xChunk.attribute("duration").as_ullong();
+    chunk->metadata.chunkID = (uint32_t)xml.AttributeUInt("id");
+    chunk->metadata.length = (uint32_t)xml.AttributeUInt("length");
+    if(xml.HasAttribute("threadID"))
+      chunk->metadata.threadID = xml.AttributeUInt("threadID");
+    if(xml.HasAttribute("timestamp"))
+      chunk->metadata.timestampMicro = xml.AttributeUInt("timestamp");
+    if(xml.HasAttribute("duration"))
+      chunk->metadata.durationMicro = xml.AttributeInt("duration");
 
-    pugi::xml_node callstack = xChunk.child("callstack");
-    if(callstack)
-    {
-      chunk->metadata.flags |= SDChunkFlags::HasCallstack;
-
-      size_t i = 0;
-      for(pugi::xml_node address = callstack.first_child(); address; address = address.next_sibling())
-      {
-        chunk->metadata.callstack.push_back(address.text().as_ullong());
-        i++;
-      }
-    }
-
-    if(xChunk.attribute("opaque"))
-    {
-      pugi::xml_node opaque = xChunk.child("buffer");
+    bool opaque = xml.HasAttribute("opaque");
 
+    if(opaque)
       chunk->metadata.flags |= SDChunkFlags::OpaqueChunk;
 
-      SDObject *buf = chunk->AddAndOwnChild(new SDObject("Opaque chunk"_lit, "Byte Buffer"_lit));
-      buf->type.basetype = SDBasic::Buffer;
-      buf->type.byteSize = opaque.attribute("byteLength").as_ullong();
-      buf->data.basic.u = opaque.text().as_ullong();
-    }
-    else
+    // chunks are added as soon as they're created so they're cleaned up if we bail out below
+    chunks.push_back(chunk);
+
+    while(NextElement(xml) == XMLStreamReader::Token::StartElement)
     {
-      for(pugi::xml_node child = xChunk.first_child(); child; child = child.next_sibling())
-        chunk->AddAndOwnChild(XML2Obj(child));
+      if(xml.Name() == "callstack")
+      {
+        chunk->metadata.flags |= SDChunkFlags::HasCallstack;
+
+        while(NextElement(xml) == XMLStreamReader::Token::StartElement)
+        {
+          rdcstr text;
+          xml.ReadElementText(text);
+          chunk->metadata.callstack.push_back(XMLStreamReader::ToUInt(text.c_str()));
+        }
+      }
+      else if(opaque)
+      {
+        if(xml.Name() == "buffer" && chunk->NumChildren() == 0)
+        {
+          SDObject *buf =
+              chunk->AddAndOwnChild(new SDObject("Opaque chunk"_lit, "Byte Buffer"_lit));
+          buf->type.basetype = SDBasic::Buffer;
+          buf->type.byteSize = xml.AttributeUInt("byteLength");
+
+          rdcstr text;
+          xml.ReadElementText(text);
+          buf->data.basic.u = XMLStreamReader::ToUInt(text.c_str());
+        }
+        else
+        {
+          xml.SkipElement();
+        }
+      }
+      else
+      {
+        chunk->AddAndOwnChild(XML2Obj(xml));
+      }
     }
 
-    chunks.push_back(chunk);
+    if(!xml.Error().empty())
+      break;
 
     if(progress)
-      progress(StructuredProgress(0.2f + 0.8f * (float(chunkIdx) / float(numChunks))));
-
-    chunkIdx++;
+      progress(StructuredProgress(0.2f + 0.8f * xml.Progress()));
   }
 
+  if(!xml.Error().empty())
+    RETURN_ERROR_RESULT(ResultCode::FileCorrupted, "Malformed xml document: %s",
+                        xml.Error().c_str());
+
   return ResultCode::Succeeded;
 }
 
+#undef EXPECT_ELEMENT
+
 static RDResult Buffers2ZIP(const rdcstr &filename, const RDCFile &file,
                             const StructuredBufferList &buffers, RENDERDOC_ProgressCallback progress)
 {
@@ -858,12 +1588,78 @@ static RDResult Buffers2ZIP(const rdcstr &filename, const RDCFile &file,
                         zipFile.c_str(), mz_zip_get_error_string(zip.m_last_error));
   }
 
-  for(size_t i = 0; i < buffers.size(); i++)
+  // buffers below this size aren't worth sending to another thread, they're compressed inline
+  const size_t parallelThreshold = 64 * 1024;
+  // the most uncompressed data to have in flight at once, to bound the compressed copies held
+  const size_t batchLimit = 64 * 1024 * 1024;
+
+  const mz_uint level = 2;
+  const int deflateFlags = (int)tdefl_create_comp_flags_from_zip_params(
+      level, -MZ_DEFAULT_WINDOW_BITS, MZ_DEFAULT_STRATEGY);
+
+  struct CompressedBuffer
   {
-    mz_zip_writer_add_mem(&zip, GetBufferName(i).c_str(), buffers[i]->data(), buffers[i]->size(), 2);
+    void *data;
+    size_t size;
+    mz_uint32 crc;
+  };
 
-    if(progress)
-      progress(BufferProgress(float(i) / float(buffers.size())));
+  rdcarray<CompressedBuffer> compressed;
+  compressed.resize(buffers.size());
+
+  Threading::JobQueue jobs;
+
+  // large buffers are deflated on worker threads a batch at a time, then added to the archive in
+  // order on this thread as pre-compressed data
+  for(size_t batchStart = 0; batchStart < buffers.size();)
+  {
+    size_t batchEnd = batchStart;
+    size_t batchSize = 0;
+
+    while(batchEnd < buffers.size() && (batchEnd == batchStart || batchSize < batchLimit))
+    {
+      const bytebuf *buf = buffers[batchEnd];
+      CompressedBuffer &comp = compressed[batchEnd];
+      comp = {};
+
+      if(buf->size() >= parallelThreshold)
+      {
+        batchSize += buf->size();
+
+        jobs.Push([buf, &comp, deflateFlags]() {
+          comp.crc = (mz_uint32)mz_crc32(MZ_CRC32_INIT, buf->data(), buf->size());
+          comp.data =
+              tdefl_compress_mem_to_heap(buf->data(), buf->size(), &comp.size, deflateFlags);
+        });
+      }
+
+      batchEnd++;
+    }
+
+    jobs.Wait();
+
+    for(size_t i = batchStart; i < batchEnd; i++)
+    {
+      const bytebuf *buf = buffers[i];
+      CompressedBuffer &comp = compressed[i];
+
+      if(comp.data)
+      {
+        mz_zip_writer_add_mem_ex(&zip, GetBufferName(i).c_str(), comp.data, comp.size, NULL, 0,
+                                 level | MZ_ZIP_FLAG_COMPRESSED_DATA, buf->size(), comp.crc);
+        mz_free(comp.data);
+        comp.data = NULL;
+      }
+      else
+      {
+        mz_zip_writer_add_mem(&zip, GetBufferName(i).c_str(), buf->data(), buf->size(), level);
+      }
+
+      if(progress)
+        progress(BufferProgress(float(i) / float(buffers.size())));
+    }
+
+    batchStart = batchEnd;
   }
 
   const RDCThumb &th = file.GetThumbnail();
@@ -938,6 +1734,7 @@ static RDResult Buffers2ZIP(const rdcstr &filename, const RDCFile &file,
   return ResultCode::Succeeded;
 }
 
+
 static RDResult ZIP2Buffers(const rdcstr &filename, ThumbTypeAndData &thumb,
                             ThumbTypeAndData &extThumb, bytebuf &logfile,
                             StructuredBufferList &buffers, RENDERDOC_ProgressCallback progress)
@@ -966,9 +1763,8 @@ static RDResult ZIP2Buffers(const rdcstr &filename, ThumbTypeAndData &thumb,
       mz_zip_archive_file_stat zstat;
       mz_zip_reader_file_stat(&zip, i, &zstat);
 
-      size_t sz = 0;
-
-      byte *buf = (byte *)mz_zip_reader_extract_to_heap(&zip, i, &sz, 0);
+      // decompress straight into the destination rather than via a temporary heap copy
+      bytebuf *dst = NULL;
 
       // thumbnails are stored separately
       if(strstr(zstat.m_filename, "thumb"))
@@ -982,18 +1778,18 @@ static RDResult ZIP2Buffers(const rdcstr &filename, ThumbTypeAndData &thumb,
         if(strstr(zstat.m_filename, "ext_thumb"))
         {
           extThumb.format = type;
-          extThumb.data.assign(buf, sz);
+          dst = &extThumb.data;
         }
         else
         {
           thumb.format = type;
-          thumb.data.assign(buf, sz);
+          dst = &thumb.data;
         }
       }
       else if(strstr(zstat.m_filename, "diagnostic.log"))
       {
         // same for logfile
-        logfile.assign(buf, sz);
+        dst = &logfile;
       }
       else
       {
@@ -1002,11 +1798,20 @@ static RDResult ZIP2Buffers(const rdcstr &filename, ThumbTypeAndData &thumb,
         if(bufname < (int)buffers.size())
         {
           buffers[bufname] = new bytebuf;
-          buffers[bufname]->assign(buf, sz);
+          dst = buffers[bufname];
         }
       }
 
-      free(buf);
+      if(dst)
+      {
+        dst->resize((size_t)zstat.m_uncomp_size);
+        if(!dst->empty() && !mz_zip_reader_extract_to_mem(&zip, i, dst->data(), dst->size(), 0))
+        {
+          RDCERR("Failed to extract %s from zip: %s", zstat.m_filename,
+                 mz_zip_get_error_string(zip.m_last_error));
+          dst->clear();
+        }
+      }
 
       if(progress)
         progress(BufferProgress(float(i) / float(numfiles)));
@@ -1030,11 +1835,7 @@ RDResult importXMLZ(const rdcstr &filename, StreamReader &reader, RDCFile *rdc,
       return res;
   }
 
-  rdcstr buf;
-  buf.resize((size_t)reader.GetSize());
-  reader.Read(buf.data(), buf.size());
-
-  return XML2Structured(buf.c_str(), thumb, extThumb, logfile, structData.buffers, rdc,
+  return XML2Structured(reader, thumb, extThumb, logfile, structData.buffers, rdc,
                         structData.version, structData.chunks, progress);
 }
 
@@ -1072,3 +1873,222 @@ static ConversionRegistration XMLOnlyConversionRegistration(
 easier to work with but it cannot then be imported.)",
         false,
     });
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+TEST_CASE("Round-trip structured data through XML+ZIP", "[xml]")
+{
+  rdcstr filename = FileIO::GetTempFolderFilename() + "rdoc_xml_test.zip.xml";
+
+  RDCFile rdc;
+  rdc.SetData(RDCDriver::Vulkan, "Vulkan", 0x123456789ULL, NULL, 1000, 2.5);
+
+  const rdcstr asciiText = "Some <notes> & \"quoted\" text\n\twith\r\nline endings\x01";
+
+  bytebuf binary;
+  for(uint32_t i = 0; i < 200; i++)
+    binary.push_back(byte(i * 7));
+
+  {
+    SectionProperties props;
+    props.name = "test/ascii";
+    props.type = SectionType::Notes;
+    props.version = 3;
+    props.flags = SectionFlags::ASCIIStored;
+    StreamWriter *w = rdc.WriteSection(props);
+    w->Write(asciiText.c_str(), asciiText.size());
+    w->Finish();
+    delete w;
+
+    props.name = "test/binary";
+    props.type = SectionType::Bookmarks;
+    props.version = 5;
+    props.flags = SectionFlags::ZstdCompressed;
+    w = rdc.WriteSection(props);
+    w->Write(binary.data(), binary.size());
+    w->Finish();
+    delete w;
+  }
+
+  SDFile sdfile;
+  sdfile.version = 0x10;
+
+  // one buffer big enough to be compressed on a worker thread, and some small ones
+  sdfile.buffers.push_back(new bytebuf);
+  sdfile.buffers.back()->resize(300 * 1024);
+  for(size_t i = 0; i < sdfile.buffers.back()->size(); i++)
+    (*sdfile.buffers.back())[i] = byte((i * i) >> 7);
+  sdfile.buffers.push_back(new bytebuf(binary));
+  sdfile.buffers.push_back(new bytebuf);
+
+  {
+    SDChunk *chunk = new SDChunk("vkFakeFunction"_lit);
+    chunk->metadata.chunkID = 1234;
+    chunk->metadata.length = 5678;
+    chunk->metadata.threadID = 42;
+    chunk->metadata.timestampMicro = 99999;
+    chunk->metadata.durationMicro = 15;
+    chunk->metadata.flags = SDChunkFlags::HasCallstack;
+    chunk->metadata.callstack = {0x1000, 0xfffffffffffffff0ULL};
+
+    chunk->AddAndOwnChild(makeSDUInt64("u64"_lit, 0xfedcba9876543210ULL));
+    chunk->AddAndOwnChild(makeSDInt32("i32"_lit, -123456));
+    chunk->AddAndOwnChild(makeSDFloat("float"_lit, 1.0f / 3.0f));
+    chunk->AddAndOwnChild(makeSDBool("bool"_lit, true));
+    chunk->AddAndOwnChild(makeSDString("str"_lit, "<tag attr=\"v\"> & \x02 \xc3\xa9"));
+    chunk->AddAndOwnChild(makeSDString("empty"_lit, ""));
+    chunk->AddAndOwnChild(makeSDEnum("enum"_lit, 7))->SetCustomString("Seven &");
+    chunk->AddAndOwnChild(makeSDResourceId("res"_lit, ResourceId()));
+
+    SDObject *c = chunk->AddAndOwnChild(new SDObject("char"_lit, "char"_lit));
+    c->type.basetype = SDBasic::Character;
+    c->type.byteSize = 1;
+    c->data.basic.c = '<';
+
+    SDObject *null = chunk->AddAndOwnChild(new SDObject("null"_lit, "Foo"_lit));
+    null->type.basetype = SDBasic::Null;
+    null->type.flags = SDTypeFlags::Nullable;
+
+    SDObject *buf = chunk->AddAndOwnChild(new SDObject("buf"_lit, "Byte Buffer"_lit));
+    buf->type.basetype = SDBasic::Buffer;
+    buf->type.byteSize = binary.size();
+    buf->data.basic.u = 1;
+
+    SDObject *s = chunk->AddAndOwnChild(makeSDStruct("struct"_lit, "MyStruct"_lit));
+    s->type.flags = SDTypeFlags::Important | SDTypeFlags::HiddenChildren;
+    s->AddAndOwnChild(makeSDUInt32("a"_lit, 1))->type.flags = SDTypeFlags::Hidden;
+    SDObject *arr = s->AddAndOwnChild(makeSDArray("arr"_lit));
+    arr->type.flags = SDTypeFlags::FixedArray;
+    arr->AddAndOwnChild(makeSDUInt32("$el"_lit, 10));
+    arr->AddAndOwnChild(makeSDUInt32("$el"_lit, 20));
+    s->AddAndOwnChild(makeSDArray("emptyarr"_lit));
+
+    sdfile.chunks.push_back(chunk);
+
+    SDChunk *opaque = new SDChunk("Opaque"_lit);
+    opaque->metadata.chunkID = 5;
+    opaque->metadata.flags = SDChunkFlags::OpaqueChunk;
+    buf = opaque->AddAndOwnChild(new SDObject("Opaque chunk"_lit, "Byte Buffer"_lit));
+    buf->type.basetype = SDBasic::Buffer;
+    buf->type.byteSize = 300 * 1024;
+    buf->data.basic.u = 0;
+
+    sdfile.chunks.push_back(opaque);
+  }
+
+  RDResult res = exportXMLZ(filename, rdc, sdfile, RENDERDOC_ProgressCallback());
+  REQUIRE(res.code == ResultCode::Succeeded);
+
+  RDCFile imported;
+  SDFile importedData;
+  {
+    StreamReader reader(FileIO::fopen(filename, FileIO::ReadBinary));
+    res = importXMLZ(filename, reader, &imported, importedData, RENDERDOC_ProgressCallback());
+  }
+  REQUIRE(res.code == ResultCode::Succeeded);
+
+  CHECK(imported.GetDriver() == RDCDriver::Vulkan);
+  CHECK(imported.GetDriverName() == "Vulkan");
+  CHECK(imported.GetMachineIdent() == 0x123456789ULL);
+  CHECK(imported.GetTimestampBase() == 1000);
+  CHECK(imported.GetTimestampFrequency() == 2.5);
+
+  REQUIRE(imported.NumSections() == 2);
+
+  for(int i = 0; i < 2; i++)
+  {
+    const SectionProperties &props = imported.GetSectionProperties(i);
+    StreamReader *r = imported.ReadSection(i);
+    bytebuf contents;
+    contents.resize((size_t)r->GetSize());
+    r->Read(contents.data(), contents.size());
+    delete r;
+
+    if(i == 0)
+    {
+      CHECK(props.name == "test/ascii");
+      CHECK(props.type == SectionType::Notes);
+      CHECK(props.version == 3);
+      CHECK(props.flags == SectionFlags::ASCIIStored);
+      // carriage returns are normalised away by XML parsing
+      CHECK(rdcstr((const char *)contents.data(), contents.size()) ==
+            "Some <notes> & \"quoted\" text\n\twith\nline endings\x01");
+    }
+    else
+    {
+      CHECK(props.name == "test/binary");
+      CHECK(props.type == SectionType::Bookmarks);
+      CHECK(props.version == 5);
+      CHECK(props.flags == SectionFlags::ZstdCompressed);
+      CHECK((contents == binary));
+    }
+  }
+
+  CHECK(importedData.version == 0x10);
+
+  REQUIRE(importedData.buffers.size() == sdfile.buffers.size());
+  for(size_t i = 0; i < sdfile.buffers.size(); i++)
+    CHECK((*importedData.buffers[i] == *sdfile.buffers[i]));
+
+  REQUIRE(importedData.chunks.size() == sdfile.chunks.size());
+  for(size_t i = 0; i < sdfile.chunks.size(); i++)
+  {
+    const SDChunk *a = sdfile.chunks[i];
+    const SDChunk *b = importedData.chunks[i];
+
+    CHECK(a->name == b->name);
+    CHECK(a->metadata.chunkID == b->metadata.chunkID);
+    CHECK(a->metadata.length == b->metadata.length);
+    CHECK(a->metadata.threadID == b->metadata.threadID);
+    CHECK(a->metadata.timestampMicro == b->metadata.timestampMicro);
+    CHECK(a->metadata.durationMicro == b->metadata.durationMicro);
+    CHECK(a->metadata.flags == b->metadata.flags);
+    CHECK((a->metadata.callstack == b->metadata.callstack));
+    REQUIRE(a->NumChildren() == b->NumChildren());
+
+    for(size_t c = 0; c < a->NumChildren(); c++)
+    {
+      const SDObject *ac = a->GetChild(c);
+      const SDObject *bc = b->GetChild(c);
+
+      CHECK(ac->name == bc->name);
+      CHECK(ac->type.name == bc->type.name);
+      CHECK(ac->type.basetype == bc->type.basetype);
+      CHECK(ac->type.flags == bc->type.flags);
+      // only sized types and buffers store their byte size
+      if(ac->type.basetype == SDBasic::UnsignedInteger ||
+         ac->type.basetype == SDBasic::SignedInteger || ac->type.basetype == SDBasic::Float ||
+         ac->type.basetype == SDBasic::Resource || ac->type.basetype == SDBasic::Buffer)
+        CHECK(ac->type.byteSize == bc->type.byteSize);
+      CHECK(ac->HasEqualValue(bc));
+    }
+  }
+
+  // the nested members are also preserved
+  const SDObject *s = importedData.chunks[0]->FindChild("struct");
+  REQUIRE(s);
+  CHECK(s->GetChild(0)->type.flags == SDTypeFlags::Hidden);
+  CHECK(s->GetChild(1)->type.flags == SDTypeFlags::FixedArray);
+  CHECK(s->GetChild(1)->GetChild(1)->name == "$el");
+  CHECK(s->GetChild(1)->GetChild(1)->data.basic.u == 20);
+
+  // a truncated document fails cleanly rather than importing partial data
+  {
+    bytebuf xml;
+    REQUIRE(FileIO::ReadAll(filename, xml));
+    xml.resize(xml.size() / 2);
+
+    StreamReader reader(xml);
+    RDCFile truncated;
+    SDFile truncatedData;
+    res = importXMLZ(rdcstr(), reader, &truncated, truncatedData, RENDERDOC_ProgressCallback());
+    CHECK(res.code == ResultCode::FileCorrupted);
+  }
+
+  FileIO::Delete(filename);
+  FileIO::Delete(strip_extension(filename));
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -22,8 +22,11 @@
  * THE SOFTWARE.
  ******************************************************************************/
 
+#include "adaptiveio.h"
 #include "lz4io.h"
+#include "readaheadio.h"
 #include "serialiser.h"
+#include "transferio.h"
 #include "zstdio.h"
 
 #if ENABLED(ENABLE_UNIT_TESTS)
@@ -190,4 +193,505 @@ TEST_CASE("Test ZSTD compression/decompression", "[streamio][zstd]")
   delete[] randomData;
 };
 
+TEST_CASE("Test read-ahead decompression", "[streamio][readahead]")
+{
+  // not a multiple of the block size, so the last block is partial
+  const uint64_t size = 3 * 1024 * 1024 + 1234;
+  const uint64_t blockSize = 64 * 1024;
+
+  bytebuf data;
+  data.resize((size_t)size);
+  for(size_t i = 0; i < data.size(); i++)
+    data[i] = (i % 1000) < 500 ? byte(i & 0xff) : byte(rand() & 0xff);
+
+  StreamWriter buf(StreamWriter::DefaultScratchSize);
+
+  {
+    StreamWriter writer(new ZSTDCompressor(&buf, Ownership::Nothing), Ownership::Stream);
+    writer.Write(data.data(), size);
+    writer.Finish();
+
+    CHECK_FALSE(writer.IsErrored());
+  }
+
+  auto makeDecompressor = [&buf, size, blockSize]() {
+    return new ReadAheadDecompressor(
+        new ZSTDDecompressor(new StreamReader(buf.GetData(), buf.GetOffset()), Ownership::Stream),
+        size, blockSize);
+  };
+
+  SECTION("Reads of varying sizes")
+  {
+    StreamReader reader(makeDecompressor(), size, Ownership::Stream);
+
+    bytebuf readData;
+    readData.resize((size_t)size);
+
+    // reads smaller than, spanning, and much larger than a block
+    const uint64_t readSizes[] = {1, 7, blockSize - 8, blockSize * 3 + 5, 100, 1024 * 1024};
+
+    uint64_t offs = 0;
+    for(uint64_t readSize : readSizes)
+    {
+      reader.Read(readData.data() + offs, readSize);
+      offs += readSize;
+    }
+    reader.Read(readData.data() + offs, size - offs);
+
+    CHECK_FALSE(reader.IsErrored());
+    CHECK(reader.AtEnd());
+    CHECK((readData == data));
+
+    // reading past the end fails without reading anything
+    byte dummy = 0;
+    CHECK_FALSE(reader.Read(dummy));
+    CHECK(reader.IsErrored());
+  };
+
+  SECTION("Recompress the rest after a partial read")
+  {
+    ReadAheadDecompressor *decomp = makeDecompressor();
+
+    bytebuf readData;
+    readData.resize(1000);
+    CHECK(decomp->Read(readData.data(), readData.size()));
+    CHECK((readData == bytebuf(data.data(), readData.size())));
+
+    StreamWriter recompressed(StreamWriter::DefaultScratchSize);
+    {
+      LZ4Compressor comp(&recompressed, Ownership::Nothing);
+      CHECK(decomp->Recompress(&comp));
+    }
+
+    delete decomp;
+
+    StreamReader reader(
+        new LZ4Decompressor(new StreamReader(recompressed.GetData(), recompressed.GetOffset()),
+                            Ownership::Stream),
+        size - 1000, Ownership::Stream);
+
+    readData.resize((size_t)size - 1000);
+    reader.Read(readData.data(), readData.size());
+
+    CHECK_FALSE(reader.IsErrored());
+    CHECK((readData == bytebuf(data.data() + 1000, readData.size())));
+  };
+
+  SECTION("Destroying with a block in flight")
+  {
+    // the first block is queued on construction, and must be waited for
+    delete makeDecompressor();
+  };
+};
+
+TEST_CASE("Test adaptive compression/decompression", "[streamio][adaptive]")
+{
+  uint32_t allowed = SupportedNetworkCodecs();
+
+  SECTION("All codecs")
+  {
+    allowed = SupportedNetworkCodecs();
+  };
+
+  SECTION("No compression")
+  {
+    allowed = NetworkCodecBit(NetworkCodec::None);
+  };
+
+  SECTION("LZ4 only")
+  {
+    allowed = NetworkCodecBit(NetworkCodec::None) | NetworkCodecBit(NetworkCodec::LZ4);
+  };
+
+  SECTION("ZSTD only")
+  {
+    allowed = NetworkCodecBit(NetworkCodec::None) | NetworkCodecBit(NetworkCodec::ZSTD);
+  };
+
+  // the two ends of a connection each have their own state
+  AdaptiveCodec sender(allowed), receiver(allowed);
+
+  // writing to memory is so fast that the big data may or may not be compressed, and the sender
+  // will learn not to bother. Send the small messages as on a new connection with the default
+  // estimates so they are compressed.
+  AdaptiveCodec smallSender(allowed), smallReceiver(allowed);
+
+  StreamWriter buf(StreamWriter::DefaultScratchSize);
+
+  const uint64_t bigSize = 4 * 1024 * 1024 + 123;
+
+  bytebuf bigData;
+  bigData.resize((size_t)bigSize);
+  for(uint64_t i = 0; i < bigSize; i++)
+    bigData[(size_t)i] = (i / (1024 * 1024)) == 1 ? byte(rand() & 0xff) : byte(i & 0xff);
+
+  // lots of small messages, as the proxy sends for e.g. constant buffer contents at each event.
+  // Each is compressed against the history of the messages before it.
+  const size_t numMessages = 64;
+  rdcarray<bytebuf> messages;
+  messages.resize(numMessages);
+  for(size_t m = 0; m < numMessages; m++)
+  {
+    messages[m].resize(1024);
+    for(size_t i = 0; i < 1024; i++)
+      messages[m][i] = byte((i % 64) * 3);
+    memcpy(messages[m].data() + 256, &m, sizeof(m));
+  }
+
+  uint64_t smallStart = 0, smallSize = 0, resyncStart = 0;
+  rdcarray<uint64_t> messageOffsets;
+
+  // write the data
+  {
+    CHECK(AdaptiveBufferSend(&buf, bigData, sender));
+
+    smallStart = buf.GetOffset();
+
+    for(size_t m = 0; m < numMessages; m++)
+    {
+      messageOffsets.push_back(buf.GetOffset());
+
+      StreamWriter writer(new AdaptiveCompressor(&buf, smallSender, Ownership::Nothing),
+                          Ownership::Stream);
+
+      writer.Write(messages[m].data(), messages[m].size());
+      writer.Finish();
+
+      CHECK_FALSE(writer.IsErrored());
+    }
+
+    smallSize = buf.GetOffset() - smallStart;
+    resyncStart = buf.GetOffset();
+
+    // a bulk send resets the history
+    CHECK(AdaptiveBufferSend(&buf, messages[0], smallSender));
+
+    CHECK_FALSE(buf.IsErrored());
+  }
+
+  if(allowed == NetworkCodecBit(NetworkCodec::None))
+  {
+    // only the size and block headers are added
+    CHECK(smallStart < bigSize + 64 * 10 + 8);
+    CHECK(smallSize == numMessages * (1024 + 10));
+  }
+  else
+  {
+    // apart from the first, each message is almost entirely a repeat of the one before.
+    CHECK(smallSize < numMessages * 1024 / 16);
+  }
+
+  // decode everything in the same order
+  {
+    StreamReader reader(buf.GetData(), buf.GetOffset());
+
+    bytebuf readData;
+    CHECK(AdaptiveBufferReceive(&reader, readData, receiver));
+    CHECK((readData == bigData));
+
+    for(size_t m = 0; m < numMessages; m++)
+    {
+      StreamReader msgReader(new AdaptiveDecompressor(&reader, smallReceiver, Ownership::Nothing),
+                             messages[m].size(), Ownership::Stream);
+
+      readData.resize(messages[m].size());
+      msgReader.Read(readData.data(), readData.size());
+
+      CHECK_FALSE(msgReader.IsErrored());
+      CHECK((readData == messages[m]));
+    }
+
+    CHECK(AdaptiveBufferReceive(&reader, readData, smallReceiver));
+    CHECK((readData == messages[0]));
+
+    CHECK_FALSE(reader.IsErrored());
+    CHECK(reader.AtEnd());
+  }
+
+  // a message that is only partly read still has all of its blocks decoded, so the messages after
+  // it decode as normal
+  {
+    AdaptiveCodec partial(allowed);
+
+    StreamReader reader(buf.GetData() + smallStart, smallSize);
+
+    for(size_t m = 0; m < numMessages; m++)
+    {
+      StreamReader msgReader(new AdaptiveDecompressor(&reader, partial, Ownership::Nothing),
+                             messages[m].size(), Ownership::Stream);
+
+      bytebuf readData;
+      readData.resize(m % 2 ? messages[m].size() : 100);
+      msgReader.Read(readData.data(), readData.size());
+
+      CHECK_FALSE(msgReader.IsErrored());
+      CHECK((memcmp(readData.data(), messages[m].data(), readData.size()) == 0));
+    }
+  }
+
+  // a message that is skipped entirely leaves the histories different, so the next message that
+  // was compressed against it fails instead of decoding to the wrong data. The next bulk send
+  // resynchronises.
+  if(allowed != NetworkCodecBit(NetworkCodec::None))
+  {
+    AdaptiveCodec skipped(allowed);
+
+    {
+      StreamReader reader(buf.GetData() + messageOffsets[0], messageOffsets[1] - messageOffsets[0]);
+      StreamReader msgReader(new AdaptiveDecompressor(&reader, skipped, Ownership::Nothing),
+                             messages[0].size(), Ownership::Stream);
+
+      bytebuf readData;
+      readData.resize(messages[0].size());
+      msgReader.Read(readData.data(), readData.size());
+
+      CHECK_FALSE(msgReader.IsErrored());
+      CHECK((readData == messages[0]));
+    }
+
+    {
+      StreamReader reader(buf.GetData() + messageOffsets[2], messageOffsets[3] - messageOffsets[2]);
+      StreamReader msgReader(new AdaptiveDecompressor(&reader, skipped, Ownership::Nothing),
+                             messages[2].size(), Ownership::Stream);
+
+      bytebuf readData;
+      readData.resize(messages[2].size());
+      msgReader.Read(readData.data(), readData.size());
+
+      CHECK(msgReader.IsErrored());
+    }
+
+    {
+      StreamReader reader(buf.GetData() + resyncStart, buf.GetOffset() - resyncStart);
+
+      bytebuf readData;
+      CHECK(AdaptiveBufferReceive(&reader, readData, skipped));
+      CHECK((readData == messages[0]));
+    }
+  }
+};
+
+// simulates a network link by discarding data, optionally blocking on every write to be slow
+class TestLink : public Compressor
+{
+public:
+  TestLink(bool slow) : Compressor(NULL, Ownership::Nothing), m_Slow(slow) {}
+  bool Write(const void *data, uint64_t numBytes)
+  {
+    // roughly 4MB/s
+    if(m_Slow)
+      Threading::Sleep(uint32_t(1 + numBytes / 4096));
+    return true;
+  }
+  bool Finish() { return true; }
+
+private:
+  bool m_Slow;
+};
+
+TEST_CASE("Test adaptive compression codec choice", "[streamio][adaptive]")
+{
+  AdaptiveCodec codec;
+
+  bytebuf data;
+  data.resize(4 * 1024 * 1024);
+
+  SECTION("Incompressible data on a fast link is sent as-is")
+  {
+    for(byte &b : data)
+      b = byte(rand() & 0xff);
+
+    StreamWriter fast(new TestLink(false), Ownership::Stream);
+    CHECK(AdaptiveBufferSend(&fast, data, codec));
+
+    CHECK(codec.GetPreferredCodec() == NetworkCodec::None);
+  };
+
+  SECTION("Compressible data on a slow link is compressed strongly")
+  {
+    for(byte &b : data)
+      b = byte(rand() & 0xf);
+
+    StreamWriter slow(new TestLink(true), Ownership::Stream);
+    CHECK(AdaptiveBufferSend(&slow, data, codec));
+
+    CHECK(codec.GetLinkThroughput() < 10.0e6);
+    CHECK(codec.GetPreferredCodec() == NetworkCodec::ZSTD);
+  };
+};
+
+// receive a chunked transfer over a loopback connection, where the sender sends the first cutoff
+// bytes of sent and then drops the connection.
+static bool ReceiveOverLoopback(const bytebuf &sent, uint64_t cutoff, const rdcstr &partialPath)
+{
+  Network::Socket *server = NULL;
+  uint16_t port = 38960;
+  for(; server == NULL && port < 38990; port++)
+    server = Network::CreateServerSocket("127.0.0.1", port, 1);
+  port--;
+
+  REQUIRE(server);
+
+  Threading::ThreadHandle sender = Threading::CreateThread([server, &sent, cutoff]() {
+    Network::Socket *client = server->AcceptClient(5000);
+    if(client)
+      client->SendDataBlocking(sent.data(), (uint32_t)RDCMIN(cutoff, (uint64_t)sent.size()));
+    delete client;
+  });
+
+  Network::Socket *sock = Network::CreateClientSocket("127.0.0.1", port, 5000);
+
+  bool complete = false;
+
+  if(sock)
+  {
+    StreamReader reader(sock, Ownership::Nothing);
+    AdaptiveCodec codec;
+    complete = ChunkedFileReceive(&reader, partialPath, codec);
+  }
+
+  Threading::JoinThread(sender);
+  Threading::CloseThread(sender);
+
+  delete sock;
+  delete server;
+
+  return complete;
+}
+
+// what the sender would send to a receiver with partialPath
+static bytebuf ChunkedSendToMemory(const rdcstr &srcPath, const rdcstr &partialPath,
+                                   uint32_t allowedCodecs = SupportedNetworkCodecs())
+{
+  uint64_t resumeOffset = 0, resumeChecksum = 0;
+  GetTransferResumePoint(partialPath, resumeOffset, resumeChecksum);
+
+  StreamWriter buf(StreamWriter::DefaultScratchSize);
+  AdaptiveCodec codec(allowedCodecs);
+  CHECK(ChunkedFileSend(&buf, srcPath, resumeOffset, resumeChecksum, codec));
+
+  return bytebuf(buf.GetData(), (size_t)buf.GetOffset());
+}
+
+static bytebuf ReadWholeFile(const rdcstr &path)
+{
+  bytebuf ret;
+  FILE *f = FileIO::fopen(path, FileIO::ReadBinary);
+  if(f)
+  {
+    ret.resize((size_t)FileIO::GetFileSize(path));
+    FileIO::fread(ret.data(), 1, ret.size(), f);
+    FileIO::fclose(f);
+  }
+  return ret;
+}
+
+static void WriteWholeFile(const rdcstr &path, const bytebuf &data)
+{
+  FILE *f = FileIO::fopen(path, FileIO::WriteBinary);
+  REQUIRE(f);
+  FileIO::fwrite(data.data(), 1, data.size(), f);
+  FileIO::fclose(f);
+}
+
+TEST_CASE("Test resumable chunked file transfer", "[streamio][transfer]")
+{
+  rdcstr dir = FileIO::GetTempFolderFilename() + "/RenderDoc/";
+  rdcstr srcPath = dir + "transfer_test_src.bin";
+  rdcstr partialPath = dir + "transfer_test_dst.bin.partial";
+
+  FileIO::CreateParentDirectory(srcPath);
+  FileIO::Delete(partialPath);
+
+  // a few whole chunks and a partial one, partly compressible
+  const uint64_t size = TransferChunkSize * 3 + 12345;
+
+  bytebuf data;
+  data.resize((size_t)size);
+  for(uint64_t i = 0; i < size; i++)
+    data[(size_t)i] = (i / TransferChunkSize) == 1 ? byte(rand() & 0xff) : byte((i * 7) >> 4);
+
+  WriteWholeFile(srcPath, data);
+
+  uint64_t offset = 0, checksum = 0;
+
+  SECTION("Uninterrupted transfer")
+  {
+    CHECK(ReceiveOverLoopback(ChunkedSendToMemory(srcPath, partialPath), ~0ULL, partialPath));
+    CHECK((ReadWholeFile(partialPath) == data));
+  };
+
+  SECTION("Transfer resumes after disconnects")
+  {
+    // drop the connection partway through the second chunk
+    bytebuf sent = ChunkedSendToMemory(srcPath, partialPath);
+    CHECK_FALSE(ReceiveOverLoopback(sent, TransferChunkSize + TransferChunkSize / 2, partialPath));
+
+    // only the verified first chunk is kept
+    GetTransferResumePoint(partialPath, offset, checksum);
+    CHECK(offset == TransferChunkSize);
+
+    // the resumed transfer only sends the rest, then drops just before the end
+    sent = ChunkedSendToMemory(srcPath, partialPath);
+    CHECK(sent.size() < size);
+    CHECK_FALSE(ReceiveOverLoopback(sent, sent.size() - 10, partialPath));
+
+    GetTransferResumePoint(partialPath, offset, checksum);
+    CHECK(offset == TransferChunkSize * 3);
+
+    // drop the connection immediately
+    sent = ChunkedSendToMemory(srcPath, partialPath);
+    CHECK_FALSE(ReceiveOverLoopback(sent, 0, partialPath));
+
+    GetTransferResumePoint(partialPath, offset, checksum);
+    CHECK(offset == TransferChunkSize * 3);
+
+    // finally complete it
+    sent = ChunkedSendToMemory(srcPath, partialPath);
+    CHECK(ReceiveOverLoopback(sent, ~0ULL, partialPath));
+    CHECK((ReadWholeFile(partialPath) == data));
+  };
+
+  SECTION("Changed source restarts from the beginning")
+  {
+    bytebuf sent = ChunkedSendToMemory(srcPath, partialPath);
+    CHECK_FALSE(ReceiveOverLoopback(sent, TransferChunkSize * 2 + 100, partialPath));
+
+    GetTransferResumePoint(partialPath, offset, checksum);
+    CHECK(offset == TransferChunkSize * 2);
+
+    data[100] ^= 0xff;
+    WriteWholeFile(srcPath, data);
+
+    // the sender sees the first chunk doesn't match and sends everything
+    sent = ChunkedSendToMemory(srcPath, partialPath);
+    CHECK(sent.size() > size / 2);
+    CHECK(ReceiveOverLoopback(sent, ~0ULL, partialPath));
+    CHECK((ReadWholeFile(partialPath) == data));
+  };
+
+  SECTION("Corrupted chunks are not written")
+  {
+    // send uncompressed so that we can corrupt the data directly
+    bytebuf sent = ChunkedSendToMemory(srcPath, partialPath, NetworkCodecBit(NetworkCodec::None));
+
+    // corrupt a byte in the third chunk's contents
+    sent[sent.size() - TransferChunkSize / 2] ^= 0x1;
+
+    StreamReader reader(sent);
+    AdaptiveCodec codec(NetworkCodecBit(NetworkCodec::None));
+    CHECK_FALSE(ChunkedFileReceive(&reader, partialPath, codec));
+
+    // the stream was still read to the end
+    CHECK_FALSE(reader.IsErrored());
+    CHECK(reader.AtEnd());
+
+    GetTransferResumePoint(partialPath, offset, checksum);
+    CHECK(offset == TransferChunkSize * 2);
+  };
+
+  FileIO::Delete(srcPath);
+  FileIO::Delete(partialPath);
+};
+
 #endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -0,0 +1,228 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "parallel_export.h"
+#include "common/threading.h"
+#include "core/settings.h"
+#include "serialiser.h"
+
+RDOC_CONFIG(uint32_t, Replay_StructuredExportThreads, 0,
+            "The number of worker threads to decode a capture's chunks on when exporting it to "
+            "structured data. 0 uses one thread per core, 1 decodes everything in order on one "
+            "thread.");
+
+uint32_t GetStructuredExportThreads()
+{
+  uint32_t threads = Replay_StructuredExportThreads();
+  if(threads == 0)
+    threads = Threading::GetNumberOfCores();
+  return RDCMAX(threads, 1U);
+}
+
+static void RebaseBuffers(SDObject *obj, uint64_t numSrcBuffers, uint64_t base)
+{
+  // objects only reference buffers when the buffers were exported, so anything out of range is
+  // left alone
+  if(obj->type.basetype == SDBasic::Buffer && obj->data.basic.u < numSrcBuffers)
+    obj->data.basic.u += base;
+
+  for(size_t i = 0; i < obj->NumChildren(); i++)
+    RebaseBuffers(obj->GetChild(i), numSrcBuffers, base);
+}
+
+void AppendStructuredFile(SDFile &dst, SDFile &src)
+{
+  if(!src.buffers.empty() && !dst.buffers.empty())
+  {
+    for(SDChunk *chunk : src.chunks)
+      RebaseBuffers(chunk, src.buffers.size(), dst.buffers.size());
+  }
+
+  dst.chunks.append(src.chunks.data(), src.chunks.size());
+  dst.buffers.append(src.buffers.data(), src.buffers.size());
+
+  // ownership has moved to dst
+  src.chunks.clear();
+  src.buffers.clear();
+}
+
+struct ExportBatch
+{
+  Threading::ThreadHandle thread = 0;
+  bytebuf data;
+  SDFile *output = NULL;
+  RDResult result;
+};
+
+RDResult ExportChunksParallel(StreamReader *reader, uint32_t stopChunkID,
+                              const rdcarray<ChunkBatchExporter> &exporters, SDFile &output,
+                              uint64_t batchSize)
+{
+  if(exporters.empty())
+    return ResultCode::Succeeded;
+
+  // batches are given to the exporters in turn, so the batch in the slot we're about to reuse is
+  // always the oldest one in flight and results are appended in order.
+  rdcarray<ExportBatch> slots;
+  slots.resize(exporters.size());
+  size_t nextSlot = 0;
+
+  RDResult ret = ResultCode::Succeeded;
+
+  auto finish = [&ret, &output](ExportBatch &slot) {
+    if(!slot.thread)
+      return;
+
+    Threading::JoinThread(slot.thread);
+    Threading::CloseThread(slot.thread);
+    slot.thread = 0;
+
+    if(ret == ResultCode::Succeeded)
+    {
+      ret = slot.result;
+
+      if(ret == ResultCode::Succeeded)
+        AppendStructuredFile(output, *slot.output);
+    }
+
+    slot.data.clear();
+    SAFE_DELETE(slot.output);
+  };
+
+  bytebuf batch;
+
+  auto submit = [&]() {
+    ExportBatch &slot = slots[nextSlot];
+    const ChunkBatchExporter &exporter = exporters[nextSlot];
+    nextSlot = (nextSlot + 1) % slots.size();
+
+    finish(slot);
+
+    slot.data.swap(batch);
+    batch.clear();
+    slot.output = new SDFile;
+    slot.thread = Threading::CreateThread([&slot, &exporter]() {
+      StreamReader batchReader(slot.data);
+      slot.result = exporter(&batchReader, *slot.output);
+    });
+  };
+
+  // copy the next size bytes from reader onto the end of the batch
+  auto copy = [&batch, reader](uint64_t size) {
+    size_t offs = batch.size();
+    batch.resize(offs + (size_t)size);
+    return reader->Read(batch.data() + offs, size);
+  };
+
+  // the chunks are copied as-is, including the padding after them. Batches start at a chunk in the
+  // source which is aligned, so the alignment within each batch is the same as in the source.
+  while(ret == ResultCode::Succeeded && !reader->AtEnd())
+  {
+    const size_t chunkStart = batch.size();
+
+    uint32_t c = 0;
+    bool success = copy(sizeof(c));
+    memcpy(&c, batch.data() + chunkStart, sizeof(c));
+
+    if(success && (c & ReadSerialiser::ChunkIndexMask) == stopChunkID)
+    {
+      batch.resize(chunkStart);
+      reader->Rewind(sizeof(c));
+      break;
+    }
+
+    if(success && (c & ReadSerialiser::ChunkCallstack))
+    {
+      uint32_t numFrames = 0;
+      success = copy(sizeof(numFrames));
+      memcpy(&numFrames, batch.data() + batch.size() - sizeof(numFrames), sizeof(numFrames));
+      success = success && copy(numFrames * sizeof(uint64_t));
+    }
+
+    if(success && (c & ReadSerialiser::ChunkThreadID))
+      success = copy(sizeof(uint64_t));
+    if(success && (c & ReadSerialiser::ChunkDuration))
+      success = copy(sizeof(int64_t));
+    if(success && (c & ReadSerialiser::ChunkTimestamp))
+      success = copy(sizeof(uint64_t));
+
+    uint64_t length = 0;
+
+    if(success && (c & ReadSerialiser::Chunk64BitSize))
+    {
+      success = copy(sizeof(length));
+      memcpy(&length, batch.data() + batch.size() - sizeof(length), sizeof(length));
+    }
+    else if(success)
+    {
+      uint32_t length32 = 0;
+      success = copy(sizeof(length32));
+      memcpy(&length32, batch.data() + batch.size() - sizeof(length32), sizeof(length32));
+      length = length32;
+    }
+
+    if(!success)
+    {
+      ret = reader->GetError();
+      break;
+    }
+
+    // chunks written in streaming mode have no length, so the only way to find the end is to
+    // decode them. Leave the rest for the caller.
+    if(length == 0)
+    {
+      uint64_t headerSize = batch.size() - chunkStart;
+      batch.resize(chunkStart);
+
+      if(!reader->Rewind(headerSize))
+        ret = RDResult(ResultCode::APIDataCorrupted,
+                       "Chunk without a length has too large a header to decode in parallel"_lit);
+      break;
+    }
+
+    // the last chunk in the section might not be padded
+    uint64_t offs = reader->GetOffset() + length;
+    uint64_t padding = AlignUp(offs, ReadSerialiser::GetChunkAlignment()) - offs;
+    if(offs + padding > reader->GetSize())
+      padding = 0;
+
+    if(!copy(length + padding))
+    {
+      ret = reader->GetError();
+      break;
+    }
+
+    if(batch.size() >= batchSize)
+      submit();
+  }
+
+  if(ret == ResultCode::Succeeded && !batch.empty())
+    submit();
+
+  // wait for everything still in flight, oldest first
+  for(size_t i = 0; i < slots.size(); i++)
+    finish(slots[(nextSlot + i) % slots.size()]);
+
+  return ret;
+}
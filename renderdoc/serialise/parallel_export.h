@@ -0,0 +1,58 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <functional>
+#include "api/replay/structured_data.h"
+#include "streamio.h"
+
+// decodes every chunk in reader into output. Different exporters run concurrently, so they must not
+// share any state.
+typedef std::function<RDResult(StreamReader *reader, SDFile &output)> ChunkBatchExporter;
+
+// Structured export of a capture section where a leading run of chunks can each be decoded without
+// any state from the chunks before them - e.g. the resource creation and initial contents chunks
+// that come before the frame.
+//
+// The chunks before the first chunk with stopChunkID are read from reader in contiguous batches of
+// around batchSize bytes, and the batches are handed to the exporters in turn to decode on worker
+// threads. Each exporter only has one batch at a time and reading waits for it to be free, so at
+// most one batch per exporter is in memory and reader can be a stream of any size. The results are
+// appended to output in chunk order with buffer references rebased, so output matches a serial
+// decode.
+//
+// On success reader is left at the stop chunk, for the caller to continue decoding serially, or at
+// the end if there is no stop chunk. A chunk that was written without a length can only be found
+// by decoding it, so reading stops before it in the same way.
+RDResult ExportChunksParallel(StreamReader *reader, uint32_t stopChunkID,
+                              const rdcarray<ChunkBatchExporter> &exporters, SDFile &output,
+                              uint64_t batchSize = 8 * 1024 * 1024);
+
+// moves all chunks and buffers from src onto the end of dst, updating buffer indices in the moved
+// chunks. src is left empty.
+void AppendStructuredFile(SDFile &dst, SDFile &src);
+
+// the number of exporters to use for parallel structured export, 1 if it's disabled.
+uint32_t GetStructuredExportThreads();
@@ -27,11 +27,17 @@
 #include "api/replay/version.h"
 #include "common/dds_readwrite.h"
 #include "common/formatting.h"
+#include "core/settings.h"
 #include "jpeg-compressor/jpge.h"
 #include "stb/stb_image.h"
 #include "lz4io.h"
+#include "readaheadio.h"
 #include "zstdio.h"
 
+RDOC_CONFIG(bool, Replay_ReadAheadDecompression, true,
+            "When loading a capture, decompress its data on a worker thread ahead of where it's "
+            "being read and processed.");
+
 // not provided by tinyexr, just do by hand
 bool is_exr_file(FILE *f)
 {
@@ -876,7 +882,7 @@ int RDCFile::SectionIndex(const rdcstr &name) const
   return -1;
 }
 
-StreamReader *RDCFile::ReadSection(int index) const
+StreamReader *RDCFile::ReadSection(int index, bool readAhead) const
 {
   if(m_Error != ResultCode::Succeeded)
     return new StreamReader(StreamReader::InvalidStream, m_Error);
@@ -898,20 +904,24 @@ StreamReader *RDCFile::ReadSection(int index) const
 
   StreamReader *fileReader = new StreamReader(m_File, offsetSize.diskLength, Ownership::Nothing);
 
-  StreamReader *compReader = NULL;
+  Decompressor *decompressor = NULL;
 
+  // the user will delete the compressed reader, and then it will delete the decompressor and the
+  // file reader
   if(props.flags & SectionFlags::LZ4Compressed)
-  {
-    // the user will delete the compressed reader, and then it will delete the compressor and the
-    // file reader
-    compReader = new StreamReader(new LZ4Decompressor(fileReader, Ownership::Stream),
-                                  props.uncompressedSize, Ownership::Stream);
-  }
+    decompressor = new LZ4Decompressor(fileReader, Ownership::Stream);
   else if(props.flags & SectionFlags::ZstdCompressed)
-  {
-    compReader = new StreamReader(new ZSTDDecompressor(fileReader, Ownership::Stream),
-                                  props.uncompressedSize, Ownership::Stream);
-  }
+    decompressor = new ZSTDDecompressor(fileReader, Ownership::Stream);
+
+  // not worth a thread for small sections
+  if(decompressor && readAhead && Replay_ReadAheadDecompression() &&
+     props.uncompressedSize > ReadAheadDecompressor::DefaultBlockSize * 2)
+    decompressor = new ReadAheadDecompressor(decompressor, props.uncompressedSize);
+
+  StreamReader *compReader = NULL;
+
+  if(decompressor)
+    compReader = new StreamReader(decompressor, props.uncompressedSize, Ownership::Stream);
 
   // if we're compressing return that writer, otherwise return the file writer directly
   return compReader ? compReader : fileReader;
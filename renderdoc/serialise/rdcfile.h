@@ -85,7 +85,9 @@ public:
   int SectionIndex(const rdcstr &name) const;
   int NumSections() const { return int(m_Sections.size()); }
   const SectionProperties &GetSectionProperties(int index) const { return m_Sections[index]; }
-  StreamReader *ReadSection(int index) const;
+  // with readAhead, compressed sections are decompressed ahead of the reader on a worker thread.
+  // Nothing else must read from this file until the returned reader is deleted.
+  StreamReader *ReadSection(int index, bool readAhead = false) const;
   StreamWriter *WriteSection(const SectionProperties &props);
 
   // Only valid if GetDriver returns RDCDriver::Image, passes over the underlying FILE * for use
@@ -0,0 +1,154 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "readaheadio.h"
+
+ReadAheadDecompressor::ReadAheadDecompressor(Decompressor *decompressor, uint64_t uncompressedSize,
+                                             uint64_t blockSize)
+    : Decompressor(NULL, Ownership::Nothing), m_Decompressor(decompressor), m_Jobs(1)
+{
+  m_BlockSize = blockSize;
+  m_Unqueued = m_Unread = uncompressedSize;
+
+  for(Block &block : m_Blocks)
+    block.data = AllocAlignedBuffer(m_BlockSize);
+
+  // the current block starts out empty, so the first read waits for this one
+  QueueFill(m_Blocks[1]);
+}
+
+ReadAheadDecompressor::~ReadAheadDecompressor()
+{
+  // wait for any block in flight before the decompressor it's using goes away
+  m_Jobs.Wait();
+
+  for(Block &block : m_Blocks)
+    FreeAlignedBuffer(block.data);
+
+  delete m_Decompressor;
+}
+
+void ReadAheadDecompressor::QueueFill(Block &block)
+{
+  block.length = RDCMIN(m_BlockSize, m_Unqueued);
+  block.offset = 0;
+  block.success = true;
+
+  m_Unqueued -= block.length;
+
+  if(block.length > 0)
+  {
+    Block *b = &block;
+    m_Jobs.Push([this, b]() { b->success = m_Decompressor->Read(b->data, b->length); });
+  }
+}
+
+bool ReadAheadDecompressor::NextBlock()
+{
+  m_Jobs.Wait();
+
+  Block &next = m_Blocks[1 - m_Current];
+
+  if(!next.success)
+  {
+    m_Error = m_Decompressor->GetError();
+    if(m_Error == ResultCode::Succeeded)
+      SET_ERROR_RESULT(m_Error, ResultCode::FileIOFailed, "Failed to decompress data");
+    return false;
+  }
+
+  if(next.length == 0)
+  {
+    SET_ERROR_RESULT(m_Error, ResultCode::FileIOFailed, "Reading off the end of compressed data");
+    return false;
+  }
+
+  // the block we just finished can be refilled while the next one is read from
+  QueueFill(m_Blocks[m_Current]);
+  m_Current = 1 - m_Current;
+
+  return true;
+}
+
+bool ReadAheadDecompressor::Recompress(Compressor *comp)
+{
+  bool success = true;
+
+  while(success && m_Unread > 0)
+  {
+    Block &cur = m_Blocks[m_Current];
+
+    if(cur.offset == cur.length)
+    {
+      success = NextBlock();
+      continue;
+    }
+
+    uint64_t numBytes = cur.length - cur.offset;
+    success = comp->Write(cur.data + cur.offset, numBytes);
+
+    if(!success)
+      m_Error = comp->GetError();
+
+    cur.offset += numBytes;
+    m_Unread -= numBytes;
+  }
+  success &= comp->Finish();
+
+  return success;
+}
+
+bool ReadAheadDecompressor::Read(void *data, uint64_t numBytes)
+{
+  if(m_Error != ResultCode::Succeeded)
+    return false;
+
+  byte *dst = (byte *)data;
+
+  while(numBytes > 0)
+  {
+    Block &cur = m_Blocks[m_Current];
+
+    if(cur.offset == cur.length)
+    {
+      if(!NextBlock())
+        return false;
+      continue;
+    }
+
+    uint64_t chunkSize = RDCMIN(numBytes, cur.length - cur.offset);
+
+    if(dst)
+    {
+      memcpy(dst, cur.data + cur.offset, (size_t)chunkSize);
+      dst += chunkSize;
+    }
+
+    cur.offset += chunkSize;
+    m_Unread -= chunkSize;
+    numBytes -= chunkSize;
+  }
+
+  return true;
+}
@@ -0,0 +1,70 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include "common/threading.h"
+#include "streamio.h"
+
+// Wraps another decompressor and decompresses ahead of the reader on a worker thread, so that
+// decompression and file reading overlap with whatever is consuming the data - e.g. decoding chunks
+// while loading a capture. Reads are served from one block while the next one is being filled.
+//
+// The wrapped decompressor (and the stream it reads from) is only touched from the worker while a
+// block is in flight, so nothing else may use the same file until this is destroyed.
+class ReadAheadDecompressor : public Decompressor
+{
+public:
+  static const uint64_t DefaultBlockSize = 4 * 1024 * 1024;
+
+  ReadAheadDecompressor(Decompressor *decompressor, uint64_t uncompressedSize,
+                        uint64_t blockSize = DefaultBlockSize);
+  ~ReadAheadDecompressor();
+
+  bool Recompress(Compressor *comp);
+  bool Read(void *data, uint64_t numBytes);
+
+private:
+  struct Block
+  {
+    byte *data = NULL;
+    uint64_t length = 0;
+    uint64_t offset = 0;
+    bool success = true;
+  };
+
+  void QueueFill(Block &block);
+  bool NextBlock();
+
+  Decompressor *m_Decompressor;
+  Threading::JobQueue m_Jobs;
+
+  Block m_Blocks[2];
+  size_t m_Current = 0;
+
+  uint64_t m_BlockSize;
+  // bytes not yet queued for decompression, and bytes not yet returned to the reader
+  uint64_t m_Unqueued;
+  uint64_t m_Unread;
+};
@@ -29,6 +29,7 @@
 #include "api/replay/structured_data.h"
 #include "common/formatting.h"
 #include "common/result.h"
+#include "strings/string_intern.h"
 #include "streamio.h"
 
 // function to deallocate anything from a serialise. Default impl
@@ -205,7 +206,7 @@ public:
   {
     if(ExportStructure())
     {
-      m_StructureStack.back()->data.str = ToStr(el);
+      m_StructureStack.back()->data.str = StringIntern::Intern(ToStr(el));
       m_StructureStack.back()->type.flags |= SDTypeFlags::HasCustomString;
     }
   }
@@ -1057,8 +1058,6 @@ public:
       m_InternalElement--;
     }
 
-    size_t byteSize = (size_t)totalSize;
-
     byte *structBuf = NULL;
 
     if(ExportStructure())
@@ -1106,7 +1105,7 @@ public:
       if(totalSize % (uint64_t)bufSize > 0)
         numBufs++;
 
-      byte *buf = new byte[byteSize];
+      byte *buf = new byte[(size_t)bufSize];
 
       if(progress)
         progress(0.0001f);
@@ -1328,7 +1327,7 @@ public:
 
       current.type.basetype = type;
       current.type.byteSize = len;
-      current.data.str = el;
+      current.data.str = StringIntern::InternData(el);
     }
   }
 
@@ -1382,7 +1381,7 @@ public:
 
       current.type.basetype = type;
       current.type.byteSize = RDCMAX(len, 0);
-      current.data.str = el ? el : "";
+      current.data.str = StringIntern::InternData(el ? el : "");
       if(len == -1)
         current.type.flags |= SDTypeFlags::NullString;
     }
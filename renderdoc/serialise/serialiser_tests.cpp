@@ -23,6 +23,9 @@
  ******************************************************************************/
 
 #include "serialiser.h"
+#include "common/timing.h"
+#include "parallel_export.h"
+#include "zstdio.h"
 
 #if ENABLED(ENABLE_UNIT_TESTS)
 
@@ -1437,6 +1440,372 @@ TEST_CASE("Read/write complex types", "[serialiser][structured]")
   delete buf;
 };
 
+// a synthetic capture-like file: many chunks with a handful of distinct names, each with an enum
+// and a string value that repeats every numNames chunks
+static StreamWriter *WriteInternTestChunks(uint32_t numChunks, uint32_t numChunkNames,
+                                           uint32_t numNames)
+{
+  StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+  WriteSerialiser ser(buf, Ownership::Nothing);
+
+  for(uint32_t i = 0; i < numChunks; i++)
+  {
+    SCOPED_SERIALISE_CHUNK(1 + (i % numChunkNames));
+
+    MySpecialEnum enumVal = MySpecialEnum(i % 4);
+    rdcstr name = StringFormat::Fmt("Intern test object %u", i % numNames);
+
+    SERIALISE_ELEMENT(enumVal);
+    SERIALISE_ELEMENT(name);
+  }
+
+  return buf;
+}
+
+static void ReadInternTestChunks(ReadSerialiser &ser, uint32_t numChunks)
+{
+  ser.ConfigureStructuredExport(
+      [](uint32_t id) -> rdcstr { return StringFormat::Fmt("SyntheticChunk%u", id); }, true, 0,
+      1.0);
+
+  for(uint32_t i = 0; i < numChunks; i++)
+  {
+    ser.ReadChunk<uint32_t>();
+
+    MySpecialEnum enumVal;
+    rdcstr name;
+
+    SERIALISE_ELEMENT(enumVal);
+    SERIALISE_ELEMENT(name);
+
+    ser.EndChunk();
+  }
+}
+
+TEST_CASE("Structured export shares repeated strings", "[serialiser][structured]")
+{
+  const uint32_t numChunks = 300;
+  const uint32_t numChunkNames = 8;
+  const uint32_t numNames = 20;
+
+  StreamWriter *buf = WriteInternTestChunks(numChunks, numChunkNames, numNames);
+
+  ReadSerialiser ser(new StreamReader(buf->GetData(), buf->GetOffset()), Ownership::Stream);
+
+  ReadInternTestChunks(ser, numChunks);
+
+  REQUIRE_FALSE(ser.IsErrored());
+
+  const SDFile &structData = ser.GetStructuredFile();
+
+  REQUIRE(structData.chunks.size() == numChunks);
+
+  const SDChunk &first = *structData.chunks[0];
+  const SDChunk &other = *structData.chunks[1];
+
+  CHECK(first.name == "SyntheticChunk1");
+  CHECK(other.name == "SyntheticChunk2");
+
+  // chunk names, enum strings and repeated string values all share storage
+  CHECK(first.name.c_str() == structData.chunks[numChunkNames]->name.c_str());
+  CHECK(first.GetChild(0)->data.str == "FirstEnumValue");
+  CHECK(first.GetChild(0)->data.str.c_str() == structData.chunks[4]->GetChild(0)->data.str.c_str());
+
+  CHECK(first.GetChild(1)->data.str == "Intern test object 0");
+  CHECK(other.GetChild(1)->data.str == "Intern test object 1");
+  CHECK(first.GetChild(1)->data.str.c_str() ==
+        structData.chunks[numNames]->GetChild(1)->data.str.c_str());
+  CHECK(first.GetChild(1)->data.str.c_str() != other.GetChild(1)->data.str.c_str());
+
+  delete buf;
+};
+
+TEST_CASE("Benchmark structured export string interning", "[serialiser][.benchmark]")
+{
+  const uint32_t numChunks = 50000;
+  const uint32_t numChunkNames = 8;
+  const uint32_t numNames = 1000;
+
+  StreamWriter *buf = WriteInternTestChunks(numChunks, numChunkNames, numNames);
+
+  StringIntern::Stats before = StringIntern::GetStats();
+
+  ReadSerialiser ser(new StreamReader(buf->GetData(), buf->GetOffset()), Ownership::Stream);
+
+  PerformanceTimer timer;
+
+  ReadInternTestChunks(ser, numChunks);
+
+  double ms = timer.GetMilliseconds();
+
+  StringIntern::Stats after = StringIntern::GetStats();
+
+  RDCLOG("Exported %u chunks in %.2f ms. Interning stored %llu bytes and saved %llu bytes",
+         numChunks, ms, after.bytes - before.bytes, after.bytesSaved - before.bytesSaved);
+
+  delete buf;
+};
+
+static const uint32_t SyntheticFrameChunk = 99;
+
+static rdcstr SyntheticChunkName(uint32_t id)
+{
+  return StringFormat::Fmt("SyntheticChunk%u", id);
+}
+
+// decodes a stream of synthetic chunks the way a driver's structured export would
+static RDResult ExportSyntheticChunks(StreamReader *reader, SDFile &output)
+{
+  ReadSerialiser ser(reader, Ownership::Nothing);
+
+  ser.ConfigureStructuredExport(&SyntheticChunkName, true, 0, 1.0);
+
+  while(!reader->AtEnd())
+  {
+    uint32_t chunk = ser.ReadChunk<uint32_t>();
+
+    if(chunk == SyntheticFrameChunk)
+    {
+      uint32_t frameNumber = 0;
+      SERIALISE_ELEMENT(frameNumber);
+    }
+    else
+    {
+      uint32_t index = 0;
+      bytebuf contents;
+      rdcstr name;
+
+      SERIALISE_ELEMENT(index);
+      SERIALISE_ELEMENT(contents);
+      SERIALISE_ELEMENT(name);
+
+      if(name == "Fail")
+        return RDResult(ResultCode::APIDataCorrupted, "Failed chunk"_lit);
+    }
+
+    ser.EndChunk();
+
+    if(reader->IsErrored())
+      return reader->GetError();
+  }
+
+  ser.GetStructuredFile().Swap(output);
+
+  return ResultCode::Succeeded;
+}
+
+TEST_CASE("Parallel structured export matches a serial decode", "[serialiser][structured]")
+{
+  const uint32_t numInitChunks = 1000;
+  const uint32_t numFrameChunks = 20;
+
+  StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+  auto writeChunks = [buf](bool withFrame, uint32_t failIndex) {
+    buf->Rewind();
+
+    WriteSerialiser ser(buf, Ownership::Nothing);
+
+    for(uint32_t i = 0; i < numInitChunks + numFrameChunks + 1; i++)
+    {
+      if(i == numInitChunks)
+      {
+        if(!withFrame)
+          continue;
+
+        SCOPED_SERIALISE_CHUNK(SyntheticFrameChunk);
+
+        uint32_t frameNumber = 7;
+        SERIALISE_ELEMENT(frameNumber);
+        continue;
+      }
+
+      SCOPED_SERIALISE_CHUNK(1 + (i % 8));
+
+      uint32_t index = i;
+      bytebuf contents;
+      // varying sizes so the batches don't all cover the same number of chunks
+      contents.resize((i % 7) * 40);
+      for(size_t b = 0; b < contents.size(); b++)
+        contents[b] = byte(i + b);
+      rdcstr name = i == failIndex ? rdcstr("Fail") : StringFormat::Fmt("Object %u", i);
+
+      SERIALISE_ELEMENT(index);
+      SERIALISE_ELEMENT(contents);
+      SERIALISE_ELEMENT(name);
+    }
+  };
+
+  // each exporter counts how many batches it was given
+  int32_t batchCounts[4] = {};
+  rdcarray<ChunkBatchExporter> exporters;
+  for(int32_t &count : batchCounts)
+  {
+    exporters.push_back([&count](StreamReader *reader, SDFile &output) {
+      Atomic::Inc32(&count);
+      return ExportSyntheticChunks(reader, output);
+    });
+  }
+
+  SECTION("Output matches")
+  {
+    writeChunks(true, ~0U);
+
+    SDFile serial;
+    {
+      StreamReader reader(buf->GetData(), buf->GetOffset());
+      REQUIRE(ExportSyntheticChunks(&reader, serial).code == ResultCode::Succeeded);
+    }
+
+    // the parallel export reads from a stream that can't seek, the same as a capture section
+    StreamWriter compressed(StreamWriter::DefaultScratchSize);
+    {
+      StreamWriter writer(new ZSTDCompressor(&compressed, Ownership::Nothing), Ownership::Stream);
+      writer.Write(buf->GetData(), buf->GetOffset());
+      writer.Finish();
+    }
+
+    SDFile parallel;
+    {
+      StreamReader reader(
+          new ZSTDDecompressor(new StreamReader(compressed.GetData(), compressed.GetOffset()),
+                               Ownership::Stream),
+          buf->GetOffset(), Ownership::Stream);
+
+      // start with something already in the output, so buffer indices need rebasing
+      SDFile existing;
+      existing.buffers.push_back(new bytebuf());
+      existing.buffers.push_back(new bytebuf());
+      AppendStructuredFile(parallel, existing);
+
+      // small batches so that each exporter gets several
+      REQUIRE(ExportChunksParallel(&reader, SyntheticFrameChunk, exporters, parallel, 4096).code ==
+              ResultCode::Succeeded);
+
+      // the reader is left at the frame for the rest to be decoded in order
+      CHECK(reader.GetOffset() > 0);
+      CHECK(parallel.chunks.size() == numInitChunks);
+
+      SDFile rest;
+      REQUIRE(ExportSyntheticChunks(&reader, rest).code == ResultCode::Succeeded);
+      CHECK(rest.chunks.size() == numFrameChunks + 1);
+
+      AppendStructuredFile(parallel, rest);
+      CHECK(rest.chunks.empty());
+      CHECK(rest.buffers.empty());
+    }
+
+    for(int32_t count : batchCounts)
+      CHECK(count > 1);
+
+    REQUIRE(parallel.chunks.size() == serial.chunks.size());
+    REQUIRE(parallel.buffers.size() == serial.buffers.size() + 2);
+
+    for(size_t i = 0; i < serial.chunks.size(); i++)
+    {
+      const SDChunk &a = *serial.chunks[i];
+      const SDChunk &b = *parallel.chunks[i];
+
+      CHECK(a.name == b.name);
+      CHECK(a.metadata.chunkID == b.metadata.chunkID);
+      CHECK(a.metadata.length == b.metadata.length);
+      REQUIRE(a.NumChildren() == b.NumChildren());
+
+      for(size_t c = 0; c < a.NumChildren(); c++)
+      {
+        const SDObject &childA = *a.GetChild(c);
+        const SDObject &childB = *b.GetChild(c);
+
+        CHECK(childA.name == childB.name);
+        CHECK(childA.type.basetype == childB.type.basetype);
+
+        if(childA.type.basetype == SDBasic::Buffer)
+        {
+          CHECK(childB.data.basic.u == childA.data.basic.u + 2);
+          CHECK((*serial.buffers[(size_t)childA.data.basic.u] ==
+                 *parallel.buffers[(size_t)childB.data.basic.u]));
+        }
+        else if(childA.type.basetype == SDBasic::String)
+        {
+          CHECK(childA.data.str == childB.data.str);
+        }
+        else
+        {
+          CHECK(childA.data.basic.u == childB.data.basic.u);
+        }
+      }
+    }
+  };
+
+  SECTION("Captures without a frame are decoded to the end")
+  {
+    writeChunks(false, ~0U);
+
+    StreamReader reader(buf->GetData(), buf->GetOffset());
+
+    SDFile parallel;
+    CHECK(ExportChunksParallel(&reader, SyntheticFrameChunk, exporters, parallel, 4096).code ==
+          ResultCode::Succeeded);
+
+    CHECK(reader.AtEnd());
+    CHECK(parallel.chunks.size() == numInitChunks + numFrameChunks);
+  };
+
+  SECTION("Chunks without a length are left for a serial decode")
+  {
+    writeChunks(true, ~0U);
+
+    // append a streamed chunk, then the frame
+    {
+      WriteSerialiser ser(buf, Ownership::Nothing);
+      ser.SetStreamingMode(true);
+
+      SCOPED_SERIALISE_CHUNK(1);
+
+      uint32_t index = 0;
+      bytebuf contents;
+      rdcstr name = "Streamed";
+
+      SERIALISE_ELEMENT(index);
+      SERIALISE_ELEMENT(contents);
+      SERIALISE_ELEMENT(name);
+    }
+
+    StreamReader reader(buf->GetData(), buf->GetOffset());
+
+    SDFile parallel;
+    CHECK(ExportChunksParallel(&reader, ~0U, exporters, parallel, 4096).code ==
+          ResultCode::Succeeded);
+
+    CHECK(parallel.chunks.size() == numInitChunks + numFrameChunks + 1);
+
+    SDFile rest;
+    REQUIRE(ExportSyntheticChunks(&reader, rest).code == ResultCode::Succeeded);
+    REQUIRE(rest.chunks.size() == 1);
+    CHECK(rest.chunks[0]->GetChild(2)->data.str == "Streamed");
+  };
+
+  SECTION("Errors in any batch are returned")
+  {
+    writeChunks(true, numInitChunks - 10);
+
+    StreamReader reader(buf->GetData(), buf->GetOffset());
+
+    SDFile parallel;
+    RDResult result =
+        ExportChunksParallel(&reader, SyntheticFrameChunk, exporters, parallel, 4096);
+
+    CHECK(result.code == ResultCode::APIDataCorrupted);
+    CHECK(result.message == "Failed chunk");
+
+    // batches before the failure are still appended, but nothing after it
+    CHECK(parallel.chunks.size() < numInitChunks);
+  };
+
+  delete buf;
+};
+
 enum class TestEnumClass
 {
   A = 1,
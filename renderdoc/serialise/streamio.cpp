@@ -205,6 +205,18 @@ void StreamReader::SetOffset(uint64_t offs)
   m_BufferHead = m_BufferBase + offs;
 }
 
+bool StreamReader::Rewind(uint64_t numBytes)
+{
+  if(numBytes > RewindWindow || numBytes > uint64_t(m_BufferHead - m_BufferBase))
+  {
+    RDCERR("Can't rewind stream by %llu bytes", numBytes);
+    return false;
+  }
+
+  m_BufferHead -= numBytes;
+  return true;
+}
+
 bool StreamReader::Reserve(uint64_t numBytes)
 {
   RDCASSERT(m_Sock || m_File || m_Decompressor);
@@ -213,7 +225,7 @@ bool StreamReader::Reserve(uint64_t numBytes)
   byte *oldBuffer = m_BufferBase;
 
   // always keep at least a certain window behind what we read.
-  uint64_t backwardsWindow = RDCMIN<uint64_t>(64ULL, m_BufferHead - m_BufferBase);
+  uint64_t backwardsWindow = RDCMIN(uint64_t(RewindWindow), uint64_t(m_BufferHead - m_BufferBase));
 
   byte *currentData = m_BufferHead - backwardsWindow;
   uint64_t currentDataSize = m_BufferSize - (m_BufferHead - m_BufferBase) + backwardsWindow;
@@ -106,6 +106,14 @@ public:
   }
   void SetOffset(uint64_t offs);
 
+  // at least this many bytes behind the current offset are always kept in the buffer, as long as
+  // they weren't read with a single read larger than the buffer.
+  static const uint64_t RewindWindow = 64;
+
+  // step back over bytes that were just read, so that they will be read again. Unlike SetOffset
+  // this works on any stream, but only within the RewindWindow.
+  bool Rewind(uint64_t numBytes);
+
   inline uint64_t GetOffset() { return m_BufferHead - m_BufferBase + m_ReadOffset; }
   inline uint64_t GetSize() { return m_InputSize; }
   inline bool AtEnd()
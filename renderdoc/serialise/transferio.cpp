@@ -0,0 +1,256 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+
+#include "transferio.h"
+#include "os/os_specific.h"
+#include "zstd/xxhash.h"
+
+// The stream is written as:
+//   uint64_t  offset the transfer starts from, or unavailableOffset if the file can't be opened
+//   uint64_t  total file size
+// then for each chunk from offset up to the file size:
+//   uint64_t  checksum of the uncompressed chunk
+//   the chunk, as written by AdaptiveBufferSend
+//
+// If the sender can't read its file partway through it sends an empty chunk and stops.
+
+static const uint64_t unavailableOffset = ~0ULL;
+
+static uint64_t ChunkChecksum(const bytebuf &chunk)
+{
+  return XXH64(chunk.data(), chunk.size(), 0);
+}
+
+static bool ReadFileRange(FILE *f, uint64_t offset, uint64_t size, bytebuf &chunk)
+{
+  chunk.resize((size_t)size);
+  FileIO::fseek64(f, offset, SEEK_SET);
+  return FileIO::fread(chunk.data(), 1, (size_t)size, f) == size;
+}
+
+// identifies the first offset bytes of a file by its first and last chunks. Verifying every chunk
+// would mean reading back the whole prefix, which for a large capture takes a while, and the header
+// at the start of a capture changes if anything else does.
+static bool PrefixChecksum(FILE *f, uint64_t offset, uint64_t &checksum)
+{
+  bytebuf chunk;
+
+  if(!ReadFileRange(f, 0, TransferChunkSize, chunk))
+    return false;
+
+  checksum = ChunkChecksum(chunk);
+
+  if(offset > TransferChunkSize)
+  {
+    if(!ReadFileRange(f, offset - TransferChunkSize, TransferChunkSize, chunk))
+      return false;
+
+    checksum = XXH64(chunk.data(), chunk.size(), checksum);
+  }
+
+  return true;
+}
+
+void GetTransferResumePoint(const rdcstr &partialPath, uint64_t &offset, uint64_t &checksum)
+{
+  offset = 0;
+  checksum = 0;
+
+  FILE *f = FileIO::fopen(partialPath, FileIO::ReadBinary);
+
+  if(!f)
+    return;
+
+  FileIO::fseek64(f, 0, SEEK_END);
+  uint64_t size = FileIO::ftell64(f);
+
+  // chunks are only written once verified, but if we were interrupted while writing one there may
+  // be part of a chunk on the end
+  uint64_t end = size - (size % TransferChunkSize);
+
+  if(end > 0 && PrefixChecksum(f, end, checksum))
+    offset = end;
+
+  FileIO::fclose(f);
+}
+
+bool ChunkedFileSend(StreamWriter *writer, const rdcstr &path, uint64_t resumeOffset,
+                     uint64_t resumeChecksum, AdaptiveCodec &codec,
+                     RENDERDOC_ProgressCallback progress)
+{
+  FILE *f = FileIO::fopen(path, FileIO::ReadBinary);
+
+  if(!f)
+  {
+    RDCERR("Can't open '%s' to send", path.c_str());
+
+    writer->Write(unavailableOffset);
+    writer->Write(uint64_t(0));
+    return false;
+  }
+
+  FileIO::fseek64(f, 0, SEEK_END);
+  uint64_t size = FileIO::ftell64(f);
+
+  uint64_t offset = 0, checksum = 0;
+
+  // only resume if the receiver's data matches ours, otherwise the file has changed
+  if(resumeOffset > 0 && resumeOffset <= size && (resumeOffset % TransferChunkSize) == 0 &&
+     PrefixChecksum(f, resumeOffset, checksum) && checksum == resumeChecksum)
+  {
+    RDCLOG("Resuming transfer of '%s' from %llu of %llu bytes", path.c_str(), resumeOffset, size);
+    offset = resumeOffset;
+  }
+
+  bool success = writer->Write(offset);
+  success &= writer->Write(size);
+
+  if(progress)
+    progress(0.0001f);
+
+  bytebuf chunk;
+
+  while(success && offset < size)
+  {
+    uint64_t chunkSize = RDCMIN(TransferChunkSize, size - offset);
+
+    if(!ReadFileRange(f, offset, chunkSize, chunk))
+    {
+      RDCERR("Error reading '%s' at %llu", path.c_str(), offset);
+
+      chunk.clear();
+      writer->Write(uint64_t(0));
+      AdaptiveBufferSend(writer, chunk, codec);
+
+      success = false;
+      break;
+    }
+
+    success &= writer->Write(ChunkChecksum(chunk));
+    success &= AdaptiveBufferSend(writer, chunk, codec);
+
+    offset += chunkSize;
+
+    if(progress)
+      progress(float(offset) / float(size));
+  }
+
+  if(progress)
+    progress(1.0f);
+
+  FileIO::fclose(f);
+
+  return success && !writer->IsErrored();
+}
+
+bool ChunkedFileReceive(StreamReader *reader, const rdcstr &partialPath, AdaptiveCodec &codec,
+                        RENDERDOC_ProgressCallback progress)
+{
+  uint64_t offset = 0, size = 0;
+
+  if(!reader->Read(offset) || !reader->Read(size))
+    return false;
+
+  // leave any partial file alone, it may be resumable when the file is available again
+  if(offset == unavailableOffset)
+  {
+    RDCERR("Sender couldn't open the file to send");
+    return false;
+  }
+
+  FILE *f = NULL;
+
+  if(offset == 0)
+  {
+    f = FileIO::fopen(partialPath, FileIO::WriteBinary);
+  }
+  else if(FileIO::GetFileSize(partialPath) >= offset)
+  {
+    f = FileIO::fopen(partialPath, FileIO::UpdateBinary);
+
+    // discard any partly written chunk past the point we're resuming from
+    if(f)
+    {
+      FileIO::ftruncateat(f, offset);
+      FileIO::fseek64(f, offset, SEEK_SET);
+    }
+  }
+
+  if(!f)
+    RDCERR("Can't open '%s' to receive at %llu", partialPath.c_str(), offset);
+
+  // once this is false we stop writing, but keep reading so the stream stays in sync
+  bool verified = (f != NULL);
+
+  bytebuf chunk;
+
+  if(progress)
+    progress(0.0001f);
+
+  while(offset < size)
+  {
+    uint64_t chunkSize = RDCMIN(TransferChunkSize, size - offset);
+    uint64_t checksum = 0;
+
+    if(!reader->Read(checksum) || !AdaptiveBufferReceive(reader, chunk, codec))
+    {
+      verified = false;
+      break;
+    }
+
+    if(chunk.empty())
+    {
+      RDCERR("Sender couldn't read its file at %llu", offset);
+      verified = false;
+      break;
+    }
+
+    if(verified && (chunk.size() != chunkSize || ChunkChecksum(chunk) != checksum))
+    {
+      RDCERR("Checksum mismatch on chunk at %llu, discarding the rest of the transfer", offset);
+      verified = false;
+    }
+
+    if(verified &&
+       (FileIO::fwrite(chunk.data(), 1, chunk.size(), f) != chunk.size() || !FileIO::fflush(f)))
+    {
+      RDCERR("Error writing '%s' at %llu", partialPath.c_str(), offset);
+      verified = false;
+    }
+
+    offset += chunkSize;
+
+    if(progress)
+      progress(float(offset) / float(size));
+  }
+
+  if(progress)
+    progress(1.0f);
+
+  if(f)
+    FileIO::fclose(f);
+
+  return verified && offset == size && !reader->IsErrored();
+}
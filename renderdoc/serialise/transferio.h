@@ -0,0 +1,55 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+
+#pragma once
+
+#include "adaptiveio.h"
+
+// Resumable file transfers for connections that may drop partway through a large capture.
+//
+// The file is sent in fixed-size chunks, each compressed with an AdaptiveCodec and preceded by a
+// checksum of its contents. The receiver writes into a partial file and only writes a chunk once
+// it has been verified, so after any failure the partial file holds a verified prefix. The next
+// transfer asks the sender to start from the end of that prefix, and the sender checks the first
+// and last chunks of it against its own copy before agreeing, falling back to the start if the
+// file has changed.
+
+// the chunk size. Resume points are always a multiple of this.
+static const uint64_t TransferChunkSize = 4 * 1024 * 1024;
+
+// find where a transfer into partialPath can resume from. offset is 0 if there's nothing to resume,
+// otherwise checksum identifies the data before offset.
+void GetTransferResumePoint(const rdcstr &partialPath, uint64_t &offset, uint64_t &checksum);
+
+// send the file at path, from the receiver's resume point if it matches this file.
+bool ChunkedFileSend(StreamWriter *writer, const rdcstr &path, uint64_t resumeOffset,
+                     uint64_t resumeChecksum, AdaptiveCodec &codec,
+                     RENDERDOC_ProgressCallback progress = RENDERDOC_ProgressCallback());
+
+// receive a file sent by ChunkedFileSend into partialPath. Returns true once the whole file has
+// been received and verified. On failure the stream may still be usable if only a checksum failed,
+// which can be checked with reader->IsErrored(), and either way partialPath can be resumed.
+bool ChunkedFileReceive(StreamReader *reader, const rdcstr &partialPath, AdaptiveCodec &codec,
+                        RENDERDOC_ProgressCallback progress = RENDERDOC_ProgressCallback());
@@ -0,0 +1,386 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+
+#include "string_intern.h"
+#include "api/replay/rdchashmap.h"
+#include "common/common.h"
+#include "common/formatting.h"
+#include "common/threading.h"
+#include "os/os_specific.h"
+
+namespace StringIntern
+{
+struct Entry
+{
+  const char *str;
+  uint32_t length;
+  // next entry with the same hash, or 0 if this is the last
+  Handle next;
+};
+
+struct Table
+{
+  // strings are packed into pages of this size. Anything too large to pack well gets its own
+  // allocation.
+  static const size_t PageSize = 64 * 1024;
+
+  // returned from AddLocked when the string isn't present and couldn't be added
+  static const Handle NoHandle = ~0U;
+
+  Table(uint64_t budget = DataBudget) : dataBudget(budget)
+  {
+    entries.push_back({"", 0, 0});
+    lookup[Hash("", 0)] = 0;
+  }
+
+  ~Table()
+  {
+    for(char *page : pages)
+      delete[] page;
+  }
+
+  static uint64_t Hash(const char *str, size_t length)
+  {
+    // 64-bit FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < length; i++)
+    {
+      hash ^= (byte)str[i];
+      hash *= 1099511628211ULL;
+    }
+    return hash;
+  }
+
+  const char *Store(const char *str, size_t length)
+  {
+    char *ret = NULL;
+
+    if(length + 1 > PageSize / 4)
+    {
+      ret = new char[length + 1];
+    }
+    else
+    {
+      if(pageUsed + length + 1 > PageSize)
+      {
+        pages.push_back(new char[PageSize]);
+        pageUsed = 0;
+      }
+
+      ret = pages.back() + pageUsed;
+      pageUsed += length + 1;
+    }
+
+    memcpy(ret, str, length);
+    ret[length] = 0;
+
+    stats.bytes += length + 1;
+
+    return ret;
+  }
+
+  Handle Add(const char *str, size_t length)
+  {
+    uint64_t hash = Hash(str, length);
+
+    SCOPED_LOCK(lock);
+
+    return AddLocked(hash, str, length, false);
+  }
+
+  rdcstr Intern(const rdcstr &str, bool data)
+  {
+    uint64_t hash = Hash(str.c_str(), str.size());
+
+    SCOPED_LOCK(lock);
+
+    Handle h = AddLocked(hash, str.c_str(), str.size(), data);
+
+    if(h == NoHandle)
+      return str;
+
+    const Entry &e = entries[h];
+
+    // the storage is immutable and never freed so it's safe to treat it as a literal
+    return rdcstr(operator"" _lit(e.str, e.length));
+  }
+
+  Handle AddLocked(uint64_t hash, const char *str, size_t length, bool data)
+  {
+    // data strings are only added while they fit in the budget, but can always share
+    bool canAdd = !data || stats.dataBytes + length + 1 <= dataBudget;
+
+    auto it = lookup.find(hash);
+    if(it != lookup.end())
+    {
+      Handle h = it->second;
+      for(;;)
+      {
+        const Entry &e = entries[h];
+        if(e.length == length && !memcmp(e.str, str, length))
+        {
+          stats.hits++;
+          stats.bytesSaved += length + 1;
+          return h;
+        }
+
+        if(e.next == 0)
+          break;
+        h = e.next;
+      }
+
+      if(!canAdd)
+        return NoHandle;
+
+      // hash collision, chain the new entry onto the last one
+      Handle ret = NewEntry(str, length, data);
+      entries[h].next = ret;
+      return ret;
+    }
+
+    if(!canAdd)
+      return NoHandle;
+
+    Handle ret = NewEntry(str, length, data);
+    lookup[hash] = ret;
+    return ret;
+  }
+
+  Handle NewEntry(const char *str, size_t length, bool data)
+  {
+    Handle ret = (Handle)entries.size();
+    entries.push_back({Store(str, length), (uint32_t)length, 0});
+    stats.count++;
+    if(data)
+      stats.dataBytes += length + 1;
+    return ret;
+  }
+
+  rdcstr Get(Handle handle)
+  {
+    const char *str = "";
+    size_t length = 0;
+
+    {
+      SCOPED_LOCK(lock);
+
+      if(handle < entries.size())
+      {
+        str = entries[handle].str;
+        length = entries[handle].length;
+      }
+      else
+      {
+        RDCERR("Invalid interned string handle %u", handle);
+      }
+    }
+
+    // the storage is immutable and never freed so it's safe to treat it as a literal
+    return rdcstr(operator"" _lit(str, length));
+  }
+
+  Threading::CriticalSection lock;
+  rdcarray<Entry> entries;
+  rdcarray<char *> pages;
+  size_t pageUsed = PageSize;
+  rdchashmap<uint64_t, Handle> lookup;
+  uint64_t dataBudget;
+  Stats stats = {};
+};
+
+static Table &GetTable()
+{
+  // deliberately leaked so that strings remain valid during static destruction
+  static Table *table = new Table;
+  return *table;
+}
+
+Handle Add(const char *str, size_t length)
+{
+  if(length == 0)
+    return 0;
+
+  return GetTable().Add(str, length);
+}
+
+rdcstr Get(Handle handle)
+{
+  return GetTable().Get(handle);
+}
+
+rdcstr Intern(const rdcstr &str)
+{
+  if(str.size() > MaxInternLength)
+    return str;
+
+  if(str.empty())
+    return rdcstr();
+
+  return GetTable().Intern(str, false);
+}
+
+rdcstr InternData(const rdcstr &str)
+{
+  if(str.size() > MaxInternLength)
+    return str;
+
+  if(str.empty())
+    return rdcstr();
+
+  return GetTable().Intern(str, true);
+}
+
+Stats GetStats()
+{
+  Table &table = GetTable();
+  SCOPED_LOCK(table.lock);
+  return table.stats;
+}
+
+void LogStats(const char *context)
+{
+  Stats stats = GetStats();
+  RDCLOG("%s: %u interned strings using %llu bytes, %llu shared uses saving %llu bytes", context,
+         stats.count, stats.bytes, stats.hits, stats.bytesSaved);
+}
+};
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+TEST_CASE("Test string interning", "[string][intern]")
+{
+  SECTION("Empty string")
+  {
+    CHECK(StringIntern::Add(rdcstr()) == 0);
+    CHECK(StringIntern::Add("", 0) == 0);
+    CHECK(StringIntern::Get(0) == "");
+  };
+
+  SECTION("Deduplication")
+  {
+    rdcstr a = "intern_test_string";
+    rdcstr b = "intern_test_string";
+    rdcstr c = "intern_test_other";
+
+    StringIntern::Handle ha = StringIntern::Add(a);
+    StringIntern::Handle hb = StringIntern::Add(b);
+    StringIntern::Handle hc = StringIntern::Add(c);
+
+    CHECK(ha != 0);
+    CHECK(ha == hb);
+    CHECK(ha != hc);
+
+    CHECK(StringIntern::Get(ha) == a);
+    CHECK(StringIntern::Get(hc) == c);
+
+    // prefixes and embedded strings are distinct
+    CHECK(StringIntern::Add("intern_test", 11) != ha);
+    CHECK(StringIntern::Get(StringIntern::Add("intern_test", 11)) == "intern_test");
+  };
+
+  SECTION("Interned strings share storage")
+  {
+    rdcstr a = StringIntern::Intern("intern_test_shared");
+    rdcstr b = StringIntern::Intern(rdcstr("intern_test_shared"));
+
+    CHECK(a.c_str() == b.c_str());
+
+    rdcinflexiblestr inflex;
+    inflex = b;
+    CHECK(inflex.c_str() == a.c_str());
+
+    rdcstr copy = a;
+    CHECK(copy.c_str() == a.c_str());
+  };
+
+  SECTION("Long strings")
+  {
+    rdcstr longstr;
+    longstr.fill(StringIntern::MaxInternLength + 1, 'x');
+
+    rdcstr passthrough = StringIntern::Intern(longstr);
+    CHECK(passthrough == longstr);
+    CHECK(passthrough.c_str() != StringIntern::Get(StringIntern::Add(longstr)).c_str());
+
+    // explicit adds still work, including strings larger than a page
+    rdcstr huge;
+    huge.fill(256 * 1024, 'y');
+    StringIntern::Handle h = StringIntern::Add(huge);
+    CHECK(StringIntern::Get(h) == huge);
+    CHECK(StringIntern::Add(huge) == h);
+  };
+
+  SECTION("Data budget")
+  {
+    // a private table with a tiny budget, so the process-wide one isn't used up
+    StringIntern::Table table(64);
+
+    rdcstr fixed = table.Intern("intern_test_fixed", false);
+    rdcstr first = table.Intern("intern_test_data_0123456789", true);
+    rdcstr second = table.Intern("intern_test_data_9876543210", true);
+
+    CHECK(table.stats.dataBytes == 56);
+
+    // over budget, so this isn't added and each copy has its own storage
+    rdcstr third = "intern_test_data_over_budget";
+    CHECK(table.Intern(third, true) == third);
+    CHECK(table.Intern(third, true).c_str() != table.Intern(third, true).c_str());
+    CHECK(table.stats.dataBytes == 56);
+
+    // strings already present are still shared, whichever way they were added
+    CHECK(table.Intern(rdcstr("intern_test_data_0123456789"), true).c_str() == first.c_str());
+    CHECK(table.Intern(rdcstr("intern_test_fixed"), true).c_str() == fixed.c_str());
+
+    // and the budget doesn't apply to fixed strings
+    rdcstr other = table.Intern("intern_test_fixed_other", false);
+    CHECK(table.Intern(rdcstr("intern_test_fixed_other"), false).c_str() == other.c_str());
+    CHECK(second == "intern_test_data_9876543210");
+  };
+
+  SECTION("Many strings")
+  {
+    rdcarray<StringIntern::Handle> handles;
+    for(int i = 0; i < 20000; i++)
+      handles.push_back(StringIntern::Add(StringFormat::Fmt("intern_test_%d", i)));
+
+    StringIntern::Stats before = StringIntern::GetStats();
+
+    for(int i = 0; i < 20000; i++)
+    {
+      rdcstr str = StringFormat::Fmt("intern_test_%d", i);
+      CHECK(StringIntern::Add(str) == handles[i]);
+      CHECK(StringIntern::Get(handles[i]) == str);
+    }
+
+    StringIntern::Stats after = StringIntern::GetStats();
+
+    CHECK(after.count == before.count);
+    CHECK(after.hits >= before.hits + 20000);
+  };
+};
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
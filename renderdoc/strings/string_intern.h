@@ -0,0 +1,85 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "api/replay/rdcstr.h"
+
+// A process-wide table of deduplicated strings. Strings are added once and never modified or
+// freed, so the storage can be handed out as fixed/literal strings that rdcstr and
+// rdcinflexiblestr will share by pointer instead of copying. This is intended for the very
+// repetitive strings that show up when loading a capture - chunk names, enum stringifications,
+// marker names - where the same few thousand strings are otherwise allocated millions of times.
+// Since nothing is ever freed, strings that come from capture data such as string values or marker
+// names must go through InternData() so the table can't grow without bound.
+namespace StringIntern
+{
+// a handle of 0 is always the empty string
+typedef uint32_t Handle;
+
+// strings longer than this are passed through Intern() unchanged. They are rarely repeated and
+// would otherwise be retained for the lifetime of the process.
+static const size_t MaxInternLength = 256;
+
+// InternData() stops adding new strings once they take this much storage between them. Strings
+// already in the table are still shared.
+static const uint64_t DataBudget = 8 * 1024 * 1024;
+
+struct Stats
+{
+  // number of unique strings in the table, and the bytes used to store them
+  uint32_t count;
+  uint64_t bytes;
+  // number of lookups that found an existing string, and the bytes they didn't need to allocate
+  uint64_t hits;
+  uint64_t bytesSaved;
+  // bytes stored for strings added by InternData(), at most DataBudget
+  uint64_t dataBytes;
+};
+
+// returns the handle for the given string, adding it to the table if it's not present. Handles
+// are stable for the lifetime of the process.
+Handle Add(const char *str, size_t length);
+inline Handle Add(const rdcstr &str)
+{
+  return Add(str.c_str(), str.size());
+}
+
+// returns a fixed string pointing at the table's storage, so copies don't allocate.
+rdcstr Get(Handle handle);
+
+// equivalent to Get(Add(str)) for strings up to MaxInternLength, but with a single lookup. Longer
+// strings are returned as-is
+rdcstr Intern(const rdcstr &str);
+
+// as Intern() but for strings from capture data. Once DataBudget is used up, strings that aren't
+// already in the table are returned as-is instead of being added.
+rdcstr InternData(const rdcstr &str);
+
+Stats GetStats();
+void LogStats(const char *context);
+};